@@ -3,7 +3,7 @@
  *
  * Yori shell base64 encode or decode
  *
- * Copyright (c) 2023 Malcolm J. Smith
+ * Copyright (c) 2023-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -37,7 +37,9 @@ CHAR strBase64HelpText[] =
         "\n"
         "BASE64 [-license] [-d] [<file>]\n"
         "\n"
-        "   -d             Decode the file or standard input.  Default is encode.\n";
+        "   -d             Decode the file or standard input.  Default is encode.\n"
+        "\n"
+        "Input to decode is interpreted using the active input encoding.\n";
 
 /**
  Display usage text to the user.
@@ -54,318 +56,466 @@ Base64Help(VOID)
 }
 
 /**
- A buffer for a single data stream.
+ The number of bytes to read from the source at a time.  Input is processed
+ in chunks of this size, so memory usage does not depend on the size of the
+ input.
+ */
+#define BASE64_READ_SIZE (64 * 1024)
+
+/**
+ Context describing a base64 operation.
  */
-typedef struct _BASE64_BUFFER {
+typedef struct _BASE64_CONTEXT {
 
     /**
-     A handle to a pipe which is the source of data for this buffer.
+     A handle to the source of data.
      */
     HANDLE hSource;
 
     /**
-     The data buffer.
+     A handle to the target for transformed data.
      */
-    YORI_LIB_BYTE_BUFFER ByteBuffer;
-
-} BASE64_BUFFER, *PBASE64_BUFFER;
-
-/**
- Populate data from stdin into an in memory buffer.
+    HANDLE hTarget;
 
- @param ThisBuffer A pointer to the process buffer set.
+    /**
+     A buffer to read source data into.
+     */
+    PUCHAR ReadBuffer;
 
- @return TRUE to indicate success, FALSE to indicate failure.
- */
-BOOL
-Base64BufferPump(
-    __in PBASE64_BUFFER ThisBuffer
-    )
-{
-    DWORD BytesRead;
-    BOOL Result = FALSE;
+    /**
+     A buffer to hold transformed data before it is written.
+     */
     PUCHAR WriteBuffer;
-    YORI_ALLOC_SIZE_T BytesAvailable;
 
-    while (TRUE) {
+    /**
+     The size of WriteBuffer, in bytes.
+     */
+    YORI_ALLOC_SIZE_T WriteBufferSize;
 
-        WriteBuffer = YoriLibByteBufferGetPointerToEnd(&ThisBuffer->ByteBuffer, 16384, &BytesAvailable);
-        if (WriteBuffer == NULL) {
-            break;
-        }
+    /**
+     A buffer used to widen encoded text when it must be converted to the
+     console or the active output encoding.
+     */
+    YORI_STRING TextBuffer;
 
-        if (ReadFile(ThisBuffer->hSource,
-                     WriteBuffer,
-                     BytesAvailable,
-                     &BytesRead,
-                     NULL)) {
+    /**
+     TRUE if input to decode is UTF-16 and must be converted into single
+     byte characters before decoding.
+     */
+    BOOLEAN Utf16Input;
 
-            if (BytesRead == 0) {
-                Result = TRUE;
-                break;
-            }
+    /**
+     TRUE if the previous read ended in the middle of a UTF-16 character,
+     whose first byte is in HalfChar.
+     */
+    BOOLEAN HaveHalfChar;
 
-            YoriLibByteBufferAddToPopulatedLength(&ThisBuffer->ByteBuffer, BytesRead);
+    /**
+     TRUE once a UTF-16 character has been converted, so a byte order mark
+     is only removed from the start of the input.
+     */
+    BOOLEAN CharsConverted;
 
-        } else {
-            Result = TRUE;
-            break;
-        }
-    }
+    /**
+     The first byte of a UTF-16 character which was split across reads.
+     */
+    UCHAR HalfChar;
 
-    return Result;
-}
+} BASE64_CONTEXT, *PBASE64_CONTEXT;
 
 /**
- Allocate and initialize a buffer for an input stream.
+ Allocate buffers for a base64 operation.
 
- @param Buffer Pointer to the buffer to allocate structures for.
+ @param Base64Context Pointer to the context to allocate buffers for.
 
- @return TRUE if the buffer is successfully initialized, FALSE if it is not.
+ @return TRUE if the buffers were successfully allocated, FALSE if they were
+         not.
  */
+__success(return)
 BOOL
-Base64AllocateBuffer(
-    __out PBASE64_BUFFER Buffer
+Base64AllocateBuffers(
+    __inout PBASE64_CONTEXT Base64Context
     )
 {
-    return YoriLibByteBufferInitialize(&Buffer->ByteBuffer, 1024);
+    Base64Context->ReadBuffer = YoriLibMalloc(BASE64_READ_SIZE);
+    if (Base64Context->ReadBuffer == NULL) {
+        return FALSE;
+    }
+
+    Base64Context->WriteBufferSize = 0;
+    Base64Context->WriteBuffer = NULL;
+    YoriLibInitEmptyString(&Base64Context->TextBuffer);
+    return TRUE;
 }
 
 /**
- Free structures associated with a single input stream.
+ Free buffers associated with a base64 operation.
 
- @param ThisBuffer Pointer to the single stream's buffers to deallocate.
+ @param Base64Context Pointer to the context to free buffers for.
  */
 VOID
-Base64FreeBuffer(
-    __in PBASE64_BUFFER ThisBuffer
+Base64FreeBuffers(
+    __inout PBASE64_CONTEXT Base64Context
     )
 {
-    YoriLibByteBufferCleanup(&ThisBuffer->ByteBuffer);
+    if (Base64Context->ReadBuffer != NULL) {
+        YoriLibFree(Base64Context->ReadBuffer);
+        Base64Context->ReadBuffer = NULL;
+    }
+
+    if (Base64Context->WriteBuffer != NULL) {
+        YoriLibFree(Base64Context->WriteBuffer);
+        Base64Context->WriteBuffer = NULL;
+    }
+    Base64Context->WriteBufferSize = 0;
+    YoriLibFreeStringContents(&Base64Context->TextBuffer);
 }
 
 /**
- Perform base64 encode and output to the requested device.
+ Ensure the write buffer is at least a specified size.  Since the size
+ required depends only on the size of each read, this typically allocates
+ once for the lifetime of the operation.
 
- @param ThisBuffer Pointer to the buffer to output.
+ @param Base64Context Pointer to the context.
 
- @return TRUE to indicate success, FALSE to indicate failure.
+ @param BytesRequired The number of bytes the write buffer must hold.
+
+ @return TRUE if the write buffer is large enough, FALSE if it could not be
+         reallocated.
  */
+__success(return)
 BOOL
-Base64Encode(
-    __inout PBASE64_BUFFER ThisBuffer
+Base64EnsureWriteBuffer(
+    __inout PBASE64_CONTEXT Base64Context,
+    __in YORI_ALLOC_SIZE_T BytesRequired
     )
 {
-    DWORD CharsRequired;
-    YORI_STRING Buffer;
-    DWORD Err;
-    LPTSTR ErrText;
-    PUCHAR SourceBuffer;
-    YORI_ALLOC_SIZE_T BytesPopulated;
+    PUCHAR NewBuffer;
 
-    //
-    //  Calculate the buffer size needed
-    //
+    if (BytesRequired <= Base64Context->WriteBufferSize) {
+        return TRUE;
+    }
 
-    SourceBuffer = YoriLibByteBufferGetPointerToValidData(&ThisBuffer->ByteBuffer, 0, &BytesPopulated);
-    if (!DllCrypt32.pCryptBinaryToStringW(SourceBuffer, BytesPopulated, CRYPT_STRING_BASE64, NULL, &CharsRequired)) {
-        Err = GetLastError();
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: failure to calculate buffer length in CryptBinaryToString: %s"), ErrText);
-        YoriLibFreeWinErrorText(ErrText);
+    NewBuffer = YoriLibMalloc(BytesRequired);
+    if (NewBuffer == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: allocation failure\n"));
         return FALSE;
     }
 
-    //
-    //  Check if the buffer size would overflow, and fail if so
-    //
-
-    if (!YoriLibIsSizeAllocatable(CharsRequired)) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: supplied data too large\n"));
-        return FALSE;
+    if (Base64Context->WriteBuffer != NULL) {
+        YoriLibFree(Base64Context->WriteBuffer);
     }
 
-    //
-    //  Allocate buffer
-    //
+    Base64Context->WriteBuffer = NewBuffer;
+    Base64Context->WriteBufferSize = BytesRequired;
+    return TRUE;
+}
 
-    if (!YoriLibAllocateString(&Buffer, (YORI_ALLOC_SIZE_T)CharsRequired)) {
-        Err = GetLastError();
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: allocation failure: %s"), ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        return FALSE;
-    }
+/**
+ Read the next chunk of data from the source.
 
-    //
-    //  Perform the encode
-    //
+ @param Base64Context Pointer to the context.
 
-    if (!DllCrypt32.pCryptBinaryToStringW(SourceBuffer, BytesPopulated, CRYPT_STRING_BASE64, Buffer.StartOfString, &CharsRequired)) {
+ @param BytesRead On successful completion, updated to contain the number of
+        bytes read.  Zero indicates the end of the input.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+Base64Read(
+    __inout PBASE64_CONTEXT Base64Context,
+    __out PDWORD BytesRead
+    )
+{
+    DWORD Err;
+    LPTSTR ErrText;
+
+    if (!ReadFile(Base64Context->hSource, Base64Context->ReadBuffer, BASE64_READ_SIZE, BytesRead, NULL)) {
         Err = GetLastError();
+
+        //
+        //  A pipe indicates the end of data by being broken.
+        //
+
+        if (Err == ERROR_BROKEN_PIPE) {
+            *BytesRead = 0;
+            return TRUE;
+        }
+
         ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: failure to encode in CryptBinaryToString: %s"), ErrText);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: failure to read from input: %s"), ErrText);
         YoriLibFreeWinErrorText(ErrText);
-        YoriLibFreeStringContents(&Buffer);
         return FALSE;
     }
 
-    Buffer.LengthInChars = (YORI_ALLOC_SIZE_T)CharsRequired;
+    return TRUE;
+}
 
-    //
-    //  Free the source buffer.  We're done with it by this point, and
-    //  output may need to double buffer for encoding.
-    //
+/**
+ Write transformed data to the target.
 
-    Base64FreeBuffer(ThisBuffer);
+ @param Base64Context Pointer to the context.
 
-    //
-    //  Output the encoded form.
-    //
+ @param Buffer Pointer to the data to write.
+
+ @param BytesToWrite The number of bytes to write.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+Base64Write(
+    __in PBASE64_CONTEXT Base64Context,
+    __in PUCHAR Buffer,
+    __in YORI_ALLOC_SIZE_T BytesToWrite
+    )
+{
+    YORI_ALLOC_SIZE_T BytesSent;
+    DWORD BytesWritten;
+    DWORD Err;
+    LPTSTR ErrText;
+
+    BytesSent = 0;
+    while (BytesSent < BytesToWrite) {
+        if (!WriteFile(Base64Context->hTarget,
+                       YoriLibAddToPointer(Buffer, BytesSent),
+                       BytesToWrite - BytesSent,
+                       &BytesWritten,
+                       NULL)) {
+
+            Err = GetLastError();
+            ErrText = YoriLibGetWinErrorText(Err);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: failure to write to output: %s"), ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            return FALSE;
+        }
 
-    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &Buffer);
-    YoriLibFreeStringContents(&Buffer);
+        BytesSent = BytesSent + BytesWritten;
+        ASSERT(BytesSent <= BytesToWrite);
+    }
 
     return TRUE;
 }
 
 /**
- Perform base64 decode and output to the requested device.
+ Write encoded text to the target.  Unlike decoded data, which is written
+ unchanged, encoded text is written in the encoding of the output device.
+
+ @param Base64Context Pointer to the context.
+
+ @param Buffer Pointer to the encoded text to write.
 
- @param ThisBuffer Pointer to the buffer to output.
+ @param CharsToWrite The number of characters to write.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
+__success(return)
 BOOL
-Base64Decode(
-    __inout PBASE64_BUFFER ThisBuffer
+Base64WriteText(
+    __in PBASE64_CONTEXT Base64Context,
+    __in PUCHAR Buffer,
+    __in YORI_ALLOC_SIZE_T CharsToWrite
     )
 {
-    YORI_ALLOC_SIZE_T CharsRequired;
-    DWORD BytesRequired;
-    YORI_STRING Buffer;
-    PUCHAR BinaryBuffer;
-    DWORD Skip;
-    DWORD Flags;
-    DWORD BytesSent;
-    BOOL Result;
-    HANDLE hTarget;
     DWORD Err;
     LPTSTR ErrText;
-    PUCHAR SourceBuffer;
-    YORI_ALLOC_SIZE_T BytesPopulated;
 
-    //
-    //  Convert the input buffer into a UTF16 string.
-    //
-
-    SourceBuffer = YoriLibByteBufferGetPointerToValidData(&ThisBuffer->ByteBuffer, 0, &BytesPopulated);
-    if (SourceBuffer == NULL) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: allocation failure\n"));
-        return FALSE;
-    }
-    CharsRequired = YoriLibGetMultibyteInputSizeNeeded(SourceBuffer, BytesPopulated);
-    if (!YoriLibAllocateString(&Buffer, CharsRequired + 1)) {
+    if (!YoriLibOutputAsciiToDevice(Base64Context->hTarget, Buffer, CharsToWrite, &Base64Context->TextBuffer)) {
         Err = GetLastError();
         ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: allocation failure: %s"), ErrText);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: failure to write to output: %s"), ErrText);
         YoriLibFreeWinErrorText(ErrText);
         return FALSE;
     }
 
-    YoriLibMultibyteInput(SourceBuffer, BytesPopulated, Buffer.StartOfString, CharsRequired);
-    Buffer.LengthInChars = CharsRequired;
-    Buffer.StartOfString[CharsRequired] = '\0';
+    return TRUE;
+}
 
-    //
-    //  Free the source buffer.  We're done with it by this point, and
-    //  output may need to double buffer for encoding.
-    //
+/**
+ Perform base64 encode and output to the requested device.  Data is encoded
+ and written as it is read, so only a single read buffer is held in memory
+ at any time.
 
-    Base64FreeBuffer(ThisBuffer);
+ @param Base64Context Pointer to the context.
 
-    //
-    //  Calculate the buffer size needed
-    //
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+Base64Encode(
+    __inout PBASE64_CONTEXT Base64Context
+    )
+{
+    YORI_LIB_BASE64_ENCODE_CONTEXT Context;
+    YORI_ALLOC_SIZE_T CharsGenerated;
+    DWORD BytesRead;
 
-    if (!DllCrypt32.pCryptStringToBinaryW(Buffer.StartOfString, Buffer.LengthInChars, CRYPT_STRING_BASE64, NULL, &BytesRequired, NULL, NULL)) {
-        Err = GetLastError();
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: failure to calculate buffer length in CryptStringToBinary: %s"), ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        YoriLibFreeStringContents(&Buffer);
-        return FALSE;
-    }
+    YoriLibBase64EncodeInitialize(&Context, YORI_LIB_BASE64_DEFAULT_LINE_LENGTH);
 
-    //
-    //  Allocate binary buffer
-    //
+    while (TRUE) {
+        if (!Base64Read(Base64Context, &BytesRead)) {
+            return FALSE;
+        }
 
-    BinaryBuffer = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesRequired);
-    if (BinaryBuffer == NULL) {
-        Err = GetLastError();
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: allocation failure: %s"), ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        YoriLibFreeStringContents(&Buffer);
+        if (BytesRead == 0) {
+            break;
+        }
+
+        if (!Base64EnsureWriteBuffer(Base64Context, YoriLibBase64EncodeGetBufferSize(&Context, (YORI_ALLOC_SIZE_T)BytesRead))) {
+            return FALSE;
+        }
+
+        CharsGenerated = YoriLibBase64EncodeUpdate(&Context, Base64Context->ReadBuffer, (YORI_ALLOC_SIZE_T)BytesRead, Base64Context->WriteBuffer);
+        if (!Base64WriteText(Base64Context, Base64Context->WriteBuffer, CharsGenerated)) {
+            return FALSE;
+        }
+
+        if (YoriLibIsOperationCancelled()) {
+            return FALSE;
+        }
+    }
+
+    if (!Base64EnsureWriteBuffer(Base64Context, YORI_LIB_BASE64_ENCODE_FINAL_SIZE)) {
         return FALSE;
     }
 
-    //
-    //  Perform the decode
-    //
+    CharsGenerated = YoriLibBase64EncodeFinalize(&Context, Base64Context->WriteBuffer);
+    return Base64WriteText(Base64Context, Base64Context->WriteBuffer, CharsGenerated);
+}
 
-    if (!DllCrypt32.pCryptStringToBinaryW(Buffer.StartOfString, Buffer.LengthInChars, CRYPT_STRING_BASE64, BinaryBuffer, &BytesRequired, &Skip, &Flags)) {
-        Err = GetLastError();
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: failure to encode in CryptBinaryToString: %s"), ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        YoriLibFreeStringContents(&Buffer);
-        YoriLibFree(BinaryBuffer);
-        return FALSE;
+/**
+ Convert UTF-16 data in the read buffer into single byte characters for the
+ base64 decoder, in place.  Base64 text consists entirely of ASCII, so any
+ other character is converted to a value the decoder will reject.  If a read
+ ends in the middle of a character, its first byte is retained in the
+ context and combined with the first byte of the next read.
+
+ @param Base64Context Pointer to the context.
+
+ @param BytesRead The number of bytes in the read buffer.
+
+ @return The number of single byte characters in the read buffer.
+ */
+YORI_ALLOC_SIZE_T
+Base64ConvertUtf16Input(
+    __inout PBASE64_CONTEXT Base64Context,
+    __in DWORD BytesRead
+    )
+{
+    PUCHAR Buffer;
+    DWORD Index;
+    YORI_ALLOC_SIZE_T CharsConverted;
+    WCHAR Char;
+
+    Buffer = Base64Context->ReadBuffer;
+    CharsConverted = 0;
+
+    for (Index = 0; Index < BytesRead; Index++) {
+        if (!Base64Context->HaveHalfChar) {
+            Base64Context->HalfChar = Buffer[Index];
+            Base64Context->HaveHalfChar = TRUE;
+            continue;
+        }
+
+        Char = (WCHAR)(Base64Context->HalfChar | (Buffer[Index] << 8));
+        Base64Context->HaveHalfChar = FALSE;
+
+        if (Char == 0xFEFF && !Base64Context->CharsConverted) {
+            Base64Context->CharsConverted = TRUE;
+            continue;
+        }
+        Base64Context->CharsConverted = TRUE;
+
+        if (Char < 0x80) {
+            Buffer[CharsConverted] = (UCHAR)Char;
+        } else {
+            Buffer[CharsConverted] = 0xFF;
+        }
+        CharsConverted++;
     }
 
-    //
-    //  We're done with the string form of the source, deallocate it.
-    //
+    return CharsConverted;
+}
 
-    YoriLibFreeStringContents(&Buffer);
+/**
+ Perform base64 decode and output to the requested device.  Data is decoded
+ and written as it is read, so only a single read buffer is held in memory
+ at any time.
 
-    //
-    //  Output the decoded form.
-    //
-    BytesSent = 0;
-    Result = TRUE;
-    hTarget = GetStdHandle(STD_OUTPUT_HANDLE);
-
-    while (BytesSent < BytesRequired) {
-        DWORD BytesToWrite;
-        DWORD BytesWritten;
-        BytesToWrite = 4096;
-        if (BytesSent + BytesToWrite > BytesRequired) {
-            BytesToWrite = BytesRequired - BytesSent;
+ @param Base64Context Pointer to the context.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+Base64Decode(
+    __inout PBASE64_CONTEXT Base64Context
+    )
+{
+    YORI_LIB_BASE64_DECODE_CONTEXT Context;
+    YORI_ALLOC_SIZE_T BytesGenerated;
+    YORI_ALLOC_SIZE_T CharsRead;
+    DWORD BytesRead;
+
+    YoriLibBase64DecodeInitialize(&Context);
+    Base64Context->Utf16Input = (BOOLEAN)(YoriLibGetMultibyteInputEncoding() == CP_UTF16);
+    Base64Context->HaveHalfChar = FALSE;
+    Base64Context->CharsConverted = FALSE;
+
+    while (TRUE) {
+        if (!Base64Read(Base64Context, &BytesRead)) {
+            return FALSE;
         }
 
-        if (WriteFile(hTarget,
-                      YoriLibAddToPointer(BinaryBuffer, BytesSent),
-                      BytesToWrite,
-                      &BytesWritten,
-                      NULL)) {
+        if (BytesRead == 0) {
+            break;
+        }
 
-            BytesSent += BytesWritten;
+        //
+        //  Base64 text is ASCII, which is the same in every supported
+        //  multibyte encoding, so only UTF-16 needs to be converted.
+        //
+
+        if (Base64Context->Utf16Input) {
+            CharsRead = Base64ConvertUtf16Input(Base64Context, BytesRead);
         } else {
-            Err = GetLastError();
-            ErrText = YoriLibGetWinErrorText(Err);
-            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: failure to write to output: %s"), ErrText);
-            YoriLibFreeWinErrorText(ErrText);
-            Result = FALSE;
+            CharsRead = (YORI_ALLOC_SIZE_T)BytesRead;
         }
 
-        ASSERT(BytesSent <= BytesRequired);
+        if (!Base64EnsureWriteBuffer(Base64Context, YoriLibBase64DecodeGetBufferSize(&Context, CharsRead))) {
+            return FALSE;
+        }
+
+        if (!YoriLibBase64DecodeUpdate(&Context, Base64Context->ReadBuffer, CharsRead, Base64Context->WriteBuffer, &BytesGenerated)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: invalid character at offset %lli\n"), Context.CharsProcessed);
+            return FALSE;
+        }
+
+        if (!Base64Write(Base64Context, Base64Context->WriteBuffer, BytesGenerated)) {
+            return FALSE;
+        }
+
+        if (YoriLibIsOperationCancelled()) {
+            return FALSE;
+        }
     }
-    YoriLibFree(BinaryBuffer);
 
-    return Result;
+    if (Base64Context->HaveHalfChar) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: input ended with an incomplete character\n"));
+        return FALSE;
+    }
+
+    if (!Base64EnsureWriteBuffer(Base64Context, YORI_LIB_BASE64_DECODE_FINAL_SIZE)) {
+        return FALSE;
+    }
+
+    if (!YoriLibBase64DecodeFinalize(&Context, Base64Context->WriteBuffer, &BytesGenerated)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: input ended with an incomplete quantum\n"));
+        return FALSE;
+    }
+
+    return Base64Write(Base64Context, Base64Context->WriteBuffer, BytesGenerated);
 }
 
 #ifdef YORI_BUILTIN
@@ -401,12 +551,13 @@ ENTRYPOINT(
     YORI_ALLOC_SIZE_T StartArg = 0;
     YORI_STRING Arg;
     BOOLEAN Decode = FALSE;
-    BASE64_BUFFER Base64Buffer;
+    BASE64_CONTEXT Base64Context;
+    BOOL Result;
     YORI_STRING FullFilePath;
     DWORD Err;
     LPTSTR ErrText;
 
-    ZeroMemory(&Base64Buffer, sizeof(Base64Buffer));
+    ZeroMemory(&Base64Context, sizeof(Base64Context));
     YoriLibInitEmptyString(&FullFilePath);
 
     for (i = 1; i < ArgC; i++) {
@@ -420,7 +571,7 @@ ENTRYPOINT(
                 Base64Help();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2023"));
+                YoriLibDisplayMitLicense(_T("2023-2026"));
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("d")) == 0) {
                 Decode = TRUE;
@@ -441,14 +592,6 @@ ENTRYPOINT(
         }
     }
 
-    YoriLibLoadCrypt32Functions();
-    if (DllCrypt32.pCryptBinaryToStringW == NULL ||
-        DllCrypt32.pCryptStringToBinaryW == NULL) {
-
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: operating system support not present\n"));
-        return EXIT_FAILURE;
-    }
-
 #if YORI_BUILTIN
     YoriLibCancelEnable(FALSE);
 #endif
@@ -459,7 +602,8 @@ ENTRYPOINT(
     //
 
     YoriLibInitEmptyString(&FullFilePath);
-    Base64Buffer.hSource = GetStdHandle(STD_INPUT_HANDLE);
+    Base64Context.hSource = GetStdHandle(STD_INPUT_HANDLE);
+    Base64Context.hTarget = GetStdHandle(STD_OUTPUT_HANDLE);
     if (StartArg == 0 || StartArg == ArgC) {
         if (YoriLibIsStdInConsole()) {
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: no file or pipe for input\n"));
@@ -474,8 +618,8 @@ ENTRYPOINT(
             return EXIT_FAILURE;
         }
 
-        Base64Buffer.hSource = CreateFile(FullFilePath.StartOfString, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-        if (Base64Buffer.hSource == INVALID_HANDLE_VALUE) {
+        Base64Context.hSource = CreateFile(FullFilePath.StartOfString, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (Base64Context.hSource == INVALID_HANDLE_VALUE) {
             Err = GetLastError();
             ErrText = YoriLibGetWinErrorText(Err);
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: opening file failed: %s"), ErrText);
@@ -485,52 +629,33 @@ ENTRYPOINT(
         }
     }
 
-    if (!Base64AllocateBuffer(&Base64Buffer)) {
+    if (!Base64AllocateBuffers(&Base64Context)) {
         Err = GetLastError();
         ErrText = YoriLibGetWinErrorText(Err);
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: allocating buffer failed: %s"), ErrText);
         YoriLibFreeWinErrorText(ErrText);
         if (FullFilePath.LengthInChars > 0) {
-            CloseHandle(Base64Buffer.hSource);
-        }
-        YoriLibFreeStringContents(&FullFilePath);
-        return EXIT_FAILURE;
-    }
-
-    if (!Base64BufferPump(&Base64Buffer)) {
-        if (FullFilePath.LengthInChars > 0) {
-            CloseHandle(Base64Buffer.hSource);
+            CloseHandle(Base64Context.hSource);
         }
         YoriLibFreeStringContents(&FullFilePath);
-        Base64FreeBuffer(&Base64Buffer);
         return EXIT_FAILURE;
     }
 
     if (!Decode) {
-        if (!Base64Encode(&Base64Buffer)) {
-            if (FullFilePath.LengthInChars > 0) {
-                CloseHandle(Base64Buffer.hSource);
-            }
-            YoriLibFreeStringContents(&FullFilePath);
-            Base64FreeBuffer(&Base64Buffer);
-            return EXIT_FAILURE;
-        }
+        Result = Base64Encode(&Base64Context);
     } else {
-        if (!Base64Decode(&Base64Buffer)) {
-            if (FullFilePath.LengthInChars > 0) {
-                CloseHandle(Base64Buffer.hSource);
-            }
-            YoriLibFreeStringContents(&FullFilePath);
-            Base64FreeBuffer(&Base64Buffer);
-            return EXIT_FAILURE;
-        }
+        Result = Base64Decode(&Base64Context);
     }
 
     if (FullFilePath.LengthInChars > 0) {
-        CloseHandle(Base64Buffer.hSource);
+        CloseHandle(Base64Context.hSource);
     }
     YoriLibFreeStringContents(&FullFilePath);
-    Base64FreeBuffer(&Base64Buffer);
+    Base64FreeBuffers(&Base64Context);
+
+    if (!Result) {
+        return EXIT_FAILURE;
+    }
 
     return EXIT_SUCCESS;
 }
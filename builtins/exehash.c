@@ -0,0 +1,128 @@
+/**
+ * @file builtins/exehash.c
+ *
+ * Yori shell display or reset the executable lookup cache
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include <yoricall.h>
+
+/**
+ Help text to display to the user.
+ */
+const
+CHAR strExeHashHelpText[] =
+        "\n"
+        "Displays or resets the cache of executables found in PATH.\n"
+        "\n"
+        "EXEHASH [-license] [-r]\n"
+        "\n"
+        "   -r             Discard all cached executable locations\n";
+
+/**
+ Display usage text to the user.
+ */
+BOOL
+ExeHashHelp(VOID)
+{
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("ExeHash %i.%02i\n"), YORI_VER_MAJOR, YORI_VER_MINOR);
+#if YORI_BUILD_ID
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  Build %i\n"), YORI_BUILD_ID);
+#endif
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%hs"), strExeHashHelpText);
+    return TRUE;
+}
+
+/**
+ Display or reset the executable lookup cache.
+
+ @param ArgC The number of arguments.
+
+ @param ArgV The argument array.
+
+ @return ExitCode, zero for success, nonzero for failure.
+ */
+DWORD
+YORI_BUILTIN_FN
+YoriCmd_EXEHASH(
+    __in YORI_ALLOC_SIZE_T ArgC,
+    __in YORI_STRING ArgV[]
+    )
+{
+    BOOL ArgumentUnderstood;
+    BOOL Reset = FALSE;
+    YORI_ALLOC_SIZE_T i;
+    YORI_STRING Arg;
+    YORI_STRING CacheStrings;
+    LPTSTR ThisVar;
+    YORI_ALLOC_SIZE_T VarLen;
+
+    for (i = 1; i < ArgC; i++) {
+
+        ArgumentUnderstood = FALSE;
+        ASSERT(YoriLibIsStringNullTerminated(&ArgV[i]));
+
+        if (YoriLibIsCommandLineOption(&ArgV[i], &Arg)) {
+
+            if (YoriLibCompareStringLitIns(&Arg, _T("?")) == 0) {
+                ExeHashHelp();
+                return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
+                YoriLibDisplayMitLicense(_T("2026"));
+                return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("r")) == 0) {
+                Reset = TRUE;
+                ArgumentUnderstood = TRUE;
+            }
+        }
+
+        if (!ArgumentUnderstood) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Argument not understood, ignored: %y\n"), &ArgV[i]);
+        }
+    }
+
+    if (Reset) {
+        if (!YoriCallClearExecutableCache()) {
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    if (!YoriCallGetExecutableCacheStrings(&CacheStrings)) {
+        return EXIT_FAILURE;
+    }
+
+    ThisVar = CacheStrings.StartOfString;
+    while (*ThisVar != '\0') {
+        VarLen = (YORI_ALLOC_SIZE_T)_tcslen(ThisVar);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%s\n"), ThisVar);
+        ThisVar += VarLen;
+        ThisVar++;
+    }
+    YoriCallFreeYoriString(&CacheStrings);
+
+    return EXIT_SUCCESS;
+}
+
+// vim:sw=4:ts=4:et:
@@ -3,7 +3,7 @@
  *
  * Yori shell script interpreter
  *
- * Copyright (c) 2017-2020 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -224,6 +224,30 @@ typedef struct _YS_SCRIPT_LINE {
      */
     YORI_STRING LineContents;
 
+    /**
+     If the line is a label, the entry for the label within the script's
+     label hash table.
+     */
+    YORI_OPEN_HASH_ENTRY LabelEntry;
+
+    /**
+     TRUE if the line is a label.
+     */
+    BOOLEAN IsLabel;
+
+    /**
+     TRUE if LabelEntry is currently inserted into the label hash table.
+     A label is not inserted if an earlier line defines the same label.
+     */
+    BOOLEAN LabelInserted;
+
+    /**
+     TRUE if the line contains a script variable delimiter, so it needs to
+     be expanded before each execution.  FALSE if the line can be executed
+     as it is.
+     */
+    BOOLEAN HasVariables;
+
 } YS_SCRIPT_LINE, *PYS_SCRIPT_LINE;
 
 /**
@@ -271,6 +295,51 @@ typedef struct _YS_SCRIPT {
      */
     YORI_LIST_ENTRY LineLinks;
 
+    /**
+     The entry for this script within the list of cached scripts.  Only
+     meaningful if Cached is TRUE.
+     */
+    YORI_LIST_ENTRY CacheLinks;
+
+    /**
+     A hash table of labels within the script, so that goto and call can
+     find a label without scanning every line.
+     */
+    PYORI_OPEN_HASH_TABLE Labels;
+
+    /**
+     The last write time of the script file when it was loaded.  This is
+     used to determine whether a cached script is still current.
+     */
+    LARGE_INTEGER LastWriteTime;
+
+    /**
+     The size of the script file when it was loaded.
+     */
+    LARGE_INTEGER FileSize;
+
+    /**
+     TRUE if LastWriteTime and FileSize were obtained, so the script can be
+     cached.
+     */
+    BOOLEAN Cacheable;
+
+    /**
+     TRUE if the script is in the list of cached scripts.
+     */
+    BOOLEAN Cached;
+
+    /**
+     TRUE if the script is currently executing.
+     */
+    BOOLEAN InUse;
+
+    /**
+     TRUE if the lines in the script have been changed by executing it, so
+     it no longer reflects the contents of the file.
+     */
+    BOOLEAN Modified;
+
     /**
      A linked list of call context information.
      */
@@ -301,12 +370,36 @@ typedef struct _YS_SCRIPT {
 
 } YS_SCRIPT, *PYS_SCRIPT;
 
+/**
+ The number of labels a script's label hash table is initially sized for.
+ The table grows as needed for scripts containing more labels.
+ */
+#define YS_EXPECTED_LABELS (64)
+
 /**
  Pointer to the active script.  This can be changed by executing a script
  within a script.
  */
 PYS_SCRIPT YsActiveScript = NULL;
 
+/**
+ The maximum number of scripts to retain in memory after they have finished
+ executing.
+ */
+#define YS_MAX_CACHED_SCRIPTS (16)
+
+/**
+ A list of scripts which have been loaded and executed, so that scripts
+ which are executed repeatedly do not need to be loaded again.  The most
+ recently used script is at the head of the list.
+ */
+YORI_LIST_ENTRY YsCachedScripts;
+
+/**
+ The number of scripts in YsCachedScripts.
+ */
+DWORD YsCachedScriptCount;
+
 /**
  Advance execution to the end of the script.  This causes script processing
  to end, but ensures that it ends organically and all cleanup is performed.
@@ -339,8 +432,8 @@ YsGotoLabel(
     __in LPTSTR Label
     )
 {
-    PYORI_LIST_ENTRY ListEntry;
-    PYS_SCRIPT_LINE Line;
+    PYORI_OPEN_HASH_ENTRY HashEntry;
+    YORI_STRING LabelString;
 
     //
     //  First special case :eof for no good reason other than CMD does.
@@ -355,29 +448,11 @@ YsGotoLabel(
     //  Now look for user defined labels within the script.
     //
 
-    ListEntry = YoriLibGetNextListEntry(&YsActiveScript->LineLinks, NULL);
-    while (ListEntry != NULL) {
-        Line = CONTAINING_RECORD(ListEntry, YS_SCRIPT_LINE, LineLinks);
-        if (Line->LineContents.LengthInChars > 1 &&
-            Line->LineContents.StartOfString[0] == ':') {
-
-            YORI_STRING LabelString;
-
-            YoriLibInitEmptyString(&LabelString);
-            LabelString.StartOfString = &Line->LineContents.StartOfString[1];
-            LabelString.LengthInChars = Line->LineContents.LengthInChars - 1;
-
-            if (LabelString.LengthInChars >= 1 &&
-                LabelString.StartOfString[LabelString.LengthInChars - 1] == '\0') {
-                LabelString.LengthInChars--;
-            }
-
-            if (YoriLibCompareStringLitIns(&LabelString, Label) == 0) {
-                YsActiveScript->ActiveLine = Line;
-                return TRUE;
-            }
-        }
-        ListEntry = YoriLibGetNextListEntry(&YsActiveScript->LineLinks, ListEntry);
+    YoriLibConstantString(&LabelString, Label);
+    HashEntry = YoriLibOpenHashLookupByKey(YsActiveScript->Labels, &LabelString);
+    if (HashEntry != NULL) {
+        YsActiveScript->ActiveLine = HashEntry->Context;
+        return TRUE;
     }
 
     return FALSE;
@@ -402,6 +477,112 @@ YsFreeCallStack(
     YoriLibFree(StackLocation);
 }
 
+/**
+ Determine the characteristics of a line that can be calculated once when
+ the line is loaded, so they do not need to be recalculated each time the
+ line is executed.
+
+ @param Line Pointer to the line to analyze.
+ */
+VOID
+YsAnalyzeLine(
+    __inout PYS_SCRIPT_LINE Line
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    Line->IsLabel = FALSE;
+    Line->LabelInserted = FALSE;
+    Line->HasVariables = FALSE;
+
+    if (Line->LineContents.LengthInChars > 1 &&
+        Line->LineContents.StartOfString[0] == ':') {
+
+        Line->IsLabel = TRUE;
+        return;
+    }
+
+    for (Index = 0; Index < Line->LineContents.LengthInChars; Index++) {
+        if (Line->LineContents.StartOfString[Index] == '%') {
+            Line->HasVariables = TRUE;
+            break;
+        }
+    }
+}
+
+/**
+ Remove all labels in a script from the script's label hash table.
+
+ @param Script Pointer to the script.
+ */
+VOID
+YsRemoveLabels(
+    __in PYS_SCRIPT Script
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYS_SCRIPT_LINE Line;
+
+    ListEntry = YoriLibGetNextListEntry(&Script->LineLinks, NULL);
+    while (ListEntry != NULL) {
+        Line = CONTAINING_RECORD(ListEntry, YS_SCRIPT_LINE, LineLinks);
+        if (Line->LabelInserted) {
+            YoriLibOpenHashRemoveByEntry(Script->Labels, &Line->LabelEntry);
+            Line->LabelInserted = FALSE;
+        }
+        ListEntry = YoriLibGetNextListEntry(&Script->LineLinks, ListEntry);
+    }
+}
+
+/**
+ Populate the label hash table for a script from the lines within it.  If a
+ label is defined more than once, the first definition is used.
+
+ @param Script Pointer to the script.
+
+ @return TRUE to indicate success, FALSE if memory could not be allocated to
+         index every label.
+ */
+__success(return)
+BOOL
+YsIndexLabels(
+    __in PYS_SCRIPT Script
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYS_SCRIPT_LINE Line;
+    YORI_STRING LabelString;
+
+    YsRemoveLabels(Script);
+
+    ListEntry = YoriLibGetNextListEntry(&Script->LineLinks, NULL);
+    while (ListEntry != NULL) {
+        Line = CONTAINING_RECORD(ListEntry, YS_SCRIPT_LINE, LineLinks);
+        if (Line->IsLabel) {
+
+            YoriLibInitEmptyString(&LabelString);
+            LabelString.MemoryToFree = Line->LineContents.MemoryToFree;
+            LabelString.StartOfString = &Line->LineContents.StartOfString[1];
+            LabelString.LengthInChars = Line->LineContents.LengthInChars - 1;
+
+            if (LabelString.LengthInChars >= 1 &&
+                LabelString.StartOfString[LabelString.LengthInChars - 1] == '\0') {
+                LabelString.LengthInChars--;
+            }
+
+            if (YoriLibOpenHashLookupByKey(Script->Labels, &LabelString) == NULL) {
+                if (!YoriLibOpenHashInsertByKey(Script->Labels, &LabelString, Line, &Line->LabelEntry)) {
+                    return FALSE;
+                }
+                Line->LabelInserted = TRUE;
+            }
+        }
+        ListEntry = YoriLibGetNextListEntry(&Script->LineLinks, ListEntry);
+    }
+
+    return TRUE;
+}
+
 /**
  Load script lines from an input stream into a linked list of lines.
 
@@ -446,6 +627,8 @@ YsLoadLines(
         ASSERT(ThisLine->LineContents.StartOfString[ThisLine->LineContents.LengthInChars] == '\0');
         ThisLine->LineContents.LengthInChars++;
 
+        YsAnalyzeLine(ThisLine);
+
         YoriLibInsertList(InsertPoint, &ThisLine->LineLinks);
         InsertPoint = &ThisLine->LineLinks;
     }
@@ -906,12 +1089,23 @@ YoriCmd_INCLUDE(
 
     YoriLibFreeStringContents(&FileName);
 
+    //
+    //  The script no longer matches the file it was loaded from, so it
+    //  should not be cached.  Any labels within the included lines need to
+    //  be indexed.
+    //
+
+    YsActiveScript->Modified = TRUE;
     if (!YsLoadLines(FileHandle, &YsActiveScript->ActiveLine->LineLinks)) {
+        YsIndexLabels(YsActiveScript);
         CloseHandle(FileHandle);
         return EXIT_FAILURE;
     }
 
     CloseHandle(FileHandle);
+    if (!YsIndexLabels(YsActiveScript)) {
+        return EXIT_FAILURE;
+    }
 
     return EXIT_SUCCESS;
 }
@@ -1093,6 +1287,7 @@ YsExecuteScript(
     )
 {
     YORI_STRING LineWithArgumentsExpanded;
+    YORI_STRING LineToExecute;
     YORI_STRING CommandName;
     DWORD Index;
     PYORI_LIST_ENTRY NextEntry;
@@ -1121,28 +1316,46 @@ YsExecuteScript(
         Script->ActiveLine = CurrentLine;
 
         if (CurrentLine->LineContents.LengthInChars > 1 &&
-            CurrentLine->LineContents.StartOfString[0] != ':') {
+            !CurrentLine->IsLabel) {
 
-            if (!YoriLibExpandCommandVariables(&CurrentLine->LineContents, '%', TRUE, YsExpandArgumentVariables, Script->ArgContext, &LineWithArgumentsExpanded)) {
-                break;
-            }
+            YoriLibInitEmptyString(&LineToExecute);
 
-            //
-            //  Lines are intentionally left with NULLs inside the string, so
-            //  we'd normally truncate these here.  When an incomplete command
-            //  expansion is used though, the NULL ends up in the variable name
-            //  so it can get truncated.  YoriLibExpandCommandVariables
-            //  also adds one, but it's not within the string, so check which
-            //  case we're in.
-            //
+            if (CurrentLine->HasVariables) {
+                if (!YoriLibExpandCommandVariables(&CurrentLine->LineContents, '%', TRUE, YsExpandArgumentVariables, Script->ArgContext, &LineWithArgumentsExpanded)) {
+                    break;
+                }
+
+                //
+                //  Lines are intentionally left with NULLs inside the string, so
+                //  we'd normally truncate these here.  When an incomplete command
+                //  expansion is used though, the NULL ends up in the variable name
+                //  so it can get truncated.  YoriLibExpandCommandVariables
+                //  also adds one, but it's not within the string, so check which
+                //  case we're in.
+                //
+
+                if (LineWithArgumentsExpanded.LengthInChars > 0 &&
+                    LineWithArgumentsExpanded.StartOfString[LineWithArgumentsExpanded.LengthInChars - 1] == '\0') {
+                    LineWithArgumentsExpanded.LengthInChars--;
+                }
 
-            if (LineWithArgumentsExpanded.LengthInChars > 0 &&
-                LineWithArgumentsExpanded.StartOfString[LineWithArgumentsExpanded.LengthInChars - 1] == '\0') {
-                LineWithArgumentsExpanded.LengthInChars--;
+                LineToExecute.StartOfString = LineWithArgumentsExpanded.StartOfString;
+                LineToExecute.LengthInChars = LineWithArgumentsExpanded.LengthInChars;
+                LineToExecute.LengthAllocated = LineWithArgumentsExpanded.LengthAllocated;
+            } else {
+
+                //
+                //  A line without variables is executed as it was loaded,
+                //  without the NULL that is included in the line.
+                //
+
+                LineToExecute.StartOfString = CurrentLine->LineContents.StartOfString;
+                LineToExecute.LengthInChars = CurrentLine->LineContents.LengthInChars - 1;
+                LineToExecute.LengthAllocated = CurrentLine->LineContents.LengthInChars;
             }
-            ASSERT(LineWithArgumentsExpanded.StartOfString[LineWithArgumentsExpanded.LengthInChars] == '\0');
+            ASSERT(LineToExecute.StartOfString[LineToExecute.LengthInChars] == '\0');
 
-            YoriCallExecuteExpression(&LineWithArgumentsExpanded);
+            YoriCallExecuteExpression(&LineToExecute);
             ASSERT(YsActiveScript == Script);
 
             if (YoriCallIsProcessExiting()) {
@@ -1167,7 +1380,33 @@ YsExecuteScript(
 }
 
 /**
- Deallocate any structures used to record a script in memory.
+ Deallocate any call stack entries remaining within a script.  This occurs
+ if a script calls a label and reaches the end of the script without
+ returning.
+
+ @param Script The script to deallocate call stack entries from.
+ */
+VOID
+YsFreeScriptCallStack(
+    __in PYS_SCRIPT Script
+    )
+{
+    PYS_CALL_STACK StackLocation;
+    PYORI_LIST_ENTRY NextEntry;
+
+    NextEntry = YoriLibGetNextListEntry(&Script->CallStackLinks, NULL);
+    while(NextEntry != NULL) {
+        StackLocation = CONTAINING_RECORD(NextEntry, YS_CALL_STACK, StackLinks);
+        NextEntry = YoriLibGetNextListEntry(&Script->CallStackLinks, NextEntry);
+
+        YoriLibRemoveListItem(&StackLocation->StackLinks);
+        YsFreeCallStack(StackLocation);
+    }
+}
+
+/**
+ Deallocate any structures used to record a script in memory, and the
+ script itself.
 
  @param Script The in memory script and state to deallocate.
  */
@@ -1177,9 +1416,14 @@ YsFreeScript(
     )
 {
     PYS_SCRIPT_LINE CurrentLine;
-    PYS_CALL_STACK StackLocation;
     PYORI_LIST_ENTRY NextEntry;
-    BOOL CallStackFound;
+
+    ASSERT(!Script->Cached && !Script->InUse);
+
+    if (Script->Labels != NULL) {
+        YsRemoveLabels(Script);
+        YoriLibFreeEmptyOpenHashTable(Script->Labels);
+    }
 
     NextEntry = YoriLibGetNextListEntry(&Script->LineLinks, NULL);
     while(NextEntry != NULL) {
@@ -1190,18 +1434,10 @@ YsFreeScript(
         YoriLibFree(CurrentLine);
     }
 
-    CallStackFound = FALSE;
-
-    NextEntry = YoriLibGetNextListEntry(&Script->CallStackLinks, NULL);
-    while(NextEntry != NULL) {
-        StackLocation = CONTAINING_RECORD(NextEntry, YS_CALL_STACK, StackLinks);
-        NextEntry = YoriLibGetNextListEntry(&Script->CallStackLinks, NextEntry);
-
-        YsFreeCallStack(StackLocation);
-        CallStackFound = TRUE;
-    }
+    YsFreeScriptCallStack(Script);
 
     YoriLibFreeStringContents(&Script->FileName);
+    YoriLibFree(Script);
 }
 
 
@@ -1210,30 +1446,236 @@ YsFreeScript(
 
  @param Handle The handle to the stream that contains the script.
 
- @param Script On successful completion, populated with the contents of the
-        script.
+ @param FileName Pointer to the fully qualified name of the script.  On
+        success, the script takes ownership of this string.
 
- @return TRUE to indicate success, FALSE to indicate failure.
+ @return Pointer to the loaded script, or NULL on failure.
  */
-BOOL
+PYS_SCRIPT
 YsLoadScript(
     __in HANDLE Handle,
-    __out PYS_SCRIPT Script
+    __in PYORI_STRING FileName
     )
 {
-    BOOL Result = TRUE;
+    PYS_SCRIPT Script;
+    BY_HANDLE_FILE_INFORMATION FileInfo;
 
+    Script = YoriLibMalloc(sizeof(YS_SCRIPT));
+    if (Script == NULL) {
+        return NULL;
+    }
+
+    ZeroMemory(Script, sizeof(YS_SCRIPT));
     YoriLibInitializeListHead(&Script->LineLinks);
     YoriLibInitializeListHead(&Script->CallStackLinks);
+    YoriLibInitEmptyString(&Script->FileName);
+
+    //
+    //  Record the state of the file before reading it, so that if it
+    //  changes while being read, the change will be detected before the
+    //  cached script is used.
+    //
+
+    if (GetFileInformationByHandle(Handle, &FileInfo)) {
+        Script->LastWriteTime.LowPart = FileInfo.ftLastWriteTime.dwLowDateTime;
+        Script->LastWriteTime.HighPart = FileInfo.ftLastWriteTime.dwHighDateTime;
+        Script->FileSize.LowPart = FileInfo.nFileSizeLow;
+        Script->FileSize.HighPart = FileInfo.nFileSizeHigh;
+        Script->Cacheable = TRUE;
+    }
+
+    Script->Labels = YoriLibAllocateOpenHashTable(YS_EXPECTED_LABELS);
+    if (Script->Labels == NULL) {
+        YsFreeScript(Script);
+        return NULL;
+    }
 
     if (!YsLoadLines(Handle, &Script->LineLinks)) {
-        Result = FALSE;
+        YsFreeScript(Script);
+        return NULL;
     }
 
-    if (Result == FALSE) {
+    if (!YsIndexLabels(Script)) {
         YsFreeScript(Script);
+        return NULL;
     }
-    return Result;
+
+    memcpy(&Script->FileName, FileName, sizeof(YORI_STRING));
+    return Script;
+}
+
+/**
+ Remove a script from the list of cached scripts.
+
+ @param Script Pointer to the script to remove.
+ */
+VOID
+YsRemoveCachedScript(
+    __in PYS_SCRIPT Script
+    )
+{
+    ASSERT(Script->Cached);
+    YoriLibRemoveListItem(&Script->CacheLinks);
+    Script->Cached = FALSE;
+    YsCachedScriptCount--;
+}
+
+/**
+ Look for a previously loaded script which matches the specified file.  If
+ the file has changed since it was loaded, the stale script is discarded.
+
+ @param FileName Pointer to the fully qualified name of the script.
+
+ @param Handle An opened handle to the script file.
+
+ @return Pointer to a script which can be executed, or NULL if no current
+         script is cached.
+ */
+PYS_SCRIPT
+YsFindCachedScript(
+    __in PYORI_STRING FileName,
+    __in HANDLE Handle
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYS_SCRIPT Script;
+    BY_HANDLE_FILE_INFORMATION FileInfo;
+
+    if (YsCachedScripts.Next == NULL) {
+        YoriLibInitializeListHead(&YsCachedScripts);
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&YsCachedScripts, NULL);
+    while (ListEntry != NULL) {
+        Script = CONTAINING_RECORD(ListEntry, YS_SCRIPT, CacheLinks);
+        if (YoriLibCompareStringIns(&Script->FileName, FileName) == 0) {
+            break;
+        }
+        ListEntry = YoriLibGetNextListEntry(&YsCachedScripts, ListEntry);
+    }
+
+    if (ListEntry == NULL) {
+        return NULL;
+    }
+
+    //
+    //  If the script is executing recursively, it needs to be loaded again
+    //  so each instance has its own state.
+    //
+
+    Script = CONTAINING_RECORD(ListEntry, YS_SCRIPT, CacheLinks);
+    if (Script->InUse) {
+        return NULL;
+    }
+
+    if (!GetFileInformationByHandle(Handle, &FileInfo) ||
+        Script->LastWriteTime.LowPart != FileInfo.ftLastWriteTime.dwLowDateTime ||
+        (DWORD)Script->LastWriteTime.HighPart != FileInfo.ftLastWriteTime.dwHighDateTime ||
+        Script->FileSize.LowPart != FileInfo.nFileSizeLow ||
+        (DWORD)Script->FileSize.HighPart != FileInfo.nFileSizeHigh) {
+
+        YsRemoveCachedScript(Script);
+        YsFreeScript(Script);
+        return NULL;
+    }
+
+    //
+    //  Move the script to the head of the list, since it is now the most
+    //  recently used.
+    //
+
+    YoriLibRemoveListItem(&Script->CacheLinks);
+    YoriLibInsertList(&YsCachedScripts, &Script->CacheLinks);
+    return Script;
+}
+
+/**
+ Indicate that a script has finished executing.  If it can be executed again
+ it is retained in the list of cached scripts, otherwise it is freed.
+
+ @param Script Pointer to the script.
+ */
+VOID
+YsReleaseScript(
+    __in PYS_SCRIPT Script
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYS_SCRIPT CachedScript;
+
+    YsFreeScriptCallStack(Script);
+
+    if (Script->Cached) {
+        if (Script->Modified) {
+            YsRemoveCachedScript(Script);
+            YsFreeScript(Script);
+        }
+        return;
+    }
+
+    if (!Script->Cacheable || Script->Modified) {
+        YsFreeScript(Script);
+        return;
+    }
+
+    //
+    //  If another copy of this script is cached, it is executing
+    //  recursively and this copy is not needed.
+    //
+
+    ListEntry = YoriLibGetNextListEntry(&YsCachedScripts, NULL);
+    while (ListEntry != NULL) {
+        CachedScript = CONTAINING_RECORD(ListEntry, YS_SCRIPT, CacheLinks);
+        if (YoriLibCompareStringIns(&CachedScript->FileName, &Script->FileName) == 0) {
+            YsFreeScript(Script);
+            return;
+        }
+        ListEntry = YoriLibGetNextListEntry(&YsCachedScripts, ListEntry);
+    }
+
+    YoriLibInsertList(&YsCachedScripts, &Script->CacheLinks);
+    Script->Cached = TRUE;
+    YsCachedScriptCount++;
+
+    //
+    //  If too many scripts are cached, discard the least recently used
+    //  script that is not executing.
+    //
+
+    ListEntry = YoriLibGetPreviousListEntry(&YsCachedScripts, NULL);
+    while (YsCachedScriptCount > YS_MAX_CACHED_SCRIPTS && ListEntry != NULL) {
+        CachedScript = CONTAINING_RECORD(ListEntry, YS_SCRIPT, CacheLinks);
+        ListEntry = YoriLibGetPreviousListEntry(&YsCachedScripts, ListEntry);
+        if (!CachedScript->InUse) {
+            YsRemoveCachedScript(CachedScript);
+            YsFreeScript(CachedScript);
+        }
+    }
+}
+
+/**
+ Notification that the module is being unloaded or the shell is exiting,
+ used to free any cached scripts.
+ */
+VOID
+YORI_BUILTIN_FN
+YsNotifyUnload(VOID)
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYS_SCRIPT Script;
+
+    if (YsCachedScripts.Next != NULL) {
+        ListEntry = YoriLibGetNextListEntry(&YsCachedScripts, NULL);
+        while (ListEntry != NULL) {
+            Script = CONTAINING_RECORD(ListEntry, YS_SCRIPT, CacheLinks);
+            ListEntry = YoriLibGetNextListEntry(&YsCachedScripts, ListEntry);
+            ASSERT(!Script->InUse);
+            YsRemoveCachedScript(Script);
+            YsFreeScript(Script);
+        }
+    }
+
+    YoriLibLineReadCleanupCache();
 }
 
 /**
@@ -1257,7 +1699,7 @@ YoriCmd_YS(
     YORI_STRING FileName;
     YORI_ALLOC_SIZE_T i;
     YORI_ALLOC_SIZE_T StartArg = 0;
-    YS_SCRIPT Script;
+    PYS_SCRIPT Script;
     YORI_STRING Arg;
 
     YoriLibLoadNtDllFunctions();
@@ -1274,7 +1716,7 @@ YoriCmd_YS(
                 YsHelp();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2017-2018"));
+                YoriLibDisplayMitLicense(_T("2017-2026"));
                 return EXIT_SUCCESS;
             }
         } else {
@@ -1315,34 +1757,46 @@ YoriCmd_YS(
         return EXIT_FAILURE;
     }
 
-    if (!YoriCallSetUnloadRoutine(YoriLibLineReadCleanupCache)) {
+    if (!YoriCallSetUnloadRoutine(YsNotifyUnload)) {
         YoriLibFreeStringContents(&FileName);
         CloseHandle(FileHandle);
         return EXIT_FAILURE;
     }
 
-    if (!YsLoadScript(FileHandle, &Script)) {
+    //
+    //  If this script has been executed before and has not changed, use
+    //  the previously loaded copy.  Otherwise load it.
+    //
+
+    Script = YsFindCachedScript(&FileName, FileHandle);
+    if (Script != NULL) {
         YoriLibFreeStringContents(&FileName);
-        CloseHandle(FileHandle);
-        return EXIT_FAILURE;
+    } else {
+        Script = YsLoadScript(FileHandle, &FileName);
+        if (Script == NULL) {
+            YoriLibFreeStringContents(&FileName);
+            CloseHandle(FileHandle);
+            return EXIT_FAILURE;
+        }
     }
 
-    memcpy(&Script.FileName, &FileName, sizeof(YORI_STRING));
-
     CloseHandle(FileHandle);
 
-    Script.GlobalArgContext.ShiftCount = StartArg;
-    Script.GlobalArgContext.ArgC = ArgC;
-    Script.GlobalArgContext.ArgV = ArgV;
+    Script->GlobalArgContext.ShiftCount = StartArg;
+    Script->GlobalArgContext.ArgC = ArgC;
+    Script->GlobalArgContext.ArgV = ArgV;
 
-    Script.ArgContext = &Script.GlobalArgContext;
+    Script->ArgContext = &Script->GlobalArgContext;
 
-    if (!YsExecuteScript(&Script)) {
-        YsFreeScript(&Script);
+    Script->InUse = TRUE;
+    if (!YsExecuteScript(Script)) {
+        Script->InUse = FALSE;
+        YsReleaseScript(Script);
         return EXIT_FAILURE;
     }
+    Script->InUse = FALSE;
 
-    YsFreeScript(&Script);
+    YsReleaseScript(Script);
 
     return YoriCallGetErrorLevel();
 }
@@ -3,7 +3,7 @@
  *
  * Yori shell copy files
  *
- * Copyright (c) 2017-2022 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -35,22 +35,23 @@ CHAR strCopyHelpText[] =
         "\n"
         "Copies one or more files.\n"
         "\n"
-        "COPY [-license] [-b] [-c:algorithm] [-ds size] [-l] [-n|-nt|-p] [-s] [-t] [-v]\n"
-        "      [-x exclude] <src>\n"
-        "COPY [-license] [-b] [-c:algorithm] [-ds size] [-l] [-n|-nt|-p] [-s] [-t] [-v]\n"
-        "      [-x exclude] <src> [<src> ...] <dest>\n"
+        "COPY [-license] [-b] [-c:algorithm] [-ds size] [-j n] [-l] [-n|-nt|-p] [-s]\n"
+        "      [-t] [-v] [-x exclude] <src>\n"
+        "COPY [-license] [-b] [-c:algorithm] [-ds size] [-j n] [-l] [-n|-nt|-p] [-s]\n"
+        "      [-t] [-v] [-x exclude] <src> [<src> ...] <dest>\n"
         "\n"
         "   -b             Use basic search criteria for files only\n"
         "   -c             Compress targets with specified algorithm.  Options are:\n"
         "                    lzx, ntfs, xp4k, xp8k, xp16k\n"
         "   -ds            The size of the device, ignored for files\n"
+        "   -j             The number of files to copy concurrently\n"
         "   -l             Copy links as links rather than contents\n"
         "   -n             Copy new or files whose size have changed only\n"
         "   -nt            Copy new or files whose size or timestamps have changed only\n"
         "   -p             Preserve existing files, no overwriting\n"
         "   -s             Copy subdirectories as well as files\n"
         "   -t             Copy timestamps only, no data\n"
-        "   -v             Verbose output\n"
+        "   -v             Verbose output, including a summary of data copied\n"
         "   -x             Exclude files matching specified pattern\n";
 
 /**
@@ -84,6 +85,38 @@ typedef struct _COPY_EXCLUDE_ITEM {
     YORI_STRING ExcludeCriteria;
 } COPY_EXCLUDE_ITEM, *PCOPY_EXCLUDE_ITEM;
 
+/**
+ A file waiting to be copied by a worker thread.
+ */
+typedef struct _COPY_PENDING_FILE {
+
+    /**
+     The list of files waiting to be copied.
+     */
+    YORI_LIST_ENTRY PendingList;
+
+    /**
+     Fully qualified path to the source file.
+     */
+    YORI_STRING SourceFile;
+
+    /**
+     Fully qualified path to the destination file.
+     */
+    YORI_STRING DestFile;
+
+    /**
+     Information about the source file from enumeration.  This is only
+     meaningful if FileInfoPresent is TRUE.
+     */
+    WIN32_FIND_DATA FileInfo;
+
+    /**
+     TRUE if the source was found from enumeration and FileInfo is valid.
+     */
+    BOOLEAN FileInfoPresent;
+} COPY_PENDING_FILE, *PCOPY_PENDING_FILE;
+
 /**
  A context passed between each source file match when copying multiple
  files.
@@ -104,12 +137,72 @@ typedef struct _COPY_CONTEXT {
      */
     YORILIB_COMPRESS_CONTEXT CompressContext;
 
+    /**
+     The list of files waiting to be copied by worker threads.
+     */
+    YORI_LIST_ENTRY PendingList;
+
+    /**
+     A mutex to synchronize the list of files waiting to be copied and the
+     totals of data copied.
+     */
+    HANDLE Mutex;
+
+    /**
+     An event signalled when a file is inserted into the list.  Worker
+     threads wait on this and the following event together.
+     */
+    HANDLE WorkerWaitEvent;
+
+    /**
+     An event signalled when worker threads should complete outstanding work
+     then terminate.
+     */
+    HANDLE WorkerShutdownEvent;
+
+    /**
+     An array of handles to threads copying files.
+     */
+    PHANDLE Threads;
+
     /**
      The number of bytes to copy when copying to or from a device.  Zero
      means copy until the end of the device.
      */
     LARGE_INTEGER DeviceSize;
 
+    /**
+     The system time when copying started.
+     */
+    LONGLONG StartTime;
+
+    /**
+     The number of bytes of file data that have been copied.
+     */
+    LONGLONG BytesCopied;
+
+    /**
+     The number of files whose data has been copied.
+     */
+    DWORD FilesDataCopied;
+
+    /**
+     The maximum number of files to copy concurrently.  This corresponds to
+     the size of the Threads array.
+     */
+    DWORD MaxThreads;
+
+    /**
+     The number of threads allocated to copy files.  This is less than or
+     equal to MaxThreads.
+     */
+    DWORD ThreadsAllocated;
+
+    /**
+     The number of files currently queued in the list.
+     */
+    DWORD ItemsQueued;
+
     /**
      The file system attributes of the destination.  Used to determine if
      the destination exists and is a directory.
@@ -553,12 +646,141 @@ CopyAsLink(
     return TRUE;
 }
 
+/**
+ The size of each buffer used when copying to or from a device.
+ */
+#define COPY_DEVICE_BUFFER_SIZE (64 * 1024)
+
+/**
+ The size of each buffer used when copying to or from a device when the
+ amount of data is large or unknown.
+ */
+#define COPY_DEVICE_LARGE_BUFFER_SIZE (1024 * 1024)
+
+/**
+ Start reading from a source opened for overlapped IO.
+
+ @param SourceHandle Handle to the source.
+
+ @param Buffer Pointer to the buffer to read into.
+
+ @param BufferSize The number of bytes to read.
+
+ @param Offset The offset within the source to read from.  This is ignored
+        by devices which do not support seeking.
+
+ @param Overlapped Pointer to the overlapped structure to use for the read.
+        The caller should initialize hEvent, which is preserved.
+
+ @return ERROR_SUCCESS to indicate the read was started, ERROR_HANDLE_EOF to
+         indicate there is no more data, or another error code to indicate
+         failure.
+ */
+SYSERR
+CopyStartRead(
+    __in HANDLE SourceHandle,
+    __out_bcount(BufferSize) PVOID Buffer,
+    __in DWORD BufferSize,
+    __in LONGLONG Offset,
+    __inout LPOVERLAPPED Overlapped
+    )
+{
+    HANDLE Event;
+    SYSERR LastError;
+
+    Event = Overlapped->hEvent;
+    ZeroMemory(Overlapped, sizeof(OVERLAPPED));
+    Overlapped->hEvent = Event;
+    Overlapped->Offset = (DWORD)Offset;
+    Overlapped->OffsetHigh = (DWORD)(Offset >> 32);
+
+    if (ReadFile(SourceHandle, Buffer, BufferSize, NULL, Overlapped)) {
+        return ERROR_SUCCESS;
+    }
+
+    LastError = GetLastError();
+    if (LastError == ERROR_IO_PENDING) {
+        return ERROR_SUCCESS;
+    }
+
+    if (LastError == ERROR_BROKEN_PIPE) {
+        LastError = ERROR_HANDLE_EOF;
+    }
+
+    return LastError;
+}
+
+/**
+ Wait for a read started with @ref CopyStartRead to complete.
+
+ @param SourceHandle Handle to the source.
+
+ @param Overlapped Pointer to the overlapped structure used for the read.
+
+ @param BytesRead On successful completion, updated to contain the number of
+        bytes read.  This is zero at the end of the source.
+
+ @return ERROR_SUCCESS to indicate success, or an error code to indicate
+         failure.
+ */
+SYSERR
+CopyCompleteRead(
+    __in HANDLE SourceHandle,
+    __in LPOVERLAPPED Overlapped,
+    __out PDWORD BytesRead
+    )
+{
+    SYSERR LastError;
+
+    *BytesRead = 0;
+    if (GetOverlappedResult(SourceHandle, Overlapped, BytesRead, TRUE)) {
+        return ERROR_SUCCESS;
+    }
+
+    LastError = GetLastError();
+    if (LastError == ERROR_HANDLE_EOF || LastError == ERROR_BROKEN_PIPE) {
+        *BytesRead = 0;
+        return ERROR_SUCCESS;
+    }
+
+    return LastError;
+}
+
+/**
+ Record that a file's data has been copied, for the summary displayed at
+ the end of the copy.
+
+ @param CopyContext Pointer to the copy context.
+
+ @param BytesCopied The number of bytes copied.
+ */
+VOID
+CopyAddToTotals(
+    __in PCOPY_CONTEXT CopyContext,
+    __in LONGLONG BytesCopied
+    )
+{
+    if (CopyContext->Mutex != NULL) {
+        WaitForSingleObject(CopyContext->Mutex, INFINITE);
+    }
+    CopyContext->BytesCopied = CopyContext->BytesCopied + BytesCopied;
+    CopyContext->FilesDataCopied++;
+    if (CopyContext->Mutex != NULL) {
+        ReleaseMutex(CopyContext->Mutex);
+    }
+}
+
 /**
  For objects that are not really files, copy can't use CopyFile, and instead
  falls back to this stupid thing of reading and writing.  Note this path
  should not be used for files since it makes no attempt to preserve any kind
  of file metadata, but for devices file metadata is meaningless anyway.
 
+ The source is read with overlapped IO into two buffers, so the next block
+ is being read while the previous one is written.  Large or unbounded
+ copies use larger buffers.  Buffers are page aligned so they satisfy the
+ sector alignment of any device.
+
  @param CopyContext Pointer to the copy context, specifying device size.
 
  @param SourceFile Pointer to the source file/device name.
@@ -574,22 +796,29 @@ CopyAsDumbDataMove(
     __in PYORI_STRING DestFile
     )
 {
-    PVOID Buffer;
+    PUCHAR Buffers[2];
+    PUCHAR Buffer;
+    DWORD BufferIndex;
     DWORD BytesCopied;
     DWORD BufferSize;
     DWORD SectorSize;
     HANDLE SourceHandle;
     HANDLE DestHandle;
+    OVERLAPPED ReadOverlapped;
+    LARGE_INTEGER SourceSize;
     SYSERR LastError;
     LPTSTR ErrText;
     LONGLONG TotalBytesCopied;
+    LONGLONG ReadOffset;
+    BOOLEAN ReadStarted;
+    BOOL Result;
 
     SourceHandle = CreateFile(SourceFile->StartOfString,
                               GENERIC_READ,
                               FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
                               NULL,
                               OPEN_EXISTING,
-                              FILE_FLAG_OPEN_NO_RECALL|FILE_FLAG_BACKUP_SEMANTICS,
+                              FILE_FLAG_OPEN_NO_RECALL|FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OVERLAPPED|FILE_FLAG_SEQUENTIAL_SCAN,
                               NULL);
 
     if (SourceHandle == INVALID_HANDLE_VALUE) {
@@ -630,28 +859,62 @@ CopyAsDumbDataMove(
 
     SectorSize = YoriLibGetHandleSectorSize(DestHandle);
 
-    BufferSize = 64 * 1024;
-    if (!YoriLibIsSizeAllocatable(BufferSize)) {
-        BufferSize = 32 * 1024;
+    //
+    //  Use small buffers for small files, and large buffers for large files
+    //  or devices whose size is not known.
+    //
+
+    BufferSize = COPY_DEVICE_LARGE_BUFFER_SIZE;
+    if (CopyContext->DeviceSize.QuadPart != 0) {
+        if (CopyContext->DeviceSize.QuadPart <= 4 * COPY_DEVICE_BUFFER_SIZE) {
+            BufferSize = COPY_DEVICE_BUFFER_SIZE;
+        }
+    } else {
+        SourceSize.LowPart = GetFileSize(SourceHandle, (LPDWORD)&SourceSize.HighPart);
+        if (SourceSize.LowPart != INVALID_FILE_SIZE || GetLastError() == NO_ERROR) {
+            if (SourceSize.QuadPart <= 4 * COPY_DEVICE_BUFFER_SIZE) {
+                BufferSize = COPY_DEVICE_BUFFER_SIZE;
+            }
+        }
     }
-    Buffer = YoriLibMalloc((YORI_ALLOC_SIZE_T)BufferSize);
-    if (Buffer == NULL) {
+
+    Buffers[0] = VirtualAlloc(NULL, BufferSize * 2, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    ReadOverlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (Buffers[0] == NULL || ReadOverlapped.hEvent == NULL) {
+        if (Buffers[0] != NULL) {
+            VirtualFree(Buffers[0], 0, MEM_RELEASE);
+        }
+        if (ReadOverlapped.hEvent != NULL) {
+            CloseHandle(ReadOverlapped.hEvent);
+        }
         CloseHandle(SourceHandle);
         CloseHandle(DestHandle);
         return FALSE;
     }
+    Buffers[1] = Buffers[0] + BufferSize;
 
     if (SectorSize > BufferSize) {
         SectorSize = BufferSize;
     }
 
     TotalBytesCopied = 0;
+    ReadOffset = 0;
+    BufferIndex = 0;
+    Result = TRUE;
 
-    while (ReadFile(SourceHandle, Buffer, BufferSize, &BytesCopied, NULL)) {
-        if (BytesCopied == 0) {
+    LastError = CopyStartRead(SourceHandle, Buffers[BufferIndex], BufferSize, ReadOffset, &ReadOverlapped);
+    ReadStarted = (BOOLEAN)(LastError == ERROR_SUCCESS);
+
+    while (ReadStarted) {
+        LastError = CopyCompleteRead(SourceHandle, &ReadOverlapped, &BytesCopied);
+        ReadStarted = FALSE;
+        if (LastError != ERROR_SUCCESS || BytesCopied == 0) {
             break;
         }
 
+        Buffer = Buffers[BufferIndex];
+        ReadOffset = ReadOffset + BytesCopied;
+
         if (CopyContext->DeviceSize.QuadPart != 0 &&
             (TotalBytesCopied + BytesCopied) > CopyContext->DeviceSize.QuadPart) {
 
@@ -659,6 +922,22 @@ CopyAsDumbDataMove(
 
         }
 
+        //
+        //  Start reading the next block into the other buffer before
+        //  writing this one, unless this block completes the device.
+        //
+
+        if (CopyContext->DeviceSize.QuadPart == 0 ||
+            TotalBytesCopied + BytesCopied < CopyContext->DeviceSize.QuadPart) {
+
+            LastError = CopyStartRead(SourceHandle, Buffers[BufferIndex ^ 1], BufferSize, ReadOffset, &ReadOverlapped);
+            if (LastError == ERROR_SUCCESS) {
+                ReadStarted = TRUE;
+            } else if (LastError != ERROR_HANDLE_EOF) {
+                break;
+            }
+        }
+
         //
         //  If the destination has a sector size requirement, round up to the
         //  next whole sector
@@ -685,24 +964,40 @@ CopyAsDumbDataMove(
             ErrText = YoriLibGetWinErrorText(LastError);
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Write to destination failed: %y: %s"), DestFile, ErrText);
             YoriLibFreeWinErrorText(ErrText);
-            YoriLibFree(Buffer);
-            CloseHandle(SourceHandle);
-            CloseHandle(DestHandle);
-            return FALSE;
+            LastError = ERROR_SUCCESS;
+            Result = FALSE;
+            break;
         }
 
         TotalBytesCopied = TotalBytesCopied + BytesCopied;
-        if (CopyContext->DeviceSize.QuadPart != 0 &&
-            TotalBytesCopied >= CopyContext->DeviceSize.QuadPart) {
+        BufferIndex = BufferIndex ^ 1;
+    }
 
-            break;
-        }
+    //
+    //  If a read is still outstanding because the write failed, it must
+    //  complete before its buffer is freed.
+    //
+
+    if (ReadStarted) {
+        GetOverlappedResult(SourceHandle, &ReadOverlapped, &BytesCopied, TRUE);
+    }
+
+    if (LastError != ERROR_SUCCESS && LastError != ERROR_HANDLE_EOF) {
+        ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Read from source failed: %y: %s"), SourceFile, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        Result = FALSE;
     }
 
-    YoriLibFree(Buffer);
+    if (Result) {
+        CopyAddToTotals(CopyContext, TotalBytesCopied);
+    }
+
+    VirtualFree(Buffers[0], 0, MEM_RELEASE);
+    CloseHandle(ReadOverlapped.hEvent);
     CloseHandle(SourceHandle);
     CloseHandle(DestHandle);
-    return TRUE;
+    return Result;
 }
 
 /**
@@ -748,6 +1043,365 @@ CopyTimestamps(
     return TRUE;
 }
 
+/**
+ Copy the data of a single file, and its timestamps if requested.  This may
+ be called on a worker thread, so it only reads from the copy context.
+
+ @param CopyContext Pointer to the copy context specifying how to copy.
+
+ @param SourceFile Pointer to the fully qualified source file name.
+
+ @param DestFile Pointer to the fully qualified destination file name.
+
+ @param FileInfo Optionally points to information about the source file
+        from enumeration.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+CopyFileData(
+    __in PCOPY_CONTEXT CopyContext,
+    __in PYORI_STRING SourceFile,
+    __in PYORI_STRING DestFile,
+    __in_opt PWIN32_FIND_DATA FileInfo
+    )
+{
+    YORI_STRING HumanSourcePath;
+    YORI_STRING HumanDestPath;
+    PYORI_STRING SourceNameToDisplay;
+    PYORI_STRING DestNameToDisplay;
+    LONGLONG FileSize;
+    SYSERR LastError;
+    BOOL Result;
+
+    Result = TRUE;
+    if (CopyContext->DestinationIsDevice || YoriLibIsFileNameDeviceName(SourceFile)) {
+        Result = CopyAsDumbDataMove(CopyContext, SourceFile, DestFile);
+    } else {
+        LastError = YoriLibCopyFile(SourceFile, DestFile);
+        if (LastError == ERROR_SUCCESS) {
+            FileSize = 0;
+            if (FileInfo != NULL) {
+                FileSize = ((LONGLONG)FileInfo->nFileSizeHigh << 32) | FileInfo->nFileSizeLow;
+            }
+            CopyAddToTotals(CopyContext, FileSize);
+        } else {
+
+            //
+            //  If it failed with an error indicating CopyFile couldn't
+            //  handle it, fall back to dumb data copy.  Note that this
+            //  function will output its own errors, so from this point,
+            //  error handling is over.
+            //
+
+            if (LastError == ERROR_INVALID_PARAMETER) {
+                Result = CopyAsDumbDataMove(CopyContext, SourceFile, DestFile);
+            } else {
+                LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
+                YoriLibInitEmptyString(&HumanSourcePath);
+                YoriLibInitEmptyString(&HumanDestPath);
+                SourceNameToDisplay = SourceFile;
+                DestNameToDisplay = DestFile;
+                if (YoriLibUnescapePath(SourceFile, &HumanSourcePath)) {
+                    SourceNameToDisplay = &HumanSourcePath;
+                }
+                if (YoriLibUnescapePath(DestFile, &HumanDestPath)) {
+                    DestNameToDisplay = &HumanDestPath;
+                }
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("CopyFile failed: %y to %y: %s"), SourceNameToDisplay, DestNameToDisplay, ErrText);
+                YoriLibFreeWinErrorText(ErrText);
+                YoriLibFreeStringContents(&HumanSourcePath);
+                YoriLibFreeStringContents(&HumanDestPath);
+                Result = FALSE;
+            }
+        }
+
+        if (CopyContext->CompressDest) {
+
+            YoriLibCompressFileInBackground(&CopyContext->CompressContext, DestFile);
+        }
+    }
+
+    if (CopyContext->CopyTimestamps && FileInfo != NULL) {
+        CopyTimestamps(FileInfo, DestFile);
+    }
+
+    return Result;
+}
+
+/**
+ A worker thread which copies files queued by the enumerating thread.
+
+ @param Context Pointer to the copy context.
+
+ @return TRUE if all files were copied successfully, FALSE if any failed.
+ */
+DWORD WINAPI
+CopyWorker(
+    __in LPVOID Context
+    )
+{
+    PCOPY_CONTEXT CopyContext = (PCOPY_CONTEXT)Context;
+    PCOPY_PENDING_FILE PendingFile;
+    DWORD FoundEvent;
+    BOOL Result = TRUE;
+
+    while (TRUE) {
+
+        //
+        //  Wait for an indication of more work or shutdown.
+        //
+
+        FoundEvent = WaitForMultipleObjectsEx(2, &CopyContext->WorkerWaitEvent, FALSE, INFINITE, FALSE);
+
+        //
+        //  Process any queued work.
+        //
+
+        while (TRUE) {
+            WaitForSingleObject(CopyContext->Mutex, INFINITE);
+            if (!YoriLibIsListEmpty(&CopyContext->PendingList)) {
+                PendingFile = CONTAINING_RECORD(CopyContext->PendingList.Next, COPY_PENDING_FILE, PendingList);
+                ASSERT(CopyContext->ItemsQueued > 0);
+                CopyContext->ItemsQueued--;
+                YoriLibRemoveListItem(&PendingFile->PendingList);
+                ReleaseMutex(CopyContext->Mutex);
+
+                if (!CopyFileData(CopyContext, &PendingFile->SourceFile, &PendingFile->DestFile, PendingFile->FileInfoPresent?&PendingFile->FileInfo:NULL)) {
+                    Result = FALSE;
+                }
+                YoriLibFree(PendingFile);
+
+            } else {
+                ASSERT(CopyContext->ItemsQueued == 0);
+                ReleaseMutex(CopyContext->Mutex);
+                break;
+            }
+        }
+
+        //
+        //  If shutdown was requested, terminate the thread.
+        //
+
+        if (FoundEvent == (WAIT_OBJECT_0 + 1)) {
+            break;
+        }
+    }
+
+    return Result;
+}
+
+/**
+ Prepare to copy files concurrently on worker threads.  Threads are created
+ as files are queued.
+
+ @param CopyContext Pointer to the copy context.
+
+ @param MaxThreads The maximum number of files to copy concurrently.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+CopyInitializeWorkers(
+    __in PCOPY_CONTEXT CopyContext,
+    __in DWORD MaxThreads
+    )
+{
+    CopyContext->MaxThreads = MaxThreads;
+    if (MaxThreads <= 1) {
+        return TRUE;
+    }
+
+    CopyContext->Threads = YoriLibMalloc(MaxThreads * sizeof(HANDLE));
+    if (CopyContext->Threads == NULL) {
+        return FALSE;
+    }
+
+    CopyContext->Mutex = CreateMutex(NULL, FALSE, NULL);
+    if (CopyContext->Mutex == NULL) {
+        return FALSE;
+    }
+
+    CopyContext->WorkerWaitEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (CopyContext->WorkerWaitEvent == NULL) {
+        return FALSE;
+    }
+
+    CopyContext->WorkerShutdownEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (CopyContext->WorkerShutdownEvent == NULL) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Copy the data of a single file on a worker thread if one is available, or
+ on the calling thread if not.  The calling thread copies the file if
+ concurrency was not requested, or if the worker threads already have an
+ excessively large queue of work, which prevents the enumerating thread from
+ continuing to add items that the workers can't get to.
+
+ @param CopyContext Pointer to the copy context.
+
+ @param SourceFile Pointer to the fully qualified source file name.
+
+ @param DestFile Pointer to the fully qualified destination file name.
+
+ @param FileInfo Optionally points to information about the source file
+        from enumeration.
+
+ @return TRUE to indicate the file was copied or queued, FALSE to indicate
+         failure.
+ */
+BOOL
+CopyQueueFileData(
+    __in PCOPY_CONTEXT CopyContext,
+    __in PYORI_STRING SourceFile,
+    __in PYORI_STRING DestFile,
+    __in_opt PWIN32_FIND_DATA FileInfo
+    )
+{
+    PCOPY_PENDING_FILE PendingFile;
+    YORI_ALLOC_SIZE_T BytesRequired;
+    BOOLEAN Queued;
+    DWORD ThreadId;
+
+    if (CopyContext->MaxThreads <= 1) {
+        return CopyFileData(CopyContext, SourceFile, DestFile, FileInfo);
+    }
+
+    ASSERT(YoriLibIsStringNullTerminated(SourceFile));
+    ASSERT(YoriLibIsStringNullTerminated(DestFile));
+
+    BytesRequired = sizeof(COPY_PENDING_FILE) + (SourceFile->LengthInChars + 1 + DestFile->LengthInChars + 1) * sizeof(TCHAR);
+    PendingFile = YoriLibMalloc(BytesRequired);
+    if (PendingFile == NULL) {
+        return CopyFileData(CopyContext, SourceFile, DestFile, FileInfo);
+    }
+
+    YoriLibInitEmptyString(&PendingFile->SourceFile);
+    PendingFile->SourceFile.StartOfString = (LPTSTR)(PendingFile + 1);
+    PendingFile->SourceFile.LengthInChars = SourceFile->LengthInChars;
+    PendingFile->SourceFile.LengthAllocated = SourceFile->LengthInChars + 1;
+    memcpy(PendingFile->SourceFile.StartOfString, SourceFile->StartOfString, (SourceFile->LengthInChars + 1) * sizeof(TCHAR));
+
+    YoriLibInitEmptyString(&PendingFile->DestFile);
+    PendingFile->DestFile.StartOfString = PendingFile->SourceFile.StartOfString + PendingFile->SourceFile.LengthAllocated;
+    PendingFile->DestFile.LengthInChars = DestFile->LengthInChars;
+    PendingFile->DestFile.LengthAllocated = DestFile->LengthInChars + 1;
+    memcpy(PendingFile->DestFile.StartOfString, DestFile->StartOfString, (DestFile->LengthInChars + 1) * sizeof(TCHAR));
+
+    PendingFile->FileInfoPresent = FALSE;
+    if (FileInfo != NULL) {
+        memcpy(&PendingFile->FileInfo, FileInfo, sizeof(WIN32_FIND_DATA));
+        PendingFile->FileInfoPresent = TRUE;
+    }
+
+    Queued = FALSE;
+    WaitForSingleObject(CopyContext->Mutex, INFINITE);
+    if (CopyContext->ThreadsAllocated < CopyContext->MaxThreads &&
+        CopyContext->ItemsQueued >= CopyContext->ThreadsAllocated) {
+
+        CopyContext->Threads[CopyContext->ThreadsAllocated] = CreateThread(NULL, 0, CopyWorker, CopyContext, 0, &ThreadId);
+        if (CopyContext->Threads[CopyContext->ThreadsAllocated] != NULL) {
+            CopyContext->ThreadsAllocated++;
+        }
+    }
+
+    if (CopyContext->ThreadsAllocated > 0 &&
+        CopyContext->ItemsQueued < CopyContext->MaxThreads * 2) {
+
+        YoriLibAppendList(&CopyContext->PendingList, &PendingFile->PendingList);
+        CopyContext->ItemsQueued++;
+        Queued = TRUE;
+    }
+    ReleaseMutex(CopyContext->Mutex);
+
+    if (Queued) {
+        SetEvent(CopyContext->WorkerWaitEvent);
+        return TRUE;
+    }
+
+    if (!CopyFileData(CopyContext, &PendingFile->SourceFile, &PendingFile->DestFile, FileInfo)) {
+        YoriLibFree(PendingFile);
+        return FALSE;
+    }
+
+    YoriLibFree(PendingFile);
+    return TRUE;
+}
+
+/**
+ Wait for worker threads to copy all queued files, then terminate them.
+
+ @param CopyContext Pointer to the copy context.
+ */
+VOID
+CopyWaitForWorkers(
+    __in PCOPY_CONTEXT CopyContext
+    )
+{
+    DWORD Index;
+
+    if (CopyContext->ThreadsAllocated == 0) {
+        return;
+    }
+
+    SetEvent(CopyContext->WorkerShutdownEvent);
+    for (Index = 0; Index < CopyContext->ThreadsAllocated; Index++) {
+        WaitForSingleObject(CopyContext->Threads[Index], INFINITE);
+        CloseHandle(CopyContext->Threads[Index]);
+    }
+    CopyContext->ThreadsAllocated = 0;
+
+    ASSERT(YoriLibIsListEmpty(&CopyContext->PendingList));
+}
+
+/**
+ Display the amount of data copied and the rate it was copied at.
+
+ @param CopyContext Pointer to the copy context.
+ */
+VOID
+CopyDisplaySummary(
+    __in PCOPY_CONTEXT CopyContext
+    )
+{
+    YORI_STRING SizeString;
+    YORI_STRING RateString;
+    TCHAR SizeBuffer[sizeof("12.3k")];
+    TCHAR RateBuffer[sizeof("12.3k")];
+    LARGE_INTEGER Size;
+    LONGLONG ElapsedMs;
+
+    ElapsedMs = (YoriLibGetSystemTimeAsInteger() - CopyContext->StartTime) / (10 * 1000);
+    if (ElapsedMs <= 0) {
+        ElapsedMs = 1;
+    }
+
+    YoriLibInitEmptyString(&SizeString);
+    SizeString.StartOfString = SizeBuffer;
+    SizeString.LengthAllocated = sizeof(SizeBuffer)/sizeof(SizeBuffer[0]);
+    YoriLibInitEmptyString(&RateString);
+    RateString.StartOfString = RateBuffer;
+    RateString.LengthAllocated = sizeof(RateBuffer)/sizeof(RateBuffer[0]);
+
+    Size.QuadPart = CopyContext->BytesCopied;
+    YoriLibFileSizeToString(&SizeString, &Size);
+    Size.QuadPart = CopyContext->BytesCopied * 1000 / ElapsedMs;
+    YoriLibFileSizeToString(&RateString, &Size);
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                  _T("Copied %i files, %y in %lli ms, %y/s, %lli files/s\n"),
+                  CopyContext->FilesDataCopied,
+                  &SizeString,
+                  ElapsedMs,
+                  &RateString,
+                  (LONGLONG)CopyContext->FilesDataCopied * 1000 / ElapsedMs);
+}
+
 /**
  A callback that is invoked when a file is found that matches a search criteria
  specified in the set of strings to enumerate.
@@ -785,6 +1439,7 @@ CopyFileFoundCallback(
     YORI_ALLOC_SIZE_T SlashesFound;
     YORI_ALLOC_SIZE_T Index;
     SYSERR LastError;
+    BOOLEAN FileDataQueued;
 
     CopyContext->FilesFoundThisArg++;
 
@@ -861,6 +1516,7 @@ CopyFileFoundCallback(
     }
 
 
+    FileDataQueued = FALSE;
     if (!CopyContext->SkipDataCopy) {
         if (FileInfo != NULL &&
             FileInfo->dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT &&
@@ -879,46 +1535,20 @@ CopyFileFoundCallback(
                     YoriLibFreeWinErrorText(ErrText);
                 }
             }
-        } else if (CopyContext->DestinationIsDevice || YoriLibIsFileNameDeviceName(FilePath)) {
-            CopyAsDumbDataMove(CopyContext, FilePath, &FullDest);
         } else {
-            LastError = YoriLibCopyFile(FilePath, &FullDest);
-            if (LastError != ERROR_SUCCESS) {
-
-                //
-                //  If it failed with an error indicating CopyFile couldn't
-                //  handle it, fall back to dumb data copy.  Note that this
-                //  function will output its own errors, so from this point,
-                //  error handling is over.
-                //
-
-                if (LastError == ERROR_INVALID_PARAMETER) {
-                    CopyAsDumbDataMove(CopyContext, FilePath, &FullDest);
-                } else {
-                    LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
-                    if (SourceNameToDisplay != &HumanSourcePath) {
-                        if (YoriLibUnescapePath(FilePath, &HumanSourcePath)) {
-                            SourceNameToDisplay = &HumanSourcePath;
-                        }
-                    }
-                    if (DestNameToDisplay != &HumanDestPath) {
-                        if (YoriLibUnescapePath(&FullDest, &HumanDestPath)) {
-                            DestNameToDisplay = &HumanDestPath;
-                        }
-                    }
-                    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("CopyFile failed: %y to %y: %s"), SourceNameToDisplay, DestNameToDisplay, ErrText);
-                    YoriLibFreeWinErrorText(ErrText);
-                }
-            }
 
-            if (CopyContext->CompressDest) {
+            //
+            //  Directories are created above as they are found, before
+            //  any file within them is queued, so workers can copy files
+            //  in any order.
+            //
 
-                YoriLibCompressFileInBackground(&CopyContext->CompressContext, &FullDest);
-            }
+            CopyQueueFileData(CopyContext, FilePath, &FullDest, FileInfo);
+            FileDataQueued = TRUE;
         }
     }
 
-    if (CopyContext->CopyTimestamps && FileInfo != NULL) {
+    if (!FileDataQueued && CopyContext->CopyTimestamps && FileInfo != NULL) {
         CopyTimestamps(FileInfo, &FullDest);
     }
 
@@ -932,7 +1562,7 @@ CopyFileFoundCallback(
 /**
  Free the structures allocated within a copy context.  The structure itself
  is on the stack and is not freed.  This will wait for any outstanding
- compression work to complete.
+ copy and compression work to complete.
 
  @param CopyContext Pointer to the context to free.
  */
@@ -941,6 +1571,23 @@ CopyFreeCopyContext(
     __in PCOPY_CONTEXT CopyContext
     )
 {
+    CopyWaitForWorkers(CopyContext);
+    if (CopyContext->Threads != NULL) {
+        YoriLibFree(CopyContext->Threads);
+        CopyContext->Threads = NULL;
+    }
+    if (CopyContext->Mutex != NULL) {
+        CloseHandle(CopyContext->Mutex);
+        CopyContext->Mutex = NULL;
+    }
+    if (CopyContext->WorkerWaitEvent != NULL) {
+        CloseHandle(CopyContext->WorkerWaitEvent);
+        CopyContext->WorkerWaitEvent = NULL;
+    }
+    if (CopyContext->WorkerShutdownEvent != NULL) {
+        CloseHandle(CopyContext->WorkerShutdownEvent);
+        CopyContext->WorkerShutdownEvent = NULL;
+    }
     YoriLibFreeCompressContext(&CopyContext->CompressContext);
     YoriLibFreeStringContents(&CopyContext->Dest);
     CopyFreeExcludes(CopyContext);
@@ -987,14 +1634,19 @@ ENTRYPOINT(
     COPY_CONTEXT CopyContext;
     YORILIB_COMPRESS_ALGORITHM CompressionAlgorithm;
     YORI_STRING Arg;
+    YORI_MAX_SIGNED_T llTemp;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+    DWORD MaxThreads;
 
     FileCount = 0;
+    MaxThreads = 1;
     Recursive = FALSE;
     BasicEnumeration = FALSE;
     ZeroMemory(&CopyContext, sizeof(CopyContext));
     CompressionAlgorithm.EntireAlgorithm = 0;
 
     YoriLibInitializeListHead(&CopyContext.ExcludeList);
+    YoriLibInitializeListHead(&CopyContext.PendingList);
 
     for (i = 1; i < ArgC; i++) {
 
@@ -1007,7 +1659,7 @@ ENTRYPOINT(
                 CopyHelp();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2017-2022"));
+                YoriLibDisplayMitLicense(_T("2017-2026"));
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("b")) == 0) {
                 BasicEnumeration = TRUE;
@@ -1050,6 +1702,17 @@ ENTRYPOINT(
                 CompressionAlgorithm.WofAlgorithm = FILE_PROVIDER_COMPRESSION_XPRESS16K;
                 CopyContext.CompressDest = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("j")) == 0) {
+                if (i + 1 < ArgC &&
+                    YoriLibStringToNumber(&ArgV[i + 1], TRUE, &llTemp, &CharsConsumed) &&
+                    CharsConsumed > 0 &&
+                    llTemp > 0 &&
+                    llTemp <= MAXIMUM_WAIT_OBJECTS) {
+
+                    MaxThreads = (DWORD)llTemp;
+                    ArgumentUnderstood = TRUE;
+                    i++;
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("l")) == 0) {
                 CopyContext.CopyAsLinks = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -1164,10 +1827,17 @@ ENTRYPOINT(
         }
     }
 
+    if (!CopyInitializeWorkers(&CopyContext, MaxThreads)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("copy: could not create copy threads\n"));
+        CopyFreeCopyContext(&CopyContext);
+        return EXIT_FAILURE;
+    }
+
 #if YORI_BUILTIN
     YoriLibCancelEnable(FALSE);
 #endif
 
+    CopyContext.StartTime = YoriLibGetSystemTimeAsInteger();
     CopyContext.FilesCopied = 0;
     FilesProcessed = 0;
 
@@ -1222,6 +1892,12 @@ ENTRYPOINT(
         }
     }
 
+    CopyWaitForWorkers(&CopyContext);
+
+    if (CopyContext.Verbose) {
+        CopyDisplaySummary(&CopyContext);
+    }
+
     Result = EXIT_SUCCESS;
 
     if (CopyContext.FilesCopied == 0) {
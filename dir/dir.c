@@ -3,7 +3,7 @@
  *
  * Yori shell enumerate files in directories
  *
- * Copyright (c) 2017-2021 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -193,6 +193,12 @@ typedef struct _DIR_CONTEXT {
      */
     YORI_LIB_FILE_FILTER ColorRules;
 
+    /**
+     The stream used to buffer output so that each file does not require a
+     separate write.
+     */
+    YORI_LIB_OUTPUT_STREAM OutputStream;
+
     /**
      A buffer allocated to fetch reparse data.  This is here because we
      probably won't allocate it, but if we do, it makes sense to reuse it
@@ -304,9 +310,9 @@ DirOutputBeginningOfDirectorySummary(
     }
 
     if (VtAttribute.LengthInChars > 0) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n Directory of %y%y%c[0m\n\n"), &VtAttribute, PathToDisplay, 27);
+        YoriLibOutputStream(&DirContext->OutputStream, _T("\n Directory of %y%y%c[0m\n\n"), &VtAttribute, PathToDisplay, 27);
     } else {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n Directory of %y\n\n"), PathToDisplay);
+        YoriLibOutputStream(&DirContext->OutputStream, _T("\n Directory of %y\n\n"), PathToDisplay);
     }
     YoriLibFreeStringContents(&UnescapedPath);
     return TRUE;
@@ -346,7 +352,7 @@ DirOutputEndOfDirectorySummary(
     YoriLibRightAlignString(&CountString, DIR_COUNT_FIELD_SIZE);
     YoriLibRightAlignString(&SizeString, DIR_SIZE_FIELD_SIZE);
 
-    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y File(s) %y bytes\n"), &CountString, &SizeString);
+    YoriLibOutputStream(&DirContext->OutputStream, _T("%y File(s) %y bytes\n"), &CountString, &SizeString);
 
 
     FreeSpace.QuadPart = 0;
@@ -359,7 +365,7 @@ DirOutputEndOfDirectorySummary(
     YoriLibRightAlignString(&CountString, DIR_COUNT_FIELD_SIZE);
     YoriLibRightAlignString(&SizeString, DIR_SIZE_FIELD_SIZE);
 
-    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y Dir(s)  %y bytes free\n"), &CountString, &SizeString);
+    YoriLibOutputStream(&DirContext->OutputStream, _T("%y Dir(s)  %y bytes free\n"), &CountString, &SizeString);
 
     DirContext->ObjectsFoundInThisDir = 0;
     DirContext->FilesFoundInThisDir = 0;
@@ -403,13 +409,13 @@ DirOutputEndOfRecursiveSummary(
     YoriLibRightAlignString(&CountString, DIR_COUNT_FIELD_SIZE);
     YoriLibRightAlignString(&SizeString, DIR_SIZE_FIELD_SIZE);
 
-    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n     Total Files Listed:\n"));
-    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y File(s) %y bytes\n"), &CountString, &SizeString);
+    YoriLibOutputStream(&DirContext->OutputStream, _T("\n     Total Files Listed:\n"));
+    YoriLibOutputStream(&DirContext->OutputStream, _T("%y File(s) %y bytes\n"), &CountString, &SizeString);
 
     YoriLibNumberToString(&CountString, DirContext->DirsFound, 10, 3, ',');
 
     YoriLibRightAlignString(&CountString, DIR_COUNT_FIELD_SIZE);
-    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y Dir(s)\n"), &CountString);
+    YoriLibOutputStream(&DirContext->OutputStream, _T("%y Dir(s)\n"), &CountString);
 
     YoriLibFreeStringContents(&CountString);
     YoriLibFreeStringContents(&SizeString);
@@ -632,13 +638,13 @@ DirFileFoundCallback(
             YORI_STRING UnescapedPath;
             YoriLibInitEmptyString(&UnescapedPath);
             if (YoriLibUnescapePath(FilePath, &UnescapedPath)) {
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y%y%s\n"), &VtAttribute, &UnescapedPath, VtReset);
+                YoriLibOutputStream(&DirContext->OutputStream, _T("%y%y%s\n"), &VtAttribute, &UnescapedPath, VtReset);
                 YoriLibFreeStringContents(&UnescapedPath);
             } else {
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y%y%s\n"), &VtAttribute, FilePath, VtReset);
+                YoriLibOutputStream(&DirContext->OutputStream, _T("%y%y%s\n"), &VtAttribute, FilePath, VtReset);
             }
         } else {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y%s%s\n"), &VtAttribute, FilePart, VtReset);
+            YoriLibOutputStream(&DirContext->OutputStream, _T("%y%s%s\n"), &VtAttribute, FilePart, VtReset);
         }
 
     } else {
@@ -850,24 +856,24 @@ DirFileFoundCallback(
         }
 
         if (DirContext->DisplayShortNames) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
-                          _T("%s  %s %y %y%12s %s%s\n"),
-                          DateStringBuffer,
-                          TimeStringBuffer,
-                          &SizeString,
-                          &VtAttribute,
-                          FileInfo->cAlternateFileName,
-                          FilePart,
-                          VtReset);
+            YoriLibOutputStream(&DirContext->OutputStream,
+                                _T("%s  %s %y %y%12s %s%s\n"),
+                                DateStringBuffer,
+                                TimeStringBuffer,
+                                &SizeString,
+                                &VtAttribute,
+                                FileInfo->cAlternateFileName,
+                                FilePart,
+                                VtReset);
         } else {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
-                          _T("%s  %s %y %y%s%s\n"),
-                          DateStringBuffer,
-                          TimeStringBuffer,
-                          &SizeString,
-                          &VtAttribute,
-                          FilePart,
-                          VtReset);
+            YoriLibOutputStream(&DirContext->OutputStream,
+                                _T("%s  %s %y %y%s%s\n"),
+                                DateStringBuffer,
+                                TimeStringBuffer,
+                                &SizeString,
+                                &VtAttribute,
+                                FilePart,
+                                VtReset);
         }
 
         if (DirContext->DisplayStreams) {
@@ -943,24 +949,24 @@ DirFileFoundCallback(
                             YoriLibRightAlignString(&SizeString, DIR_SIZE_FIELD_SIZE);
                         }
                         if (DirContext->DisplayShortNames) {
-                            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
-                                          _T("%18s%y %13s%y%s%s%s\n"),
-                                          _T(""),
-                                          &SizeString,
-                                          _T(""),
-                                          &VtAttribute,
-                                          FileInfo->cFileName,
-                                          FindStreamData.cStreamName,
-                                          VtReset);
+                            YoriLibOutputStream(&DirContext->OutputStream,
+                                                _T("%18s%y %13s%y%s%s%s\n"),
+                                                _T(""),
+                                                &SizeString,
+                                                _T(""),
+                                                &VtAttribute,
+                                                FileInfo->cFileName,
+                                                FindStreamData.cStreamName,
+                                                VtReset);
                         } else {
-                            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
-                                          _T("%18s%y %y%s%s%s\n"),
-                                          _T(""),
-                                          &SizeString,
-                                          &VtAttribute,
-                                          FileInfo->cFileName,
-                                          FindStreamData.cStreamName,
-                                          VtReset);
+                            YoriLibOutputStream(&DirContext->OutputStream,
+                                                _T("%18s%y %y%s%s%s\n"),
+                                                _T(""),
+                                                &SizeString,
+                                                &VtAttribute,
+                                                FileInfo->cFileName,
+                                                FindStreamData.cStreamName,
+                                                VtReset);
                         }
                     }
                 } while (DllKernel32.pFindNextStreamW(hFind, &FindStreamData));
@@ -1025,6 +1031,7 @@ DirFileEnumerateErrorCallback(
         } else {
             DirName.LengthInChars = UnescapedFilePath.LengthInChars;
         }
+        YoriLibOutputStreamFlush(&DirContext->OutputStream);
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Enumerate of %y failed: %s"), &DirName, ErrText);
         YoriLibFreeWinErrorText(ErrText);
         if (DirContext->Recursive) {
@@ -1205,6 +1212,7 @@ ENTRYPOINT(
 #endif
 
     DirLoadLocaleSettings(&DirContext);
+    YoriLibOutputStreamInitialize(&DirContext.OutputStream, YORI_LIB_OUTPUT_STDOUT, 0);
 
     //
     //  Attempt to enable backup privilege so an administrator can access more
@@ -1264,12 +1272,14 @@ ENTRYPOINT(
     }
 
     if (DirContext.FilesFound == 0 && DirContext.DirsFound == 0) {
+        YoriLibOutputStreamClose(&DirContext.OutputStream);
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("dir: no matching files found\n"));
         return EXIT_FAILURE;
     } else if (DirContext.Recursive && !DirContext.MinimalDisplay) {
         DirOutputEndOfRecursiveSummary(&DirContext);
     }
 
+    YoriLibOutputStreamClose(&DirContext.OutputStream);
     return EXIT_SUCCESS;
 }
 
@@ -3,7 +3,7 @@
  *
  * Yori shell text editor
  *
- * Copyright (c) 2020-2024 Malcolm J. Smith
+ * Copyright (c) 2020-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -49,7 +49,7 @@ CHAR strEditHelpText[] =
  The copyright year string to display with license text.
  */
 const
-TCHAR strEditCopyrightYear[] = _T("2020-2024");
+TCHAR strEditCopyrightYear[] = _T("2020-2026");
 
 /**
  Display usage text to the user.
@@ -65,6 +65,31 @@ EditHelp(VOID)
     return TRUE;
 }
 
+/**
+ A batch of lines loaded from a file by a background thread which are ready
+ to be added to the multiline edit control.
+ */
+typedef struct _EDIT_LOAD_BATCH {
+
+    /**
+     The entry for this batch within the list of batches waiting to be added
+     to the multiline edit control.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     A referenced array of lines.  Each line refers to a buffer which is not
+     used by any other batch.
+     */
+    PYORI_STRING LineArray;
+
+    /**
+     The number of lines in LineArray.
+     */
+    YORI_ALLOC_SIZE_T LinesPopulated;
+
+} EDIT_LOAD_BATCH, *PEDIT_LOAD_BATCH;
+
 /**
  A context that records files found and being operated on in the current
  window.
@@ -223,6 +248,51 @@ typedef struct _EDIT_CONTEXT {
      */
     BOOLEAN ReadOnly;
 
+    /**
+     Handle to a thread loading the contents of a file in the background.
+     NULL if no load is in progress.
+     */
+    HANDLE LoadThread;
+
+    /**
+     Handle to the file being loaded by LoadThread.
+     */
+    HANDLE LoadSource;
+
+    /**
+     A mutex synchronizing access to LoadBatchList between the loading thread
+     and the user interface thread.
+     */
+    HANDLE LoadMutex;
+
+    /**
+     A list of batches of lines which have been loaded but not yet added to
+     the multiline edit control.
+     */
+    YORI_LIST_ENTRY LoadBatchList;
+
+    /**
+     The multibyte input encoding to restore once the load completes.
+     */
+    DWORD LoadSavedEncoding;
+
+    /**
+     The line ending of the first line of the file being loaded.  This is
+     written by the loading thread and is only meaningful once it completes.
+     */
+    YORI_LIB_LINE_ENDING LoadFirstLineEnding;
+
+    /**
+     TRUE if any lines were found by the loading thread.  This is only
+     meaningful once it completes.
+     */
+    BOOLEAN LoadFoundLines;
+
+    /**
+     Set to TRUE to indicate the loading thread should stop loading.
+     */
+    volatile BOOLEAN LoadCancelled;
+
 } EDIT_CONTEXT, *PEDIT_CONTEXT;
 
 /**
@@ -242,6 +312,10 @@ EditFreeEditContext(
 {
     YoriLibFreeStringContents(&EditContext->OpenFileName);
     YoriLibFreeStringContents(&EditContext->SearchString);
+    if (EditContext->LoadMutex != NULL) {
+        CloseHandle(EditContext->LoadMutex);
+        EditContext->LoadMutex = NULL;
+    }
 }
 
 /**
@@ -349,19 +423,144 @@ EditUpdateOpenedFileCaption(
 }
 
 /**
- Process a single opened stream, enumerating through all lines and populating
- the multiline edit control with the contents.
+ Free a batch of loaded lines which will not be added to the multiline edit
+ control.
+
+ @param Batch Pointer to the batch to free.
+ */
+VOID
+EditFreeLoadBatch(
+    __in PEDIT_LOAD_BATCH Batch
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    for (Index = 0; Index < Batch->LinesPopulated; Index++) {
+        YoriLibFreeStringContents(&Batch->LineArray[Index]);
+    }
+    YoriLibDereference(Batch->LineArray);
+    YoriLibFree(Batch);
+}
+
+/**
+ Queue a batch of loaded lines to be added to the multiline edit control.
+ On success, the line array and the lines within it are owned by the batch.
+
+ @param EditContext Pointer to the edit context.
+
+ @param LineArray Pointer to a referenced array of lines.
+
+ @param LinesPopulated The number of lines in LineArray.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+EditQueueLoadBatch(
+    __in PEDIT_CONTEXT EditContext,
+    __in PYORI_STRING LineArray,
+    __in YORI_ALLOC_SIZE_T LinesPopulated
+    )
+{
+    PEDIT_LOAD_BATCH Batch;
+
+    Batch = YoriLibMalloc(sizeof(EDIT_LOAD_BATCH));
+    if (Batch == NULL) {
+        return FALSE;
+    }
+
+    Batch->LineArray = LineArray;
+    Batch->LinesPopulated = LinesPopulated;
+
+    if (EditContext->LoadMutex != NULL) {
+        WaitForSingleObject(EditContext->LoadMutex, INFINITE);
+    }
+    YoriLibAppendList(&EditContext->LoadBatchList, &Batch->ListEntry);
+    if (EditContext->LoadMutex != NULL) {
+        ReleaseMutex(EditContext->LoadMutex);
+    }
+
+    return TRUE;
+}
+
+/**
+ Remove the oldest batch of loaded lines from the queue.
+
+ @param EditContext Pointer to the edit context.
+
+ @return Pointer to the batch, or NULL if no batches are queued.
+ */
+PEDIT_LOAD_BATCH
+EditDequeueLoadBatch(
+    __in PEDIT_CONTEXT EditContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PEDIT_LOAD_BATCH Batch;
+
+    Batch = NULL;
+    if (EditContext->LoadMutex != NULL) {
+        WaitForSingleObject(EditContext->LoadMutex, INFINITE);
+    }
+    ListEntry = YoriLibGetNextListEntry(&EditContext->LoadBatchList, NULL);
+    if (ListEntry != NULL) {
+        YoriLibRemoveListItem(ListEntry);
+        Batch = CONTAINING_RECORD(ListEntry, EDIT_LOAD_BATCH, ListEntry);
+    }
+    if (EditContext->LoadMutex != NULL) {
+        ReleaseMutex(EditContext->LoadMutex);
+    }
+
+    return Batch;
+}
+
+/**
+ Add all queued batches of loaded lines to the multiline edit control.
+
+ @param EditContext Pointer to the edit context.
+ */
+VOID
+EditDrainLoadBatches(
+    __in PEDIT_CONTEXT EditContext
+    )
+{
+    PEDIT_LOAD_BATCH Batch;
+
+    while (TRUE) {
+        Batch = EditDequeueLoadBatch(EditContext);
+        if (Batch == NULL) {
+            break;
+        }
+
+        if (YoriWinMultilineEditAppendLinesNoDataCopy(EditContext->MultilineEdit, Batch->LineArray, Batch->LinesPopulated)) {
+            Batch->LinesPopulated = 0;
+        }
+        EditFreeLoadBatch(Batch);
+    }
+}
+
+/**
+ Process a single opened stream, enumerating through all lines and queueing
+ batches of lines to add to the multiline edit control.  Each batch uses its
+ own buffers, so that once a batch is queued, the lines within it are only
+ manipulated by the thread that adds them to the control.
 
  @param EditContext Pointer to the edit context.
 
  @param hSource The opened source stream.
 
+ @param Background If TRUE, this function is running on a background thread,
+        and should queue lines in small batches that grow as the load
+        progresses, so the first lines can be displayed quickly.  If FALSE,
+        all lines are queued in a single batch.
+
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOLEAN
 EditPopulateFromStream(
     __in PEDIT_CONTEXT EditContext,
-    __in HANDLE hSource
+    __in HANDLE hSource,
+    __in BOOLEAN Background
     )
 {
     PVOID LineContext = NULL;
@@ -376,6 +575,7 @@ EditPopulateFromStream(
     BOOLEAN Result;
     YORI_ALLOC_SIZE_T LinesAllocated;
     YORI_ALLOC_SIZE_T LinesPopulated;
+    DWORD BatchLimit;
     DWORD BytesDesired;
     PYORI_STRING LineArray;
     YORI_LIB_LINE_ENDING FirstLineEnding;
@@ -386,13 +586,24 @@ EditPopulateFromStream(
     LinesAllocated = 0;
     LinesPopulated = 0;
 
+    if (Background) {
+        BatchLimit = 1024;
+    } else {
+        BatchLimit = (DWORD)-1;
+    }
+
     FirstLineEnding = YoriLibLineEndingNone;
+    EditContext->LoadFoundLines = FALSE;
 
     YoriLibInitEmptyString(&LineString);
     Result = TRUE;
 
     while (TRUE) {
 
+        if (EditContext->LoadCancelled) {
+            break;
+        }
+
         if (!YoriLibReadLineToStringEx(&LineString, &LineContext, TRUE, INFINITE, hSource, &LineEnding, &TimeoutReached)) {
             break;
         }
@@ -401,6 +612,35 @@ EditPopulateFromStream(
             FirstLineEnding = LineEnding;
         }
 
+        EditContext->LoadFoundLines = TRUE;
+
+        //
+        //  If the current batch is full, queue it.  The buffer is released
+        //  first so that the next line is placed in a new buffer, since
+        //  buffers referenced by a queued batch can be freed by another
+        //  thread.
+        //
+
+        if (LinesPopulated >= BatchLimit) {
+            if (Buffer != NULL) {
+                YoriLibDereference(Buffer);
+                Buffer = NULL;
+            }
+
+            if (!EditQueueLoadBatch(EditContext, LineArray, LinesPopulated)) {
+                Result = FALSE;
+                break;
+            }
+
+            LineArray = NULL;
+            LinesAllocated = 0;
+            LinesPopulated = 0;
+
+            if (BatchLimit < 64 * 1024) {
+                BatchLimit = BatchLimit * 2;
+            }
+        }
+
         BytesRequired = (LineString.LengthInChars + 1) * sizeof(TCHAR);
 
         //
@@ -455,6 +695,9 @@ EditPopulateFromStream(
             if (DesiredBytes < 0x1000) {
                 DesiredBytes = 0x1000;
             }
+            if (DesiredBytes > BatchLimit) {
+                DesiredBytes = BatchLimit;
+            }
             DesiredBytes = DesiredBytes * sizeof(YORI_STRING);
 
             BytesToAllocate = YoriLibMaximumAllocationInRange(RequiredBytes, DesiredBytes);
@@ -512,35 +755,163 @@ EditPopulateFromStream(
     YoriLibLineReadCloseOrCache(LineContext);
     YoriLibFreeStringContents(&LineString);
 
-    if (Result == FALSE) {
-        while (LinesPopulated > 0) {
-            YoriLibFreeStringContents(&LineArray[LinesPopulated - 1]);
-            LinesPopulated--;
-        }
+    EditContext->LoadFirstLineEnding = FirstLineEnding;
 
-        if (LineArray != NULL) {
-            YoriLibDereference(LineArray);
+    if (Result != FALSE && LinesPopulated > 0) {
+        if (EditQueueLoadBatch(EditContext, LineArray, LinesPopulated)) {
+            return TRUE;
         }
+        Result = FALSE;
+    }
 
-        return FALSE;
+    while (LinesPopulated > 0) {
+        YoriLibFreeStringContents(&LineArray[LinesPopulated - 1]);
+        LinesPopulated--;
+    }
+
+    if (LineArray != NULL) {
+        YoriLibDereference(LineArray);
+    }
+
+    return Result;
+}
+
+/**
+ The entrypoint for a background thread that loads the contents of a file.
+
+ @param Context Pointer to the edit context.
+
+ @return Zero to indicate success, nonzero to indicate failure.
+ */
+DWORD WINAPI
+EditLoadThread(
+    __in LPVOID Context
+    )
+{
+    PEDIT_CONTEXT EditContext;
+
+    EditContext = (PEDIT_CONTEXT)Context;
+    if (!EditPopulateFromStream(EditContext, EditContext->LoadSource, TRUE)) {
+        return EXIT_FAILURE;
     }
+    return EXIT_SUCCESS;
+}
 
-    if (LinesPopulated > 0) {
-        YoriWinMultilineEditAppendLinesNoDataCopy(EditContext->MultilineEdit, LineArray, LinesPopulated);
+/**
+ Update state once all lines from a file have been loaded, or once a load
+ has been cancelled.  On entry, the loading thread, if any, has terminated.
 
+ @param EditContext Pointer to the edit context.
+ */
+VOID
+EditCompleteLoad(
+    __in PEDIT_CONTEXT EditContext
+    )
+{
+    if (EditContext->LoadFoundLines) {
         YoriLibConstantString(&EditContext->Newline, _T("\r\n"));
-        if (FirstLineEnding == YoriLibLineEndingLF) {
+        if (EditContext->LoadFirstLineEnding == YoriLibLineEndingLF) {
             YoriLibConstantString(&EditContext->Newline, _T("\n"));
-        } else if (FirstLineEnding == YoriLibLineEndingCR) {
+        } else if (EditContext->LoadFirstLineEnding == YoriLibLineEndingCR) {
             YoriLibConstantString(&EditContext->Newline, _T("\r"));
         }
     }
 
-    if (LineArray != NULL) {
-        YoriLibDereference(LineArray);
+    YoriLibSetMultibyteInputEncoding(EditContext->LoadSavedEncoding);
+
+    if (EditContext->LoadThread != NULL) {
+        CloseHandle(EditContext->LoadThread);
+        EditContext->LoadThread = NULL;
     }
 
-    return Result;
+    if (EditContext->LoadSource != NULL) {
+        CloseHandle(EditContext->LoadSource);
+        EditContext->LoadSource = NULL;
+    }
+}
+
+/**
+ A callback invoked periodically by the multiline edit control while a file
+ is being loaded in the background.  This adds any lines that have been
+ loaded to the control.
+
+ @param Ctrl Pointer to the multiline edit control.
+
+ @return TRUE to indicate the load is still in progress and this function
+         should be invoked again, FALSE to indicate the load is complete.
+ */
+BOOLEAN
+EditLoadMore(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PEDIT_CONTEXT EditContext;
+    BOOLEAN LoadComplete;
+
+    EditContext = YoriWinGetControlContext(YoriWinGetControlParent(Ctrl));
+    ASSERT(EditContext->LoadThread != NULL);
+
+    //
+    //  Check for completion before adding lines, so that any lines queued
+    //  before the thread terminated are added below.
+    //
+
+    LoadComplete = FALSE;
+    if (WaitForSingleObject(EditContext->LoadThread, 0) == WAIT_OBJECT_0) {
+        LoadComplete = TRUE;
+    }
+
+    EditDrainLoadBatches(EditContext);
+
+    if (LoadComplete) {
+        EditCompleteLoad(EditContext);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ If a file is being loaded in the background, wait for the load to finish.
+
+ @param EditContext Pointer to the edit context.
+
+ @param Cancel If TRUE, the load is abandoned and any lines that have not
+        been added to the multiline edit control are discarded.  If FALSE,
+        all remaining lines are added to the control.
+ */
+VOID
+EditFinishLoad(
+    __in PEDIT_CONTEXT EditContext,
+    __in BOOLEAN Cancel
+    )
+{
+    PEDIT_LOAD_BATCH Batch;
+
+    if (EditContext->LoadThread == NULL) {
+        return;
+    }
+
+    if (Cancel) {
+        EditContext->LoadCancelled = TRUE;
+    }
+
+    WaitForSingleObject(EditContext->LoadThread, INFINITE);
+    YoriWinMultilineEditSetLoadMoreNotifyCallback(EditContext->MultilineEdit, NULL);
+
+    if (Cancel) {
+        while (TRUE) {
+            Batch = EditDequeueLoadBatch(EditContext);
+            if (Batch == NULL) {
+                break;
+            }
+            EditFreeLoadBatch(Batch);
+        }
+    } else {
+        EditDrainLoadBatches(EditContext);
+    }
+
+    EditCompleteLoad(EditContext);
 }
 
 /**
@@ -639,12 +1010,14 @@ EditLoadFile(
     )
 {
     HANDLE hFile;
-    DWORD SavedEncoding;
+    DWORD ThreadId;
 
     if (FileName->StartOfString == NULL) {
         return FALSE;
     }
 
+    EditFinishLoad(EditContext, TRUE);
+
     ASSERT(YoriLibIsStringNullTerminated(FileName));
 
     hFile = CreateFile(FileName->StartOfString, FILE_READ_DATA | FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
@@ -683,11 +1056,35 @@ EditLoadFile(
     }
 
     YoriWinMultilineEditClear(EditContext->MultilineEdit);
-    SavedEncoding = YoriLibGetMultibyteInputEncoding();
+    EditContext->LoadSavedEncoding = YoriLibGetMultibyteInputEncoding();
     YoriLibSetMultibyteInputEncoding(EditContext->Encoding);
-    EditPopulateFromStream(EditContext, hFile);
-    YoriLibSetMultibyteInputEncoding(SavedEncoding);
-    CloseHandle(hFile);
+    EditContext->LoadSource = hFile;
+    EditContext->LoadCancelled = FALSE;
+
+    //
+    //  Load the file on a background thread, adding lines to the control as
+    //  they become available, so large files can be viewed and edited
+    //  before they have been read completely.  If a thread cannot be
+    //  created, load the file synchronously.
+    //
+
+    if (EditContext->LoadMutex == NULL) {
+        EditContext->LoadMutex = CreateMutex(NULL, FALSE, NULL);
+    }
+
+    if (EditContext->LoadMutex != NULL) {
+        EditContext->LoadThread = CreateThread(NULL, 0, EditLoadThread, EditContext, 0, &ThreadId);
+        if (EditContext->LoadThread != NULL) {
+            if (!YoriWinMultilineEditSetLoadMoreNotifyCallback(EditContext->MultilineEdit, EditLoadMore)) {
+                EditFinishLoad(EditContext, FALSE);
+            }
+            return TRUE;
+        }
+    }
+
+    EditPopulateFromStream(EditContext, hFile, FALSE);
+    EditDrainLoadBatches(EditContext);
+    EditCompleteLoad(EditContext);
     return TRUE;
 }
 
@@ -978,6 +1375,7 @@ EditNewButtonClicked(
         return;
     }
 
+    EditFinishLoad(EditContext, TRUE);
     EditContext->WriteBom = FALSE;
     YoriWinMultilineEditClear(EditContext->MultilineEdit);
     YoriLibFreeStringContents(&EditContext->OpenFileName);
@@ -1312,6 +1710,8 @@ EditSaveButtonClicked(
     Parent = YoriWinGetControlParent(Ctrl);
     EditContext = YoriWinGetControlContext(Parent);
 
+    EditFinishLoad(EditContext, FALSE);
+
     if (EditContext->OpenFileName.StartOfString == NULL) {
         EditSaveAsButtonClicked(Ctrl);
         return;
@@ -1365,6 +1765,13 @@ EditSaveAsButtonClicked(
     Parent = YoriWinGetControlParent(Ctrl);
     EditContext = YoriWinGetControlContext(Parent);
 
+    //
+    //  Wait for any background load to complete so the entire file is
+    //  saved and the line ending of the file is known.
+    //
+
+    EditFinishLoad(EditContext, FALSE);
+
     EncodingCount = EditPopulateEncodingArray(EncodingValues, FALSE);
 
     YoriLibConstantString(&LineEndingValues[0].ValueText, _T("Windows (CRLF)"));
@@ -3143,6 +3550,7 @@ EditCreateMainWindow(
         Result = FALSE;
     }
 
+    EditFinishLoad(EditContext, TRUE);
     YoriWinDestroyWindow(Parent);
     YoriWinCloseWindowManager(WinMgr);
     return (BOOL)Result;
@@ -3218,6 +3626,7 @@ ENTRYPOINT(
     GlobalEditContext.TraditionalNavigation = TRUE;
     GlobalEditContext.AutoIndent = TRUE;
     GlobalEditContext.ExpandTab = FALSE;
+    YoriLibInitializeListHead(&GlobalEditContext.LoadBatchList);
 
     EditLoadDefaults(&GlobalEditContext);
 
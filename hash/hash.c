@@ -32,6 +32,11 @@
  */
 #define MS_PRIMITIVE_PROVIDER L"Microsoft Primitive Provider"
 
+/**
+ The largest digest generated by any supported algorithm, in bytes.
+ */
+#define HASH_MAXIMUM_DIGEST_SIZE 64
+
 /**
  Help text to display to the user.
  */
@@ -40,162 +45,1116 @@ CHAR strHashHelpText[] =
         "\n"
         "Hash a file.\n"
         "\n"
-        "HASH [-license] [-a <algorithm>] [-b] [-s] [<file>]\n"
+        "HASH [-license] [-a <algorithm>] [-b] [-j n] [-s] [<file>...]\n"
         "\n"
         "   -a <algorithm> Specify the hash algorithm. Supported algorithms:\n"
-        "                    MD4, MD5, SHA1, SHA256, SHA384, or SHA512\n"
+        "                    BLAKE3, MD4, MD5, SHA1, SHA256, SHA384, SHA512,\n"
+        "                    or XXH3\n"
         "   -b             Use basic search criteria for files only\n"
+        "   -j n           The number of files to hash concurrently\n"
         "   -s             Hash files in subdirectories\n";
 
 /**
- Display usage text to the user.
+ Display usage text to the user.
+ */
+BOOL
+HashHelp(VOID)
+{
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Hash %i.%02i\n"), YORI_VER_MAJOR, YORI_VER_MINOR);
+#if YORI_BUILD_ID
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  Build %i\n"), YORI_BUILD_ID);
+#endif
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%hs"), strHashHelpText);
+    return TRUE;
+}
+
+/**
+ Algorithms which are implemented within this program rather than by the
+ operating system.
+ */
+typedef enum _HASH_NATIVE_ALGORITHM {
+    HashNativeNone = 0,
+    HashNativeSha256 = 1,
+    HashNativeXxh3 = 2,
+    HashNativeBlake3 = 3
+} HASH_NATIVE_ALGORITHM;
+
+/**
+ A description of a supported hash algorithm.
+ */
+typedef struct _HASH_ALGORITHM {
+
+    /**
+     The name of the algorithm, as specified on the command line.
+     */
+    LPCTSTR Name;
+
+    /**
+     The algorithm in CALG_* format, if it is implemented by the operating
+     system.
+     */
+    DWORD CryptAlgorithm;
+
+    /**
+     The algorithm if it is implemented within this program, or
+     HashNativeNone if it is implemented by the operating system.
+     */
+    HASH_NATIVE_ALGORITHM NativeAlgorithm;
+
+    /**
+     The number of bytes in the digest of a native algorithm.
+     */
+    YORI_ALLOC_SIZE_T NativeHashLength;
+} HASH_ALGORITHM, *PHASH_ALGORITHM;
+
+/**
+ Constant pointer to a description of a supported hash algorithm.
+ */
+typedef HASH_ALGORITHM CONST *PCHASH_ALGORITHM;
+
+/**
+ The supported hash algorithms.
+ */
+CONST HASH_ALGORITHM HashAlgorithms[] = {
+    {_T("BLAKE3"), 0,            HashNativeBlake3, YORI_LIB_BLAKE3_DIGEST_SIZE},
+    {_T("MD4"),    CALG_MD4,     HashNativeNone,   0},
+    {_T("MD5"),    CALG_MD5,     HashNativeNone,   0},
+    {_T("SHA1"),   CALG_SHA1,    HashNativeNone,   0},
+    {_T("SHA256"), 0,            HashNativeSha256, YORI_LIB_SHA256_DIGEST_SIZE},
+    {_T("SHA384"), CALG_SHA_384, HashNativeNone,   0},
+    {_T("SHA512"), CALG_SHA_512, HashNativeNone,   0},
+    {_T("XXH3"),   0,            HashNativeXxh3,   YORI_LIB_XXH3_DIGEST_SIZE},
+};
+
+/**
+ State used to hash a single stream at a time.  Each thread hashing files
+ has its own stream state.
+ */
+typedef struct _HASH_STREAM {
+
+    /**
+     Two buffers to read data from the file into.  One is being hashed while
+     data is read into the other.
+     */
+    PUCHAR ReadBuffers[2];
+
+    /**
+     An event used to wait for reads to complete.
+     */
+    HANDLE ReadEvent;
+
+    /**
+     WinCrypt handle to the hash being calculated, for algorithms
+     implemented by the operating system.
+     */
+    DWORD_PTR CryptHash;
+
+    /**
+     The state of the hash being calculated, for algorithms implemented by
+     this program.
+     */
+    union {
+        YORI_LIB_SHA256_CONTEXT Sha256;
+        YORI_LIB_XXH3_CONTEXT Xxh3;
+        YORI_LIB_BLAKE3_CONTEXT Blake3;
+    } Native;
+
+    /**
+     The result of the hash calculation.
+     */
+    UCHAR HashBuffer[HASH_MAXIMUM_DIGEST_SIZE];
+} HASH_STREAM, *PHASH_STREAM;
+
+/**
+ A file which has been found and whose hash is being calculated.  Files are
+ kept in the order they were found until their result is displayed, so that
+ output is deterministic regardless of the order in which threads complete
+ their work.
+ */
+typedef struct _HASH_PENDING_FILE {
+
+    /**
+     The list of files waiting to be hashed by worker threads.
+     */
+    YORI_LIST_ENTRY PendingList;
+
+    /**
+     The list of files waiting for their result to be displayed.
+     */
+    YORI_LIST_ENTRY OutputList;
+
+    /**
+     Fully qualified path to the file.
+     */
+    YORI_STRING FilePath;
+
+    /**
+     The path to display, which refers to the end of FilePath.
+     */
+    YORI_STRING RelativePath;
+
+    /**
+     The hex representation of the hash, once it has been calculated.
+     */
+    YORI_STRING HashString;
+
+    /**
+     The error encountered opening the file, or ERROR_SUCCESS if the file
+     was opened.
+     */
+    SYSERR OpenError;
+
+    /**
+     TRUE if a failure to open the file should be displayed.
+     */
+    BOOLEAN ReportOpenError;
+
+    /**
+     TRUE if the file has been processed and its result can be displayed.
+     */
+    BOOLEAN Complete;
+
+    /**
+     TRUE if the hash was calculated successfully.
+     */
+    BOOLEAN Hashed;
+} HASH_PENDING_FILE, *PHASH_PENDING_FILE;
+
+/**
+ A worker thread which hashes files, along with its stream state.
+ */
+typedef struct _HASH_WORKER {
+
+    /**
+     Pointer to the hash context.
+     */
+    struct _HASH_CONTEXT *HashContext;
+
+    /**
+     Handle to the thread.
+     */
+    HANDLE Thread;
+
+    /**
+     The stream state used by this thread.
+     */
+    HASH_STREAM Stream;
+} HASH_WORKER, *PHASH_WORKER;
+
+/**
+ Context passed to the callback which is invoked for each file found.
+ */
+typedef struct _HASH_CONTEXT {
+
+    /**
+     TRUE if file enumeration is being performed recursively; FALSE if it is
+     in one directory only.
+     */
+    BOOLEAN Recursive;
+
+    /**
+     WinCrypt handle to the algorithm provider.  If 0, the algorithm provider
+     has not been initialized.
+     */
+    DWORD_PTR Provider;
+
+    /**
+     The first error encountered when enumerating objects from a single arg.
+     This is used to preserve file not found/path not found errors so that
+     when the program falls back to interpreting the argument as a literal,
+     if that still doesn't work, this is the error code that is displayed.
+     */
+    SYSERR SavedErrorThisArg;
+
+    /**
+     The algorithm to use.
+     */
+    PCHASH_ALGORITHM Algorithm;
+
+    /**
+     Specifies the number of bytes in the result of the hash calculation.
+     */
+    YORI_ALLOC_SIZE_T HashLength;
+
+    /**
+     Specifies the number of bytes in each read buffer.
+     */
+    YORI_ALLOC_SIZE_T ReadBufferLength;
+
+    /**
+     The stream state used by the enumerating thread.
+     */
+    HASH_STREAM Stream;
+
+    /**
+     The list of files waiting to be hashed by worker threads.
+     */
+    YORI_LIST_ENTRY PendingList;
+
+    /**
+     The list of files in the order they were found, waiting for their
+     result to be displayed.
+     */
+    YORI_LIST_ENTRY OutputList;
+
+    /**
+     A mutex to synchronize the lists of files and the count of files
+     processed.  This is NULL if files are not hashed concurrently.
+     */
+    HANDLE Mutex;
+
+    /**
+     An event signalled when a file is inserted into the list.  Worker
+     threads wait on this and the following event together.
+     */
+    HANDLE WorkerWaitEvent;
+
+    /**
+     An event signalled when worker threads should complete outstanding work
+     then terminate.
+     */
+    HANDLE WorkerShutdownEvent;
+
+    /**
+     An array of worker threads hashing files.
+     */
+    PHASH_WORKER Workers;
+
+    /**
+     The maximum number of files to hash concurrently.  This corresponds to
+     the size of the Workers array.
+     */
+    DWORD MaxThreads;
+
+    /**
+     The number of worker threads which have been created.  This is less
+     than or equal to MaxThreads.
+     */
+    DWORD ThreadsAllocated;
+
+    /**
+     The number of files currently queued in the pending list.
+     */
+    DWORD ItemsQueued;
+
+    /**
+     Records the total number of files opened for hashing.
+     */
+    LONGLONG FilesFound;
+
+    /**
+     Records the total number of files found within a single command line
+     argument.
+     */
+    LONGLONG FilesFoundThisArg;
+
+} HASH_CONTEXT, *PHASH_CONTEXT;
+
+/**
+ Prepare to calculate a hash.
+
+ @param HashContext Pointer to the hash context specifying the algorithm.
+
+ @param Stream Pointer to the stream state to use.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+HashBegin(
+    __in PHASH_CONTEXT HashContext,
+    __inout PHASH_STREAM Stream
+    )
+{
+    switch(HashContext->Algorithm->NativeAlgorithm) {
+        case HashNativeSha256:
+            YoriLibSha256Initialize(&Stream->Native.Sha256);
+            break;
+        case HashNativeXxh3:
+            YoriLibXxh3Initialize(&Stream->Native.Xxh3);
+            break;
+        case HashNativeBlake3:
+            YoriLibBlake3Initialize(&Stream->Native.Blake3);
+            break;
+        default:
+            if (!DllAdvApi32.pCryptCreateHash(HashContext->Provider, HashContext->Algorithm->CryptAlgorithm, 0, 0, &Stream->CryptHash)) {
+                return FALSE;
+            }
+            break;
+    }
+
+    return TRUE;
+}
+
+/**
+ Add data to a hash.
+
+ @param HashContext Pointer to the hash context specifying the algorithm.
+
+ @param Stream Pointer to the stream state.
+
+ @param Buffer Pointer to the data to add.
+
+ @param Length The number of bytes in Buffer.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+HashData(
+    __in PHASH_CONTEXT HashContext,
+    __inout PHASH_STREAM Stream,
+    __in PUCHAR Buffer,
+    __in DWORD Length
+    )
+{
+    switch(HashContext->Algorithm->NativeAlgorithm) {
+        case HashNativeSha256:
+            YoriLibSha256Update(&Stream->Native.Sha256, Buffer, Length);
+            break;
+        case HashNativeXxh3:
+            YoriLibXxh3Update(&Stream->Native.Xxh3, Buffer, Length);
+            break;
+        case HashNativeBlake3:
+            YoriLibBlake3Update(&Stream->Native.Blake3, Buffer, Length);
+            break;
+        default:
+            if (!DllAdvApi32.pCryptHashData(Stream->CryptHash, Buffer, Length, 0)) {
+                return FALSE;
+            }
+            break;
+    }
+
+    return TRUE;
+}
+
+/**
+ Complete a hash, returning its result in hex form if requested.  This must
+ be called after each successful call to @ref HashBegin.
+
+ @param HashContext Pointer to the hash context specifying the algorithm.
+
+ @param Stream Pointer to the stream state.
+
+ @param HashString Optionally points to a string to populate with the hex
+        representation of the hash.  If NULL, the hash is abandoned.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+HashEnd(
+    __in PHASH_CONTEXT HashContext,
+    __inout PHASH_STREAM Stream,
+    __inout_opt PYORI_STRING HashString
+    )
+{
+    DWORD HashLength;
+    BOOL Result;
+
+    Result = TRUE;
+    switch(HashContext->Algorithm->NativeAlgorithm) {
+        case HashNativeSha256:
+            YoriLibSha256Finalize(&Stream->Native.Sha256, Stream->HashBuffer);
+            break;
+        case HashNativeXxh3:
+            YoriLibXxh3Finalize(&Stream->Native.Xxh3, Stream->HashBuffer);
+            break;
+        case HashNativeBlake3:
+            YoriLibBlake3Finalize(&Stream->Native.Blake3, Stream->HashBuffer);
+            break;
+        default:
+            if (HashString != NULL) {
+                HashLength = HashContext->HashLength;
+                if (!DllAdvApi32.pCryptGetHashParam(Stream->CryptHash, HP_HASHVAL, Stream->HashBuffer, &HashLength, 0)) {
+                    Result = FALSE;
+                }
+            }
+            DllAdvApi32.pCryptDestroyHash(Stream->CryptHash);
+            Stream->CryptHash = 0;
+            break;
+    }
+
+    if (Result && HashString != NULL) {
+        if (!YoriLibHexBufferToString(Stream->HashBuffer, HashContext->HashLength, HashString)) {
+            Result = FALSE;
+        }
+    }
+
+    return Result;
+}
+
+/**
+ Hash a stream which is read synchronously, such as a pipe.
+
+ @param hSource A handle to the incoming stream, which may be a file or a
+        pipe.
+
+ @param HashContext Pointer to a context describing the actions to perform.
+
+ @param Stream Pointer to the stream state to use.
+
+ @return ERROR_SUCCESS to indicate success, or an error code to indicate
+         failure.
+ */
+SYSERR
+HashReadSynchronous(
+    __in HANDLE hSource,
+    __in PHASH_CONTEXT HashContext,
+    __inout PHASH_STREAM Stream
+    )
+{
+    DWORD BytesRead;
+
+    while (TRUE) {
+        if (!ReadFile(hSource, Stream->ReadBuffers[0], HashContext->ReadBufferLength, &BytesRead, NULL)) {
+            // MSFIX: Distinguish errors here better? EOF means success,
+            // read error means hash is wrong.  Could be reading from a pipe
+            // etc though
+            break;
+        }
+
+        if (BytesRead == 0) {
+            break;
+        }
+
+        if (!HashData(HashContext, Stream, Stream->ReadBuffers[0], BytesRead)) {
+            return GetLastError();
+        }
+    }
+
+    return ERROR_SUCCESS;
+}
+
+/**
+ Start reading from a source opened for overlapped IO.
+
+ @param SourceHandle Handle to the source.
+
+ @param Buffer Pointer to the buffer to read into.
+
+ @param BufferSize The number of bytes to read.
+
+ @param Offset The offset within the source to read from.  This is ignored
+        by devices which do not support seeking.
+
+ @param Overlapped Pointer to the overlapped structure to use for the read.
+        The caller should initialize hEvent, which is preserved.
+
+ @return ERROR_SUCCESS to indicate the read was started, ERROR_HANDLE_EOF to
+         indicate there is no more data, or another error code to indicate
+         failure.
+ */
+SYSERR
+HashStartRead(
+    __in HANDLE SourceHandle,
+    __out_bcount(BufferSize) PVOID Buffer,
+    __in DWORD BufferSize,
+    __in LONGLONG Offset,
+    __inout LPOVERLAPPED Overlapped
+    )
+{
+    HANDLE Event;
+    SYSERR LastError;
+
+    Event = Overlapped->hEvent;
+    ZeroMemory(Overlapped, sizeof(OVERLAPPED));
+    Overlapped->hEvent = Event;
+    Overlapped->Offset = (DWORD)Offset;
+    Overlapped->OffsetHigh = (DWORD)(Offset >> 32);
+
+    if (ReadFile(SourceHandle, Buffer, BufferSize, NULL, Overlapped)) {
+        return ERROR_SUCCESS;
+    }
+
+    LastError = GetLastError();
+    if (LastError == ERROR_IO_PENDING) {
+        return ERROR_SUCCESS;
+    }
+
+    if (LastError == ERROR_BROKEN_PIPE) {
+        LastError = ERROR_HANDLE_EOF;
+    }
+
+    return LastError;
+}
+
+/**
+ Wait for a read started with @ref HashStartRead to complete.
+
+ @param SourceHandle Handle to the source.
+
+ @param Overlapped Pointer to the overlapped structure used for the read.
+
+ @param BytesRead On successful completion, updated to contain the number of
+        bytes read.  This is zero at the end of the source.
+
+ @return ERROR_SUCCESS to indicate success, or an error code to indicate
+         failure.
+ */
+SYSERR
+HashCompleteRead(
+    __in HANDLE SourceHandle,
+    __in LPOVERLAPPED Overlapped,
+    __out PDWORD BytesRead
+    )
+{
+    SYSERR LastError;
+
+    *BytesRead = 0;
+    if (GetOverlappedResult(SourceHandle, Overlapped, BytesRead, TRUE)) {
+        return ERROR_SUCCESS;
+    }
+
+    LastError = GetLastError();
+    if (LastError == ERROR_HANDLE_EOF || LastError == ERROR_BROKEN_PIPE) {
+        *BytesRead = 0;
+        return ERROR_SUCCESS;
+    }
+
+    return LastError;
+}
+
+/**
+ Hash a stream opened for overlapped IO.  Data is read into two buffers, so
+ the next block is being read while the previous one is hashed.
+
+ @param hSource A handle to the incoming stream, which was opened for
+        overlapped IO.
+
+ @param HashContext Pointer to a context describing the actions to perform.
+
+ @param Stream Pointer to the stream state to use.
+
+ @return ERROR_SUCCESS to indicate success, or an error code to indicate
+         failure.
+ */
+SYSERR
+HashReadOverlapped(
+    __in HANDLE hSource,
+    __in PHASH_CONTEXT HashContext,
+    __inout PHASH_STREAM Stream
+    )
+{
+    OVERLAPPED ReadOverlapped;
+    LONGLONG ReadOffset;
+    DWORD BufferIndex;
+    DWORD BytesRead;
+    SYSERR LastError;
+    BOOLEAN ReadStarted;
+
+    ReadOverlapped.hEvent = Stream->ReadEvent;
+    ReadOffset = 0;
+    BufferIndex = 0;
+
+    LastError = HashStartRead(hSource, Stream->ReadBuffers[BufferIndex], HashContext->ReadBufferLength, ReadOffset, &ReadOverlapped);
+
+    //
+    //  Systems which don't support overlapped IO on files fail the first
+    //  read, and ignored the request to open the file for overlapped IO,
+    //  so read it synchronously instead.
+    //
+
+    if (LastError == ERROR_INVALID_PARAMETER) {
+        return HashReadSynchronous(hSource, HashContext, Stream);
+    }
+
+    ReadStarted = (BOOLEAN)(LastError == ERROR_SUCCESS);
+
+    while (ReadStarted) {
+        LastError = HashCompleteRead(hSource, &ReadOverlapped, &BytesRead);
+        ReadStarted = FALSE;
+        if (LastError != ERROR_SUCCESS || BytesRead == 0) {
+            break;
+        }
+
+        //
+        //  Start reading the next block into the other buffer before
+        //  hashing this one.
+        //
+
+        ReadOffset = ReadOffset + BytesRead;
+        LastError = HashStartRead(hSource, Stream->ReadBuffers[BufferIndex ^ 1], HashContext->ReadBufferLength, ReadOffset, &ReadOverlapped);
+        if (LastError == ERROR_SUCCESS) {
+            ReadStarted = TRUE;
+        } else if (LastError != ERROR_HANDLE_EOF) {
+            break;
+        }
+
+        if (!HashData(HashContext, Stream, Stream->ReadBuffers[BufferIndex], BytesRead)) {
+            LastError = GetLastError();
+            break;
+        }
+
+        BufferIndex = BufferIndex ^ 1;
+    }
+
+    //
+    //  If a read is still outstanding because hashing failed, it must
+    //  complete before its buffer is reused.
+    //
+
+    if (ReadStarted) {
+        GetOverlappedResult(hSource, &ReadOverlapped, &BytesRead, TRUE);
+    }
+
+    if (LastError == ERROR_HANDLE_EOF) {
+        LastError = ERROR_SUCCESS;
+    }
+
+    return LastError;
+}
+
+/**
+ Calculate the hash of a single stream.
+
+ @param hSource A handle to the incoming stream, which may be a file or a
+        pipe.
+
+ @param Overlapped TRUE if the stream was opened for overlapped IO, FALSE
+        if it should be read synchronously.
+
+ @param HashContext Pointer to a context describing the actions to perform.
+
+ @param Stream Pointer to the stream state to use.
+
+ @param HashString On successful completion, populated with the hex
+        representation of the hash.  This string should have been allocated
+        by the caller to be large enough.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+HashProcessStream(
+    __in HANDLE hSource,
+    __in BOOLEAN Overlapped,
+    __in PHASH_CONTEXT HashContext,
+    __inout PHASH_STREAM Stream,
+    __inout PYORI_STRING HashString
+    )
+{
+    SYSERR Err;
+
+    if (!HashBegin(HashContext, Stream)) {
+        return FALSE;
+    }
+
+    if (Overlapped) {
+        Err = HashReadOverlapped(hSource, HashContext, Stream);
+    } else {
+        Err = HashReadSynchronous(hSource, HashContext, Stream);
+    }
+
+    if (Err != ERROR_SUCCESS) {
+        HashEnd(HashContext, Stream, NULL);
+        return FALSE;
+    }
+
+    return HashEnd(HashContext, Stream, HashString);
+}
+
+/**
+ Open and hash a file which has been found.
+
+ @param HashContext Pointer to the hash context.
+
+ @param Stream Pointer to the stream state to use.
+
+ @param PendingFile Pointer to the file to hash.  On completion, this is
+        updated with the result.
+ */
+VOID
+HashProcessPendingFile(
+    __in PHASH_CONTEXT HashContext,
+    __inout PHASH_STREAM Stream,
+    __inout PHASH_PENDING_FILE PendingFile
+    )
+{
+    HANDLE FileHandle;
+
+    FileHandle = CreateFile(PendingFile->FilePath.StartOfString,
+                            GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN,
+                            NULL);
+
+    if (FileHandle == NULL || FileHandle == INVALID_HANDLE_VALUE) {
+        PendingFile->OpenError = GetLastError();
+        return;
+    }
+
+    PendingFile->OpenError = ERROR_SUCCESS;
+    if (HashProcessStream(FileHandle, TRUE, HashContext, Stream, &PendingFile->HashString)) {
+        PendingFile->Hashed = TRUE;
+    }
+
+    CloseHandle(FileHandle);
+}
+
+/**
+ Mark a file as processed, and display the result of every processed file
+ which is not waiting for an earlier file to be processed.
+
+ @param HashContext Pointer to the hash context.
+
+ @param PendingFile Pointer to the file which has been processed.
+ */
+VOID
+HashCompletePendingFile(
+    __in PHASH_CONTEXT HashContext,
+    __in PHASH_PENDING_FILE PendingFile
+    )
+{
+    LPTSTR ErrText;
+
+    if (HashContext->Mutex != NULL) {
+        WaitForSingleObject(HashContext->Mutex, INFINITE);
+    }
+
+    PendingFile->Complete = TRUE;
+    if (PendingFile->OpenError == ERROR_SUCCESS) {
+        HashContext->FilesFound++;
+    }
+
+    while (!YoriLibIsListEmpty(&HashContext->OutputList)) {
+        PendingFile = CONTAINING_RECORD(HashContext->OutputList.Next, HASH_PENDING_FILE, OutputList);
+        if (!PendingFile->Complete) {
+            break;
+        }
+
+        if (PendingFile->Hashed) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y %y\n"), &PendingFile->HashString, &PendingFile->RelativePath);
+        } else if (PendingFile->OpenError != ERROR_SUCCESS && PendingFile->ReportOpenError) {
+            ErrText = YoriLibGetWinErrorText(PendingFile->OpenError);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hash: open of %y failed: %s"), &PendingFile->FilePath, ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+        }
+
+        YoriLibRemoveListItem(&PendingFile->OutputList);
+        YoriLibFree(PendingFile);
+    }
+
+    if (HashContext->Mutex != NULL) {
+        ReleaseMutex(HashContext->Mutex);
+    }
+}
+
+/**
+ A worker thread which hashes files queued by the enumerating thread.
+
+ @param Context Pointer to the worker, which refers to the hash context.
+
+ @return Zero.
+ */
+DWORD WINAPI
+HashWorker(
+    __in LPVOID Context
+    )
+{
+    PHASH_WORKER Worker = (PHASH_WORKER)Context;
+    PHASH_CONTEXT HashContext = Worker->HashContext;
+    PHASH_PENDING_FILE PendingFile;
+    DWORD FoundEvent;
+
+    while (TRUE) {
+
+        //
+        //  Wait for an indication of more work or shutdown.
+        //
+
+        FoundEvent = WaitForMultipleObjectsEx(2, &HashContext->WorkerWaitEvent, FALSE, INFINITE, FALSE);
+
+        //
+        //  Process any queued work.
+        //
+
+        while (TRUE) {
+            WaitForSingleObject(HashContext->Mutex, INFINITE);
+            if (!YoriLibIsListEmpty(&HashContext->PendingList)) {
+                PendingFile = CONTAINING_RECORD(HashContext->PendingList.Next, HASH_PENDING_FILE, PendingList);
+                ASSERT(HashContext->ItemsQueued > 0);
+                HashContext->ItemsQueued--;
+                YoriLibRemoveListItem(&PendingFile->PendingList);
+                ReleaseMutex(HashContext->Mutex);
+
+                HashProcessPendingFile(HashContext, &Worker->Stream, PendingFile);
+                HashCompletePendingFile(HashContext, PendingFile);
+
+            } else {
+                ASSERT(HashContext->ItemsQueued == 0);
+                ReleaseMutex(HashContext->Mutex);
+                break;
+            }
+        }
+
+        //
+        //  If shutdown was requested, terminate the thread.
+        //
+
+        if (FoundEvent == (WAIT_OBJECT_0 + 1)) {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ Allocate the buffers used to hash a stream.
+
+ @param HashContext Pointer to the hash context, specifying the size of
+        buffers to allocate.
+
+ @param Stream Pointer to the stream state to initialize.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
  */
+__success(return)
 BOOL
-HashHelp(VOID)
+HashInitializeStream(
+    __in PHASH_CONTEXT HashContext,
+    __out PHASH_STREAM Stream
+    )
 {
-    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Hash %i.%02i\n"), YORI_VER_MAJOR, YORI_VER_MINOR);
-#if YORI_BUILD_ID
-    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  Build %i\n"), YORI_BUILD_ID);
-#endif
-    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%hs"), strHashHelpText);
+    ZeroMemory(Stream, sizeof(HASH_STREAM));
+
+    Stream->ReadBuffers[0] = YoriLibMalloc(HashContext->ReadBufferLength * 2);
+    if (Stream->ReadBuffers[0] == NULL) {
+        return FALSE;
+    }
+    Stream->ReadBuffers[1] = Stream->ReadBuffers[0] + HashContext->ReadBufferLength;
+
+    Stream->ReadEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (Stream->ReadEvent == NULL) {
+        YoriLibFree(Stream->ReadBuffers[0]);
+        Stream->ReadBuffers[0] = NULL;
+        return FALSE;
+    }
+
     return TRUE;
 }
 
 /**
- Context passed to the callback which is invoked for each file found.
+ Free the buffers used to hash a stream.
+
+ @param Stream Pointer to the stream state to clean up.
  */
-typedef struct _HASH_CONTEXT {
+VOID
+HashCleanupStream(
+    __in PHASH_STREAM Stream
+    )
+{
+    if (Stream->ReadBuffers[0] != NULL) {
+        YoriLibFree(Stream->ReadBuffers[0]);
+        Stream->ReadBuffers[0] = NULL;
+        Stream->ReadBuffers[1] = NULL;
+    }
 
-    /**
-     TRUE if file enumeration is being performed recursively; FALSE if it is
-     in one directory only.
-     */
-    BOOLEAN Recursive;
+    if (Stream->ReadEvent != NULL) {
+        CloseHandle(Stream->ReadEvent);
+        Stream->ReadEvent = NULL;
+    }
+}
 
-    /**
-     WinCrypt handle to the algorithm provider.  If 0, the algorithm provider
-     has not been initialized.
-     */
-    DWORD_PTR Provider;
+/**
+ Prepare to hash files concurrently on worker threads.  Threads are created
+ as files are queued.
 
-    /**
-     The first error encountered when enumerating objects from a single arg.
-     This is used to preserve file not found/path not found errors so that
-     when the program falls back to interpreting the argument as a literal,
-     if that still doesn't work, this is the error code that is displayed.
-     */
-    SYSERR SavedErrorThisArg;
+ @param HashContext Pointer to the hash context.
 
-    /**
-     The algorithm to use in CALG_* format.
-     */
-    DWORD Algorithm;
+ @param MaxThreads The maximum number of files to hash concurrently.
 
-    /**
-     Pointer to a blob of memory containing the result of the hash calculation
-     for each file.
-     */
-    PUCHAR HashBuffer;
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+HashInitializeWorkers(
+    __in PHASH_CONTEXT HashContext,
+    __in DWORD MaxThreads
+    )
+{
+    HashContext->MaxThreads = MaxThreads;
+    if (MaxThreads <= 1) {
+        return TRUE;
+    }
 
-    /**
-     Specifies the number of bytes in HashBuffer.
-     */
-    YORI_ALLOC_SIZE_T HashLength;
+    HashContext->Workers = YoriLibMalloc(MaxThreads * sizeof(HASH_WORKER));
+    if (HashContext->Workers == NULL) {
+        return FALSE;
+    }
 
-    /**
-     Pointer to a buffer to read data from the file into.
-     */
-    PVOID ReadBuffer;
+    HashContext->Mutex = CreateMutex(NULL, FALSE, NULL);
+    if (HashContext->Mutex == NULL) {
+        return FALSE;
+    }
 
-    /**
-     Specifies the number of bytes in ReadBuffer.
-     */
-    YORI_ALLOC_SIZE_T ReadBufferLength;
+    HashContext->WorkerWaitEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (HashContext->WorkerWaitEvent == NULL) {
+        return FALSE;
+    }
 
-    /**
-     A string which contains enough characters to contain the hex
-     representation of HashBuffer plus a NULL terminator.
-     */
-    YORI_STRING HashString;
+    HashContext->WorkerShutdownEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (HashContext->WorkerShutdownEvent == NULL) {
+        return FALSE;
+    }
 
-    /**
-     Records the total number of files processed.
-     */
-    LONGLONG FilesFound;
+    return TRUE;
+}
 
-    /**
-     Records the total number of files processed within a single command line
-     argument.
-     */
-    LONGLONG FilesFoundThisArg;
+/**
+ Create a new worker thread.  This is called with the mutex held.
 
-} HASH_CONTEXT, *PHASH_CONTEXT;
+ @param HashContext Pointer to the hash context.
+ */
+VOID
+HashCreateWorker(
+    __in PHASH_CONTEXT HashContext
+    )
+{
+    PHASH_WORKER Worker;
+    DWORD ThreadId;
+
+    Worker = &HashContext->Workers[HashContext->ThreadsAllocated];
+    if (!HashInitializeStream(HashContext, &Worker->Stream)) {
+        return;
+    }
+
+    Worker->HashContext = HashContext;
+    Worker->Thread = CreateThread(NULL, 0, HashWorker, Worker, 0, &ThreadId);
+    if (Worker->Thread == NULL) {
+        HashCleanupStream(&Worker->Stream);
+        return;
+    }
+
+    HashContext->ThreadsAllocated++;
+}
 
 /**
- Take a single incoming stream and break it into pieces.
+ Hash a file on a worker thread if one is available, or on the calling thread
+ if not.  The calling thread hashes the file if concurrency was not
+ requested, if the caller needs to know whether the file could be opened, or
+ if the worker threads already have an excessively large queue of work,
+ which prevents the enumerating thread from continuing to add items that the
+ workers can't get to.  Either way, the result is displayed after the result
+ of every file queued before it.
 
- @param hSource A handle to the incoming stream, which may be a file or a
-        pipe.
- 
- @param HashContext Pointer to a context describing the actions to perform.
+ @param HashContext Pointer to the hash context.
 
- @return TRUE to indicate success, FALSE to indicate failure.
+ @param FilePath Pointer to the fully qualified file name.
+
+ @param RelativePathOffset The offset within FilePath of the path to
+        display.
+
+ @param ProcessInline If TRUE, the file is hashed on the calling thread.
+
+ @return ERROR_SUCCESS if the file was queued or opened, or the error
+         encountered opening the file.
  */
-BOOL
-HashProcessStream(
-    __in HANDLE hSource,
-    __in PHASH_CONTEXT HashContext
+SYSERR
+HashQueueFile(
+    __in PHASH_CONTEXT HashContext,
+    __in PYORI_STRING FilePath,
+    __in YORI_ALLOC_SIZE_T RelativePathOffset,
+    __in BOOLEAN ProcessInline
     )
 {
-    DWORD Err;
-    DWORD_PTR hHash;
-    DWORD BytesRead;
+    PHASH_PENDING_FILE PendingFile;
+    YORI_ALLOC_SIZE_T BytesRequired;
+    YORI_ALLOC_SIZE_T HashChars;
+    BOOLEAN Queued;
+    SYSERR OpenError;
 
-    HashContext->FilesFound++;
-    HashContext->FilesFoundThisArg++;
+    ASSERT(YoriLibIsStringNullTerminated(FilePath));
 
-    if (!DllAdvApi32.pCryptCreateHash(HashContext->Provider, HashContext->Algorithm, 0, 0, &hHash)) {
-        return FALSE;
+    HashChars = HashContext->HashLength * 2 + 1;
+    BytesRequired = sizeof(HASH_PENDING_FILE) + (FilePath->LengthInChars + 1 + HashChars) * sizeof(TCHAR);
+    PendingFile = YoriLibMalloc(BytesRequired);
+    if (PendingFile == NULL) {
+        return ERROR_NOT_ENOUGH_MEMORY;
     }
 
+    ZeroMemory(PendingFile, sizeof(HASH_PENDING_FILE));
 
-    Err = ERROR_SUCCESS;
-    while (TRUE) {
-        if (!ReadFile(hSource, HashContext->ReadBuffer, HashContext->ReadBufferLength, &BytesRead, NULL)) {
-            // MSFIX: Distinguish errors here better? EOF means success,
-            // read error means hash is wrong.  Could be reading from a pipe
-            // etc though
-            break;
-        }
+    PendingFile->FilePath.StartOfString = (LPTSTR)(PendingFile + 1);
+    PendingFile->FilePath.LengthInChars = FilePath->LengthInChars;
+    PendingFile->FilePath.LengthAllocated = FilePath->LengthInChars + 1;
+    memcpy(PendingFile->FilePath.StartOfString, FilePath->StartOfString, (FilePath->LengthInChars + 1) * sizeof(TCHAR));
 
-        if (BytesRead == 0) {
-            break;
+    PendingFile->RelativePath.StartOfString = &PendingFile->FilePath.StartOfString[RelativePathOffset];
+    PendingFile->RelativePath.LengthInChars = FilePath->LengthInChars - RelativePathOffset;
+
+    PendingFile->HashString.StartOfString = PendingFile->FilePath.StartOfString + PendingFile->FilePath.LengthAllocated;
+    PendingFile->HashString.LengthAllocated = HashChars;
+
+    PendingFile->ReportOpenError = (BOOLEAN)(HashContext->SavedErrorThisArg == ERROR_SUCCESS);
+
+    Queued = FALSE;
+    if (HashContext->Mutex != NULL) {
+        WaitForSingleObject(HashContext->Mutex, INFINITE);
+    }
+
+    YoriLibAppendList(&HashContext->OutputList, &PendingFile->OutputList);
+
+    if (!ProcessInline && HashContext->MaxThreads > 1) {
+        if (HashContext->ThreadsAllocated < HashContext->MaxThreads &&
+            HashContext->ItemsQueued >= HashContext->ThreadsAllocated) {
+
+            HashCreateWorker(HashContext);
         }
 
-        if (!DllAdvApi32.pCryptHashData(hHash, HashContext->ReadBuffer, BytesRead, 0)) {
-            Err = GetLastError();
-            break;
+        if (HashContext->ThreadsAllocated > 0 &&
+            HashContext->ItemsQueued < HashContext->MaxThreads * 2) {
+
+            YoriLibAppendList(&HashContext->PendingList, &PendingFile->PendingList);
+            HashContext->ItemsQueued++;
+            Queued = TRUE;
         }
+    }
 
+    if (HashContext->Mutex != NULL) {
+        ReleaseMutex(HashContext->Mutex);
     }
 
-    if (Err == ERROR_SUCCESS) {
-        DWORD HashLength;
-        HashLength = HashContext->HashLength;
-        if (DllAdvApi32.pCryptGetHashParam(hHash, HP_HASHVAL, HashContext->HashBuffer, &HashLength, 0)) {
-            if (!YoriLibHexBufferToString(HashContext->HashBuffer, HashContext->HashLength, &HashContext->HashString)) {
-                Err = !(ERROR_SUCCESS);
-            }
-        }
+    if (Queued) {
+        SetEvent(HashContext->WorkerWaitEvent);
+        return ERROR_SUCCESS;
     }
 
-    DllAdvApi32.pCryptDestroyHash(hHash);
+    HashProcessPendingFile(HashContext, &HashContext->Stream, PendingFile);
+    OpenError = PendingFile->OpenError;
+    HashCompletePendingFile(HashContext, PendingFile);
+    return OpenError;
+}
 
-    if (Err != STATUS_SUCCESS) {
-        return FALSE;
+/**
+ Wait for worker threads to hash all queued files, then terminate them.
+
+ @param HashContext Pointer to the hash context.
+ */
+VOID
+HashWaitForWorkers(
+    __in PHASH_CONTEXT HashContext
+    )
+{
+    DWORD Index;
+
+    if (HashContext->ThreadsAllocated == 0) {
+        return;
     }
 
-    return TRUE;
+    SetEvent(HashContext->WorkerShutdownEvent);
+    for (Index = 0; Index < HashContext->ThreadsAllocated; Index++) {
+        WaitForSingleObject(HashContext->Workers[Index].Thread, INFINITE);
+        CloseHandle(HashContext->Workers[Index].Thread);
+        HashCleanupStream(&HashContext->Workers[Index].Stream);
+    }
+    HashContext->ThreadsAllocated = 0;
+
+    ASSERT(YoriLibIsListEmpty(&HashContext->PendingList));
+    ASSERT(YoriLibIsListEmpty(&HashContext->OutputList));
 }
 
 /**
@@ -222,17 +1181,12 @@ HashFileFoundCallback(
     )
 {
     PHASH_CONTEXT HashContext = (PHASH_CONTEXT)Context;
-    YORI_STRING RelativePathFrom;
-    HANDLE FileHandle;
     YORI_ALLOC_SIZE_T SlashesFound;
     YORI_ALLOC_SIZE_T Index;
-
-    UNREFERENCED_PARAMETER(FileInfo);
+    SYSERR OpenError;
 
     ASSERT(YoriLibIsStringNullTerminated(FilePath));
 
-    YoriLibInitEmptyString(&RelativePathFrom);
-
     SlashesFound = 0;
     for (Index = FilePath->LengthInChars; Index > 0; Index--) {
         if (FilePath->StartOfString[Index - 1] == '\\') {
@@ -246,34 +1200,22 @@ HashFileFoundCallback(
     ASSERT(Index > 0);
     ASSERT(SlashesFound == Depth + 1);
 
-    RelativePathFrom.StartOfString = &FilePath->StartOfString[Index];
-    RelativePathFrom.LengthInChars = FilePath->LengthInChars - Index;
-
-    FileHandle = CreateFile(FilePath->StartOfString,
-                            GENERIC_READ,
-                            FILE_SHARE_READ | FILE_SHARE_DELETE,
-                            NULL,
-                            OPEN_EXISTING,
-                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS,
-                            NULL);
+    //
+    //  Files found by enumeration can be hashed on any thread.  If the file
+    //  was not found by enumeration, the argument is being interpreted as a
+    //  literal path, and the caller needs to know if it could be opened.
+    //
 
-    if (FileHandle == NULL || FileHandle == INVALID_HANDLE_VALUE) {
-        if (HashContext->SavedErrorThisArg == ERROR_SUCCESS) {
-            SYSERR LastError = GetLastError();
-            LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
-            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hash: open of %y failed: %s"), FilePath, ErrText);
-            YoriLibFreeWinErrorText(ErrText);
+    if (FileInfo != NULL) {
+        HashContext->FilesFoundThisArg++;
+        HashQueueFile(HashContext, FilePath, Index, FALSE);
+    } else {
+        OpenError = HashQueueFile(HashContext, FilePath, Index, TRUE);
+        if (OpenError == ERROR_SUCCESS) {
+            HashContext->SavedErrorThisArg = ERROR_SUCCESS;
         }
-        return TRUE;
-    }
-
-    HashContext->SavedErrorThisArg = ERROR_SUCCESS;
-
-    if (HashProcessStream(FileHandle, HashContext)) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y %y\n"), &HashContext->HashString, &RelativePathFrom);
     }
 
-    CloseHandle(FileHandle);
     return TRUE;
 }
 
@@ -291,17 +1233,29 @@ HashCleanupContext(
 {
     BOOL Result;
 
-    if (HashContext->HashBuffer != NULL) {
-        YoriLibFree(HashContext->HashBuffer);
-        HashContext->HashBuffer = NULL;
+    HashWaitForWorkers(HashContext);
+
+    if (HashContext->Workers != NULL) {
+        YoriLibFree(HashContext->Workers);
+        HashContext->Workers = NULL;
+    }
+
+    if (HashContext->Mutex != NULL) {
+        CloseHandle(HashContext->Mutex);
+        HashContext->Mutex = NULL;
     }
 
-    if (HashContext->ReadBuffer != NULL) {
-        YoriLibFree(HashContext->ReadBuffer);
-        HashContext->ReadBuffer = NULL;
+    if (HashContext->WorkerWaitEvent != NULL) {
+        CloseHandle(HashContext->WorkerWaitEvent);
+        HashContext->WorkerWaitEvent = NULL;
     }
 
-    YoriLibFreeStringContents(&HashContext->HashString);
+    if (HashContext->WorkerShutdownEvent != NULL) {
+        CloseHandle(HashContext->WorkerShutdownEvent);
+        HashContext->WorkerShutdownEvent = NULL;
+    }
+
+    HashCleanupStream(&HashContext->Stream);
 
     if (HashContext->Provider != 0) {
         Result = DllAdvApi32.pCryptReleaseContext(HashContext->Provider, 0);
@@ -344,21 +1298,25 @@ CONST HASH_ACQUIRE_CONFIG HashAcquireConfigOptions[] = {
     {MS_DEF_PROV, PROV_RSA_FULL, 0}                              // NT 4 RTM
 };
 
+
 /**
  Allocate any internal allocations within the hash context needed for the
  specified hash algorithm.
 
  @param HashContext Pointer to the hash context to initialize.
 
- @param Algorithm Specifies a CALG_* algorithm indicating the algorithm to
-        initialize.
+ @param Algorithm Pointer to the algorithm to initialize.
+
+ @param MaxThreads The maximum number of files to hash concurrently.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
+__success(return)
 BOOL
 HashInitializeContext(
     __in PHASH_CONTEXT HashContext,
-    __in DWORD Algorithm
+    __in PCHASH_ALGORITHM Algorithm,
+    __in DWORD MaxThreads
     )
 {
     DWORD_PTR hHash;
@@ -368,96 +1326,108 @@ HashInitializeContext(
     DWORD HashLength;
 
     LastError = ERROR_SUCCESS;
+    HashContext->Algorithm = Algorithm;
+    YoriLibInitializeListHead(&HashContext->PendingList);
+    YoriLibInitializeListHead(&HashContext->OutputList);
 
-    //
-    //  Iterate through the supported providers, looking for one that works.
-    //
+    if (Algorithm->NativeAlgorithm != HashNativeNone) {
+        HashContext->HashLength = Algorithm->NativeHashLength;
+    } else {
 
-    for (Index = 0; Index < sizeof(HashAcquireConfigOptions)/sizeof(HashAcquireConfigOptions[0]); Index++) {
-        if (DllAdvApi32.pCryptAcquireContextW(&HashContext->Provider,
-                                              NULL,
-                                              HashAcquireConfigOptions[Index].Provider,
-                                              HashAcquireConfigOptions[Index].ProviderType,
-                                              HashAcquireConfigOptions[Index].Flags)) {
-            LastError = ERROR_SUCCESS;
-            break;
-        } else {
-            LastError = GetLastError();
+        YoriLibLoadAdvApi32Functions();
+        if (DllAdvApi32.pCryptAcquireContextW == NULL ||
+            DllAdvApi32.pCryptCreateHash == NULL ||
+            DllAdvApi32.pCryptDestroyHash == NULL ||
+            DllAdvApi32.pCryptGetHashParam == NULL ||
+            DllAdvApi32.pCryptHashData == NULL ||
+            DllAdvApi32.pCryptReleaseContext == NULL) {
 
-            //
-            //  NTE_BAD_KEYSET indicates that a keyset may need to be created.
-            //  The documentation suggests code should always handle this,
-            //  although it's less clear on why.  In practice this appears
-            //  necessary on NT 4 RTM (perhaps nothing else has used it first?)
-            //
-            if (LastError != (DWORD)NTE_BAD_KEYSET) {
-                continue;
-            }
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hash: operating system support not present\n"));
+            return FALSE;
+        }
 
+        //
+        //  Iterate through the supported providers, looking for one that
+        //  works.
+        //
+
+        for (Index = 0; Index < sizeof(HashAcquireConfigOptions)/sizeof(HashAcquireConfigOptions[0]); Index++) {
             if (DllAdvApi32.pCryptAcquireContextW(&HashContext->Provider,
                                                   NULL,
                                                   HashAcquireConfigOptions[Index].Provider,
                                                   HashAcquireConfigOptions[Index].ProviderType,
-                                                  HashAcquireConfigOptions[Index].Flags | CRYPT_NEWKEYSET)) {
+                                                  HashAcquireConfigOptions[Index].Flags)) {
                 LastError = ERROR_SUCCESS;
                 break;
+            } else {
+                LastError = GetLastError();
+
+                //
+                //  NTE_BAD_KEYSET indicates that a keyset may need to be
+                //  created.  The documentation suggests code should always
+                //  handle this, although it's less clear on why.  In
+                //  practice this appears necessary on NT 4 RTM (perhaps
+                //  nothing else has used it first?)
+                //
+                if (LastError != (DWORD)NTE_BAD_KEYSET) {
+                    continue;
+                }
+
+                if (DllAdvApi32.pCryptAcquireContextW(&HashContext->Provider,
+                                                      NULL,
+                                                      HashAcquireConfigOptions[Index].Provider,
+                                                      HashAcquireConfigOptions[Index].ProviderType,
+                                                      HashAcquireConfigOptions[Index].Flags | CRYPT_NEWKEYSET)) {
+                    LastError = ERROR_SUCCESS;
+                    break;
+                }
             }
         }
-    }
-
-    if (LastError != ERROR_SUCCESS) {
-        ErrText = YoriLibGetWinErrorText(LastError);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hash: algorithm provider not functional: %s\n"), ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        HashCleanupContext(HashContext);
-        return FALSE;
-    }
 
-    if (!DllAdvApi32.pCryptCreateHash(HashContext->Provider, Algorithm, 0, 0, &hHash)) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hash: operating system support not present\n"));
-        HashCleanupContext(HashContext);
-        return FALSE;
-    }
-
-    if (!DllAdvApi32.pCryptGetHashParam(hHash, HP_HASHVAL, NULL, &HashLength, 0)) {
-        LastError = GetLastError();
-        if (LastError != ERROR_MORE_DATA) {
+        if (LastError != ERROR_SUCCESS) {
             ErrText = YoriLibGetWinErrorText(LastError);
-            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hash: could not determine hash length: %s\n"), ErrText);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hash: algorithm provider not functional: %s\n"), ErrText);
             YoriLibFreeWinErrorText(ErrText);
-            DllAdvApi32.pCryptDestroyHash(hHash);
             HashCleanupContext(HashContext);
             return FALSE;
         }
-    }
 
-    if (!YoriLibIsSizeAllocatable(HashLength)) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hash: hash length %i too large\n"), HashLength);
-        DllAdvApi32.pCryptDestroyHash(hHash);
-        HashCleanupContext(HashContext);
-        return FALSE;
-    }
-    HashContext->HashLength = (YORI_ALLOC_SIZE_T)HashLength;
+        if (!DllAdvApi32.pCryptCreateHash(HashContext->Provider, Algorithm->CryptAlgorithm, 0, 0, &hHash)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hash: operating system support not present\n"));
+            HashCleanupContext(HashContext);
+            return FALSE;
+        }
 
-    DllAdvApi32.pCryptDestroyHash(hHash);
+        if (!DllAdvApi32.pCryptGetHashParam(hHash, HP_HASHVAL, NULL, &HashLength, 0)) {
+            LastError = GetLastError();
+            if (LastError != ERROR_MORE_DATA) {
+                ErrText = YoriLibGetWinErrorText(LastError);
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hash: could not determine hash length: %s\n"), ErrText);
+                YoriLibFreeWinErrorText(ErrText);
+                DllAdvApi32.pCryptDestroyHash(hHash);
+                HashCleanupContext(HashContext);
+                return FALSE;
+            }
+        }
 
-    HashContext->Algorithm = Algorithm;
+        DllAdvApi32.pCryptDestroyHash(hHash);
 
-    HashContext->HashBuffer = YoriLibMalloc(HashContext->HashLength);
-    if (HashContext->HashBuffer == NULL) {
-        HashCleanupContext(HashContext);
-        return FALSE;
+        if (HashLength > HASH_MAXIMUM_DIGEST_SIZE) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hash: hash length %i too large\n"), HashLength);
+            HashCleanupContext(HashContext);
+            return FALSE;
+        }
+        HashContext->HashLength = (YORI_ALLOC_SIZE_T)HashLength;
     }
 
-    if (!YoriLibAllocateString(&HashContext->HashString, HashContext->HashLength * 2 + 1)) {
+    HashContext->ReadBufferLength = YoriLibMaximumAllocationInRange(60 * 1024, 1024 * 1024);
+
+    if (!HashInitializeStream(HashContext, &HashContext->Stream)) {
         HashCleanupContext(HashContext);
         return FALSE;
     }
 
-    HashContext->ReadBufferLength = YoriLibMaximumAllocationInRange(60 * 1024, 1024 * 1024);
-
-    HashContext->ReadBuffer = YoriLibMalloc(HashContext->ReadBufferLength);
-    if (HashContext->ReadBuffer == NULL) {
+    if (!HashInitializeWorkers(HashContext, MaxThreads)) {
         HashCleanupContext(HashContext);
         return FALSE;
     }
@@ -465,6 +1435,7 @@ HashInitializeContext(
     return TRUE;
 }
 
+
 /**
  A callback that is invoked when a directory cannot be successfully enumerated.
 
@@ -526,6 +1497,7 @@ HashFileEnumerateErrorCallback(
 }
 
 
+
 #ifdef YORI_BUILTIN
 /**
  The main entrypoint for the hash builtin command.
@@ -557,13 +1529,21 @@ ENTRYPOINT(
     BOOLEAN ArgumentUnderstood;
     YORI_ALLOC_SIZE_T i;
     YORI_ALLOC_SIZE_T StartArg = 0;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+    DWORD Index;
+    DWORD MaxThreads;
+    LONGLONG llTemp;
     WORD MatchFlags;
+    WORD PerformanceProcessors;
+    WORD EfficiencyProcessors;
     BOOLEAN BasicEnumeration = FALSE;
     HASH_CONTEXT HashContext;
     YORI_STRING Arg;
-    DWORD Algorithm = CALG_SHA1;
+    PCHASH_ALGORITHM Algorithm;
 
     ZeroMemory(&HashContext, sizeof(HashContext));
+    Algorithm = NULL;
+    MaxThreads = 0;
 
     for (i = 1; i < ArgC; i++) {
 
@@ -576,42 +1556,39 @@ ENTRYPOINT(
                 HashHelp();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2019-2021"));
+                YoriLibDisplayMitLicense(_T("2019-2026"));
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("a")) == 0) {
                 if (i + 1 < ArgC) {
-                    if (YoriLibCompareStringLitIns(&ArgV[i + 1], _T("MD4")) == 0) {
-                        ArgumentUnderstood = TRUE;
-                        i++;
-                        Algorithm = CALG_MD4;
-                    } else if (YoriLibCompareStringLitIns(&ArgV[i + 1], _T("MD5")) == 0) {
-                        ArgumentUnderstood = TRUE;
-                        i++;
-                        Algorithm = CALG_MD5;
-                    } else if (YoriLibCompareStringLitIns(&ArgV[i + 1], _T("SHA1")) == 0) {
-                        ArgumentUnderstood = TRUE;
-                        i++;
-                        Algorithm = CALG_SHA1;
-                    } else if (YoriLibCompareStringLitIns(&ArgV[i + 1], _T("SHA256")) == 0) {
-                        ArgumentUnderstood = TRUE;
-                        i++;
-                        Algorithm = CALG_SHA_256;
-                    } else if (YoriLibCompareStringLitIns(&ArgV[i + 1], _T("SHA384")) == 0) {
-                        ArgumentUnderstood = TRUE;
-                        i++;
-                        Algorithm = CALG_SHA_384;
-                    } else if (YoriLibCompareStringLitIns(&ArgV[i + 1], _T("SHA512")) == 0) {
-                        ArgumentUnderstood = TRUE;
-                        i++;
-                        Algorithm = CALG_SHA_512;
-                    } else {
-                        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hash: algorithm not recognized.  Supported algorithms are MD4, MD5, SHA1, SHA256, SHA384, and SHA512\n"));
+                    for (Index = 0; Index < sizeof(HashAlgorithms)/sizeof(HashAlgorithms[0]); Index++) {
+                        if (YoriLibCompareStringLitIns(&ArgV[i + 1], HashAlgorithms[Index].Name) == 0) {
+                            Algorithm = &HashAlgorithms[Index];
+                            break;
+                        }
+                    }
+
+                    if (Index == sizeof(HashAlgorithms)/sizeof(HashAlgorithms[0])) {
+                        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hash: algorithm not recognized.  Supported algorithms are BLAKE3, MD4, MD5, SHA1, SHA256, SHA384, SHA512, and XXH3\n"));
                         return EXIT_FAILURE;
                     }
+
+                    ArgumentUnderstood = TRUE;
+                    i++;
                 }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("b")) == 0) {
                 BasicEnumeration = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("j")) == 0) {
+                if (i + 1 < ArgC &&
+                    YoriLibStringToNumber(&ArgV[i + 1], TRUE, &llTemp, &CharsConsumed) &&
+                    CharsConsumed > 0 &&
+                    llTemp > 0 &&
+                    llTemp <= MAXIMUM_WAIT_OBJECTS) {
+
+                    MaxThreads = (DWORD)llTemp;
+                    ArgumentUnderstood = TRUE;
+                    i++;
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("s")) == 0) {
                 HashContext.Recursive = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -631,19 +1608,37 @@ ENTRYPOINT(
         }
     }
 
-    YoriLibLoadAdvApi32Functions();
-    if (DllAdvApi32.pCryptAcquireContextW == NULL ||
-        DllAdvApi32.pCryptCreateHash == NULL ||
-        DllAdvApi32.pCryptDestroyHash == NULL ||
-        DllAdvApi32.pCryptGetHashParam == NULL ||
-        DllAdvApi32.pCryptHashData == NULL ||
-        DllAdvApi32.pCryptReleaseContext == NULL) {
+    //
+    //  SHA1 is the default for compatibility with earlier versions.
+    //
 
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hash: operating system support not present\n"));
-        return EXIT_FAILURE;
+    if (Algorithm == NULL) {
+        for (Index = 0; Index < sizeof(HashAlgorithms)/sizeof(HashAlgorithms[0]); Index++) {
+            if (HashAlgorithms[Index].CryptAlgorithm == CALG_SHA1) {
+                Algorithm = &HashAlgorithms[Index];
+                break;
+            }
+        }
+        ASSERT(Algorithm != NULL);
+        __analysis_assume(Algorithm != NULL);
+    }
+
+    //
+    //  If the number of files to hash concurrently wasn't specified, use
+    //  one per processor.
+    //
+
+    if (MaxThreads == 0) {
+        YoriLibQueryCpuCount(&PerformanceProcessors, &EfficiencyProcessors);
+        MaxThreads = PerformanceProcessors + EfficiencyProcessors;
+        if (MaxThreads == 0) {
+            MaxThreads = 1;
+        } else if (MaxThreads > MAXIMUM_WAIT_OBJECTS) {
+            MaxThreads = MAXIMUM_WAIT_OBJECTS;
+        }
     }
 
-    if (!HashInitializeContext(&HashContext, Algorithm)) {
+    if (!HashInitializeContext(&HashContext, Algorithm, MaxThreads)) {
         return EXIT_FAILURE;
     }
 
@@ -664,17 +1659,25 @@ ENTRYPOINT(
     //
 
     if (StartArg == 0 || StartArg == ArgC) {
+        YORI_STRING HashString;
+        TCHAR HashChars[HASH_MAXIMUM_DIGEST_SIZE * 2 + 1];
+
         if (YoriLibIsStdInConsole()) {
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hash: no file or pipe for input\n"));
             HashCleanupContext(&HashContext);
             return EXIT_FAILURE;
         }
 
-        if (!HashProcessStream(GetStdHandle(STD_INPUT_HANDLE), &HashContext)) {
+        YoriLibInitEmptyString(&HashString);
+        HashString.StartOfString = HashChars;
+        HashString.LengthAllocated = sizeof(HashChars)/sizeof(HashChars[0]);
+
+        HashContext.FilesFound++;
+        if (!HashProcessStream(GetStdHandle(STD_INPUT_HANDLE), FALSE, &HashContext, &HashContext.Stream, &HashString)) {
             HashCleanupContext(&HashContext);
             return EXIT_FAILURE;
         }
-        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), &HashContext.HashString);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), &HashString);
     } else {
         MatchFlags = YORILIB_ENUM_RETURN_FILES | YORILIB_ENUM_DIRECTORY_CONTENTS;
         if (BasicEnumeration) {
@@ -708,6 +1711,8 @@ ENTRYPOINT(
                 }
             }
         }
+
+        HashWaitForWorkers(&HashContext);
     }
 
     HashCleanupContext(&HashContext);
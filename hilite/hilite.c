@@ -3,7 +3,7 @@
  *
  * Yori shell highlight lines or text in an input stream
  *
- * Copyright (c) 2018-2021 Malcolm J. Smith
+ * Copyright (c) 2018-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -37,7 +37,7 @@ CHAR strHiliteHelpText[] =
         "or text matching specified criteria.\n"
         "\n"
         "HILITE [-license] [-b] [-c <string> <color>] [-h <string> <color>]\n"
-        "       [-i] [-m] [-s] [-t <string> <color>] [<file>...]\n"
+        "       [-i] [-m] [-r] [-s] [-t <string> <color>] [<file>...]\n"
         "\n"
         "   -b             Use basic search criteria for files only\n"
         "   -c             Highlight lines containing <string> with <color>\n";
@@ -50,6 +50,7 @@ CHAR strHiliteHelpText2[] =
         "   -h             Highlight lines starting with <string> with <color>\n"
         "   -i             Match insensitively\n"
         "   -m             Highlight matching text (as opposed to matching lines)\n"
+        "   -r             Treat strings as regular expressions\n"
         "   -s             Process files from all subdirectories\n"
         "   -t             Highlight lines ending with <string> with <color>\n";
 
@@ -151,6 +152,53 @@ typedef struct _HILITE_CONTEXT {
      */
     YORI_LIST_ENTRY EndMatches;
 
+    /**
+     An array of the strings from MiddleMatches, in list order, which
+     MiddleMatcher is built from.
+     */
+    PYORI_STRING MiddleMatchStrings;
+
+    /**
+     An array of the criteria from MiddleMatches, in the same order as
+     MiddleMatchStrings.
+     */
+    PHILITE_MATCH_CRITERIA *MiddleMatchCriteria;
+
+    /**
+     The strings from MiddleMatches compiled so that all of them can be found
+     with a single pass over each line.
+     */
+    PYORI_LIB_SUBSTR_MATCHER MiddleMatcher;
+
+    /**
+     TRUE if the strings to match are regular expressions.
+     */
+    BOOLEAN UseRegex;
+
+    /**
+     When using regular expressions, an array of the expressions for every
+     criteria, in the order returned by HiliteGetNextMatch.  Expressions
+     for the beginning or end of lines are anchored, and have been
+     allocated.
+     */
+    PYORI_STRING RegexStrings;
+
+    /**
+     An array of the criteria in the same order as RegexStrings.
+     */
+    PHILITE_MATCH_CRITERIA *RegexCriteria;
+
+    /**
+     The number of elements in RegexStrings and RegexCriteria.
+     */
+    YORI_ALLOC_SIZE_T RegexCount;
+
+    /**
+     The expressions from RegexStrings compiled so that all of them can be
+     found with a single pass over each line.
+     */
+    PYORI_LIB_REGEX Regex;
+
 } HILITE_CONTEXT, *PHILITE_CONTEXT;
 
 /**
@@ -220,6 +268,243 @@ HiliteGetNextMatch(
     return NULL;
 }
 
+/**
+ Compile the criteria that can match in the middle of a line so that lines
+ can be checked against all of them in a single pass.  When highlighting
+ matching text, empty strings are never highlighted, so they are excluded.
+
+ @param HiliteContext Pointer to the context containing the criteria.
+
+ @return TRUE to indicate success, FALSE on allocation failure.
+ */
+__success(return)
+BOOLEAN
+HiliteCompileMiddleMatches(
+    __inout PHILITE_CONTEXT HiliteContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PHILITE_MATCH_CRITERIA MatchCriteria;
+    YORI_ALLOC_SIZE_T Count;
+    YORI_MAX_UNSIGNED_T BytesNeeded;
+
+    Count = 0;
+    ListEntry = YoriLibGetNextListEntry(&HiliteContext->MiddleMatches, NULL);
+    while (ListEntry != NULL) {
+        Count++;
+        ListEntry = YoriLibGetNextListEntry(&HiliteContext->MiddleMatches, ListEntry);
+    }
+
+    if (Count == 0) {
+        return TRUE;
+    }
+
+    BytesNeeded = Count;
+    BytesNeeded = BytesNeeded * (sizeof(YORI_STRING) + sizeof(PHILITE_MATCH_CRITERIA));
+    if (!YoriLibIsSizeAllocatable(BytesNeeded)) {
+        return FALSE;
+    }
+
+    HiliteContext->MiddleMatchStrings = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesNeeded);
+    if (HiliteContext->MiddleMatchStrings == NULL) {
+        return FALSE;
+    }
+    HiliteContext->MiddleMatchCriteria = (PHILITE_MATCH_CRITERIA *)&HiliteContext->MiddleMatchStrings[Count];
+
+    Count = 0;
+    ListEntry = YoriLibGetNextListEntry(&HiliteContext->MiddleMatches, NULL);
+    while (ListEntry != NULL) {
+        MatchCriteria = CONTAINING_RECORD(ListEntry, HILITE_MATCH_CRITERIA, ListEntry);
+        if (!HiliteContext->HighlightMatchText ||
+            MatchCriteria->MatchString.LengthInChars > 0) {
+
+            YoriLibInitEmptyString(&HiliteContext->MiddleMatchStrings[Count]);
+            HiliteContext->MiddleMatchStrings[Count].StartOfString = MatchCriteria->MatchString.StartOfString;
+            HiliteContext->MiddleMatchStrings[Count].LengthInChars = MatchCriteria->MatchString.LengthInChars;
+            HiliteContext->MiddleMatchCriteria[Count] = MatchCriteria;
+            Count++;
+        }
+        ListEntry = YoriLibGetNextListEntry(&HiliteContext->MiddleMatches, ListEntry);
+    }
+
+    HiliteContext->MiddleMatcher = YoriLibAllocateSubstrMatcher(Count, HiliteContext->MiddleMatchStrings, HiliteContext->Insensitive);
+    if (HiliteContext->MiddleMatcher == NULL) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Compile every criteria as a regular expression so that lines can be checked
+ against all of them in a single pass.  Criteria that match the beginning or
+ end of a line are anchored, and are ordered before and after criteria that
+ can match anywhere, so that the same criteria is selected as when matching
+ strings.
+
+ @param HiliteContext Pointer to the context containing the criteria.
+
+ @return TRUE to indicate success, FALSE if an expression is not valid or on
+         allocation failure.
+ */
+__success(return)
+BOOLEAN
+HiliteCompileRegex(
+    __inout PHILITE_CONTEXT HiliteContext
+    )
+{
+    PYORI_LIST_ENTRY ListHead;
+    PHILITE_MATCH_CRITERIA MatchCriteria;
+    PYORI_STRING RegexString;
+    YORI_ALLOC_SIZE_T Count;
+    YORI_ALLOC_SIZE_T ErrorPattern;
+    YORI_ALLOC_SIZE_T ErrorOffset;
+    YORI_MAX_UNSIGNED_T BytesNeeded;
+
+    Count = 0;
+    ListHead = NULL;
+    MatchCriteria = HiliteGetNextMatch(HiliteContext, &ListHead, NULL);
+    while (MatchCriteria != NULL) {
+        Count++;
+        MatchCriteria = HiliteGetNextMatch(HiliteContext, &ListHead, MatchCriteria);
+    }
+
+    if (Count == 0) {
+        return TRUE;
+    }
+
+    BytesNeeded = Count;
+    BytesNeeded = BytesNeeded * (sizeof(YORI_STRING) + sizeof(PHILITE_MATCH_CRITERIA));
+    if (!YoriLibIsSizeAllocatable(BytesNeeded)) {
+        return FALSE;
+    }
+
+    HiliteContext->RegexStrings = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesNeeded);
+    if (HiliteContext->RegexStrings == NULL) {
+        return FALSE;
+    }
+    HiliteContext->RegexCriteria = (PHILITE_MATCH_CRITERIA *)&HiliteContext->RegexStrings[Count];
+
+    HiliteContext->RegexCount = 0;
+    ListHead = NULL;
+    MatchCriteria = HiliteGetNextMatch(HiliteContext, &ListHead, NULL);
+    while (MatchCriteria != NULL) {
+        RegexString = &HiliteContext->RegexStrings[HiliteContext->RegexCount];
+        YoriLibInitEmptyString(RegexString);
+        if (MatchCriteria->MatchType == HiliteMatchTypeBeginsWith) {
+            YoriLibYPrintf(RegexString, _T("^(?:%y)"), &MatchCriteria->MatchString);
+        } else if (MatchCriteria->MatchType == HiliteMatchTypeEndsWith) {
+            YoriLibYPrintf(RegexString, _T("(?:%y)$"), &MatchCriteria->MatchString);
+        } else {
+            RegexString->StartOfString = MatchCriteria->MatchString.StartOfString;
+            RegexString->LengthInChars = MatchCriteria->MatchString.LengthInChars;
+        }
+
+        if (MatchCriteria->MatchType != HiliteMatchTypeContains &&
+            RegexString->StartOfString == NULL) {
+
+            return FALSE;
+        }
+
+        HiliteContext->RegexCriteria[HiliteContext->RegexCount] = MatchCriteria;
+        HiliteContext->RegexCount++;
+        MatchCriteria = HiliteGetNextMatch(HiliteContext, &ListHead, MatchCriteria);
+    }
+
+    HiliteContext->Regex = YoriLibAllocateRegex(HiliteContext->RegexCount, HiliteContext->RegexStrings, HiliteContext->Insensitive, &ErrorPattern, &ErrorOffset);
+    if (HiliteContext->Regex == NULL) {
+        if (ErrorPattern < HiliteContext->RegexCount) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hilite: invalid regular expression %y at offset %i\n"), &HiliteContext->RegexStrings[ErrorPattern], ErrorOffset);
+        }
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Output a line, highlighting it or text within it according to criteria
+ that have been compiled into a regular expression.
+
+ @param HiliteContext Pointer to the context containing the compiled
+        criteria.
+
+ @param LineString The line to output.
+
+ @param Remaining On completion, updated to refer to the portion at the end
+        of the line which has not been output and contains no matches.
+ */
+VOID
+HiliteProcessLineRegex(
+    __in PHILITE_CONTEXT HiliteContext,
+    __in PYORI_STRING LineString,
+    __out PYORI_STRING Remaining
+    )
+{
+    PHILITE_MATCH_CRITERIA MatchCriteria;
+    PYORI_STRING FoundString;
+    YORI_STRING DisplayString;
+    YORI_ALLOC_SIZE_T Offset;
+    YORI_ALLOC_SIZE_T MatchOffset;
+    YORI_ALLOC_SIZE_T MatchLength;
+
+    YoriLibInitEmptyString(&DisplayString);
+    Offset = 0;
+
+    if (!HiliteContext->HighlightMatchText) {
+        FoundString = YoriLibRegexFindLowestEntry(HiliteContext->Regex, LineString, NULL);
+        if (FoundString != NULL) {
+            MatchCriteria = HiliteContext->RegexCriteria[FoundString - HiliteContext->RegexStrings];
+            YoriLibVtSetConsoleTextAttr(YORI_LIB_OUTPUT_STDOUT, MatchCriteria->Color.Win32Attr);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), LineString);
+            YoriLibVtSetConsoleTextAttr(YORI_LIB_OUTPUT_STDOUT, HiliteContext->DefaultColor.Win32Attr);
+            Offset = LineString->LengthInChars;
+        }
+    } else {
+        while (Offset < LineString->LengthInChars) {
+            FoundString = YoriLibRegexFindFirst(HiliteContext->Regex, LineString, Offset, &MatchOffset, &MatchLength);
+            if (FoundString == NULL) {
+                break;
+            }
+
+            //
+            //  Empty matches are not highlighted.  Output the text up to
+            //  and including the next character, and look for a nonempty
+            //  match after it.
+            //
+
+            if (MatchLength == 0) {
+                if (MatchOffset >= LineString->LengthInChars) {
+                    break;
+                }
+                DisplayString.StartOfString = &LineString->StartOfString[Offset];
+                DisplayString.LengthInChars = MatchOffset - Offset + 1;
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
+                Offset = MatchOffset + 1;
+                continue;
+            }
+
+            if (MatchOffset > Offset) {
+                DisplayString.StartOfString = &LineString->StartOfString[Offset];
+                DisplayString.LengthInChars = MatchOffset - Offset;
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
+            }
+
+            MatchCriteria = HiliteContext->RegexCriteria[FoundString - HiliteContext->RegexStrings];
+            DisplayString.StartOfString = &LineString->StartOfString[MatchOffset];
+            DisplayString.LengthInChars = MatchLength;
+            YoriLibVtSetConsoleTextAttr(YORI_LIB_OUTPUT_STDOUT, MatchCriteria->Color.Win32Attr);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
+            YoriLibVtSetConsoleTextAttr(YORI_LIB_OUTPUT_STDOUT, HiliteContext->DefaultColor.Win32Attr);
+            Offset = MatchOffset + MatchLength;
+        }
+    }
+
+    YoriLibInitEmptyString(Remaining);
+    Remaining->StartOfString = &LineString->StartOfString[Offset];
+    Remaining->LengthInChars = LineString->LengthInChars - Offset;
+}
+
 /**
  Process a stream and apply the hilite criteria before outputting to standard
  output.
@@ -244,10 +529,12 @@ HiliteProcessStream(
     YORI_STRING DisplayString;
     PHILITE_MATCH_CRITERIA MatchCriteria;
     PHILITE_MATCH_CRITERIA BestMatchCriteria;
+    PYORI_STRING FoundString;
     YORI_ALLOC_SIZE_T BestMatchOffset;
     YORILIB_COLOR_ATTRIBUTES ColorToUse;
     PYORI_LIST_ENTRY ListHead;
     BOOLEAN MatchFound;
+    BOOLEAN MiddleMatchesChecked;
     BOOLEAN AnyMatchFound;
     YORI_ALLOC_SIZE_T MatchOffset;
 
@@ -269,7 +556,11 @@ HiliteProcessStream(
         ColorToUse.Ctrl = HiliteContext->DefaultColor.Ctrl;
         ColorToUse.Win32Attr = HiliteContext->DefaultColor.Win32Attr;
 
-        while (Substring.LengthInChars > 0) {
+        if (HiliteContext->Regex != NULL) {
+            HiliteProcessLineRegex(HiliteContext, &LineString, &Substring);
+        }
+
+        while (HiliteContext->Regex == NULL && Substring.LengthInChars > 0) {
 
             //
             //  Enumerate through the matches and see if there is anything to
@@ -290,6 +581,7 @@ HiliteProcessStream(
             MatchCriteria = HiliteGetNextMatch(HiliteContext, &ListHead, MatchCriteria);
             while (MatchCriteria != NULL) {
                 MatchFound = FALSE;
+                MiddleMatchesChecked = FALSE;
                 if (MatchCriteria->MatchType == HiliteMatchTypeBeginsWith) {
                     if (HiliteContext->Insensitive) {
                         if (YoriLibCompareStringInsCnt(&Substring,
@@ -327,15 +619,27 @@ HiliteProcessStream(
                         }
                     }
                 } else if (MatchCriteria->MatchType == HiliteMatchTypeContains) {
-                    if (HiliteContext->Insensitive) {
-                        if (YoriLibFindFirstMatchSubstrIns(&Substring, 1, &MatchCriteria->MatchString, &MatchOffset)) {
-                            MatchFound = TRUE;
-                        }
+
+                    //
+                    //  All of the criteria in the middle of the line are
+                    //  checked at once.  When highlighting text, this
+                    //  returns the earliest match in the line; otherwise it
+                    //  returns the first criteria in list order that
+                    //  matches anywhere.  Either way this is the criteria
+                    //  that checking each in turn would have selected.
+                    //
+
+                    ASSERT(HiliteContext->MiddleMatcher != NULL);
+                    if (HiliteContext->HighlightMatchText) {
+                        FoundString = YoriLibSubstrMatcherFindFirst(HiliteContext->MiddleMatcher, &Substring, &MatchOffset);
                     } else {
-                        if (YoriLibFindFirstMatchSubstr(&Substring, 1, &MatchCriteria->MatchString, &MatchOffset)) {
-                            MatchFound = TRUE;
-                        }
+                        FoundString = YoriLibSubstrMatcherFindLowestEntry(HiliteContext->MiddleMatcher, &Substring, &MatchOffset);
+                    }
+                    if (FoundString != NULL) {
+                        MatchCriteria = HiliteContext->MiddleMatchCriteria[FoundString - HiliteContext->MiddleMatchStrings];
+                        MatchFound = TRUE;
                     }
+                    MiddleMatchesChecked = TRUE;
                 }
 
 
@@ -361,7 +665,12 @@ HiliteProcessStream(
                     }
                 }
 
-                MatchCriteria = HiliteGetNextMatch(HiliteContext, &ListHead, MatchCriteria);
+                if (MiddleMatchesChecked) {
+                    ListHead = &HiliteContext->EndMatches;
+                    MatchCriteria = HiliteGetNextMatch(HiliteContext, &ListHead, NULL);
+                } else {
+                    MatchCriteria = HiliteGetNextMatch(HiliteContext, &ListHead, MatchCriteria);
+                }
             }
 
             //
@@ -572,6 +881,7 @@ HiliteCleanupContext(
     PHILITE_MATCH_CRITERIA MatchCriteria;
     PHILITE_MATCH_CRITERIA NextMatchCriteria;
     PYORI_LIST_ENTRY ListHead;
+    YORI_ALLOC_SIZE_T Index;
 
     ListHead = &HiliteContext->StartMatches;
 
@@ -582,6 +892,32 @@ HiliteCleanupContext(
         YoriLibFree(MatchCriteria);
         MatchCriteria = NextMatchCriteria;
     }
+
+    if (HiliteContext->MiddleMatcher != NULL) {
+        YoriLibFreeSubstrMatcher(HiliteContext->MiddleMatcher);
+        HiliteContext->MiddleMatcher = NULL;
+    }
+
+    if (HiliteContext->MiddleMatchStrings != NULL) {
+        YoriLibFree(HiliteContext->MiddleMatchStrings);
+        HiliteContext->MiddleMatchStrings = NULL;
+        HiliteContext->MiddleMatchCriteria = NULL;
+    }
+
+    if (HiliteContext->Regex != NULL) {
+        YoriLibFreeRegex(HiliteContext->Regex);
+        HiliteContext->Regex = NULL;
+    }
+
+    if (HiliteContext->RegexStrings != NULL) {
+        for (Index = 0; Index < HiliteContext->RegexCount; Index++) {
+            YoriLibFreeStringContents(&HiliteContext->RegexStrings[Index]);
+        }
+        YoriLibFree(HiliteContext->RegexStrings);
+        HiliteContext->RegexStrings = NULL;
+        HiliteContext->RegexCriteria = NULL;
+        HiliteContext->RegexCount = 0;
+    }
 }
 
 
@@ -649,7 +985,7 @@ ENTRYPOINT(
                 HiliteCleanupContext(&HiliteContext);
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2018-2021"));
+                YoriLibDisplayMitLicense(_T("2018-2026"));
                 HiliteCleanupContext(&HiliteContext);
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("b")) == 0) {
@@ -695,6 +1031,9 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("m")) == 0) {
                 HiliteContext.HighlightMatchText = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("r")) == 0) {
+                HiliteContext.UseRegex = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("s")) == 0) {
                 HiliteContext.Recursive = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -731,6 +1070,16 @@ ENTRYPOINT(
         }
     }
 
+    if (HiliteContext.UseRegex) {
+        if (!HiliteCompileRegex(&HiliteContext)) {
+            HiliteCleanupContext(&HiliteContext);
+            return EXIT_FAILURE;
+        }
+    } else if (!HiliteCompileMiddleMatches(&HiliteContext)) {
+        HiliteCleanupContext(&HiliteContext);
+        return EXIT_FAILURE;
+    }
+
     //
     //  Attempt to enable backup privilege so an administrator can access more
     //  objects successfully.
@@ -3,7 +3,7 @@
  *
  * Yori query or set values in INI files
  *
- * Copyright (c) 2018 Malcolm J. Smith
+ * Copyright (c) 2018-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -62,6 +62,38 @@ IniToolHelp(VOID)
     return TRUE;
 }
 
+/**
+ Load an INI file specified by the user into memory.
+
+ @param UserFileName Pointer to the file name of the INI file.
+
+ @param IniDocument On successful completion, populated with the contents of
+        the INI file.  The caller should free this with
+        @ref YoriLibIniCleanup regardless of whether this function succeeds.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+IniToolLoadIniFile(
+    __in PYORI_STRING UserFileName,
+    __out PYORI_LIB_INI_DOCUMENT IniDocument
+    )
+{
+    YORI_STRING RealFileName;
+    BOOL Result;
+
+    ZeroMemory(IniDocument, sizeof(YORI_LIB_INI_DOCUMENT));
+
+    if (!YoriLibUserToSingleFilePath(UserFileName, FALSE, &RealFileName)) {
+        return FALSE;
+    }
+
+    Result = YoriLibIniLoad(IniDocument, &RealFileName);
+    YoriLibFreeStringContents(&RealFileName);
+    return Result;
+}
+
 /**
  Delete a value from an INI file.
 
@@ -80,23 +112,23 @@ IniToolDeleteFromIniFile(
     __in_opt PYORI_STRING Key
     )
 {
-    YORI_STRING RealFileName;
-
-    if (DllKernel32.pWritePrivateProfileStringW == NULL) {
-        return FALSE;
-    }
+    YORI_LIB_INI_DOCUMENT IniDocument;
+    BOOL Result;
 
-    if (!YoriLibUserToSingleFilePath(UserFileName, FALSE, &RealFileName)) {
+    if (!IniToolLoadIniFile(UserFileName, &IniDocument)) {
+        YoriLibIniCleanup(&IniDocument);
         return FALSE;
     }
 
-    if (!DllKernel32.pWritePrivateProfileStringW(Section->StartOfString, (Key != NULL)?Key->StartOfString:NULL, NULL, RealFileName.StartOfString)) {
-        YoriLibFreeStringContents(&RealFileName);
-        return FALSE;
+    if (Key != NULL) {
+        YoriLibIniDeleteKey(&IniDocument, Section->StartOfString, Key->StartOfString);
+    } else {
+        YoriLibIniDeleteSection(&IniDocument, Section->StartOfString);
     }
 
-    YoriLibFreeStringContents(&RealFileName);
-    return TRUE;
+    Result = YoriLibIniSave(&IniDocument);
+    YoriLibIniCleanup(&IniDocument);
+    return Result;
 }
 
 /**
@@ -114,38 +146,25 @@ IniToolListSectionFromIniFile(
     __in PYORI_STRING Section
     )
 {
-    YORI_STRING RealFileName;
-    YORI_STRING Value;
-    LPTSTR ThisVar;
+    YORI_LIB_INI_DOCUMENT IniDocument;
+    PYORI_LIB_INI_SECTION IniSection;
+    PYORI_LIB_INI_KEY IniKey;
 
-    if (DllKernel32.pGetPrivateProfileSectionW == NULL) {
+    if (!IniToolLoadIniFile(UserFileName, &IniDocument)) {
+        YoriLibIniCleanup(&IniDocument);
         return FALSE;
     }
 
-    if (!YoriLibUserToSingleFilePath(UserFileName, FALSE, &RealFileName)) {
-        return FALSE;
-    }
-
-    if (!YoriLibAllocateString(&Value, 32 * 1024)) {
-        YoriLibFreeStringContents(&RealFileName);
-        return FALSE;
-    }
-
-    Value.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileSectionW(Section->StartOfString,
-                                               Value.StartOfString,
-                                               Value.LengthAllocated,
-                                               RealFileName.StartOfString);
-    ThisVar = Value.StartOfString;
-    while (*ThisVar != '\0') {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%s\n"), ThisVar);
-
-        ThisVar += _tcslen(ThisVar);
-        ThisVar++;
+    IniSection = YoriLibIniFindSection(&IniDocument, Section->StartOfString);
+    if (IniSection != NULL) {
+        IniKey = YoriLibIniGetNextKey(IniSection, NULL);
+        while (IniKey != NULL) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y=%y\n"), &IniKey->Name, &IniKey->Value);
+            IniKey = YoriLibIniGetNextKey(IniSection, IniKey);
+        }
     }
 
-    YoriLibFreeStringContents(&RealFileName);
-    YoriLibFreeStringContents(&Value);
+    YoriLibIniCleanup(&IniDocument);
     return TRUE;
 }
 
@@ -161,37 +180,21 @@ IniToolListSectionsFromIniFile(
     __in PYORI_STRING UserFileName
     )
 {
-    YORI_STRING RealFileName;
-    YORI_STRING Value;
-    LPTSTR ThisVar;
-
-    if (DllKernel32.pGetPrivateProfileSectionNamesW == NULL) {
-        return FALSE;
-    }
-
-    if (!YoriLibUserToSingleFilePath(UserFileName, FALSE, &RealFileName)) {
-        return FALSE;
-    }
+    YORI_LIB_INI_DOCUMENT IniDocument;
+    PYORI_LIB_INI_SECTION IniSection;
 
-    if (!YoriLibAllocateString(&Value, 32 * 1024)) {
-        YoriLibFreeStringContents(&RealFileName);
+    if (!IniToolLoadIniFile(UserFileName, &IniDocument)) {
+        YoriLibIniCleanup(&IniDocument);
         return FALSE;
     }
 
-    Value.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileSectionNamesW(Value.StartOfString,
-                                                    Value.LengthAllocated,
-                                                    RealFileName.StartOfString);
-    ThisVar = Value.StartOfString;
-    while (*ThisVar != '\0') {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%s\n"), ThisVar);
-
-        ThisVar += _tcslen(ThisVar);
-        ThisVar++;
+    IniSection = YoriLibIniGetNextSection(&IniDocument, NULL);
+    while (IniSection != NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), &IniSection->Name);
+        IniSection = YoriLibIniGetNextSection(&IniDocument, IniSection);
     }
 
-    YoriLibFreeStringContents(&RealFileName);
-    YoriLibFreeStringContents(&Value);
+    YoriLibIniCleanup(&IniDocument);
     return TRUE;
 }
 
@@ -213,33 +216,20 @@ IniToolReadFromIniFile(
     __in PYORI_STRING Key
     )
 {
-    YORI_STRING RealFileName;
-    YORI_STRING Value;
-
-    if (DllKernel32.pGetPrivateProfileStringW == NULL) {
-        return FALSE;
-    }
+    YORI_LIB_INI_DOCUMENT IniDocument;
+    PYORI_LIB_INI_KEY IniKey;
 
-    if (!YoriLibUserToSingleFilePath(UserFileName, FALSE, &RealFileName)) {
+    if (!IniToolLoadIniFile(UserFileName, &IniDocument)) {
+        YoriLibIniCleanup(&IniDocument);
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&Value, 32 * 1024)) {
-        YoriLibFreeStringContents(&RealFileName);
-        return FALSE;
+    IniKey = YoriLibIniFindSectionKey(&IniDocument, Section->StartOfString, Key->StartOfString);
+    if (IniKey != NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &IniKey->Value);
     }
 
-    Value.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(Section->StartOfString,
-                                              Key->StartOfString,
-                                              _T(""),
-                                              Value.StartOfString,
-                                              Value.LengthAllocated,
-                                              RealFileName.StartOfString);
-    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &Value);
-
-    YoriLibFreeStringContents(&RealFileName);
-    YoriLibFreeStringContents(&Value);
+    YoriLibIniCleanup(&IniDocument);
     return TRUE;
 }
 
@@ -264,23 +254,21 @@ IniToolWriteToIniFile(
     __in PYORI_STRING Value
     )
 {
-    YORI_STRING RealFileName;
-
-    if (DllKernel32.pWritePrivateProfileStringW == NULL) {
-        return FALSE;
-    }
+    YORI_LIB_INI_DOCUMENT IniDocument;
+    BOOL Result;
 
-    if (!YoriLibUserToSingleFilePath(UserFileName, FALSE, &RealFileName)) {
+    if (!IniToolLoadIniFile(UserFileName, &IniDocument)) {
+        YoriLibIniCleanup(&IniDocument);
         return FALSE;
     }
 
-    if (!DllKernel32.pWritePrivateProfileStringW(Section->StartOfString, Key->StartOfString, Value->StartOfString, RealFileName.StartOfString)) {
-        YoriLibFreeStringContents(&RealFileName);
-        return FALSE;
+    Result = FALSE;
+    if (YoriLibIniSetString(&IniDocument, Section->StartOfString, Key->StartOfString, Value->StartOfString)) {
+        Result = YoriLibIniSave(&IniDocument);
     }
 
-    YoriLibFreeStringContents(&RealFileName);
-    return TRUE;
+    YoriLibIniCleanup(&IniDocument);
+    return Result;
 }
 
 /**
@@ -342,7 +330,7 @@ ENTRYPOINT(
                 IniToolHelp();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2018"));
+                YoriLibDisplayMitLicense(_T("2018-2026"));
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("d")) == 0) {
                 Op = IniToolOpDeleteValue;
@@ -0,0 +1,214 @@
+/**
+ * @file lib/arena.c
+ *
+ * Yori arena allocation routines for short lived groups of allocations
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+/**
+ The alignment of each allocation returned from an arena.
+ */
+#define YORI_LIB_ARENA_ALIGNMENT (8)
+
+/**
+ Initialize an arena.  No memory is allocated until the first allocation is
+ requested from the arena.
+
+ @param Arena Pointer to the arena to initialize.
+
+ @param BlockSize The number of bytes to allocate from the heap each time the
+        arena needs more memory.  Allocations larger than this are satisfied
+        from their own block.
+ */
+VOID
+YoriLibArenaInitialize(
+    __out PYORI_LIB_ARENA Arena,
+    __in YORI_ALLOC_SIZE_T BlockSize
+    )
+{
+    Arena->Block = NULL;
+    Arena->BlockSize = 0;
+    Arena->BytesUsed = 0;
+    Arena->DefaultBlockSize = BlockSize;
+    Arena->BlocksAllocated = 0;
+    Arena->AllocationsSatisfied = 0;
+}
+
+/**
+ Release the arena's reference on its current block.  Memory that has been
+ handed out from the arena remains valid until each caller dereferences the
+ MemoryToFree value it was given, and each block is returned to the heap in
+ a single operation once its final reference is released.
+
+ @param Arena Pointer to the arena to clean up.
+ */
+VOID
+YoriLibArenaCleanup(
+    __inout PYORI_LIB_ARENA Arena
+    )
+{
+    if (Arena->Block != NULL) {
+        YoriLibDereference(Arena->Block);
+        Arena->Block = NULL;
+    }
+    Arena->BlockSize = 0;
+    Arena->BytesUsed = 0;
+}
+
+#if !YORI_SPECIAL_HEAP
+/**
+ Allocate memory from an arena.  The memory is not initialized.  The caller
+ is given a reference to the block containing the allocation in MemoryToFree,
+ which should be released with @ref YoriLibDereference when the allocation
+ is no longer needed, exactly as if it had come from
+ @ref YoriLibReferencedMalloc .  Additional references can be taken on
+ MemoryToFree to share the allocation.
+
+ @param Arena Pointer to the arena to allocate from.
+
+ @param Bytes The number of bytes to allocate.
+
+ @param MemoryToFree On successful completion, updated to point to a
+        referenced allocation containing the returned memory.
+
+ @return A pointer to the newly allocated memory, or NULL on failure.
+ */
+PVOID
+YoriLibArenaAllocate(
+    __inout PYORI_LIB_ARENA Arena,
+    __in YORI_ALLOC_SIZE_T Bytes,
+    __out PVOID *MemoryToFree
+    )
+{
+    PUCHAR NewBlock;
+    DWORD_PTR Address;
+    YORI_ALLOC_SIZE_T Offset;
+    YORI_ALLOC_SIZE_T NewBlockSize;
+
+    //
+    //  Try to satisfy the request from the current block.  Alignment is
+    //  applied to the address rather than the offset, since referenced
+    //  allocations are preceded by their header.
+    //
+
+    if (Arena->Block != NULL) {
+        Address = (DWORD_PTR)(Arena->Block + Arena->BytesUsed);
+        Address = (Address + YORI_LIB_ARENA_ALIGNMENT - 1) & ~((DWORD_PTR)YORI_LIB_ARENA_ALIGNMENT - 1);
+        Offset = (YORI_ALLOC_SIZE_T)(Address - (DWORD_PTR)Arena->Block);
+
+        if (Offset <= Arena->BlockSize && Bytes <= Arena->BlockSize - Offset) {
+            Arena->BytesUsed = Offset + Bytes;
+            Arena->AllocationsSatisfied++;
+            YoriLibReference(Arena->Block);
+            *MemoryToFree = Arena->Block;
+            return Arena->Block + Offset;
+        }
+    }
+
+    NewBlockSize = Arena->DefaultBlockSize;
+    if (Bytes > NewBlockSize) {
+        NewBlockSize = Bytes;
+    }
+
+    NewBlock = YoriLibReferencedMalloc(NewBlockSize);
+    if (NewBlock == NULL) {
+        return NULL;
+    }
+
+    Arena->BlocksAllocated++;
+    Arena->AllocationsSatisfied++;
+
+    //
+    //  If the new block has more space remaining than the current one,
+    //  switch to it so later allocations can use it.  Otherwise the new
+    //  block is owned exclusively by the caller.
+    //
+
+    if (Arena->Block == NULL ||
+        NewBlockSize - Bytes > Arena->BlockSize - Arena->BytesUsed) {
+
+        if (Arena->Block != NULL) {
+            YoriLibDereference(Arena->Block);
+        }
+
+        Arena->Block = NewBlock;
+        Arena->BlockSize = NewBlockSize;
+        Arena->BytesUsed = Bytes;
+        YoriLibReference(NewBlock);
+    }
+
+    *MemoryToFree = NewBlock;
+    return NewBlock;
+}
+#else
+/**
+ Allocate memory from an arena.  In debug builds, each arena allocation is
+ a separate allocation from the special heap, so that overruns are caught
+ by guard pages and leaks are reported against the code that allocated
+ them.  The arena only counts the requests it has been given.
+
+ @param Arena Pointer to the arena to allocate from.
+
+ @param Bytes The number of bytes to allocate.
+
+ @param MemoryToFree On successful completion, updated to point to a
+        referenced allocation containing the returned memory.
+
+ @param Function Pointer to a constant string indicating the function that is
+        allocating the memory.
+
+ @param File Pointer to a constant string indicating the source file that is
+        allocating the memory.
+
+ @param Line Specifies the line number within the source file that is
+        allocating the memory.
+
+ @return A pointer to the newly allocated memory, or NULL on failure.
+ */
+PVOID
+YoriLibArenaAllocateSpecialHeap(
+    __inout PYORI_LIB_ARENA Arena,
+    __in YORI_ALLOC_SIZE_T Bytes,
+    __out PVOID *MemoryToFree,
+    __in LPCSTR Function,
+    __in LPCSTR File,
+    __in DWORD Line
+    )
+{
+    PVOID Allocation;
+
+    Allocation = YoriLibReferencedMallocSpecialHeap(Bytes, Function, File, Line);
+    if (Allocation == NULL) {
+        return NULL;
+    }
+
+    Arena->BlocksAllocated++;
+    Arena->AllocationsSatisfied++;
+    *MemoryToFree = Allocation;
+    return Allocation;
+}
+#endif
+
+// vim:sw=4:ts=4:et:
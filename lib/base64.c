@@ -0,0 +1,712 @@
+/**
+ * @file lib/base64.c
+ *
+ * Yori streaming base64 encode and decode routines
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+/**
+ Set to nonzero if base64 encode and decode can use SSSE3.  Older compilers
+ don't know these instructions.  Processor support is checked at runtime, and
+ processors without them use the table driven implementation.
+ */
+#if (defined(_M_AMD64) || defined(_M_IX86)) && defined(_MSC_VER) && (_MSC_VER >= 1500)
+#define YORI_LIB_BASE64_SSSE3 1
+#include <intrin.h>
+#include <tmmintrin.h>
+#else
+#define YORI_LIB_BASE64_SSSE3 0
+#endif
+
+/**
+ The characters used to encode each six bit value.
+ */
+CONST CHAR YoriLibBase64EncodeTable[64] = {
+    'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M',
+    'N', 'O', 'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z',
+    'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm',
+    'n', 'o', 'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z',
+    '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', '+', '/'
+};
+
+/**
+ A value in YoriLibBase64DecodeTable indicating the character is whitespace
+ which should be ignored.
+ */
+#define YORI_LIB_BASE64_WHITESPACE (0x40)
+
+/**
+ A value in YoriLibBase64DecodeTable indicating the character is padding.
+ */
+#define YORI_LIB_BASE64_PADDING    (0x41)
+
+/**
+ A value in YoriLibBase64DecodeTable indicating the character is not valid
+ in base64 encoded data.
+ */
+#define YORI_LIB_BASE64_INVALID    (0xFF)
+
+/**
+ The six bit value for each character, or one of the values above.  This is
+ populated on first use.
+ */
+UCHAR YoriLibBase64DecodeTable[256];
+
+/**
+ Set to TRUE once YoriLibBase64DecodeTable has been populated.
+ */
+BOOLEAN YoriLibBase64DecodeTableInitialized;
+
+/**
+ Populate the table used to decode characters.  This can safely be performed
+ by multiple threads concurrently since each writes the same values.
+ */
+VOID
+YoriLibBase64InitializeDecodeTable(VOID)
+{
+    DWORD Index;
+
+    for (Index = 0; Index < sizeof(YoriLibBase64DecodeTable); Index++) {
+        YoriLibBase64DecodeTable[Index] = YORI_LIB_BASE64_INVALID;
+    }
+
+    for (Index = 0; Index < sizeof(YoriLibBase64EncodeTable); Index++) {
+        YoriLibBase64DecodeTable[(UCHAR)YoriLibBase64EncodeTable[Index]] = (UCHAR)Index;
+    }
+
+    YoriLibBase64DecodeTable[' '] = YORI_LIB_BASE64_WHITESPACE;
+    YoriLibBase64DecodeTable['\t'] = YORI_LIB_BASE64_WHITESPACE;
+    YoriLibBase64DecodeTable['\r'] = YORI_LIB_BASE64_WHITESPACE;
+    YoriLibBase64DecodeTable['\n'] = YORI_LIB_BASE64_WHITESPACE;
+    YoriLibBase64DecodeTable['\f'] = YORI_LIB_BASE64_WHITESPACE;
+    YoriLibBase64DecodeTable['\v'] = YORI_LIB_BASE64_WHITESPACE;
+    YoriLibBase64DecodeTable['='] = YORI_LIB_BASE64_PADDING;
+
+    YoriLibBase64DecodeTableInitialized = TRUE;
+}
+
+#if YORI_LIB_BASE64_SSSE3
+
+/**
+ Indicates whether the processor supports SSSE3.  Zero means this has not
+ been checked yet, one means the instructions are not present, and two means
+ they are present.
+ */
+DWORD YoriLibBase64Ssse3Support;
+
+/**
+ Returns TRUE if the processor supports SSSE3.
+
+ @return TRUE if SSSE3 can be used, FALSE if not.
+ */
+BOOLEAN
+YoriLibBase64IsSsse3Present(VOID)
+{
+    int CpuInfo[4];
+    DWORD Support;
+
+    if (YoriLibBase64Ssse3Support == 0) {
+        Support = 1;
+        __cpuid(CpuInfo, 0);
+        if (CpuInfo[0] >= 1) {
+            __cpuid(CpuInfo, 1);
+            if ((CpuInfo[2] & (1 << 9)) != 0) {
+                Support = 2;
+            }
+        }
+        YoriLibBase64Ssse3Support = Support;
+    }
+
+    return (BOOLEAN)(YoriLibBase64Ssse3Support == 2);
+}
+
+/**
+ Encode twelve bytes into sixteen characters using SSSE3.  Sixteen bytes are
+ read from the input, so the caller must ensure that many are present.
+
+ @param Input Pointer to the bytes to encode.
+
+ @param Output Pointer to a buffer to receive sixteen characters.
+ */
+VOID
+YoriLibBase64EncodeSsse3(
+    __in_ecount(16) CONST UCHAR * Input,
+    __out_bcount(16) PUCHAR Output
+    )
+{
+    __m128i In;
+    __m128i Indices;
+    __m128i Result;
+    __m128i Less;
+
+    //
+    //  Arrange each group of three bytes into a 32 bit value so that each
+    //  six bit field can be moved into its own byte with multiplies.
+    //
+
+    In = _mm_loadu_si128((const __m128i *)Input);
+    In = _mm_shuffle_epi8(In, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    Indices = _mm_or_si128(_mm_mulhi_epu16(_mm_and_si128(In, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040)),
+                           _mm_mullo_epi16(_mm_and_si128(In, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010)));
+
+    //
+    //  Translate each six bit value into a character by adding an offset
+    //  which depends on the range the value falls within.  Values 0-25 map
+    //  to index 13, 26-51 to index 0, and 52-63 to indices 1-12.
+    //
+
+    Result = _mm_subs_epu8(Indices, _mm_set1_epi8(51));
+    Less = _mm_cmpgt_epi8(_mm_set1_epi8(26), Indices);
+    Result = _mm_or_si128(Result, _mm_and_si128(Less, _mm_set1_epi8(13)));
+    Result = _mm_shuffle_epi8(_mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52,
+                                            '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                            '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                            '/' - 63, 'A', 0, 0),
+                              Result);
+
+    _mm_storeu_si128((__m128i *)Output, _mm_add_epi8(Result, Indices));
+}
+
+/**
+ Decode sixteen characters into twelve bytes using SSSE3.  Sixteen bytes are
+ written to the output.
+
+ @param Input Pointer to the characters to decode.
+
+ @param Output Pointer to a buffer to receive the decoded bytes.
+
+ @return TRUE if all sixteen characters are in the base64 alphabet and were
+         decoded, FALSE if any is not, in which case nothing is written.
+ */
+__success(return)
+BOOLEAN
+YoriLibBase64DecodeSsse3(
+    __in_ecount(16) CONST UCHAR * Input,
+    __out_bcount(16) PUCHAR Output
+    )
+{
+    __m128i In;
+    __m128i Mask2F;
+    __m128i HiNibbles;
+    __m128i Hi;
+    __m128i Lo;
+    __m128i Roll;
+
+    //
+    //  Classify each character by its high and low nibbles.  Each table
+    //  contains bits which are only both set for characters that are not in
+    //  the alphabet.  Note pshufb only considers the low four bits of each
+    //  index, so masking with 0x2F is equivalent to 0x0F.
+    //
+
+    In = _mm_loadu_si128((const __m128i *)Input);
+    Mask2F = _mm_set1_epi8(0x2f);
+    HiNibbles = _mm_and_si128(_mm_srli_epi32(In, 4), Mask2F);
+    Hi = _mm_shuffle_epi8(_mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10),
+                          HiNibbles);
+    Lo = _mm_shuffle_epi8(_mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                        0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A),
+                          _mm_and_si128(In, Mask2F));
+
+    if (_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(Lo, Hi), _mm_setzero_si128())) != 0) {
+        return FALSE;
+    }
+
+    //
+    //  Translate each character to its six bit value by adding an offset
+    //  which depends on its high nibble, with '/' handled specially since it
+    //  shares a high nibble with '+'.
+    //
+
+    Roll = _mm_shuffle_epi8(_mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71,
+                                          0, 0, 0, 0, 0, 0, 0, 0),
+                            _mm_add_epi8(_mm_cmpeq_epi8(In, Mask2F), HiNibbles));
+    In = _mm_add_epi8(In, Roll);
+
+    //
+    //  Combine each group of four six bit values into three bytes.
+    //
+
+    In = _mm_maddubs_epi16(In, _mm_set1_epi32(0x01400140));
+    In = _mm_madd_epi16(In, _mm_set1_epi32(0x00011000));
+    In = _mm_shuffle_epi8(In, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+
+    _mm_storeu_si128((__m128i *)Output, In);
+    return TRUE;
+}
+
+#endif
+
+/**
+ Encode three bytes into four characters.
+
+ @param Input Pointer to the bytes to encode.
+
+ @param Output Pointer to a buffer to receive four characters.
+ */
+VOID
+YoriLibBase64EncodeQuantum(
+    __in_ecount(3) CONST UCHAR * Input,
+    __out_bcount(4) PUCHAR Output
+    )
+{
+    DWORD Value;
+
+    Value = (Input[0] << 16) | (Input[1] << 8) | Input[2];
+    Output[0] = YoriLibBase64EncodeTable[(Value >> 18) & 0x3F];
+    Output[1] = YoriLibBase64EncodeTable[(Value >> 12) & 0x3F];
+    Output[2] = YoriLibBase64EncodeTable[(Value >> 6) & 0x3F];
+    Output[3] = YoriLibBase64EncodeTable[Value & 0x3F];
+}
+
+/**
+ Prepare to encode data in base64 form.
+
+ @param Context Pointer to the context to initialize.
+
+ @param LineLength The number of characters to output before a line break,
+        which must be a multiple of four.  If zero, no line breaks are
+        output.  @ref YORI_LIB_BASE64_DEFAULT_LINE_LENGTH matches the form
+        used by CryptBinaryToString.
+ */
+VOID
+YoriLibBase64EncodeInitialize(
+    __out PYORI_LIB_BASE64_ENCODE_CONTEXT Context,
+    __in DWORD LineLength
+    )
+{
+    ASSERT((LineLength % 4) == 0);
+    Context->LineLength = LineLength;
+    Context->CharsOnLine = 0;
+    Context->PendingLength = 0;
+}
+
+/**
+ Return the size of a buffer that is large enough to contain the output from
+ encoding a specified number of bytes, including the output from finalizing
+ the encode.
+
+ @param Context Pointer to the encode context.
+
+ @param InputLength The number of bytes that will be supplied to
+        @ref YoriLibBase64EncodeUpdate .
+
+ @return The number of bytes of output buffer to supply.
+ */
+YORI_ALLOC_SIZE_T
+YoriLibBase64EncodeGetBufferSize(
+    __in PYORI_LIB_BASE64_ENCODE_CONTEXT Context,
+    __in YORI_ALLOC_SIZE_T InputLength
+    )
+{
+    YORI_ALLOC_SIZE_T Chars;
+
+    Chars = (Context->PendingLength + InputLength + 2) / 3 * 4;
+    if (Context->LineLength != 0) {
+        Chars = Chars + ((Context->CharsOnLine + Chars) / Context->LineLength + 1) * 2;
+    }
+    return Chars;
+}
+
+/**
+ Encode a buffer of data, and output as many characters as possible.  Up to
+ two bytes are retained in the context until more data is supplied or the
+ encode is finalized.
+
+ @param Context Pointer to the encode context.
+
+ @param Input Pointer to the data to encode.
+
+ @param InputLength The number of bytes in Input.
+
+ @param Output Pointer to a buffer to receive encoded characters.  This must
+        be at least the size returned from
+        @ref YoriLibBase64EncodeGetBufferSize .
+
+ @return The number of characters written to Output.
+ */
+YORI_ALLOC_SIZE_T
+YoriLibBase64EncodeUpdate(
+    __inout PYORI_LIB_BASE64_ENCODE_CONTEXT Context,
+    __in_ecount(InputLength) CONST UCHAR * Input,
+    __in YORI_ALLOC_SIZE_T InputLength,
+    __out PUCHAR Output
+    )
+{
+    YORI_ALLOC_SIZE_T InputIndex;
+    YORI_ALLOC_SIZE_T OutputIndex;
+    DWORD LineLength;
+    DWORD CharsOnLine;
+#if YORI_LIB_BASE64_SSSE3
+    BOOLEAN UseSsse3;
+
+    UseSsse3 = YoriLibBase64IsSsse3Present();
+#endif
+
+    InputIndex = 0;
+    OutputIndex = 0;
+    LineLength = Context->LineLength;
+    CharsOnLine = Context->CharsOnLine;
+
+    //
+    //  If bytes are left over from a previous call, complete the quantum.
+    //
+
+    if (Context->PendingLength > 0) {
+        while (Context->PendingLength < 3 && InputIndex < InputLength) {
+            Context->Pending[Context->PendingLength] = Input[InputIndex];
+            Context->PendingLength++;
+            InputIndex++;
+        }
+
+        if (Context->PendingLength < 3) {
+            return 0;
+        }
+
+        YoriLibBase64EncodeQuantum(Context->Pending, &Output[OutputIndex]);
+        OutputIndex = OutputIndex + 4;
+        CharsOnLine = CharsOnLine + 4;
+        Context->PendingLength = 0;
+        if (LineLength != 0 && CharsOnLine >= LineLength) {
+            Output[OutputIndex++] = '\r';
+            Output[OutputIndex++] = '\n';
+            CharsOnLine = 0;
+        }
+    }
+
+    while (InputLength - InputIndex >= 3) {
+#if YORI_LIB_BASE64_SSSE3
+        if (UseSsse3 &&
+            InputLength - InputIndex >= 16 &&
+            (LineLength == 0 || LineLength - CharsOnLine >= 16)) {
+
+            YoriLibBase64EncodeSsse3(&Input[InputIndex], &Output[OutputIndex]);
+            InputIndex = InputIndex + 12;
+            OutputIndex = OutputIndex + 16;
+            CharsOnLine = CharsOnLine + 16;
+        } else {
+#endif
+            YoriLibBase64EncodeQuantum(&Input[InputIndex], &Output[OutputIndex]);
+            InputIndex = InputIndex + 3;
+            OutputIndex = OutputIndex + 4;
+            CharsOnLine = CharsOnLine + 4;
+#if YORI_LIB_BASE64_SSSE3
+        }
+#endif
+
+        if (LineLength != 0 && CharsOnLine >= LineLength) {
+            Output[OutputIndex++] = '\r';
+            Output[OutputIndex++] = '\n';
+            CharsOnLine = 0;
+        }
+    }
+
+    while (InputIndex < InputLength) {
+        Context->Pending[Context->PendingLength] = Input[InputIndex];
+        Context->PendingLength++;
+        InputIndex++;
+    }
+
+    Context->CharsOnLine = CharsOnLine;
+    return OutputIndex;
+}
+
+/**
+ Complete a base64 encode, outputting any remaining bytes with padding and
+ terminating the final line.
+
+ @param Context Pointer to the encode context.
+
+ @param Output Pointer to a buffer to receive encoded characters.  This must
+        be at least @ref YORI_LIB_BASE64_ENCODE_FINAL_SIZE bytes.
+
+ @return The number of characters written to Output.
+ */
+YORI_ALLOC_SIZE_T
+YoriLibBase64EncodeFinalize(
+    __inout PYORI_LIB_BASE64_ENCODE_CONTEXT Context,
+    __out_bcount(YORI_LIB_BASE64_ENCODE_FINAL_SIZE) PUCHAR Output
+    )
+{
+    YORI_ALLOC_SIZE_T OutputIndex;
+    UCHAR Quantum[3];
+
+    OutputIndex = 0;
+    if (Context->PendingLength > 0) {
+        Quantum[0] = Context->Pending[0];
+        Quantum[1] = 0;
+        Quantum[2] = 0;
+        if (Context->PendingLength > 1) {
+            Quantum[1] = Context->Pending[1];
+        }
+        YoriLibBase64EncodeQuantum(Quantum, Output);
+        Output[3] = '=';
+        if (Context->PendingLength == 1) {
+            Output[2] = '=';
+        }
+        OutputIndex = 4;
+        Context->CharsOnLine = Context->CharsOnLine + 4;
+        Context->PendingLength = 0;
+    }
+
+    if (Context->LineLength != 0 && Context->CharsOnLine > 0) {
+        Output[OutputIndex++] = '\r';
+        Output[OutputIndex++] = '\n';
+        Context->CharsOnLine = 0;
+    }
+
+    return OutputIndex;
+}
+
+/**
+ Prepare to decode data from base64 form.
+
+ @param Context Pointer to the context to initialize.
+ */
+VOID
+YoriLibBase64DecodeInitialize(
+    __out PYORI_LIB_BASE64_DECODE_CONTEXT Context
+    )
+{
+    if (!YoriLibBase64DecodeTableInitialized) {
+        YoriLibBase64InitializeDecodeTable();
+    }
+
+    Context->Quantum = 0;
+    Context->QuantumChars = 0;
+    Context->PaddingChars = 0;
+    Context->CharsProcessed = 0;
+}
+
+/**
+ Return the size of a buffer that is large enough to contain the output from
+ decoding a specified number of characters.
+
+ @param Context Pointer to the decode context.
+
+ @param InputLength The number of characters that will be supplied to
+        @ref YoriLibBase64DecodeUpdate .
+
+ @return The number of bytes of output buffer to supply.
+ */
+YORI_ALLOC_SIZE_T
+YoriLibBase64DecodeGetBufferSize(
+    __in PYORI_LIB_BASE64_DECODE_CONTEXT Context,
+    __in YORI_ALLOC_SIZE_T InputLength
+    )
+{
+    //
+    //  The vectorized path writes four bytes beyond the data it decodes.
+    //
+
+    return (Context->QuantumChars + InputLength) / 4 * 3 + 4;
+}
+
+/**
+ Decode a buffer of base64 characters.  Whitespace, including line breaks,
+ is ignored.  Up to three characters are retained in the context until more
+ data is supplied or the decode is finalized.
+
+ @param Context Pointer to the decode context.
+
+ @param Input Pointer to the characters to decode.  Since the base64
+        alphabet is ASCII, this can be in any encoding that is a superset of
+        ASCII.
+
+ @param InputLength The number of characters in Input.
+
+ @param Output Pointer to a buffer to receive decoded bytes.  This must be at
+        least the size returned from @ref YoriLibBase64DecodeGetBufferSize .
+
+ @param OutputLength On successful completion, updated to contain the number
+        of bytes written to Output.
+
+ @return TRUE to indicate success, FALSE if the input is not valid base64.
+         On failure, Context->CharsProcessed indicates the offset of the
+         invalid character from the beginning of the data.
+ */
+__success(return)
+BOOLEAN
+YoriLibBase64DecodeUpdate(
+    __inout PYORI_LIB_BASE64_DECODE_CONTEXT Context,
+    __in_ecount(InputLength) CONST UCHAR * Input,
+    __in YORI_ALLOC_SIZE_T InputLength,
+    __out PUCHAR Output,
+    __out PYORI_ALLOC_SIZE_T OutputLength
+    )
+{
+    YORI_ALLOC_SIZE_T InputIndex;
+    YORI_ALLOC_SIZE_T OutputIndex;
+    DWORD Quantum;
+    DWORD QuantumChars;
+    UCHAR Value;
+#if YORI_LIB_BASE64_SSSE3
+    BOOLEAN UseSsse3;
+    YORI_ALLOC_SIZE_T NextSsse3Attempt;
+
+    UseSsse3 = YoriLibBase64IsSsse3Present();
+    NextSsse3Attempt = 0;
+#endif
+
+    InputIndex = 0;
+    OutputIndex = 0;
+    Quantum = Context->Quantum;
+    QuantumChars = Context->QuantumChars;
+
+    while (InputIndex < InputLength) {
+
+#if YORI_LIB_BASE64_SSSE3
+
+        //
+        //  If the next sixteen characters are all in the alphabet, decode
+        //  them at once.  If not, they contain whitespace or padding, so
+        //  decode them individually before trying again.
+        //
+
+        if (UseSsse3 &&
+            QuantumChars == 0 &&
+            InputIndex >= NextSsse3Attempt &&
+            InputLength - InputIndex >= 16) {
+
+            if (YoriLibBase64DecodeSsse3(&Input[InputIndex], &Output[OutputIndex])) {
+                if (Context->PaddingChars > 0) {
+                    break;
+                }
+                InputIndex = InputIndex + 16;
+                OutputIndex = OutputIndex + 12;
+                continue;
+            }
+            NextSsse3Attempt = InputIndex + 16;
+        }
+#endif
+
+        Value = YoriLibBase64DecodeTable[Input[InputIndex]];
+        if (Value < 64) {
+
+            //
+            //  Data cannot follow padding.
+            //
+
+            if (Context->PaddingChars > 0) {
+                break;
+            }
+
+            Quantum = (Quantum << 6) | Value;
+            QuantumChars++;
+            if (QuantumChars == 4) {
+                Output[OutputIndex] = (UCHAR)(Quantum >> 16);
+                Output[OutputIndex + 1] = (UCHAR)(Quantum >> 8);
+                Output[OutputIndex + 2] = (UCHAR)Quantum;
+                OutputIndex = OutputIndex + 3;
+                Quantum = 0;
+                QuantumChars = 0;
+            }
+        } else if (Value == YORI_LIB_BASE64_PADDING) {
+
+            //
+            //  Padding completes a quantum of two or three characters.
+            //  Once the quantum is complete, no more padding is expected.
+            //
+
+            if (QuantumChars < 2) {
+                break;
+            }
+            Context->PaddingChars++;
+            if (QuantumChars + Context->PaddingChars == 4) {
+                Quantum = Quantum << (6 * (4 - QuantumChars));
+                Output[OutputIndex++] = (UCHAR)(Quantum >> 16);
+                if (QuantumChars == 3) {
+                    Output[OutputIndex++] = (UCHAR)(Quantum >> 8);
+                }
+                Quantum = 0;
+                QuantumChars = 0;
+            }
+        } else if (Value != YORI_LIB_BASE64_WHITESPACE) {
+            break;
+        }
+
+        InputIndex++;
+    }
+
+    Context->CharsProcessed = Context->CharsProcessed + InputIndex;
+    Context->Quantum = Quantum;
+    Context->QuantumChars = QuantumChars;
+    *OutputLength = OutputIndex;
+
+    if (InputIndex < InputLength) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Complete a base64 decode.  Input which ends without complete padding is
+ accepted, and the remaining characters are decoded.
+
+ @param Context Pointer to the decode context.
+
+ @param Output Pointer to a buffer to receive decoded bytes.  This must be at
+        least @ref YORI_LIB_BASE64_DECODE_FINAL_SIZE bytes.
+
+ @param OutputLength On successful completion, updated to contain the number
+        of bytes written to Output.
+
+ @return TRUE to indicate success, FALSE if the input ended partway through
+         a quantum in a way that cannot be decoded.
+ */
+__success(return)
+BOOLEAN
+YoriLibBase64DecodeFinalize(
+    __inout PYORI_LIB_BASE64_DECODE_CONTEXT Context,
+    __out_bcount(YORI_LIB_BASE64_DECODE_FINAL_SIZE) PUCHAR Output,
+    __out PYORI_ALLOC_SIZE_T OutputLength
+    )
+{
+    DWORD Quantum;
+    YORI_ALLOC_SIZE_T OutputIndex;
+
+    OutputIndex = 0;
+    if (Context->QuantumChars == 1) {
+        return FALSE;
+    }
+
+    if (Context->QuantumChars > 1) {
+        Quantum = Context->Quantum << (6 * (4 - Context->QuantumChars));
+        Output[OutputIndex++] = (UCHAR)(Quantum >> 16);
+        if (Context->QuantumChars == 3) {
+            Output[OutputIndex++] = (UCHAR)(Quantum >> 8);
+        }
+    }
+
+    Context->Quantum = 0;
+    Context->QuantumChars = 0;
+    *OutputLength = OutputIndex;
+    return TRUE;
+}
+
+// vim:sw=4:ts=4:et:
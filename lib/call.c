@@ -4,7 +4,7 @@
  * Yori call from modules into external API.  Functions in this file can only
  * be called from code running within the Yori process.
  *
- * Copyright (c) 2017-2025 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -245,6 +245,43 @@ YoriCallBuiltinUnregister(
 }
 
 
+/**
+ Prototype for the @ref YoriApiClearExecutableCache function.
+ */
+typedef BOOL YORI_API_CLEAR_EXECUTABLE_CACHE(VOID);
+
+/**
+ Prototype for a pointer to the @ref YoriApiClearExecutableCache function.
+ */
+typedef YORI_API_CLEAR_EXECUTABLE_CACHE *PYORI_API_CLEAR_EXECUTABLE_CACHE;
+
+/**
+ Pointer to the @ref YoriApiClearExecutableCache function.
+ */
+PYORI_API_CLEAR_EXECUTABLE_CACHE pYoriApiClearExecutableCache;
+
+/**
+ Discard all cached executable locations.
+
+ @return TRUE if the cache was successfully discarded, FALSE if not.
+ */
+__success(return)
+BOOL
+YoriCallClearExecutableCache(VOID)
+{
+    if (pYoriApiClearExecutableCache == NULL) {
+        HMODULE hYori;
+
+        hYori = GetModuleHandle(NULL);
+        __analysis_assume(hYori != NULL);
+        pYoriApiClearExecutableCache = (PYORI_API_CLEAR_EXECUTABLE_CACHE)GetProcAddress(hYori, "YoriApiClearExecutableCache");
+        if (pYoriApiClearExecutableCache == NULL) {
+            return FALSE;
+        }
+    }
+    return pYoriApiClearExecutableCache();
+}
+
 /**
  Prototype for the @ref YoriApiClearHistoryStrings function.
  */
@@ -789,6 +826,51 @@ YoriCallGetEscapedArgumentsEx(
     return pYoriApiGetEscapedArgumentsEx(ArgC, ArgV, ArgContainsQuotes);
 }
 
+/**
+ Prototype for the @ref YoriApiGetExecutableCacheStrings function.
+ */
+typedef BOOL YORI_API_GET_EXECUTABLE_CACHE_STRINGS(PYORI_STRING);
+
+/**
+ Prototype for a pointer to the @ref YoriApiGetExecutableCacheStrings function.
+ */
+typedef YORI_API_GET_EXECUTABLE_CACHE_STRINGS *PYORI_API_GET_EXECUTABLE_CACHE_STRINGS;
+
+/**
+ Pointer to the @ref YoriApiGetExecutableCacheStrings function.
+ */
+PYORI_API_GET_EXECUTABLE_CACHE_STRINGS pYoriApiGetExecutableCacheStrings;
+
+/**
+ Build the set of executables located via the executable cache into an
+ array of key value pairs, where the key is the command name and the value
+ is the path to the executable.  The result must be freed with a subsequent
+ call to @ref YoriCallFreeYoriString .
+
+ @param CacheStrings On successful completion, populated with the cache
+        strings.
+
+ @return TRUE to indicate success, or FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriCallGetExecutableCacheStrings(
+    __out PYORI_STRING CacheStrings
+    )
+{
+    if (pYoriApiGetExecutableCacheStrings == NULL) {
+        HMODULE hYori;
+
+        hYori = GetModuleHandle(NULL);
+        __analysis_assume(hYori != NULL);
+        pYoriApiGetExecutableCacheStrings = (PYORI_API_GET_EXECUTABLE_CACHE_STRINGS)GetProcAddress(hYori, "YoriApiGetExecutableCacheStrings");
+        if (pYoriApiGetExecutableCacheStrings == NULL) {
+            return FALSE;
+        }
+    }
+    return pYoriApiGetExecutableCacheStrings(CacheStrings);
+}
+
 /**
  Prototype for the @ref YoriApiGetHistoryStrings function.
  */
@@ -0,0 +1,1558 @@
+/**
+ * @file lib/digest.c
+ *
+ * Yori native message digest routines
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+/**
+ Set to nonzero if XXH3 and BLAKE3 should use SSE2.  SSE2 is part of the
+ base AMD64 architecture so it can be used without checking processor
+ support.  32 bit x86 builds are expected to run on processors without it.
+ */
+#if defined(_M_AMD64) && defined(_MSC_VER) && (_MSC_VER >= 1400)
+#define YORI_LIB_DIGEST_SSE2 1
+#include <emmintrin.h>
+#else
+#define YORI_LIB_DIGEST_SSE2 0
+#endif
+
+/**
+ Set to nonzero if SHA-256 can use the processor's SHA extensions.  Older
+ compilers don't know these instructions.  Processor support is checked at
+ runtime, and processors without them use the portable implementation.
+ */
+#if (defined(_M_AMD64) || defined(_M_IX86)) && defined(_MSC_VER) && (_MSC_VER >= 1900)
+#define YORI_LIB_DIGEST_SHA_NI 1
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#define YORI_LIB_DIGEST_SHA_NI 0
+#endif
+
+/**
+ Construct a 64 bit constant from two 32 bit halves.  Older compilers don't
+ support 64 bit literals.
+ */
+#define YORI_LIB_DIGEST_CONST64(Hi, Lo) ((((DWORDLONG)(Hi)) << 32) | (DWORDLONG)(Lo))
+
+/**
+ Rotate a 32 bit value right by the specified number of bits.
+ */
+#define YORI_LIB_DIGEST_ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+/**
+ Rotate a 64 bit value left by the specified number of bits.
+ */
+#define YORI_LIB_DIGEST_ROTL64(x, n) (((x) << (n)) | ((x) >> (64 - (n))))
+
+#if defined(_M_AMD64) || defined(_M_IX86)
+
+/**
+ Read a little endian 32 bit value from a potentially unaligned address.
+ This architecture allows unaligned loads.
+ */
+#define YORI_LIB_DIGEST_READ32(p) (*(DWORD UNALIGNED *)(p))
+
+/**
+ Read a little endian 64 bit value from a potentially unaligned address.
+ This architecture allows unaligned loads.
+ */
+#define YORI_LIB_DIGEST_READ64(p) (*(DWORDLONG UNALIGNED *)(p))
+
+#else
+
+/**
+ Read a little endian 32 bit value from a potentially unaligned address.
+ */
+#define YORI_LIB_DIGEST_READ32(p)           \
+    ((DWORD)((CONST UCHAR *)(p))[0]       | \
+     ((DWORD)((CONST UCHAR *)(p))[1] << 8)  | \
+     ((DWORD)((CONST UCHAR *)(p))[2] << 16) | \
+     ((DWORD)((CONST UCHAR *)(p))[3] << 24))
+
+/**
+ Read a little endian 64 bit value from a potentially unaligned address.
+ */
+#define YORI_LIB_DIGEST_READ64(p) \
+    ((DWORDLONG)YORI_LIB_DIGEST_READ32(p) | ((DWORDLONG)YORI_LIB_DIGEST_READ32((CONST UCHAR *)(p) + 4) << 32))
+
+#endif
+
+/**
+ Read a big endian 32 bit value from a potentially unaligned address.
+ */
+#define YORI_LIB_DIGEST_READ32_BE(p)         \
+    (((DWORD)((CONST UCHAR *)(p))[0] << 24) | \
+     ((DWORD)((CONST UCHAR *)(p))[1] << 16) | \
+     ((DWORD)((CONST UCHAR *)(p))[2] << 8)  | \
+     (DWORD)((CONST UCHAR *)(p))[3])
+
+/**
+ Write a 32 bit value to a buffer in big endian form.
+
+ @param Buffer Pointer to the buffer to write to.
+
+ @param Value The value to write.
+ */
+VOID
+YoriLibDigestWrite32Be(
+    __out_bcount(4) PUCHAR Buffer,
+    __in DWORD Value
+    )
+{
+    Buffer[0] = (UCHAR)(Value >> 24);
+    Buffer[1] = (UCHAR)(Value >> 16);
+    Buffer[2] = (UCHAR)(Value >> 8);
+    Buffer[3] = (UCHAR)Value;
+}
+
+//
+//  SHA-256, as described in FIPS 180-4.
+//
+
+/**
+ The SHA-256 round constants.
+ */
+CONST DWORD YoriLibSha256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+/**
+ The SHA-256 initial hash value.  BLAKE3 uses the same value as its
+ initialization vector.
+ */
+CONST DWORD YoriLibSha256Iv[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+/**
+ Process one or more 64 byte blocks of input using portable code.
+
+ @param State The current hash state, updated on completion.
+
+ @param Blocks Pointer to the input blocks.
+
+ @param BlockCount The number of 64 byte blocks to process.
+ */
+VOID
+YoriLibSha256CompressPortable(
+    __inout PDWORD State,
+    __in CONST UCHAR * Blocks,
+    __in DWORD BlockCount
+    )
+{
+    DWORD W[64];
+    DWORD a, b, c, d, e, f, g, h;
+    DWORD T1, T2;
+    DWORD Index;
+
+    for (; BlockCount > 0; BlockCount--, Blocks += 64) {
+        for (Index = 0; Index < 16; Index++) {
+            W[Index] = YORI_LIB_DIGEST_READ32_BE(Blocks + Index * 4);
+        }
+
+        for (Index = 16; Index < 64; Index++) {
+            T1 = W[Index - 2];
+            T2 = W[Index - 15];
+            W[Index] = (YORI_LIB_DIGEST_ROTR32(T1, 17) ^ YORI_LIB_DIGEST_ROTR32(T1, 19) ^ (T1 >> 10)) +
+                       W[Index - 7] +
+                       (YORI_LIB_DIGEST_ROTR32(T2, 7) ^ YORI_LIB_DIGEST_ROTR32(T2, 18) ^ (T2 >> 3)) +
+                       W[Index - 16];
+        }
+
+        a = State[0];
+        b = State[1];
+        c = State[2];
+        d = State[3];
+        e = State[4];
+        f = State[5];
+        g = State[6];
+        h = State[7];
+
+        for (Index = 0; Index < 64; Index++) {
+            T1 = h +
+                 (YORI_LIB_DIGEST_ROTR32(e, 6) ^ YORI_LIB_DIGEST_ROTR32(e, 11) ^ YORI_LIB_DIGEST_ROTR32(e, 25)) +
+                 ((e & f) ^ (~e & g)) +
+                 YoriLibSha256K[Index] +
+                 W[Index];
+            T2 = (YORI_LIB_DIGEST_ROTR32(a, 2) ^ YORI_LIB_DIGEST_ROTR32(a, 13) ^ YORI_LIB_DIGEST_ROTR32(a, 22)) +
+                 ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + T1;
+            d = c;
+            c = b;
+            b = a;
+            a = T1 + T2;
+        }
+
+        State[0] += a;
+        State[1] += b;
+        State[2] += c;
+        State[3] += d;
+        State[4] += e;
+        State[5] += f;
+        State[6] += g;
+        State[7] += h;
+    }
+}
+
+#if YORI_LIB_DIGEST_SHA_NI
+
+/**
+ Indicates whether the processor supports the SHA extensions.  Zero means
+ this has not been checked yet, one means the extensions are not present,
+ and two means they are present.
+ */
+DWORD YoriLibSha256ShaNiSupport;
+
+/**
+ Returns TRUE if the processor supports the SHA extensions along with the
+ SSSE3 and SSE4.1 instructions used alongside them.
+
+ @return TRUE if the SHA extensions can be used, FALSE if not.
+ */
+BOOLEAN
+YoriLibSha256IsShaNiPresent(VOID)
+{
+    int CpuInfo[4];
+    DWORD Support;
+
+    if (YoriLibSha256ShaNiSupport == 0) {
+        Support = 1;
+        __cpuid(CpuInfo, 0);
+        if (CpuInfo[0] >= 7) {
+            __cpuid(CpuInfo, 1);
+            if ((CpuInfo[2] & (1 << 9)) != 0 &&
+                (CpuInfo[2] & (1 << 19)) != 0) {
+
+                __cpuidex(CpuInfo, 7, 0);
+                if ((CpuInfo[1] & (1 << 29)) != 0) {
+                    Support = 2;
+                }
+            }
+        }
+        YoriLibSha256ShaNiSupport = Support;
+    }
+
+    return (BOOLEAN)(YoriLibSha256ShaNiSupport == 2);
+}
+
+/**
+ Perform four rounds of SHA-256 using the SHA extensions.  Msg contains the
+ message schedule for these rounds, and KIndex the index of the first round
+ constant.
+ */
+#define YORI_LIB_SHA_NI_ROUNDS(Msg, KIndex)                                              \
+    MsgK = _mm_add_epi32(Msg, _mm_loadu_si128((const __m128i *)&YoriLibSha256K[KIndex])); \
+    State1 = _mm_sha256rnds2_epu32(State1, State0, MsgK);                                \
+    MsgK = _mm_shuffle_epi32(MsgK, 0x0E);                                                \
+    State0 = _mm_sha256rnds2_epu32(State0, State1, MsgK);
+
+/**
+ Complete the message schedule for a future group of four rounds.
+ */
+#define YORI_LIB_SHA_NI_SCHEDULE2(Cur, Prev, Next) \
+    Next = _mm_sha256msg2_epu32(_mm_add_epi32(Next, _mm_alignr_epi8(Cur, Prev, 4)), Cur);
+
+/**
+ Begin the message schedule for a future group of four rounds.
+ */
+#define YORI_LIB_SHA_NI_SCHEDULE1(Prev, Cur) \
+    Prev = _mm_sha256msg1_epu32(Prev, Cur);
+
+/**
+ Process one or more 64 byte blocks of input using the processor's SHA
+ extensions.
+
+ @param State The current hash state, updated on completion.
+
+ @param Blocks Pointer to the input blocks.
+
+ @param BlockCount The number of 64 byte blocks to process.
+ */
+VOID
+YoriLibSha256CompressShaNi(
+    __inout PDWORD State,
+    __in CONST UCHAR * Blocks,
+    __in DWORD BlockCount
+    )
+{
+    __m128i State0;
+    __m128i State1;
+    __m128i SavedState0;
+    __m128i SavedState1;
+    __m128i Msg0;
+    __m128i Msg1;
+    __m128i Msg2;
+    __m128i Msg3;
+    __m128i MsgK;
+    __m128i Temp;
+    __m128i ByteSwap;
+
+    ByteSwap = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+
+    //
+    //  The instructions operate on the state as ABEF and CDGH.
+    //
+
+    Temp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&State[0]), 0xB1);
+    State1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&State[4]), 0x1B);
+    State0 = _mm_alignr_epi8(Temp, State1, 8);
+    State1 = _mm_blend_epi16(State1, Temp, 0xF0);
+
+    for (; BlockCount > 0; BlockCount--, Blocks += 64) {
+        SavedState0 = State0;
+        SavedState1 = State1;
+
+        Msg0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(Blocks + 0)), ByteSwap);
+        Msg1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(Blocks + 16)), ByteSwap);
+        Msg2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(Blocks + 32)), ByteSwap);
+        Msg3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(Blocks + 48)), ByteSwap);
+
+        YORI_LIB_SHA_NI_ROUNDS(Msg0, 0);
+        YORI_LIB_SHA_NI_ROUNDS(Msg1, 4);
+        YORI_LIB_SHA_NI_SCHEDULE1(Msg0, Msg1);
+        YORI_LIB_SHA_NI_ROUNDS(Msg2, 8);
+        YORI_LIB_SHA_NI_SCHEDULE1(Msg1, Msg2);
+        YORI_LIB_SHA_NI_ROUNDS(Msg3, 12);
+        YORI_LIB_SHA_NI_SCHEDULE2(Msg3, Msg2, Msg0);
+        YORI_LIB_SHA_NI_SCHEDULE1(Msg2, Msg3);
+        YORI_LIB_SHA_NI_ROUNDS(Msg0, 16);
+        YORI_LIB_SHA_NI_SCHEDULE2(Msg0, Msg3, Msg1);
+        YORI_LIB_SHA_NI_SCHEDULE1(Msg3, Msg0);
+        YORI_LIB_SHA_NI_ROUNDS(Msg1, 20);
+        YORI_LIB_SHA_NI_SCHEDULE2(Msg1, Msg0, Msg2);
+        YORI_LIB_SHA_NI_SCHEDULE1(Msg0, Msg1);
+        YORI_LIB_SHA_NI_ROUNDS(Msg2, 24);
+        YORI_LIB_SHA_NI_SCHEDULE2(Msg2, Msg1, Msg3);
+        YORI_LIB_SHA_NI_SCHEDULE1(Msg1, Msg2);
+        YORI_LIB_SHA_NI_ROUNDS(Msg3, 28);
+        YORI_LIB_SHA_NI_SCHEDULE2(Msg3, Msg2, Msg0);
+        YORI_LIB_SHA_NI_SCHEDULE1(Msg2, Msg3);
+        YORI_LIB_SHA_NI_ROUNDS(Msg0, 32);
+        YORI_LIB_SHA_NI_SCHEDULE2(Msg0, Msg3, Msg1);
+        YORI_LIB_SHA_NI_SCHEDULE1(Msg3, Msg0);
+        YORI_LIB_SHA_NI_ROUNDS(Msg1, 36);
+        YORI_LIB_SHA_NI_SCHEDULE2(Msg1, Msg0, Msg2);
+        YORI_LIB_SHA_NI_SCHEDULE1(Msg0, Msg1);
+        YORI_LIB_SHA_NI_ROUNDS(Msg2, 40);
+        YORI_LIB_SHA_NI_SCHEDULE2(Msg2, Msg1, Msg3);
+        YORI_LIB_SHA_NI_SCHEDULE1(Msg1, Msg2);
+        YORI_LIB_SHA_NI_ROUNDS(Msg3, 44);
+        YORI_LIB_SHA_NI_SCHEDULE2(Msg3, Msg2, Msg0);
+        YORI_LIB_SHA_NI_SCHEDULE1(Msg2, Msg3);
+        YORI_LIB_SHA_NI_ROUNDS(Msg0, 48);
+        YORI_LIB_SHA_NI_SCHEDULE2(Msg0, Msg3, Msg1);
+        YORI_LIB_SHA_NI_SCHEDULE1(Msg3, Msg0);
+        YORI_LIB_SHA_NI_ROUNDS(Msg1, 52);
+        YORI_LIB_SHA_NI_SCHEDULE2(Msg1, Msg0, Msg2);
+        YORI_LIB_SHA_NI_ROUNDS(Msg2, 56);
+        YORI_LIB_SHA_NI_SCHEDULE2(Msg2, Msg1, Msg3);
+        YORI_LIB_SHA_NI_ROUNDS(Msg3, 60);
+
+        State0 = _mm_add_epi32(State0, SavedState0);
+        State1 = _mm_add_epi32(State1, SavedState1);
+    }
+
+    Temp = _mm_shuffle_epi32(State0, 0x1B);
+    State1 = _mm_shuffle_epi32(State1, 0xB1);
+    State0 = _mm_blend_epi16(Temp, State1, 0xF0);
+    State1 = _mm_alignr_epi8(State1, Temp, 8);
+
+    _mm_storeu_si128((__m128i *)&State[0], State0);
+    _mm_storeu_si128((__m128i *)&State[4], State1);
+}
+
+#endif
+
+/**
+ Process one or more 64 byte blocks of input, using the processor's SHA
+ extensions if they are available.
+
+ @param State The current hash state, updated on completion.
+
+ @param Blocks Pointer to the input blocks.
+
+ @param BlockCount The number of 64 byte blocks to process.
+ */
+VOID
+YoriLibSha256Compress(
+    __inout PDWORD State,
+    __in CONST UCHAR * Blocks,
+    __in DWORD BlockCount
+    )
+{
+#if YORI_LIB_DIGEST_SHA_NI
+    if (YoriLibSha256IsShaNiPresent()) {
+        YoriLibSha256CompressShaNi(State, Blocks, BlockCount);
+        return;
+    }
+#endif
+    YoriLibSha256CompressPortable(State, Blocks, BlockCount);
+}
+
+/**
+ Prepare a context to calculate a SHA-256 digest.
+
+ @param Context Pointer to the context to initialize.
+ */
+VOID
+YoriLibSha256Initialize(
+    __out PYORI_LIB_SHA256_CONTEXT Context
+    )
+{
+    memcpy(Context->State, YoriLibSha256Iv, sizeof(Context->State));
+    Context->BytesHashed = 0;
+    Context->BufferLength = 0;
+}
+
+/**
+ Add data to a SHA-256 digest.
+
+ @param Context Pointer to the context.
+
+ @param Buffer Pointer to the data to add.
+
+ @param Length The number of bytes in Buffer.
+ */
+VOID
+YoriLibSha256Update(
+    __inout PYORI_LIB_SHA256_CONTEXT Context,
+    __in_ecount(Length) CONST UCHAR * Buffer,
+    __in DWORD Length
+    )
+{
+    DWORD BytesToCopy;
+    DWORD BlockCount;
+
+    Context->BytesHashed = Context->BytesHashed + Length;
+
+    if (Context->BufferLength > 0) {
+        BytesToCopy = (DWORD)sizeof(Context->Buffer) - Context->BufferLength;
+        if (BytesToCopy > Length) {
+            BytesToCopy = Length;
+        }
+        memcpy(&Context->Buffer[Context->BufferLength], Buffer, BytesToCopy);
+        Context->BufferLength = Context->BufferLength + BytesToCopy;
+        Buffer = Buffer + BytesToCopy;
+        Length = Length - BytesToCopy;
+        if (Context->BufferLength < sizeof(Context->Buffer)) {
+            return;
+        }
+        YoriLibSha256Compress(Context->State, Context->Buffer, 1);
+        Context->BufferLength = 0;
+    }
+
+    BlockCount = Length / 64;
+    if (BlockCount > 0) {
+        YoriLibSha256Compress(Context->State, Buffer, BlockCount);
+        Buffer = Buffer + BlockCount * 64;
+        Length = Length - BlockCount * 64;
+    }
+
+    if (Length > 0) {
+        memcpy(Context->Buffer, Buffer, Length);
+        Context->BufferLength = Length;
+    }
+}
+
+/**
+ Complete a SHA-256 digest.
+
+ @param Context Pointer to the context.  This cannot be used for further
+        operations until it is reinitialized.
+
+ @param Digest On completion, populated with the 32 byte digest.
+ */
+VOID
+YoriLibSha256Finalize(
+    __inout PYORI_LIB_SHA256_CONTEXT Context,
+    __out_bcount(YORI_LIB_SHA256_DIGEST_SIZE) PUCHAR Digest
+    )
+{
+    DWORDLONG BitsHashed;
+    DWORD Index;
+
+    BitsHashed = Context->BytesHashed * 8;
+
+    Context->Buffer[Context->BufferLength] = 0x80;
+    Context->BufferLength++;
+    if (Context->BufferLength > sizeof(Context->Buffer) - 8) {
+        ZeroMemory(&Context->Buffer[Context->BufferLength], sizeof(Context->Buffer) - Context->BufferLength);
+        YoriLibSha256Compress(Context->State, Context->Buffer, 1);
+        Context->BufferLength = 0;
+    }
+
+    ZeroMemory(&Context->Buffer[Context->BufferLength], sizeof(Context->Buffer) - 8 - Context->BufferLength);
+    YoriLibDigestWrite32Be(&Context->Buffer[56], (DWORD)(BitsHashed >> 32));
+    YoriLibDigestWrite32Be(&Context->Buffer[60], (DWORD)BitsHashed);
+    YoriLibSha256Compress(Context->State, Context->Buffer, 1);
+
+    for (Index = 0; Index < 8; Index++) {
+        YoriLibDigestWrite32Be(&Digest[Index * 4], Context->State[Index]);
+    }
+}
+
+//
+//  XXH3, the 64 bit variant with a zero seed and the default secret.
+//
+
+/**
+ The 32 bit primes used by the xxHash family.
+ */
+#define YORI_LIB_XXH_PRIME32_1 0x9E3779B1
+#define YORI_LIB_XXH_PRIME32_2 0x85EBCA77
+#define YORI_LIB_XXH_PRIME32_3 0xC2B2AE3D
+
+/**
+ The 64 bit primes used by the xxHash family.
+ */
+#define YORI_LIB_XXH_PRIME64_1 YORI_LIB_DIGEST_CONST64(0x9E3779B1, 0x85EBCA87)
+#define YORI_LIB_XXH_PRIME64_2 YORI_LIB_DIGEST_CONST64(0xC2B2AE3D, 0x27D4EB4F)
+#define YORI_LIB_XXH_PRIME64_3 YORI_LIB_DIGEST_CONST64(0x165667B1, 0x9E3779F9)
+#define YORI_LIB_XXH_PRIME64_4 YORI_LIB_DIGEST_CONST64(0x85EBCA77, 0xC2B2AE63)
+#define YORI_LIB_XXH_PRIME64_5 YORI_LIB_DIGEST_CONST64(0x27D4EB2F, 0x165667C5)
+
+/**
+ The multipliers used by XXH3's final mixing steps.
+ */
+#define YORI_LIB_XXH_PRIME_MX1 YORI_LIB_DIGEST_CONST64(0x16566791, 0x9E3779F9)
+#define YORI_LIB_XXH_PRIME_MX2 YORI_LIB_DIGEST_CONST64(0x9FB21C65, 0x1E98DF25)
+
+/**
+ The number of bytes in each stripe of input consumed by the accumulators.
+ */
+#define YORI_LIB_XXH3_STRIPE_LENGTH 64
+
+/**
+ The number of stripes processed before the accumulators are scrambled.
+ This is the number of eight byte steps that fit within the secret, leaving
+ one stripe of secret for the final stripe.
+ */
+#define YORI_LIB_XXH3_STRIPES_PER_BLOCK 16
+
+/**
+ The largest input that is hashed without using the accumulators.
+ */
+#define YORI_LIB_XXH3_MIDSIZE_MAX 240
+
+/**
+ The default XXH3 secret.
+ */
+CONST UCHAR YoriLibXxh3Secret[192] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+/**
+ Multiply two 64 bit values to generate a 128 bit result, and return the
+ upper 64 bits combined with the lower 64 bits.
+
+ @param Left The first value to multiply.
+
+ @param Right The second value to multiply.
+
+ @return The upper half of the product exclusive ored with the lower half.
+ */
+DWORDLONG
+YoriLibXxh3MultiplyFold64(
+    __in DWORDLONG Left,
+    __in DWORDLONG Right
+    )
+{
+    DWORDLONG LoLo;
+    DWORDLONG HiLo;
+    DWORDLONG LoHi;
+    DWORDLONG HiHi;
+    DWORDLONG Cross;
+    DWORDLONG Upper;
+    DWORDLONG Lower;
+
+    LoLo = (DWORDLONG)(DWORD)Left * (DWORD)Right;
+    HiLo = (DWORDLONG)(DWORD)(Left >> 32) * (DWORD)Right;
+    LoHi = (DWORDLONG)(DWORD)Left * (DWORD)(Right >> 32);
+    HiHi = (DWORDLONG)(DWORD)(Left >> 32) * (DWORD)(Right >> 32);
+
+    Cross = (LoLo >> 32) + (DWORD)HiLo + LoHi;
+    Upper = (HiLo >> 32) + (Cross >> 32) + HiHi;
+    Lower = (Cross << 32) | (DWORD)LoLo;
+
+    return Lower ^ Upper;
+}
+
+/**
+ Reverse the order of bytes in a 64 bit value.
+
+ @param Value The value to reverse.
+
+ @return The value with its bytes reversed.
+ */
+DWORDLONG
+YoriLibXxh3ByteSwap64(
+    __in DWORDLONG Value
+    )
+{
+    DWORD Lo;
+    DWORD Hi;
+
+    Lo = (DWORD)Value;
+    Hi = (DWORD)(Value >> 32);
+    Lo = (Lo >> 24) | ((Lo >> 8) & 0xFF00) | ((Lo << 8) & 0xFF0000) | (Lo << 24);
+    Hi = (Hi >> 24) | ((Hi >> 8) & 0xFF00) | ((Hi << 8) & 0xFF0000) | (Hi << 24);
+    return ((DWORDLONG)Lo << 32) | Hi;
+}
+
+/**
+ The final mixing step of XXH64, which XXH3 uses for very short inputs.
+
+ @param Hash The value to mix.
+
+ @return The mixed value.
+ */
+DWORDLONG
+YoriLibXxh64Avalanche(
+    __in DWORDLONG Hash
+    )
+{
+    Hash = Hash ^ (Hash >> 33);
+    Hash = Hash * YORI_LIB_XXH_PRIME64_2;
+    Hash = Hash ^ (Hash >> 29);
+    Hash = Hash * YORI_LIB_XXH_PRIME64_3;
+    Hash = Hash ^ (Hash >> 32);
+    return Hash;
+}
+
+/**
+ The final mixing step of XXH3.
+
+ @param Hash The value to mix.
+
+ @return The mixed value.
+ */
+DWORDLONG
+YoriLibXxh3Avalanche(
+    __in DWORDLONG Hash
+    )
+{
+    Hash = Hash ^ (Hash >> 37);
+    Hash = Hash * YORI_LIB_XXH_PRIME_MX1;
+    Hash = Hash ^ (Hash >> 32);
+    return Hash;
+}
+
+/**
+ Mix sixteen bytes of input with sixteen bytes of secret.
+
+ @param Input Pointer to the input.
+
+ @param Secret Pointer to the secret.
+
+ @return The mixed value.
+ */
+DWORDLONG
+YoriLibXxh3Mix16(
+    __in CONST UCHAR * Input,
+    __in CONST UCHAR * Secret
+    )
+{
+    return YoriLibXxh3MultiplyFold64(YORI_LIB_DIGEST_READ64(Input) ^ YORI_LIB_DIGEST_READ64(Secret),
+                                     YORI_LIB_DIGEST_READ64(Input + 8) ^ YORI_LIB_DIGEST_READ64(Secret + 8));
+}
+
+/**
+ Calculate the XXH3 hash of an input of up to 240 bytes, which is hashed
+ without using the accumulators.
+
+ @param Input Pointer to the input.
+
+ @param Length The number of bytes of input, which must be 240 or less.
+
+ @return The hash value.
+ */
+DWORDLONG
+YoriLibXxh3HashShort(
+    __in_ecount(Length) CONST UCHAR * Input,
+    __in DWORD Length
+    )
+{
+    CONST UCHAR * Secret = YoriLibXxh3Secret;
+    DWORDLONG Acc;
+    DWORDLONG AccEnd;
+    DWORDLONG Lo;
+    DWORDLONG Hi;
+    DWORD Combined;
+    DWORD Index;
+
+    ASSERT(Length <= YORI_LIB_XXH3_MIDSIZE_MAX);
+
+    if (Length == 0) {
+        return YoriLibXxh64Avalanche(YORI_LIB_DIGEST_READ64(Secret + 56) ^ YORI_LIB_DIGEST_READ64(Secret + 64));
+    }
+
+    if (Length <= 3) {
+        Combined = ((DWORD)Input[0] << 16) |
+                   ((DWORD)Input[Length >> 1] << 24) |
+                   (DWORD)Input[Length - 1] |
+                   (Length << 8);
+        Acc = (DWORDLONG)Combined ^ (DWORDLONG)(YORI_LIB_DIGEST_READ32(Secret) ^ YORI_LIB_DIGEST_READ32(Secret + 4));
+        return YoriLibXxh64Avalanche(Acc);
+    }
+
+    if (Length <= 8) {
+        Acc = (DWORDLONG)YORI_LIB_DIGEST_READ32(Input + Length - 4) +
+              ((DWORDLONG)YORI_LIB_DIGEST_READ32(Input) << 32);
+        Acc = Acc ^ (YORI_LIB_DIGEST_READ64(Secret + 8) ^ YORI_LIB_DIGEST_READ64(Secret + 16));
+        Acc = Acc ^ (YORI_LIB_DIGEST_ROTL64(Acc, 49) ^ YORI_LIB_DIGEST_ROTL64(Acc, 24));
+        Acc = Acc * YORI_LIB_XXH_PRIME_MX2;
+        Acc = Acc ^ ((Acc >> 35) + Length);
+        Acc = Acc * YORI_LIB_XXH_PRIME_MX2;
+        Acc = Acc ^ (Acc >> 28);
+        return Acc;
+    }
+
+    if (Length <= 16) {
+        Lo = YORI_LIB_DIGEST_READ64(Input) ^ (YORI_LIB_DIGEST_READ64(Secret + 24) ^ YORI_LIB_DIGEST_READ64(Secret + 32));
+        Hi = YORI_LIB_DIGEST_READ64(Input + Length - 8) ^ (YORI_LIB_DIGEST_READ64(Secret + 40) ^ YORI_LIB_DIGEST_READ64(Secret + 48));
+
+        Acc = Length + YoriLibXxh3ByteSwap64(Lo) + Hi + YoriLibXxh3MultiplyFold64(Lo, Hi);
+        return YoriLibXxh3Avalanche(Acc);
+    }
+
+    Acc = Length * YORI_LIB_XXH_PRIME64_1;
+
+    if (Length <= 128) {
+        if (Length > 32) {
+            if (Length > 64) {
+                if (Length > 96) {
+                    Acc = Acc + YoriLibXxh3Mix16(Input + 48, Secret + 96);
+                    Acc = Acc + YoriLibXxh3Mix16(Input + Length - 64, Secret + 112);
+                }
+                Acc = Acc + YoriLibXxh3Mix16(Input + 32, Secret + 64);
+                Acc = Acc + YoriLibXxh3Mix16(Input + Length - 48, Secret + 80);
+            }
+            Acc = Acc + YoriLibXxh3Mix16(Input + 16, Secret + 32);
+            Acc = Acc + YoriLibXxh3Mix16(Input + Length - 32, Secret + 48);
+        }
+        Acc = Acc + YoriLibXxh3Mix16(Input, Secret);
+        Acc = Acc + YoriLibXxh3Mix16(Input + Length - 16, Secret + 16);
+        return YoriLibXxh3Avalanche(Acc);
+    }
+
+    for (Index = 0; Index < 8; Index++) {
+        Acc = Acc + YoriLibXxh3Mix16(Input + 16 * Index, Secret + 16 * Index);
+    }
+    Acc = YoriLibXxh3Avalanche(Acc);
+
+    AccEnd = YoriLibXxh3Mix16(Input + Length - 16, Secret + 136 - 17);
+    for (Index = 8; Index < Length / 16; Index++) {
+        AccEnd = AccEnd + YoriLibXxh3Mix16(Input + 16 * Index, Secret + 16 * (Index - 8) + 3);
+    }
+
+    return YoriLibXxh3Avalanche(Acc + AccEnd);
+}
+
+/**
+ Consume stripes of input into the accumulators.  Each stripe uses the
+ secret at an eight byte offset from the previous one.
+
+ @param Acc Pointer to the eight accumulators.
+
+ @param Input Pointer to the input, which contains StripeCount stripes.
+
+ @param Secret Pointer to the secret for the first stripe.
+
+ @param StripeCount The number of stripes to consume.
+ */
+VOID
+YoriLibXxh3Accumulate(
+    __inout DWORDLONG * Acc,
+    __in CONST UCHAR * Input,
+    __in CONST UCHAR * Secret,
+    __in DWORD StripeCount
+    )
+{
+#if YORI_LIB_DIGEST_SSE2
+    __m128i Acc0;
+    __m128i Acc1;
+    __m128i Acc2;
+    __m128i Acc3;
+    __m128i Data;
+    __m128i DataKey;
+
+    Acc0 = _mm_loadu_si128((const __m128i *)&Acc[0]);
+    Acc1 = _mm_loadu_si128((const __m128i *)&Acc[2]);
+    Acc2 = _mm_loadu_si128((const __m128i *)&Acc[4]);
+    Acc3 = _mm_loadu_si128((const __m128i *)&Acc[6]);
+
+//
+//  Add each 64 bit input to the adjacent accumulator, and the product of
+//  the 32 bit halves of input exclusive ored with secret to its own.
+//
+
+#define YORI_LIB_XXH3_ACCUMULATE_SSE2(AccVec, Offset)                                       \
+    Data = _mm_loadu_si128((const __m128i *)(Input + Offset));                              \
+    DataKey = _mm_xor_si128(Data, _mm_loadu_si128((const __m128i *)(Secret + Offset)));     \
+    AccVec = _mm_add_epi64(AccVec, _mm_shuffle_epi32(Data, _MM_SHUFFLE(1, 0, 3, 2)));       \
+    AccVec = _mm_add_epi64(AccVec, _mm_mul_epu32(DataKey, _mm_shuffle_epi32(DataKey, _MM_SHUFFLE(0, 3, 0, 1))));
+
+    for (; StripeCount > 0; StripeCount--) {
+        YORI_LIB_XXH3_ACCUMULATE_SSE2(Acc0, 0);
+        YORI_LIB_XXH3_ACCUMULATE_SSE2(Acc1, 16);
+        YORI_LIB_XXH3_ACCUMULATE_SSE2(Acc2, 32);
+        YORI_LIB_XXH3_ACCUMULATE_SSE2(Acc3, 48);
+        Input = Input + YORI_LIB_XXH3_STRIPE_LENGTH;
+        Secret = Secret + 8;
+    }
+
+    _mm_storeu_si128((__m128i *)&Acc[0], Acc0);
+    _mm_storeu_si128((__m128i *)&Acc[2], Acc1);
+    _mm_storeu_si128((__m128i *)&Acc[4], Acc2);
+    _mm_storeu_si128((__m128i *)&Acc[6], Acc3);
+#else
+    DWORDLONG Data;
+    DWORDLONG DataKey;
+    DWORD Index;
+
+    for (; StripeCount > 0; StripeCount--) {
+        for (Index = 0; Index < 8; Index++) {
+            Data = YORI_LIB_DIGEST_READ64(Input + Index * 8);
+            DataKey = Data ^ YORI_LIB_DIGEST_READ64(Secret + Index * 8);
+            Acc[Index ^ 1] = Acc[Index ^ 1] + Data;
+            Acc[Index] = Acc[Index] + (DWORDLONG)(DWORD)DataKey * (DWORD)(DataKey >> 32);
+        }
+        Input = Input + YORI_LIB_XXH3_STRIPE_LENGTH;
+        Secret = Secret + 8;
+    }
+#endif
+}
+
+/**
+ Scramble the accumulators at the end of each block of stripes.
+
+ @param Acc Pointer to the eight accumulators.
+ */
+VOID
+YoriLibXxh3Scramble(
+    __inout DWORDLONG * Acc
+    )
+{
+    CONST UCHAR * Secret;
+#if YORI_LIB_DIGEST_SSE2
+    __m128i AccVec;
+    __m128i DataKey;
+    __m128i Prime;
+    DWORD Index;
+
+    Secret = YoriLibXxh3Secret + sizeof(YoriLibXxh3Secret) - YORI_LIB_XXH3_STRIPE_LENGTH;
+    Prime = _mm_set1_epi32((int)YORI_LIB_XXH_PRIME32_1);
+    for (Index = 0; Index < 8; Index += 2) {
+        AccVec = _mm_loadu_si128((const __m128i *)&Acc[Index]);
+        AccVec = _mm_xor_si128(AccVec, _mm_srli_epi64(AccVec, 47));
+        DataKey = _mm_xor_si128(AccVec, _mm_loadu_si128((const __m128i *)(Secret + Index * 8)));
+        AccVec = _mm_add_epi64(_mm_mul_epu32(DataKey, Prime),
+                               _mm_slli_epi64(_mm_mul_epu32(_mm_shuffle_epi32(DataKey, _MM_SHUFFLE(0, 3, 0, 1)), Prime), 32));
+        _mm_storeu_si128((__m128i *)&Acc[Index], AccVec);
+    }
+#else
+    DWORDLONG Value;
+    DWORD Index;
+
+    Secret = YoriLibXxh3Secret + sizeof(YoriLibXxh3Secret) - YORI_LIB_XXH3_STRIPE_LENGTH;
+    for (Index = 0; Index < 8; Index++) {
+        Value = Acc[Index];
+        Value = Value ^ (Value >> 47);
+        Value = Value ^ YORI_LIB_DIGEST_READ64(Secret + Index * 8);
+        Value = Value * YORI_LIB_XXH_PRIME32_1;
+        Acc[Index] = Value;
+    }
+#endif
+}
+
+/**
+ Consume stripes of input into the accumulators, scrambling them at the end
+ of each block.
+
+ @param Acc Pointer to the eight accumulators.
+
+ @param StripesInBlock Pointer to the number of stripes consumed in the
+        current block, updated on completion.
+
+ @param Input Pointer to the input.
+
+ @param StripeCount The number of stripes to consume.
+ */
+VOID
+YoriLibXxh3ConsumeStripes(
+    __inout DWORDLONG * Acc,
+    __inout PDWORD StripesInBlock,
+    __in CONST UCHAR * Input,
+    __in DWORD StripeCount
+    )
+{
+    DWORD StripesThisBlock;
+
+    while (StripeCount > 0) {
+        StripesThisBlock = YORI_LIB_XXH3_STRIPES_PER_BLOCK - *StripesInBlock;
+        if (StripesThisBlock > StripeCount) {
+            StripesThisBlock = StripeCount;
+        }
+        YoriLibXxh3Accumulate(Acc, Input, YoriLibXxh3Secret + *StripesInBlock * 8, StripesThisBlock);
+        Input = Input + StripesThisBlock * YORI_LIB_XXH3_STRIPE_LENGTH;
+        StripeCount = StripeCount - StripesThisBlock;
+        *StripesInBlock = *StripesInBlock + StripesThisBlock;
+        if (*StripesInBlock == YORI_LIB_XXH3_STRIPES_PER_BLOCK) {
+            YoriLibXxh3Scramble(Acc);
+            *StripesInBlock = 0;
+        }
+    }
+}
+
+/**
+ Prepare a context to calculate an XXH3 hash.
+
+ @param Context Pointer to the context to initialize.
+ */
+VOID
+YoriLibXxh3Initialize(
+    __out PYORI_LIB_XXH3_CONTEXT Context
+    )
+{
+    Context->Acc[0] = YORI_LIB_XXH_PRIME32_3;
+    Context->Acc[1] = YORI_LIB_XXH_PRIME64_1;
+    Context->Acc[2] = YORI_LIB_XXH_PRIME64_2;
+    Context->Acc[3] = YORI_LIB_XXH_PRIME64_3;
+    Context->Acc[4] = YORI_LIB_XXH_PRIME64_4;
+    Context->Acc[5] = YORI_LIB_XXH_PRIME32_2;
+    Context->Acc[6] = YORI_LIB_XXH_PRIME64_5;
+    Context->Acc[7] = YORI_LIB_XXH_PRIME32_1;
+    Context->BytesHashed = 0;
+    Context->BufferLength = 0;
+    Context->StripesInBlock = 0;
+}
+
+/**
+ Add data to an XXH3 hash.
+
+ Stripes are only consumed once it is known that more data follows them,
+ because the final stripe is processed differently.  Consumed data remains
+ in the buffer so the final stripe can be reconstructed when it spans
+ data already consumed.
+
+ @param Context Pointer to the context.
+
+ @param Buffer Pointer to the data to add.
+
+ @param Length The number of bytes in Buffer.
+ */
+VOID
+YoriLibXxh3Update(
+    __inout PYORI_LIB_XXH3_CONTEXT Context,
+    __in_ecount(Length) CONST UCHAR * Buffer,
+    __in DWORD Length
+    )
+{
+    DWORD BytesToCopy;
+    DWORD StripeCount;
+
+    Context->BytesHashed = Context->BytesHashed + Length;
+
+    if (Length <= (DWORD)sizeof(Context->Buffer) - Context->BufferLength) {
+        memcpy(&Context->Buffer[Context->BufferLength], Buffer, Length);
+        Context->BufferLength = Context->BufferLength + Length;
+        return;
+    }
+
+    //
+    //  Fill and consume the buffer, since more data follows it.
+    //
+
+    if (Context->BufferLength > 0) {
+        BytesToCopy = (DWORD)sizeof(Context->Buffer) - Context->BufferLength;
+        memcpy(&Context->Buffer[Context->BufferLength], Buffer, BytesToCopy);
+        Buffer = Buffer + BytesToCopy;
+        Length = Length - BytesToCopy;
+        YoriLibXxh3ConsumeStripes(Context->Acc, &Context->StripesInBlock, Context->Buffer, (DWORD)sizeof(Context->Buffer) / YORI_LIB_XXH3_STRIPE_LENGTH);
+        Context->BufferLength = 0;
+    }
+
+    //
+    //  Consume stripes directly from the caller's buffer, leaving at least
+    //  one byte, then preserve the final stripe consumed at the end of the
+    //  buffer in case it is needed to reconstruct the final stripe.
+    //
+
+    if (Length > (DWORD)sizeof(Context->Buffer)) {
+        StripeCount = (Length - 1) / YORI_LIB_XXH3_STRIPE_LENGTH;
+        YoriLibXxh3ConsumeStripes(Context->Acc, &Context->StripesInBlock, Buffer, StripeCount);
+        Buffer = Buffer + StripeCount * YORI_LIB_XXH3_STRIPE_LENGTH;
+        Length = Length - StripeCount * YORI_LIB_XXH3_STRIPE_LENGTH;
+        memcpy(&Context->Buffer[sizeof(Context->Buffer) - YORI_LIB_XXH3_STRIPE_LENGTH],
+               Buffer - YORI_LIB_XXH3_STRIPE_LENGTH,
+               YORI_LIB_XXH3_STRIPE_LENGTH);
+    }
+
+    memcpy(Context->Buffer, Buffer, Length);
+    Context->BufferLength = Length;
+}
+
+/**
+ Complete an XXH3 hash.
+
+ @param Context Pointer to the context.  This cannot be used for further
+        operations until it is reinitialized.
+
+ @param Digest On completion, populated with the 8 byte hash in big endian
+        form, which is its conventional representation.
+ */
+VOID
+YoriLibXxh3Finalize(
+    __inout PYORI_LIB_XXH3_CONTEXT Context,
+    __out_bcount(YORI_LIB_XXH3_DIGEST_SIZE) PUCHAR Digest
+    )
+{
+    UCHAR LastStripe[YORI_LIB_XXH3_STRIPE_LENGTH];
+    CONST UCHAR * LastStripePtr;
+    CONST UCHAR * Secret;
+    DWORDLONG Hash;
+    DWORD StripeCount;
+    DWORD CatchupLength;
+    DWORD Index;
+
+    if (Context->BytesHashed <= YORI_LIB_XXH3_MIDSIZE_MAX) {
+        Hash = YoriLibXxh3HashShort(Context->Buffer, (DWORD)Context->BytesHashed);
+    } else {
+
+        //
+        //  Consume all stripes which are followed by data, then process the
+        //  final 64 bytes of input as the last stripe.
+        //
+
+        if (Context->BufferLength >= YORI_LIB_XXH3_STRIPE_LENGTH) {
+            StripeCount = (Context->BufferLength - 1) / YORI_LIB_XXH3_STRIPE_LENGTH;
+            YoriLibXxh3ConsumeStripes(Context->Acc, &Context->StripesInBlock, Context->Buffer, StripeCount);
+            LastStripePtr = &Context->Buffer[Context->BufferLength - YORI_LIB_XXH3_STRIPE_LENGTH];
+        } else {
+            CatchupLength = YORI_LIB_XXH3_STRIPE_LENGTH - Context->BufferLength;
+            memcpy(LastStripe, &Context->Buffer[sizeof(Context->Buffer) - CatchupLength], CatchupLength);
+            memcpy(&LastStripe[CatchupLength], Context->Buffer, Context->BufferLength);
+            LastStripePtr = LastStripe;
+        }
+
+        YoriLibXxh3Accumulate(Context->Acc,
+                              LastStripePtr,
+                              YoriLibXxh3Secret + sizeof(YoriLibXxh3Secret) - YORI_LIB_XXH3_STRIPE_LENGTH - 7,
+                              1);
+
+        //
+        //  Merge the accumulators.
+        //
+
+        Secret = YoriLibXxh3Secret + 11;
+        Hash = Context->BytesHashed * YORI_LIB_XXH_PRIME64_1;
+        for (Index = 0; Index < 8; Index += 2) {
+            Hash = Hash + YoriLibXxh3MultiplyFold64(Context->Acc[Index] ^ YORI_LIB_DIGEST_READ64(Secret + Index * 8),
+                                                    Context->Acc[Index + 1] ^ YORI_LIB_DIGEST_READ64(Secret + Index * 8 + 8));
+        }
+        Hash = YoriLibXxh3Avalanche(Hash);
+    }
+
+    YoriLibDigestWrite32Be(Digest, (DWORD)(Hash >> 32));
+    YoriLibDigestWrite32Be(Digest + 4, (DWORD)Hash);
+}
+
+//
+//  BLAKE3, with a 32 byte output and no key.
+//
+
+/**
+ Flags describing the position of a block within the BLAKE3 tree.
+ */
+#define YORI_LIB_BLAKE3_CHUNK_START 0x01
+#define YORI_LIB_BLAKE3_CHUNK_END   0x02
+#define YORI_LIB_BLAKE3_PARENT      0x04
+#define YORI_LIB_BLAKE3_ROOT        0x08
+
+/**
+ The number of bytes in each BLAKE3 chunk.
+ */
+#define YORI_LIB_BLAKE3_CHUNK_LENGTH 1024
+
+/**
+ The order in which message words are used in each of the seven rounds.
+ */
+CONST UCHAR YoriLibBlake3Schedule[7][16] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8},
+    {3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1},
+    {10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6},
+    {12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4},
+    {9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7},
+    {11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13},
+};
+
+/**
+ The BLAKE3 mixing function, applied to four words of state and two words
+ of message.
+ */
+#define YORI_LIB_BLAKE3_G(a, b, c, d, x, y)                           \
+    V[a] = V[a] + V[b] + (x); V[d] = YORI_LIB_DIGEST_ROTR32(V[d] ^ V[a], 16); \
+    V[c] = V[c] + V[d];       V[b] = YORI_LIB_DIGEST_ROTR32(V[b] ^ V[c], 12); \
+    V[a] = V[a] + V[b] + (y); V[d] = YORI_LIB_DIGEST_ROTR32(V[d] ^ V[a], 8);  \
+    V[c] = V[c] + V[d];       V[b] = YORI_LIB_DIGEST_ROTR32(V[b] ^ V[c], 7);
+
+/**
+ Compress a single BLAKE3 block.
+
+ @param Cv The input chaining value.
+
+ @param Block Pointer to the 64 byte block.
+
+ @param Counter The chunk counter.
+
+ @param BlockLength The number of bytes of input in the block.
+
+ @param Flags The flags describing the position of the block.
+
+ @param Output On completion, populated with the output chaining value.
+ */
+VOID
+YoriLibBlake3Compress(
+    __in_ecount(8) CONST DWORD * Cv,
+    __in_ecount(64) CONST UCHAR * Block,
+    __in DWORDLONG Counter,
+    __in DWORD BlockLength,
+    __in DWORD Flags,
+    __out_ecount(8) PDWORD Output
+    )
+{
+    DWORD M[16];
+    DWORD V[16];
+    CONST UCHAR * S;
+    DWORD Round;
+    DWORD Index;
+
+    for (Index = 0; Index < 16; Index++) {
+        M[Index] = YORI_LIB_DIGEST_READ32(Block + Index * 4);
+    }
+
+    for (Index = 0; Index < 8; Index++) {
+        V[Index] = Cv[Index];
+    }
+    V[8] = YoriLibSha256Iv[0];
+    V[9] = YoriLibSha256Iv[1];
+    V[10] = YoriLibSha256Iv[2];
+    V[11] = YoriLibSha256Iv[3];
+    V[12] = (DWORD)Counter;
+    V[13] = (DWORD)(Counter >> 32);
+    V[14] = BlockLength;
+    V[15] = Flags;
+
+    for (Round = 0; Round < 7; Round++) {
+        S = YoriLibBlake3Schedule[Round];
+        YORI_LIB_BLAKE3_G(0, 4, 8, 12, M[S[0]], M[S[1]]);
+        YORI_LIB_BLAKE3_G(1, 5, 9, 13, M[S[2]], M[S[3]]);
+        YORI_LIB_BLAKE3_G(2, 6, 10, 14, M[S[4]], M[S[5]]);
+        YORI_LIB_BLAKE3_G(3, 7, 11, 15, M[S[6]], M[S[7]]);
+        YORI_LIB_BLAKE3_G(0, 5, 10, 15, M[S[8]], M[S[9]]);
+        YORI_LIB_BLAKE3_G(1, 6, 11, 12, M[S[10]], M[S[11]]);
+        YORI_LIB_BLAKE3_G(2, 7, 8, 13, M[S[12]], M[S[13]]);
+        YORI_LIB_BLAKE3_G(3, 4, 9, 14, M[S[14]], M[S[15]]);
+    }
+
+    for (Index = 0; Index < 8; Index++) {
+        Output[Index] = V[Index] ^ V[Index + 8];
+    }
+}
+
+#if YORI_LIB_DIGEST_SSE2
+
+/**
+ Rotate each 32 bit element of a vector right by the specified number of
+ bits.
+ */
+#define YORI_LIB_BLAKE3_ROTR_SSE2(x, n) _mm_or_si128(_mm_srli_epi32(x, n), _mm_slli_epi32(x, 32 - (n)))
+
+/**
+ The BLAKE3 mixing function, applied to four independent chunks at once.
+ */
+#define YORI_LIB_BLAKE3_G_SSE2(a, b, c, d, x, y)                                                   \
+    V[a] = _mm_add_epi32(_mm_add_epi32(V[a], V[b]), x); V[d] = YORI_LIB_BLAKE3_ROTR_SSE2(_mm_xor_si128(V[d], V[a]), 16); \
+    V[c] = _mm_add_epi32(V[c], V[d]);                   V[b] = YORI_LIB_BLAKE3_ROTR_SSE2(_mm_xor_si128(V[b], V[c]), 12); \
+    V[a] = _mm_add_epi32(_mm_add_epi32(V[a], V[b]), y); V[d] = YORI_LIB_BLAKE3_ROTR_SSE2(_mm_xor_si128(V[d], V[a]), 8);  \
+    V[c] = _mm_add_epi32(V[c], V[d]);                   V[b] = YORI_LIB_BLAKE3_ROTR_SSE2(_mm_xor_si128(V[b], V[c]), 7);
+
+/**
+ Transpose four vectors of four 32 bit elements.
+ */
+#define YORI_LIB_BLAKE3_TRANSPOSE_SSE2(r0, r1, r2, r3)       \
+    {                                                         \
+        __m128i t0 = _mm_unpacklo_epi32(r0, r1);              \
+        __m128i t1 = _mm_unpackhi_epi32(r0, r1);              \
+        __m128i t2 = _mm_unpacklo_epi32(r2, r3);              \
+        __m128i t3 = _mm_unpackhi_epi32(r2, r3);              \
+        r0 = _mm_unpacklo_epi64(t0, t2);                      \
+        r1 = _mm_unpackhi_epi64(t0, t2);                      \
+        r2 = _mm_unpacklo_epi64(t1, t3);                      \
+        r3 = _mm_unpackhi_epi64(t1, t3);                      \
+    }
+
+/**
+ Hash four complete chunks at once, with each chunk occupying one element of
+ each vector.  None of these chunks can be the root of the tree.
+
+ @param Input Pointer to four consecutive chunks.
+
+ @param Counter The chunk counter of the first chunk.
+
+ @param Output On completion, populated with the chaining value of each of
+        the four chunks.
+ */
+VOID
+YoriLibBlake3HashFourChunks(
+    __in_ecount(4 * YORI_LIB_BLAKE3_CHUNK_LENGTH) CONST UCHAR * Input,
+    __in DWORDLONG Counter,
+    __out_ecount(32) PDWORD Output
+    )
+{
+    __m128i H[8];
+    __m128i M[16];
+    __m128i V[16];
+    __m128i CounterLo;
+    __m128i CounterHi;
+    CONST UCHAR * S;
+    CONST UCHAR * BlockInput;
+    DWORD Block;
+    DWORD Round;
+    DWORD Index;
+    DWORD Flags;
+
+    for (Index = 0; Index < 8; Index++) {
+        H[Index] = _mm_set1_epi32((int)YoriLibSha256Iv[Index]);
+    }
+
+    CounterLo = _mm_set_epi32((int)(DWORD)(Counter + 3), (int)(DWORD)(Counter + 2), (int)(DWORD)(Counter + 1), (int)(DWORD)Counter);
+    CounterHi = _mm_set_epi32((int)(DWORD)((Counter + 3) >> 32), (int)(DWORD)((Counter + 2) >> 32), (int)(DWORD)((Counter + 1) >> 32), (int)(DWORD)(Counter >> 32));
+
+    for (Block = 0; Block < YORI_LIB_BLAKE3_CHUNK_LENGTH / 64; Block++) {
+
+        //
+        //  Load the message so each vector contains the same word from
+        //  each chunk.
+        //
+
+        BlockInput = Input + Block * 64;
+        for (Index = 0; Index < 16; Index += 4) {
+            M[Index] = _mm_loadu_si128((const __m128i *)(BlockInput + Index * 4));
+            M[Index + 1] = _mm_loadu_si128((const __m128i *)(BlockInput + YORI_LIB_BLAKE3_CHUNK_LENGTH + Index * 4));
+            M[Index + 2] = _mm_loadu_si128((const __m128i *)(BlockInput + 2 * YORI_LIB_BLAKE3_CHUNK_LENGTH + Index * 4));
+            M[Index + 3] = _mm_loadu_si128((const __m128i *)(BlockInput + 3 * YORI_LIB_BLAKE3_CHUNK_LENGTH + Index * 4));
+            YORI_LIB_BLAKE3_TRANSPOSE_SSE2(M[Index], M[Index + 1], M[Index + 2], M[Index + 3]);
+        }
+
+        Flags = 0;
+        if (Block == 0) {
+            Flags = YORI_LIB_BLAKE3_CHUNK_START;
+        } else if (Block == YORI_LIB_BLAKE3_CHUNK_LENGTH / 64 - 1) {
+            Flags = YORI_LIB_BLAKE3_CHUNK_END;
+        }
+
+        for (Index = 0; Index < 8; Index++) {
+            V[Index] = H[Index];
+        }
+        V[8] = _mm_set1_epi32((int)YoriLibSha256Iv[0]);
+        V[9] = _mm_set1_epi32((int)YoriLibSha256Iv[1]);
+        V[10] = _mm_set1_epi32((int)YoriLibSha256Iv[2]);
+        V[11] = _mm_set1_epi32((int)YoriLibSha256Iv[3]);
+        V[12] = CounterLo;
+        V[13] = CounterHi;
+        V[14] = _mm_set1_epi32(64);
+        V[15] = _mm_set1_epi32((int)Flags);
+
+        for (Round = 0; Round < 7; Round++) {
+            S = YoriLibBlake3Schedule[Round];
+            YORI_LIB_BLAKE3_G_SSE2(0, 4, 8, 12, M[S[0]], M[S[1]]);
+            YORI_LIB_BLAKE3_G_SSE2(1, 5, 9, 13, M[S[2]], M[S[3]]);
+            YORI_LIB_BLAKE3_G_SSE2(2, 6, 10, 14, M[S[4]], M[S[5]]);
+            YORI_LIB_BLAKE3_G_SSE2(3, 7, 11, 15, M[S[6]], M[S[7]]);
+            YORI_LIB_BLAKE3_G_SSE2(0, 5, 10, 15, M[S[8]], M[S[9]]);
+            YORI_LIB_BLAKE3_G_SSE2(1, 6, 11, 12, M[S[10]], M[S[11]]);
+            YORI_LIB_BLAKE3_G_SSE2(2, 7, 8, 13, M[S[12]], M[S[13]]);
+            YORI_LIB_BLAKE3_G_SSE2(3, 4, 9, 14, M[S[14]], M[S[15]]);
+        }
+
+        for (Index = 0; Index < 8; Index++) {
+            H[Index] = _mm_xor_si128(V[Index], V[Index + 8]);
+        }
+    }
+
+    //
+    //  Transpose the result so each chunk's chaining value is contiguous.
+    //
+
+    YORI_LIB_BLAKE3_TRANSPOSE_SSE2(H[0], H[1], H[2], H[3]);
+    YORI_LIB_BLAKE3_TRANSPOSE_SSE2(H[4], H[5], H[6], H[7]);
+    for (Index = 0; Index < 4; Index++) {
+        _mm_storeu_si128((__m128i *)&Output[Index * 8], H[Index]);
+        _mm_storeu_si128((__m128i *)&Output[Index * 8 + 4], H[Index + 4]);
+    }
+}
+
+#endif
+
+/**
+ Add the chaining value of a completed chunk to the tree, merging it with
+ any completed subtrees of the same size.
+
+ @param Context Pointer to the context.
+
+ @param Cv The chaining value of the completed chunk.
+ */
+VOID
+YoriLibBlake3PushChunk(
+    __inout PYORI_LIB_BLAKE3_CONTEXT Context,
+    __in_ecount(8) CONST DWORD * Cv
+    )
+{
+    DWORD Block[16];
+    DWORDLONG TotalChunks;
+
+    memcpy(&Block[8], Cv, 8 * sizeof(DWORD));
+    TotalChunks = Context->ChunkCounter + 1;
+    while ((TotalChunks & 1) == 0) {
+        ASSERT(Context->CvStackDepth > 0);
+        Context->CvStackDepth--;
+        memcpy(&Block[0], &Context->CvStack[Context->CvStackDepth * 8], 8 * sizeof(DWORD));
+        YoriLibBlake3Compress(YoriLibSha256Iv, (CONST UCHAR *)Block, 0, 64, YORI_LIB_BLAKE3_PARENT, &Block[8]);
+        TotalChunks = TotalChunks >> 1;
+    }
+
+    memcpy(&Context->CvStack[Context->CvStackDepth * 8], &Block[8], 8 * sizeof(DWORD));
+    Context->CvStackDepth++;
+    Context->ChunkCounter++;
+}
+
+/**
+ Prepare a context to calculate a BLAKE3 hash.
+
+ @param Context Pointer to the context to initialize.
+ */
+VOID
+YoriLibBlake3Initialize(
+    __out PYORI_LIB_BLAKE3_CONTEXT Context
+    )
+{
+    memcpy(Context->ChunkCv, YoriLibSha256Iv, sizeof(Context->ChunkCv));
+    Context->ChunkCounter = 0;
+    Context->BlockLength = 0;
+    Context->BlocksCompressed = 0;
+    Context->CvStackDepth = 0;
+}
+
+/**
+ Add data to a BLAKE3 hash.
+
+ Blocks and chunks are only completed once it is known that more data
+ follows them, because the final block is processed differently.
+
+ @param Context Pointer to the context.
+
+ @param Buffer Pointer to the data to add.
+
+ @param Length The number of bytes in Buffer.
+ */
+VOID
+YoriLibBlake3Update(
+    __inout PYORI_LIB_BLAKE3_CONTEXT Context,
+    __in_ecount(Length) CONST UCHAR * Buffer,
+    __in DWORD Length
+    )
+{
+    DWORD BytesToCopy;
+    DWORD Flags;
+#if YORI_LIB_DIGEST_SSE2
+    DWORD Cvs[32];
+    DWORD Index;
+#endif
+
+    while (Length > 0) {
+
+        //
+        //  If the current chunk is full, complete it.
+        //
+
+        if (Context->BlocksCompressed == YORI_LIB_BLAKE3_CHUNK_LENGTH / 64 - 1 &&
+            Context->BlockLength == 64) {
+
+            YoriLibBlake3Compress(Context->ChunkCv, Context->Block, Context->ChunkCounter, 64, YORI_LIB_BLAKE3_CHUNK_END, Context->ChunkCv);
+            YoriLibBlake3PushChunk(Context, Context->ChunkCv);
+            memcpy(Context->ChunkCv, YoriLibSha256Iv, sizeof(Context->ChunkCv));
+            Context->BlocksCompressed = 0;
+            Context->BlockLength = 0;
+        }
+
+#if YORI_LIB_DIGEST_SSE2
+        //
+        //  If whole chunks are available and more data follows them, hash
+        //  four of them at once.
+        //
+
+        if (Context->BlocksCompressed == 0 &&
+            Context->BlockLength == 0) {
+
+            while (Length > 4 * YORI_LIB_BLAKE3_CHUNK_LENGTH) {
+                YoriLibBlake3HashFourChunks(Buffer, Context->ChunkCounter, Cvs);
+                for (Index = 0; Index < 4; Index++) {
+                    YoriLibBlake3PushChunk(Context, &Cvs[Index * 8]);
+                }
+                Buffer = Buffer + 4 * YORI_LIB_BLAKE3_CHUNK_LENGTH;
+                Length = Length - 4 * YORI_LIB_BLAKE3_CHUNK_LENGTH;
+            }
+        }
+#endif
+
+        //
+        //  If the current block is full, compress it.
+        //
+
+        if (Context->BlockLength == 64) {
+            Flags = 0;
+            if (Context->BlocksCompressed == 0) {
+                Flags = YORI_LIB_BLAKE3_CHUNK_START;
+            }
+            YoriLibBlake3Compress(Context->ChunkCv, Context->Block, Context->ChunkCounter, 64, Flags, Context->ChunkCv);
+            Context->BlocksCompressed++;
+            Context->BlockLength = 0;
+        }
+
+        //
+        //  If the block is empty and isn't the last in the chunk, and more
+        //  data follows it, compress directly from the caller's buffer.
+        //
+
+        while (Context->BlockLength == 0 &&
+               Context->BlocksCompressed < YORI_LIB_BLAKE3_CHUNK_LENGTH / 64 - 1 &&
+               Length > 64) {
+
+            Flags = 0;
+            if (Context->BlocksCompressed == 0) {
+                Flags = YORI_LIB_BLAKE3_CHUNK_START;
+            }
+            YoriLibBlake3Compress(Context->ChunkCv, Buffer, Context->ChunkCounter, 64, Flags, Context->ChunkCv);
+            Context->BlocksCompressed++;
+            Buffer = Buffer + 64;
+            Length = Length - 64;
+        }
+
+        BytesToCopy = 64 - Context->BlockLength;
+        if (BytesToCopy > Length) {
+            BytesToCopy = Length;
+        }
+        memcpy(&Context->Block[Context->BlockLength], Buffer, BytesToCopy);
+        Context->BlockLength = Context->BlockLength + BytesToCopy;
+        Buffer = Buffer + BytesToCopy;
+        Length = Length - BytesToCopy;
+    }
+}
+
+/**
+ Complete a BLAKE3 hash.
+
+ @param Context Pointer to the context.  This cannot be used for further
+        operations until it is reinitialized.
+
+ @param Digest On completion, populated with the 32 byte hash.
+ */
+VOID
+YoriLibBlake3Finalize(
+    __inout PYORI_LIB_BLAKE3_CONTEXT Context,
+    __out_bcount(YORI_LIB_BLAKE3_DIGEST_SIZE) PUCHAR Digest
+    )
+{
+    DWORD Cv[8];
+    DWORD Block[16];
+    DWORD Output[8];
+    DWORD Flags;
+    DWORD Depth;
+    DWORD Index;
+
+    //
+    //  The last chunk is the root if it is the only chunk.  Otherwise,
+    //  merge it with every subtree on the stack, and the final parent is
+    //  the root.
+    //
+
+    ZeroMemory(&Context->Block[Context->BlockLength], sizeof(Context->Block) - Context->BlockLength);
+    Flags = YORI_LIB_BLAKE3_CHUNK_END;
+    if (Context->BlocksCompressed == 0) {
+        Flags = Flags | YORI_LIB_BLAKE3_CHUNK_START;
+    }
+
+    Depth = Context->CvStackDepth;
+    if (Depth == 0) {
+        YoriLibBlake3Compress(Context->ChunkCv, Context->Block, Context->ChunkCounter, Context->BlockLength, Flags | YORI_LIB_BLAKE3_ROOT, Output);
+    } else {
+        YoriLibBlake3Compress(Context->ChunkCv, Context->Block, Context->ChunkCounter, Context->BlockLength, Flags, Cv);
+        while (Depth > 0) {
+            Depth--;
+            memcpy(&Block[0], &Context->CvStack[Depth * 8], 8 * sizeof(DWORD));
+            memcpy(&Block[8], Cv, 8 * sizeof(DWORD));
+            Flags = YORI_LIB_BLAKE3_PARENT;
+            if (Depth == 0) {
+                Flags = Flags | YORI_LIB_BLAKE3_ROOT;
+            }
+            YoriLibBlake3Compress(YoriLibSha256Iv, (CONST UCHAR *)Block, 0, 64, Flags, Cv);
+        }
+        memcpy(Output, Cv, sizeof(Output));
+    }
+
+    for (Index = 0; Index < 8; Index++) {
+        Digest[Index * 4] = (UCHAR)Output[Index];
+        Digest[Index * 4 + 1] = (UCHAR)(Output[Index] >> 8);
+        Digest[Index * 4 + 2] = (UCHAR)(Output[Index] >> 16);
+        Digest[Index * 4 + 3] = (UCHAR)(Output[Index] >> 24);
+    }
+}
+
+// vim:sw=4:ts=4:et:
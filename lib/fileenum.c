@@ -3,7 +3,7 @@
  *
  * Yori file enumeration routines
  *
- * Copyright (c) 2017-2018 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -91,6 +91,169 @@ typedef struct _YORILIB_FOREACHFILE_CONTEXT {
 
 } YORILIB_FOREACHFILE_CONTEXT, *PYORILIB_FOREACHFILE_CONTEXT;
 
+/**
+ The maximum number of worker threads used for a parallel enumerate.
+ */
+#define YORILIB_FOREACHFILE_MAX_WORKERS 32
+
+/**
+ Indicates that a directory enumerate should report matching objects.
+ */
+#define YORILIB_FOREACHFILE_PHASE_REPORT  0x0001
+
+/**
+ Indicates that a directory enumerate should recurse into subdirectories.
+ */
+#define YORILIB_FOREACHFILE_PHASE_RECURSE 0x0002
+
+/**
+ A subdirectory which has been found during a parallel enumerate and is
+ waiting to be, or is being, enumerated.
+ */
+typedef struct _YORILIB_FOREACHFILE_ITEM {
+
+    /**
+     The entry for this item on a worker's queue.  Paired with
+     YORILIB_FOREACHFILE_WORKER::Queue .
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     Pointer to the item describing the directory containing this one.  This
+     is NULL if this directory was found by the calling thread.
+     */
+    struct _YORILIB_FOREACHFILE_ITEM *Parent;
+
+    /**
+     The number of things which must complete before this item is complete.
+     This is one for the enumerate of this directory, plus one for each
+     subdirectory item that has not completed.  When recursing before
+     returning, objects in this directory are reported once this reaches
+     zero.
+     */
+    LONG Pending;
+
+    /**
+     The recursion depth of this directory.
+     */
+    DWORD Depth;
+
+    /**
+     The enumeration criteria for this directory.  The string is stored in
+     the same allocation as this structure.
+     */
+    YORI_STRING Criteria;
+
+} YORILIB_FOREACHFILE_ITEM, *PYORILIB_FOREACHFILE_ITEM;
+
+/**
+ State for a single worker thread in a parallel enumerate.
+ */
+typedef struct _YORILIB_FOREACHFILE_WORKER {
+
+    /**
+     Items to enumerate.  Subdirectories found by this worker are inserted at
+     the head and removed from the head by this worker, so that it proceeds
+     depth first.  Other workers with nothing to do remove items from the
+     tail, which are the largest remaining pieces of work.
+     */
+    YORI_LIST_ENTRY Queue;
+
+    /**
+     A mutex protecting Queue.
+     */
+    HANDLE Mutex;
+
+    /**
+     A handle to the worker thread.
+     */
+    HANDLE Thread;
+
+    /**
+     A buffer used to construct the criteria for subdirectories.  This is
+     retained across directories so it is only reallocated when a longer
+     path is found.
+     */
+    YORI_STRING RecurseCriteria;
+
+    /**
+     Pointer to the parallel enumerate state.
+     */
+    struct _YORILIB_FOREACHFILE_PARALLEL *Parallel;
+
+} YORILIB_FOREACHFILE_WORKER, *PYORILIB_FOREACHFILE_WORKER;
+
+/**
+ State for a parallel enumerate.  This is created by the top level enumerate
+ and shared by all worker threads.
+ */
+typedef struct _YORILIB_FOREACHFILE_PARALLEL {
+
+    /**
+     The flags describing the enumerate.
+     */
+    WORD MatchFlags;
+
+    /**
+     Set to TRUE if an enumerate has failed or been cancelled, indicating
+     that remaining items should be discarded.
+     */
+    BOOLEAN Abort;
+
+    /**
+     Set to TRUE when worker threads should terminate.
+     */
+    BOOLEAN Shutdown;
+
+    /**
+     The number of worker threads.
+     */
+    DWORD WorkerCount;
+
+    /**
+     The worker to queue the next item found by the calling thread to.
+     */
+    DWORD NextWorker;
+
+    /**
+     The number of items that have been queued and have not completed.
+     */
+    LONG Outstanding;
+
+    /**
+     A semaphore whose count is the number of items on all worker queues.
+     Each worker waits on this before removing an item from any queue.
+     */
+    HANDLE WorkSemaphore;
+
+    /**
+     A manual reset event which is signalled when Outstanding reaches zero.
+     */
+    HANDLE IdleEvent;
+
+    /**
+     The callback to invoke on each match.
+     */
+    PYORILIB_FILE_ENUM_FN Callback;
+
+    /**
+     Optionally points to a function to invoke if a directory cannot be
+     enumerated.
+     */
+    PYORILIB_FILE_ENUM_ERROR_FN ErrorCallback;
+
+    /**
+     Caller provided context to pass to the callbacks.
+     */
+    PVOID Context;
+
+    /**
+     An array of WorkerCount workers.
+     */
+    PYORILIB_FOREACHFILE_WORKER Workers;
+
+} YORILIB_FOREACHFILE_PARALLEL, *PYORILIB_FOREACHFILE_PARALLEL;
+
 /**
  If a string contains a directory that ends with a seperator, and it's not
  referring to a drive root, remove the seperator.
@@ -135,7 +298,93 @@ YoriLibTruncateTrailingSeperatorIfBenign(
 }
 
 /**
- Call a callback for every file matching a specified file pattern.
+ Queue a subdirectory to be enumerated by a worker thread in a parallel
+ enumerate.
+
+ @param Parallel Pointer to the parallel enumerate state.
+
+ @param Worker Optionally points to the worker which found the directory.
+        If NULL, the directory was found by the calling thread.
+
+ @param Parent Optionally points to the item describing the directory that
+        contains this one.  This item cannot complete until the newly
+        queued item completes.
+
+ @param Criteria The enumeration criteria for the subdirectory.
+
+ @param Depth The recursion depth of the subdirectory.
+
+ @return TRUE to indicate the item was queued, FALSE on allocation failure.
+ */
+__success(return)
+BOOL
+YoriLibForEachFileQueueItem(
+    __in PYORILIB_FOREACHFILE_PARALLEL Parallel,
+    __in_opt PYORILIB_FOREACHFILE_WORKER Worker,
+    __in_opt PYORILIB_FOREACHFILE_ITEM Parent,
+    __in PYORI_STRING Criteria,
+    __in DWORD Depth
+    )
+{
+    PYORILIB_FOREACHFILE_ITEM Item;
+
+    Item = YoriLibMalloc(sizeof(YORILIB_FOREACHFILE_ITEM) + (Criteria->LengthInChars + 1) * sizeof(TCHAR));
+    if (Item == NULL) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&Item->Criteria);
+    Item->Criteria.StartOfString = (LPTSTR)(Item + 1);
+    Item->Criteria.LengthInChars = Criteria->LengthInChars;
+    Item->Criteria.LengthAllocated = Criteria->LengthInChars + 1;
+    memcpy(Item->Criteria.StartOfString, Criteria->StartOfString, Criteria->LengthInChars * sizeof(TCHAR));
+    Item->Criteria.StartOfString[Item->Criteria.LengthInChars] = '\0';
+    Item->Parent = Parent;
+    Item->Pending = 1;
+    Item->Depth = Depth;
+
+    if (Parent != NULL) {
+        InterlockedIncrement(&Parent->Pending);
+    }
+    InterlockedIncrement(&Parallel->Outstanding);
+
+    if (Worker == NULL) {
+        Worker = &Parallel->Workers[Parallel->NextWorker];
+        Parallel->NextWorker++;
+        if (Parallel->NextWorker == Parallel->WorkerCount) {
+            Parallel->NextWorker = 0;
+        }
+    }
+
+    WaitForSingleObject(Worker->Mutex, INFINITE);
+    YoriLibInsertList(&Worker->Queue, &Item->ListEntry);
+    ReleaseMutex(Worker->Mutex);
+
+    ReleaseSemaphore(Parallel->WorkSemaphore, 1, NULL);
+    return TRUE;
+}
+
+/**
+ Wait for all items queued by a parallel enumerate to complete.
+
+ @param Parallel Pointer to the parallel enumerate state.
+ */
+VOID
+YoriLibForEachFileWaitForIdle(
+    __in PYORILIB_FOREACHFILE_PARALLEL Parallel
+    )
+{
+    if (Parallel->Outstanding != 0) {
+        WaitForSingleObject(Parallel->IdleEvent, INFINITE);
+    }
+    ResetEvent(Parallel->IdleEvent);
+}
+
+/**
+ Call a callback for every file matching a specified file pattern within a
+ single directory, and recurse into subdirectories if requested.  When
+ performing a parallel enumerate, subdirectories are queued to worker
+ threads rather than recursed into.
 
  @param FileSpec The pattern to match against.
 
@@ -152,16 +401,35 @@ YoriLibTruncateTrailingSeperatorIfBenign(
         about failures and wants to silently continue.
 
  @param Context Caller provided context to pass to the callback.
+
+ @param Parallel Optionally points to parallel enumerate state.  If NULL,
+        subdirectories are recursed into on this thread.
+
+ @param Worker Optionally points to the worker thread performing this
+        enumerate.  If NULL, this is the calling thread.
+
+ @param Item Optionally points to the queued item being enumerated by a
+        worker thread.
+
+ @param Phases Specifies which phases of the enumerate to perform, as a
+        combination of YORILIB_FOREACHFILE_PHASE_REPORT and
+        YORILIB_FOREACHFILE_PHASE_RECURSE.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
  */
 __success(return)
 BOOL
-YoriLibForEachFileEnum(
+YoriLibForEachFileEnumInternal(
     __in PYORI_STRING FileSpec,
     __in WORD MatchFlags,
     __in DWORD Depth,
     __in PYORILIB_FILE_ENUM_FN Callback,
     __in_opt PYORILIB_FILE_ENUM_ERROR_FN ErrorCallback,
-    __in_opt PVOID Context
+    __in_opt PVOID Context,
+    __in_opt PYORILIB_FOREACHFILE_PARALLEL Parallel,
+    __in_opt PYORILIB_FOREACHFILE_WORKER Worker,
+    __in_opt PYORILIB_FOREACHFILE_ITEM Item,
+    __in WORD Phases
     )
 {
     HANDLE hFind;
@@ -172,6 +440,7 @@ YoriLibForEachFileEnum(
     BOOLEAN RecursePhase;
     BOOLEAN IsLink;
     BOOLEAN TrailingSlashInParentComponent;
+    PYORI_STRING RecurseCriteria;
     PYORILIB_FOREACHFILE_CONTEXT ForEachContext = NULL;
 
     Result = TRUE;
@@ -187,6 +456,18 @@ YoriLibForEachFileEnum(
     }
     YoriLibInitEmptyString(&ForEachContext->RecurseCriteria);
 
+    //
+    //  Worker threads construct subdirectory criteria in a buffer that
+    //  persists across directories.  Otherwise, a buffer is retained across
+    //  all subdirectories of this directory.
+    //
+
+    if (Worker != NULL) {
+        RecurseCriteria = &Worker->RecurseCriteria;
+    } else {
+        RecurseCriteria = &ForEachContext->RecurseCriteria;
+    }
+
     //
     //  This is currently only needed for the GetFileAttributes call.  It may
     //  be possible to relax this, possibly allocating within this routine if
@@ -374,6 +655,16 @@ YoriLibForEachFileEnum(
             }
         }
 
+        if (RecursePhase) {
+            if ((Phases & YORILIB_FOREACHFILE_PHASE_RECURSE) == 0) {
+                continue;
+            }
+        } else {
+            if ((Phases & YORILIB_FOREACHFILE_PHASE_REPORT) == 0) {
+                continue;
+            }
+        }
+
         //
         //  If we're recursing but should apply the file match pattern on
         //  every subdirectory, brew up a new search criteria now for "*"
@@ -534,24 +825,28 @@ YoriLibForEachFileEnum(
                         WildLength = ForEachContext->EffectiveFileSpec.LengthInChars - ForEachContext->CharsToFinalSlash;
                     }
 
-                    if (!YoriLibAllocateString(&ForEachContext->RecurseCriteria,
-                                               ForEachContext->CharsToFinalSlash + FileNameLen + 1 + WildLength + 1)) {
-                        Result = FALSE;
-                        break;
+                    if (RecurseCriteria->LengthAllocated < ForEachContext->CharsToFinalSlash + FileNameLen + 1 + WildLength + 1) {
+                        YoriLibFreeStringContents(RecurseCriteria);
+                        if (!YoriLibAllocateString(RecurseCriteria,
+                                                   ForEachContext->CharsToFinalSlash + FileNameLen + 1 + WildLength + 1)) {
+                            Result = FALSE;
+                            break;
+                        }
                     }
 
+                    RecurseCriteria->LengthInChars = 0;
                     if (FinalSlashFound) {
-                        memcpy(ForEachContext->RecurseCriteria.StartOfString,
+                        memcpy(RecurseCriteria->StartOfString,
                                ForEachContext->EffectiveFileSpec.StartOfString,
                                ForEachContext->CharsToFinalSlash * sizeof(TCHAR));
-                        ForEachContext->RecurseCriteria.LengthInChars = ForEachContext->CharsToFinalSlash;
+                        RecurseCriteria->LengthInChars = ForEachContext->CharsToFinalSlash;
                     }
-                    memcpy(&ForEachContext->RecurseCriteria.StartOfString[ForEachContext->RecurseCriteria.LengthInChars],
+                    memcpy(&RecurseCriteria->StartOfString[RecurseCriteria->LengthInChars],
                            ForEachContext->FileInfo.cFileName,
                            FileNameLen * sizeof(TCHAR));
-                    ForEachContext->RecurseCriteria.LengthInChars = ForEachContext->RecurseCriteria.LengthInChars + FileNameLen;
-                    ForEachContext->RecurseCriteria.StartOfString[ForEachContext->RecurseCriteria.LengthInChars] = '\\';
-                    ForEachContext->RecurseCriteria.LengthInChars++;
+                    RecurseCriteria->LengthInChars = RecurseCriteria->LengthInChars + FileNameLen;
+                    RecurseCriteria->StartOfString[RecurseCriteria->LengthInChars] = '\\';
+                    RecurseCriteria->LengthInChars++;
 
                     //
                     //  Try to implement support for recursively matching a given
@@ -560,26 +855,36 @@ YoriLibForEachFileEnum(
 
                     if ((MatchFlags & YORILIB_ENUM_REC_PRESERVE_WILD) != 0) {
                         if (FinalSlashFound) {
-                            _tcscpy(&ForEachContext->RecurseCriteria.StartOfString[ForEachContext->RecurseCriteria.LengthInChars],
-                                    &ForEachContext->EffectiveFileSpec.StartOfString[ForEachContext->CharsToFinalSlash]);
+                            memcpy(&RecurseCriteria->StartOfString[RecurseCriteria->LengthInChars],
+                                   &ForEachContext->EffectiveFileSpec.StartOfString[ForEachContext->CharsToFinalSlash],
+                                   WildLength * sizeof(TCHAR));
                         } else {
                             ASSERT(ForEachContext->CharsToFinalSlash == 0);
-                            _tcscpy(&ForEachContext->RecurseCriteria.StartOfString[ForEachContext->RecurseCriteria.LengthInChars],
-                                    ForEachContext->EffectiveFileSpec.StartOfString);
+                            memcpy(&RecurseCriteria->StartOfString[RecurseCriteria->LengthInChars],
+                                   ForEachContext->EffectiveFileSpec.StartOfString,
+                                   WildLength * sizeof(TCHAR));
                         }
-                        ForEachContext->RecurseCriteria.LengthInChars = ForEachContext->RecurseCriteria.LengthInChars + WildLength;
+                        RecurseCriteria->LengthInChars = RecurseCriteria->LengthInChars + WildLength;
                     } else {
-                        ForEachContext->RecurseCriteria.StartOfString[ForEachContext->RecurseCriteria.LengthInChars] = '*';
-                        ForEachContext->RecurseCriteria.LengthInChars++;
-                        ForEachContext->RecurseCriteria.StartOfString[ForEachContext->RecurseCriteria.LengthInChars] = '\0';
+                        RecurseCriteria->StartOfString[RecurseCriteria->LengthInChars] = '*';
+                        RecurseCriteria->LengthInChars++;
                     }
+                    RecurseCriteria->StartOfString[RecurseCriteria->LengthInChars] = '\0';
 
-                    if (!YoriLibForEachFileEnum(&ForEachContext->RecurseCriteria, MatchFlags, Depth + 1, Callback, ErrorCallback, Context)) {
+                    //
+                    //  When enumerating in parallel, hand the subdirectory to
+                    //  a worker thread.  Otherwise, recurse into it now.
+                    //
+
+                    if (Parallel != NULL) {
+                        if (!YoriLibForEachFileQueueItem(Parallel, Worker, Item, RecurseCriteria, Depth + 1)) {
+                            Result = FALSE;
+                            break;
+                        }
+                    } else if (!YoriLibForEachFileEnumInternal(RecurseCriteria, MatchFlags, Depth + 1, Callback, ErrorCallback, Context, NULL, NULL, NULL, YORILIB_FOREACHFILE_PHASE_REPORT | YORILIB_FOREACHFILE_PHASE_RECURSE)) {
                         Result = FALSE;
                         break;
                     }
-
-                    YoriLibFreeStringContents(&ForEachContext->RecurseCriteria);
                 }
 
                 //
@@ -629,20 +934,40 @@ YoriLibForEachFileEnum(
                     }
                 }
 
-            } while (hFind != INVALID_HANDLE_VALUE && hFind != NULL && FindNextFile(hFind, &ForEachContext->FileInfo));
+                if (Parallel != NULL && Parallel->Abort) {
+                    Result = FALSE;
+                    break;
+                }
 
-            YoriLibFreeStringContents(&ForEachContext->RecurseCriteria);
+            } while (hFind != INVALID_HANDLE_VALUE && hFind != NULL && FindNextFile(hFind, &ForEachContext->FileInfo));
 
             if (hFind != NULL && hFind != INVALID_HANDLE_VALUE) {
                 FindClose(hFind);
             }
 
+            //
+            //  If this is the calling thread of a parallel enumerate, wait
+            //  for all subdirectories to be processed before moving to the
+            //  next phase or returning.
+            //
+
+            if (Parallel != NULL && Worker == NULL && RecursePhase) {
+                if (Result == FALSE) {
+                    Parallel->Abort = TRUE;
+                }
+                YoriLibForEachFileWaitForIdle(Parallel);
+                if (Parallel->Abort) {
+                    Result = FALSE;
+                }
+            }
+
             if (Result == FALSE) {
                 break;
             }
         }
     }
 
+    YoriLibFreeStringContents(&ForEachContext->RecurseCriteria);
     YoriLibFreeStringContents(&ForEachContext->EffectiveFileSpec);
     YoriLibFreeStringContents(&ForEachContext->ParentFullPath);
     YoriLibFreeStringContents(&ForEachContext->FullPath);
@@ -651,6 +976,386 @@ YoriLibForEachFileEnum(
     return Result;
 }
 
+/**
+ Indicate that an item in a parallel enumerate has finished enumerating its
+ own directory, or that one of its subdirectories has completed.  When
+ nothing remains outstanding for the item, any deferred reporting is
+ performed, the item is freed, and its parent is updated in turn.
+
+ @param Parallel Pointer to the parallel enumerate state.
+
+ @param Worker Pointer to the worker thread completing the item.
+
+ @param Item Pointer to the item.
+ */
+VOID
+YoriLibForEachFileCompleteItem(
+    __in PYORILIB_FOREACHFILE_PARALLEL Parallel,
+    __in PYORILIB_FOREACHFILE_WORKER Worker,
+    __in PYORILIB_FOREACHFILE_ITEM Item
+    )
+{
+    PYORILIB_FOREACHFILE_ITEM Parent;
+
+    while (Item != NULL) {
+        if (InterlockedDecrement(&Item->Pending) != 0) {
+            break;
+        }
+
+        //
+        //  When recursing before returning, objects in this directory can
+        //  only be reported after everything beneath it has been reported.
+        //
+
+        if ((Parallel->MatchFlags & YORILIB_ENUM_REC_BEFORE_RETURN) != 0 &&
+            !Parallel->Abort) {
+
+            if (!YoriLibForEachFileEnumInternal(&Item->Criteria,
+                                                Parallel->MatchFlags,
+                                                Item->Depth,
+                                                Parallel->Callback,
+                                                Parallel->ErrorCallback,
+                                                Parallel->Context,
+                                                Parallel,
+                                                Worker,
+                                                Item,
+                                                YORILIB_FOREACHFILE_PHASE_REPORT)) {
+                Parallel->Abort = TRUE;
+            }
+        }
+
+        Parent = Item->Parent;
+        YoriLibFree(Item);
+
+        if (InterlockedDecrement(&Parallel->Outstanding) == 0) {
+            SetEvent(Parallel->IdleEvent);
+        }
+
+        Item = Parent;
+    }
+}
+
+/**
+ Remove the next item for a worker to enumerate.  Items are taken from the
+ head of the worker's own queue, or if that is empty, from the tail of
+ another worker's queue.  The caller must have acquired the work semaphore,
+ which guarantees that an item exists on some queue.
+
+ @param Worker Pointer to the worker thread looking for work.
+
+ @return Pointer to the item, or NULL if no item was found.
+ */
+PYORILIB_FOREACHFILE_ITEM
+YoriLibForEachFileGetNextItem(
+    __in PYORILIB_FOREACHFILE_WORKER Worker
+    )
+{
+    PYORILIB_FOREACHFILE_PARALLEL Parallel;
+    PYORILIB_FOREACHFILE_WORKER Victim;
+    PYORI_LIST_ENTRY ListEntry;
+    DWORD Index;
+    DWORD VictimIndex;
+
+    Parallel = Worker->Parallel;
+
+    WaitForSingleObject(Worker->Mutex, INFINITE);
+    ListEntry = YoriLibGetNextListEntry(&Worker->Queue, NULL);
+    if (ListEntry != NULL) {
+        YoriLibRemoveListItem(ListEntry);
+    }
+    ReleaseMutex(Worker->Mutex);
+
+    if (ListEntry != NULL) {
+        return CONTAINING_RECORD(ListEntry, YORILIB_FOREACHFILE_ITEM, ListEntry);
+    }
+
+    VictimIndex = (DWORD)(Worker - Parallel->Workers);
+    for (Index = 1; Index < Parallel->WorkerCount; Index++) {
+        VictimIndex++;
+        if (VictimIndex == Parallel->WorkerCount) {
+            VictimIndex = 0;
+        }
+        Victim = &Parallel->Workers[VictimIndex];
+
+        WaitForSingleObject(Victim->Mutex, INFINITE);
+        ListEntry = YoriLibGetPreviousListEntry(&Victim->Queue, NULL);
+        if (ListEntry != NULL) {
+            YoriLibRemoveListItem(ListEntry);
+        }
+        ReleaseMutex(Victim->Mutex);
+
+        if (ListEntry != NULL) {
+            return CONTAINING_RECORD(ListEntry, YORILIB_FOREACHFILE_ITEM, ListEntry);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ A worker thread for a parallel enumerate.  This waits for items to be
+ queued, enumerates them, and completes them.
+
+ @param Context Pointer to the worker.
+
+ @return Thread return code, which is ignored.
+ */
+DWORD WINAPI
+YoriLibForEachFileWorker(
+    __in LPVOID Context
+    )
+{
+    PYORILIB_FOREACHFILE_WORKER Worker;
+    PYORILIB_FOREACHFILE_PARALLEL Parallel;
+    PYORILIB_FOREACHFILE_ITEM Item;
+    WORD Phases;
+
+    Worker = (PYORILIB_FOREACHFILE_WORKER)Context;
+    Parallel = Worker->Parallel;
+
+    //
+    //  When recursing before returning, only recurse now.  Objects in the
+    //  directory are reported when the item completes.
+    //
+
+    Phases = YORILIB_FOREACHFILE_PHASE_REPORT | YORILIB_FOREACHFILE_PHASE_RECURSE;
+    if ((Parallel->MatchFlags & YORILIB_ENUM_REC_BEFORE_RETURN) != 0) {
+        Phases = YORILIB_FOREACHFILE_PHASE_RECURSE;
+    }
+
+    while (TRUE) {
+        WaitForSingleObject(Parallel->WorkSemaphore, INFINITE);
+        if (Parallel->Shutdown) {
+            break;
+        }
+
+        Item = YoriLibForEachFileGetNextItem(Worker);
+        ASSERT(Item != NULL);
+        if (Item == NULL) {
+            continue;
+        }
+
+        if (!Parallel->Abort) {
+            if (!YoriLibForEachFileEnumInternal(&Item->Criteria,
+                                                Parallel->MatchFlags,
+                                                Item->Depth,
+                                                Parallel->Callback,
+                                                Parallel->ErrorCallback,
+                                                Parallel->Context,
+                                                Parallel,
+                                                Worker,
+                                                Item,
+                                                Phases)) {
+                Parallel->Abort = TRUE;
+            }
+        }
+
+        YoriLibForEachFileCompleteItem(Parallel, Worker, Item);
+    }
+
+    return 0;
+}
+
+/**
+ Stop all worker threads for a parallel enumerate and free its state.  All
+ items must have completed before this is called.
+
+ @param Parallel Pointer to the parallel enumerate state.
+ */
+VOID
+YoriLibForEachFileFreeParallel(
+    __in PYORILIB_FOREACHFILE_PARALLEL Parallel
+    )
+{
+    DWORD Index;
+    DWORD ThreadCount;
+
+    ASSERT(Parallel->Outstanding == 0);
+
+    ThreadCount = 0;
+    for (Index = 0; Index < Parallel->WorkerCount; Index++) {
+        if (Parallel->Workers[Index].Thread != NULL) {
+            ThreadCount++;
+        }
+    }
+
+    if (ThreadCount > 0) {
+        Parallel->Shutdown = TRUE;
+        ReleaseSemaphore(Parallel->WorkSemaphore, ThreadCount, NULL);
+    }
+
+    for (Index = 0; Index < Parallel->WorkerCount; Index++) {
+        if (Parallel->Workers[Index].Thread != NULL) {
+            WaitForSingleObject(Parallel->Workers[Index].Thread, INFINITE);
+            CloseHandle(Parallel->Workers[Index].Thread);
+        }
+        if (Parallel->Workers[Index].Mutex != NULL) {
+            CloseHandle(Parallel->Workers[Index].Mutex);
+        }
+        ASSERT(YoriLibIsListEmpty(&Parallel->Workers[Index].Queue));
+        YoriLibFreeStringContents(&Parallel->Workers[Index].RecurseCriteria);
+    }
+
+    if (Parallel->WorkSemaphore != NULL) {
+        CloseHandle(Parallel->WorkSemaphore);
+    }
+    if (Parallel->IdleEvent != NULL) {
+        CloseHandle(Parallel->IdleEvent);
+    }
+
+    YoriLibFree(Parallel);
+}
+
+/**
+ Allocate state for a parallel enumerate and start its worker threads.  One
+ worker is created for each processor.
+
+ @param MatchFlags Specifies the behavior of the match.
+
+ @param Callback The callback to invoke on each match.
+
+ @param ErrorCallback Optionally points to a function to invoke if a
+        directory cannot be enumerated.
+
+ @param Context Caller provided context to pass to the callback.
+
+ @return Pointer to the parallel enumerate state, or NULL on failure.  On
+         failure, the caller is expected to enumerate on a single thread.
+ */
+PYORILIB_FOREACHFILE_PARALLEL
+YoriLibForEachFileAllocateParallel(
+    __in WORD MatchFlags,
+    __in PYORILIB_FILE_ENUM_FN Callback,
+    __in_opt PYORILIB_FILE_ENUM_ERROR_FN ErrorCallback,
+    __in_opt PVOID Context
+    )
+{
+    PYORILIB_FOREACHFILE_PARALLEL Parallel;
+    SYSTEM_INFO SystemInfo;
+    DWORD WorkerCount;
+    DWORD Index;
+    DWORD ThreadId;
+
+    GetSystemInfo(&SystemInfo);
+    WorkerCount = SystemInfo.dwNumberOfProcessors;
+    if (WorkerCount < 2) {
+        return NULL;
+    }
+    if (WorkerCount > YORILIB_FOREACHFILE_MAX_WORKERS) {
+        WorkerCount = YORILIB_FOREACHFILE_MAX_WORKERS;
+    }
+
+    Parallel = YoriLibMalloc(sizeof(YORILIB_FOREACHFILE_PARALLEL) + WorkerCount * sizeof(YORILIB_FOREACHFILE_WORKER));
+    if (Parallel == NULL) {
+        return NULL;
+    }
+
+    ZeroMemory(Parallel, sizeof(YORILIB_FOREACHFILE_PARALLEL) + WorkerCount * sizeof(YORILIB_FOREACHFILE_WORKER));
+    Parallel->MatchFlags = MatchFlags;
+    Parallel->Callback = Callback;
+    Parallel->ErrorCallback = ErrorCallback;
+    Parallel->Context = Context;
+    Parallel->WorkerCount = WorkerCount;
+    Parallel->Workers = (PYORILIB_FOREACHFILE_WORKER)(Parallel + 1);
+
+    for (Index = 0; Index < WorkerCount; Index++) {
+        YoriLibInitializeListHead(&Parallel->Workers[Index].Queue);
+        YoriLibInitEmptyString(&Parallel->Workers[Index].RecurseCriteria);
+        Parallel->Workers[Index].Parallel = Parallel;
+    }
+
+    Parallel->WorkSemaphore = CreateSemaphore(NULL, 0, 0x7fffffff, NULL);
+    if (Parallel->WorkSemaphore == NULL) {
+        YoriLibForEachFileFreeParallel(Parallel);
+        return NULL;
+    }
+
+    Parallel->IdleEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (Parallel->IdleEvent == NULL) {
+        YoriLibForEachFileFreeParallel(Parallel);
+        return NULL;
+    }
+
+    for (Index = 0; Index < WorkerCount; Index++) {
+        Parallel->Workers[Index].Mutex = CreateMutex(NULL, FALSE, NULL);
+        if (Parallel->Workers[Index].Mutex == NULL) {
+            YoriLibForEachFileFreeParallel(Parallel);
+            return NULL;
+        }
+    }
+
+    for (Index = 0; Index < WorkerCount; Index++) {
+        Parallel->Workers[Index].Thread = CreateThread(NULL, 0, YoriLibForEachFileWorker, &Parallel->Workers[Index], 0, &ThreadId);
+        if (Parallel->Workers[Index].Thread == NULL) {
+            YoriLibForEachFileFreeParallel(Parallel);
+            return NULL;
+        }
+    }
+
+    return Parallel;
+}
+
+/**
+ Call a callback for every file matching a specified file pattern.
+
+ @param FileSpec The pattern to match against.
+
+ @param MatchFlags Specifies the behavior of the match, including whether
+        it should be applied recursively and the recursing behavior.
+
+ @param Depth Indicates the current recursion depth.  If this function is
+        reentered, this value is incremented.
+
+ @param Callback The callback to invoke on each match.
+
+ @param ErrorCallback Optionally points to a function to invoke if a
+        directory cannot be enumerated.  If NULL, the caller does not care
+        about failures and wants to silently continue.
+
+ @param Context Caller provided context to pass to the callback.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibForEachFileEnum(
+    __in PYORI_STRING FileSpec,
+    __in WORD MatchFlags,
+    __in DWORD Depth,
+    __in PYORILIB_FILE_ENUM_FN Callback,
+    __in_opt PYORILIB_FILE_ENUM_ERROR_FN ErrorCallback,
+    __in_opt PVOID Context
+    )
+{
+    PYORILIB_FOREACHFILE_PARALLEL Parallel;
+    BOOL Result;
+
+    Parallel = NULL;
+    if ((MatchFlags & YORILIB_ENUM_PARALLEL) != 0 &&
+        (MatchFlags & (YORILIB_ENUM_REC_AFTER_RETURN | YORILIB_ENUM_REC_BEFORE_RETURN)) != 0 &&
+        Depth == 0) {
+
+        Parallel = YoriLibForEachFileAllocateParallel(MatchFlags, Callback, ErrorCallback, Context);
+    }
+
+    Result = YoriLibForEachFileEnumInternal(FileSpec,
+                                            MatchFlags,
+                                            Depth,
+                                            Callback,
+                                            ErrorCallback,
+                                            Context,
+                                            Parallel,
+                                            NULL,
+                                            NULL,
+                                            YORILIB_FOREACHFILE_PHASE_REPORT | YORILIB_FOREACHFILE_PHASE_RECURSE);
+
+    if (Parallel != NULL) {
+        YoriLibForEachFileFreeParallel(Parallel);
+    }
+
+    return Result;
+}
+
 /**
  Enumerate the set of possible files matching a user specified pattern.
  This function is responsible for expanding Yori defined sequences, including
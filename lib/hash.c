@@ -251,4 +251,674 @@ YoriLibHashRemoveByKey(
     return Entry;
 }
 
+/**
+ The value in YORI_OPEN_HASH_SLOTS::Hashes indicating a slot has never
+ contained an entry.  A probe sequence ends when it finds this value.
+ */
+#define YORI_OPEN_HASH_SLOT_EMPTY         (0)
+
+/**
+ The value in YORI_OPEN_HASH_SLOTS::Hashes indicating a slot contained an
+ entry which has since been removed.  A probe sequence continues past this
+ value.
+ */
+#define YORI_OPEN_HASH_SLOT_REMOVED       (1)
+
+/**
+ The smallest number of slots to allocate in an open hash table.
+ */
+#define YORI_OPEN_HASH_MIN_SLOTS          (16)
+
+/**
+ The number of slots in the draining array to migrate as part of each
+ insertion while a resize is in progress.  A resize leaves the new array no
+ more than half full and the next resize occurs when it is three quarters
+ full, so any value of four or more ensures one resize completes before the
+ next is needed.  Larger values complete the resize sooner at the cost of
+ more work per insertion.
+ */
+#define YORI_OPEN_HASH_MIGRATE_PER_INSERT (32)
+
+/**
+ Hash a yori string into a 32 bit hash value for use in an open addressed
+ hash table.  Because the table uses the low bits of the hash as an index
+ and relies on the full hash to avoid key comparisons, this is a stronger
+ hash than YoriLibHashString32.  Like that routine, the result is
+ independent of case.  Two hash values are reserved to describe slot
+ state and are never returned.
+
+ @param String The string to generate a hash for.
+
+ @return A 32 bit hash value for the string.
+ */
+DWORD
+YoriLibOpenHashString(
+    __in PCYORI_STRING String
+    )
+{
+    DWORD Hash;
+    YORI_ALLOC_SIZE_T Index;
+    TCHAR Char;
+
+    //
+    //  FNV-1a over the upcased characters.
+    //
+
+    Hash = 2166136261;
+    for (Index = 0; Index < String->LengthInChars; Index++) {
+        Char = String->StartOfString[Index];
+        if (Char >= 'a' && Char <= 'z') {
+            Char = (TCHAR)(Char - 'a' + 'A');
+        }
+        Hash = Hash ^ Char;
+        Hash = Hash * 16777619;
+    }
+
+    //
+    //  Mix the high bits into the low bits, since only the low bits are
+    //  used to find the initial slot.
+    //
+
+    Hash = Hash ^ (Hash >> 16);
+    Hash = Hash * 0x85ebca6b;
+    Hash = Hash ^ (Hash >> 13);
+    Hash = Hash * 0xc2b2ae35;
+    Hash = Hash ^ (Hash >> 16);
+
+    if (Hash <= YORI_OPEN_HASH_SLOT_REMOVED) {
+        Hash = Hash + YORI_OPEN_HASH_SLOT_REMOVED + 1;
+    }
+
+    return Hash;
+}
+
+/**
+ Allocate the arrays for a set of slots in an open hash table.
+
+ @param Slots Pointer to the slots structure to initialize.
+
+ @param SlotCount The number of slots to allocate.  This must be a power of
+        two.
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.
+ */
+__success(return)
+BOOLEAN
+YoriLibOpenHashAllocateSlots(
+    __out PYORI_OPEN_HASH_SLOTS Slots,
+    __in YORI_ALLOC_SIZE_T SlotCount
+    )
+{
+    YORI_MAX_UNSIGNED_T SizeNeeded;
+
+    ASSERT((SlotCount & (SlotCount - 1)) == 0);
+
+    SizeNeeded = SlotCount;
+    SizeNeeded = SizeNeeded * (sizeof(DWORD) + sizeof(PYORI_OPEN_HASH_ENTRY));
+    if (!YoriLibIsSizeAllocatable(SizeNeeded)) {
+        return FALSE;
+    }
+
+    Slots->Hashes = YoriLibMalloc((YORI_ALLOC_SIZE_T)SizeNeeded);
+    if (Slots->Hashes == NULL) {
+        return FALSE;
+    }
+
+    //
+    //  The slot count is at least YORI_OPEN_HASH_MIN_SLOTS so the array of
+    //  hashes has a size that is a multiple of pointer alignment.
+    //
+
+    Slots->Entries = (PYORI_OPEN_HASH_ENTRY *)(Slots->Hashes + SlotCount);
+    ZeroMemory(Slots->Hashes, SlotCount * sizeof(DWORD));
+    Slots->SlotCount = SlotCount;
+    Slots->UsedCount = 0;
+    Slots->LiveCount = 0;
+    return TRUE;
+}
+
+/**
+ Free the arrays for a set of slots in an open hash table.
+
+ @param Slots Pointer to the slots structure to clean up.
+ */
+VOID
+YoriLibOpenHashFreeSlots(
+    __inout PYORI_OPEN_HASH_SLOTS Slots
+    )
+{
+    if (Slots->Hashes != NULL) {
+        YoriLibFree(Slots->Hashes);
+    }
+    Slots->Hashes = NULL;
+    Slots->Entries = NULL;
+    Slots->SlotCount = 0;
+    Slots->UsedCount = 0;
+    Slots->LiveCount = 0;
+}
+
+/**
+ Place an entry into the first available slot along its probe sequence.
+ The caller is expected to ensure that a free slot exists.
+
+ @param Slots Pointer to the slots to insert the entry into.
+
+ @param HashEntry Pointer to the entry to insert, whose Hash member has
+        been initialized.
+ */
+VOID
+YoriLibOpenHashPlaceEntry(
+    __inout PYORI_OPEN_HASH_SLOTS Slots,
+    __in PYORI_OPEN_HASH_ENTRY HashEntry
+    )
+{
+    YORI_ALLOC_SIZE_T Mask;
+    YORI_ALLOC_SIZE_T Index;
+    DWORD SlotHash;
+
+    ASSERT(Slots->UsedCount < Slots->SlotCount);
+
+    Mask = Slots->SlotCount - 1;
+    Index = HashEntry->Hash & Mask;
+    while (TRUE) {
+        SlotHash = Slots->Hashes[Index];
+        if (SlotHash == YORI_OPEN_HASH_SLOT_EMPTY) {
+            Slots->UsedCount++;
+            break;
+        }
+        if (SlotHash == YORI_OPEN_HASH_SLOT_REMOVED) {
+            break;
+        }
+        Index = (Index + 1) & Mask;
+    }
+
+    Slots->Hashes[Index] = HashEntry->Hash;
+    Slots->Entries[Index] = HashEntry;
+    Slots->LiveCount++;
+}
+
+/**
+ Remove the entry at a specified slot index.  If the following slot is
+ empty, no probe sequence can continue past this slot, so it can be marked
+ empty rather than removed.
+
+ @param Slots Pointer to the slots containing the entry.
+
+ @param Index The index of the slot to clear.
+ */
+VOID
+YoriLibOpenHashClearSlot(
+    __inout PYORI_OPEN_HASH_SLOTS Slots,
+    __in YORI_ALLOC_SIZE_T Index
+    )
+{
+    YORI_ALLOC_SIZE_T NextIndex;
+
+    NextIndex = (Index + 1) & (Slots->SlotCount - 1);
+    if (Slots->Hashes[NextIndex] == YORI_OPEN_HASH_SLOT_EMPTY) {
+        Slots->Hashes[Index] = YORI_OPEN_HASH_SLOT_EMPTY;
+        Slots->UsedCount--;
+    } else {
+        Slots->Hashes[Index] = YORI_OPEN_HASH_SLOT_REMOVED;
+    }
+    Slots->Entries[Index] = NULL;
+    Slots->LiveCount--;
+}
+
+/**
+ Search a set of slots for an entry matching a key.
+
+ @param Slots Pointer to the slots to search.
+
+ @param Hash The hash of the key, as returned from YoriLibOpenHashString.
+
+ @param KeyString Pointer to the key to search for.
+
+ @return The index of the slot containing the matching entry, or
+         YORI_MAX_ALLOC_SIZE if no match is found.
+ */
+YORI_ALLOC_SIZE_T
+YoriLibOpenHashFindSlotByKey(
+    __in PYORI_OPEN_HASH_SLOTS Slots,
+    __in DWORD Hash,
+    __in PCYORI_STRING KeyString
+    )
+{
+    YORI_ALLOC_SIZE_T Mask;
+    YORI_ALLOC_SIZE_T Index;
+    DWORD SlotHash;
+
+    if (Slots->SlotCount == 0) {
+        return YORI_MAX_ALLOC_SIZE;
+    }
+
+    Mask = Slots->SlotCount - 1;
+    Index = Hash & Mask;
+    while (TRUE) {
+        SlotHash = Slots->Hashes[Index];
+        if (SlotHash == YORI_OPEN_HASH_SLOT_EMPTY) {
+            break;
+        }
+        if (SlotHash == Hash &&
+            YoriLibCompareStringIns(KeyString, &Slots->Entries[Index]->Key) == 0) {
+
+            return Index;
+        }
+        Index = (Index + 1) & Mask;
+    }
+
+    return YORI_MAX_ALLOC_SIZE;
+}
+
+/**
+ Search a set of slots for a specific entry.
+
+ @param Slots Pointer to the slots to search.
+
+ @param HashEntry Pointer to the entry to find.
+
+ @return The index of the slot containing the entry, or YORI_MAX_ALLOC_SIZE
+         if the entry is not in these slots.
+ */
+YORI_ALLOC_SIZE_T
+YoriLibOpenHashFindSlotByEntry(
+    __in PYORI_OPEN_HASH_SLOTS Slots,
+    __in PYORI_OPEN_HASH_ENTRY HashEntry
+    )
+{
+    YORI_ALLOC_SIZE_T Mask;
+    YORI_ALLOC_SIZE_T Index;
+    DWORD SlotHash;
+
+    if (Slots->SlotCount == 0) {
+        return YORI_MAX_ALLOC_SIZE;
+    }
+
+    Mask = Slots->SlotCount - 1;
+    Index = HashEntry->Hash & Mask;
+    while (TRUE) {
+        SlotHash = Slots->Hashes[Index];
+        if (SlotHash == YORI_OPEN_HASH_SLOT_EMPTY) {
+            break;
+        }
+        if (Slots->Entries[Index] == HashEntry) {
+            return Index;
+        }
+        Index = (Index + 1) & Mask;
+    }
+
+    return YORI_MAX_ALLOC_SIZE;
+}
+
+/**
+ Move entries from the draining array of a hash table into the primary
+ array.  When the draining array is empty, it is freed.
+
+ @param HashTable Pointer to the hash table.
+
+ @param SlotsToScan The maximum number of draining slots to examine.
+ */
+VOID
+YoriLibOpenHashMigrate(
+    __inout PYORI_OPEN_HASH_TABLE HashTable,
+    __in YORI_ALLOC_SIZE_T SlotsToScan
+    )
+{
+    PYORI_OPEN_HASH_SLOTS Draining;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T Scanned;
+
+    Draining = &HashTable->Draining;
+    Index = HashTable->DrainIndex;
+    for (Scanned = 0;
+         Scanned < SlotsToScan && Index < Draining->SlotCount && Draining->LiveCount > 0;
+         Scanned++, Index++) {
+
+        if (Draining->Hashes[Index] > YORI_OPEN_HASH_SLOT_REMOVED) {
+            YoriLibOpenHashPlaceEntry(&HashTable->Primary, Draining->Entries[Index]);
+
+            //
+            //  Other entries in the draining array may still need to probe
+            //  past this slot, so it cannot be marked empty.
+            //
+
+            Draining->Hashes[Index] = YORI_OPEN_HASH_SLOT_REMOVED;
+            Draining->Entries[Index] = NULL;
+            Draining->LiveCount--;
+        }
+    }
+    HashTable->DrainIndex = Index;
+
+    if (Draining->LiveCount == 0) {
+        YoriLibOpenHashFreeSlots(Draining);
+        HashTable->DrainIndex = 0;
+    }
+}
+
+/**
+ Start a resize of a hash table by allocating a new primary array and
+ marking the previous one to be drained as future insertions occur.  If a
+ previous resize is still in progress, it is completed first.
+
+ @param HashTable Pointer to the hash table.
+
+ @return TRUE to indicate a new array was allocated, FALSE if it could not
+         be allocated.
+ */
+__success(return)
+BOOLEAN
+YoriLibOpenHashStartResize(
+    __inout PYORI_OPEN_HASH_TABLE HashTable
+    )
+{
+    YORI_OPEN_HASH_SLOTS NewSlots;
+    YORI_ALLOC_SIZE_T NewSlotCount;
+    YORI_ALLOC_SIZE_T LiveCount;
+
+    if (HashTable->Draining.SlotCount != 0) {
+        YoriLibOpenHashMigrate(HashTable, YORI_MAX_ALLOC_SIZE);
+    }
+
+    //
+    //  Size the new array so that it is at most half full of live
+    //  entries.  If the existing array is mostly removal markers, this
+    //  results in a new array of the same size.
+    //
+
+    LiveCount = HashTable->Primary.LiveCount;
+    NewSlotCount = HashTable->Primary.SlotCount;
+    while ((YORI_MAX_UNSIGNED_T)(LiveCount + 1) * 2 > NewSlotCount) {
+        if (NewSlotCount > YORI_MAX_ALLOC_SIZE / 2) {
+            return FALSE;
+        }
+        NewSlotCount = NewSlotCount * 2;
+    }
+
+    if (!YoriLibOpenHashAllocateSlots(&NewSlots, NewSlotCount)) {
+        return FALSE;
+    }
+
+    memcpy(&HashTable->Draining, &HashTable->Primary, sizeof(YORI_OPEN_HASH_SLOTS));
+    memcpy(&HashTable->Primary, &NewSlots, sizeof(YORI_OPEN_HASH_SLOTS));
+    HashTable->DrainIndex = 0;
+
+    if (HashTable->Draining.LiveCount == 0) {
+        YoriLibOpenHashFreeSlots(&HashTable->Draining);
+    }
+
+    return TRUE;
+}
+
+/**
+ Allocate an empty open addressed hash table.  The table grows as entries
+ are inserted, so the expected number of entries is only a hint to avoid
+ early resizes.
+
+ @param ExpectedEntries The number of entries the caller expects to insert.
+        This can be zero.
+
+ @return On successful completion, points to the resulting hash table.
+         On allocation failure, returns NULL.
+ */
+PYORI_OPEN_HASH_TABLE
+YoriLibAllocateOpenHashTable(
+    __in YORI_ALLOC_SIZE_T ExpectedEntries
+    )
+{
+    PYORI_OPEN_HASH_TABLE HashTable;
+    YORI_ALLOC_SIZE_T SlotCount;
+
+    //
+    //  Size the table so the expected entries fill no more than half of
+    //  it.
+    //
+
+    SlotCount = YORI_OPEN_HASH_MIN_SLOTS;
+    while ((YORI_MAX_UNSIGNED_T)SlotCount < (YORI_MAX_UNSIGNED_T)ExpectedEntries * 2) {
+        if (SlotCount > YORI_MAX_ALLOC_SIZE / 2) {
+            return NULL;
+        }
+        SlotCount = SlotCount * 2;
+    }
+
+    HashTable = YoriLibMalloc(sizeof(YORI_OPEN_HASH_TABLE));
+    if (HashTable == NULL) {
+        return NULL;
+    }
+
+    ZeroMemory(HashTable, sizeof(YORI_OPEN_HASH_TABLE));
+    if (!YoriLibOpenHashAllocateSlots(&HashTable->Primary, SlotCount)) {
+        YoriLibFree(HashTable);
+        return NULL;
+    }
+
+    return HashTable;
+}
+
+/**
+ Free an open addressed hash table.  This assumes the caller has already
+ removed and performed all necessary cleanup for any objects within it.
+
+ @param HashTable Pointer to the hash table to deallocate.
+ */
+VOID
+YoriLibFreeEmptyOpenHashTable(
+    __in PYORI_OPEN_HASH_TABLE HashTable
+    )
+{
+    ASSERT(HashTable->EntryCount == 0);
+    YoriLibOpenHashFreeSlots(&HashTable->Primary);
+    YoriLibOpenHashFreeSlots(&HashTable->Draining);
+    YoriLibFree(HashTable);
+}
+
+/**
+ Insert an object with a string based key into an open addressed hash table.
+ Note that this routine does not check for an existing entry with the same
+ key.
+
+ @param HashTable The hash table to insert the object into.
+
+ @param KeyString Pointer to a Yori string describing the key for the
+        entry.
+
+ @param Context Pointer to a blob of data which is meaningful to the caller.
+
+ @param HashEntry On successful completion, populated with structures
+        describing the entry within the hash table.
+
+ @return TRUE to indicate the entry was inserted, FALSE if the table needed
+         to grow and memory could not be allocated.
+ */
+__success(return)
+BOOLEAN
+YoriLibOpenHashInsertByKey(
+    __in PYORI_OPEN_HASH_TABLE HashTable,
+    __in PYORI_STRING KeyString,
+    __in PVOID Context,
+    __out PYORI_OPEN_HASH_ENTRY HashEntry
+    )
+{
+    PYORI_OPEN_HASH_SLOTS Primary;
+
+    if (HashTable->Draining.SlotCount != 0) {
+        YoriLibOpenHashMigrate(HashTable, YORI_OPEN_HASH_MIGRATE_PER_INSERT);
+    }
+
+    //
+    //  Grow when three quarters of slots are used.  If memory cannot be
+    //  allocated, keep using the existing array so long as an empty slot
+    //  will remain to terminate probe sequences.
+    //
+
+    Primary = &HashTable->Primary;
+    if ((YORI_MAX_UNSIGNED_T)(Primary->UsedCount + 1) * 4 > (YORI_MAX_UNSIGNED_T)Primary->SlotCount * 3) {
+        if (!YoriLibOpenHashStartResize(HashTable) &&
+            Primary->UsedCount + 1 >= Primary->SlotCount) {
+
+            return FALSE;
+        }
+    }
+
+    YoriLibCloneString(&HashEntry->Key, KeyString);
+    HashEntry->Context = Context;
+    HashEntry->Hash = YoriLibOpenHashString(KeyString);
+    YoriLibOpenHashPlaceEntry(Primary, HashEntry);
+    HashTable->EntryCount++;
+    return TRUE;
+}
+
+/**
+ Locate an object within an open addressed hash table by a specified key.
+
+ @param HashTable Pointer to the hash table to search for the object.
+
+ @param KeyString Pointer to the key to identify the object.
+
+ @return Pointer to the entry within the hash table if a match is found.
+         If no match is found, returns NULL.
+ */
+PYORI_OPEN_HASH_ENTRY
+YoriLibOpenHashLookupByKey(
+    __in PYORI_OPEN_HASH_TABLE HashTable,
+    __in PCYORI_STRING KeyString
+    )
+{
+    DWORD Hash;
+    YORI_ALLOC_SIZE_T Index;
+
+    Hash = YoriLibOpenHashString(KeyString);
+
+    Index = YoriLibOpenHashFindSlotByKey(&HashTable->Primary, Hash, KeyString);
+    if (Index != YORI_MAX_ALLOC_SIZE) {
+        return HashTable->Primary.Entries[Index];
+    }
+
+    Index = YoriLibOpenHashFindSlotByKey(&HashTable->Draining, Hash, KeyString);
+    if (Index != YORI_MAX_ALLOC_SIZE) {
+        return HashTable->Draining.Entries[Index];
+    }
+
+    return NULL;
+}
+
+/**
+ Remove an entry from an open addressed hash table.  This routine assumes the
+ entry must already be inserted into the hash table.
+
+ @param HashTable The hash table containing the entry.
+
+ @param HashEntry The entry to remove.
+ */
+VOID
+YoriLibOpenHashRemoveByEntry(
+    __in PYORI_OPEN_HASH_TABLE HashTable,
+    __in PYORI_OPEN_HASH_ENTRY HashEntry
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    Index = YoriLibOpenHashFindSlotByEntry(&HashTable->Primary, HashEntry);
+    if (Index != YORI_MAX_ALLOC_SIZE) {
+        YoriLibOpenHashClearSlot(&HashTable->Primary, Index);
+    } else {
+        Index = YoriLibOpenHashFindSlotByEntry(&HashTable->Draining, HashEntry);
+        ASSERT(Index != YORI_MAX_ALLOC_SIZE);
+        if (Index == YORI_MAX_ALLOC_SIZE) {
+            return;
+        }
+        YoriLibOpenHashClearSlot(&HashTable->Draining, Index);
+    }
+
+    HashTable->EntryCount--;
+    YoriLibFreeStringContents(&HashEntry->Key);
+}
+
+/**
+ Remove an entry from an open addressed hash table by performing a lookup by
+ key.
+
+ @param HashTable The hash table to remove the entry from.
+
+ @param KeyString The key matching the object to remove.
+
+ @return Pointer to the entry if one was removed, or NULL if no match was
+         found.
+ */
+PYORI_OPEN_HASH_ENTRY
+YoriLibOpenHashRemoveByKey(
+    __in PYORI_OPEN_HASH_TABLE HashTable,
+    __in PCYORI_STRING KeyString
+    )
+{
+    PYORI_OPEN_HASH_ENTRY Entry;
+    Entry = YoriLibOpenHashLookupByKey(HashTable, KeyString);
+    if (Entry != NULL) {
+        YoriLibOpenHashRemoveByEntry(HashTable, Entry);
+    }
+
+    return Entry;
+}
+
+/**
+ Return the next entry in an open addressed hash table.  Entries are
+ returned in no particular order.  Entries must not be inserted while
+ enumerating.  The previously returned entry can be removed, but only after
+ it has been used to find the following entry, similar to
+ YoriLibGetNextListEntry.
+
+ @param HashTable The hash table to enumerate.
+
+ @param PreviousEntry Pointer to the previously returned entry, or NULL to
+        begin enumerating.
+
+ @return Pointer to the next entry, or NULL if all entries have been
+         returned.
+ */
+PYORI_OPEN_HASH_ENTRY
+YoriLibOpenHashGetNextEntry(
+    __in PYORI_OPEN_HASH_TABLE HashTable,
+    __in_opt PYORI_OPEN_HASH_ENTRY PreviousEntry
+    )
+{
+    PYORI_OPEN_HASH_SLOTS Slots;
+    YORI_ALLOC_SIZE_T Index;
+
+    //
+    //  Entries in the draining array are returned first, followed by
+    //  entries in the primary array.
+    //
+
+    Slots = &HashTable->Draining;
+    Index = 0;
+    if (PreviousEntry != NULL) {
+        Index = YoriLibOpenHashFindSlotByEntry(Slots, PreviousEntry);
+        if (Index == YORI_MAX_ALLOC_SIZE) {
+            Slots = &HashTable->Primary;
+            Index = YoriLibOpenHashFindSlotByEntry(Slots, PreviousEntry);
+            ASSERT(Index != YORI_MAX_ALLOC_SIZE);
+            if (Index == YORI_MAX_ALLOC_SIZE) {
+                return NULL;
+            }
+        }
+        Index++;
+    }
+
+    while (TRUE) {
+        for (; Index < Slots->SlotCount; Index++) {
+            if (Slots->Hashes[Index] > YORI_OPEN_HASH_SLOT_REMOVED) {
+                return Slots->Entries[Index];
+            }
+        }
+
+        if (Slots == &HashTable->Primary) {
+            break;
+        }
+        Slots = &HashTable->Primary;
+        Index = 0;
+    }
+
+    return NULL;
+}
+
 // vim:sw=4:ts=4:et:
@@ -0,0 +1,1330 @@
+/**
+ * @file lib/ini.c
+ *
+ * Yori INI file document routines
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+/**
+ The number of bytes to read from an INI file at a time.
+ */
+#define YORI_LIB_INI_READ_SIZE (64 * 1024)
+
+/**
+ Free a line within a section, which may or may not be a key.  The caller
+ is expected to have removed it from any list or hash table.
+
+ @param Key Pointer to the line to free.
+ */
+VOID
+YoriLibIniFreeKey(
+    __in PYORI_LIB_INI_KEY Key
+    )
+{
+    YoriLibFreeStringContents(&Key->Name);
+    YoriLibFreeStringContents(&Key->Value);
+    YoriLibFree(Key);
+}
+
+/**
+ Remove a line from a section and free it.
+
+ @param Section Pointer to the section containing the line.
+
+ @param Key Pointer to the line to remove.
+ */
+VOID
+YoriLibIniRemoveKey(
+    __in PYORI_LIB_INI_SECTION Section,
+    __in PYORI_LIB_INI_KEY Key
+    )
+{
+    YoriLibRemoveListItem(&Key->ListEntry);
+    if (!Key->Verbatim) {
+        YoriLibOpenHashRemoveByEntry(Section->KeyHash, &Key->HashEntry);
+    }
+    YoriLibIniFreeKey(Key);
+}
+
+/**
+ Remove a section from a document and free it along with every line within
+ it.
+
+ @param Document Pointer to the document containing the section.
+
+ @param Section Pointer to the section to free.
+ */
+VOID
+YoriLibIniRemoveSection(
+    __in PYORI_LIB_INI_DOCUMENT Document,
+    __in PYORI_LIB_INI_SECTION Section
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_LIB_INI_KEY Key;
+
+    ListEntry = YoriLibGetNextListEntry(&Section->KeyList, NULL);
+    while (ListEntry != NULL) {
+        Key = CONTAINING_RECORD(ListEntry, YORI_LIB_INI_KEY, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&Section->KeyList, ListEntry);
+        YoriLibIniRemoveKey(Section, Key);
+    }
+
+    YoriLibFreeEmptyOpenHashTable(Section->KeyHash);
+    YoriLibOpenHashRemoveByEntry(Document->SectionHash, &Section->HashEntry);
+    YoriLibRemoveListItem(&Section->ListEntry);
+    YoriLibFreeStringContents(&Section->Name);
+    YoriLibFree(Section);
+}
+
+/**
+ Free all memory associated with a document.  Changes that have not been
+ written with @ref YoriLibIniSave are discarded.  A document that has been
+ zeroed but never loaded can also be passed here, which allows callers to
+ have a single cleanup path.
+
+ @param Document Pointer to the document to clean up.
+ */
+VOID
+YoriLibIniCleanup(
+    __inout PYORI_LIB_INI_DOCUMENT Document
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_LIB_INI_SECTION Section;
+    PYORI_LIB_INI_KEY Key;
+
+    if (Document->SectionHash != NULL) {
+        ListEntry = YoriLibGetNextListEntry(&Document->SectionList, NULL);
+        while (ListEntry != NULL) {
+            Section = CONTAINING_RECORD(ListEntry, YORI_LIB_INI_SECTION, ListEntry);
+            ListEntry = YoriLibGetNextListEntry(&Document->SectionList, ListEntry);
+            YoriLibIniRemoveSection(Document, Section);
+        }
+
+        YoriLibFreeEmptyOpenHashTable(Document->SectionHash);
+        Document->SectionHash = NULL;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&Document->PreambleList, NULL);
+    while (ListEntry != NULL) {
+        Key = CONTAINING_RECORD(ListEntry, YORI_LIB_INI_KEY, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&Document->PreambleList, ListEntry);
+        YoriLibRemoveListItem(&Key->ListEntry);
+        YoriLibIniFreeKey(Key);
+    }
+
+    YoriLibFreeStringContents(&Document->FilePath);
+}
+
+/**
+ Add a new, empty section to the end of a document.
+
+ @param Document Pointer to the document.
+
+ @param Name Pointer to the name of the section.  This is referenced by the
+        section rather than copied, and must be NULL terminated.
+
+ @return Pointer to the new section, or NULL on allocation failure.
+ */
+PYORI_LIB_INI_SECTION
+YoriLibIniAddSection(
+    __inout PYORI_LIB_INI_DOCUMENT Document,
+    __in PYORI_STRING Name
+    )
+{
+    PYORI_LIB_INI_SECTION Section;
+
+    Section = YoriLibMalloc(sizeof(YORI_LIB_INI_SECTION));
+    if (Section == NULL) {
+        return NULL;
+    }
+
+    ZeroMemory(Section, sizeof(YORI_LIB_INI_SECTION));
+    Section->KeyHash = YoriLibAllocateOpenHashTable(0);
+    if (Section->KeyHash == NULL) {
+        YoriLibFree(Section);
+        return NULL;
+    }
+
+    if (!YoriLibOpenHashInsertByKey(Document->SectionHash, Name, Section, &Section->HashEntry)) {
+        YoriLibFreeEmptyOpenHashTable(Section->KeyHash);
+        YoriLibFree(Section);
+        return NULL;
+    }
+
+    YoriLibCloneString(&Section->Name, Name);
+    YoriLibInitializeListHead(&Section->KeyList);
+    YoriLibAppendList(&Document->SectionList, &Section->ListEntry);
+    return Section;
+}
+
+/**
+ Allocate a line within a section.  The name and value are referenced by
+ the line rather than copied.  If the line is a key, it is inserted into
+ the section's hash table, but the caller is responsible for inserting it
+ into a list.
+
+ @param Section Pointer to the section that will contain the line.
+
+ @param Name Pointer to the name of the key.  For lines that are not keys,
+        this should be empty.  This must be NULL terminated.
+
+ @param Value Pointer to the value of the key, or for lines that are not
+        keys, the text of the line.  This must be NULL terminated.
+
+ @param Verbatim TRUE if the line is not a key, FALSE if it is.
+
+ @return Pointer to the newly allocated line, or NULL on allocation failure.
+ */
+PYORI_LIB_INI_KEY
+YoriLibIniAllocateKey(
+    __in_opt PYORI_LIB_INI_SECTION Section,
+    __in PYORI_STRING Name,
+    __in PYORI_STRING Value,
+    __in BOOLEAN Verbatim
+    )
+{
+    PYORI_LIB_INI_KEY Key;
+
+    Key = YoriLibMalloc(sizeof(YORI_LIB_INI_KEY));
+    if (Key == NULL) {
+        return NULL;
+    }
+
+    ZeroMemory(Key, sizeof(YORI_LIB_INI_KEY));
+    Key->Verbatim = Verbatim;
+    if (!Verbatim) {
+        ASSERT(Section != NULL);
+        if (!YoriLibOpenHashInsertByKey(Section->KeyHash, Name, Key, &Key->HashEntry)) {
+            YoriLibFree(Key);
+            return NULL;
+        }
+    }
+
+    YoriLibCloneString(&Key->Name, Name);
+    YoriLibCloneString(&Key->Value, Value);
+    return Key;
+}
+
+/**
+ Return TRUE if a character is whitespace that is removed from the start
+ and end of names and values.
+
+ @param Char The character to check.
+
+ @return TRUE if the character is whitespace, FALSE if it is not.
+ */
+BOOLEAN
+YoriLibIniIsSpace(
+    __in TCHAR Char
+    )
+{
+    if (Char == ' ' || Char == '\t') {
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/**
+ Initialize a string to describe a range of the text of a document, and
+ terminate the range so the string can be used as a NULL terminated
+ string.  The string does not hold a reference on the text; the caller is
+ expected to clone it.
+
+ @param String On completion, populated to describe the range.
+
+ @param Text Pointer to the referenced allocation containing the text.
+
+ @param Start The offset of the first character in the range.
+
+ @param End The offset of the character following the range.  This
+        character is overwritten with a NULL terminator.
+ */
+VOID
+YoriLibIniDescribeRange(
+    __out PYORI_STRING String,
+    __in LPTSTR Text,
+    __in YORI_ALLOC_SIZE_T Start,
+    __in YORI_ALLOC_SIZE_T End
+    )
+{
+    String->MemoryToFree = Text;
+    String->StartOfString = &Text[Start];
+    String->LengthInChars = End - Start;
+    String->LengthAllocated = End - Start + 1;
+    Text[End] = '\0';
+}
+
+/**
+ Parse the text of an INI file into a document.  The text is modified so
+ that each name and value within it is NULL terminated, and the document
+ references the text rather than copying it.
+
+ Lines that are not section headers or keys, such as comments and blank
+ lines, are retained so the file can be written back without losing them.
+ A key whose name has already been seen in its section is retained in the
+ same way, since only the first instance can be found.  If a section header
+ is repeated, the keys that follow it are combined into the first instance.
+
+ @param Document Pointer to the document to populate.
+
+ @param Text Pointer to a referenced allocation containing the text.  This
+        must contain one character beyond Length, which is overwritten.
+
+ @param Length The number of characters of text.
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.
+ */
+__success(return)
+BOOL
+YoriLibIniParse(
+    __inout PYORI_LIB_INI_DOCUMENT Document,
+    __in LPTSTR Text,
+    __in YORI_ALLOC_SIZE_T Length
+    )
+{
+    PYORI_LIB_INI_SECTION Section;
+    PYORI_LIB_INI_KEY Key;
+    PYORI_OPEN_HASH_ENTRY HashEntry;
+    YORI_STRING Name;
+    YORI_STRING Value;
+    YORI_ALLOC_SIZE_T LineStart;
+    YORI_ALLOC_SIZE_T LineEnd;
+    YORI_ALLOC_SIZE_T NextLine;
+    YORI_ALLOC_SIZE_T Start;
+    YORI_ALLOC_SIZE_T End;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T NameEnd;
+    YORI_ALLOC_SIZE_T ValueStart;
+    YORI_ALLOC_SIZE_T ValueEnd;
+    BOOLEAN IsKey;
+
+    Section = NULL;
+    LineStart = 0;
+    while (LineStart < Length) {
+
+        LineEnd = LineStart;
+        while (LineEnd < Length && Text[LineEnd] != '\r' && Text[LineEnd] != '\n') {
+            LineEnd++;
+        }
+
+        NextLine = LineEnd;
+        if (NextLine < Length && Text[NextLine] == '\r') {
+            NextLine++;
+        }
+        if (NextLine < Length && Text[NextLine] == '\n') {
+            NextLine++;
+        }
+
+        Start = LineStart;
+        while (Start < LineEnd && YoriLibIniIsSpace(Text[Start])) {
+            Start++;
+        }
+
+        End = LineEnd;
+        while (End > Start && YoriLibIniIsSpace(Text[End - 1])) {
+            End--;
+        }
+
+        //
+        //  Check for a section header.  Any text following the closing
+        //  bracket is ignored.
+        //
+
+        if (Start < End && Text[Start] == '[') {
+            for (Index = Start + 1; Index < End; Index++) {
+                if (Text[Index] == ']') {
+                    break;
+                }
+            }
+
+            if (Index < End) {
+                Start++;
+                while (Start < Index && YoriLibIniIsSpace(Text[Start])) {
+                    Start++;
+                }
+                while (Index > Start && YoriLibIniIsSpace(Text[Index - 1])) {
+                    Index--;
+                }
+
+                YoriLibIniDescribeRange(&Name, Text, Start, Index);
+                HashEntry = YoriLibOpenHashLookupByKey(Document->SectionHash, &Name);
+                if (HashEntry != NULL) {
+                    Section = HashEntry->Context;
+                } else {
+                    Section = YoriLibIniAddSection(Document, &Name);
+                    if (Section == NULL) {
+                        return FALSE;
+                    }
+                }
+
+                LineStart = NextLine;
+                continue;
+            }
+        }
+
+        //
+        //  Check for a key.  The value may be enclosed in quotes, which are
+        //  removed.
+        //
+
+        IsKey = FALSE;
+        NameEnd = Start;
+        ValueStart = End;
+        ValueEnd = End;
+        if (Section != NULL && Start < End && Text[Start] != ';') {
+            for (Index = Start; Index < End; Index++) {
+                if (Text[Index] == '=') {
+                    break;
+                }
+            }
+
+            if (Index < End) {
+                NameEnd = Index;
+                while (NameEnd > Start && YoriLibIniIsSpace(Text[NameEnd - 1])) {
+                    NameEnd--;
+                }
+
+                ValueStart = Index + 1;
+                while (ValueStart < End && YoriLibIniIsSpace(Text[ValueStart])) {
+                    ValueStart++;
+                }
+
+                if (End - ValueStart >= 2 &&
+                    (Text[ValueStart] == '"' || Text[ValueStart] == '\'') &&
+                    Text[End - 1] == Text[ValueStart]) {
+
+                    ValueStart++;
+                    ValueEnd = End - 1;
+                }
+
+                if (NameEnd > Start) {
+                    Name.MemoryToFree = NULL;
+                    Name.StartOfString = &Text[Start];
+                    Name.LengthInChars = NameEnd - Start;
+                    Name.LengthAllocated = Name.LengthInChars;
+                    if (YoriLibOpenHashLookupByKey(Section->KeyHash, &Name) == NULL) {
+                        IsKey = TRUE;
+                    }
+                }
+            }
+        }
+
+        if (IsKey) {
+            YoriLibIniDescribeRange(&Name, Text, Start, NameEnd);
+            YoriLibIniDescribeRange(&Value, Text, ValueStart, ValueEnd);
+        } else {
+            YoriLibInitEmptyString(&Name);
+            YoriLibIniDescribeRange(&Value, Text, LineStart, LineEnd);
+        }
+
+        Key = YoriLibIniAllocateKey(Section, &Name, &Value, (BOOLEAN)!IsKey);
+        if (Key == NULL) {
+            return FALSE;
+        }
+
+        if (Section != NULL) {
+            YoriLibAppendList(&Section->KeyList, &Key->ListEntry);
+        } else {
+            YoriLibAppendList(&Document->PreambleList, &Key->ListEntry);
+        }
+
+        LineStart = NextLine;
+    }
+
+    return TRUE;
+}
+
+/**
+ Load an INI file into a document.  The file is read and decoded once, and
+ every section and key within it is indexed so that later lookups do not
+ need to scan the file.  If the file does not exist, the document is empty,
+ and saving it will create the file.
+
+ @param Document Pointer to the document to initialize.  On success, the
+        caller should free it with @ref YoriLibIniCleanup .
+
+ @param FilePath Pointer to the full path to the INI file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibIniLoad(
+    __out PYORI_LIB_INI_DOCUMENT Document,
+    __in PCYORI_STRING FilePath
+    )
+{
+    HANDLE FileHandle;
+    PUCHAR Buffer;
+    LPTSTR Text;
+    DWORD FileSizeHigh;
+    DWORD FileSize;
+    DWORD BytesRead;
+    DWORD BytesToRead;
+    DWORD TotalRead;
+    DWORD Err;
+    DWORD BomLength;
+    YORI_ALLOC_SIZE_T Length;
+    BOOL Result;
+
+    ZeroMemory(Document, sizeof(YORI_LIB_INI_DOCUMENT));
+    YoriLibInitializeListHead(&Document->PreambleList);
+    YoriLibInitializeListHead(&Document->SectionList);
+    Document->Encoding = CP_ACP;
+
+    Document->SectionHash = YoriLibAllocateOpenHashTable(0);
+    if (Document->SectionHash == NULL) {
+        return FALSE;
+    }
+
+    if (!YoriLibCopyString(&Document->FilePath, FilePath)) {
+        YoriLibIniCleanup(Document);
+        return FALSE;
+    }
+
+    FileHandle = CreateFile(Document->FilePath.StartOfString,
+                            GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL,
+                            NULL);
+
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        Err = GetLastError();
+        if (Err == ERROR_FILE_NOT_FOUND) {
+            return TRUE;
+        }
+        YoriLibIniCleanup(Document);
+        SetLastError(Err);
+        return FALSE;
+    }
+
+    FileSize = GetFileSize(FileHandle, &FileSizeHigh);
+    if (FileSizeHigh != 0 || !YoriLibIsSizeAllocatable(FileSize)) {
+        CloseHandle(FileHandle);
+        YoriLibIniCleanup(Document);
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return FALSE;
+    }
+
+    if (FileSize == 0) {
+        CloseHandle(FileHandle);
+        return TRUE;
+    }
+
+    Buffer = YoriLibMalloc((YORI_ALLOC_SIZE_T)FileSize);
+    if (Buffer == NULL) {
+        CloseHandle(FileHandle);
+        YoriLibIniCleanup(Document);
+        return FALSE;
+    }
+
+    TotalRead = 0;
+    while (TotalRead < FileSize) {
+        BytesToRead = FileSize - TotalRead;
+        if (BytesToRead > YORI_LIB_INI_READ_SIZE) {
+            BytesToRead = YORI_LIB_INI_READ_SIZE;
+        }
+        if (!ReadFile(FileHandle, &Buffer[TotalRead], BytesToRead, &BytesRead, NULL)) {
+            Err = GetLastError();
+            CloseHandle(FileHandle);
+            YoriLibFree(Buffer);
+            YoriLibIniCleanup(Document);
+            SetLastError(Err);
+            return FALSE;
+        }
+        if (BytesRead == 0) {
+            break;
+        }
+        TotalRead = TotalRead + BytesRead;
+    }
+
+    CloseHandle(FileHandle);
+
+    //
+    //  Decode the file according to its byte order mark.  Files without a
+    //  byte order mark are in the ANSI code page, which is what the
+    //  profile functions assume.
+    //
+
+    BomLength = 0;
+    if (TotalRead >= 2 && Buffer[0] == 0xFF && Buffer[1] == 0xFE) {
+        Document->Encoding = CP_UTF16;
+        BomLength = 2;
+    } else if (TotalRead >= 3 && Buffer[0] == 0xEF && Buffer[1] == 0xBB && Buffer[2] == 0xBF) {
+        Document->Encoding = CP_UTF8;
+        BomLength = 3;
+    }
+
+    if (Document->Encoding == CP_UTF16) {
+        Length = (YORI_ALLOC_SIZE_T)((TotalRead - BomLength) / sizeof(WCHAR));
+    } else if (TotalRead > BomLength) {
+        Length = (YORI_ALLOC_SIZE_T)MultiByteToWideChar(Document->Encoding, 0, (LPCSTR)&Buffer[BomLength], TotalRead - BomLength, NULL, 0);
+    } else {
+        Length = 0;
+    }
+
+    if (!YoriLibIsSizeAllocatable(((YORI_MAX_UNSIGNED_T)Length + 1) * sizeof(TCHAR))) {
+        YoriLibFree(Buffer);
+        YoriLibIniCleanup(Document);
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return FALSE;
+    }
+
+    Text = YoriLibReferencedMalloc((Length + 1) * sizeof(TCHAR));
+    if (Text == NULL) {
+        YoriLibFree(Buffer);
+        YoriLibIniCleanup(Document);
+        return FALSE;
+    }
+
+    if (Document->Encoding == CP_UTF16) {
+        memcpy(Text, &Buffer[BomLength], Length * sizeof(TCHAR));
+    } else if (Length > 0) {
+        MultiByteToWideChar(Document->Encoding, 0, (LPCSTR)&Buffer[BomLength], TotalRead - BomLength, Text, Length);
+    }
+    Text[Length] = '\0';
+    YoriLibFree(Buffer);
+
+    Result = YoriLibIniParse(Document, Text, Length);
+    YoriLibDereference(Text);
+    if (!Result) {
+        YoriLibIniCleanup(Document);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Determine whether a value needs to be enclosed in quotes when it is
+ written.  Quotes are needed if the value would otherwise be changed when
+ it is read back, because it starts or ends with whitespace or is already
+ enclosed in quotes.
+
+ @param Value Pointer to the value.
+
+ @return TRUE if the value needs to be enclosed in quotes so that it can be
+         read back unchanged, FALSE if it can be written as is.
+ */
+BOOLEAN
+YoriLibIniValueNeedsQuotes(
+    __in PCYORI_STRING Value
+    )
+{
+    TCHAR First;
+    TCHAR Last;
+
+    if (Value->LengthInChars == 0) {
+        return FALSE;
+    }
+
+    First = Value->StartOfString[0];
+    Last = Value->StartOfString[Value->LengthInChars - 1];
+    if (YoriLibIniIsSpace(First) || YoriLibIniIsSpace(Last)) {
+        return TRUE;
+    }
+
+    if (Value->LengthInChars >= 2 &&
+        (First == '"' || First == '\'') &&
+        First == Last) {
+
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/**
+ Append a string to a buffer that is being used to generate the text of a
+ document.  If the buffer is NULL, only the length is calculated.
+
+ @param Buffer Optionally points to the buffer to append to.
+
+ @param Offset On input, the number of characters in the buffer.  On output,
+        updated to include the string.
+
+ @param String Pointer to the string to append.
+ */
+VOID
+YoriLibIniAppendText(
+    __inout_opt LPTSTR Buffer,
+    __inout PYORI_MAX_UNSIGNED_T Offset,
+    __in PCYORI_STRING String
+    )
+{
+    if (Buffer != NULL) {
+        memcpy(&Buffer[*Offset], String->StartOfString, String->LengthInChars * sizeof(TCHAR));
+    }
+    *Offset = *Offset + String->LengthInChars;
+}
+
+/**
+ Generate the text of a document.  This is called once with no buffer to
+ determine the length, and again to populate a buffer.
+
+ @param Document Pointer to the document.
+
+ @param Buffer Optionally points to a buffer to populate with the text.
+
+ @return The number of characters of text.
+ */
+YORI_MAX_UNSIGNED_T
+YoriLibIniGenerateText(
+    __in PYORI_LIB_INI_DOCUMENT Document,
+    __out_opt LPTSTR Buffer
+    )
+{
+    PYORI_LIST_ENTRY SectionEntry;
+    PYORI_LIST_ENTRY KeyEntry;
+    PYORI_LIB_INI_SECTION Section;
+    PYORI_LIB_INI_KEY Key;
+    YORI_MAX_UNSIGNED_T Offset;
+    YORI_STRING LineEnd;
+    YORI_STRING OpenBracket;
+    YORI_STRING CloseBracket;
+    YORI_STRING Equals;
+    YORI_STRING Quote;
+    BOOLEAN NeedsQuotes;
+
+    YoriLibConstantString(&LineEnd, _T("\r\n"));
+    YoriLibConstantString(&OpenBracket, _T("["));
+    YoriLibConstantString(&CloseBracket, _T("]\r\n"));
+    YoriLibConstantString(&Equals, _T("="));
+    YoriLibConstantString(&Quote, _T("\""));
+
+    Offset = 0;
+    KeyEntry = YoriLibGetNextListEntry(&Document->PreambleList, NULL);
+    while (KeyEntry != NULL) {
+        Key = CONTAINING_RECORD(KeyEntry, YORI_LIB_INI_KEY, ListEntry);
+        YoriLibIniAppendText(Buffer, &Offset, &Key->Value);
+        YoriLibIniAppendText(Buffer, &Offset, &LineEnd);
+        KeyEntry = YoriLibGetNextListEntry(&Document->PreambleList, KeyEntry);
+    }
+
+    SectionEntry = YoriLibGetNextListEntry(&Document->SectionList, NULL);
+    while (SectionEntry != NULL) {
+        Section = CONTAINING_RECORD(SectionEntry, YORI_LIB_INI_SECTION, ListEntry);
+        YoriLibIniAppendText(Buffer, &Offset, &OpenBracket);
+        YoriLibIniAppendText(Buffer, &Offset, &Section->Name);
+        YoriLibIniAppendText(Buffer, &Offset, &CloseBracket);
+
+        KeyEntry = YoriLibGetNextListEntry(&Section->KeyList, NULL);
+        while (KeyEntry != NULL) {
+            Key = CONTAINING_RECORD(KeyEntry, YORI_LIB_INI_KEY, ListEntry);
+            if (Key->Verbatim) {
+                YoriLibIniAppendText(Buffer, &Offset, &Key->Value);
+            } else {
+                NeedsQuotes = YoriLibIniValueNeedsQuotes(&Key->Value);
+                YoriLibIniAppendText(Buffer, &Offset, &Key->Name);
+                YoriLibIniAppendText(Buffer, &Offset, &Equals);
+                if (NeedsQuotes) {
+                    YoriLibIniAppendText(Buffer, &Offset, &Quote);
+                }
+                YoriLibIniAppendText(Buffer, &Offset, &Key->Value);
+                if (NeedsQuotes) {
+                    YoriLibIniAppendText(Buffer, &Offset, &Quote);
+                }
+            }
+            YoriLibIniAppendText(Buffer, &Offset, &LineEnd);
+            KeyEntry = YoriLibGetNextListEntry(&Section->KeyList, KeyEntry);
+        }
+
+        SectionEntry = YoriLibGetNextListEntry(&Document->SectionList, SectionEntry);
+    }
+
+    return Offset;
+}
+
+/**
+ Write a document back to the file it was loaded from, if it has been
+ modified.  The complete file is written to a temporary file in the same
+ directory, which then replaces the original, so the file is either
+ entirely updated or left unchanged.  The file retains the encoding it was
+ loaded with.
+
+ @param Document Pointer to the document to save.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibIniSave(
+    __inout PYORI_LIB_INI_DOCUMENT Document
+    )
+{
+    YORI_MAX_UNSIGNED_T Length;
+    YORI_ALLOC_SIZE_T BomLength;
+    YORI_ALLOC_SIZE_T BytesNeeded;
+    YORI_STRING Directory;
+    YORI_STRING Prefix;
+    YORI_STRING TempFileName;
+    LPTSTR FinalSeperator;
+    LPTSTR Text;
+    PUCHAR Buffer;
+    HANDLE TempHandle;
+    DWORD BytesWritten;
+    DWORD Err;
+
+    if (!Document->Modified) {
+        return TRUE;
+    }
+
+    Length = YoriLibIniGenerateText(Document, NULL);
+    if (!YoriLibIsSizeAllocatable(Length * sizeof(TCHAR))) {
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return FALSE;
+    }
+
+    Text = YoriLibMalloc((YORI_ALLOC_SIZE_T)(Length * sizeof(TCHAR) + sizeof(TCHAR)));
+    if (Text == NULL) {
+        return FALSE;
+    }
+
+    YoriLibIniGenerateText(Document, Text);
+
+    //
+    //  Encode the text, preceded by a byte order mark if the file had one.
+    //
+
+    BomLength = 0;
+    if (Document->Encoding == CP_UTF16) {
+        BomLength = 2;
+        BytesNeeded = (YORI_ALLOC_SIZE_T)(Length * sizeof(WCHAR));
+    } else {
+        if (Document->Encoding == CP_UTF8) {
+            BomLength = 3;
+        }
+        BytesNeeded = 0;
+        if (Length > 0) {
+            BytesNeeded = (YORI_ALLOC_SIZE_T)WideCharToMultiByte(Document->Encoding, 0, Text, (YORI_ALLOC_SIZE_T)Length, NULL, 0, NULL, NULL);
+        }
+    }
+
+    if (!YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)BytesNeeded + BomLength)) {
+        YoriLibFree(Text);
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return FALSE;
+    }
+
+    Buffer = YoriLibMalloc(BytesNeeded + BomLength);
+    if (Buffer == NULL) {
+        YoriLibFree(Text);
+        return FALSE;
+    }
+
+    if (Document->Encoding == CP_UTF16) {
+        Buffer[0] = 0xFF;
+        Buffer[1] = 0xFE;
+        memcpy(&Buffer[BomLength], Text, BytesNeeded);
+    } else {
+        if (Document->Encoding == CP_UTF8) {
+            Buffer[0] = 0xEF;
+            Buffer[1] = 0xBB;
+            Buffer[2] = 0xBF;
+        }
+        if (BytesNeeded > 0) {
+            WideCharToMultiByte(Document->Encoding, 0, Text, (YORI_ALLOC_SIZE_T)Length, (LPSTR)&Buffer[BomLength], BytesNeeded, NULL, NULL);
+        }
+    }
+    YoriLibFree(Text);
+
+    //
+    //  Write the new contents alongside the file so that the final rename
+    //  stays within a single volume.
+    //
+
+    YoriLibInitEmptyString(&Directory);
+    FinalSeperator = YoriLibFindRightMostCharacter(&Document->FilePath, '\\');
+    if (FinalSeperator != NULL) {
+        Directory.StartOfString = Document->FilePath.StartOfString;
+        Directory.LengthInChars = (YORI_ALLOC_SIZE_T)(FinalSeperator - Document->FilePath.StartOfString);
+    } else {
+        YoriLibConstantString(&Directory, _T("."));
+    }
+
+    YoriLibConstantString(&Prefix, _T("INI"));
+    if (!YoriLibGetTempFileName(&Directory, &Prefix, &TempHandle, &TempFileName)) {
+        Err = GetLastError();
+        YoriLibFree(Buffer);
+        SetLastError(Err);
+        return FALSE;
+    }
+
+    if (!WriteFile(TempHandle, Buffer, BytesNeeded + BomLength, &BytesWritten, NULL) ||
+        BytesWritten != BytesNeeded + BomLength ||
+        !FlushFileBuffers(TempHandle)) {
+
+        Err = GetLastError();
+        CloseHandle(TempHandle);
+        DeleteFile(TempFileName.StartOfString);
+        YoriLibFreeStringContents(&TempFileName);
+        YoriLibFree(Buffer);
+        SetLastError(Err);
+        return FALSE;
+    }
+
+    CloseHandle(TempHandle);
+    YoriLibFree(Buffer);
+
+    if (!MoveFileEx(TempFileName.StartOfString, Document->FilePath.StartOfString, MOVEFILE_REPLACE_EXISTING)) {
+        Err = GetLastError();
+        DeleteFile(TempFileName.StartOfString);
+        YoriLibFreeStringContents(&TempFileName);
+        SetLastError(Err);
+        return FALSE;
+    }
+
+    YoriLibFreeStringContents(&TempFileName);
+    Document->Modified = FALSE;
+    return TRUE;
+}
+
+/**
+ Find a section within a document.
+
+ @param Document Pointer to the document.
+
+ @param SectionName The name of the section.  Section names are not case
+        sensitive.
+
+ @return Pointer to the section, or NULL if the document does not contain
+         it.
+ */
+PYORI_LIB_INI_SECTION
+YoriLibIniFindSection(
+    __in PYORI_LIB_INI_DOCUMENT Document,
+    __in LPCTSTR SectionName
+    )
+{
+    PYORI_OPEN_HASH_ENTRY HashEntry;
+    YORI_STRING Name;
+
+    YoriLibConstantString(&Name, SectionName);
+    HashEntry = YoriLibOpenHashLookupByKey(Document->SectionHash, &Name);
+    if (HashEntry == NULL) {
+        return NULL;
+    }
+    return HashEntry->Context;
+}
+
+/**
+ Find a key within a section.
+
+ @param Section Pointer to the section.
+
+ @param KeyName The name of the key.  Key names are not case sensitive.
+
+ @return Pointer to the key, or NULL if the section does not contain it.
+ */
+PYORI_LIB_INI_KEY
+YoriLibIniFindKey(
+    __in PYORI_LIB_INI_SECTION Section,
+    __in LPCTSTR KeyName
+    )
+{
+    PYORI_OPEN_HASH_ENTRY HashEntry;
+    YORI_STRING Name;
+
+    YoriLibConstantString(&Name, KeyName);
+    HashEntry = YoriLibOpenHashLookupByKey(Section->KeyHash, &Name);
+    if (HashEntry == NULL) {
+        return NULL;
+    }
+    return HashEntry->Context;
+}
+
+/**
+ Find a key within a document.
+
+ @param Document Pointer to the document.
+
+ @param SectionName The name of the section containing the key.
+
+ @param KeyName The name of the key.
+
+ @return Pointer to the key, or NULL if the document does not contain it.
+ */
+PYORI_LIB_INI_KEY
+YoriLibIniFindSectionKey(
+    __in PYORI_LIB_INI_DOCUMENT Document,
+    __in LPCTSTR SectionName,
+    __in LPCTSTR KeyName
+    )
+{
+    PYORI_LIB_INI_SECTION Section;
+
+    Section = YoriLibIniFindSection(Document, SectionName);
+    if (Section == NULL) {
+        return NULL;
+    }
+    return YoriLibIniFindKey(Section, KeyName);
+}
+
+/**
+ Copy the value of a key into a caller supplied string.  If the value does
+ not fit, it is truncated.  The result is always NULL terminated, and is
+ empty if the key is not found.
+
+ @param Document Pointer to the document.
+
+ @param SectionName The name of the section containing the key.
+
+ @param KeyName The name of the key.
+
+ @param Value Pointer to a string with an allocated buffer to populate with
+        the value.
+
+ @return TRUE if the key was found, FALSE if it was not.
+ */
+__success(return)
+BOOL
+YoriLibIniGetString(
+    __in PYORI_LIB_INI_DOCUMENT Document,
+    __in LPCTSTR SectionName,
+    __in LPCTSTR KeyName,
+    __inout PYORI_STRING Value
+    )
+{
+    PYORI_LIB_INI_KEY Key;
+    YORI_ALLOC_SIZE_T Length;
+
+    Value->LengthInChars = 0;
+    if (Value->LengthAllocated > 0) {
+        Value->StartOfString[0] = '\0';
+    }
+
+    Key = YoriLibIniFindSectionKey(Document, SectionName, KeyName);
+    if (Key == NULL) {
+        return FALSE;
+    }
+
+    if (Value->LengthAllocated == 0) {
+        return TRUE;
+    }
+
+    Length = Key->Value.LengthInChars;
+    if (Length >= Value->LengthAllocated) {
+        Length = Value->LengthAllocated - 1;
+    }
+
+    memcpy(Value->StartOfString, Key->Value.StartOfString, Length * sizeof(TCHAR));
+    Value->StartOfString[Length] = '\0';
+    Value->LengthInChars = Length;
+    return TRUE;
+}
+
+/**
+ Return the value of a key as a number.  Numbers are parsed the same way as
+ the rest of Yori, so prefixes such as 0x are honored.
+
+ @param Document Pointer to the document.
+
+ @param SectionName The name of the section containing the key.
+
+ @param KeyName The name of the key.
+
+ @param Default The value to return if the key is not found or is not a
+        number.
+
+ @return The value of the key.
+ */
+DWORD
+YoriLibIniGetInt(
+    __in PYORI_LIB_INI_DOCUMENT Document,
+    __in LPCTSTR SectionName,
+    __in LPCTSTR KeyName,
+    __in DWORD Default
+    )
+{
+    PYORI_LIB_INI_KEY Key;
+    YORI_MAX_SIGNED_T Number;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+
+    Key = YoriLibIniFindSectionKey(Document, SectionName, KeyName);
+    if (Key == NULL) {
+        return Default;
+    }
+
+    if (!YoriLibStringToNumber(&Key->Value, FALSE, &Number, &CharsConsumed) ||
+        CharsConsumed == 0) {
+
+        return Default;
+    }
+
+    return (DWORD)Number;
+}
+
+/**
+ Allocate a NULL terminated copy of a C string for use in a document.
+
+ @param String On successful completion, populated with the copy.
+
+ @param Value The string to copy.
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.
+ */
+__success(return)
+BOOL
+YoriLibIniCopyCString(
+    __out PYORI_STRING String,
+    __in LPCTSTR Value
+    )
+{
+    YORI_STRING Source;
+
+    YoriLibConstantString(&Source, Value);
+    return YoriLibCopyString(String, &Source);
+}
+
+/**
+ Set the value of a key, creating the section and key if they do not exist.
+ The document is only marked as modified if the value changes.  New keys
+ are placed after the last existing key in the section, so any comments or
+ blank lines at the end of the section remain there.
+
+ @param Document Pointer to the document.
+
+ @param SectionName The name of the section containing the key.
+
+ @param KeyName The name of the key.
+
+ @param Value The new value of the key.
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.
+ */
+__success(return)
+BOOL
+YoriLibIniSetString(
+    __inout PYORI_LIB_INI_DOCUMENT Document,
+    __in LPCTSTR SectionName,
+    __in LPCTSTR KeyName,
+    __in LPCTSTR Value
+    )
+{
+    PYORI_LIB_INI_SECTION Section;
+    PYORI_LIB_INI_KEY Key;
+    PYORI_LIST_ENTRY ListEntry;
+    YORI_STRING Name;
+    YORI_STRING NewValue;
+
+    Section = YoriLibIniFindSection(Document, SectionName);
+    if (Section == NULL) {
+        if (!YoriLibIniCopyCString(&Name, SectionName)) {
+            return FALSE;
+        }
+        Section = YoriLibIniAddSection(Document, &Name);
+        YoriLibFreeStringContents(&Name);
+        if (Section == NULL) {
+            return FALSE;
+        }
+        Document->Modified = TRUE;
+    }
+
+    Key = YoriLibIniFindKey(Section, KeyName);
+    if (Key != NULL) {
+        YoriLibConstantString(&Name, Value);
+        if (YoriLibCompareString(&Key->Value, &Name) == 0) {
+            return TRUE;
+        }
+
+        if (!YoriLibCopyString(&NewValue, &Name)) {
+            return FALSE;
+        }
+
+        YoriLibFreeStringContents(&Key->Value);
+        memcpy(&Key->Value, &NewValue, sizeof(YORI_STRING));
+        Document->Modified = TRUE;
+        return TRUE;
+    }
+
+    if (!YoriLibIniCopyCString(&Name, KeyName)) {
+        return FALSE;
+    }
+
+    if (!YoriLibIniCopyCString(&NewValue, Value)) {
+        YoriLibFreeStringContents(&Name);
+        return FALSE;
+    }
+
+    Key = YoriLibIniAllocateKey(Section, &Name, &NewValue, FALSE);
+    YoriLibFreeStringContents(&Name);
+    YoriLibFreeStringContents(&NewValue);
+    if (Key == NULL) {
+        return FALSE;
+    }
+
+    ListEntry = YoriLibGetPreviousListEntry(&Section->KeyList, NULL);
+    while (ListEntry != NULL) {
+        if (!CONTAINING_RECORD(ListEntry, YORI_LIB_INI_KEY, ListEntry)->Verbatim) {
+            break;
+        }
+        ListEntry = YoriLibGetPreviousListEntry(&Section->KeyList, ListEntry);
+    }
+
+    if (ListEntry != NULL) {
+        YoriLibInsertList(ListEntry, &Key->ListEntry);
+    } else {
+        YoriLibInsertList(&Section->KeyList, &Key->ListEntry);
+    }
+
+    Document->Modified = TRUE;
+    return TRUE;
+}
+
+/**
+ Delete a key from a document.  It is not an error if the key does not
+ exist.
+
+ @param Document Pointer to the document.
+
+ @param SectionName The name of the section containing the key.
+
+ @param KeyName The name of the key.
+ */
+VOID
+YoriLibIniDeleteKey(
+    __inout PYORI_LIB_INI_DOCUMENT Document,
+    __in LPCTSTR SectionName,
+    __in LPCTSTR KeyName
+    )
+{
+    PYORI_LIB_INI_SECTION Section;
+    PYORI_LIB_INI_KEY Key;
+
+    Section = YoriLibIniFindSection(Document, SectionName);
+    if (Section == NULL) {
+        return;
+    }
+
+    Key = YoriLibIniFindKey(Section, KeyName);
+    if (Key == NULL) {
+        return;
+    }
+
+    YoriLibIniRemoveKey(Section, Key);
+    Document->Modified = TRUE;
+}
+
+/**
+ Delete a section and every key within it from a document.  It is not an
+ error if the section does not exist.
+
+ @param Document Pointer to the document.
+
+ @param SectionName The name of the section.
+ */
+VOID
+YoriLibIniDeleteSection(
+    __inout PYORI_LIB_INI_DOCUMENT Document,
+    __in LPCTSTR SectionName
+    )
+{
+    PYORI_LIB_INI_SECTION Section;
+
+    Section = YoriLibIniFindSection(Document, SectionName);
+    if (Section == NULL) {
+        return;
+    }
+
+    YoriLibIniRemoveSection(Document, Section);
+    Document->Modified = TRUE;
+}
+
+/**
+ Return the next section in a document, in the order they appear in the
+ file.
+
+ @param Document Pointer to the document.
+
+ @param PreviousSection Pointer to the previously returned section, or NULL
+        to begin enumerating.
+
+ @return Pointer to the next section, or NULL if all sections have been
+         returned.
+ */
+PYORI_LIB_INI_SECTION
+YoriLibIniGetNextSection(
+    __in PYORI_LIB_INI_DOCUMENT Document,
+    __in_opt PYORI_LIB_INI_SECTION PreviousSection
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+
+    if (PreviousSection == NULL) {
+        ListEntry = YoriLibGetNextListEntry(&Document->SectionList, NULL);
+    } else {
+        ListEntry = YoriLibGetNextListEntry(&Document->SectionList, &PreviousSection->ListEntry);
+    }
+
+    if (ListEntry == NULL) {
+        return NULL;
+    }
+    return CONTAINING_RECORD(ListEntry, YORI_LIB_INI_SECTION, ListEntry);
+}
+
+/**
+ Return the next key in a section, in the order they appear in the file.
+ Comments and other lines that are not keys are skipped.  The previously
+ returned key can be deleted, but only after it has been used to find the
+ following key.
+
+ @param Section Pointer to the section.
+
+ @param PreviousKey Pointer to the previously returned key, or NULL to begin
+        enumerating.
+
+ @return Pointer to the next key, or NULL if all keys have been returned.
+ */
+PYORI_LIB_INI_KEY
+YoriLibIniGetNextKey(
+    __in PYORI_LIB_INI_SECTION Section,
+    __in_opt PYORI_LIB_INI_KEY PreviousKey
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_LIB_INI_KEY Key;
+
+    if (PreviousKey == NULL) {
+        ListEntry = YoriLibGetNextListEntry(&Section->KeyList, NULL);
+    } else {
+        ListEntry = YoriLibGetNextListEntry(&Section->KeyList, &PreviousKey->ListEntry);
+    }
+
+    while (ListEntry != NULL) {
+        Key = CONTAINING_RECORD(ListEntry, YORI_LIB_INI_KEY, ListEntry);
+        if (!Key->Verbatim) {
+            return Key;
+        }
+        ListEntry = YoriLibGetNextListEntry(&Section->KeyList, ListEntry);
+    }
+
+    return NULL;
+}
+
+// vim:sw=4:ts=4:et:
@@ -0,0 +1,1486 @@
+/**
+ * @file lib/linecnt.c
+ *
+ * Count lines in files without converting them to UTF16, and find the final
+ * lines of a file without reading the lines before them.
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+/**
+ Set to nonzero if the line scan should use SSE2.  SSE2 is part of the base
+ AMD64 architecture so it can be used without checking processor support.
+ 32 bit x86 builds are expected to run on processors without it.
+ */
+#if defined(_M_AMD64) && defined(_MSC_VER) && (_MSC_VER >= 1400)
+#define YORI_LIB_LINE_COUNT_SSE2 1
+#include <emmintrin.h>
+#else
+#define YORI_LIB_LINE_COUNT_SSE2 0
+#endif
+
+/**
+ The largest number of bytes to read from a stream at a time.
+ */
+#define YORI_LIB_LINE_COUNT_READ_SIZE (1024 * 1024)
+
+/**
+ The number of bytes in each range of a file that is counted by a worker
+ thread.  Files smaller than two ranges are counted on the calling thread.
+ */
+#define YORI_LIB_LINE_COUNT_RANGE_SIZE (32 * 1024 * 1024)
+
+/**
+ The number of bytes of a file that a worker thread maps at a time.  This is
+ kept small so that 32 bit processes can count large files on many threads
+ without exhausting their address space.
+ */
+#define YORI_LIB_LINE_COUNT_VIEW_SIZE (4 * 1024 * 1024)
+
+/**
+ The UTF-8 byte order mark, which is not included in the length of the first
+ line.
+ */
+CONST UCHAR YoriLibLineCountBom[] = {0xEF, 0xBB, 0xBF};
+
+/**
+ State describing a count operation that is in progress.  Data can be
+ supplied in any number of buffers, and lines and multibyte sequences can
+ span buffers.
+ */
+typedef struct _YORI_LIB_LINE_COUNT_STATE {
+
+    /**
+     The lines that have been completed so far.
+     */
+    YORI_LIB_LINE_COUNT Count;
+
+    /**
+     The number of UTF16 characters in the line that is currently being
+     counted.  This is only maintained if MeasureLines is TRUE.
+     */
+    YORI_MAX_UNSIGNED_T LineChars;
+
+    /**
+     TRUE if the length of each line should be calculated.  If FALSE, only
+     line endings are counted.
+     */
+    BOOLEAN MeasureLines;
+
+    /**
+     TRUE if bytes have been found since the previous line ending, so the
+     end of the data also ends a line.
+     */
+    BOOLEAN LineStarted;
+
+    /**
+     TRUE if the previous buffer ended in a carriage return, so a line feed
+     at the start of the next buffer is part of the same line ending.
+     */
+    BOOLEAN PendingCr;
+
+    /**
+     TRUE if data should be discarded until after the next line ending.
+     This is used when counting a range that starts in the middle of a file,
+     since the first partial line is counted by the previous range.
+     */
+    BOOLEAN SkipToLineStart;
+
+    /**
+     TRUE if counting should stop after the current line ends.  This is used
+     to complete the final line of a range that extends beyond the range.
+     */
+    BOOLEAN StopAtLineEnd;
+
+    /**
+     Set to TRUE once counting stopped because StopAtLineEnd was set.
+     */
+    BOOLEAN Stopped;
+
+    /**
+     TRUE if the data examined so far matches the start of a byte order
+     mark.
+     */
+    BOOLEAN CheckBom;
+
+    /**
+     TRUE if the first line started with a byte order mark, which should not
+     be included in its length.
+     */
+    BOOLEAN BomFound;
+
+    /**
+     The number of bytes of the byte order mark that have been matched.
+     */
+    UCHAR BomBytesMatched;
+
+    /**
+     The number of continuation bytes needed to complete the current UTF-8
+     sequence.
+     */
+    UCHAR Utf8BytesNeeded;
+
+    /**
+     The smallest value that is valid for the next continuation byte.
+     */
+    UCHAR Utf8Lower;
+
+    /**
+     The largest value that is valid for the next continuation byte.
+     */
+    UCHAR Utf8Upper;
+
+    /**
+     The number of UTF16 characters that the current UTF-8 sequence
+     generates once it is complete.
+     */
+    UCHAR Utf8CharsOnComplete;
+
+} YORI_LIB_LINE_COUNT_STATE, *PYORI_LIB_LINE_COUNT_STATE;
+
+/**
+ Context shared between threads counting ranges of a single file.
+ */
+typedef struct _YORI_LIB_LINE_COUNT_PARALLEL {
+
+    /**
+     A read only mapping of the file.
+     */
+    HANDLE Mapping;
+
+    /**
+     The offset within the file to start counting from.
+     */
+    YORI_MAX_UNSIGNED_T StartOffset;
+
+    /**
+     The size of the file.
+     */
+    YORI_MAX_UNSIGNED_T EndOffset;
+
+    /**
+     The granularity that views of the mapping must be aligned to.
+     */
+    DWORD Granularity;
+
+    /**
+     The number of ranges in the file.
+     */
+    LONG RangeCount;
+
+    /**
+     The index of the next range that has not yet been claimed by a thread.
+     */
+    LONG NextRange;
+
+    /**
+     Set to TRUE if any range could not be counted, which also causes
+     remaining ranges to be abandoned.
+     */
+    LONG Failed;
+
+    /**
+     TRUE if the length of each line should be calculated.
+     */
+    BOOLEAN MeasureLines;
+
+    /**
+     An array of RangeCount elements describing the lines that start within
+     each range.
+     */
+    PYORI_LIB_LINE_COUNT RangeResults;
+
+} YORI_LIB_LINE_COUNT_PARALLEL, *PYORI_LIB_LINE_COUNT_PARALLEL;
+
+/**
+ Prepare to count lines.
+
+ @param State Pointer to the state to initialize.
+
+ @param MeasureLines TRUE if the length of each line should be calculated.
+
+ @param StartOfStream TRUE if the data to be supplied starts at the
+        beginning of the stream, so it may start with a byte order mark.
+ */
+VOID
+YoriLibLineCountInitializeState(
+    __out PYORI_LIB_LINE_COUNT_STATE State,
+    __in BOOLEAN MeasureLines,
+    __in BOOLEAN StartOfStream
+    )
+{
+    ZeroMemory(State, sizeof(YORI_LIB_LINE_COUNT_STATE));
+    State->MeasureLines = MeasureLines;
+    if (MeasureLines && StartOfStream) {
+        State->CheckBom = TRUE;
+    }
+}
+
+/**
+ Record the end of a line.
+
+ @param State Pointer to the count state.
+ */
+VOID
+YoriLibLineCountEndLine(
+    __inout PYORI_LIB_LINE_COUNT_STATE State
+    )
+{
+    if (State->MeasureLines) {
+
+        //
+        //  An incomplete UTF-8 sequence is converted into a single
+        //  replacement character.
+        //
+
+        if (State->Utf8BytesNeeded > 0) {
+            State->LineChars++;
+            State->Utf8BytesNeeded = 0;
+        }
+
+        if (State->BomFound) {
+            State->LineChars--;
+            State->BomFound = FALSE;
+        }
+        State->CheckBom = FALSE;
+
+        if (State->Count.LineCount == 0 || State->LineChars < State->Count.ShortestLine) {
+            State->Count.ShortestLine = State->LineChars;
+        }
+        if (State->LineChars > State->Count.LongestLine) {
+            State->Count.LongestLine = State->LineChars;
+        }
+        State->Count.TotalChars = State->Count.TotalChars + State->LineChars;
+        State->LineChars = 0;
+    }
+
+    State->Count.LineCount++;
+    State->LineStarted = FALSE;
+}
+
+/**
+ Add the number of UTF16 characters generated by a buffer of UTF-8 to the
+ length of the current line.  Invalid sequences are counted as one
+ replacement character for each maximal subpart of an invalid sequence,
+ consistent with the Unicode recommendation for converting UTF-8.
+
+ @param State Pointer to the count state.
+
+ @param Buffer Pointer to the buffer, which must not contain line endings.
+
+ @param Length The number of bytes in Buffer.
+ */
+VOID
+YoriLibLineCountUtf8(
+    __inout PYORI_LIB_LINE_COUNT_STATE State,
+    __in_ecount(Length) CONST UCHAR * Buffer,
+    __in YORI_ALLOC_SIZE_T Length
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    UCHAR Char;
+
+    for (Index = 0; Index < Length; Index++) {
+        Char = Buffer[Index];
+
+        if (State->Utf8BytesNeeded > 0) {
+            if (Char >= State->Utf8Lower && Char <= State->Utf8Upper) {
+                State->Utf8BytesNeeded--;
+                State->Utf8Lower = 0x80;
+                State->Utf8Upper = 0xBF;
+                if (State->Utf8BytesNeeded == 0) {
+                    State->LineChars = State->LineChars + State->Utf8CharsOnComplete;
+                }
+                continue;
+            }
+
+            //
+            //  The sequence ended early.  It generates one replacement
+            //  character, and this byte is examined as the start of a new
+            //  sequence.
+            //
+
+            State->LineChars++;
+            State->Utf8BytesNeeded = 0;
+        }
+
+        State->Utf8Lower = 0x80;
+        State->Utf8Upper = 0xBF;
+
+        if (Char < 0x80) {
+            State->LineChars++;
+        } else if (Char >= 0xC2 && Char <= 0xDF) {
+            State->Utf8BytesNeeded = 1;
+            State->Utf8CharsOnComplete = 1;
+        } else if (Char >= 0xE0 && Char <= 0xEF) {
+            State->Utf8BytesNeeded = 2;
+            State->Utf8CharsOnComplete = 1;
+            if (Char == 0xE0) {
+                State->Utf8Lower = 0xA0;
+            } else if (Char == 0xED) {
+                State->Utf8Upper = 0x9F;
+            }
+        } else if (Char >= 0xF0 && Char <= 0xF4) {
+            State->Utf8BytesNeeded = 3;
+            State->Utf8CharsOnComplete = 2;
+            if (Char == 0xF0) {
+                State->Utf8Lower = 0x90;
+            } else if (Char == 0xF4) {
+                State->Utf8Upper = 0x8F;
+            }
+        } else {
+            State->LineChars++;
+        }
+    }
+}
+
+/**
+ Find the first carriage return or line feed in a buffer, and indicate
+ whether any bytes before it are not ASCII.
+
+ @param Buffer Pointer to the buffer to search.
+
+ @param Length The number of bytes in the buffer.
+
+ @param HighBitFound On completion, set to TRUE if any byte before the
+        returned offset has its high bit set.
+
+ @return The offset of the first line delimiter, or Length if the buffer does
+         not contain a line delimiter.
+ */
+YORI_ALLOC_SIZE_T
+YoriLibLineCountFindDelimiter(
+    __in_ecount(Length) CONST UCHAR * Buffer,
+    __in YORI_ALLOC_SIZE_T Length,
+    __out PBOOLEAN HighBitFound
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    DWORD HighBits;
+
+    Index = 0;
+    HighBits = 0;
+
+#if YORI_LIB_LINE_COUNT_SSE2
+    if (Length >= 16) {
+        __m128i Cr;
+        __m128i Lf;
+        __m128i Chars;
+        DWORD Mask;
+        DWORD High;
+
+        Cr = _mm_set1_epi8(0xD);
+        Lf = _mm_set1_epi8(0xA);
+
+        for (; Length - Index >= 16; Index = Index + 16) {
+            Chars = _mm_loadu_si128((__m128i const *)&Buffer[Index]);
+            Mask = (DWORD)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(Chars, Cr), _mm_cmpeq_epi8(Chars, Lf)));
+            High = (DWORD)_mm_movemask_epi8(Chars);
+            if (Mask != 0) {
+                while ((Mask & 1) == 0) {
+                    HighBits = HighBits | (High & 1);
+                    Mask = Mask >> 1;
+                    High = High >> 1;
+                    Index++;
+                }
+                *HighBitFound = (BOOLEAN)(HighBits != 0);
+                return Index;
+            }
+            HighBits = HighBits | High;
+        }
+    }
+#endif
+
+    for (; Index < Length; Index++) {
+        if (Buffer[Index] == 0xD || Buffer[Index] == 0xA) {
+            break;
+        }
+        HighBits = HighBits | (Buffer[Index] & 0x80);
+    }
+
+    *HighBitFound = (BOOLEAN)(HighBits != 0);
+    return Index;
+}
+
+/**
+ Count the line endings in a buffer.  A carriage return followed by a line
+ feed is a single line ending.  A carriage return at the end of the buffer
+ is counted, so the caller must not count a line feed at the start of the
+ next buffer.
+
+ @param Buffer Pointer to the buffer to search.
+
+ @param Length The number of bytes in the buffer.
+
+ @return The number of line endings in the buffer.
+ */
+YORI_MAX_UNSIGNED_T
+YoriLibLineCountEndings(
+    __in_ecount(Length) CONST UCHAR * Buffer,
+    __in YORI_ALLOC_SIZE_T Length
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    YORI_MAX_UNSIGNED_T Delimiters;
+    YORI_MAX_UNSIGNED_T Pairs;
+
+    Index = 0;
+    Delimiters = 0;
+    Pairs = 0;
+
+#if YORI_LIB_LINE_COUNT_SSE2
+
+    //
+    //  Count delimiters and CRLF pairs in byte sized counters, and add them
+    //  to the totals before any counter can overflow.  Each pair is found
+    //  by comparing the following byte, so the final byte in the buffer is
+    //  left for the loop below.
+    //
+
+    if (Length > 16) {
+        __m128i Cr;
+        __m128i Lf;
+        __m128i Zero;
+        __m128i Chars;
+        __m128i IsCr;
+        __m128i DelimiterCounts;
+        __m128i PairCounts;
+        DWORD Iterations;
+
+        Cr = _mm_set1_epi8(0xD);
+        Lf = _mm_set1_epi8(0xA);
+        Zero = _mm_setzero_si128();
+
+        while (Length - Index > 16) {
+            DelimiterCounts = _mm_setzero_si128();
+            PairCounts = _mm_setzero_si128();
+            for (Iterations = 0; Iterations < 255 && Length - Index > 16; Iterations++) {
+                Chars = _mm_loadu_si128((__m128i const *)&Buffer[Index]);
+                IsCr = _mm_cmpeq_epi8(Chars, Cr);
+                DelimiterCounts = _mm_sub_epi8(DelimiterCounts, _mm_or_si128(IsCr, _mm_cmpeq_epi8(Chars, Lf)));
+                Chars = _mm_loadu_si128((__m128i const *)&Buffer[Index + 1]);
+                PairCounts = _mm_sub_epi8(PairCounts, _mm_and_si128(IsCr, _mm_cmpeq_epi8(Chars, Lf)));
+                Index = Index + 16;
+            }
+
+            DelimiterCounts = _mm_sad_epu8(DelimiterCounts, Zero);
+            PairCounts = _mm_sad_epu8(PairCounts, Zero);
+            Delimiters = Delimiters + (DWORD)_mm_cvtsi128_si32(DelimiterCounts) + (DWORD)_mm_cvtsi128_si32(_mm_srli_si128(DelimiterCounts, 8));
+            Pairs = Pairs + (DWORD)_mm_cvtsi128_si32(PairCounts) + (DWORD)_mm_cvtsi128_si32(_mm_srli_si128(PairCounts, 8));
+        }
+    }
+#endif
+
+    for (; Index < Length; Index++) {
+        if (Buffer[Index] == 0xA) {
+            Delimiters++;
+        } else if (Buffer[Index] == 0xD) {
+            Delimiters++;
+            if (Index + 1 < Length && Buffer[Index + 1] == 0xA) {
+                Pairs++;
+            }
+        }
+    }
+
+    return Delimiters - Pairs;
+}
+
+/**
+ Count the lines in a buffer of data.
+
+ @param State Pointer to the count state.
+
+ @param Buffer Pointer to the data.
+
+ @param Length The number of bytes in Buffer.
+ */
+VOID
+YoriLibLineCountUpdate(
+    __inout PYORI_LIB_LINE_COUNT_STATE State,
+    __in_ecount(Length) CONST UCHAR * Buffer,
+    __in YORI_ALLOC_SIZE_T Length
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T Offset;
+    BOOLEAN HighBitFound;
+    UCHAR LastChar;
+
+    for (Index = 0; State->CheckBom && Index < Length; Index++) {
+        if (Buffer[Index] != YoriLibLineCountBom[State->BomBytesMatched]) {
+            State->CheckBom = FALSE;
+        } else {
+            State->BomBytesMatched++;
+            if (State->BomBytesMatched == sizeof(YoriLibLineCountBom)) {
+                State->BomFound = TRUE;
+                State->CheckBom = FALSE;
+            }
+        }
+    }
+
+    Index = 0;
+    if (State->SkipToLineStart) {
+        Offset = YoriLibLineCountFindDelimiter(Buffer, Length, &HighBitFound);
+        if (Offset == Length) {
+            return;
+        }
+        State->SkipToLineStart = FALSE;
+        if (Buffer[Offset] == 0xD) {
+            State->PendingCr = TRUE;
+        }
+        Index = Offset + 1;
+    }
+
+    if (State->PendingCr && Index < Length) {
+        State->PendingCr = FALSE;
+        if (Buffer[Index] == 0xA) {
+            Index++;
+        }
+    }
+
+    if (Index == Length) {
+        return;
+    }
+
+    //
+    //  If line lengths are not needed, count line endings in bulk and
+    //  determine whether the buffer ended within a line.
+    //
+
+    if (!State->MeasureLines && !State->StopAtLineEnd) {
+        State->Count.LineCount = State->Count.LineCount + YoriLibLineCountEndings(&Buffer[Index], Length - Index);
+        LastChar = Buffer[Length - 1];
+        if (LastChar == 0xD) {
+            State->PendingCr = TRUE;
+            State->LineStarted = FALSE;
+        } else if (LastChar == 0xA) {
+            State->LineStarted = FALSE;
+        } else {
+            State->LineStarted = TRUE;
+        }
+        return;
+    }
+
+    //
+    //  Find each line.  Lines containing only ASCII have one character per
+    //  byte, so only lines with other bytes need to be decoded.
+    //
+
+    while (Index < Length) {
+        Offset = YoriLibLineCountFindDelimiter(&Buffer[Index], Length - Index, &HighBitFound);
+        if (Offset > 0) {
+            State->LineStarted = TRUE;
+            if (State->MeasureLines) {
+                if (HighBitFound || State->Utf8BytesNeeded > 0) {
+                    YoriLibLineCountUtf8(State, &Buffer[Index], Offset);
+                } else {
+                    State->LineChars = State->LineChars + Offset;
+                }
+            }
+        }
+
+        Index = Index + Offset;
+        if (Index == Length) {
+            break;
+        }
+
+        YoriLibLineCountEndLine(State);
+        if (Buffer[Index] == 0xD) {
+            Index++;
+            if (Index == Length) {
+                State->PendingCr = TRUE;
+            } else if (Buffer[Index] == 0xA) {
+                Index++;
+            }
+        } else {
+            Index++;
+        }
+
+        if (State->StopAtLineEnd) {
+            State->Stopped = TRUE;
+            break;
+        }
+    }
+}
+
+/**
+ Complete counting lines once all data has been supplied.  If the data did
+ not end with a line ending, the final partial line is counted.
+
+ @param State Pointer to the count state.
+ */
+VOID
+YoriLibLineCountFinalize(
+    __inout PYORI_LIB_LINE_COUNT_STATE State
+    )
+{
+    if (State->LineStarted) {
+        YoriLibLineCountEndLine(State);
+    }
+}
+
+/**
+ Combine the lines counted in one part of a file into the result for the
+ entire file.
+
+ @param LineCount Pointer to the result for the entire file.
+
+ @param RangeCount Pointer to the result for a part of the file.
+ */
+VOID
+YoriLibLineCountMerge(
+    __inout PYORI_LIB_LINE_COUNT LineCount,
+    __in PYORI_LIB_LINE_COUNT RangeCount
+    )
+{
+    if (RangeCount->LineCount == 0) {
+        return;
+    }
+
+    if (LineCount->LineCount == 0 || RangeCount->ShortestLine < LineCount->ShortestLine) {
+        LineCount->ShortestLine = RangeCount->ShortestLine;
+    }
+    if (RangeCount->LongestLine > LineCount->LongestLine) {
+        LineCount->LongestLine = RangeCount->LongestLine;
+    }
+    LineCount->LineCount = LineCount->LineCount + RangeCount->LineCount;
+    LineCount->TotalChars = LineCount->TotalChars + RangeCount->TotalChars;
+}
+
+/**
+ Count lines in a part of a mapped file.  Views of the file are mapped one
+ at a time.
+
+ @param Parallel Pointer to the context describing the mapped file.
+
+ @param State Pointer to the count state.
+
+ @param Offset The offset within the file of the first byte to count.
+
+ @param EndOffset The offset within the file to stop counting.  Counting
+        may stop earlier if the state indicates it should stop at the end of
+        the current line.
+
+ @return TRUE to indicate success, FALSE if a view could not be mapped or
+         the operation was cancelled.
+ */
+__success(return)
+BOOLEAN
+YoriLibLineCountMappedRange(
+    __in PYORI_LIB_LINE_COUNT_PARALLEL Parallel,
+    __inout PYORI_LIB_LINE_COUNT_STATE State,
+    __in YORI_MAX_UNSIGNED_T Offset,
+    __in YORI_MAX_UNSIGNED_T EndOffset
+    )
+{
+    YORI_MAX_UNSIGNED_T ViewOffset;
+    YORI_MAX_UNSIGNED_T ViewLength;
+    YORI_MAX_UNSIGNED_T BytesToCount;
+    PUCHAR View;
+
+    while (Offset < EndOffset && !State->Stopped) {
+        ViewOffset = Offset - (Offset % Parallel->Granularity);
+        ViewLength = YORI_LIB_LINE_COUNT_VIEW_SIZE;
+        if (ViewLength > Parallel->EndOffset - ViewOffset) {
+            ViewLength = Parallel->EndOffset - ViewOffset;
+        }
+
+        BytesToCount = ViewOffset + ViewLength - Offset;
+        if (BytesToCount > EndOffset - Offset) {
+            BytesToCount = EndOffset - Offset;
+        }
+
+        View = MapViewOfFile(Parallel->Mapping,
+                             FILE_MAP_READ,
+                             (DWORD)(ViewOffset >> 32),
+                             (DWORD)ViewOffset,
+                             (SIZE_T)ViewLength);
+        if (View == NULL) {
+            return FALSE;
+        }
+
+        YoriLibLineCountUpdate(State, View + (DWORD)(Offset - ViewOffset), (YORI_ALLOC_SIZE_T)BytesToCount);
+        UnmapViewOfFile(View);
+        Offset = Offset + BytesToCount;
+
+        if (Parallel->Failed || YoriLibIsOperationCancelled()) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Count the lines that start within a single range of a mapped file.  A line
+ that starts before the range is counted by the previous range, and a line
+ that starts within the range but ends after it is counted by this range.
+
+ @param Parallel Pointer to the context describing the mapped file.
+
+ @param RangeIndex The index of the range to count.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriLibLineCountProcessRange(
+    __in PYORI_LIB_LINE_COUNT_PARALLEL Parallel,
+    __in LONG RangeIndex
+    )
+{
+    YORI_LIB_LINE_COUNT_STATE State;
+    YORI_MAX_UNSIGNED_T RangeStart;
+    YORI_MAX_UNSIGNED_T RangeEnd;
+
+    RangeStart = Parallel->StartOffset + (YORI_MAX_UNSIGNED_T)RangeIndex * YORI_LIB_LINE_COUNT_RANGE_SIZE;
+    RangeEnd = RangeStart + YORI_LIB_LINE_COUNT_RANGE_SIZE;
+    if (RangeEnd > Parallel->EndOffset) {
+        RangeEnd = Parallel->EndOffset;
+    }
+
+    YoriLibLineCountInitializeState(&State, Parallel->MeasureLines, (BOOLEAN)(RangeIndex == 0));
+
+    //
+    //  Lines after the first start immediately after a line ending, so
+    //  start counting after the first line ending found from the byte
+    //  before the range.  If that byte is a carriage return, a line feed
+    //  at the start of the range is part of the same line ending.
+    //
+
+    if (RangeIndex > 0) {
+        State.SkipToLineStart = TRUE;
+        RangeStart--;
+    }
+
+    if (!YoriLibLineCountMappedRange(Parallel, &State, RangeStart, RangeEnd)) {
+        return FALSE;
+    }
+
+    if (State.LineStarted) {
+        State.StopAtLineEnd = TRUE;
+        if (!YoriLibLineCountMappedRange(Parallel, &State, RangeEnd, Parallel->EndOffset)) {
+            return FALSE;
+        }
+    }
+
+    YoriLibLineCountFinalize(&State);
+    memcpy(&Parallel->RangeResults[RangeIndex], &State.Count, sizeof(YORI_LIB_LINE_COUNT));
+    return TRUE;
+}
+
+/**
+ A worker thread which counts ranges of a mapped file until no ranges
+ remain.
+
+ @param Context Pointer to the context describing the mapped file.
+
+ @return DWORD, ignored.
+ */
+DWORD WINAPI
+YoriLibLineCountWorker(
+    __in LPVOID Context
+    )
+{
+    PYORI_LIB_LINE_COUNT_PARALLEL Parallel;
+    LONG RangeIndex;
+
+    Parallel = (PYORI_LIB_LINE_COUNT_PARALLEL)Context;
+    while (Parallel->Failed == FALSE) {
+        RangeIndex = InterlockedIncrement(&Parallel->NextRange) - 1;
+        if (RangeIndex >= Parallel->RangeCount) {
+            break;
+        }
+
+        if (!YoriLibLineCountProcessRange(Parallel, RangeIndex)) {
+            InterlockedExchange(&Parallel->Failed, TRUE);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ Count lines in a file by mapping it and counting ranges of it on multiple
+ threads.
+
+ @param FileHandle Handle to the file.
+
+ @param StartOffset The offset within the file to start counting from.
+
+ @param FileSize The size of the file.
+
+ @param MeasureLines TRUE if the length of each line should be calculated.
+
+ @param LineCount On successful completion, populated with the number of
+        lines and their lengths.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibCountLinesParallel(
+    __in HANDLE FileHandle,
+    __in YORI_MAX_UNSIGNED_T StartOffset,
+    __in YORI_MAX_UNSIGNED_T FileSize,
+    __in BOOLEAN MeasureLines,
+    __out PYORI_LIB_LINE_COUNT LineCount
+    )
+{
+    YORI_LIB_LINE_COUNT_PARALLEL Parallel;
+    SYSTEM_INFO SystemInfo;
+    HANDLE WorkerThreads[MAXIMUM_WAIT_OBJECTS];
+    YORI_MAX_UNSIGNED_T RangeCount;
+    DWORD WorkerCount;
+    DWORD WorkerIndex;
+    DWORD ThreadId;
+    LONG RangeIndex;
+
+    ZeroMemory(&Parallel, sizeof(Parallel));
+
+    RangeCount = (FileSize - StartOffset + YORI_LIB_LINE_COUNT_RANGE_SIZE - 1) / YORI_LIB_LINE_COUNT_RANGE_SIZE;
+    if (!YoriLibIsSizeAllocatable(RangeCount * sizeof(YORI_LIB_LINE_COUNT))) {
+        return FALSE;
+    }
+
+    Parallel.RangeResults = YoriLibMalloc((YORI_ALLOC_SIZE_T)RangeCount * sizeof(YORI_LIB_LINE_COUNT));
+    if (Parallel.RangeResults == NULL) {
+        return FALSE;
+    }
+
+    Parallel.Mapping = CreateFileMapping(FileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (Parallel.Mapping == NULL) {
+        YoriLibFree(Parallel.RangeResults);
+        return FALSE;
+    }
+
+    GetSystemInfo(&SystemInfo);
+    Parallel.StartOffset = StartOffset;
+    Parallel.EndOffset = FileSize;
+    Parallel.Granularity = SystemInfo.dwAllocationGranularity;
+    Parallel.RangeCount = (LONG)RangeCount;
+    Parallel.MeasureLines = MeasureLines;
+
+    //
+    //  This thread counts ranges too, so start one fewer worker than the
+    //  number of processors, and don't start workers that would have no
+    //  range to count.
+    //
+
+    WorkerCount = SystemInfo.dwNumberOfProcessors;
+    if (WorkerCount > (DWORD)Parallel.RangeCount) {
+        WorkerCount = (DWORD)Parallel.RangeCount;
+    }
+    if (WorkerCount > MAXIMUM_WAIT_OBJECTS) {
+        WorkerCount = MAXIMUM_WAIT_OBJECTS;
+    }
+    if (WorkerCount > 0) {
+        WorkerCount--;
+    }
+
+    for (WorkerIndex = 0; WorkerIndex < WorkerCount; WorkerIndex++) {
+        WorkerThreads[WorkerIndex] = CreateThread(NULL, 0, YoriLibLineCountWorker, &Parallel, 0, &ThreadId);
+        if (WorkerThreads[WorkerIndex] == NULL) {
+            break;
+        }
+    }
+    WorkerCount = WorkerIndex;
+
+    YoriLibLineCountWorker(&Parallel);
+
+    for (WorkerIndex = 0; WorkerIndex < WorkerCount; WorkerIndex++) {
+        WaitForSingleObject(WorkerThreads[WorkerIndex], INFINITE);
+        CloseHandle(WorkerThreads[WorkerIndex]);
+    }
+
+    CloseHandle(Parallel.Mapping);
+
+    if (Parallel.Failed) {
+        YoriLibFree(Parallel.RangeResults);
+        return FALSE;
+    }
+
+    ZeroMemory(LineCount, sizeof(YORI_LIB_LINE_COUNT));
+    for (RangeIndex = 0; RangeIndex < Parallel.RangeCount; RangeIndex++) {
+        YoriLibLineCountMerge(LineCount, &Parallel.RangeResults[RangeIndex]);
+    }
+
+    YoriLibFree(Parallel.RangeResults);
+    return TRUE;
+}
+
+/**
+ Count lines in a stream by reading it a buffer at a time.
+
+ @param FileHandle Handle to the stream.
+
+ @param MeasureLines TRUE if the length of each line should be calculated.
+
+ @param LineCount On successful completion, populated with the number of
+        lines and their lengths.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibCountLinesSequential(
+    __in HANDLE FileHandle,
+    __in BOOLEAN MeasureLines,
+    __out PYORI_LIB_LINE_COUNT LineCount
+    )
+{
+    YORI_LIB_LINE_COUNT_STATE State;
+    YORI_ALLOC_SIZE_T BufferSize;
+    PUCHAR Buffer;
+    DWORD BytesRead;
+    DWORD FileType;
+
+    BufferSize = YoriLibMaximumAllocationInRange(64 * 1024, YORI_LIB_LINE_COUNT_READ_SIZE);
+    Buffer = YoriLibMalloc(BufferSize);
+    if (Buffer == NULL) {
+        return FALSE;
+    }
+
+    FileType = GetFileType(FileHandle);
+    YoriLibLineCountInitializeState(&State, MeasureLines, TRUE);
+
+    while (TRUE) {
+
+        //
+        //  As with the line reader, a failure to read indicates the end of
+        //  the data, which is how pipes report that the writer has closed
+        //  them.
+        //
+
+        if (!ReadFile(FileHandle, Buffer, BufferSize, &BytesRead, NULL)) {
+            break;
+        }
+
+        if (BytesRead == 0) {
+            if (FileType != FILE_TYPE_PIPE) {
+                break;
+            }
+            continue;
+        }
+
+        YoriLibLineCountUpdate(&State, Buffer, (YORI_ALLOC_SIZE_T)BytesRead);
+
+        if (YoriLibIsOperationCancelled()) {
+            YoriLibFree(Buffer);
+            return FALSE;
+        }
+    }
+
+    YoriLibFree(Buffer);
+    YoriLibLineCountFinalize(&State);
+    memcpy(LineCount, &State.Count, sizeof(YORI_LIB_LINE_COUNT));
+    return TRUE;
+}
+
+/**
+ Count lines in a stream by reading each line with the line reader.  This
+ is used for input encodings where line lengths cannot be determined from
+ the bytes in the line.  The line reader can include a carriage return at
+ the end of the stream in the final line, depending on where that line falls
+ in its buffer.  Here it always ends the final line, so results do not
+ depend on buffer alignment and match counting bytes.
+
+ @param FileHandle Handle to the stream.
+
+ @param LineCount On successful completion, populated with the number of
+        lines and their lengths.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibCountLinesWithLineReader(
+    __in HANDLE FileHandle,
+    __out PYORI_LIB_LINE_COUNT LineCount
+    )
+{
+    PVOID LineContext = NULL;
+    YORI_STRING LineString;
+    YORI_LIB_LINE_ENDING LineEnding;
+    BOOL TimeoutReached;
+
+    YoriLibInitEmptyString(&LineString);
+    ZeroMemory(LineCount, sizeof(YORI_LIB_LINE_COUNT));
+
+    while (TRUE) {
+
+        if (!YoriLibReadLineToStringEx(&LineString, &LineContext, TRUE, INFINITE, FileHandle, &LineEnding, &TimeoutReached)) {
+            break;
+        }
+
+        if (LineEnding == YoriLibLineEndingNone &&
+            LineString.LengthInChars > 0 &&
+            LineString.StartOfString[LineString.LengthInChars - 1] == '\r') {
+
+            LineString.LengthInChars--;
+        }
+
+        if (LineCount->LineCount == 0 || LineString.LengthInChars < LineCount->ShortestLine) {
+            LineCount->ShortestLine = LineString.LengthInChars;
+        }
+        if (LineString.LengthInChars > LineCount->LongestLine) {
+            LineCount->LongestLine = LineString.LengthInChars;
+        }
+        LineCount->LineCount++;
+        LineCount->TotalChars = LineCount->TotalChars + LineString.LengthInChars;
+    }
+
+    YoriLibLineReadCloseOrCache(LineContext);
+    YoriLibFreeStringContents(&LineString);
+    return TRUE;
+}
+
+/**
+ Count the lines in a stream, and optionally calculate the length of the
+ shortest, longest, and total of all lines.  Results are the same as reading
+ each line with @ref YoriLibReadLineToString , where line lengths are in
+ UTF16 characters and exclude the line ending and any byte order mark, but
+ are calculated without converting the text.  A carriage return at the end
+ of the stream is always treated as ending the final line.  Large files are mapped and
+ counted on multiple threads.
+
+ @param FileHandle Handle to the stream.  Counting starts from the current
+        position.
+
+ @param MeasureLines TRUE if the length of each line should be calculated.
+        If FALSE, only LineCount is returned, which is substantially faster.
+
+ @param LineCount On successful completion, populated with the number of
+        lines and, if requested, their lengths.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibCountLines(
+    __in HANDLE FileHandle,
+    __in BOOLEAN MeasureLines,
+    __out PYORI_LIB_LINE_COUNT LineCount
+    )
+{
+    SYSTEM_INFO SystemInfo;
+    YORI_MAX_UNSIGNED_T FileSize;
+    YORI_MAX_UNSIGNED_T Position;
+    DWORD SizeLow;
+    DWORD SizeHigh;
+    LONG PositionHigh;
+    DWORD PositionLow;
+
+    //
+    //  Line endings can only be found by examining bytes in 8 bit
+    //  encodings, and line lengths can only be determined from bytes in
+    //  UTF-8.  Anything else uses the line reader.
+    //
+
+    if (YoriLibGetMultibyteInputEncoding() != CP_UTF8) {
+        return YoriLibCountLinesWithLineReader(FileHandle, LineCount);
+    }
+
+    if (GetFileType(FileHandle) == FILE_TYPE_DISK) {
+        GetSystemInfo(&SystemInfo);
+        if (SystemInfo.dwNumberOfProcessors > 1) {
+            SizeLow = GetFileSize(FileHandle, &SizeHigh);
+            PositionHigh = 0;
+            PositionLow = SetFilePointer(FileHandle, 0, &PositionHigh, FILE_CURRENT);
+            if ((SizeLow != INVALID_FILE_SIZE || GetLastError() == NO_ERROR) &&
+                (PositionLow != INVALID_SET_FILE_POINTER || GetLastError() == NO_ERROR)) {
+
+                FileSize = ((YORI_MAX_UNSIGNED_T)SizeHigh << 32) | SizeLow;
+                Position = ((YORI_MAX_UNSIGNED_T)(DWORD)PositionHigh << 32) | PositionLow;
+                if (FileSize > Position &&
+                    FileSize - Position >= 2 * YORI_LIB_LINE_COUNT_RANGE_SIZE) {
+
+                    if (YoriLibCountLinesParallel(FileHandle, Position, FileSize, MeasureLines, LineCount)) {
+                        return TRUE;
+                    }
+
+                    if (YoriLibIsOperationCancelled()) {
+                        return FALSE;
+                    }
+                }
+            }
+        }
+    }
+
+    return YoriLibCountLinesSequential(FileHandle, MeasureLines, LineCount);
+}
+
+/**
+ The number of bytes to read at a time when searching backwards from the end
+ of a file for its final lines.
+ */
+#define YORI_LIB_LINE_COUNT_BACKWARD_BLOCK_SIZE (64 * 1024)
+
+/**
+ Find the last carriage return or line feed in a buffer of 8 bit
+ characters.
+
+ @param Buffer Pointer to the buffer to search.
+
+ @param Length The number of bytes in the buffer.
+
+ @return The offset of the last line delimiter, or Length if the buffer does
+         not contain a line delimiter.
+ */
+YORI_ALLOC_SIZE_T
+YoriLibLineCountFindLastDelimiterA(
+    __in_ecount(Length) CONST UCHAR * Buffer,
+    __in YORI_ALLOC_SIZE_T Length
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    Index = Length;
+
+#if YORI_LIB_LINE_COUNT_SSE2
+    if (Length >= 16) {
+        __m128i Cr;
+        __m128i Lf;
+        __m128i Chars;
+        DWORD Mask;
+
+        Cr = _mm_set1_epi8(0xD);
+        Lf = _mm_set1_epi8(0xA);
+
+        //
+        //  Skip blocks that contain no delimiter.  Once a block with a
+        //  delimiter is found, the loop below locates it within the block.
+        //
+
+        for (; Index >= 16; Index = Index - 16) {
+            Chars = _mm_loadu_si128((__m128i const *)&Buffer[Index - 16]);
+            Mask = (DWORD)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(Chars, Cr), _mm_cmpeq_epi8(Chars, Lf)));
+            if (Mask != 0) {
+                break;
+            }
+        }
+    }
+#endif
+
+    while (Index > 0) {
+        Index--;
+        if (Buffer[Index] == 0xD || Buffer[Index] == 0xA) {
+            return Index;
+        }
+    }
+
+    return Length;
+}
+
+/**
+ Find the last carriage return or line feed in a buffer of UTF16
+ characters.
+
+ @param Buffer Pointer to the buffer to search.
+
+ @param Length The number of characters in the buffer.
+
+ @return The offset of the last line delimiter, in characters, or Length if
+         the buffer does not contain a line delimiter.
+ */
+YORI_ALLOC_SIZE_T
+YoriLibLineCountFindLastDelimiterW(
+    __in_ecount(Length) CONST WCHAR * Buffer,
+    __in YORI_ALLOC_SIZE_T Length
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    Index = Length;
+
+#if YORI_LIB_LINE_COUNT_SSE2
+    if (Length >= 8) {
+        __m128i Cr;
+        __m128i Lf;
+        __m128i Chars;
+        DWORD Mask;
+
+        Cr = _mm_set1_epi16(0xD);
+        Lf = _mm_set1_epi16(0xA);
+
+        for (; Index >= 8; Index = Index - 8) {
+            Chars = _mm_loadu_si128((__m128i const *)&Buffer[Index - 8]);
+            Mask = (DWORD)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi16(Chars, Cr), _mm_cmpeq_epi16(Chars, Lf)));
+            if (Mask != 0) {
+                break;
+            }
+        }
+    }
+#endif
+
+    while (Index > 0) {
+        Index--;
+        if (Buffer[Index] == 0xD || Buffer[Index] == 0xA) {
+            return Index;
+        }
+    }
+
+    return Length;
+}
+
+/**
+ Read a range of a file into a buffer.
+
+ @param FileHandle Handle to the file.
+
+ @param Offset The offset within the file to read from.
+
+ @param Buffer Pointer to the buffer to populate.
+
+ @param Length The number of bytes to read.
+
+ @return TRUE to indicate the entire range was read, FALSE to indicate
+         failure.
+ */
+__success(return)
+BOOL
+YoriLibLineCountReadRange(
+    __in HANDLE FileHandle,
+    __in YORI_MAX_UNSIGNED_T Offset,
+    __out_ecount(Length) PUCHAR Buffer,
+    __in YORI_ALLOC_SIZE_T Length
+    )
+{
+    LONG OffsetHigh;
+    DWORD OffsetLow;
+    DWORD BytesRead;
+    YORI_ALLOC_SIZE_T TotalRead;
+
+    OffsetHigh = (LONG)(Offset >> 32);
+    OffsetLow = SetFilePointer(FileHandle, (LONG)(DWORD)Offset, &OffsetHigh, FILE_BEGIN);
+    if (OffsetLow == INVALID_SET_FILE_POINTER && GetLastError() != NO_ERROR) {
+        return FALSE;
+    }
+
+    TotalRead = 0;
+    while (TotalRead < Length) {
+        if (!ReadFile(FileHandle, &Buffer[TotalRead], Length - TotalRead, &BytesRead, NULL)) {
+            return FALSE;
+        }
+
+        //
+        //  If the file has been truncated since its size was queried, the
+        //  blocks already examined are no longer meaningful.
+        //
+
+        if (BytesRead == 0) {
+            return FALSE;
+        }
+        TotalRead = TotalRead + (YORI_ALLOC_SIZE_T)BytesRead;
+    }
+
+    return TRUE;
+}
+
+/**
+ Find the offset within a file where its final lines begin, so that a caller
+ can display the end of a file by reading forward from that point without
+ reading everything before it.  Blocks are read backwards from the end of the
+ file and line endings are counted until enough lines have been found.
+ Lines are delimited as they are by @ref YoriLibReadLineToString , so a
+ carriage return followed by a line feed is a single line ending, and a line
+ ending at the end of the file does not begin another line.  The file is
+ interpreted as UTF16 if that is the current input encoding; all other
+ encodings are examined as bytes.
+
+ @param FileHandle Handle to the file.  This must be a file on disk, since
+        the routine seeks within it.  On successful completion, the file
+        position is set to the returned offset.
+
+ @param LineCount The number of lines to find.
+
+ @param Offset On successful completion, set to the offset in bytes of the
+        first of the final LineCount lines.  If the file contains LineCount
+        lines or fewer, this is zero.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibFindFinalLines(
+    __in HANDLE FileHandle,
+    __in YORI_MAX_UNSIGNED_T LineCount,
+    __out PYORI_MAX_UNSIGNED_T Offset
+    )
+{
+    YORI_MAX_UNSIGNED_T FileSize;
+    YORI_MAX_UNSIGNED_T BlockStart;
+    YORI_MAX_UNSIGNED_T BlockEnd;
+    YORI_MAX_UNSIGNED_T LineStart;
+    YORI_MAX_UNSIGNED_T LinesRemaining;
+    YORI_MAX_UNSIGNED_T FoundOffset;
+    YORI_ALLOC_SIZE_T BlockLength;
+    YORI_ALLOC_SIZE_T CharsInBlock;
+    YORI_ALLOC_SIZE_T CharSize;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T Delimiter;
+    PUCHAR Buffer;
+    LONG OffsetHigh;
+    DWORD OffsetLow;
+    DWORD SizeLow;
+    DWORD SizeHigh;
+    WCHAR Char;
+    WCHAR NextChar;
+    BOOLEAN Wide;
+    BOOLEAN Found;
+
+    if (GetFileType(FileHandle) != FILE_TYPE_DISK) {
+        return FALSE;
+    }
+
+    SizeLow = GetFileSize(FileHandle, &SizeHigh);
+    if (SizeLow == INVALID_FILE_SIZE && GetLastError() != NO_ERROR) {
+        return FALSE;
+    }
+
+    Wide = FALSE;
+    CharSize = sizeof(UCHAR);
+    if (YoriLibGetMultibyteInputEncoding() == CP_UTF16) {
+        Wide = TRUE;
+        CharSize = sizeof(WCHAR);
+    }
+
+    FileSize = ((YORI_MAX_UNSIGNED_T)SizeHigh << 32) | SizeLow;
+    FileSize = FileSize - (FileSize % CharSize);
+
+    Buffer = YoriLibMalloc(YORI_LIB_LINE_COUNT_BACKWARD_BLOCK_SIZE);
+    if (Buffer == NULL) {
+        return FALSE;
+    }
+
+    //
+    //  The character following each delimiter is needed to tell whether a
+    //  carriage return is followed by a line feed.  When a carriage return
+    //  is at the end of a block, the character is the first one in the
+    //  block that was examined previously.  Zero indicates the end of the
+    //  file.
+    //
+
+    FoundOffset = 0;
+    LinesRemaining = LineCount;
+    NextChar = 0;
+    BlockEnd = FileSize;
+    Found = FALSE;
+
+    if (LinesRemaining == 0) {
+        FoundOffset = FileSize;
+        Found = TRUE;
+    }
+
+    while (BlockEnd > 0 && !Found) {
+
+        BlockLength = YORI_LIB_LINE_COUNT_BACKWARD_BLOCK_SIZE;
+        if (BlockLength > BlockEnd) {
+            BlockLength = (YORI_ALLOC_SIZE_T)BlockEnd;
+        }
+        BlockStart = BlockEnd - BlockLength;
+
+        if (!YoriLibLineCountReadRange(FileHandle, BlockStart, Buffer, BlockLength)) {
+            YoriLibFree(Buffer);
+            return FALSE;
+        }
+
+        CharsInBlock = BlockLength / CharSize;
+        Index = CharsInBlock;
+
+        while (TRUE) {
+            if (Wide) {
+                Delimiter = YoriLibLineCountFindLastDelimiterW((PWCHAR)Buffer, Index);
+            } else {
+                Delimiter = YoriLibLineCountFindLastDelimiterA(Buffer, Index);
+            }
+
+            if (Delimiter == Index) {
+                break;
+            }
+
+            if (Wide) {
+                Char = ((PWCHAR)Buffer)[Delimiter];
+            } else {
+                Char = Buffer[Delimiter];
+            }
+
+            if (Char == '\r') {
+                if (Delimiter + 1 < CharsInBlock) {
+                    if (Wide) {
+                        Char = ((PWCHAR)Buffer)[Delimiter + 1];
+                    } else {
+                        Char = Buffer[Delimiter + 1];
+                    }
+                } else {
+                    Char = NextChar;
+                }
+            } else {
+                Char = 0;
+            }
+
+            //
+            //  A carriage return that is followed by a line feed does not
+            //  end a line, since the line feed does.
+            //
+
+            LineStart = BlockStart + (Delimiter + 1) * CharSize;
+            if (Char != '\n' && LineStart < FileSize) {
+                LinesRemaining--;
+                if (LinesRemaining == 0) {
+                    FoundOffset = LineStart;
+                    Found = TRUE;
+                    break;
+                }
+            }
+
+            Index = Delimiter;
+        }
+
+        if (Wide) {
+            NextChar = ((PWCHAR)Buffer)[0];
+        } else {
+            NextChar = Buffer[0];
+        }
+        BlockEnd = BlockStart;
+
+        if (YoriLibIsOperationCancelled()) {
+            YoriLibFree(Buffer);
+            return FALSE;
+        }
+    }
+
+    YoriLibFree(Buffer);
+
+    OffsetHigh = (LONG)(FoundOffset >> 32);
+    OffsetLow = SetFilePointer(FileHandle, (LONG)(DWORD)FoundOffset, &OffsetHigh, FILE_BEGIN);
+    if (OffsetLow == INVALID_SET_FILE_POINTER && GetLastError() != NO_ERROR) {
+        return FALSE;
+    }
+
+    *Offset = FoundOffset;
+    return TRUE;
+}
+
+// vim:sw=4:ts=4:et:
@@ -27,6 +27,18 @@
 #include "yoripch.h"
 #include "yorilib.h"
 
+/**
+ Set to nonzero if the line delimiter scan should use SSE2.  SSE2 is part of
+ the base AMD64 architecture so it can be used without checking processor
+ support.  32 bit x86 builds are expected to run on processors without it.
+ */
+#if defined(_M_AMD64) && defined(_MSC_VER) && (_MSC_VER >= 1400)
+#define YORI_LIB_LINE_SCAN_SSE2 1
+#include <emmintrin.h>
+#else
+#define YORI_LIB_LINE_SCAN_SSE2 0
+#endif
+
 /**
  Context to be passed between repeated line read calls to contain data
  that doesn't constitute a whole line but cannot be left in the incoming
@@ -380,70 +392,238 @@ YoriLibLineReadCleanupCache(VOID)
 
 
 /**
- Read a line from an input stream.
+ Find the first carriage return or line feed in a buffer of 8 bit
+ characters.
 
- @param UserString Pointer to a string to be updated to contain data for a
-        line.  This must be initialized by the caller and the caller's buffer
-        will be used if it is large enough.  If not, this function may
-        reallocate the string to point to a new buffer.
+ @param Buffer Pointer to the buffer to search.
 
- @param Context Pointer to a PVOID sized block of memory that should be
-        initialized to NULL for the first line read, and will be updated by
-        this function.
+ @param Length The number of characters in the buffer.
 
- @param ReturnFinalNonTerminatedLine If TRUE, treat any line at the end of the
-        stream without a line ending character to be a line to return.  If
-        FALSE, assume new input could arrive that means we just haven't
-        observed the line break yet.
+ @return The offset of the first line delimiter, or Length if the buffer does
+         not contain a line delimiter.
+ */
+YORI_ALLOC_SIZE_T
+YoriLibFindLineDelimiterA(
+    __in_ecount(Length) PUCHAR Buffer,
+    __in YORI_ALLOC_SIZE_T Length
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    Index = 0;
+
+#if YORI_LIB_LINE_SCAN_SSE2
+    if (Length >= 16) {
+        __m128i Cr;
+        __m128i Lf;
+        __m128i Chars;
+        DWORD Mask;
+
+        Cr = _mm_set1_epi8(0xD);
+        Lf = _mm_set1_epi8(0xA);
+
+        for (; Length - Index >= 16; Index = Index + 16) {
+            Chars = _mm_loadu_si128((__m128i const *)&Buffer[Index]);
+            Mask = (DWORD)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(Chars, Cr), _mm_cmpeq_epi8(Chars, Lf)));
+            if (Mask != 0) {
+                while ((Mask & 1) == 0) {
+                    Mask = Mask >> 1;
+                    Index++;
+                }
+                return Index;
+            }
+        }
+    }
+#endif
 
- @param MaximumDelay Specifies the maximum amount of time to wait for a
-        complete line.  This value can be INFINITE or a specified number of
-        milliseconds.  If the timeout value is reached, TimeoutReached will
-        be set to true and the function will return NULL.
+    for (; Index < Length; Index++) {
+        if (Buffer[Index] == 0xD || Buffer[Index] == 0xA) {
+            break;
+        }
+    }
 
- @param FileHandle Specifies the handle to the file to read the line from.
+    return Index;
+}
 
- @param LineEnding On successful completion, set to indicate the string of
-        characters used to terminate the line.  Can be YoriLibLineEndingNone
-        to indicate no line end was found, which can happen if
-        ReturnFinalNonTerminatedLine is TRUE or MaximumDelay is less than
-        infinite and a partial line was found.
+/**
+ Find the first carriage return or line feed in a buffer of 16 bit
+ characters.
 
- @param TimeoutReached On successful completion, set to TRUE to indicate that
-        the timeout value in MaximumDelay was reached.  If MaximumDelay is
-        INFINITE, this cannot happen.
+ @param Buffer Pointer to the buffer to search.
 
- @return Pointer to the Line buffer for success, NULL on failure.
+ @param Length The number of characters in the buffer.
+
+ @return The offset of the first line delimiter, or Length if the buffer does
+         not contain a line delimiter.
  */
-PVOID
-YoriLibReadLineToStringEx(
-    __in PYORI_STRING UserString,
-    __inout PVOID * Context,
-    __in BOOL ReturnFinalNonTerminatedLine,
-    __in DWORD MaximumDelay,
-    __in HANDLE FileHandle,
-    __out PYORI_LIB_LINE_ENDING LineEnding,
-    __out PBOOL TimeoutReached
+YORI_ALLOC_SIZE_T
+YoriLibFindLineDelimiterW(
+    __in_ecount(Length) PWCHAR Buffer,
+    __in YORI_ALLOC_SIZE_T Length
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    Index = 0;
+
+#if YORI_LIB_LINE_SCAN_SSE2
+    if (Length >= 8) {
+        __m128i Cr;
+        __m128i Lf;
+        __m128i Chars;
+        DWORD Mask;
+
+        Cr = _mm_set1_epi16(0xD);
+        Lf = _mm_set1_epi16(0xA);
+
+        for (; Length - Index >= 8; Index = Index + 8) {
+            Chars = _mm_loadu_si128((__m128i const *)&Buffer[Index]);
+            Mask = (DWORD)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi16(Chars, Cr), _mm_cmpeq_epi16(Chars, Lf)));
+            if (Mask != 0) {
+
+                //
+                //  Each matching character sets two bits in the mask.
+                //
+
+                while ((Mask & 3) == 0) {
+                    Mask = Mask >> 2;
+                    Index++;
+                }
+                return Index;
+            }
+        }
+    }
+#endif
+
+    for (; Index < Length; Index++) {
+        if (Buffer[Index] == 0xD || Buffer[Index] == 0xA) {
+            break;
+        }
+    }
+
+    return Index;
+}
+
+/**
+ Search the read buffer for the next complete line.
+
+ @param ReadContext Pointer to the line read context.
+
+ @param Offset The offset within the read buffer, in bytes, to start
+        searching from.
+
+ @param CharsInLine On successful completion, updated to contain the number
+        of characters in the line, excluding the line ending.  Note this may
+        mean 8 bit or 16 bit characters depending on input encoding.
+
+ @param CharsConsumed On successful completion, updated to contain the number
+        of characters in the line including the line ending.
+
+ @param LineEnding On successful completion, updated to contain the line
+        ending that terminated the line.
+
+ @return TRUE if a complete line was found, FALSE if more data is needed to
+         complete the line.
+ */
+__success(return)
+BOOLEAN
+YoriLibReadLineFindNextLine(
+    __in PYORI_LIB_LINE_READ_CONTEXT ReadContext,
+    __in YORI_ALLOC_SIZE_T Offset,
+    __out PYORI_ALLOC_SIZE_T CharsInLine,
+    __out PYORI_ALLOC_SIZE_T CharsConsumed,
+    __out PYORI_LIB_LINE_ENDING LineEnding
     )
 {
-    PYORI_LIB_LINE_READ_CONTEXT ReadContext;
-    YORI_ALLOC_SIZE_T Count = 0;
-    SYSERR LastError;
-    YORI_ALLOC_SIZE_T BytesToRead;
-    DWORD BytesRead;
-    YORI_ALLOC_SIZE_T CharsToCopy;
-    YORI_ALLOC_SIZE_T CharsToSkip;
-    BOOL BomFound = FALSE;
-    BOOL TerminateProcessing;
-    HANDLE HandleArray[2];
-    DWORD HandleCount;
-    DWORD WaitResult;
-    DWORD DelayTime;
     YORI_ALLOC_SIZE_T CharsRemaining;
-    DWORD CumulativeDelay;
+    YORI_ALLOC_SIZE_T Count;
     YORI_LIB_LINE_ENDING LocalLineEnding;
 
-    *TimeoutReached = FALSE;
+    ASSERT(Offset <= ReadContext->BytesInBuffer);
+
+    if (ReadContext->ReadWChars) {
+        PWCHAR WideBuffer = (PWCHAR)YoriLibAddToPointer(ReadContext->PreviousBuffer, Offset);
+        CharsRemaining = (ReadContext->BytesInBuffer - Offset) / sizeof(WCHAR);
+        Count = YoriLibFindLineDelimiterW(WideBuffer, CharsRemaining);
+        if (Count == CharsRemaining) {
+            return FALSE;
+        }
+
+        *CharsInLine = Count;
+        LocalLineEnding = YoriLibLineEndingCR;
+        if (WideBuffer[Count] == 0xD) {
+            if ((Count + 1) * sizeof(WCHAR) < (ReadContext->BytesInBuffer - Offset)) {
+                if (WideBuffer[Count + 1] == 0xA) {
+                    Count++;
+                    LocalLineEnding = YoriLibLineEndingCRLF;
+                }
+            } else if (Offset > 0) {
+
+                //
+                //  The carriage return is at the end of the buffer, so
+                //  it's not yet known whether a line feed follows.  Move
+                //  the data to the front of the buffer and look again
+                //  after reading more.
+                //
+
+                return FALSE;
+            }
+        } else {
+            LocalLineEnding = YoriLibLineEndingLF;
+        }
+    } else {
+        PUCHAR Buffer = YoriLibAddToPointer(ReadContext->PreviousBuffer, Offset);
+        CharsRemaining = ReadContext->BytesInBuffer - Offset;
+        Count = YoriLibFindLineDelimiterA(Buffer, CharsRemaining);
+        if (Count == CharsRemaining) {
+            return FALSE;
+        }
+
+        *CharsInLine = Count;
+        LocalLineEnding = YoriLibLineEndingCR;
+        if (Buffer[Count] == 0xD) {
+            if (Count + 1 < (ReadContext->BytesInBuffer - Offset)) {
+                if (Buffer[Count + 1] == 0xA) {
+                    Count++;
+                    LocalLineEnding = YoriLibLineEndingCRLF;
+                }
+            } else if (Offset > 0) {
+                return FALSE;
+            }
+        } else {
+            LocalLineEnding = YoriLibLineEndingLF;
+        }
+    }
+
+    *CharsConsumed = Count + 1;
+    *LineEnding = LocalLineEnding;
+    return TRUE;
+}
+
+/**
+ Prepare a line read context for a read operation.  If the context has not
+ been allocated yet, allocate it.  If the context does not have a buffer, or
+ the buffer is smaller than the caller requires, allocate one.
+
+ @param Context Pointer to a PVOID sized block of memory that is NULL for the
+        first read operation, and is updated by this function.
+
+ @param FileHandle Specifies the handle to the file to read from.
+
+ @param MinimumBufferLength Specifies the minimum size of the read buffer, in
+        bytes.
+
+ @return Pointer to the line read context, or NULL if the context could not
+         be allocated or the read operation has already been terminated.
+ */
+PYORI_LIB_LINE_READ_CONTEXT
+YoriLibReadLinePrepareContext(
+    __inout PVOID * Context,
+    __in HANDLE FileHandle,
+    __in YORI_ALLOC_SIZE_T MinimumBufferLength
+    )
+{
+    PYORI_LIB_LINE_READ_CONTEXT ReadContext;
 
     //
     //  If we don't have a line read context yet, allocate one.
@@ -452,8 +632,6 @@ YoriLibReadLineToStringEx(
     if (*Context == NULL) {
         ReadContext = YoriLibReadLineAllocateContext();
         if (ReadContext == NULL) {
-            UserString->LengthInChars = 0;
-            *LineEnding = YoriLibLineEndingNone;
             return NULL;
         }
         *Context = ReadContext;
@@ -478,7 +656,7 @@ YoriLibReadLineToStringEx(
     //  If the line read context doesn't have a buffer yet, allocate it
     //
 
-    if (ReadContext->PreviousBuffer == NULL || UserString->LengthAllocated > ReadContext->LengthOfBuffer) {
+    if (ReadContext->PreviousBuffer == NULL || MinimumBufferLength > ReadContext->LengthOfBuffer) {
         YORI_ALLOC_SIZE_T MinBufferSize;
         if (ReadContext->PreviousBuffer != NULL) {
             YoriLibFree(ReadContext->PreviousBuffer);
@@ -488,304 +666,362 @@ YoriLibReadLineToStringEx(
         //
         //  MSFIX: Need to adjust this for smaller alloc size limits
         //
-        ReadContext->LengthOfBuffer = UserString->LengthAllocated;
+        ReadContext->LengthOfBuffer = MinimumBufferLength;
         MinBufferSize = YoriLibMaximumAllocationInRange(60 * 1024, 256 * 1024);
         if (ReadContext->LengthOfBuffer < MinBufferSize) {
             ReadContext->LengthOfBuffer = MinBufferSize;
         }
         ReadContext->PreviousBuffer = YoriLibMalloc(ReadContext->LengthOfBuffer);
         if (ReadContext->PreviousBuffer == NULL) {
-            UserString->LengthInChars = 0;
-            *LineEnding = YoriLibLineEndingNone;
             ReadContext->Terminated = TRUE;
             return NULL;
         }
     }
 
-    do {
+    return ReadContext;
+}
 
-        BOOL ProcessThisLine;
-        ASSERT(ReadContext->CurrentBufferOffset <= ReadContext->BytesInBuffer);
+/**
+ Move any data in the read buffer that has not been returned to the caller
+ to the front of the buffer, so that more data can be read after it.
 
-        //
-        //  Scan through the buffer looking for newlines.  If we find one,
-        //  copy the data back into the caller's buffer.  Copy any remaining
-        //  buffer back to the beginning of the holdover buffer, and
-        //  decrement chars there accordingly.
-        //
+ @param ReadContext Pointer to the line read context.
 
-        if (ReadContext->ReadWChars) {
-            PWCHAR WideBuffer = (PWCHAR)YoriLibAddToPointer(ReadContext->PreviousBuffer, ReadContext->CurrentBufferOffset);
-            CharsRemaining = (ReadContext->BytesInBuffer - ReadContext->CurrentBufferOffset) / sizeof(WCHAR);
-            for (Count = 0; Count < CharsRemaining; Count++) {
-                if (WideBuffer[Count] == 0xD ||
-                    WideBuffer[Count] == 0xA) {
-
-                    ProcessThisLine = TRUE;
-
-                    CharsToCopy = Count;
-                    LocalLineEnding = YoriLibLineEndingCR;
-                    if (WideBuffer[Count] == 0xD) {
-                        if ((Count + 1) * sizeof(WCHAR) < (ReadContext->BytesInBuffer - ReadContext->CurrentBufferOffset)) {
-                            if (WideBuffer[Count + 1] == 0xA) {
-                                Count++;
-                                LocalLineEnding = YoriLibLineEndingCRLF;
-                            }
-                        } else if (ReadContext->CurrentBufferOffset > 0) {
-                            ProcessThisLine = FALSE;
-                        }
-                    } else {
-                        LocalLineEnding = YoriLibLineEndingLF;
-                    }
+ @return TRUE if there is space in the buffer to read more data, FALSE if
+         the buffer is full.
+ */
+BOOLEAN
+YoriLibReadLineCompactBuffer(
+    __in PYORI_LIB_LINE_READ_CONTEXT ReadContext
+    )
+{
+    if (ReadContext->CurrentBufferOffset != 0) {
+        memmove(ReadContext->PreviousBuffer,
+                YoriLibAddToPointer(ReadContext->PreviousBuffer, ReadContext->CurrentBufferOffset),
+                ReadContext->BytesInBuffer - ReadContext->CurrentBufferOffset);
+        ReadContext->BytesInBuffer = ReadContext->BytesInBuffer - ReadContext->CurrentBufferOffset;
+        ReadContext->CurrentBufferOffset = 0;
+    }
 
-                    Count++;
+    //
+    //  If the buffer is full, we're at the end of the road.  Although we
+    //  could increase the buffer size, the caller isn't able to process a
+    //  line of this length anyway.
+    //
 
-                    if (ProcessThisLine) {
-
-                        CharsToSkip = 0;
-                        if (!BomFound && ReadContext->LinesRead == 0) {
-                            CharsToSkip = YoriLibBytesInBom((PUCHAR)ReadContext->PreviousBuffer, CharsToCopy * sizeof(WCHAR));
-                            if (CharsToSkip > 0) {
-                                BomFound = TRUE;
-                                CharsToSkip = CharsToSkip / sizeof(WCHAR);
-                                CharsToCopy = CharsToCopy - CharsToSkip;
-                            }
-                        }
-                        if (YoriLibCopyLineToUserBufferW(UserString, (LPSTR)&WideBuffer[CharsToSkip], CharsToCopy)) {
-                            ReadContext->CurrentBufferOffset = ReadContext->CurrentBufferOffset + Count * sizeof(WCHAR);
-                            ReadContext->LinesRead++;
-                            *LineEnding = LocalLineEnding;
-                            return UserString->StartOfString;
-                        } else {
-                            UserString->LengthInChars = 0;
-                            *LineEnding = YoriLibLineEndingNone;
-                            ReadContext->Terminated = TRUE;
-                            return NULL;
-                        }
-                    }
-                }
-            }
+    if (ReadContext->LengthOfBuffer == ReadContext->BytesInBuffer) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Wait for more data to arrive on the input stream and append it to the read
+ buffer.
+
+ @param ReadContext Pointer to the line read context.
+
+ @param MaximumDelay Specifies the maximum amount of time to wait for data.
+        This value can be INFINITE or a specified number of milliseconds.
+
+ @param FileHandle Specifies the handle to the file to read from.
+
+ @param TimeoutReached Set to TRUE to indicate that the timeout value in
+        MaximumDelay was reached.  The caller is expected to initialize this
+        to FALSE.
+
+ @return TRUE to indicate more data may have been added to the buffer, or
+         FALSE to indicate processing should terminate because the end of
+         the stream was reached, an error occurred, the operation was
+         cancelled, or the timeout was reached.
+ */
+BOOLEAN
+YoriLibReadLineFillBuffer(
+    __in PYORI_LIB_LINE_READ_CONTEXT ReadContext,
+    __in DWORD MaximumDelay,
+    __in HANDLE FileHandle,
+    __inout PBOOL TimeoutReached
+    )
+{
+    SYSERR LastError;
+    YORI_ALLOC_SIZE_T BytesToRead;
+    DWORD BytesRead;
+    BOOL TerminateProcessing;
+    HANDLE HandleArray[2];
+    DWORD HandleCount;
+    DWORD WaitResult;
+    DWORD DelayTime;
+    DWORD CumulativeDelay;
+
+    //
+    //  Wait for more data, or for cancellation if it's enabled.
+    //
+    //  This stupid dance about waiting and sleeping is for the following
+    //  brain-damaged comment in MSDN under "Named Pipe Operations":
+    //
+    //    The pipe server should not perform a blocking read operation
+    //    until the pipe client has started. Otherwise, a race condition
+    //    can occur. This typically occurs when initialization code, such
+    //    as that of the C run-time library, needs to lock and examine
+    //    inherited handles.
+    //
+    //  Of course, we don't control the behavior of the pipe client.  We
+    //  do, however, observe that the pipe can be signalled prior to the
+    //  client performing operations on it, which requires us to
+    //  distinguish between "signalled due to correct operation" and
+    //  "signalled due to a documented bug on MSDN."
+    //
+    //  The cancel event is listed first because in the case where the
+    //  pipe is overactively signalled, we still want to detect cancel,
+    //  which will not be overactively signalled.
+    //
+
+    CumulativeDelay = 0;
+    DelayTime = 1;
+    TerminateProcessing = FALSE;
+    while(TRUE) {
+        DWORD BytesAvailable;
+
+        if (YoriLibCancelGetEvent() != NULL) {
+            HandleCount = 2;
+            HandleArray[0] = YoriLibCancelGetEvent();
+            HandleArray[1] = FileHandle;
         } else {
-            PUCHAR Buffer = YoriLibAddToPointer(ReadContext->PreviousBuffer, ReadContext->CurrentBufferOffset);
-            CharsRemaining = ReadContext->BytesInBuffer - ReadContext->CurrentBufferOffset;
-            for (Count = 0; Count < CharsRemaining; Count++) {
-
-                if (Buffer[Count] == 0xD ||
-                    Buffer[Count] == 0xA) {
-
-                    ProcessThisLine = TRUE;
-
-                    CharsToCopy = Count;
-                    LocalLineEnding = YoriLibLineEndingCR;
-                    if (Buffer[Count] == 0xD) {
-                        if (Count + 1 < (ReadContext->BytesInBuffer - ReadContext->CurrentBufferOffset)) {
-                            if (Buffer[Count + 1] == 0xA) {
-                                Count++;
-                                LocalLineEnding = YoriLibLineEndingCRLF;
-                            }
-                        } else if (ReadContext->CurrentBufferOffset > 0) {
-                            ProcessThisLine = FALSE;
-                        }
-                    } else {
-                        LocalLineEnding = YoriLibLineEndingLF;
-                    }
+            HandleCount = 1;
+            HandleArray[0] = FileHandle;
+        }
 
-                    Count++;
+        WaitResult = WaitForMultipleObjectsEx(HandleCount, HandleArray, FALSE, INFINITE, FALSE);
+        if (WaitResult == WAIT_OBJECT_0 && HandleCount > 1) {
+            TerminateProcessing = TRUE;
+            break;
+        }
 
-                    if (ProcessThisLine) {
-
-                        CharsToSkip = 0;
-                        if (!BomFound && ReadContext->LinesRead == 0) {
-                            CharsToSkip = YoriLibBytesInBom((PUCHAR)ReadContext->PreviousBuffer, CharsToCopy);
-                            if (CharsToSkip > 0) {
-                                BomFound = TRUE;
-                                CharsToCopy = CharsToCopy - CharsToSkip;
-                            }
-                        }
-                        if (YoriLibCopyLineToUserBufferW(UserString, (LPSTR)&Buffer[CharsToSkip], CharsToCopy)) {
-                            ReadContext->CurrentBufferOffset = ReadContext->CurrentBufferOffset + Count;
-                            ReadContext->LinesRead++;
-                            *LineEnding = LocalLineEnding;
-                            return UserString->StartOfString;
-                        } else {
-                            UserString->LengthInChars = 0;
-                            *LineEnding = YoriLibLineEndingNone;
-                            ReadContext->Terminated = TRUE;
-                            return NULL;
-                        }
-                    }
-                }
-            }
+        if (ReadContext->FileType != FILE_TYPE_PIPE) {
+            break;
         }
 
-        //
-        //  We haven't found any lines.  Move the contents that are still
-        //  unprocessed to the front of the buffer.
-        //
+        if (!PeekNamedPipe(FileHandle, NULL, 0, NULL, &BytesAvailable, NULL)) {
+            TerminateProcessing = TRUE;
+            break;
+        }
+
+        if (BytesAvailable > 0) {
+            break;
+        }
 
-        if (ReadContext->CurrentBufferOffset != 0) {
-            memmove(ReadContext->PreviousBuffer,
-                    YoriLibAddToPointer(ReadContext->PreviousBuffer, ReadContext->CurrentBufferOffset),
-                    ReadContext->BytesInBuffer - ReadContext->CurrentBufferOffset);
-            ReadContext->BytesInBuffer = ReadContext->BytesInBuffer - ReadContext->CurrentBufferOffset;
-            ReadContext->CurrentBufferOffset = 0;
+        if (MaximumDelay != INFINITE && CumulativeDelay >= MaximumDelay) {
+            *TimeoutReached = TRUE;
+            TerminateProcessing = TRUE;
+            break;
         }
 
         //
-        //  If we haven't found a newline yet and the buffer is full,
-        //  we're at the end of the road.  Although we could increase the
-        //  buffer size, the caller isn't able to process a line of this
-        //  length anyway.
+        //  Note that this delay is not exercised once the process
+        //  starts pushing data into the pipe.  Think of this as
+        //  the maximum interval that we're waiting for the process
+        //  to start.
         //
 
-        if (ReadContext->LengthOfBuffer == ReadContext->BytesInBuffer) {
-            UserString->LengthInChars = 0;
-            *LineEnding = YoriLibLineEndingNone;
-            ReadContext->Terminated = TRUE;
-            return NULL;
+        Sleep(DelayTime);
+        CumulativeDelay += DelayTime;
+        if (DelayTime < 10) {
+            DelayTime++;
+        } else {
+            DelayTime = DelayTime * 5 / 4;
+        }
+        if (DelayTime > 500) {
+            DelayTime = 500;
+        }
+    }
+
+    if (TerminateProcessing) {
+        return FALSE;
+    }
+
+    //
+    //  Check if we can read more data and see if it helps.
+    //
+
+    BytesRead = 0;
+    BytesToRead = ReadContext->LengthOfBuffer - ReadContext->BytesInBuffer;
+    LastError = ERROR_SUCCESS;
+
+    while(TRUE) {
+        if (ReadFile(FileHandle, YoriLibAddToPointer(ReadContext->PreviousBuffer, ReadContext->BytesInBuffer), BytesToRead, &BytesRead, NULL)) {
+            LastError = ERROR_SUCCESS;
+            break;
         }
 
         //
-        //  Wait for more data, or for cancellation if it's enabled.
-        //
-        //  This stupid dance about waiting and sleeping is for the following
-        //  brain-damaged comment in MSDN under "Named Pipe Operations":
-        //
-        //    The pipe server should not perform a blocking read operation
-        //    until the pipe client has started. Otherwise, a race condition
-        //    can occur. This typically occurs when initialization code, such
-        //    as that of the C run-time library, needs to lock and examine
-        //    inherited handles.
+        //  NT 3.1 can fail reads with NOT_ENOUGH_MEMORY if the buffer
+        //  is too large.  Work around this by shrinking the requested
+        //  number of bytes to read.
         //
-        //  Of course, we don't control the behavior of the pipe client.  We
-        //  do, however, observe that the pipe can be signalled prior to the
-        //  client performing operations on it, which requires us to
-        //  distinguish between "signalled due to correct operation" and
-        //  "signalled due to a documented bug on MSDN."
+
+        LastError = GetLastError();
+        if (LastError == ERROR_NOT_ENOUGH_MEMORY && BytesToRead > 16384) {
+            BytesToRead = 16384;
+            continue;
+        }
+
+        break;
+    }
+
+    if (LastError != ERROR_SUCCESS) {
+#if DBG
         //
-        //  The cancel event is listed first because in the case where the
-        //  pipe is overactively signalled, we still want to detect cancel,
-        //  which will not be overactively signalled.
+        //  Most of these indicate the source has gone away or ended.
+        //  ERROR_INVALID_PARAMETER happens when we're trying to
+        //  perform an unaligned read on a noncached handle, which
+        //  is crazy, but Windows will silently allow cached opens to
+        //  devices to be noncached opens, which inconveniently means
+        //  the detection of the problem happens later than it should.
         //
 
-        CumulativeDelay = 0;
-        DelayTime = 1;
-        TerminateProcessing = FALSE;
-        while(TRUE) {
-            DWORD BytesAvailable;
+        ASSERT(LastError == ERROR_BROKEN_PIPE ||
+               LastError == ERROR_NO_DATA ||
+               LastError == ERROR_HANDLE_EOF ||
+               LastError == ERROR_INVALID_PARAMETER);
+#endif
+        return FALSE;
+    }
 
-            if (YoriLibCancelGetEvent() != NULL) {
-                HandleCount = 2;
-                HandleArray[0] = YoriLibCancelGetEvent();
-                HandleArray[1] = FileHandle;
-            } else {
-                HandleCount = 1;
-                HandleArray[0] = FileHandle;
-            }
+    if (ReadContext->FileType != FILE_TYPE_PIPE && BytesRead == 0) {
+        return FALSE;
+    }
 
-            WaitResult = WaitForMultipleObjectsEx(HandleCount, HandleArray, FALSE, INFINITE, FALSE);
-            if (WaitResult == WAIT_OBJECT_0 && HandleCount > 1) {
-                TerminateProcessing = TRUE;
-                break;
-            }
+    ReadContext->BytesInBuffer = ReadContext->BytesInBuffer + (YORI_ALLOC_SIZE_T)BytesRead;
+    return TRUE;
+}
 
-            if (ReadContext->FileType != FILE_TYPE_PIPE) {
-                break;
-            }
+/**
+ Read a line from an input stream.
 
-            if (!PeekNamedPipe(FileHandle, NULL, 0, NULL, &BytesAvailable, NULL)) {
-                TerminateProcessing = TRUE;
-                break;
-            }
+ @param UserString Pointer to a string to be updated to contain data for a
+        line.  This must be initialized by the caller and the caller's buffer
+        will be used if it is large enough.  If not, this function may
+        reallocate the string to point to a new buffer.
 
-            if (BytesAvailable > 0) {
-                break;
-            }
+ @param Context Pointer to a PVOID sized block of memory that should be
+        initialized to NULL for the first line read, and will be updated by
+        this function.
 
-            if (MaximumDelay != INFINITE && CumulativeDelay >= MaximumDelay) {
-                *TimeoutReached = TRUE;
-                TerminateProcessing = TRUE;
-                break;
-            }
+ @param ReturnFinalNonTerminatedLine If TRUE, treat any line at the end of the
+        stream without a line ending character to be a line to return.  If
+        FALSE, assume new input could arrive that means we just haven't
+        observed the line break yet.
 
-            //
-            //  Note that this delay is not exercised once the process
-            //  starts pushing data into the pipe.  Think of this as
-            //  the maximum interval that we're waiting for the process
-            //  to start.
-            //
+ @param MaximumDelay Specifies the maximum amount of time to wait for a
+        complete line.  This value can be INFINITE or a specified number of
+        milliseconds.  If the timeout value is reached, TimeoutReached will
+        be set to true and the function will return NULL.
 
-            Sleep(DelayTime);
-            CumulativeDelay += DelayTime;
-            if (DelayTime < 10) {
-                DelayTime++;
-            } else {
-                DelayTime = DelayTime * 5 / 4;
-            }
-            if (DelayTime > 500) {
-                DelayTime = 500;
-            }
-        }
+ @param FileHandle Specifies the handle to the file to read the line from.
 
-        //
-        //  If we haven't found a newline yet, check if we can read more
-        //  data and see if it helps.  If we fail to read more data,
-        //  just treat any buffer remainder as a line.
-        //
+ @param LineEnding On successful completion, set to indicate the string of
+        characters used to terminate the line.  Can be YoriLibLineEndingNone
+        to indicate no line end was found, which can happen if
+        ReturnFinalNonTerminatedLine is TRUE or MaximumDelay is less than
+        infinite and a partial line was found.
 
-        BytesRead = 0;
-        if (!TerminateProcessing) {
+ @param TimeoutReached On successful completion, set to TRUE to indicate that
+        the timeout value in MaximumDelay was reached.  If MaximumDelay is
+        INFINITE, this cannot happen.
 
-            BytesToRead = ReadContext->LengthOfBuffer - ReadContext->BytesInBuffer;
-            LastError = ERROR_SUCCESS;
+ @return Pointer to the Line buffer for success, NULL on failure.
+ */
+PVOID
+YoriLibReadLineToStringEx(
+    __in PYORI_STRING UserString,
+    __inout PVOID * Context,
+    __in BOOL ReturnFinalNonTerminatedLine,
+    __in DWORD MaximumDelay,
+    __in HANDLE FileHandle,
+    __out PYORI_LIB_LINE_ENDING LineEnding,
+    __out PBOOL TimeoutReached
+    )
+{
+    PYORI_LIB_LINE_READ_CONTEXT ReadContext;
+    YORI_ALLOC_SIZE_T CharsToCopy;
+    YORI_ALLOC_SIZE_T CharsToSkip;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+    YORI_LIB_LINE_ENDING LocalLineEnding;
 
-            while(TRUE) {
-                if (ReadFile(FileHandle, YoriLibAddToPointer(ReadContext->PreviousBuffer, ReadContext->BytesInBuffer), BytesToRead, &BytesRead, NULL)) {
-                    LastError = ERROR_SUCCESS;
-                    break;
-                }
+    *TimeoutReached = FALSE;
 
-                //
-                //  NT 3.1 can fail reads with NOT_ENOUGH_MEMORY if the buffer
-                //  is too large.  Work around this by shrinking the requested
-                //  number of bytes to read.
-                //
+    ReadContext = YoriLibReadLinePrepareContext(Context, FileHandle, UserString->LengthAllocated);
+    if (ReadContext == NULL) {
+        UserString->LengthInChars = 0;
+        *LineEnding = YoriLibLineEndingNone;
+        return NULL;
+    }
 
-                LastError = GetLastError();
-                if (LastError == ERROR_NOT_ENOUGH_MEMORY && BytesToRead > 16384) {
-                    BytesToRead = 16384;
-                    continue;
-                }
+    do {
 
-                break;
-            }
+        ASSERT(ReadContext->CurrentBufferOffset <= ReadContext->BytesInBuffer);
 
-            if (LastError != ERROR_SUCCESS) {
-#if DBG
-                //
-                //  Most of these indicate the source has gone away or ended.
-                //  ERROR_INVALID_PARAMETER happens when we're trying to
-                //  perform an unaligned read on a noncached handle, which
-                //  is crazy, but Windows will silently allow cached opens to
-                //  devices to be noncached opens, which inconveniently means
-                //  the detection of the problem happens later than it should.
-                //
+        //
+        //  Scan through the buffer looking for newlines.  If we find one,
+        //  copy the data back into the caller's buffer.
+        //
 
-                ASSERT(LastError == ERROR_BROKEN_PIPE ||
-                       LastError == ERROR_NO_DATA ||
-                       LastError == ERROR_HANDLE_EOF ||
-                       LastError == ERROR_INVALID_PARAMETER);
-#endif
-                TerminateProcessing = TRUE;
+        if (YoriLibReadLineFindNextLine(ReadContext, ReadContext->CurrentBufferOffset, &CharsToCopy, &CharsConsumed, &LocalLineEnding)) {
+            LPSTR LineStart;
+
+            LineStart = YoriLibAddToPointer(ReadContext->PreviousBuffer, ReadContext->CurrentBufferOffset);
+            CharsToSkip = 0;
+            if (ReadContext->LinesRead == 0) {
+                if (ReadContext->ReadWChars) {
+                    CharsToSkip = YoriLibBytesInBom((PUCHAR)ReadContext->PreviousBuffer, CharsToCopy * sizeof(WCHAR));
+                } else {
+                    CharsToSkip = YoriLibBytesInBom((PUCHAR)ReadContext->PreviousBuffer, CharsToCopy);
+                }
             }
 
-            if (ReadContext->FileType != FILE_TYPE_PIPE && BytesRead == 0) {
+            if (ReadContext->ReadWChars) {
+                CharsToSkip = CharsToSkip / sizeof(WCHAR);
+                LineStart = (LPSTR)((PWCHAR)LineStart + CharsToSkip);
+                CharsConsumed = CharsConsumed * sizeof(WCHAR);
+            } else {
+                LineStart = LineStart + CharsToSkip;
+            }
+            CharsToCopy = CharsToCopy - CharsToSkip;
 
-                TerminateProcessing = TRUE;
+            if (YoriLibCopyLineToUserBufferW(UserString, LineStart, CharsToCopy)) {
+                ReadContext->CurrentBufferOffset = ReadContext->CurrentBufferOffset + CharsConsumed;
+                ReadContext->LinesRead++;
+                *LineEnding = LocalLineEnding;
+                return UserString->StartOfString;
+            } else {
+                UserString->LengthInChars = 0;
+                *LineEnding = YoriLibLineEndingNone;
+                ReadContext->Terminated = TRUE;
+                return NULL;
             }
         }
 
-        if (TerminateProcessing) {
+        //
+        //  We haven't found any lines.  Move the contents that are still
+        //  unprocessed to the front of the buffer.  If the buffer is full
+        //  without a line, give up.
+        //
+
+        if (!YoriLibReadLineCompactBuffer(ReadContext)) {
+            UserString->LengthInChars = 0;
+            *LineEnding = YoriLibLineEndingNone;
+            ReadContext->Terminated = TRUE;
+            return NULL;
+        }
+
+        //
+        //  If we haven't found a newline yet, check if we can read more
+        //  data and see if it helps.  If we fail to read more data,
+        //  just treat any buffer remainder as a line.
+        //
+
+        if (!YoriLibReadLineFillBuffer(ReadContext, MaximumDelay, FileHandle, TimeoutReached)) {
             if (ReturnFinalNonTerminatedLine) {
 
                 //
@@ -809,12 +1045,9 @@ YoriLibReadLineToStringEx(
 
                     CharsToSkip = 0;
                     CharsToCopy = ReadContext->BytesInBuffer;
-                    if (!BomFound && ReadContext->LinesRead == 0) {
+                    if (ReadContext->LinesRead == 0) {
                         CharsToSkip = YoriLibBytesInBom((PUCHAR)ReadContext->PreviousBuffer, CharsToCopy);
-                        if (CharsToSkip > 0) {
-                            BomFound = TRUE;
-                            CharsToCopy = CharsToCopy - CharsToSkip;
-                        }
+                        CharsToCopy = CharsToCopy - CharsToSkip;
                     }
                     if (ReadContext->ReadWChars) {
                         CharsToCopy = CharsToCopy / sizeof(WCHAR);
@@ -831,11 +1064,221 @@ YoriLibReadLineToStringEx(
             return NULL;
         }
 
-        ReadContext->BytesInBuffer = ReadContext->BytesInBuffer + (YORI_ALLOC_SIZE_T)BytesRead;
-
     } while(TRUE);
 }
 
+/**
+ Read a set of lines from an input stream.  This is equivalent to calling
+ YoriLibReadLineToStringEx repeatedly, but returns every complete line that
+ is present in the read buffer at once, and converts them to UTF16 in a
+ single operation.  The context can be used with YoriLibReadLineToStringEx
+ and YoriLibLineReadClose in the same way.
+
+ @param BatchBuffer Pointer to a string to be updated to contain the text of
+        all returned lines.  This must be initialized by the caller and the
+        caller's buffer will be used if it is large enough.  If not, this
+        function may reallocate the string to point to a new buffer.
+
+ @param Context Pointer to a PVOID sized block of memory that should be
+        initialized to NULL for the first read, and will be updated by this
+        function.
+
+ @param ReturnFinalNonTerminatedLine If TRUE, treat any line at the end of the
+        stream without a line ending character to be a line to return.
+
+ @param FileHandle Specifies the handle to the file to read lines from.
+
+ @param Lines Pointer to an array of line spans to populate.  On successful
+        completion, each line string refers to memory within BatchBuffer,
+        is not NULL terminated, and remains valid until BatchBuffer is
+        modified or passed to this function again.
+
+ @param MaximumLines The number of elements in the Lines array.
+
+ @param LinesReturned On successful completion, updated to contain the
+        number of elements in the Lines array that were populated.  This is
+        always at least one.
+
+ @return TRUE to indicate one or more lines were returned, FALSE to indicate
+         the end of the stream was reached or a failure occurred.
+ */
+__success(return)
+BOOL
+YoriLibReadLineBatch(
+    __inout PYORI_STRING BatchBuffer,
+    __inout PVOID * Context,
+    __in BOOL ReturnFinalNonTerminatedLine,
+    __in HANDLE FileHandle,
+    __out_ecount(MaximumLines) PYORI_LIB_LINE_SPAN Lines,
+    __in YORI_ALLOC_SIZE_T MaximumLines,
+    __out PYORI_ALLOC_SIZE_T LinesReturned
+    )
+{
+    PYORI_LIB_LINE_READ_CONTEXT ReadContext;
+    YORI_ALLOC_SIZE_T LineCount;
+    YORI_ALLOC_SIZE_T LineIndex;
+    YORI_ALLOC_SIZE_T EndOffset;
+    YORI_ALLOC_SIZE_T StartOffset;
+    YORI_ALLOC_SIZE_T CharsInLine;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+    YORI_ALLOC_SIZE_T CharsToConvert;
+    YORI_ALLOC_SIZE_T CharsNeeded;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T LineStart;
+    YORI_LIB_LINE_ENDING LocalLineEnding;
+    BOOL TimeoutReached;
+    BOOLEAN FinalLine;
+    PWCHAR WideBuffer;
+
+    *LinesReturned = 0;
+    if (MaximumLines == 0) {
+        return FALSE;
+    }
+
+    ReadContext = YoriLibReadLinePrepareContext(Context, FileHandle, 0);
+    if (ReadContext == NULL) {
+        return FALSE;
+    }
+
+    //
+    //  Count the complete lines in the buffer, reading more data until at
+    //  least one line is found.
+    //
+
+    TimeoutReached = FALSE;
+    FinalLine = FALSE;
+    while (TRUE) {
+        LineCount = 0;
+        EndOffset = ReadContext->CurrentBufferOffset;
+        while (LineCount < MaximumLines &&
+               YoriLibReadLineFindNextLine(ReadContext, EndOffset, &CharsInLine, &CharsConsumed, &LocalLineEnding)) {
+
+            if (ReadContext->ReadWChars) {
+                CharsConsumed = CharsConsumed * sizeof(WCHAR);
+            }
+            EndOffset = EndOffset + CharsConsumed;
+            LineCount++;
+        }
+
+        if (LineCount > 0) {
+            break;
+        }
+
+        if (!YoriLibReadLineCompactBuffer(ReadContext)) {
+            ReadContext->Terminated = TRUE;
+            return FALSE;
+        }
+
+        if (!YoriLibReadLineFillBuffer(ReadContext, INFINITE, FileHandle, &TimeoutReached)) {
+            ReadContext->Terminated = TRUE;
+            if (!ReturnFinalNonTerminatedLine || ReadContext->BytesInBuffer == 0) {
+                return FALSE;
+            }
+
+            //
+            //  Return whatever remains as a final line without a line
+            //  ending.  This can include a carriage return that was at
+            //  the end of the buffer.
+            //
+
+            EndOffset = ReadContext->BytesInBuffer;
+            LineCount = 1;
+            FinalLine = TRUE;
+            break;
+        }
+    }
+
+    //
+    //  Convert all of the lines at once.  Line delimiters are ASCII and
+    //  cannot form part of a multibyte sequence, so the converted text
+    //  contains the same lines as the input.
+    //
+
+    StartOffset = ReadContext->CurrentBufferOffset;
+    if (ReadContext->LinesRead == 0) {
+        StartOffset = StartOffset + YoriLibBytesInBom((PUCHAR)ReadContext->PreviousBuffer, EndOffset);
+    }
+
+    CharsToConvert = EndOffset - StartOffset;
+    if (ReadContext->ReadWChars) {
+        CharsToConvert = CharsToConvert / sizeof(WCHAR);
+    }
+
+    CharsNeeded = 0;
+    if (CharsToConvert > 0) {
+        CharsNeeded = (YORI_ALLOC_SIZE_T)YoriLibGetMultibyteInputSizeNeeded(YoriLibAddToPointer(ReadContext->PreviousBuffer, StartOffset), CharsToConvert);
+    }
+
+    if (CharsNeeded >= BatchBuffer->LengthAllocated) {
+        YORI_ALLOC_SIZE_T CharsToAllocate;
+
+        //
+        //  Allocate enough for any full buffer so this only happens once.
+        //
+
+        CharsToAllocate = ReadContext->LengthOfBuffer;
+        if (CharsToAllocate <= CharsNeeded) {
+            CharsToAllocate = CharsNeeded + 1;
+        }
+        BatchBuffer->LengthInChars = 0;
+        if (!YoriLibReallocStringNoContents(BatchBuffer, CharsToAllocate)) {
+            ReadContext->Terminated = TRUE;
+            return FALSE;
+        }
+    }
+
+    if (CharsToConvert > 0) {
+        YoriLibMultibyteInput(YoriLibAddToPointer(ReadContext->PreviousBuffer, StartOffset),
+                              CharsToConvert,
+                              BatchBuffer->StartOfString,
+                              BatchBuffer->LengthAllocated);
+    }
+    BatchBuffer->LengthInChars = CharsNeeded;
+
+    //
+    //  Split the converted text into lines.
+    //
+
+    WideBuffer = BatchBuffer->StartOfString;
+    Index = 0;
+    for (LineIndex = 0; LineIndex < LineCount; LineIndex++) {
+        LineStart = Index;
+        if (FinalLine) {
+            Index = CharsNeeded;
+        } else {
+            Index = Index + YoriLibFindLineDelimiterW(&WideBuffer[Index], CharsNeeded - Index);
+        }
+
+        YoriLibInitEmptyString(&Lines[LineIndex].Line);
+        Lines[LineIndex].Line.StartOfString = &WideBuffer[LineStart];
+        Lines[LineIndex].Line.LengthInChars = Index - LineStart;
+        Lines[LineIndex].Line.LengthAllocated = Index - LineStart;
+
+        if (Index == CharsNeeded) {
+            Lines[LineIndex].LineEnding = YoriLibLineEndingNone;
+        } else if (WideBuffer[Index] == 0xA) {
+            Lines[LineIndex].LineEnding = YoriLibLineEndingLF;
+            Index++;
+        } else if (Index + 1 < CharsNeeded && WideBuffer[Index + 1] == 0xA) {
+            Lines[LineIndex].LineEnding = YoriLibLineEndingCRLF;
+            Index = Index + 2;
+        } else {
+            Lines[LineIndex].LineEnding = YoriLibLineEndingCR;
+            Index++;
+        }
+    }
+
+    if (FinalLine) {
+        ReadContext->BytesInBuffer = 0;
+        ReadContext->CurrentBufferOffset = 0;
+    } else {
+        ReadContext->CurrentBufferOffset = EndOffset;
+    }
+    ReadContext->LinesRead = ReadContext->LinesRead + LineCount;
+    *LinesReturned = LineCount;
+    return TRUE;
+}
+
 /**
  Read a line from an input stream.
 
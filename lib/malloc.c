@@ -3,7 +3,7 @@
  *
  * Yori memory allocation wrappers
  *
- * Copyright (c) 2017-2019 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -143,6 +143,12 @@ YORI_SPECIAL_HEAP_GLOBAL YoriLibSpecialHeap;
 #endif
 
 #if !YORI_SPECIAL_HEAP
+/**
+ The number of allocations performed by this process.  This is only used for
+ reporting, and is not synchronized between threads.
+ */
+DWORD YoriLibAllocationCount;
+
 /**
  Allocate memory.  This should be freed with @ref YoriLibFree when it is no
  longer needed.
@@ -158,6 +164,7 @@ YoriLibMalloc(
 {
     PVOID Alloc;
     Alloc = HeapAlloc(GetProcessHeap(), 0, Bytes);
+    YoriLibAllocationCount++;
     return Alloc;
 }
 #else
@@ -385,6 +392,23 @@ YoriLibDisplayMemoryUsage(VOID)
 #endif
 }
 
+/**
+ Return the number of allocations performed by this process.  This allows a
+ caller to measure how many allocations an operation requires by comparing
+ the value before and after it.
+
+ @return The number of allocations performed by this process.
+ */
+DWORD
+YoriLibGetAllocationCount(VOID)
+{
+#if YORI_SPECIAL_HEAP
+    return YoriLibSpecialHeap.NumberAllocated;
+#else
+    return YoriLibAllocationCount;
+#endif
+}
+
 
 /**
  A structure that preceeds a reference counted malloc allocation.
@@ -0,0 +1,2231 @@
+/**
+ * @file lib/regex.c
+ *
+ * Yori regular expression matching routines
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+/**
+ The number of DWORDs in a bitmap containing one bit per character.
+ */
+#define YORI_LIB_REGEX_BITMAP_DWORDS (0x10000 / 32)
+
+/**
+ Returns TRUE if the bit for a character is set in a bitmap.
+ */
+#define YORI_LIB_REGEX_TEST_BIT(Bitmap, Char) (((Bitmap)[(Char) / 32] & (1 << ((Char) % 32))) != 0)
+
+/**
+ Set the bit for a character in a bitmap.
+ */
+#define YORI_LIB_REGEX_SET_BIT(Bitmap, Char) ((Bitmap)[(Char) / 32] |= (1 << ((Char) % 32)))
+
+/**
+ A value indicating an unbounded repetition count, or that no match has been
+ found.
+ */
+#define YORI_LIB_REGEX_NONE ((YORI_ALLOC_SIZE_T)-1)
+
+/**
+ The largest number of instructions that a compiled expression can contain.
+ This limits the memory and time consumed by expressions such as
+ (a{1000}){1000}.
+ */
+#define YORI_LIB_REGEX_MAX_INSTS (0x10000)
+
+/**
+ The largest explicit repetition count that can be specified with {m,n}.
+ */
+#define YORI_LIB_REGEX_MAX_REPEAT (1000)
+
+/**
+ The deepest nesting of groups, repetitions and alternations allowed in an
+ expression.  Parsing and compiling recurse over this nesting, so this
+ limits the stack consumed.
+ */
+#define YORI_LIB_REGEX_MAX_DEPTH (256)
+
+/**
+ A parse tree node that matches the empty string.
+ */
+#define YORI_LIB_REGEX_NODE_EMPTY        0
+
+/**
+ A parse tree node that matches a single character.
+ */
+#define YORI_LIB_REGEX_NODE_CHAR         1
+
+/**
+ A parse tree node that matches any character other than a newline.
+ */
+#define YORI_LIB_REGEX_NODE_ANY          2
+
+/**
+ A parse tree node that matches a character within a class.
+ */
+#define YORI_LIB_REGEX_NODE_CLASS        3
+
+/**
+ A parse tree node that matches a character within a negated class.  Since
+ a negated class matches characters outside the basic multilingual plane,
+ this also matches a complete surrogate pair.
+ */
+#define YORI_LIB_REGEX_NODE_NEGATED_CLASS 4
+
+/**
+ A parse tree node that matches an instruction that consumes no characters,
+ such as the start or end of a line or a word boundary.
+ */
+#define YORI_LIB_REGEX_NODE_ASSERT       5
+
+/**
+ A parse tree node that matches each of its children in sequence.
+ */
+#define YORI_LIB_REGEX_NODE_CONCAT       6
+
+/**
+ A parse tree node that matches any one of its children, preferring earlier
+ children.
+ */
+#define YORI_LIB_REGEX_NODE_ALTERNATE    7
+
+/**
+ A parse tree node that matches its child a number of times.
+ */
+#define YORI_LIB_REGEX_NODE_REPEAT       8
+
+/**
+ A node within the parse tree of a regular expression.
+ */
+typedef struct _YORI_LIB_REGEX_NODE {
+
+    /**
+     The first child of this node.
+     */
+    struct _YORI_LIB_REGEX_NODE *Child;
+
+    /**
+     The next node with the same parent as this one.
+     */
+    struct _YORI_LIB_REGEX_NODE *Next;
+
+    /**
+     For a character, the character to match.  For a class, the index of
+     the class.  For an assertion, the operation to perform.
+     */
+    YORI_ALLOC_SIZE_T Value;
+
+    /**
+     For a repetition, the minimum number of times to match the child.
+     */
+    YORI_ALLOC_SIZE_T Min;
+
+    /**
+     For a repetition, the maximum number of times to match the child, or
+     YORI_LIB_REGEX_NONE if there is no maximum.
+     */
+    YORI_ALLOC_SIZE_T Max;
+
+    /**
+     The number of instructions needed to compile this node.
+     */
+    YORI_ALLOC_SIZE_T InstCount;
+
+    /**
+     The number of levels of nodes from this node to its deepest
+     descendant.
+     */
+    YORI_ALLOC_SIZE_T Depth;
+
+    /**
+     The type of this node, from YORI_LIB_REGEX_NODE_*.
+     */
+    UCHAR Type;
+
+    /**
+     For a repetition, TRUE if the child should be matched as few times as
+     possible rather than as many times as possible.
+     */
+    BOOLEAN Lazy;
+} YORI_LIB_REGEX_NODE, *PYORI_LIB_REGEX_NODE;
+
+/**
+ State used while parsing a regular expression.
+ */
+typedef struct _YORI_LIB_REGEX_PARSE {
+
+    /**
+     The pattern being parsed.
+     */
+    PCYORI_STRING Pattern;
+
+    /**
+     The offset within the pattern of the next character to parse.  On
+     failure, this is the offset of the character that could not be parsed.
+     */
+    YORI_ALLOC_SIZE_T Offset;
+
+    /**
+     The number of groups currently being parsed.
+     */
+    YORI_ALLOC_SIZE_T GroupDepth;
+
+    /**
+     TRUE if the pattern should be matched case insensitively.
+     */
+    BOOLEAN Insensitive;
+
+    /**
+     TRUE if parsing failed due to an allocation failure rather than an
+     invalid pattern.
+     */
+    BOOLEAN OutOfMemory;
+
+    /**
+     An array of nodes to allocate from.
+     */
+    PYORI_LIB_REGEX_NODE Nodes;
+
+    /**
+     The number of nodes allocated from Nodes.
+     */
+    YORI_ALLOC_SIZE_T NodeCount;
+
+    /**
+     The number of elements in Nodes.
+     */
+    YORI_ALLOC_SIZE_T NodesAllocated;
+
+    /**
+     An array of character class bitmaps.
+     */
+    PDWORD Classes;
+
+    /**
+     The number of character classes in Classes.
+     */
+    YORI_ALLOC_SIZE_T ClassCount;
+
+    /**
+     The number of character classes that Classes has space for.
+     */
+    YORI_ALLOC_SIZE_T ClassesAllocated;
+} YORI_LIB_REGEX_PARSE, *PYORI_LIB_REGEX_PARSE;
+
+/**
+ A thread of execution within a compiled regular expression.
+ */
+typedef struct _YORI_LIB_REGEX_THREAD {
+
+    /**
+     The index of the next instruction for the thread to execute.
+     */
+    YORI_ALLOC_SIZE_T Pc;
+
+    /**
+     The offset within the string where this thread's match started.
+     */
+    YORI_ALLOC_SIZE_T Start;
+} YORI_LIB_REGEX_THREAD, *PYORI_LIB_REGEX_THREAD;
+
+/**
+ Memory used while searching a string with a compiled regular expression.
+ This is allocated for each search so that a single compiled expression can
+ be used to search from multiple threads.
+ */
+typedef struct _YORI_LIB_REGEX_SEARCH {
+
+    /**
+     For each instruction, the generation of the thread list which most
+     recently processed the instruction.  An instruction can only be added
+     to a thread list once.
+     */
+    PDWORD Marks;
+
+    /**
+     The threads that are executing at the current offset.
+     */
+    PYORI_LIB_REGEX_THREAD Current;
+
+    /**
+     The threads that will execute at the next offset.
+     */
+    PYORI_LIB_REGEX_THREAD Next;
+
+    /**
+     A stack of instructions used when following instructions which
+     consume no characters.
+     */
+    PYORI_LIB_REGEX_THREAD Stack;
+
+    /**
+     The number of threads in Current.
+     */
+    YORI_ALLOC_SIZE_T CurrentCount;
+
+    /**
+     The number of threads in Next.
+     */
+    YORI_ALLOC_SIZE_T NextCount;
+
+    /**
+     The generation of the Current thread list.
+     */
+    DWORD CurrentGeneration;
+
+    /**
+     The most recently allocated generation.
+     */
+    DWORD Generation;
+
+    /**
+     The allocation backing this structure if it could not be satisfied
+     from the caller's stack buffer, or NULL if it was.
+     */
+    PVOID Allocation;
+} YORI_LIB_REGEX_SEARCH, *PYORI_LIB_REGEX_SEARCH;
+
+/**
+ The number of bytes of stack that a search can use before allocating
+ memory.
+ */
+#define YORI_LIB_REGEX_STACK_BUFFER (4096)
+
+/**
+ Return TRUE if a character is considered part of a word for the purpose of
+ \w and \b.
+
+ @param Char The character to check.
+
+ @return TRUE if the character is part of a word, FALSE if it is not.
+ */
+BOOLEAN
+YoriLibRegexIsWordChar(
+    __in TCHAR Char
+    )
+{
+    if ((Char >= 'a' && Char <= 'z') ||
+        (Char >= 'A' && Char <= 'Z') ||
+        (Char >= '0' && Char <= '9') ||
+        Char == '_') {
+
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/**
+ Allocate a new node in the parse tree.
+
+ @param Parse Pointer to the parse state.
+
+ @param Type The type of the node, from YORI_LIB_REGEX_NODE_*.
+
+ @return Pointer to the node, or NULL if no more nodes are available.
+ */
+PYORI_LIB_REGEX_NODE
+YoriLibRegexAllocateNode(
+    __in PYORI_LIB_REGEX_PARSE Parse,
+    __in UCHAR Type
+    )
+{
+    PYORI_LIB_REGEX_NODE Node;
+
+    //
+    //  The node array is sized from the pattern length so this should not
+    //  be exhausted, but fail cleanly if it is.
+    //
+
+    if (Parse->NodeCount >= Parse->NodesAllocated) {
+        Parse->OutOfMemory = TRUE;
+        return NULL;
+    }
+
+    Node = &Parse->Nodes[Parse->NodeCount];
+    Parse->NodeCount++;
+    ZeroMemory(Node, sizeof(YORI_LIB_REGEX_NODE));
+    Node->Type = Type;
+    Node->Depth = 1;
+    return Node;
+}
+
+/**
+ Allocate a new, empty, character class.
+
+ @param Parse Pointer to the parse state.
+
+ @param ClassIndex On successful completion, updated to contain the index of
+        the new class.
+
+ @return Pointer to the bitmap for the class, or NULL on allocation failure.
+ */
+PDWORD
+YoriLibRegexAllocateClass(
+    __in PYORI_LIB_REGEX_PARSE Parse,
+    __out PYORI_ALLOC_SIZE_T ClassIndex
+    )
+{
+    PDWORD NewClasses;
+    PDWORD Bitmap;
+    YORI_ALLOC_SIZE_T NewAllocated;
+
+    if (Parse->ClassCount >= Parse->ClassesAllocated) {
+        NewAllocated = Parse->ClassesAllocated * 2;
+        if (NewAllocated == 0) {
+            NewAllocated = 4;
+        }
+        if (!YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)NewAllocated * YORI_LIB_REGEX_BITMAP_DWORDS * sizeof(DWORD))) {
+            Parse->OutOfMemory = TRUE;
+            return NULL;
+        }
+        NewClasses = YoriLibMalloc((YORI_ALLOC_SIZE_T)(NewAllocated * YORI_LIB_REGEX_BITMAP_DWORDS * sizeof(DWORD)));
+        if (NewClasses == NULL) {
+            Parse->OutOfMemory = TRUE;
+            return NULL;
+        }
+        if (Parse->Classes != NULL) {
+            memcpy(NewClasses, Parse->Classes, Parse->ClassCount * YORI_LIB_REGEX_BITMAP_DWORDS * sizeof(DWORD));
+            YoriLibFree(Parse->Classes);
+        }
+        Parse->Classes = NewClasses;
+        Parse->ClassesAllocated = NewAllocated;
+    }
+
+    *ClassIndex = Parse->ClassCount;
+    Bitmap = &Parse->Classes[Parse->ClassCount * YORI_LIB_REGEX_BITMAP_DWORDS];
+    Parse->ClassCount++;
+    ZeroMemory(Bitmap, YORI_LIB_REGEX_BITMAP_DWORDS * sizeof(DWORD));
+    return Bitmap;
+}
+
+/**
+ Add the characters described by a shorthand class, such as \d, to a
+ character class bitmap.
+
+ @param Bitmap The bitmap to update.
+
+ @param Shorthand The character following the backslash, which is one of
+        d, D, s, S, w or W.
+ */
+VOID
+YoriLibRegexAddShorthand(
+    __inout PDWORD Bitmap,
+    __in TCHAR Shorthand
+    )
+{
+    DWORD Shorthands[0x80 / 32];
+    DWORD Index;
+    TCHAR Lower;
+
+    ZeroMemory(Shorthands, sizeof(Shorthands));
+    Lower = Shorthand;
+    if (Lower >= 'A' && Lower <= 'Z') {
+        Lower = (TCHAR)(Lower - 'A' + 'a');
+    }
+
+    switch(Lower) {
+        case 'd':
+            for (Index = '0'; Index <= '9'; Index++) {
+                YORI_LIB_REGEX_SET_BIT(Shorthands, Index);
+            }
+            break;
+        case 's':
+            YORI_LIB_REGEX_SET_BIT(Shorthands, ' ');
+            YORI_LIB_REGEX_SET_BIT(Shorthands, '\t');
+            YORI_LIB_REGEX_SET_BIT(Shorthands, '\n');
+            YORI_LIB_REGEX_SET_BIT(Shorthands, '\r');
+            YORI_LIB_REGEX_SET_BIT(Shorthands, '\f');
+            YORI_LIB_REGEX_SET_BIT(Shorthands, '\v');
+            break;
+        case 'w':
+            for (Index = 0; Index < 0x80; Index++) {
+                if (YoriLibRegexIsWordChar((TCHAR)Index)) {
+                    YORI_LIB_REGEX_SET_BIT(Shorthands, Index);
+                }
+            }
+            break;
+    }
+
+    //
+    //  Each shorthand only describes ASCII characters, so the negated forms
+    //  include every character above that range.
+    //
+
+    for (Index = 0; Index < YORI_LIB_REGEX_BITMAP_DWORDS; Index++) {
+        if (Shorthand == Lower) {
+            if (Index < sizeof(Shorthands)/sizeof(Shorthands[0])) {
+                Bitmap[Index] |= Shorthands[Index];
+            }
+        } else {
+            if (Index < sizeof(Shorthands)/sizeof(Shorthands[0])) {
+                Bitmap[Index] |= ~(Shorthands[Index]);
+            } else {
+                Bitmap[Index] = (DWORD)-1;
+            }
+        }
+    }
+}
+
+/**
+ Prepare a character class bitmap for matching.  Characters being searched
+ are upcased before checking a case insensitive class, so the upcased form
+ of every character in the class is added to it.  If the class is negated,
+ the bitmap is inverted.
+
+ @param Parse Pointer to the parse state.
+
+ @param Bitmap The bitmap to update.
+
+ @param Negate TRUE if the class should match characters that are not in
+        the bitmap.
+ */
+VOID
+YoriLibRegexFinishClass(
+    __in PYORI_LIB_REGEX_PARSE Parse,
+    __inout PDWORD Bitmap,
+    __in BOOLEAN Negate
+    )
+{
+    DWORD Index;
+    DWORD Bit;
+    TCHAR Upcased;
+
+    if (Parse->Insensitive) {
+        for (Index = 0; Index < YORI_LIB_REGEX_BITMAP_DWORDS; Index++) {
+            if (Bitmap[Index] == 0) {
+                continue;
+            }
+            for (Bit = 0; Bit < 32; Bit++) {
+                if (Bitmap[Index] & (1 << Bit)) {
+                    Upcased = YoriLibUpcaseChar((TCHAR)(Index * 32 + Bit));
+                    YORI_LIB_REGEX_SET_BIT(Bitmap, Upcased);
+                }
+            }
+        }
+    }
+
+    if (Negate) {
+        for (Index = 0; Index < YORI_LIB_REGEX_BITMAP_DWORDS; Index++) {
+            Bitmap[Index] = ~(Bitmap[Index]);
+        }
+    }
+}
+
+/**
+ Parse a fixed number of hexadecimal digits from a pattern.
+
+ @param Parse Pointer to the parse state.  On success, the offset is
+        advanced beyond the digits.
+
+ @param Digits The number of digits to parse.
+
+ @param Char On successful completion, updated to contain the character
+        described by the digits.
+
+ @return TRUE to indicate success, FALSE if the digits are not valid.
+ */
+__success(return)
+BOOLEAN
+YoriLibRegexParseHex(
+    __in PYORI_LIB_REGEX_PARSE Parse,
+    __in DWORD Digits,
+    __out PTCHAR Char
+    )
+{
+    DWORD Index;
+    DWORD Value;
+    TCHAR Digit;
+
+    if (Parse->Offset + Digits > Parse->Pattern->LengthInChars) {
+        return FALSE;
+    }
+
+    Value = 0;
+    for (Index = 0; Index < Digits; Index++) {
+        Digit = Parse->Pattern->StartOfString[Parse->Offset + Index];
+        Value = Value * 16;
+        if (Digit >= '0' && Digit <= '9') {
+            Value = Value + Digit - '0';
+        } else if (Digit >= 'a' && Digit <= 'f') {
+            Value = Value + Digit - 'a' + 10;
+        } else if (Digit >= 'A' && Digit <= 'F') {
+            Value = Value + Digit - 'A' + 10;
+        } else {
+            return FALSE;
+        }
+    }
+
+    Parse->Offset = Parse->Offset + Digits;
+    *Char = (TCHAR)Value;
+    return TRUE;
+}
+
+/**
+ Parse an escape sequence following a backslash.
+
+ @param Parse Pointer to the parse state, where the offset refers to the
+        character following the backslash.  On success, the offset is
+        advanced beyond the escape sequence.
+
+ @param Char On successful completion, if the escape describes a single
+        character, updated to contain that character.
+
+ @param Shorthand On successful completion, if the escape describes a class
+        or assertion such as \d or \b, updated to contain the character
+        following the backslash.  Otherwise, updated to zero.
+
+ @return TRUE to indicate success, FALSE if the escape is not valid.
+ */
+__success(return)
+BOOLEAN
+YoriLibRegexParseEscape(
+    __in PYORI_LIB_REGEX_PARSE Parse,
+    __out PTCHAR Char,
+    __out PTCHAR Shorthand
+    )
+{
+    TCHAR Escape;
+
+    *Char = 0;
+    *Shorthand = 0;
+    if (Parse->Offset >= Parse->Pattern->LengthInChars) {
+        return FALSE;
+    }
+
+    Escape = Parse->Pattern->StartOfString[Parse->Offset];
+    Parse->Offset++;
+
+    switch(Escape) {
+        case 'd':
+        case 'D':
+        case 's':
+        case 'S':
+        case 'w':
+        case 'W':
+        case 'b':
+        case 'B':
+            *Shorthand = Escape;
+            break;
+        case 't':
+            *Char = '\t';
+            break;
+        case 'n':
+            *Char = '\n';
+            break;
+        case 'r':
+            *Char = '\r';
+            break;
+        case 'f':
+            *Char = '\f';
+            break;
+        case 'v':
+            *Char = '\v';
+            break;
+        case 'e':
+            *Char = 27;
+            break;
+        case 'x':
+            if (!YoriLibRegexParseHex(Parse, 2, Char)) {
+                return FALSE;
+            }
+            break;
+        case 'u':
+            if (!YoriLibRegexParseHex(Parse, 4, Char)) {
+                return FALSE;
+            }
+            break;
+        default:
+            *Char = Escape;
+            break;
+    }
+
+    return TRUE;
+}
+
+/**
+ Parse a bracketed character class, such as [a-z_].
+
+ @param Parse Pointer to the parse state, where the offset refers to the
+        opening bracket.  On success, the offset is advanced beyond the
+        closing bracket.
+
+ @return Pointer to the parse tree node for the class, or NULL on failure.
+ */
+PYORI_LIB_REGEX_NODE
+YoriLibRegexParseClass(
+    __in PYORI_LIB_REGEX_PARSE Parse
+    )
+{
+    PYORI_LIB_REGEX_NODE Node;
+    PDWORD Bitmap;
+    YORI_ALLOC_SIZE_T ClassIndex;
+    YORI_ALLOC_SIZE_T ClassStart;
+    BOOLEAN Negate;
+    TCHAR Low;
+    TCHAR High;
+    TCHAR Shorthand;
+    DWORD Index;
+
+    Bitmap = YoriLibRegexAllocateClass(Parse, &ClassIndex);
+    if (Bitmap == NULL) {
+        return NULL;
+    }
+
+    Parse->Offset++;
+    Negate = FALSE;
+    if (Parse->Offset < Parse->Pattern->LengthInChars &&
+        Parse->Pattern->StartOfString[Parse->Offset] == '^') {
+
+        Negate = TRUE;
+        Parse->Offset++;
+    }
+
+    //
+    //  A closing bracket immediately after the opening bracket is part of
+    //  the class.
+    //
+
+    ClassStart = Parse->Offset;
+    while (TRUE) {
+        if (Parse->Offset >= Parse->Pattern->LengthInChars) {
+            return NULL;
+        }
+
+        Low = Parse->Pattern->StartOfString[Parse->Offset];
+        if (Low == ']' && Parse->Offset > ClassStart) {
+            Parse->Offset++;
+            break;
+        }
+
+        Parse->Offset++;
+        if (Low == '\\') {
+            if (!YoriLibRegexParseEscape(Parse, &Low, &Shorthand)) {
+                return NULL;
+            }
+
+            //
+            //  Within a class, \b is a backspace rather than a word
+            //  boundary.
+            //
+
+            if (Shorthand == 'b') {
+                Low = '\b';
+            } else if (Shorthand == 'B') {
+                Parse->Offset--;
+                return NULL;
+            } else if (Shorthand != 0) {
+                YoriLibRegexAddShorthand(Bitmap, Shorthand);
+                continue;
+            }
+        }
+
+        High = Low;
+        if (Parse->Offset + 1 < Parse->Pattern->LengthInChars &&
+            Parse->Pattern->StartOfString[Parse->Offset] == '-' &&
+            Parse->Pattern->StartOfString[Parse->Offset + 1] != ']') {
+
+            Parse->Offset++;
+            High = Parse->Pattern->StartOfString[Parse->Offset];
+            Parse->Offset++;
+            if (High == '\\') {
+                if (!YoriLibRegexParseEscape(Parse, &High, &Shorthand)) {
+                    return NULL;
+                }
+                if (Shorthand == 'b') {
+                    High = '\b';
+                } else if (Shorthand != 0) {
+                    Parse->Offset--;
+                    return NULL;
+                }
+            }
+            if (High < Low) {
+                Parse->Offset--;
+                return NULL;
+            }
+        }
+
+        for (Index = Low; Index <= High; Index++) {
+            YORI_LIB_REGEX_SET_BIT(Bitmap, Index);
+        }
+    }
+
+    YoriLibRegexFinishClass(Parse, Bitmap, Negate);
+
+    if (Negate) {
+        Node = YoriLibRegexAllocateNode(Parse, YORI_LIB_REGEX_NODE_NEGATED_CLASS);
+    } else {
+        Node = YoriLibRegexAllocateNode(Parse, YORI_LIB_REGEX_NODE_CLASS);
+    }
+    if (Node == NULL) {
+        return NULL;
+    }
+    Node->Value = ClassIndex;
+    return Node;
+}
+
+PYORI_LIB_REGEX_NODE
+YoriLibRegexParseAlternate(
+    __in PYORI_LIB_REGEX_PARSE Parse
+    );
+
+/**
+ Parse a single item that can be repeated, such as a character, a class, or
+ a parenthesized group.
+
+ @param Parse Pointer to the parse state.  On success, the offset is
+        advanced beyond the item.
+
+ @return Pointer to the parse tree node for the item, or NULL on failure.
+ */
+PYORI_LIB_REGEX_NODE
+YoriLibRegexParseAtom(
+    __in PYORI_LIB_REGEX_PARSE Parse
+    )
+{
+    PYORI_LIB_REGEX_NODE Node;
+    PDWORD Bitmap;
+    YORI_ALLOC_SIZE_T ClassIndex;
+    TCHAR Char;
+    TCHAR Shorthand;
+
+    Char = Parse->Pattern->StartOfString[Parse->Offset];
+    switch(Char) {
+        case '(':
+            if (Parse->GroupDepth >= YORI_LIB_REGEX_MAX_DEPTH) {
+                return NULL;
+            }
+            Parse->Offset++;
+            if (Parse->Offset + 1 < Parse->Pattern->LengthInChars &&
+                Parse->Pattern->StartOfString[Parse->Offset] == '?' &&
+                Parse->Pattern->StartOfString[Parse->Offset + 1] == ':') {
+
+                Parse->Offset = Parse->Offset + 2;
+            }
+            Parse->GroupDepth++;
+            Node = YoriLibRegexParseAlternate(Parse);
+            Parse->GroupDepth--;
+            if (Node == NULL) {
+                return NULL;
+            }
+            if (Parse->Offset >= Parse->Pattern->LengthInChars ||
+                Parse->Pattern->StartOfString[Parse->Offset] != ')') {
+
+                return NULL;
+            }
+            Parse->Offset++;
+            return Node;
+
+        case '[':
+            return YoriLibRegexParseClass(Parse);
+
+        case '.':
+            Parse->Offset++;
+            return YoriLibRegexAllocateNode(Parse, YORI_LIB_REGEX_NODE_ANY);
+
+        case '^':
+        case '$':
+            Node = YoriLibRegexAllocateNode(Parse, YORI_LIB_REGEX_NODE_ASSERT);
+            if (Node == NULL) {
+                return NULL;
+            }
+            if (Char == '^') {
+                Node->Value = YoriLibRegexOpLineStart;
+            } else {
+                Node->Value = YoriLibRegexOpLineEnd;
+            }
+            Parse->Offset++;
+            return Node;
+
+        case '*':
+        case '+':
+        case '?':
+
+            //
+            //  There is nothing to repeat.
+            //
+
+            return NULL;
+
+        case '\\':
+            Parse->Offset++;
+            if (!YoriLibRegexParseEscape(Parse, &Char, &Shorthand)) {
+                return NULL;
+            }
+
+            if (Shorthand == 'b' || Shorthand == 'B') {
+                Node = YoriLibRegexAllocateNode(Parse, YORI_LIB_REGEX_NODE_ASSERT);
+                if (Node == NULL) {
+                    return NULL;
+                }
+                if (Shorthand == 'b') {
+                    Node->Value = YoriLibRegexOpWordBoundary;
+                } else {
+                    Node->Value = YoriLibRegexOpNotWordBoundary;
+                }
+                return Node;
+            }
+
+            if (Shorthand != 0) {
+                Bitmap = YoriLibRegexAllocateClass(Parse, &ClassIndex);
+                if (Bitmap == NULL) {
+                    return NULL;
+                }
+                YoriLibRegexAddShorthand(Bitmap, Shorthand);
+                YoriLibRegexFinishClass(Parse, Bitmap, FALSE);
+
+                //
+                //  Upper case shorthands match everything outside a class,
+                //  so they match surrogate pairs like any negated class.
+                //
+
+                if (Shorthand >= 'A' && Shorthand <= 'Z') {
+                    Node = YoriLibRegexAllocateNode(Parse, YORI_LIB_REGEX_NODE_NEGATED_CLASS);
+                } else {
+                    Node = YoriLibRegexAllocateNode(Parse, YORI_LIB_REGEX_NODE_CLASS);
+                }
+                if (Node == NULL) {
+                    return NULL;
+                }
+                Node->Value = ClassIndex;
+                return Node;
+            }
+            break;
+
+        default:
+            Parse->Offset++;
+            break;
+    }
+
+    Node = YoriLibRegexAllocateNode(Parse, YORI_LIB_REGEX_NODE_CHAR);
+    if (Node == NULL) {
+        return NULL;
+    }
+    if (Parse->Insensitive) {
+        Char = YoriLibUpcaseChar(Char);
+    }
+    Node->Value = Char;
+    return Node;
+}
+
+/**
+ Parse a decimal repetition count within braces.
+
+ @param Parse Pointer to the parse state.
+
+ @param Offset Pointer to the offset of the first digit.  On success, this
+        is advanced beyond the digits.
+
+ @param Value On successful completion, updated to contain the count.
+
+ @return TRUE to indicate a count was found, FALSE if it was not.
+ */
+__success(return)
+BOOLEAN
+YoriLibRegexParseCount(
+    __in PYORI_LIB_REGEX_PARSE Parse,
+    __inout PYORI_ALLOC_SIZE_T Offset,
+    __out PYORI_ALLOC_SIZE_T Value
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T Count;
+    TCHAR Char;
+
+    Count = 0;
+    for (Index = *Offset; Index < Parse->Pattern->LengthInChars; Index++) {
+        Char = Parse->Pattern->StartOfString[Index];
+        if (Char < '0' || Char > '9') {
+            break;
+        }
+        Count = Count * 10 + Char - '0';
+        if (Count > YORI_LIB_REGEX_MAX_REPEAT) {
+            Count = YORI_LIB_REGEX_MAX_REPEAT + 1;
+        }
+    }
+
+    if (Index == *Offset) {
+        return FALSE;
+    }
+
+    *Offset = Index;
+    *Value = Count;
+    return TRUE;
+}
+
+/**
+ Parse an item followed by any number of repetition operators.
+
+ @param Parse Pointer to the parse state.  On success, the offset is
+        advanced beyond the item and its repetition operators.
+
+ @return Pointer to the parse tree node for the item, or NULL on failure.
+ */
+PYORI_LIB_REGEX_NODE
+YoriLibRegexParseRepeat(
+    __in PYORI_LIB_REGEX_PARSE Parse
+    )
+{
+    PYORI_LIB_REGEX_NODE Node;
+    PYORI_LIB_REGEX_NODE Repeat;
+    YORI_ALLOC_SIZE_T Min;
+    YORI_ALLOC_SIZE_T Max;
+    YORI_ALLOC_SIZE_T Offset;
+    TCHAR Char;
+
+    Node = YoriLibRegexParseAtom(Parse);
+    if (Node == NULL) {
+        return NULL;
+    }
+
+    while (Parse->Offset < Parse->Pattern->LengthInChars) {
+        Char = Parse->Pattern->StartOfString[Parse->Offset];
+        if (Char == '*') {
+            Min = 0;
+            Max = YORI_LIB_REGEX_NONE;
+            Parse->Offset++;
+        } else if (Char == '+') {
+            Min = 1;
+            Max = YORI_LIB_REGEX_NONE;
+            Parse->Offset++;
+        } else if (Char == '?') {
+            Min = 0;
+            Max = 1;
+            Parse->Offset++;
+        } else if (Char == '{') {
+
+            //
+            //  A brace that does not start a valid {m}, {m,} or {m,n} is
+            //  treated as a literal character by the caller.
+            //
+
+            Offset = Parse->Offset + 1;
+            if (!YoriLibRegexParseCount(Parse, &Offset, &Min)) {
+                break;
+            }
+            Max = Min;
+            if (Offset < Parse->Pattern->LengthInChars &&
+                Parse->Pattern->StartOfString[Offset] == ',') {
+
+                Offset++;
+                if (!YoriLibRegexParseCount(Parse, &Offset, &Max)) {
+                    Max = YORI_LIB_REGEX_NONE;
+                }
+            }
+            if (Offset >= Parse->Pattern->LengthInChars ||
+                Parse->Pattern->StartOfString[Offset] != '}') {
+                break;
+            }
+            if (Min > YORI_LIB_REGEX_MAX_REPEAT ||
+                (Max != YORI_LIB_REGEX_NONE && (Max > YORI_LIB_REGEX_MAX_REPEAT || Max < Min))) {
+
+                return NULL;
+            }
+            Parse->Offset = Offset + 1;
+        } else {
+            break;
+        }
+
+        Repeat = YoriLibRegexAllocateNode(Parse, YORI_LIB_REGEX_NODE_REPEAT);
+        if (Repeat == NULL) {
+            return NULL;
+        }
+        Repeat->Child = Node;
+        Repeat->Min = Min;
+        Repeat->Max = Max;
+        Repeat->Depth = Node->Depth + 1;
+        if (Repeat->Depth > YORI_LIB_REGEX_MAX_DEPTH) {
+            return NULL;
+        }
+
+        if (Parse->Offset < Parse->Pattern->LengthInChars &&
+            Parse->Pattern->StartOfString[Parse->Offset] == '?') {
+
+            Repeat->Lazy = TRUE;
+            Parse->Offset++;
+        }
+
+        Node = Repeat;
+    }
+
+    return Node;
+}
+
+/**
+ Parse a sequence of items that are matched one after another, ending at the
+ end of the pattern, an alternation, or the end of a group.
+
+ @param Parse Pointer to the parse state.  On success, the offset is
+        advanced beyond the sequence.
+
+ @return Pointer to the parse tree node for the sequence, or NULL on
+         failure.
+ */
+PYORI_LIB_REGEX_NODE
+YoriLibRegexParseConcat(
+    __in PYORI_LIB_REGEX_PARSE Parse
+    )
+{
+    PYORI_LIB_REGEX_NODE First;
+    PYORI_LIB_REGEX_NODE Last;
+    PYORI_LIB_REGEX_NODE Node;
+    PYORI_LIB_REGEX_NODE Concat;
+    YORI_ALLOC_SIZE_T Depth;
+    TCHAR Char;
+
+    First = NULL;
+    Last = NULL;
+    Depth = 0;
+
+    while (Parse->Offset < Parse->Pattern->LengthInChars) {
+        Char = Parse->Pattern->StartOfString[Parse->Offset];
+        if (Char == '|' || Char == ')') {
+            break;
+        }
+
+        Node = YoriLibRegexParseRepeat(Parse);
+        if (Node == NULL) {
+            return NULL;
+        }
+
+        if (Node->Depth > Depth) {
+            Depth = Node->Depth;
+        }
+
+        if (First == NULL) {
+            First = Node;
+        } else {
+            Last->Next = Node;
+        }
+        Last = Node;
+    }
+
+    if (First == NULL) {
+        return YoriLibRegexAllocateNode(Parse, YORI_LIB_REGEX_NODE_EMPTY);
+    }
+
+    if (First == Last) {
+        return First;
+    }
+
+    Concat = YoriLibRegexAllocateNode(Parse, YORI_LIB_REGEX_NODE_CONCAT);
+    if (Concat == NULL) {
+        return NULL;
+    }
+    Concat->Child = First;
+    Concat->Depth = Depth + 1;
+    if (Concat->Depth > YORI_LIB_REGEX_MAX_DEPTH) {
+        return NULL;
+    }
+    return Concat;
+}
+
+/**
+ Parse a set of alternative sequences separated by |.
+
+ @param Parse Pointer to the parse state.  On success, the offset is
+        advanced beyond the alternatives.
+
+ @return Pointer to the parse tree node for the alternatives, or NULL on
+         failure.
+ */
+PYORI_LIB_REGEX_NODE
+YoriLibRegexParseAlternate(
+    __in PYORI_LIB_REGEX_PARSE Parse
+    )
+{
+    PYORI_LIB_REGEX_NODE First;
+    PYORI_LIB_REGEX_NODE Last;
+    PYORI_LIB_REGEX_NODE Node;
+    PYORI_LIB_REGEX_NODE Alternate;
+    YORI_ALLOC_SIZE_T Depth;
+
+    First = YoriLibRegexParseConcat(Parse);
+    if (First == NULL) {
+        return NULL;
+    }
+
+    if (Parse->Offset >= Parse->Pattern->LengthInChars ||
+        Parse->Pattern->StartOfString[Parse->Offset] != '|') {
+
+        return First;
+    }
+
+    Depth = First->Depth;
+    Last = First;
+    while (Parse->Offset < Parse->Pattern->LengthInChars &&
+           Parse->Pattern->StartOfString[Parse->Offset] == '|') {
+
+        Parse->Offset++;
+        Node = YoriLibRegexParseConcat(Parse);
+        if (Node == NULL) {
+            return NULL;
+        }
+        if (Node->Depth > Depth) {
+            Depth = Node->Depth;
+        }
+        Last->Next = Node;
+        Last = Node;
+    }
+
+    Alternate = YoriLibRegexAllocateNode(Parse, YORI_LIB_REGEX_NODE_ALTERNATE);
+    if (Alternate == NULL) {
+        return NULL;
+    }
+    Alternate->Child = First;
+    Alternate->Depth = Depth + 1;
+    if (Alternate->Depth > YORI_LIB_REGEX_MAX_DEPTH) {
+        return NULL;
+    }
+    return Alternate;
+}
+
+/**
+ Calculate the number of instructions needed to compile a parse tree node
+ and each of its descendants, recording the result in each node.
+
+ @param Node Pointer to the node.
+
+ @return The number of instructions, or a value greater than
+         YORI_LIB_REGEX_MAX_INSTS if the node is too large to compile.
+ */
+DWORDLONG
+YoriLibRegexMeasure(
+    __in PYORI_LIB_REGEX_NODE Node
+    )
+{
+    PYORI_LIB_REGEX_NODE Child;
+    DWORDLONG Total;
+    DWORDLONG ChildCount;
+    DWORDLONG Alternatives;
+
+    Total = 0;
+    switch(Node->Type) {
+        case YORI_LIB_REGEX_NODE_EMPTY:
+            break;
+        case YORI_LIB_REGEX_NODE_CHAR:
+        case YORI_LIB_REGEX_NODE_CLASS:
+        case YORI_LIB_REGEX_NODE_ASSERT:
+            Total = 1;
+            break;
+        case YORI_LIB_REGEX_NODE_ANY:
+        case YORI_LIB_REGEX_NODE_NEGATED_CLASS:
+
+            //
+            //  Split, high surrogate, low surrogate, jump, and the single
+            //  character form.
+            //
+
+            Total = 5;
+            break;
+        case YORI_LIB_REGEX_NODE_CONCAT:
+        case YORI_LIB_REGEX_NODE_ALTERNATE:
+            Alternatives = 0;
+            for (Child = Node->Child; Child != NULL; Child = Child->Next) {
+                Total = Total + YoriLibRegexMeasure(Child);
+                Alternatives++;
+                if (Total > YORI_LIB_REGEX_MAX_INSTS) {
+                    return Total;
+                }
+            }
+
+            //
+            //  Each alternative other than the last is preceded by a split
+            //  and followed by a jump.
+            //
+
+            if (Node->Type == YORI_LIB_REGEX_NODE_ALTERNATE) {
+                Total = Total + 2 * (Alternatives - 1);
+            }
+            break;
+        case YORI_LIB_REGEX_NODE_REPEAT:
+            ChildCount = YoriLibRegexMeasure(Node->Child);
+            if (ChildCount > YORI_LIB_REGEX_MAX_INSTS) {
+                return ChildCount;
+            }
+
+            //
+            //  The child is emitted once for each required match.  Further
+            //  optional matches are each preceded by a split.  An unbounded
+            //  repetition is a split and a jump around one copy of the
+            //  child, or if the child has already been emitted, a split
+            //  back to its start.
+            //
+
+            Total = ChildCount * Node->Min;
+            if (Node->Max == YORI_LIB_REGEX_NONE) {
+                if (Node->Min > 0) {
+                    Total = Total + 1;
+                } else {
+                    Total = Total + ChildCount + 2;
+                }
+            } else {
+                Total = Total + (ChildCount + 1) * (Node->Max - Node->Min);
+            }
+            break;
+    }
+
+    if (Total <= YORI_LIB_REGEX_MAX_INSTS) {
+        Node->InstCount = (YORI_ALLOC_SIZE_T)Total;
+    }
+    return Total;
+}
+
+/**
+ Set an instruction in a compiled expression.
+
+ @param Regex Pointer to the compiled expression.
+
+ @param Pc The index of the instruction to set.
+
+ @param Op The operation to perform.
+
+ @param Arg The first argument to the operation.
+
+ @param Alt The second argument to the operation.
+ */
+VOID
+YoriLibRegexSetInst(
+    __in PYORI_LIB_REGEX Regex,
+    __in YORI_ALLOC_SIZE_T Pc,
+    __in YORI_LIB_REGEX_OP Op,
+    __in YORI_ALLOC_SIZE_T Arg,
+    __in YORI_ALLOC_SIZE_T Alt
+    )
+{
+    ASSERT(Pc < Regex->InstCount);
+    Regex->Insts[Pc].Op = Op;
+    Regex->Insts[Pc].Arg = Arg;
+    Regex->Insts[Pc].Alt = Alt;
+}
+
+/**
+ Compile a parse tree node and its descendants into instructions.  The
+ node must have been measured with YoriLibRegexMeasure.
+
+ @param Regex Pointer to the compiled expression to populate.
+
+ @param Node Pointer to the node to compile.
+
+ @param Pc Pointer to the index of the next instruction to populate.  On
+        return, this is advanced beyond the instructions for this node.
+ */
+VOID
+YoriLibRegexEmit(
+    __in PYORI_LIB_REGEX Regex,
+    __in PYORI_LIB_REGEX_NODE Node,
+    __inout PYORI_ALLOC_SIZE_T Pc
+    )
+{
+    PYORI_LIB_REGEX_NODE Child;
+    YORI_ALLOC_SIZE_T Start;
+    YORI_ALLOC_SIZE_T End;
+    YORI_ALLOC_SIZE_T Split;
+    YORI_ALLOC_SIZE_T Count;
+    YORI_ALLOC_SIZE_T Preferred;
+    YORI_ALLOC_SIZE_T Other;
+
+    Start = *Pc;
+    End = Start + Node->InstCount;
+
+    switch(Node->Type) {
+        case YORI_LIB_REGEX_NODE_EMPTY:
+            break;
+        case YORI_LIB_REGEX_NODE_CHAR:
+            YoriLibRegexSetInst(Regex, Start, YoriLibRegexOpChar, Node->Value, 0);
+            break;
+        case YORI_LIB_REGEX_NODE_CLASS:
+            YoriLibRegexSetInst(Regex, Start, YoriLibRegexOpClass, Node->Value, 0);
+            break;
+        case YORI_LIB_REGEX_NODE_ASSERT:
+            YoriLibRegexSetInst(Regex, Start, (YORI_LIB_REGEX_OP)Node->Value, 0, 0);
+            break;
+        case YORI_LIB_REGEX_NODE_ANY:
+        case YORI_LIB_REGEX_NODE_NEGATED_CLASS:
+            YoriLibRegexSetInst(Regex, Start, YoriLibRegexOpSplit, Start + 1, Start + 4);
+            YoriLibRegexSetInst(Regex, Start + 1, YoriLibRegexOpHighSurrogate, 0, 0);
+            YoriLibRegexSetInst(Regex, Start + 2, YoriLibRegexOpLowSurrogate, 0, 0);
+            YoriLibRegexSetInst(Regex, Start + 3, YoriLibRegexOpJump, End, 0);
+            if (Node->Type == YORI_LIB_REGEX_NODE_ANY) {
+                YoriLibRegexSetInst(Regex, Start + 4, YoriLibRegexOpAny, 0, 0);
+            } else {
+                YoriLibRegexSetInst(Regex, Start + 4, YoriLibRegexOpClass, Node->Value, 0);
+            }
+            break;
+        case YORI_LIB_REGEX_NODE_CONCAT:
+            for (Child = Node->Child; Child != NULL; Child = Child->Next) {
+                YoriLibRegexEmit(Regex, Child, Pc);
+            }
+            break;
+        case YORI_LIB_REGEX_NODE_ALTERNATE:
+            for (Child = Node->Child; Child != NULL; Child = Child->Next) {
+                if (Child->Next == NULL) {
+                    YoriLibRegexEmit(Regex, Child, Pc);
+                    break;
+                }
+                Split = *Pc;
+                YoriLibRegexSetInst(Regex, Split, YoriLibRegexOpSplit, Split + 1, Split + Child->InstCount + 2);
+                *Pc = Split + 1;
+                YoriLibRegexEmit(Regex, Child, Pc);
+                YoriLibRegexSetInst(Regex, *Pc, YoriLibRegexOpJump, End, 0);
+                *Pc = *Pc + 1;
+            }
+            break;
+        case YORI_LIB_REGEX_NODE_REPEAT:
+            for (Count = 0; Count < Node->Min; Count++) {
+                YoriLibRegexEmit(Regex, Node->Child, Pc);
+            }
+
+            if (Node->Max == YORI_LIB_REGEX_NONE) {
+                if (Node->Min > 0) {
+
+                    //
+                    //  Loop back to the start of the final required copy.
+                    //
+
+                    Preferred = *Pc - Node->Child->InstCount;
+                    Other = *Pc + 1;
+                    if (Node->Lazy) {
+                        YoriLibRegexSetInst(Regex, *Pc, YoriLibRegexOpSplit, Other, Preferred);
+                    } else {
+                        YoriLibRegexSetInst(Regex, *Pc, YoriLibRegexOpSplit, Preferred, Other);
+                    }
+                    *Pc = *Pc + 1;
+                } else {
+                    Split = *Pc;
+                    Preferred = Split + 1;
+                    Other = Split + Node->Child->InstCount + 2;
+                    if (Node->Lazy) {
+                        YoriLibRegexSetInst(Regex, Split, YoriLibRegexOpSplit, Other, Preferred);
+                    } else {
+                        YoriLibRegexSetInst(Regex, Split, YoriLibRegexOpSplit, Preferred, Other);
+                    }
+                    *Pc = Split + 1;
+                    YoriLibRegexEmit(Regex, Node->Child, Pc);
+                    YoriLibRegexSetInst(Regex, *Pc, YoriLibRegexOpJump, Split, 0);
+                    *Pc = *Pc + 1;
+                }
+            } else {
+
+                //
+                //  Each optional copy can skip to the end of the whole
+                //  repetition, since if one optional copy is not matched,
+                //  later ones cannot be either.
+                //
+
+                for (Count = Node->Min; Count < Node->Max; Count++) {
+                    Split = *Pc;
+                    Preferred = Split + 1;
+                    if (Node->Lazy) {
+                        YoriLibRegexSetInst(Regex, Split, YoriLibRegexOpSplit, End, Preferred);
+                    } else {
+                        YoriLibRegexSetInst(Regex, Split, YoriLibRegexOpSplit, Preferred, End);
+                    }
+                    *Pc = Split + 1;
+                    YoriLibRegexEmit(Regex, Node->Child, Pc);
+                }
+            }
+            break;
+    }
+
+    *Pc = End;
+}
+
+/**
+ Calculate the set of characters that can begin a match, so that searches
+ can skip over characters which cannot.
+
+ @param Regex Pointer to the compiled expression.
+
+ @return TRUE to indicate success, FALSE on allocation failure.
+ */
+__success(return)
+BOOLEAN
+YoriLibRegexFindFirstChars(
+    __in PYORI_LIB_REGEX Regex
+    )
+{
+    PYORI_ALLOC_SIZE_T Stack;
+    PUCHAR Visited;
+    PYORI_LIB_REGEX_INST Inst;
+    PDWORD Bitmap;
+    YORI_ALLOC_SIZE_T StackCount;
+    YORI_ALLOC_SIZE_T Pc;
+    DWORD Index;
+
+    Stack = YoriLibMalloc((Regex->InstCount * 2 + 1) * sizeof(YORI_ALLOC_SIZE_T) + Regex->InstCount);
+    if (Stack == NULL) {
+        return FALSE;
+    }
+    Visited = (PUCHAR)&Stack[Regex->InstCount * 2 + 1];
+    ZeroMemory(Visited, Regex->InstCount);
+    ZeroMemory(Regex->FirstChars, sizeof(Regex->FirstChars));
+    Regex->AnyFirstChar = FALSE;
+
+    //
+    //  Follow every path from the first instruction that does not consume
+    //  a character.  Assertions might succeed, so are followed too.
+    //
+
+    Stack[0] = 0;
+    StackCount = 1;
+    while (StackCount > 0 && !Regex->AnyFirstChar) {
+        StackCount--;
+        Pc = Stack[StackCount];
+        if (Visited[Pc]) {
+            continue;
+        }
+        Visited[Pc] = TRUE;
+        Inst = &Regex->Insts[Pc];
+        switch(Inst->Op) {
+            case YoriLibRegexOpChar:
+                YORI_LIB_REGEX_SET_BIT(Regex->FirstChars, Inst->Arg);
+                break;
+            case YoriLibRegexOpClass:
+                Bitmap = &Regex->Classes[Inst->Arg * YORI_LIB_REGEX_BITMAP_DWORDS];
+                for (Index = 0; Index < YORI_LIB_REGEX_BITMAP_DWORDS; Index++) {
+                    Regex->FirstChars[Index] |= Bitmap[Index];
+                }
+                break;
+            case YoriLibRegexOpHighSurrogate:
+                for (Index = 0xD800; Index < 0xDC00; Index++) {
+                    YORI_LIB_REGEX_SET_BIT(Regex->FirstChars, Index);
+                }
+                break;
+            case YoriLibRegexOpLowSurrogate:
+                for (Index = 0xDC00; Index < 0xE000; Index++) {
+                    YORI_LIB_REGEX_SET_BIT(Regex->FirstChars, Index);
+                }
+                break;
+            case YoriLibRegexOpAny:
+            case YoriLibRegexOpMatch:
+                Regex->AnyFirstChar = TRUE;
+                break;
+            case YoriLibRegexOpSplit:
+                Stack[StackCount] = Inst->Alt;
+                StackCount++;
+                Stack[StackCount] = Inst->Arg;
+                StackCount++;
+                break;
+            case YoriLibRegexOpJump:
+                Stack[StackCount] = Inst->Arg;
+                StackCount++;
+                break;
+            default:
+                Stack[StackCount] = Pc + 1;
+                StackCount++;
+                break;
+        }
+    }
+
+    YoriLibFree(Stack);
+    return TRUE;
+}
+
+/**
+ Compile a set of regular expressions into a single program which can
+ locate a match for any of them in a single pass over a string.  The
+ compiled expression records a pointer to PatternArray so that matches can
+ be returned in terms of the original array, so the array must remain valid
+ while the compiled expression is in use, but the strings within the array
+ can be modified or freed.
+
+ The supported syntax consists of literal characters, . for any character
+ other than a newline, bracketed classes such as [a-z] or [^0-9], the
+ shorthand classes \d, \s and \w and their negated forms, ^ and $ to match
+ the start and end of the string, \b and \B to match word boundaries,
+ groups with ( and ), alternation with |, and repetition with *, +, ?, {m},
+ {m,} and {m,n}, each of which can be followed by ? to match as few times
+ as possible.  Characters can be escaped with \, or specified with \t, \n,
+ \r, \e, \xHH or \uHHHH.
+
+ @param NumberPatterns The number of patterns to compile.
+
+ @param PatternArray An array of strings containing the patterns.
+
+ @param Insensitive TRUE if matches should be found case insensitively, FALSE
+        if they should be found case sensitively.
+
+ @param ErrorPattern If the expression could not be compiled, optionally
+        points to a value updated to contain the index of the invalid
+        pattern, or (YORI_ALLOC_SIZE_T)-1 on allocation failure.
+
+ @param ErrorOffset If the expression could not be compiled, optionally
+        points to a value updated to contain the offset within the invalid
+        pattern of the character which could not be parsed.
+
+ @return Pointer to the compiled expression, or NULL on failure.  The
+         caller should free this with YoriLibFreeRegex.
+ */
+PYORI_LIB_REGEX
+YoriLibAllocateRegex(
+    __in YORI_ALLOC_SIZE_T NumberPatterns,
+    __in PYORI_STRING PatternArray,
+    __in BOOLEAN Insensitive,
+    __out_opt PYORI_ALLOC_SIZE_T ErrorPattern,
+    __out_opt PYORI_ALLOC_SIZE_T ErrorOffset
+    )
+{
+    YORI_LIB_REGEX_PARSE Parse;
+    PYORI_LIB_REGEX Regex;
+    PYORI_LIB_REGEX_NODE *Roots;
+    YORI_MAX_UNSIGNED_T NodesNeeded;
+    DWORDLONG InstCount;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T Pc;
+    YORI_ALLOC_SIZE_T Split;
+
+    if (ErrorPattern != NULL) {
+        *ErrorPattern = YORI_LIB_REGEX_NONE;
+    }
+    if (ErrorOffset != NULL) {
+        *ErrorOffset = 0;
+    }
+
+    if (NumberPatterns == 0) {
+        return NULL;
+    }
+
+    ZeroMemory(&Parse, sizeof(Parse));
+    Parse.Insensitive = Insensitive;
+    Regex = NULL;
+    Roots = NULL;
+
+    //
+    //  Each character in a pattern can generate at most three nodes, for
+    //  example an empty alternative on either side of a |, so allocate
+    //  enough nodes for the worst case.
+    //
+
+    NodesNeeded = 0;
+    for (Index = 0; Index < NumberPatterns; Index++) {
+        NodesNeeded = NodesNeeded + 3 * (YORI_MAX_UNSIGNED_T)PatternArray[Index].LengthInChars + 4;
+    }
+    NodesNeeded = NodesNeeded * sizeof(YORI_LIB_REGEX_NODE) + NumberPatterns * sizeof(PYORI_LIB_REGEX_NODE);
+    if (!YoriLibIsSizeAllocatable(NodesNeeded)) {
+        return NULL;
+    }
+
+    Roots = YoriLibMalloc((YORI_ALLOC_SIZE_T)NodesNeeded);
+    if (Roots == NULL) {
+        return NULL;
+    }
+    Parse.Nodes = (PYORI_LIB_REGEX_NODE)&Roots[NumberPatterns];
+    Parse.NodesAllocated = (YORI_ALLOC_SIZE_T)((NodesNeeded - NumberPatterns * sizeof(PYORI_LIB_REGEX_NODE)) / sizeof(YORI_LIB_REGEX_NODE));
+
+    //
+    //  Parse each pattern, and count the instructions needed to compile
+    //  it.  The program starts with a split for each pattern other than
+    //  the last, and each pattern ends with a match instruction.
+    //
+
+    InstCount = NumberPatterns - 1;
+    for (Index = 0; Index < NumberPatterns; Index++) {
+        Parse.Pattern = &PatternArray[Index];
+        Parse.Offset = 0;
+        Parse.GroupDepth = 0;
+        Roots[Index] = YoriLibRegexParseAlternate(&Parse);
+        if (Roots[Index] == NULL || Parse.Offset < Parse.Pattern->LengthInChars) {
+            if (ErrorPattern != NULL && !Parse.OutOfMemory) {
+                *ErrorPattern = Index;
+            }
+            if (ErrorOffset != NULL) {
+                *ErrorOffset = Parse.Offset;
+            }
+            goto Exit;
+        }
+
+        InstCount = InstCount + YoriLibRegexMeasure(Roots[Index]) + 1;
+        if (InstCount > YORI_LIB_REGEX_MAX_INSTS) {
+            if (ErrorPattern != NULL) {
+                *ErrorPattern = Index;
+            }
+            goto Exit;
+        }
+    }
+
+    Regex = YoriLibMalloc(sizeof(YORI_LIB_REGEX) + (YORI_ALLOC_SIZE_T)InstCount * sizeof(YORI_LIB_REGEX_INST));
+    if (Regex == NULL) {
+        goto Exit;
+    }
+
+    ZeroMemory(Regex, sizeof(YORI_LIB_REGEX));
+    Regex->PatternArray = PatternArray;
+    Regex->NumberPatterns = NumberPatterns;
+    Regex->Insensitive = Insensitive;
+    Regex->InstCount = (YORI_ALLOC_SIZE_T)InstCount;
+    Regex->Insts = (PYORI_LIB_REGEX_INST)(Regex + 1);
+    Regex->Classes = Parse.Classes;
+    Regex->ClassCount = Parse.ClassCount;
+    Parse.Classes = NULL;
+
+    Pc = 0;
+    for (Index = 0; Index < NumberPatterns; Index++) {
+        Split = Pc;
+        if (Index + 1 < NumberPatterns) {
+            Pc++;
+        }
+        YoriLibRegexEmit(Regex, Roots[Index], &Pc);
+        YoriLibRegexSetInst(Regex, Pc, YoriLibRegexOpMatch, Index, 0);
+        Pc++;
+        if (Index + 1 < NumberPatterns) {
+            YoriLibRegexSetInst(Regex, Split, YoriLibRegexOpSplit, Split + 1, Pc);
+        }
+    }
+    ASSERT(Pc == Regex->InstCount);
+
+    if (!YoriLibRegexFindFirstChars(Regex)) {
+        YoriLibFreeRegex(Regex);
+        Regex = NULL;
+    }
+
+Exit:
+    if (Parse.Classes != NULL) {
+        YoriLibFree(Parse.Classes);
+    }
+    YoriLibFree(Roots);
+    return Regex;
+}
+
+/**
+ Free a compiled expression allocated with YoriLibAllocateRegex.
+
+ @param Regex Pointer to the compiled expression to free.
+ */
+VOID
+YoriLibFreeRegex(
+    __in PYORI_LIB_REGEX Regex
+    )
+{
+    if (Regex->Classes != NULL) {
+        YoriLibFree(Regex->Classes);
+    }
+    YoriLibFree(Regex);
+}
+
+/**
+ Prepare to search a string with a compiled expression.
+
+ @param Regex Pointer to the compiled expression.
+
+ @param Search Pointer to the search state to initialize.
+
+ @param Buffer Pointer to a buffer which can be used for the search state
+        if it is large enough.
+
+ @param BufferSize The size of Buffer, in bytes.
+
+ @return TRUE to indicate success, FALSE on allocation failure.
+ */
+__success(return)
+BOOLEAN
+YoriLibRegexInitializeSearch(
+    __in PYORI_LIB_REGEX Regex,
+    __out PYORI_LIB_REGEX_SEARCH Search,
+    __in PVOID Buffer,
+    __in DWORD BufferSize
+    )
+{
+    YORI_MAX_UNSIGNED_T BytesNeeded;
+    PUCHAR Memory;
+
+    //
+    //  Each thread list can hold each instruction once.  The stack can hold
+    //  both targets of each split.
+    //
+
+    BytesNeeded = (YORI_MAX_UNSIGNED_T)Regex->InstCount * sizeof(DWORD) +
+                  (YORI_MAX_UNSIGNED_T)Regex->InstCount * 2 * sizeof(YORI_LIB_REGEX_THREAD) +
+                  ((YORI_MAX_UNSIGNED_T)Regex->InstCount * 2 + 2) * sizeof(YORI_LIB_REGEX_THREAD);
+
+    Search->Allocation = NULL;
+    if (BytesNeeded <= BufferSize) {
+        Memory = Buffer;
+    } else {
+        if (!YoriLibIsSizeAllocatable(BytesNeeded)) {
+            return FALSE;
+        }
+        Search->Allocation = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesNeeded);
+        if (Search->Allocation == NULL) {
+            return FALSE;
+        }
+        Memory = Search->Allocation;
+    }
+
+    Search->Current = (PYORI_LIB_REGEX_THREAD)Memory;
+    Search->Next = &Search->Current[Regex->InstCount];
+    Search->Stack = &Search->Next[Regex->InstCount];
+    Search->Marks = (PDWORD)&Search->Stack[Regex->InstCount * 2 + 2];
+    ZeroMemory(Search->Marks, Regex->InstCount * sizeof(DWORD));
+    Search->CurrentCount = 0;
+    Search->NextCount = 0;
+    Search->Generation = 1;
+    Search->CurrentGeneration = 1;
+
+    return TRUE;
+}
+
+/**
+ Add a thread to a thread list, following any instructions that consume no
+ characters.  Threads reached through preferred paths are added to the list
+ before threads reached through less preferred paths.
+
+ @param Regex Pointer to the compiled expression.
+
+ @param Search Pointer to the search state.
+
+ @param List The thread list to add to.
+
+ @param ListCount Pointer to the number of threads in List, updated on
+        return.
+
+ @param Generation The generation of List.  Instructions that have already
+        been added to the list in this generation are not added again.
+
+ @param Pc The instruction for the thread to execute.
+
+ @param Start The offset in the string where the thread's match started.
+
+ @param String The string being searched.
+
+ @param Offset The offset within the string of the next character for the
+        thread to process.
+ */
+VOID
+YoriLibRegexAddThread(
+    __in PYORI_LIB_REGEX Regex,
+    __in PYORI_LIB_REGEX_SEARCH Search,
+    __in PYORI_LIB_REGEX_THREAD List,
+    __inout PYORI_ALLOC_SIZE_T ListCount,
+    __in DWORD Generation,
+    __in YORI_ALLOC_SIZE_T Pc,
+    __in YORI_ALLOC_SIZE_T Start,
+    __in PCYORI_STRING String,
+    __in YORI_ALLOC_SIZE_T Offset
+    )
+{
+    PYORI_LIB_REGEX_INST Inst;
+    YORI_ALLOC_SIZE_T StackCount;
+    BOOLEAN WordBefore;
+    BOOLEAN WordAfter;
+
+    Search->Stack[0].Pc = Pc;
+    StackCount = 1;
+
+    while (StackCount > 0) {
+        StackCount--;
+        Pc = Search->Stack[StackCount].Pc;
+        if (Search->Marks[Pc] == Generation) {
+            continue;
+        }
+        Search->Marks[Pc] = Generation;
+
+        Inst = &Regex->Insts[Pc];
+        switch(Inst->Op) {
+            case YoriLibRegexOpJump:
+                Search->Stack[StackCount].Pc = Inst->Arg;
+                StackCount++;
+                break;
+            case YoriLibRegexOpSplit:
+                Search->Stack[StackCount].Pc = Inst->Alt;
+                StackCount++;
+                Search->Stack[StackCount].Pc = Inst->Arg;
+                StackCount++;
+                break;
+            case YoriLibRegexOpLineStart:
+                if (Offset == 0) {
+                    Search->Stack[StackCount].Pc = Pc + 1;
+                    StackCount++;
+                }
+                break;
+            case YoriLibRegexOpLineEnd:
+                if (Offset == String->LengthInChars) {
+                    Search->Stack[StackCount].Pc = Pc + 1;
+                    StackCount++;
+                }
+                break;
+            case YoriLibRegexOpWordBoundary:
+            case YoriLibRegexOpNotWordBoundary:
+                WordBefore = FALSE;
+                WordAfter = FALSE;
+                if (Offset > 0) {
+                    WordBefore = YoriLibRegexIsWordChar(String->StartOfString[Offset - 1]);
+                }
+                if (Offset < String->LengthInChars) {
+                    WordAfter = YoriLibRegexIsWordChar(String->StartOfString[Offset]);
+                }
+                if ((WordBefore != WordAfter) == (Inst->Op == YoriLibRegexOpWordBoundary)) {
+                    Search->Stack[StackCount].Pc = Pc + 1;
+                    StackCount++;
+                }
+                break;
+            default:
+                List[*ListCount].Pc = Pc;
+                List[*ListCount].Start = Start;
+                *ListCount = *ListCount + 1;
+                break;
+        }
+    }
+}
+
+/**
+ Check whether an instruction which consumes a character matches the
+ character.
+
+ @param Regex Pointer to the compiled expression.
+
+ @param Inst Pointer to the instruction.
+
+ @param Char The character, which has been upcased if the expression is
+        case insensitive.
+
+ @return TRUE if the instruction matches the character, FALSE if it does
+         not.
+ */
+BOOLEAN
+YoriLibRegexCharMatches(
+    __in PYORI_LIB_REGEX Regex,
+    __in PYORI_LIB_REGEX_INST Inst,
+    __in TCHAR Char
+    )
+{
+    PDWORD Bitmap;
+
+    switch(Inst->Op) {
+        case YoriLibRegexOpChar:
+            return (BOOLEAN)(Char == Inst->Arg);
+        case YoriLibRegexOpAny:
+            return (BOOLEAN)(Char != '\n');
+        case YoriLibRegexOpClass:
+            Bitmap = &Regex->Classes[Inst->Arg * YORI_LIB_REGEX_BITMAP_DWORDS];
+            return (BOOLEAN)YORI_LIB_REGEX_TEST_BIT(Bitmap, Char);
+        case YoriLibRegexOpHighSurrogate:
+            return (BOOLEAN)(Char >= 0xD800 && Char < 0xDC00);
+        case YoriLibRegexOpLowSurrogate:
+            return (BOOLEAN)(Char >= 0xDC00 && Char < 0xE000);
+    }
+
+    return FALSE;
+}
+
+/**
+ Search a string for the first match of any of the patterns in a compiled
+ expression.  The match which starts earliest in the string is returned.
+ If more than one pattern matches at that offset, the earliest pattern in
+ the array is returned.  Within a pattern, repetitions match as many times
+ as possible unless they are lazy, and earlier alternatives are preferred
+ to later ones.
+
+ @param Regex Pointer to the compiled expression.
+
+ @param String The string to search through.  ^ matches at the start of
+        this string and $ at its end.
+
+ @param StartOffset The offset within the string to start searching from.
+        Characters before this offset are used only to evaluate ^ and \b.
+
+ @param StringOffsetOfMatch On successful completion, optionally updated to
+        contain the offset within String of the match.
+
+ @param LengthOfMatch On successful completion, optionally updated to
+        contain the number of characters matched.
+
+ @return A pointer to the pattern that was found, or NULL if no match was
+         found.
+ */
+PYORI_STRING
+YoriLibRegexFindFirst(
+    __in PYORI_LIB_REGEX Regex,
+    __in PCYORI_STRING String,
+    __in YORI_ALLOC_SIZE_T StartOffset,
+    __out_opt PYORI_ALLOC_SIZE_T StringOffsetOfMatch,
+    __out_opt PYORI_ALLOC_SIZE_T LengthOfMatch
+    )
+{
+    YORI_LIB_REGEX_SEARCH Search;
+    DWORD Buffer[YORI_LIB_REGEX_STACK_BUFFER / sizeof(DWORD)];
+    PYORI_LIB_REGEX_THREAD Swap;
+    PYORI_LIB_REGEX_INST Inst;
+    YORI_ALLOC_SIZE_T Offset;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T FoundIndex;
+    YORI_ALLOC_SIZE_T FoundStart;
+    YORI_ALLOC_SIZE_T FoundEnd;
+    DWORD NextGeneration;
+    TCHAR Char;
+
+    FoundIndex = YORI_LIB_REGEX_NONE;
+    FoundStart = 0;
+    FoundEnd = 0;
+
+    if (StartOffset > String->LengthInChars ||
+        !YoriLibRegexInitializeSearch(Regex, &Search, Buffer, sizeof(Buffer))) {
+
+        goto Exit;
+    }
+
+    Offset = StartOffset;
+    while (TRUE) {
+
+        //
+        //  If nothing is in progress, skip to the next character which
+        //  could start a match.  If there isn't one, no match will be
+        //  found.
+        //
+
+        if (FoundIndex == YORI_LIB_REGEX_NONE) {
+            if (Search.CurrentCount == 0 && !Regex->AnyFirstChar) {
+                while (Offset < String->LengthInChars) {
+                    Char = String->StartOfString[Offset];
+                    if (Regex->Insensitive) {
+                        Char = YoriLibUpcaseChar(Char);
+                    }
+                    if (YORI_LIB_REGEX_TEST_BIT(Regex->FirstChars, Char)) {
+                        break;
+                    }
+                    Offset++;
+                }
+
+                if (Offset >= String->LengthInChars) {
+                    break;
+                }
+
+                Search.Generation++;
+                Search.CurrentGeneration = Search.Generation;
+            }
+
+            //
+            //  Start a new thread at this offset, which has lower priority
+            //  than any thread that started earlier.
+            //
+
+            YoriLibRegexAddThread(Regex, &Search, Search.Current, &Search.CurrentCount, Search.CurrentGeneration, 0, Offset, String, Offset);
+        }
+
+        if (Search.CurrentCount == 0 && (FoundIndex != YORI_LIB_REGEX_NONE || Offset >= String->LengthInChars)) {
+            break;
+        }
+
+        Char = 0;
+        if (Offset < String->LengthInChars) {
+            Char = String->StartOfString[Offset];
+            if (Regex->Insensitive) {
+                Char = YoriLibUpcaseChar(Char);
+            }
+        }
+
+        Search.Generation++;
+        NextGeneration = Search.Generation;
+        Search.NextCount = 0;
+
+        for (Index = 0; Index < Search.CurrentCount; Index++) {
+            Inst = &Regex->Insts[Search.Current[Index].Pc];
+            if (Inst->Op == YoriLibRegexOpMatch) {
+
+                //
+                //  This match is preferred to anything that any lower
+                //  priority thread might find, so stop processing them.
+                //  Higher priority threads may still find a preferred
+                //  match.
+                //
+
+                FoundIndex = Inst->Arg;
+                FoundStart = Search.Current[Index].Start;
+                FoundEnd = Offset;
+                break;
+            }
+
+            if (Offset < String->LengthInChars &&
+                YoriLibRegexCharMatches(Regex, Inst, Char)) {
+
+                YoriLibRegexAddThread(Regex, &Search, Search.Next, &Search.NextCount, NextGeneration, Search.Current[Index].Pc + 1, Search.Current[Index].Start, String, Offset + 1);
+            }
+        }
+
+        if (Offset >= String->LengthInChars) {
+            break;
+        }
+
+        Swap = Search.Current;
+        Search.Current = Search.Next;
+        Search.Next = Swap;
+        Search.CurrentCount = Search.NextCount;
+        Search.CurrentGeneration = NextGeneration;
+        Offset++;
+    }
+
+    if (Search.Allocation != NULL) {
+        YoriLibFree(Search.Allocation);
+    }
+
+Exit:
+    if (FoundIndex == YORI_LIB_REGEX_NONE) {
+        if (StringOffsetOfMatch != NULL) {
+            *StringOffsetOfMatch = 0;
+        }
+        if (LengthOfMatch != NULL) {
+            *LengthOfMatch = 0;
+        }
+        return NULL;
+    }
+
+    if (StringOffsetOfMatch != NULL) {
+        *StringOffsetOfMatch = FoundStart;
+    }
+    if (LengthOfMatch != NULL) {
+        *LengthOfMatch = FoundEnd - FoundStart;
+    }
+    return &Regex->PatternArray[FoundIndex];
+}
+
+/**
+ Search a string for the earliest pattern in a compiled expression which
+ matches anywhere in the string.  This differs from YoriLibRegexFindFirst
+ which returns the match that occurs earliest in the string.
+
+ @param Regex Pointer to the compiled expression.
+
+ @param String The string to search through.
+
+ @param StringOffsetOfMatch On successful completion, optionally updated to
+        contain the offset within String of a match of the returned pattern.
+
+ @return A pointer to the pattern that was found, or NULL if no match was
+         found.
+ */
+PYORI_STRING
+YoriLibRegexFindLowestEntry(
+    __in PYORI_LIB_REGEX Regex,
+    __in PCYORI_STRING String,
+    __out_opt PYORI_ALLOC_SIZE_T StringOffsetOfMatch
+    )
+{
+    YORI_LIB_REGEX_SEARCH Search;
+    DWORD Buffer[YORI_LIB_REGEX_STACK_BUFFER / sizeof(DWORD)];
+    PYORI_LIB_REGEX_THREAD Swap;
+    PYORI_LIB_REGEX_INST Inst;
+    YORI_ALLOC_SIZE_T Offset;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T BestIndex;
+    YORI_ALLOC_SIZE_T BestStart;
+    DWORD NextGeneration;
+    TCHAR Char;
+
+    BestIndex = YORI_LIB_REGEX_NONE;
+    BestStart = 0;
+
+    if (!YoriLibRegexInitializeSearch(Regex, &Search, Buffer, sizeof(Buffer))) {
+        goto Exit;
+    }
+
+    Offset = 0;
+    while (BestIndex != 0) {
+
+        if (Search.CurrentCount == 0 && !Regex->AnyFirstChar) {
+            while (Offset < String->LengthInChars) {
+                Char = String->StartOfString[Offset];
+                if (Regex->Insensitive) {
+                    Char = YoriLibUpcaseChar(Char);
+                }
+                if (YORI_LIB_REGEX_TEST_BIT(Regex->FirstChars, Char)) {
+                    break;
+                }
+                Offset++;
+            }
+
+            if (Offset >= String->LengthInChars) {
+                break;
+            }
+
+            Search.Generation++;
+            Search.CurrentGeneration = Search.Generation;
+        }
+
+        YoriLibRegexAddThread(Regex, &Search, Search.Current, &Search.CurrentCount, Search.CurrentGeneration, 0, Offset, String, Offset);
+
+        Char = 0;
+        if (Offset < String->LengthInChars) {
+            Char = String->StartOfString[Offset];
+            if (Regex->Insensitive) {
+                Char = YoriLibUpcaseChar(Char);
+            }
+        }
+
+        Search.Generation++;
+        NextGeneration = Search.Generation;
+        Search.NextCount = 0;
+
+        //
+        //  Every thread is processed, since a lower priority thread may
+        //  find a match for an earlier pattern.
+        //
+
+        for (Index = 0; Index < Search.CurrentCount; Index++) {
+            Inst = &Regex->Insts[Search.Current[Index].Pc];
+            if (Inst->Op == YoriLibRegexOpMatch) {
+                if (Inst->Arg < BestIndex) {
+                    BestIndex = Inst->Arg;
+                    BestStart = Search.Current[Index].Start;
+                }
+                continue;
+            }
+
+            if (Offset < String->LengthInChars &&
+                YoriLibRegexCharMatches(Regex, Inst, Char)) {
+
+                YoriLibRegexAddThread(Regex, &Search, Search.Next, &Search.NextCount, NextGeneration, Search.Current[Index].Pc + 1, Search.Current[Index].Start, String, Offset + 1);
+            }
+        }
+
+        if (Offset >= String->LengthInChars) {
+            break;
+        }
+
+        Swap = Search.Current;
+        Search.Current = Search.Next;
+        Search.Next = Swap;
+        Search.CurrentCount = Search.NextCount;
+        Search.CurrentGeneration = NextGeneration;
+        Offset++;
+    }
+
+    if (Search.Allocation != NULL) {
+        YoriLibFree(Search.Allocation);
+    }
+
+Exit:
+    if (BestIndex == YORI_LIB_REGEX_NONE) {
+        if (StringOffsetOfMatch != NULL) {
+            *StringOffsetOfMatch = 0;
+        }
+        return NULL;
+    }
+
+    if (StringOffsetOfMatch != NULL) {
+        *StringOffsetOfMatch = BestStart;
+    }
+    return &Regex->PatternArray[BestIndex];
+}
+
+// vim:sw=4:ts=4:et:
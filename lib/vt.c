@@ -4,7 +4,7 @@
  * Convert VT100/ANSI escape sequences into other formats, including the 
  * console.
  *
- * Copyright (c) 2015-2021 Malcolm J. Smith
+ * Copyright (c) 2015-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -997,6 +997,48 @@ YoriLibProcVtEscOnNewStream(
     return Result;
 }
 
+/**
+ Select the callback functions used to output text to a device, based on
+ whether the device is a console and how the caller wants escapes handled.
+
+ @param hOut The device to output to.
+
+ @param Flags Flags, indicating behavior.
+
+ @param Callbacks On completion, populated with the callback functions to
+        use.
+ */
+VOID
+YoriLibOutputSetFnForDevice(
+    __in HANDLE hOut,
+    __in WORD Flags,
+    __out PYORI_LIB_VT_CALLBACK_FUNCTIONS Callbacks
+    )
+{
+    DWORD CurrentMode;
+
+    //
+    //  Check if we're writing to a console supporting color or a file
+    //  that doesn't
+    //
+
+    if (hOut == YORI_LIB_DEBUGGER_HANDLE) {
+        YoriLibDbgSetFn(Callbacks);
+    } else if (GetConsoleMode(hOut, &CurrentMode)) {
+        if ((Flags & YORI_LIB_OUTPUT_STRIP_VT) != 0) {
+            YoriLibConsoleNoEscSetFn(Callbacks);
+        } else if ((Flags & YORI_LIB_OUTPUT_PASSTHROUGH_VT) != 0) {
+            YoriLibConsoleIncludeEscSetFn(Callbacks);
+        } else {
+            YoriLibConsoleSetFn(Callbacks);
+        }
+    } else if ((Flags & YORI_LIB_OUTPUT_STRIP_VT) != 0) {
+        YoriLibUtf8TextNoEscSetFn(Callbacks);
+    } else {
+        YoriLibUtf8TextWithEscSetFn(Callbacks);
+    }
+}
+
 /**
  Output a printf-style formatted string to the specified output stream.
 
@@ -1027,33 +1069,13 @@ YoriLibOutputInternal(
     TCHAR stack_buf[64];
     TCHAR * buf;
     YORI_LIB_VT_CALLBACK_FUNCTIONS Callbacks;
-    DWORD CurrentMode;
     BOOL Result;
 
 #ifdef __WATCOMC__
     savedmarker[0] = marker[0];
 #endif
 
-    //
-    //  Check if we're writing to a console supporting color or a file
-    //  that doesn't
-    //
-
-    if (hOut == YORI_LIB_DEBUGGER_HANDLE) {
-        YoriLibDbgSetFn(&Callbacks);
-    } else if (GetConsoleMode(hOut, &CurrentMode)) {
-        if ((Flags & YORI_LIB_OUTPUT_STRIP_VT) != 0) {
-            YoriLibConsoleNoEscSetFn(&Callbacks);
-        } else if ((Flags & YORI_LIB_OUTPUT_PASSTHROUGH_VT) != 0) {
-            YoriLibConsoleIncludeEscSetFn(&Callbacks);
-        } else {
-            YoriLibConsoleSetFn(&Callbacks);
-        }
-    } else if ((Flags & YORI_LIB_OUTPUT_STRIP_VT) != 0) {
-        YoriLibUtf8TextNoEscSetFn(&Callbacks);
-    } else {
-        YoriLibUtf8TextWithEscSetFn(&Callbacks);
-    }
+    YoriLibOutputSetFnForDevice(hOut, Flags, &Callbacks);
 
     len = YoriLibVSPrintfSize(szFmt, marker);
 
@@ -1136,31 +1158,75 @@ YoriLibOutputString(
     )
 {
     YORI_LIB_VT_CALLBACK_FUNCTIONS Callbacks;
-    DWORD CurrentMode;
     BOOL Result;
 
-    //
-    //  Check if we're writing to a console supporting color or a file
-    //  that doesn't
-    //
+    YoriLibOutputSetFnForDevice(hOut, Flags, &Callbacks);
 
-    if (GetConsoleMode(hOut, &CurrentMode)) {
-        if ((Flags & YORI_LIB_OUTPUT_STRIP_VT) != 0) {
-            YoriLibConsoleNoEscSetFn(&Callbacks);
-        } else if ((Flags & YORI_LIB_OUTPUT_PASSTHROUGH_VT) != 0) {
-            YoriLibConsoleIncludeEscSetFn(&Callbacks);
-        } else {
-            YoriLibConsoleSetFn(&Callbacks);
+    Result = YoriLibProcVtEscOnNewStream(String->StartOfString, String->LengthInChars, hOut, &Callbacks);
+
+    return Result;
+}
+
+/**
+ Output a buffer of 7 bit ASCII text, such as generated encoded text, to a
+ specified device.  If the device is not a console and the output encoding
+ is a superset of ASCII, the bytes are written unchanged.  Otherwise the text
+ is widened and written with @ref YoriLibOutputString so it is converted to
+ the console or the active output encoding.
+
+ @param hOut The output stream to write any result to.
+
+ @param Text Pointer to the ASCII text to output.
+
+ @param Length The number of bytes in Text.
+
+ @param Buffer Pointer to a string used to widen the text.  This is
+        reallocated if it is too small, allowing callers writing repeatedly
+        to reuse one allocation.  The caller should free it when finished.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibOutputAsciiToDevice(
+    __in HANDLE hOut,
+    __in_ecount(Length) CONST UCHAR * Text,
+    __in YORI_ALLOC_SIZE_T Length,
+    __inout PYORI_STRING Buffer
+    )
+{
+    DWORD CurrentMode;
+    DWORD BytesWritten;
+    YORI_ALLOC_SIZE_T BytesSent;
+    YORI_ALLOC_SIZE_T Index;
+
+    if (hOut != YORI_LIB_DEBUGGER_HANDLE &&
+        !GetConsoleMode(hOut, &CurrentMode) &&
+        YoriLibGetMultibyteOutputEncoding() != CP_UTF16) {
+
+        BytesSent = 0;
+        while (BytesSent < Length) {
+            if (!WriteFile(hOut, YoriLibAddToPointer(Text, BytesSent), Length - BytesSent, &BytesWritten, NULL)) {
+                return FALSE;
+            }
+            BytesSent = BytesSent + (YORI_ALLOC_SIZE_T)BytesWritten;
         }
-    } else if ((Flags & YORI_LIB_OUTPUT_STRIP_VT) != 0) {
-        YoriLibUtf8TextNoEscSetFn(&Callbacks);
-    } else {
-        YoriLibUtf8TextWithEscSetFn(&Callbacks);
+        return TRUE;
     }
 
-    Result = YoriLibProcVtEscOnNewStream(String->StartOfString, String->LengthInChars, hOut, &Callbacks);
+    if (Buffer->LengthAllocated < Length) {
+        YoriLibFreeStringContents(Buffer);
+        if (!YoriLibAllocateString(Buffer, Length)) {
+            return FALSE;
+        }
+    }
 
-    return Result;
+    for (Index = 0; Index < Length; Index++) {
+        Buffer->StartOfString[Index] = Text[Index];
+    }
+    Buffer->LengthInChars = Length;
+
+    return YoriLibOutputString(hOut, 0, Buffer);
 }
 
 /**
@@ -1191,6 +1257,277 @@ YoriLibOutputToDevice(
     return Result;
 }
 
+/**
+ Prepare a stream to buffer output to a device.  The decision about how to
+ output to the device is made once here rather than for each write, and
+ text is accumulated until the buffer is full or the stream is flushed.
+ The caller must flush the stream before writing to the device by other
+ means, and must close it when output is complete.
+
+ @param Stream Pointer to the stream to initialize.
+
+ @param hOut The device to output to.
+
+ @param Flags Flags, indicating behavior, as for YoriLibOutputToDevice.
+
+ @param FlushSize The number of characters to accumulate before writing to
+        the device.  If zero, a default size is used.
+ */
+VOID
+YoriLibOutputStreamInitializeForDevice(
+    __out PYORI_LIB_OUTPUT_STREAM Stream,
+    __in HANDLE hOut,
+    __in WORD Flags,
+    __in YORI_ALLOC_SIZE_T FlushSize
+    )
+{
+    Stream->hOutput = hOut;
+    Stream->Flags = Flags;
+    if (FlushSize == 0) {
+        FlushSize = YORI_LIB_OUTPUT_STREAM_DEFAULT_FLUSH;
+    }
+    Stream->FlushSize = FlushSize;
+    YoriLibInitEmptyString(&Stream->Buffer);
+    YoriLibOutputSetFnForDevice(hOut, Flags, &Stream->Callbacks);
+}
+
+/**
+ Prepare a stream to buffer output to standard output, standard error or the
+ debugger.
+
+ @param Stream Pointer to the stream to initialize.
+
+ @param Flags Flags, indicating the output device and its behavior, as for
+        YoriLibOutput.
+
+ @param FlushSize The number of characters to accumulate before writing to
+        the device.  If zero, a default size is used.
+ */
+VOID
+YoriLibOutputStreamInitialize(
+    __out PYORI_LIB_OUTPUT_STREAM Stream,
+    __in WORD Flags,
+    __in YORI_ALLOC_SIZE_T FlushSize
+    )
+{
+    HANDLE hOut;
+
+    if ((Flags & YORI_LIB_OUTPUT_STDERR) != 0) {
+        hOut = GetStdHandle(STD_ERROR_HANDLE);
+    } else if ((Flags & YORI_LIB_OUTPUT_DEBUG) != 0) {
+        hOut = (HANDLE)(YORI_LIB_DEBUGGER_HANDLE);
+    } else {
+        hOut = GetStdHandle(STD_OUTPUT_HANDLE);
+    }
+
+    YoriLibOutputStreamInitializeForDevice(Stream, hOut, Flags, FlushSize);
+}
+
+/**
+ Write any text buffered in a stream to its device.
+
+ @param Stream Pointer to the stream.
+
+ @return TRUE for success, FALSE for failure.
+ */
+BOOL
+YoriLibOutputStreamFlush(
+    __inout PYORI_LIB_OUTPUT_STREAM Stream
+    )
+{
+    BOOL Result;
+
+    if (Stream->Buffer.LengthInChars == 0) {
+        return TRUE;
+    }
+
+    //
+    //  Each flush is processed as a new stream, so any state the callbacks
+    //  cache about the device is refreshed in case something else wrote to
+    //  it since the last flush.
+    //
+
+    Stream->Callbacks.Context = 0;
+    Result = YoriLibProcVtEscOnNewStream(Stream->Buffer.StartOfString, Stream->Buffer.LengthInChars, Stream->hOutput, &Stream->Callbacks);
+    Stream->Buffer.LengthInChars = 0;
+    return Result;
+}
+
+/**
+ Write any text buffered in a stream to its device and free the buffer.  The
+ stream can be reused after this point, and will allocate a new buffer if
+ more text is written.
+
+ @param Stream Pointer to the stream.
+
+ @return TRUE for success, FALSE for failure.
+ */
+BOOL
+YoriLibOutputStreamClose(
+    __inout PYORI_LIB_OUTPUT_STREAM Stream
+    )
+{
+    BOOL Result;
+
+    Result = YoriLibOutputStreamFlush(Stream);
+    YoriLibFreeStringContents(&Stream->Buffer);
+    return Result;
+}
+
+/**
+ Output a Yori string to a stream.
+
+ @param Stream Pointer to the stream.
+
+ @param String The string to output.
+
+ @return TRUE for success, FALSE for failure.
+ */
+BOOL
+YoriLibOutputStreamString(
+    __inout PYORI_LIB_OUTPUT_STREAM Stream,
+    __in PCYORI_STRING String
+    )
+{
+    if (String->LengthInChars == 0) {
+        return TRUE;
+    }
+
+    if (Stream->Buffer.LengthAllocated == 0) {
+        YoriLibAllocateString(&Stream->Buffer, Stream->FlushSize);
+    }
+
+    if (String->LengthInChars > Stream->Buffer.LengthAllocated - Stream->Buffer.LengthInChars) {
+        if (!YoriLibOutputStreamFlush(Stream)) {
+            return FALSE;
+        }
+
+        //
+        //  If the string is larger than the buffer, there's no point
+        //  copying it.
+        //
+
+        if (String->LengthInChars > Stream->Buffer.LengthAllocated) {
+            Stream->Callbacks.Context = 0;
+            return YoriLibProcVtEscOnNewStream(String->StartOfString, String->LengthInChars, Stream->hOutput, &Stream->Callbacks);
+        }
+    }
+
+    memcpy(&Stream->Buffer.StartOfString[Stream->Buffer.LengthInChars], String->StartOfString, String->LengthInChars * sizeof(TCHAR));
+    Stream->Buffer.LengthInChars = Stream->Buffer.LengthInChars + String->LengthInChars;
+    return TRUE;
+}
+
+/**
+ Output a printf-style formatted string to a stream.  The string is
+ formatted directly into the stream's buffer, so in the common case it is
+ only formatted once and is not written until the buffer is full.
+
+ @param Stream Pointer to the stream.
+
+ @param szFmt The format string, followed by appropriate arguments.
+
+ @param marker The arguments that correspond to the format string.
+
+ @return TRUE for success, FALSE for failure.
+ */
+BOOL CDECL
+YoriLibOutputStreamInternal(
+    __inout PYORI_LIB_OUTPUT_STREAM Stream,
+    __in LPCTSTR szFmt,
+    __in va_list marker
+    )
+{
+#ifdef __WATCOMC__
+    va_list savedmarker;
+#else
+    va_list savedmarker = marker;
+#endif
+    YORI_SIGNED_ALLOC_SIZE_T len;
+    YORI_ALLOC_SIZE_T Remaining;
+
+#ifdef __WATCOMC__
+    savedmarker[0] = marker[0];
+#endif
+
+    if (Stream->Buffer.LengthAllocated == 0) {
+        if (!YoriLibAllocateString(&Stream->Buffer, Stream->FlushSize)) {
+            return YoriLibOutputInternal(Stream->hOutput, Stream->Flags, szFmt, marker);
+        }
+    }
+
+    //
+    //  Try to format into the remaining space.  If the string doesn't fit
+    //  it is truncated to fill the space, so a string which fills the space
+    //  exactly may have been truncated and is formatted again below.
+    //
+
+    Remaining = Stream->Buffer.LengthAllocated - Stream->Buffer.LengthInChars;
+    if (Remaining > 1) {
+        len = YoriLibVSPrintf(&Stream->Buffer.StartOfString[Stream->Buffer.LengthInChars], Remaining, szFmt, marker);
+        if (len >= 0 && (YORI_ALLOC_SIZE_T)len < Remaining - 1) {
+            Stream->Buffer.LengthInChars = Stream->Buffer.LengthInChars + (YORI_ALLOC_SIZE_T)len;
+            return TRUE;
+        }
+    }
+
+    //
+    //  Write what is already buffered, and grow the buffer if this string
+    //  cannot fit even when the buffer is empty.
+    //
+
+    if (!YoriLibOutputStreamFlush(Stream)) {
+        return FALSE;
+    }
+
+    marker = savedmarker;
+    len = YoriLibVSPrintfSize(szFmt, marker);
+    if (len < 0) {
+        return FALSE;
+    }
+
+    if ((YORI_ALLOC_SIZE_T)len > Stream->Buffer.LengthAllocated) {
+        if (!YoriLibReallocString(&Stream->Buffer, (YORI_ALLOC_SIZE_T)len)) {
+            marker = savedmarker;
+            return YoriLibOutputInternal(Stream->hOutput, Stream->Flags, szFmt, marker);
+        }
+    }
+
+    marker = savedmarker;
+    len = YoriLibVSPrintf(Stream->Buffer.StartOfString, Stream->Buffer.LengthAllocated, szFmt, marker);
+    if (len < 0) {
+        return FALSE;
+    }
+    Stream->Buffer.LengthInChars = (YORI_ALLOC_SIZE_T)len;
+    return TRUE;
+}
+
+/**
+ Output a printf-style formatted string to a stream.  This takes the same
+ arguments as YoriLibOutput, except the flags are replaced by the stream.
+
+ @param Stream Pointer to the stream.
+
+ @param szFmt The format string, followed by appropriate arguments.
+
+ @return TRUE for success, FALSE for failure.
+ */
+BOOL
+YoriLibOutputStream(
+    __inout PYORI_LIB_OUTPUT_STREAM Stream,
+    __in LPCTSTR szFmt,
+    ...
+    )
+{
+    va_list marker;
+    BOOL Result;
+
+    va_start(marker, szFmt);
+    Result = YoriLibOutputStreamInternal(Stream, szFmt, marker);
+    va_end(marker);
+    return Result;
+}
+
 /**
  Generate a string that is the VT100 representation for the specified Win32
  attribute.
@@ -135,6 +135,461 @@ YoriLibFindFirstMatchSubstrIns(
     return NULL;
 }
 
+/**
+ A value indicating that a matcher node does not terminate any pattern, or
+ that no match has been found.
+ */
+#define YORI_LIB_SUBSTR_MATCHER_NONE ((YORI_ALLOC_SIZE_T)-1)
+
+/**
+ Find the child of a matcher node that corresponds to a specified character.
+
+ @param Matcher Pointer to the matcher.
+
+ @param NodeIndex The node whose children should be searched.
+
+ @param Char The character to find.
+
+ @return The index of the child node, or zero if there is no child for the
+         character.  Zero is the root node, which is never a child.
+ */
+YORI_ALLOC_SIZE_T
+YoriLibSubstrMatcherFindChild(
+    __in PYORI_LIB_SUBSTR_MATCHER Matcher,
+    __in YORI_ALLOC_SIZE_T NodeIndex,
+    __in TCHAR Char
+    )
+{
+    YORI_ALLOC_SIZE_T ChildIndex;
+
+    ChildIndex = Matcher->Nodes[NodeIndex].FirstChild;
+    while (ChildIndex != 0) {
+        if (Matcher->Nodes[ChildIndex].Char == Char) {
+            break;
+        }
+        ChildIndex = Matcher->Nodes[ChildIndex].NextSibling;
+    }
+
+    return ChildIndex;
+}
+
+/**
+ Advance the matcher by one character of the string being searched.
+
+ @param Matcher Pointer to the matcher.
+
+ @param NodeIndex The node describing the text matched so far.
+
+ @param Char The next character in the string being searched.  If the
+        matcher is case insensitive, this has already been converted to upper
+        case.
+
+ @return The node describing the text matched after adding the character.
+ */
+YORI_ALLOC_SIZE_T
+YoriLibSubstrMatcherStep(
+    __in PYORI_LIB_SUBSTR_MATCHER Matcher,
+    __in YORI_ALLOC_SIZE_T NodeIndex,
+    __in TCHAR Char
+    )
+{
+    YORI_ALLOC_SIZE_T ChildIndex;
+
+    while (TRUE) {
+        if (NodeIndex == 0) {
+
+            //
+            //  Most characters don't start any pattern, so check the bitmap
+            //  before walking the children of the root.
+            //
+
+            if ((Matcher->RootChars[Char / 32] & (1 << (Char % 32))) == 0) {
+                return 0;
+            }
+            return YoriLibSubstrMatcherFindChild(Matcher, 0, Char);
+        }
+
+        ChildIndex = YoriLibSubstrMatcherFindChild(Matcher, NodeIndex, Char);
+        if (ChildIndex != 0) {
+            return ChildIndex;
+        }
+
+        NodeIndex = Matcher->Nodes[NodeIndex].Fail;
+    }
+}
+
+/**
+ Compile a set of substrings into a matcher which can locate any of them in
+ a string in a single pass over the string.  The matcher records a pointer
+ to MatchArray so that matches can be returned in terms of the original
+ array, so the array must remain valid while the matcher is in use, but the
+ strings within the array can be modified or freed.
+
+ @param NumberMatches The number of substrings to look for.
+
+ @param MatchArray An array of strings corresponding to the matches to
+        look for.
+
+ @param Insensitive TRUE if matches should be found case insensitively, FALSE
+        if they should be found case sensitively.
+
+ @return Pointer to the matcher, or NULL on allocation failure.  The caller
+         should free this with YoriLibFreeSubstrMatcher.
+ */
+PYORI_LIB_SUBSTR_MATCHER
+YoriLibAllocateSubstrMatcher(
+    __in YORI_ALLOC_SIZE_T NumberMatches,
+    __in PYORI_STRING MatchArray,
+    __in BOOLEAN Insensitive
+    )
+{
+    PYORI_LIB_SUBSTR_MATCHER Matcher;
+    PYORI_LIB_SUBSTR_MATCHER_NODE Node;
+    PYORI_ALLOC_SIZE_T Queue;
+    YORI_MAX_UNSIGNED_T TotalChars;
+    YORI_MAX_UNSIGNED_T BytesNeeded;
+    YORI_ALLOC_SIZE_T MatchIndex;
+    YORI_ALLOC_SIZE_T CharIndex;
+    YORI_ALLOC_SIZE_T NodeIndex;
+    YORI_ALLOC_SIZE_T ChildIndex;
+    YORI_ALLOC_SIZE_T FailIndex;
+    YORI_ALLOC_SIZE_T QueueHead;
+    YORI_ALLOC_SIZE_T QueueTail;
+    TCHAR Char;
+
+    //
+    //  The trie can contain at most one node per character plus the root.
+    //
+
+    TotalChars = 0;
+    for (MatchIndex = 0; MatchIndex < NumberMatches; MatchIndex++) {
+        TotalChars = TotalChars + MatchArray[MatchIndex].LengthInChars;
+    }
+
+    BytesNeeded = sizeof(YORI_LIB_SUBSTR_MATCHER) + (TotalChars + 1) * sizeof(YORI_LIB_SUBSTR_MATCHER_NODE);
+    if (!YoriLibIsSizeAllocatable(BytesNeeded) ||
+        !YoriLibIsSizeAllocatable((TotalChars + 1) * sizeof(YORI_ALLOC_SIZE_T))) {
+        return NULL;
+    }
+
+    Matcher = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesNeeded);
+    if (Matcher == NULL) {
+        return NULL;
+    }
+
+    Queue = YoriLibMalloc((YORI_ALLOC_SIZE_T)((TotalChars + 1) * sizeof(YORI_ALLOC_SIZE_T)));
+    if (Queue == NULL) {
+        YoriLibFree(Matcher);
+        return NULL;
+    }
+
+    ZeroMemory(Matcher->RootChars, sizeof(Matcher->RootChars));
+    Matcher->MatchArray = MatchArray;
+    Matcher->NumberMatches = NumberMatches;
+    Matcher->MaximumLength = 0;
+    Matcher->EmptyMatchIndex = YORI_LIB_SUBSTR_MATCHER_NONE;
+    Matcher->Insensitive = Insensitive;
+    Matcher->Nodes = (PYORI_LIB_SUBSTR_MATCHER_NODE)(Matcher + 1);
+    Matcher->NodeCount = 1;
+
+    Node = &Matcher->Nodes[0];
+    Node->FirstChild = 0;
+    Node->NextSibling = 0;
+    Node->Fail = 0;
+    Node->Output = 0;
+    Node->MatchIndex = YORI_LIB_SUBSTR_MATCHER_NONE;
+    Node->Depth = 0;
+    Node->Char = 0;
+
+    //
+    //  Insert each pattern into the trie.  If two patterns are the same,
+    //  the node records the earlier one, since that is the one that would
+    //  be returned by YoriLibFindFirstMatchSubstr.
+    //
+
+    for (MatchIndex = 0; MatchIndex < NumberMatches; MatchIndex++) {
+        if (MatchArray[MatchIndex].LengthInChars == 0) {
+            if (Matcher->EmptyMatchIndex == YORI_LIB_SUBSTR_MATCHER_NONE) {
+                Matcher->EmptyMatchIndex = MatchIndex;
+            }
+            continue;
+        }
+
+        if (MatchArray[MatchIndex].LengthInChars > Matcher->MaximumLength) {
+            Matcher->MaximumLength = MatchArray[MatchIndex].LengthInChars;
+        }
+
+        NodeIndex = 0;
+        for (CharIndex = 0; CharIndex < MatchArray[MatchIndex].LengthInChars; CharIndex++) {
+            Char = MatchArray[MatchIndex].StartOfString[CharIndex];
+            if (Insensitive) {
+                Char = YoriLibUpcaseChar(Char);
+            }
+
+            if (NodeIndex == 0) {
+                Matcher->RootChars[Char / 32] = Matcher->RootChars[Char / 32] | (1 << (Char % 32));
+            }
+
+            ChildIndex = YoriLibSubstrMatcherFindChild(Matcher, NodeIndex, Char);
+            if (ChildIndex == 0) {
+                ChildIndex = Matcher->NodeCount;
+                Matcher->NodeCount++;
+                Node = &Matcher->Nodes[ChildIndex];
+                Node->FirstChild = 0;
+                Node->NextSibling = Matcher->Nodes[NodeIndex].FirstChild;
+                Node->Fail = 0;
+                Node->Output = 0;
+                Node->MatchIndex = YORI_LIB_SUBSTR_MATCHER_NONE;
+                Node->Depth = CharIndex + 1;
+                Node->Char = Char;
+                Matcher->Nodes[NodeIndex].FirstChild = ChildIndex;
+            }
+            NodeIndex = ChildIndex;
+        }
+
+        if (Matcher->Nodes[NodeIndex].MatchIndex == YORI_LIB_SUBSTR_MATCHER_NONE) {
+            Matcher->Nodes[NodeIndex].MatchIndex = MatchIndex;
+        }
+    }
+
+    //
+    //  Walk the trie breadth first so that each node's failure link can be
+    //  derived from its parent's.  The failure link points to the node for
+    //  the longest proper suffix of this node's text that is also in the
+    //  trie, and the output link points to the nearest node along the
+    //  failure links that terminates a pattern.
+    //
+
+    QueueHead = 0;
+    QueueTail = 0;
+    ChildIndex = Matcher->Nodes[0].FirstChild;
+    while (ChildIndex != 0) {
+        Queue[QueueTail] = ChildIndex;
+        QueueTail++;
+        ChildIndex = Matcher->Nodes[ChildIndex].NextSibling;
+    }
+
+    while (QueueHead < QueueTail) {
+        NodeIndex = Queue[QueueHead];
+        QueueHead++;
+
+        ChildIndex = Matcher->Nodes[NodeIndex].FirstChild;
+        while (ChildIndex != 0) {
+            Node = &Matcher->Nodes[ChildIndex];
+            FailIndex = YoriLibSubstrMatcherStep(Matcher, Matcher->Nodes[NodeIndex].Fail, Node->Char);
+            Node->Fail = FailIndex;
+            if (Matcher->Nodes[FailIndex].MatchIndex != YORI_LIB_SUBSTR_MATCHER_NONE) {
+                Node->Output = FailIndex;
+            } else {
+                Node->Output = Matcher->Nodes[FailIndex].Output;
+            }
+
+            Queue[QueueTail] = ChildIndex;
+            QueueTail++;
+            ChildIndex = Node->NextSibling;
+        }
+    }
+
+    YoriLibFree(Queue);
+    return Matcher;
+}
+
+/**
+ Free a matcher allocated with YoriLibAllocateSubstrMatcher.
+
+ @param Matcher Pointer to the matcher to free.
+ */
+VOID
+YoriLibFreeSubstrMatcher(
+    __in PYORI_LIB_SUBSTR_MATCHER Matcher
+    )
+{
+    YoriLibFree(Matcher);
+}
+
+/**
+ Search through a string looking to see if any of the substrings in a
+ matcher can be located.  Returns the first match in offset from the
+ beginning of the string order, and if more than one substring matches at
+ that offset, the one earliest in the array used to build the matcher.  This
+ is the same result as YoriLibFindFirstMatchSubstr or
+ YoriLibFindFirstMatchSubstrIns, but the time taken does not depend on the
+ number of substrings.
+
+ @param Matcher Pointer to the matcher.
+
+ @param String The string to search through.
+
+ @param StringOffsetOfMatch On successful completion, returns the offset
+        within the string of the match.
+
+ @return If a match is found, returns a pointer to the entry in the
+         matcher's MatchArray corresponding to the substring that was
+         matched.  If no match is found, returns NULL.
+ */
+PYORI_STRING
+YoriLibSubstrMatcherFindFirst(
+    __in PYORI_LIB_SUBSTR_MATCHER Matcher,
+    __in PCYORI_STRING String,
+    __out_opt PYORI_ALLOC_SIZE_T StringOffsetOfMatch
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T NodeIndex;
+    YORI_ALLOC_SIZE_T OutputIndex;
+    YORI_ALLOC_SIZE_T MatchStart;
+    YORI_ALLOC_SIZE_T BestStart;
+    YORI_ALLOC_SIZE_T BestIndex;
+    PYORI_LIB_SUBSTR_MATCHER_NODE Node;
+    TCHAR Char;
+
+    BestStart = 0;
+    BestIndex = YORI_LIB_SUBSTR_MATCHER_NONE;
+    if (String->LengthInChars > 0) {
+        BestIndex = Matcher->EmptyMatchIndex;
+    }
+
+    NodeIndex = 0;
+    for (Index = 0; Index < String->LengthInChars; Index++) {
+
+        //
+        //  Once a match is found, keep looking until no pattern that starts
+        //  at or before it could still end here, since a longer pattern
+        //  may start earlier.
+        //
+
+        if (BestIndex != YORI_LIB_SUBSTR_MATCHER_NONE &&
+            Index - BestStart >= Matcher->MaximumLength) {
+
+            break;
+        }
+
+        Char = String->StartOfString[Index];
+        if (Matcher->Insensitive) {
+            Char = YoriLibUpcaseChar(Char);
+        }
+
+        NodeIndex = YoriLibSubstrMatcherStep(Matcher, NodeIndex, Char);
+        if (NodeIndex == 0) {
+            continue;
+        }
+
+        OutputIndex = NodeIndex;
+        if (Matcher->Nodes[OutputIndex].MatchIndex == YORI_LIB_SUBSTR_MATCHER_NONE) {
+            OutputIndex = Matcher->Nodes[OutputIndex].Output;
+        }
+
+        while (OutputIndex != 0) {
+            Node = &Matcher->Nodes[OutputIndex];
+            MatchStart = Index + 1 - Node->Depth;
+            if (BestIndex == YORI_LIB_SUBSTR_MATCHER_NONE ||
+                MatchStart < BestStart ||
+                (MatchStart == BestStart && Node->MatchIndex < BestIndex)) {
+
+                BestStart = MatchStart;
+                BestIndex = Node->MatchIndex;
+            }
+            OutputIndex = Node->Output;
+        }
+    }
+
+    if (BestIndex == YORI_LIB_SUBSTR_MATCHER_NONE) {
+        if (StringOffsetOfMatch != NULL) {
+            *StringOffsetOfMatch = 0;
+        }
+        return NULL;
+    }
+
+    if (StringOffsetOfMatch != NULL) {
+        *StringOffsetOfMatch = BestStart;
+    }
+    return &Matcher->MatchArray[BestIndex];
+}
+
+/**
+ Search through a string looking to see if any of the substrings in a
+ matcher can be located.  Returns the substring that is earliest in the
+ array used to build the matcher which is found anywhere in the string.
+ This is useful where the array is in priority order and the location of
+ the match is less important.
+
+ @param Matcher Pointer to the matcher.
+
+ @param String The string to search through.
+
+ @param StringOffsetOfMatch On successful completion, returns the offset
+        within the string of the first occurrence of the returned substring.
+
+ @return If a match is found, returns a pointer to the entry in the
+         matcher's MatchArray corresponding to the substring that was
+         matched.  If no match is found, returns NULL.
+ */
+PYORI_STRING
+YoriLibSubstrMatcherFindLowestEntry(
+    __in PYORI_LIB_SUBSTR_MATCHER Matcher,
+    __in PCYORI_STRING String,
+    __out_opt PYORI_ALLOC_SIZE_T StringOffsetOfMatch
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T NodeIndex;
+    YORI_ALLOC_SIZE_T OutputIndex;
+    YORI_ALLOC_SIZE_T BestStart;
+    YORI_ALLOC_SIZE_T BestIndex;
+    PYORI_LIB_SUBSTR_MATCHER_NODE Node;
+    TCHAR Char;
+
+    BestStart = 0;
+    BestIndex = YORI_LIB_SUBSTR_MATCHER_NONE;
+    if (String->LengthInChars > 0) {
+        BestIndex = Matcher->EmptyMatchIndex;
+    }
+
+    NodeIndex = 0;
+    for (Index = 0; Index < String->LengthInChars; Index++) {
+
+        if (BestIndex == 0) {
+            break;
+        }
+
+        Char = String->StartOfString[Index];
+        if (Matcher->Insensitive) {
+            Char = YoriLibUpcaseChar(Char);
+        }
+
+        NodeIndex = YoriLibSubstrMatcherStep(Matcher, NodeIndex, Char);
+        if (NodeIndex == 0) {
+            continue;
+        }
+
+        OutputIndex = NodeIndex;
+        if (Matcher->Nodes[OutputIndex].MatchIndex == YORI_LIB_SUBSTR_MATCHER_NONE) {
+            OutputIndex = Matcher->Nodes[OutputIndex].Output;
+        }
+
+        while (OutputIndex != 0) {
+            Node = &Matcher->Nodes[OutputIndex];
+            if (Node->MatchIndex < BestIndex) {
+                BestStart = Index + 1 - Node->Depth;
+                BestIndex = Node->MatchIndex;
+            }
+            OutputIndex = Node->Output;
+        }
+    }
+
+    if (BestIndex == YORI_LIB_SUBSTR_MATCHER_NONE) {
+        if (StringOffsetOfMatch != NULL) {
+            *StringOffsetOfMatch = 0;
+        }
+        return NULL;
+    }
+
+    if (StringOffsetOfMatch != NULL) {
+        *StringOffsetOfMatch = BestStart;
+    }
+    return &Matcher->MatchArray[BestIndex];
+}
+
 /**
  Search through a string looking to see if any substrings can be located.
  Returns the last match in offet from the end of the string order.
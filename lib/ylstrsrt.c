@@ -3,7 +3,7 @@
  *
  * Yori string sorting routines
  *
- * Copyright (c) 2017-2018 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -50,129 +50,700 @@ YoriLibSwapStrings(
 }
 
 /**
- Sort an array of strings.  This is currently implemented using a handrolled
- quicksort.
+ Arrays with fewer elements than this are sorted with an insertion sort.
+ */
+#define YORILIB_SORT_INSERTION_CUTOFF 16
 
- @param StringArray Pointer to an array of strings.
+/**
+ A partition must contain at least this many elements before it is sorted on
+ a separate thread.
+ */
+#define YORILIB_SORT_PARALLEL_THRESHOLD 0x4000
 
- @param Count The number of elements in the array.
+/**
+ The maximum number of additional threads used to sort a single array.
+ */
+#define YORILIB_SORT_MAX_THREADS 15
+
+/**
+ The number of upcased characters stored in the key of each string when keys
+ are cached.
+ */
+#define YORILIB_SORT_KEY_CHARS (sizeof(DWORDLONG) / sizeof(TCHAR))
+
+/**
+ State that is common to all ranges being sorted within a single array.
+ */
+typedef struct _YORILIB_SORT_STATE {
+
+    /**
+     The size of each element in the array, in bytes.
+     */
+    YORI_ALLOC_SIZE_T ElementSize;
+
+    /**
+     The number of additional threads that can still be created to sort
+     partitions.  This is decremented when a thread is created and may
+     become negative, indicating no more threads should be created.
+     */
+    LONG ThreadsAvailable;
+
+    /**
+     The function to compare two elements.
+     */
+    PYORILIB_SORT_COMPARE_FN CompareFn;
+
+    /**
+     Context to pass to the compare function.
+     */
+    PVOID Context;
+} YORILIB_SORT_STATE, *PYORILIB_SORT_STATE;
+
+/**
+ A range of an array that is being sorted on a separate thread.
+ */
+typedef struct _YORILIB_SORT_TASK {
+
+    /**
+     Pointer to the state common to the array.
+     */
+    PYORILIB_SORT_STATE State;
+
+    /**
+     Pointer to the first element in the range.
+     */
+    PUCHAR Base;
+
+    /**
+     The number of elements in the range.
+     */
+    YORI_ALLOC_SIZE_T Count;
+
+    /**
+     The number of partitioning passes allowed before switching to a heap
+     sort.
+     */
+    DWORD DepthLimit;
+
+    /**
+     Handle to the thread sorting the range.
+     */
+    HANDLE Thread;
+} YORILIB_SORT_TASK, *PYORILIB_SORT_TASK;
+
+/**
+ A string along with a cached key used to sort it.
+ */
+typedef struct _YORILIB_SORT_STRING_KEY {
+
+    /**
+     The first characters of the string, upcased, with the first character
+     in the most significant bits.  If the string is shorter than the key,
+     the remainder is zero.
+     */
+    DWORDLONG Prefix;
+
+    /**
+     The string.
+     */
+    YORI_STRING String;
+} YORILIB_SORT_STRING_KEY, *PYORILIB_SORT_STRING_KEY;
+
+/**
+ Swap two elements in an array being sorted.
+
+ @param State Pointer to the sort state, indicating the size of each
+        element.
+
+ @param Element1 Pointer to the first element.
+
+ @param Element2 Pointer to the second element.
  */
 VOID
-YoriLibSortStringArray(
-    __in_ecount(Count) PYORI_STRING StringArray,
-    __in YORI_ALLOC_SIZE_T Count
+YoriLibSortSwapElements(
+    __in PYORILIB_SORT_STATE State,
+    __inout PUCHAR Element1,
+    __inout PUCHAR Element2
     )
 {
-    YORI_ALLOC_SIZE_T FirstOffset;
     YORI_ALLOC_SIZE_T Index;
+    PDWORD_PTR Ptr1;
+    PDWORD_PTR Ptr2;
+    DWORD_PTR PtrSwap;
+    UCHAR Swap;
 
-    if (Count <= 1) {
+    //
+    //  Elements are normally structures whose size is a multiple of the
+    //  pointer size, so swap a pointer at a time where possible.
+    //
+
+    if ((State->ElementSize % sizeof(DWORD_PTR)) == 0) {
+        Ptr1 = (PDWORD_PTR)Element1;
+        Ptr2 = (PDWORD_PTR)Element2;
+        for (Index = 0; Index < State->ElementSize / sizeof(DWORD_PTR); Index++) {
+            PtrSwap = Ptr1[Index];
+            Ptr1[Index] = Ptr2[Index];
+            Ptr2[Index] = PtrSwap;
+        }
         return;
     }
 
-    FirstOffset = 0;
+    for (Index = 0; Index < State->ElementSize; Index++) {
+        Swap = Element1[Index];
+        Element1[Index] = Element2[Index];
+        Element2[Index] = Swap;
+    }
+}
 
-    while (TRUE) {
-        YORI_ALLOC_SIZE_T BreakPoint;
-        YORI_ALLOC_SIZE_T LastOffset;
-        YORI_STRING MidPoint;
-        volatile DWORD LastSwapFirst;
-        volatile DWORD LastSwapLast;
-
-        BreakPoint = Count / 2;
-        memcpy(&MidPoint, &StringArray[BreakPoint], sizeof(YORI_STRING));
-    
-        FirstOffset = 0;
-        LastOffset = Count - 1;
-    
-        //
-        //  Scan from the beginning looking for an item that should be sorted
-        //  after the midpoint.
-        //
-    
-        for (FirstOffset = 0; FirstOffset < LastOffset; FirstOffset++) {
-            if (YoriLibCompareStringIns(&StringArray[FirstOffset],&MidPoint) >= 0) {
-                for (; LastOffset > FirstOffset; LastOffset--) {
-                    if (YoriLibCompareStringIns(&StringArray[LastOffset],&MidPoint) < 0) {
-                        LastSwapFirst = FirstOffset;
-                        LastSwapLast = LastOffset;
-                        YoriLibSwapStrings(&StringArray[FirstOffset], &StringArray[LastOffset]);
-                        LastOffset--;
-                        break;
-                    }
-                }
-                if (LastOffset <= FirstOffset) {
-                    break;
-                }
+/**
+ Move an element down a heap until it is larger than its children.
+
+ @param State Pointer to the sort state.
+
+ @param Base Pointer to the first element of the heap.
+
+ @param Root The index of the element to move.
+
+ @param Count The number of elements in the heap.
+ */
+VOID
+YoriLibSortSiftDown(
+    __in PYORILIB_SORT_STATE State,
+    __in PUCHAR Base,
+    __in YORI_ALLOC_SIZE_T Root,
+    __in YORI_ALLOC_SIZE_T Count
+    )
+{
+    YORI_ALLOC_SIZE_T Child;
+    YORI_ALLOC_SIZE_T ElementSize;
+
+    ElementSize = State->ElementSize;
+
+    while (Root < Count / 2) {
+        Child = Root * 2 + 1;
+        if (Child + 1 < Count &&
+            State->CompareFn(&Base[Child * ElementSize], &Base[(Child + 1) * ElementSize], State->Context) < 0) {
+
+            Child++;
+        }
+
+        if (State->CompareFn(&Base[Root * ElementSize], &Base[Child * ElementSize], State->Context) >= 0) {
+            break;
+        }
+
+        YoriLibSortSwapElements(State, &Base[Root * ElementSize], &Base[Child * ElementSize]);
+        Root = Child;
+    }
+}
+
+/**
+ Sort a range of an array with a heap sort.  This is used when partitioning
+ is not making progress, since its running time does not depend on the
+ order of the input.
+
+ @param State Pointer to the sort state.
+
+ @param Base Pointer to the first element in the range.
+
+ @param Count The number of elements in the range.
+ */
+VOID
+YoriLibSortHeapSort(
+    __in PYORILIB_SORT_STATE State,
+    __in PUCHAR Base,
+    __in YORI_ALLOC_SIZE_T Count
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    for (Index = Count / 2; Index > 0; Index--) {
+        YoriLibSortSiftDown(State, Base, Index - 1, Count);
+    }
+
+    for (Index = Count - 1; Index > 0; Index--) {
+        YoriLibSortSwapElements(State, Base, &Base[Index * State->ElementSize]);
+        YoriLibSortSiftDown(State, Base, 0, Index);
+    }
+}
+
+/**
+ Sort a small range of an array with an insertion sort.
+
+ @param State Pointer to the sort state.
+
+ @param Base Pointer to the first element in the range.
+
+ @param Count The number of elements in the range.
+ */
+VOID
+YoriLibSortInsertionSort(
+    __in PYORILIB_SORT_STATE State,
+    __in PUCHAR Base,
+    __in YORI_ALLOC_SIZE_T Count
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T Insert;
+    YORI_ALLOC_SIZE_T ElementSize;
+
+    ElementSize = State->ElementSize;
+
+    for (Index = 1; Index < Count; Index++) {
+        for (Insert = Index; Insert > 0; Insert--) {
+            if (State->CompareFn(&Base[(Insert - 1) * ElementSize], &Base[Insert * ElementSize], State->Context) <= 0) {
+                break;
             }
+            YoriLibSortSwapElements(State, &Base[(Insert - 1) * ElementSize], &Base[Insert * ElementSize]);
+        }
+    }
+}
+
+/**
+ Partition a range of an array around the median of its first, middle and
+ last elements.
+
+ @param State Pointer to the sort state.
+
+ @param Base Pointer to the first element in the range.
+
+ @param Count The number of elements in the range.  This must be at least
+        three.
+
+ @return The index of the pivot element on completion.  Every element
+         before it compares less than or equal to it, and every element
+         after it compares greater than or equal to it.
+ */
+YORI_ALLOC_SIZE_T
+YoriLibSortPartition(
+    __in PYORILIB_SORT_STATE State,
+    __in PUCHAR Base,
+    __in YORI_ALLOC_SIZE_T Count
+    )
+{
+    YORI_ALLOC_SIZE_T ElementSize;
+    PUCHAR First;
+    PUCHAR Middle;
+    PUCHAR Last;
+    YORI_ALLOC_SIZE_T Lower;
+    YORI_ALLOC_SIZE_T Upper;
+
+    ElementSize = State->ElementSize;
+    First = Base;
+    Middle = &Base[(Count / 2) * ElementSize];
+    Last = &Base[(Count - 1) * ElementSize];
+
+    //
+    //  Order the first, middle and last elements, then move the median to
+    //  the front to act as the pivot.  Since the last element is now
+    //  greater than or equal to the pivot, the forward scan below will stop
+    //  before running off the end.
+    //
+
+    if (State->CompareFn(Middle, First, State->Context) < 0) {
+        YoriLibSortSwapElements(State, Middle, First);
+    }
+    if (State->CompareFn(Last, Middle, State->Context) < 0) {
+        YoriLibSortSwapElements(State, Last, Middle);
+        if (State->CompareFn(Middle, First, State->Context) < 0) {
+            YoriLibSortSwapElements(State, Middle, First);
         }
+    }
+    YoriLibSortSwapElements(State, First, Middle);
+
+    //
+    //  Both scans stop on elements equal to the pivot, so runs of identical
+    //  elements are split evenly rather than all falling on one side.
+    //
+
+    Lower = 0;
+    Upper = Count;
+    while (TRUE) {
+        do {
+            Lower++;
+        } while (Lower < Count && State->CompareFn(&Base[Lower * ElementSize], First, State->Context) < 0);
+
+        do {
+            Upper--;
+        } while (State->CompareFn(&Base[Upper * ElementSize], First, State->Context) > 0);
 
-        ASSERT(FirstOffset == LastOffset);
-        FirstOffset = LastOffset;
-        if (YoriLibCompareStringIns(&StringArray[FirstOffset], &MidPoint) < 0) {
-            FirstOffset++;
+        if (Lower >= Upper) {
+            break;
         }
 
-        //
-        //  If no copies occurred, check if everything in the list is
-        //  sorted.
-        //
+        YoriLibSortSwapElements(State, &Base[Lower * ElementSize], &Base[Upper * ElementSize]);
+    }
+
+    YoriLibSortSwapElements(State, First, &Base[Upper * ElementSize]);
+    return Upper;
+}
 
-        if (FirstOffset == 0 || FirstOffset == Count) {
-            for (Index = 0; Index < Count - 1; Index++) {
-                if (YoriLibCompareStringIns(&StringArray[Index], &StringArray[Index + 1]) > 0) {
-                    break;
+DWORD WINAPI
+YoriLibSortTaskThread(
+    __in LPVOID Parameter
+    );
+
+/**
+ Sort a range of an array.  Ranges are partitioned until they are small
+ enough for an insertion sort, or until partitioning has been unbalanced for
+ long enough that a heap sort is used instead.  The smaller side of each
+ partition is sorted recursively, or on a new thread if it is large enough
+ and threads are available, and the larger side is sorted by this loop.
+
+ @param State Pointer to the sort state.
+
+ @param Base Pointer to the first element in the range.
+
+ @param Count The number of elements in the range.
+
+ @param DepthLimit The number of partitioning passes allowed before switching
+        to a heap sort.
+ */
+VOID
+YoriLibSortRange(
+    __in PYORILIB_SORT_STATE State,
+    __in PUCHAR Base,
+    __in YORI_ALLOC_SIZE_T Count,
+    __in DWORD DepthLimit
+    )
+{
+    PYORILIB_SORT_TASK Task;
+    YORI_ALLOC_SIZE_T Pivot;
+    YORI_ALLOC_SIZE_T UpperCount;
+    PUCHAR UpperBase;
+    DWORD ThreadId;
+
+    Task = NULL;
+
+    while (Count >= YORILIB_SORT_INSERTION_CUTOFF) {
+        if (DepthLimit == 0) {
+            YoriLibSortHeapSort(State, Base, Count);
+            break;
+        }
+        DepthLimit--;
+
+        Pivot = YoriLibSortPartition(State, Base, Count);
+        UpperBase = &Base[(Pivot + 1) * State->ElementSize];
+        UpperCount = Count - Pivot - 1;
+
+        if (Pivot < UpperCount) {
+
+            if (Task == NULL &&
+                Pivot >= YORILIB_SORT_PARALLEL_THRESHOLD &&
+                InterlockedDecrement(&State->ThreadsAvailable) >= 0) {
+
+                Task = YoriLibMalloc(sizeof(YORILIB_SORT_TASK));
+                if (Task != NULL) {
+                    Task->State = State;
+                    Task->Base = Base;
+                    Task->Count = Pivot;
+                    Task->DepthLimit = DepthLimit;
+                    Task->Thread = CreateThread(NULL, 0, YoriLibSortTaskThread, Task, 0, &ThreadId);
+                    if (Task->Thread == NULL) {
+                        YoriLibFree(Task);
+                        Task = NULL;
+                        YoriLibSortRange(State, Base, Pivot, DepthLimit);
+                    }
+                } else {
+                    YoriLibSortRange(State, Base, Pivot, DepthLimit);
                 }
+            } else {
+                YoriLibSortRange(State, Base, Pivot, DepthLimit);
             }
-            if (Index == Count - 1) {
-                return;
-            }
+            Base = UpperBase;
+            Count = UpperCount;
+        } else {
+
+            if (Task == NULL &&
+                UpperCount >= YORILIB_SORT_PARALLEL_THRESHOLD &&
+                InterlockedDecrement(&State->ThreadsAvailable) >= 0) {
 
-            //
-            //  Nothing was copied and it's not because it's identical.  This
-            //  implies a very bad choice of midpoint that belongs either at
-            //  the beginning or the end (so nothing could move past it.)
-            //  Move it around and repeat the process (which will get a new
-            //  midpoint.)
-            //
-    
-            if (FirstOffset == 0) {
-                ASSERT(YoriLibCompareStringIns(&StringArray[0], &MidPoint) > 0);
-
-                if (YoriLibCompareStringIns(&StringArray[0], &MidPoint) > 0) {
-                    YoriLibSwapStrings(&StringArray[0], &StringArray[BreakPoint]);
+                Task = YoriLibMalloc(sizeof(YORILIB_SORT_TASK));
+                if (Task != NULL) {
+                    Task->State = State;
+                    Task->Base = UpperBase;
+                    Task->Count = UpperCount;
+                    Task->DepthLimit = DepthLimit;
+                    Task->Thread = CreateThread(NULL, 0, YoriLibSortTaskThread, Task, 0, &ThreadId);
+                    if (Task->Thread == NULL) {
+                        YoriLibFree(Task);
+                        Task = NULL;
+                        YoriLibSortRange(State, UpperBase, UpperCount, DepthLimit);
+                    }
+                } else {
+                    YoriLibSortRange(State, UpperBase, UpperCount, DepthLimit);
                 }
             } else {
-                ASSERT(YoriLibCompareStringIns(&MidPoint, &StringArray[Count - 1]) > 0);
-                YoriLibSwapStrings(&StringArray[Count - 1], &StringArray[BreakPoint]);
+                YoriLibSortRange(State, UpperBase, UpperCount, DepthLimit);
+            }
+            Count = Pivot;
+        }
+    }
+
+    if (Count < YORILIB_SORT_INSERTION_CUTOFF) {
+        YoriLibSortInsertionSort(State, Base, Count);
+    }
+
+    if (Task != NULL) {
+        WaitForSingleObject(Task->Thread, INFINITE);
+        CloseHandle(Task->Thread);
+        YoriLibFree(Task);
+    }
+}
+
+/**
+ The entrypoint for a thread sorting a range of an array.
+
+ @param Parameter Pointer to the task describing the range to sort.
+
+ @return Zero.
+ */
+DWORD WINAPI
+YoriLibSortTaskThread(
+    __in LPVOID Parameter
+    )
+{
+    PYORILIB_SORT_TASK Task = (PYORILIB_SORT_TASK)Parameter;
+
+    YoriLibSortRange(Task->State, Task->Base, Task->Count, Task->DepthLimit);
+    return 0;
+}
+
+/**
+ Sort an array of arbitrary elements.  This is an introsort: a quicksort
+ using median of three pivots, which falls back to a heap sort if
+ partitioning is unbalanced and uses an insertion sort for small ranges.
+ The sort is not stable.
+
+ @param Base Pointer to the first element in the array.
+
+ @param Count The number of elements in the array.
+
+ @param ElementSize The size of each element, in bytes.
+
+ @param CompareFn Function to compare two elements.  If YORILIB_SORT_PARALLEL
+        is specified, this may be called concurrently from multiple threads.
+
+ @param Context Context to pass to the compare function.
+
+ @param Flags Flags modifying the sort.  YORILIB_SORT_PARALLEL allows large
+        arrays to be sorted with multiple threads.
+ */
+VOID
+YoriLibSortArray(
+    __inout PVOID Base,
+    __in YORI_ALLOC_SIZE_T Count,
+    __in YORI_ALLOC_SIZE_T ElementSize,
+    __in PYORILIB_SORT_COMPARE_FN CompareFn,
+    __in_opt PVOID Context,
+    __in DWORD Flags
+    )
+{
+    YORILIB_SORT_STATE State;
+    SYSTEM_INFO SystemInfo;
+    YORI_ALLOC_SIZE_T Remaining;
+    DWORD DepthLimit;
+
+    if (Count <= 1) {
+        return;
+    }
+
+    State.ElementSize = ElementSize;
+    State.CompareFn = CompareFn;
+    State.Context = Context;
+    State.ThreadsAvailable = 0;
+
+    if ((Flags & YORILIB_SORT_PARALLEL) != 0 &&
+        Count >= 2 * YORILIB_SORT_PARALLEL_THRESHOLD) {
+
+        GetSystemInfo(&SystemInfo);
+        if (SystemInfo.dwNumberOfProcessors > 1) {
+            State.ThreadsAvailable = SystemInfo.dwNumberOfProcessors - 1;
+            if (State.ThreadsAvailable > YORILIB_SORT_MAX_THREADS) {
+                State.ThreadsAvailable = YORILIB_SORT_MAX_THREADS;
             }
-        } else {
-            break;
         }
     }
 
     //
-    //  If there are two sets (FirstOffset is not at either end), recurse.
+    //  Allow twice the depth of a perfectly balanced sort before switching
+    //  to a heap sort.
     //
 
-    if (FirstOffset && (Count - FirstOffset)) {
-        if (FirstOffset > 0) {
-            YoriLibSortStringArray(StringArray, FirstOffset);
-        }
-        if ((Count - FirstOffset) > 0) {
-            YoriLibSortStringArray(&StringArray[FirstOffset], Count - FirstOffset);
-        }
+    DepthLimit = 0;
+    for (Remaining = Count; Remaining > 1; Remaining = Remaining / 2) {
+        DepthLimit += 2;
+    }
+
+    YoriLibSortRange(&State, Base, Count, DepthLimit);
+}
+
+/**
+ Compare two strings without regard to case.  This is used when sorting
+ strings without cached keys.
+
+ @param Element1 Pointer to the first string.
+
+ @param Element2 Pointer to the second string.
+
+ @param Context Unused.
+
+ @return Negative if the first string sorts before the second, zero if they
+         are equal, positive if the first string sorts after the second.
+ */
+int
+YoriLibSortCompareStrings(
+    __in PVOID Element1,
+    __in PVOID Element2,
+    __in_opt PVOID Context
+    )
+{
+    UNREFERENCED_PARAMETER(Context);
+
+    return YoriLibCompareStringIns((PCYORI_STRING)Element1, (PCYORI_STRING)Element2);
+}
+
+/**
+ Compare two strings with cached keys without regard to case.  The keys are
+ compared first, and only if they are equal are the remaining characters
+ compared.
+
+ @param Element1 Pointer to the first string and key.
+
+ @param Element2 Pointer to the second string and key.
+
+ @param Context Unused.
+
+ @return Negative if the first string sorts before the second, zero if they
+         are equal, positive if the first string sorts after the second.
+ */
+int
+YoriLibSortCompareStringKeys(
+    __in PVOID Element1,
+    __in PVOID Element2,
+    __in_opt PVOID Context
+    )
+{
+    PYORILIB_SORT_STRING_KEY Key1 = (PYORILIB_SORT_STRING_KEY)Element1;
+    PYORILIB_SORT_STRING_KEY Key2 = (PYORILIB_SORT_STRING_KEY)Element2;
+    YORI_STRING Remainder1;
+    YORI_STRING Remainder2;
+
+    UNREFERENCED_PARAMETER(Context);
+
+    if (Key1->Prefix < Key2->Prefix) {
+        return -1;
+    } else if (Key1->Prefix > Key2->Prefix) {
+        return 1;
     }
 
     //
-    //  Check that it's now sorted
+    //  If both strings fit within the key, any difference in length is
+    //  due to trailing NUL characters, and the shorter string sorts first.
     //
-    for (Index = 0; Index < Count - 1; Index++) {
-        if (YoriLibCompareStringIns(&StringArray[Index], &StringArray[Index + 1]) > 0) {
-            break;
+
+    if (Key1->String.LengthInChars <= YORILIB_SORT_KEY_CHARS &&
+        Key2->String.LengthInChars <= YORILIB_SORT_KEY_CHARS) {
+
+        if (Key1->String.LengthInChars < Key2->String.LengthInChars) {
+            return -1;
+        } else if (Key1->String.LengthInChars > Key2->String.LengthInChars) {
+            return 1;
         }
+        return 0;
     }
-    ASSERT (Index == Count - 1);
+
+    YoriLibInitEmptyString(&Remainder1);
+    YoriLibInitEmptyString(&Remainder2);
+    if (Key1->String.LengthInChars > YORILIB_SORT_KEY_CHARS) {
+        Remainder1.StartOfString = &Key1->String.StartOfString[YORILIB_SORT_KEY_CHARS];
+        Remainder1.LengthInChars = (YORI_ALLOC_SIZE_T)(Key1->String.LengthInChars - YORILIB_SORT_KEY_CHARS);
+    }
+    if (Key2->String.LengthInChars > YORILIB_SORT_KEY_CHARS) {
+        Remainder2.StartOfString = &Key2->String.StartOfString[YORILIB_SORT_KEY_CHARS];
+        Remainder2.LengthInChars = (YORI_ALLOC_SIZE_T)(Key2->String.LengthInChars - YORILIB_SORT_KEY_CHARS);
+    }
+
+    return YoriLibCompareStringIns(&Remainder1, &Remainder2);
+}
+
+/**
+ Sort an array of strings without regard to case.
+
+ @param StringArray Pointer to an array of strings.
+
+ @param Count The number of elements in the array.
+
+ @param Flags Flags modifying the sort.  YORILIB_SORT_CACHE_KEYS computes an
+        upcased prefix of each string before sorting, so most comparisons
+        are a single integer comparison, at the cost of a temporary
+        allocation.  If the allocation fails the strings are sorted without
+        keys.  YORILIB_SORT_PARALLEL allows large arrays to be sorted with
+        multiple threads.
+ */
+VOID
+YoriLibSortStringArrayEx(
+    __in_ecount(Count) PYORI_STRING StringArray,
+    __in YORI_ALLOC_SIZE_T Count,
+    __in DWORD Flags
+    )
+{
+    PYORILIB_SORT_STRING_KEY Keys;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T CharIndex;
+    DWORDLONG Prefix;
+
+    if (Count <= 1) {
+        return;
+    }
+
+    Keys = NULL;
+    if ((Flags & YORILIB_SORT_CACHE_KEYS) &&
+        YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)Count * sizeof(YORILIB_SORT_STRING_KEY))) {
+
+        Keys = YoriLibMalloc(Count * sizeof(YORILIB_SORT_STRING_KEY));
+    }
+
+    if (Keys == NULL) {
+        YoriLibSortArray(StringArray, Count, sizeof(YORI_STRING), YoriLibSortCompareStrings, NULL, Flags);
+        return;
+    }
+
+    for (Index = 0; Index < Count; Index++) {
+        Prefix = 0;
+        for (CharIndex = 0; CharIndex < YORILIB_SORT_KEY_CHARS; CharIndex++) {
+            Prefix = Prefix << (sizeof(TCHAR) * 8);
+            if (CharIndex < StringArray[Index].LengthInChars) {
+                Prefix = Prefix | (DWORDLONG)YoriLibUpcaseChar(StringArray[Index].StartOfString[CharIndex]);
+            }
+        }
+        Keys[Index].Prefix = Prefix;
+        memcpy(&Keys[Index].String, &StringArray[Index], sizeof(YORI_STRING));
+    }
+
+    YoriLibSortArray(Keys, Count, sizeof(YORILIB_SORT_STRING_KEY), YoriLibSortCompareStringKeys, NULL, Flags);
+
+    for (Index = 0; Index < Count; Index++) {
+        memcpy(&StringArray[Index], &Keys[Index].String, sizeof(YORI_STRING));
+    }
+
+    YoriLibFree(Keys);
+}
+
+/**
+ Sort an array of strings without regard to case.  Keys are cached and large
+ arrays are sorted with multiple threads.
+
+ @param StringArray Pointer to an array of strings.
+
+ @param Count The number of elements in the array.
+ */
+VOID
+YoriLibSortStringArray(
+    __in_ecount(Count) PYORI_STRING StringArray,
+    __in YORI_ALLOC_SIZE_T Count
+    )
+{
+    YoriLibSortStringArrayEx(StringArray, Count, YORILIB_SORT_CACHE_KEYS | YORILIB_SORT_PARALLEL);
 }
 
 // vim:sw=4:ts=4:et:
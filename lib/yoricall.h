@@ -3,7 +3,7 @@
  *
  * Yori exported API for modules to call
  *
- * Copyright (c) 2017-2025 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -53,6 +53,10 @@ YoriCallBuiltinUnregister(
     __in PYORI_CMD_BUILTIN CallbackFn
     );
 
+__success(return)
+BOOL
+YoriCallClearExecutableCache(VOID);
+
 BOOL
 YoriCallClearHistoryStrings(VOID);
 
@@ -121,6 +125,12 @@ YoriCallGetEscapedArgumentsEx(
     __out PBOOLEAN * ArgContainsQuotes
     );
 
+__success(return)
+BOOL
+YoriCallGetExecutableCacheStrings(
+    __out PYORI_STRING CacheStrings
+    );
+
 __success(return)
 BOOL
 YoriCallGetHistoryStrings(
@@ -4,7 +4,7 @@
  * Header for library routines that may be of value from the shell as well
  * as external tools.
  *
- * Copyright (c) 2017-2021 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -194,6 +194,48 @@ typedef struct _YORI_LIB_BYTE_BUFFER {
 
 } YORI_LIB_BYTE_BUFFER, *PYORI_LIB_BYTE_BUFFER;
 
+/**
+ An arena that carves many small allocations from a small number of
+ reference counted blocks.  Each allocation holds a reference on its block,
+ so a group of allocations can be returned to the heap in one operation once
+ all of them have been released.
+ */
+typedef struct _YORI_LIB_ARENA {
+
+    /**
+     The block that allocations are currently being carved from.  The arena
+     holds a reference on this block.  NULL if no block has been allocated.
+     */
+    PUCHAR Block;
+
+    /**
+     The number of bytes in the current block.
+     */
+    YORI_ALLOC_SIZE_T BlockSize;
+
+    /**
+     The number of bytes in the current block that have been allocated.
+     */
+    YORI_ALLOC_SIZE_T BytesUsed;
+
+    /**
+     The number of bytes to allocate from the heap when a new block is
+     needed.
+     */
+    YORI_ALLOC_SIZE_T DefaultBlockSize;
+
+    /**
+     The number of heap allocations performed by this arena.
+     */
+    DWORD BlocksAllocated;
+
+    /**
+     The number of allocations satisfied by this arena.
+     */
+    DWORD AllocationsSatisfied;
+
+} YORI_LIB_ARENA, *PYORI_LIB_ARENA;
+
 /**
  A structure describing an entry that is an element of a hash table.
  */
@@ -243,6 +285,210 @@ typedef struct _YORI_HASH_TABLE {
     PYORI_HASH_BUCKET Buckets;
 } YORI_HASH_TABLE, *PYORI_HASH_TABLE;
 
+/**
+ A structure describing an entry that is an element of an open addressed
+ hash table.  Like YORI_HASH_ENTRY, this is embedded in a caller's
+ structure.
+ */
+typedef struct _YORI_OPEN_HASH_ENTRY {
+
+    /**
+     A string that represents the key for the object within the table.
+     */
+    YORI_STRING Key;
+
+    /**
+     An opaque context block that can be used by the user of the hash
+     table to identify the entry.
+     */
+    PVOID Context;
+
+    /**
+     The full 32 bit hash of the key.  This is retained so that the entry
+     can be moved to a larger table without rehashing the key, and so that
+     it can be located again when removing or enumerating.
+     */
+    DWORD Hash;
+} YORI_OPEN_HASH_ENTRY, *PYORI_OPEN_HASH_ENTRY;
+
+/**
+ A single array of slots within an open addressed hash table.  A table
+ normally has one of these, but has two while it is being resized.
+ */
+typedef struct _YORI_OPEN_HASH_SLOTS {
+
+    /**
+     The number of slots.  This is always a power of two so the hash can be
+     converted to an index with a mask.
+     */
+    YORI_ALLOC_SIZE_T SlotCount;
+
+    /**
+     The number of slots that are not empty, meaning they either contain an
+     entry or contain a marker indicating an entry was removed.  This
+     determines how long a probe sequence can be.
+     */
+    YORI_ALLOC_SIZE_T UsedCount;
+
+    /**
+     The number of slots that contain an entry.
+     */
+    YORI_ALLOC_SIZE_T LiveCount;
+
+    /**
+     An array of full 32 bit hashes, one per slot.  Probing scans this array
+     and only compares a key when the hash matches.  Two values are reserved
+     to indicate an empty slot and a removed entry.
+     */
+    PDWORD Hashes;
+
+    /**
+     An array of pointers to entries, one per slot.  This is part of the same
+     allocation as Hashes.
+     */
+    PYORI_OPEN_HASH_ENTRY *Entries;
+} YORI_OPEN_HASH_SLOTS, *PYORI_OPEN_HASH_SLOTS;
+
+/**
+ A structure describing an open addressed hash table.  Entries are located by
+ linear probing over an array of hashes, and the table grows automatically.
+ When it grows, entries are moved to the new array incrementally as part of
+ later insertions, so no single insertion needs to move the whole table.
+ */
+typedef struct _YORI_OPEN_HASH_TABLE {
+
+    /**
+     The array that new entries are inserted into.
+     */
+    YORI_OPEN_HASH_SLOTS Primary;
+
+    /**
+     The previous array while a resize is in progress.  Entries are removed
+     from here and placed into Primary as insertions occur.  SlotCount is
+     zero if no resize is in progress.
+     */
+    YORI_OPEN_HASH_SLOTS Draining;
+
+    /**
+     The next slot index in Draining to migrate into Primary.
+     */
+    YORI_ALLOC_SIZE_T DrainIndex;
+
+    /**
+     The number of entries in the table.
+     */
+    YORI_ALLOC_SIZE_T EntryCount;
+} YORI_OPEN_HASH_TABLE, *PYORI_OPEN_HASH_TABLE;
+
+/**
+ A single line within a section of an INI document.  Most lines are keys,
+ but comments, blank lines and other text are retained so that the file
+ can be written back without losing them.
+ */
+typedef struct _YORI_LIB_INI_KEY {
+
+    /**
+     The links of this line within the lines of its section.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The entry for this key within the section's hash table.  This is
+     only used if the line is a key.
+     */
+    YORI_OPEN_HASH_ENTRY HashEntry;
+
+    /**
+     The name of the key.  This is empty if the line is not a key.  This
+     string is NULL terminated.
+     */
+    YORI_STRING Name;
+
+    /**
+     The value of the key, with any enclosing quotes removed.  If the line
+     is not a key, this contains the text of the line.  This string is NULL
+     terminated.
+     */
+    YORI_STRING Value;
+
+    /**
+     TRUE if the line is not a key, and is written back as it was read.
+     */
+    BOOLEAN Verbatim;
+
+} YORI_LIB_INI_KEY, *PYORI_LIB_INI_KEY;
+
+/**
+ A section within an INI document.
+ */
+typedef struct _YORI_LIB_INI_SECTION {
+
+    /**
+     The links of this section within the sections of its document.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The entry for this section within the document's hash table.
+     */
+    YORI_OPEN_HASH_ENTRY HashEntry;
+
+    /**
+     The name of the section.  This string is NULL terminated.
+     */
+    YORI_STRING Name;
+
+    /**
+     A list of lines within the section, in the order they are written.
+     */
+    YORI_LIST_ENTRY KeyList;
+
+    /**
+     A hash table of keys within the section, indexed by name.
+     */
+    PYORI_OPEN_HASH_TABLE KeyHash;
+
+} YORI_LIB_INI_SECTION, *PYORI_LIB_INI_SECTION;
+
+/**
+ An INI file that has been loaded into memory.  Sections and keys can be
+ found without scanning the file, and any number of changes can be made
+ before the file is written back once.
+ */
+typedef struct _YORI_LIB_INI_DOCUMENT {
+
+    /**
+     The full path to the file.
+     */
+    YORI_STRING FilePath;
+
+    /**
+     A list of lines that precede the first section.
+     */
+    YORI_LIST_ENTRY PreambleList;
+
+    /**
+     A list of sections, in the order they are written.
+     */
+    YORI_LIST_ENTRY SectionList;
+
+    /**
+     A hash table of sections, indexed by name.
+     */
+    PYORI_OPEN_HASH_TABLE SectionHash;
+
+    /**
+     The encoding of the file, which is CP_ACP, CP_UTF8 or CP_UTF16.
+     */
+    DWORD Encoding;
+
+    /**
+     TRUE if the document has changed since it was loaded or saved.
+     */
+    BOOLEAN Modified;
+
+} YORI_LIB_INI_DOCUMENT, *PYORI_LIB_INI_DOCUMENT;
+
 #pragma pack(push, 1)
 
 /**
@@ -553,6 +799,179 @@ YoriLibSetAirplaneMode(
     __in BOOLEAN AirplaneModeEnabled
     );
 
+// *** ARENA.C ***
+
+VOID
+YoriLibArenaInitialize(
+    __out PYORI_LIB_ARENA Arena,
+    __in YORI_ALLOC_SIZE_T BlockSize
+    );
+
+VOID
+YoriLibArenaCleanup(
+    __inout PYORI_LIB_ARENA Arena
+    );
+
+#if DBG
+#define YORI_SPECIAL_HEAP 1
+#endif
+
+#if YORI_SPECIAL_HEAP
+
+PVOID
+YoriLibArenaAllocateSpecialHeap(
+    __inout PYORI_LIB_ARENA Arena,
+    __in YORI_ALLOC_SIZE_T Bytes,
+    __out PVOID *MemoryToFree,
+    __in LPCSTR Function,
+    __in LPCSTR File,
+    __in DWORD Line
+    );
+
+#ifndef __FUNCTION__
+#define __FUNCTION__ ""
+#endif
+
+#define YoriLibArenaAllocate(Arena, Bytes, MemoryToFree) \
+    YoriLibArenaAllocateSpecialHeap(Arena, Bytes, MemoryToFree, __FUNCTION__, __FILE__, __LINE__)
+
+#else
+PVOID
+YoriLibArenaAllocate(
+    __inout PYORI_LIB_ARENA Arena,
+    __in YORI_ALLOC_SIZE_T Bytes,
+    __out PVOID *MemoryToFree
+    );
+#endif
+
+// *** BASE64.C ***
+
+/**
+ The number of characters on each line of base64 output, matching the form
+ generated by CryptBinaryToString.
+ */
+#define YORI_LIB_BASE64_DEFAULT_LINE_LENGTH 64
+
+/**
+ The number of bytes that can be written when finalizing a base64 encode.
+ */
+#define YORI_LIB_BASE64_ENCODE_FINAL_SIZE 6
+
+/**
+ The number of bytes that can be written when finalizing a base64 decode.
+ */
+#define YORI_LIB_BASE64_DECODE_FINAL_SIZE 2
+
+/**
+ State describing a base64 encode which is in progress.
+ */
+typedef struct _YORI_LIB_BASE64_ENCODE_CONTEXT {
+
+    /**
+     The number of characters to output before each line break, or zero if
+     line breaks should not be output.
+     */
+    DWORD LineLength;
+
+    /**
+     The number of characters output since the last line break.
+     */
+    DWORD CharsOnLine;
+
+    /**
+     The number of bytes in Pending.
+     */
+    DWORD PendingLength;
+
+    /**
+     Bytes which do not yet form a complete three byte quantum.
+     */
+    UCHAR Pending[3];
+} YORI_LIB_BASE64_ENCODE_CONTEXT, *PYORI_LIB_BASE64_ENCODE_CONTEXT;
+
+/**
+ State describing a base64 decode which is in progress.
+ */
+typedef struct _YORI_LIB_BASE64_DECODE_CONTEXT {
+
+    /**
+     The six bit values of characters which do not yet form a complete four
+     character quantum.
+     */
+    DWORD Quantum;
+
+    /**
+     The number of characters in Quantum.
+     */
+    DWORD QuantumChars;
+
+    /**
+     The number of padding characters encountered.
+     */
+    DWORD PaddingChars;
+
+    /**
+     The number of characters processed.  If decoding fails, this is the
+     offset of the invalid character.
+     */
+    DWORDLONG CharsProcessed;
+} YORI_LIB_BASE64_DECODE_CONTEXT, *PYORI_LIB_BASE64_DECODE_CONTEXT;
+
+VOID
+YoriLibBase64EncodeInitialize(
+    __out PYORI_LIB_BASE64_ENCODE_CONTEXT Context,
+    __in DWORD LineLength
+    );
+
+YORI_ALLOC_SIZE_T
+YoriLibBase64EncodeGetBufferSize(
+    __in PYORI_LIB_BASE64_ENCODE_CONTEXT Context,
+    __in YORI_ALLOC_SIZE_T InputLength
+    );
+
+YORI_ALLOC_SIZE_T
+YoriLibBase64EncodeUpdate(
+    __inout PYORI_LIB_BASE64_ENCODE_CONTEXT Context,
+    __in_ecount(InputLength) CONST UCHAR * Input,
+    __in YORI_ALLOC_SIZE_T InputLength,
+    __out PUCHAR Output
+    );
+
+YORI_ALLOC_SIZE_T
+YoriLibBase64EncodeFinalize(
+    __inout PYORI_LIB_BASE64_ENCODE_CONTEXT Context,
+    __out_bcount(YORI_LIB_BASE64_ENCODE_FINAL_SIZE) PUCHAR Output
+    );
+
+VOID
+YoriLibBase64DecodeInitialize(
+    __out PYORI_LIB_BASE64_DECODE_CONTEXT Context
+    );
+
+YORI_ALLOC_SIZE_T
+YoriLibBase64DecodeGetBufferSize(
+    __in PYORI_LIB_BASE64_DECODE_CONTEXT Context,
+    __in YORI_ALLOC_SIZE_T InputLength
+    );
+
+__success(return)
+BOOLEAN
+YoriLibBase64DecodeUpdate(
+    __inout PYORI_LIB_BASE64_DECODE_CONTEXT Context,
+    __in_ecount(InputLength) CONST UCHAR * Input,
+    __in YORI_ALLOC_SIZE_T InputLength,
+    __out PUCHAR Output,
+    __out PYORI_ALLOC_SIZE_T OutputLength
+    );
+
+__success(return)
+BOOLEAN
+YoriLibBase64DecodeFinalize(
+    __inout PYORI_LIB_BASE64_DECODE_CONTEXT Context,
+    __out_bcount(YORI_LIB_BASE64_DECODE_FINAL_SIZE) PUCHAR Output,
+    __out PYORI_ALLOC_SIZE_T OutputLength
+    );
+
 // *** BARGRAPH.C ***
 
 BOOLEAN
@@ -1247,6 +1666,181 @@ YoriLibDbgRealAssert(
 #define ASSERT(x)
 #endif
 
+// *** DIGEST.C ***
+
+/**
+ The number of bytes in a SHA-256 digest.
+ */
+#define YORI_LIB_SHA256_DIGEST_SIZE 32
+
+/**
+ The number of bytes in an XXH3 digest.
+ */
+#define YORI_LIB_XXH3_DIGEST_SIZE 8
+
+/**
+ The number of bytes in a BLAKE3 digest.
+ */
+#define YORI_LIB_BLAKE3_DIGEST_SIZE 32
+
+/**
+ State describing a SHA-256 digest which is being calculated.
+ */
+typedef struct _YORI_LIB_SHA256_CONTEXT {
+
+    /**
+     The hash state after each complete block.
+     */
+    DWORD State[8];
+
+    /**
+     The total number of bytes added to the digest.
+     */
+    DWORDLONG BytesHashed;
+
+    /**
+     The number of bytes in Buffer.
+     */
+    DWORD BufferLength;
+
+    /**
+     Data which does not yet form a complete block.
+     */
+    UCHAR Buffer[64];
+} YORI_LIB_SHA256_CONTEXT, *PYORI_LIB_SHA256_CONTEXT;
+
+/**
+ State describing an XXH3 hash which is being calculated.
+ */
+typedef struct _YORI_LIB_XXH3_CONTEXT {
+
+    /**
+     The accumulators which input stripes are added to.
+     */
+    DWORDLONG Acc[8];
+
+    /**
+     The total number of bytes added to the hash.
+     */
+    DWORDLONG BytesHashed;
+
+    /**
+     The number of bytes in Buffer which have not been consumed.
+     */
+    DWORD BufferLength;
+
+    /**
+     The number of stripes consumed since the accumulators were last
+     scrambled.
+     */
+    DWORD StripesInBlock;
+
+    /**
+     Data which has not been consumed by the accumulators, because it is not
+     yet known whether it contains the final stripe.
+     */
+    UCHAR Buffer[256];
+} YORI_LIB_XXH3_CONTEXT, *PYORI_LIB_XXH3_CONTEXT;
+
+/**
+ State describing a BLAKE3 hash which is being calculated.
+ */
+typedef struct _YORI_LIB_BLAKE3_CONTEXT {
+
+    /**
+     The chaining value of the chunk being processed.
+     */
+    DWORD ChunkCv[8];
+
+    /**
+     The index of the chunk being processed.
+     */
+    DWORDLONG ChunkCounter;
+
+    /**
+     The number of blocks within the current chunk which have been
+     compressed.
+     */
+    DWORD BlocksCompressed;
+
+    /**
+     The number of bytes in Block.
+     */
+    DWORD BlockLength;
+
+    /**
+     The number of chaining values in CvStack.
+     */
+    DWORD CvStackDepth;
+
+    /**
+     Data which has not been compressed, because it is not yet known whether
+     it is the final block of the chunk.
+     */
+    UCHAR Block[64];
+
+    /**
+     The chaining values of completed subtrees which are waiting for a
+     sibling subtree of the same size.  This can contain one value for each
+     bit of the chunk counter.
+     */
+    DWORD CvStack[54 * 8];
+} YORI_LIB_BLAKE3_CONTEXT, *PYORI_LIB_BLAKE3_CONTEXT;
+
+VOID
+YoriLibSha256Initialize(
+    __out PYORI_LIB_SHA256_CONTEXT Context
+    );
+
+VOID
+YoriLibSha256Update(
+    __inout PYORI_LIB_SHA256_CONTEXT Context,
+    __in_ecount(Length) CONST UCHAR * Buffer,
+    __in DWORD Length
+    );
+
+VOID
+YoriLibSha256Finalize(
+    __inout PYORI_LIB_SHA256_CONTEXT Context,
+    __out_bcount(YORI_LIB_SHA256_DIGEST_SIZE) PUCHAR Digest
+    );
+
+VOID
+YoriLibXxh3Initialize(
+    __out PYORI_LIB_XXH3_CONTEXT Context
+    );
+
+VOID
+YoriLibXxh3Update(
+    __inout PYORI_LIB_XXH3_CONTEXT Context,
+    __in_ecount(Length) CONST UCHAR * Buffer,
+    __in DWORD Length
+    );
+
+VOID
+YoriLibXxh3Finalize(
+    __inout PYORI_LIB_XXH3_CONTEXT Context,
+    __out_bcount(YORI_LIB_XXH3_DIGEST_SIZE) PUCHAR Digest
+    );
+
+VOID
+YoriLibBlake3Initialize(
+    __out PYORI_LIB_BLAKE3_CONTEXT Context
+    );
+
+VOID
+YoriLibBlake3Update(
+    __inout PYORI_LIB_BLAKE3_CONTEXT Context,
+    __in_ecount(Length) CONST UCHAR * Buffer,
+    __in DWORD Length
+    );
+
+VOID
+YoriLibBlake3Finalize(
+    __inout PYORI_LIB_BLAKE3_CONTEXT Context,
+    __out_bcount(YORI_LIB_BLAKE3_DIGEST_SIZE) PUCHAR Digest
+    );
+
 // *** DYLD.C ***
 
 __success(return)
@@ -1605,6 +2199,18 @@ typedef YORILIB_FILE_ENUM_FN *PYORILIB_FILE_ENUM_FN;
  */
 #define YORILIB_ENUM_DIRECTORY_CONTENTS      0x00000100
 
+/**
+ When recursing, enumerate subdirectories concurrently on a pool of worker
+ threads.  The callback and error callback can be invoked concurrently from
+ any of these threads and the calling thread, so any state they update must
+ be synchronized.  Objects within a single directory are reported in
+ sequence by one thread, and the ordering between a directory and its
+ contents requested by YORILIB_ENUM_REC_BEFORE_RETURN or
+ YORILIB_ENUM_REC_AFTER_RETURN is preserved, but the order between sibling
+ directories is not.  Callbacks must not change the current directory.
+ */
+#define YORILIB_ENUM_PARALLEL                0x00000200
+
 __success(return)
 BOOL
 YoriLibForEachFile(
@@ -2674,6 +3280,49 @@ YoriLibHashRemoveByKey(
     __in PYORI_STRING KeyString
     );
 
+PYORI_OPEN_HASH_TABLE
+YoriLibAllocateOpenHashTable(
+    __in YORI_ALLOC_SIZE_T ExpectedEntries
+    );
+
+VOID
+YoriLibFreeEmptyOpenHashTable(
+    __in PYORI_OPEN_HASH_TABLE HashTable
+    );
+
+__success(return)
+BOOLEAN
+YoriLibOpenHashInsertByKey(
+    __in PYORI_OPEN_HASH_TABLE HashTable,
+    __in PYORI_STRING KeyString,
+    __in PVOID Context,
+    __out PYORI_OPEN_HASH_ENTRY HashEntry
+    );
+
+PYORI_OPEN_HASH_ENTRY
+YoriLibOpenHashLookupByKey(
+    __in PYORI_OPEN_HASH_TABLE HashTable,
+    __in PCYORI_STRING KeyString
+    );
+
+VOID
+YoriLibOpenHashRemoveByEntry(
+    __in PYORI_OPEN_HASH_TABLE HashTable,
+    __in PYORI_OPEN_HASH_ENTRY HashEntry
+    );
+
+PYORI_OPEN_HASH_ENTRY
+YoriLibOpenHashRemoveByKey(
+    __in PYORI_OPEN_HASH_TABLE HashTable,
+    __in PCYORI_STRING KeyString
+    );
+
+PYORI_OPEN_HASH_ENTRY
+YoriLibOpenHashGetNextEntry(
+    __in PYORI_OPEN_HASH_TABLE HashTable,
+    __in_opt PYORI_OPEN_HASH_ENTRY PreviousEntry
+    );
+
 // *** HEXDUMP.C ***
 
 /**
@@ -2864,6 +3513,96 @@ YoriLibMultibyteInput(
     __in YORI_ALLOC_SIZE_T OutputBufferLength
     );
 
+// *** INI.C ***
+
+__success(return)
+BOOL
+YoriLibIniLoad(
+    __out PYORI_LIB_INI_DOCUMENT Document,
+    __in PCYORI_STRING FilePath
+    );
+
+__success(return)
+BOOL
+YoriLibIniSave(
+    __inout PYORI_LIB_INI_DOCUMENT Document
+    );
+
+VOID
+YoriLibIniCleanup(
+    __inout PYORI_LIB_INI_DOCUMENT Document
+    );
+
+PYORI_LIB_INI_SECTION
+YoriLibIniFindSection(
+    __in PYORI_LIB_INI_DOCUMENT Document,
+    __in LPCTSTR SectionName
+    );
+
+PYORI_LIB_INI_KEY
+YoriLibIniFindKey(
+    __in PYORI_LIB_INI_SECTION Section,
+    __in LPCTSTR KeyName
+    );
+
+PYORI_LIB_INI_KEY
+YoriLibIniFindSectionKey(
+    __in PYORI_LIB_INI_DOCUMENT Document,
+    __in LPCTSTR SectionName,
+    __in LPCTSTR KeyName
+    );
+
+__success(return)
+BOOL
+YoriLibIniGetString(
+    __in PYORI_LIB_INI_DOCUMENT Document,
+    __in LPCTSTR SectionName,
+    __in LPCTSTR KeyName,
+    __inout PYORI_STRING Value
+    );
+
+DWORD
+YoriLibIniGetInt(
+    __in PYORI_LIB_INI_DOCUMENT Document,
+    __in LPCTSTR SectionName,
+    __in LPCTSTR KeyName,
+    __in DWORD Default
+    );
+
+__success(return)
+BOOL
+YoriLibIniSetString(
+    __inout PYORI_LIB_INI_DOCUMENT Document,
+    __in LPCTSTR SectionName,
+    __in LPCTSTR KeyName,
+    __in LPCTSTR Value
+    );
+
+VOID
+YoriLibIniDeleteKey(
+    __inout PYORI_LIB_INI_DOCUMENT Document,
+    __in LPCTSTR SectionName,
+    __in LPCTSTR KeyName
+    );
+
+VOID
+YoriLibIniDeleteSection(
+    __inout PYORI_LIB_INI_DOCUMENT Document,
+    __in LPCTSTR SectionName
+    );
+
+PYORI_LIB_INI_SECTION
+YoriLibIniGetNextSection(
+    __in PYORI_LIB_INI_DOCUMENT Document,
+    __in_opt PYORI_LIB_INI_SECTION PreviousSection
+    );
+
+PYORI_LIB_INI_KEY
+YoriLibIniGetNextKey(
+    __in PYORI_LIB_INI_SECTION Section,
+    __in_opt PYORI_LIB_INI_KEY PreviousKey
+    );
+
 // *** JOBOBJ.C ***
 
 HANDLE
@@ -2894,6 +3633,52 @@ YoriLibDisplayMitLicense(
     __in LPCTSTR CopyrightYear
     );
 
+// *** LINECNT.C ***
+
+/**
+ The number of lines found in a stream, and optionally their lengths in
+ UTF16 characters.
+ */
+typedef struct _YORI_LIB_LINE_COUNT {
+
+    /**
+     The number of lines found.
+     */
+    YORI_MAX_UNSIGNED_T LineCount;
+
+    /**
+     The total number of characters in all lines, excluding line endings.
+     */
+    YORI_MAX_UNSIGNED_T TotalChars;
+
+    /**
+     The number of characters in the shortest line.
+     */
+    YORI_MAX_UNSIGNED_T ShortestLine;
+
+    /**
+     The number of characters in the longest line.
+     */
+    YORI_MAX_UNSIGNED_T LongestLine;
+
+} YORI_LIB_LINE_COUNT, *PYORI_LIB_LINE_COUNT;
+
+__success(return)
+BOOL
+YoriLibCountLines(
+    __in HANDLE FileHandle,
+    __in BOOLEAN MeasureLines,
+    __out PYORI_LIB_LINE_COUNT LineCount
+    );
+
+__success(return)
+BOOL
+YoriLibFindFinalLines(
+    __in HANDLE FileHandle,
+    __in YORI_MAX_UNSIGNED_T LineCount,
+    __out PYORI_MAX_UNSIGNED_T Offset
+    );
+
 // *** LINEREAD.C ***
 
 /**
@@ -2911,6 +3696,35 @@ typedef enum _YORI_LIB_LINE_ENDING {
  */
 typedef YORI_LIB_LINE_ENDING *PYORI_LIB_LINE_ENDING;
 
+/**
+ A single line returned from YoriLibReadLineBatch.
+ */
+typedef struct _YORI_LIB_LINE_SPAN {
+
+    /**
+     The contents of the line, excluding the line ending.  This refers to
+     memory within the caller's batch buffer and is not NULL terminated.
+     */
+    YORI_STRING Line;
+
+    /**
+     The characters that terminated the line.
+     */
+    YORI_LIB_LINE_ENDING LineEnding;
+} YORI_LIB_LINE_SPAN, *PYORI_LIB_LINE_SPAN;
+
+YORI_ALLOC_SIZE_T
+YoriLibFindLineDelimiterA(
+    __in_ecount(Length) PUCHAR Buffer,
+    __in YORI_ALLOC_SIZE_T Length
+    );
+
+YORI_ALLOC_SIZE_T
+YoriLibFindLineDelimiterW(
+    __in_ecount(Length) PWCHAR Buffer,
+    __in YORI_ALLOC_SIZE_T Length
+    );
+
 PVOID
 YoriLibReadLineToString(
     __in PYORI_STRING UserString,
@@ -2929,6 +3743,18 @@ YoriLibReadLineToStringEx(
     __out PBOOL TimeoutReached
     );
 
+__success(return)
+BOOL
+YoriLibReadLineBatch(
+    __inout PYORI_STRING BatchBuffer,
+    __inout PVOID * Context,
+    __in BOOL ReturnFinalNonTerminatedLine,
+    __in HANDLE FileHandle,
+    __out_ecount(MaximumLines) PYORI_LIB_LINE_SPAN Lines,
+    __in YORI_ALLOC_SIZE_T MaximumLines,
+    __out PYORI_ALLOC_SIZE_T LinesReturned
+    );
+
 VOID
 YoriLibLineReadClose(
     __in_opt PVOID Context
@@ -3039,6 +3865,9 @@ YoriLibFree(
 VOID
 YoriLibDisplayMemoryUsage(VOID);
 
+DWORD
+YoriLibGetAllocationCount(VOID);
+
 
 VOID
 YoriLibReference(
@@ -3408,6 +4237,140 @@ YoriLibRecycleBinFile(
     __in PYORI_STRING FilePath
     );
 
+// *** REGEX.C ***
+
+/**
+ The operations that can be performed by an instruction within a compiled
+ regular expression.
+ */
+typedef enum _YORI_LIB_REGEX_OP {
+    YoriLibRegexOpChar = 0,
+    YoriLibRegexOpAny = 1,
+    YoriLibRegexOpClass = 2,
+    YoriLibRegexOpHighSurrogate = 3,
+    YoriLibRegexOpLowSurrogate = 4,
+    YoriLibRegexOpSplit = 5,
+    YoriLibRegexOpJump = 6,
+    YoriLibRegexOpLineStart = 7,
+    YoriLibRegexOpLineEnd = 8,
+    YoriLibRegexOpWordBoundary = 9,
+    YoriLibRegexOpNotWordBoundary = 10,
+    YoriLibRegexOpMatch = 11
+} YORI_LIB_REGEX_OP;
+
+/**
+ A single instruction within a compiled regular expression.
+ */
+typedef struct _YORI_LIB_REGEX_INST {
+
+    /**
+     The operation that this instruction performs.
+     */
+    YORI_LIB_REGEX_OP Op;
+
+    /**
+     For a character, the character to match, which is upcased if the
+     expression is case insensitive.  For a class, the index of the class.
+     For a split or jump, the index of the preferred next instruction.  For
+     a match, the index of the pattern that has been matched.
+     */
+    YORI_ALLOC_SIZE_T Arg;
+
+    /**
+     For a split, the index of the less preferred next instruction.
+     */
+    YORI_ALLOC_SIZE_T Alt;
+} YORI_LIB_REGEX_INST, *PYORI_LIB_REGEX_INST;
+
+/**
+ A set of regular expressions compiled into a single program which is
+ executed as a nondeterministic automaton.  Every thread of the automaton
+ advances in lockstep over the string being searched, so searching takes
+ time proportional to the length of the string multiplied by the size of
+ the program, regardless of the expressions or the input.
+ */
+typedef struct _YORI_LIB_REGEX {
+
+    /**
+     The array of patterns that the expression was compiled from.  Matches
+     are returned as pointers into this array.
+     */
+    PYORI_STRING PatternArray;
+
+    /**
+     The number of elements in PatternArray.
+     */
+    YORI_ALLOC_SIZE_T NumberPatterns;
+
+    /**
+     The number of elements in Insts.
+     */
+    YORI_ALLOC_SIZE_T InstCount;
+
+    /**
+     The number of character classes in Classes.
+     */
+    YORI_ALLOC_SIZE_T ClassCount;
+
+    /**
+     TRUE if patterns are matched case insensitively.
+     */
+    BOOLEAN Insensitive;
+
+    /**
+     TRUE if a match can begin with any character, or with no character,
+     so FirstChars cannot be used to skip over the string being searched.
+     */
+    BOOLEAN AnyFirstChar;
+
+    /**
+     The program to execute.
+     */
+    PYORI_LIB_REGEX_INST Insts;
+
+    /**
+     An array of bitmaps, each with one bit per character, describing the
+     characters which are matched by each character class.
+     */
+    PDWORD Classes;
+
+    /**
+     A bitmap with one bit per character, set if any match can start with
+     that character.
+     */
+    DWORD FirstChars[0x10000 / 32];
+} YORI_LIB_REGEX, *PYORI_LIB_REGEX;
+
+PYORI_LIB_REGEX
+YoriLibAllocateRegex(
+    __in YORI_ALLOC_SIZE_T NumberPatterns,
+    __in PYORI_STRING PatternArray,
+    __in BOOLEAN Insensitive,
+    __out_opt PYORI_ALLOC_SIZE_T ErrorPattern,
+    __out_opt PYORI_ALLOC_SIZE_T ErrorOffset
+    );
+
+VOID
+YoriLibFreeRegex(
+    __in PYORI_LIB_REGEX Regex
+    );
+
+PYORI_STRING
+YoriLibRegexFindFirst(
+    __in PYORI_LIB_REGEX Regex,
+    __in PCYORI_STRING String,
+    __in YORI_ALLOC_SIZE_T StartOffset,
+    __out_opt PYORI_ALLOC_SIZE_T StringOffsetOfMatch,
+    __out_opt PYORI_ALLOC_SIZE_T LengthOfMatch
+    );
+
+PYORI_STRING
+YoriLibRegexFindLowestEntry(
+    __in PYORI_LIB_REGEX Regex,
+    __in PCYORI_STRING String,
+    __out_opt PYORI_ALLOC_SIZE_T StringOffsetOfMatch
+    );
+
 // *** RSRC.C ***
 
 __success(return)
@@ -3932,6 +4895,105 @@ YoriLibCntStringTrailingChars(
     __in LPCTSTR chars
     );
 
+/**
+ A node within a compiled substring matcher.  Each node corresponds to a
+ prefix of one or more of the substrings being searched for.
+ */
+typedef struct _YORI_LIB_SUBSTR_MATCHER_NODE {
+
+    /**
+     The index of the first node whose prefix extends this one by one
+     character, or zero if there are none.
+     */
+    YORI_ALLOC_SIZE_T FirstChild;
+
+    /**
+     The index of the next node with the same parent as this one, or zero
+     if there are no more.
+     */
+    YORI_ALLOC_SIZE_T NextSibling;
+
+    /**
+     The index of the node corresponding to the longest suffix of this
+     node's prefix which is also a prefix of a substring.
+     */
+    YORI_ALLOC_SIZE_T Fail;
+
+    /**
+     The index of the nearest node reachable via Fail links that completes
+     a substring, or zero if there is none.
+     */
+    YORI_ALLOC_SIZE_T Output;
+
+    /**
+     If this node completes a substring, the index of that substring in the
+     match array.  If not, this is (YORI_ALLOC_SIZE_T)-1.
+     */
+    YORI_ALLOC_SIZE_T MatchIndex;
+
+    /**
+     The number of characters in this node's prefix.
+     */
+    YORI_ALLOC_SIZE_T Depth;
+
+    /**
+     The final character of this node's prefix.
+     */
+    TCHAR Char;
+} YORI_LIB_SUBSTR_MATCHER_NODE, *PYORI_LIB_SUBSTR_MATCHER_NODE;
+
+/**
+ A set of substrings compiled so that any of them can be found with a single
+ pass over a string.
+ */
+typedef struct _YORI_LIB_SUBSTR_MATCHER {
+
+    /**
+     The array of substrings that the matcher was built from.  Matches are
+     returned as pointers into this array.
+     */
+    PYORI_STRING MatchArray;
+
+    /**
+     The number of elements in MatchArray.
+     */
+    YORI_ALLOC_SIZE_T NumberMatches;
+
+    /**
+     The number of elements in Nodes.
+     */
+    YORI_ALLOC_SIZE_T NodeCount;
+
+    /**
+     The length of the longest substring, in characters.
+     */
+    YORI_ALLOC_SIZE_T MaximumLength;
+
+    /**
+     The index of the first empty substring in MatchArray, which matches at
+     the start of any nonempty string, or (YORI_ALLOC_SIZE_T)-1 if there is
+     no empty substring.
+     */
+    YORI_ALLOC_SIZE_T EmptyMatchIndex;
+
+    /**
+     TRUE if substrings are matched case insensitively.
+     */
+    BOOLEAN Insensitive;
+
+    /**
+     The nodes of the trie.  Node zero is the root, corresponding to an
+     empty prefix.
+     */
+    PYORI_LIB_SUBSTR_MATCHER_NODE Nodes;
+
+    /**
+     A bitmap with one bit per character, set if any substring starts with
+     that character.
+     */
+    DWORD RootChars[0x10000 / 32];
+} YORI_LIB_SUBSTR_MATCHER, *PYORI_LIB_SUBSTR_MATCHER;
+
 PYORI_STRING
 YoriLibFindFirstMatchSubstr(
     __in PCYORI_STRING String,
@@ -3948,6 +5010,32 @@ YoriLibFindFirstMatchSubstrIns(
     __out_opt PYORI_ALLOC_SIZE_T StringOffsetOfMatch
     );
 
+PYORI_LIB_SUBSTR_MATCHER
+YoriLibAllocateSubstrMatcher(
+    __in YORI_ALLOC_SIZE_T NumberMatches,
+    __in PYORI_STRING MatchArray,
+    __in BOOLEAN Insensitive
+    );
+
+VOID
+YoriLibFreeSubstrMatcher(
+    __in PYORI_LIB_SUBSTR_MATCHER Matcher
+    );
+
+PYORI_STRING
+YoriLibSubstrMatcherFindFirst(
+    __in PYORI_LIB_SUBSTR_MATCHER Matcher,
+    __in PCYORI_STRING String,
+    __out_opt PYORI_ALLOC_SIZE_T StringOffsetOfMatch
+    );
+
+PYORI_STRING
+YoriLibSubstrMatcherFindLowestEntry(
+    __in PYORI_LIB_SUBSTR_MATCHER Matcher,
+    __in PCYORI_STRING String,
+    __out_opt PYORI_ALLOC_SIZE_T StringOffsetOfMatch
+    );
+
 PYORI_STRING
 YoriLibFindLastMatchSubstr(
     __in PCYORI_STRING String,
@@ -4027,6 +5115,49 @@ YoriLibStringToDateTime(
     __out LPSYSTEMTIME Date
     );
 
+/**
+ A prototype for a callback function to compare two elements when sorting an
+ array.  Returns negative if the first element sorts before the second, zero
+ if they are equal, and positive if the first element sorts after the
+ second.
+ */
+typedef int YORILIB_SORT_COMPARE_FN(PVOID Element1, PVOID Element2, PVOID Context);
+
+/**
+ A pointer to a callback function to compare two elements when sorting an
+ array.
+ */
+typedef YORILIB_SORT_COMPARE_FN *PYORILIB_SORT_COMPARE_FN;
+
+/**
+ Compute an upcased prefix of each string before sorting, so that most
+ comparisons are a single integer comparison.
+ */
+#define YORILIB_SORT_CACHE_KEYS              0x00000001
+
+/**
+ Allow large arrays to be sorted with multiple threads.  The compare function
+ may be called concurrently.
+ */
+#define YORILIB_SORT_PARALLEL                0x00000002
+
+VOID
+YoriLibSortArray(
+    __inout PVOID Base,
+    __in YORI_ALLOC_SIZE_T Count,
+    __in YORI_ALLOC_SIZE_T ElementSize,
+    __in PYORILIB_SORT_COMPARE_FN CompareFn,
+    __in_opt PVOID Context,
+    __in DWORD Flags
+    );
+
+VOID
+YoriLibSortStringArrayEx(
+    __in_ecount(Count) PYORI_STRING StringArray,
+    __in YORI_ALLOC_SIZE_T Count,
+    __in DWORD Flags
+    );
+
 VOID
 YoriLibSortStringArray(
     __in_ecount(Count) PYORI_STRING StringArray,
@@ -4420,6 +5551,96 @@ YoriLibOutputString(
     __in PYORI_STRING String
     );
 
+__success(return)
+BOOL
+YoriLibOutputAsciiToDevice(
+    __in HANDLE hOut,
+    __in_ecount(Length) CONST UCHAR * Text,
+    __in YORI_ALLOC_SIZE_T Length,
+    __inout PYORI_STRING Buffer
+    );
+
+/**
+ The default number of characters accumulated by an output stream before
+ writing to its device.
+ */
+#define YORI_LIB_OUTPUT_STREAM_DEFAULT_FLUSH 0x4000
+
+/**
+ A stream that accumulates output to a device and writes it in batches.  The
+ stream is not synchronized and should be used by one thread at a time.
+ */
+typedef struct _YORI_LIB_OUTPUT_STREAM {
+
+    /**
+     The device to output to.
+     */
+    HANDLE hOutput;
+
+    /**
+     The callback functions used to output to the device, selected when the
+     stream is initialized.
+     */
+    YORI_LIB_VT_CALLBACK_FUNCTIONS Callbacks;
+
+    /**
+     Text that has been buffered but not yet written to the device.  This
+     is allocated when the first text is written, and grows if a single
+     string is larger than the flush size.
+     */
+    YORI_STRING Buffer;
+
+    /**
+     The number of characters to accumulate before writing to the device.
+     */
+    YORI_ALLOC_SIZE_T FlushSize;
+
+    /**
+     Flags, indicating behavior, as supplied when the stream was
+     initialized.
+     */
+    WORD Flags;
+
+} YORI_LIB_OUTPUT_STREAM, *PYORI_LIB_OUTPUT_STREAM;
+
+VOID
+YoriLibOutputStreamInitializeForDevice(
+    __out PYORI_LIB_OUTPUT_STREAM Stream,
+    __in HANDLE hOut,
+    __in WORD Flags,
+    __in YORI_ALLOC_SIZE_T FlushSize
+    );
+
+VOID
+YoriLibOutputStreamInitialize(
+    __out PYORI_LIB_OUTPUT_STREAM Stream,
+    __in WORD Flags,
+    __in YORI_ALLOC_SIZE_T FlushSize
+    );
+
+BOOL
+YoriLibOutputStreamFlush(
+    __inout PYORI_LIB_OUTPUT_STREAM Stream
+    );
+
+BOOL
+YoriLibOutputStreamClose(
+    __inout PYORI_LIB_OUTPUT_STREAM Stream
+    );
+
+BOOL
+YoriLibOutputStreamString(
+    __inout PYORI_LIB_OUTPUT_STREAM Stream,
+    __in PCYORI_STRING String
+    );
+
+BOOL
+YoriLibOutputStream(
+    __inout PYORI_LIB_OUTPUT_STREAM Stream,
+    __in LPCTSTR szFmt,
+    ...
+    );
+
 BOOL
 YoriLibVtSetConsoleTextAttrDev(
     __in HANDLE hOut,
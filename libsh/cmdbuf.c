@@ -3,7 +3,7 @@
  *
  * Facilities for managing buffers of executing processes
  *
- * Copyright (c) 2017-2019 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -28,6 +28,76 @@
 #include <yorilib.h>
 #include <yorish.h>
 
+/**
+ The size of the first segment allocated to hold the output of a process, in
+ bytes.  Most processes whose output is buffered generate very little, so
+ this is kept small.
+ */
+#define YORI_LIBSH_PROCESS_BUFFER_INITIAL_SEGMENT_SIZE 1024
+
+/**
+ The largest size of a segment allocated to hold the output of a process, in
+ bytes.  Each segment is twice the size of the previous one until this size
+ is reached.  This is also the size of the buffer used to read and write
+ output that has been spilled to a temporary file.
+ */
+#define YORI_LIBSH_PROCESS_BUFFER_SEGMENT_SIZE (64 * 1024)
+
+/**
+ A single contiguous region of memory holding part of the output of a
+ process.  Segments are never reallocated, so when a segment is full, a new
+ one is added to the end of the chain.
+ */
+typedef struct _YORI_LIBSH_PROCESS_BUFFER_SEGMENT {
+
+    /**
+     The link into the list of segments for the stream.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The number of bytes allocated to this segment.
+     */
+    YORI_ALLOC_SIZE_T BytesAllocated;
+
+    /**
+     The number of bytes populated with data in this segment.  Only the final
+     segment in the chain can have fewer bytes populated than allocated.
+     */
+    YORI_ALLOC_SIZE_T BytesPopulated;
+
+    /**
+     Pointer to the data in this segment, which immediately follows this
+     structure.
+     */
+    PUCHAR Buffer;
+
+} YORI_LIBSH_PROCESS_BUFFER_SEGMENT, *PYORI_LIBSH_PROCESS_BUFFER_SEGMENT;
+
+/**
+ A position within the output of a process, used to walk through the
+ segments and any temporary file in order.
+ */
+typedef struct _YORI_LIBSH_PROCESS_BUFFER_CURSOR {
+
+    /**
+     The offset from the start of the output, in bytes.
+     */
+    DWORDLONG Offset;
+
+    /**
+     The segment containing Offset, or NULL if the cursor has not yet been
+     used to locate any data in memory.
+     */
+    PYORI_LIBSH_PROCESS_BUFFER_SEGMENT Segment;
+
+    /**
+     The offset within Segment corresponding to Offset.
+     */
+    YORI_ALLOC_SIZE_T SegmentOffset;
+
+} YORI_LIBSH_PROCESS_BUFFER_CURSOR, *PYORI_LIBSH_PROCESS_BUFFER_CURSOR;
+
 /**
  A buffer for a single data stream.  A process may have a different buffered
  data stream for stdout as well as stderr.
@@ -35,14 +105,41 @@
 typedef struct _YORI_LIBSH_PROCESS_BUFFER {
 
     /**
-     The number of bytes currently allocated to this buffer.
+     The list of segments containing data for this stream.
      */
-    YORI_ALLOC_SIZE_T BytesAllocated;
+    YORI_LIST_ENTRY SegmentList;
 
     /**
-     The number of bytes populated with data in this buffer.
+     The number of bytes populated with data in this stream, including data
+     in memory and data in any temporary file.
      */
-    YORI_ALLOC_SIZE_T BytesPopulated;
+    DWORDLONG BytesPopulated;
+
+    /**
+     The number of bytes populated with data in the segments of this stream.
+     Any data beyond this point is in the temporary file.
+     */
+    DWORDLONG BytesInMemory;
+
+    /**
+     The number of bytes that can be held in memory before further data is
+     written to a temporary file.  Zero indicates data is always held in
+     memory.
+     */
+    DWORDLONG SpillThreshold;
+
+    /**
+     A handle to a temporary file containing data beyond BytesInMemory, or
+     NULL if all data is in memory.
+     */
+    HANDLE hSpillFile;
+
+    /**
+     A buffer of YORI_LIBSH_PROCESS_BUFFER_SEGMENT_SIZE bytes used to
+     transfer data to and from hSpillFile by the thread processing this
+     stream.  This is only allocated if hSpillFile is in use.
+     */
+    PUCHAR SpillBuffer;
 
     /**
      A handle to the buffer processing thread.
@@ -66,14 +163,9 @@ typedef struct _YORI_LIBSH_PROCESS_BUFFER {
     HANDLE hMirror;
 
     /**
-     The number of bytes which have been sent to hMirror.
+     The position of the next data to send to hMirror.
      */
-    DWORD BytesSent;
-
-    /**
-     The data buffer.
-     */
-    PCHAR Buffer;
+    YORI_LIBSH_PROCESS_BUFFER_CURSOR MirrorCursor;
 
 } YORI_LIBSH_PROCESS_BUFFER, *PYORI_LIBSH_PROCESS_BUFFER;
 
@@ -151,8 +243,23 @@ YoriLibShFreeProcessBuffer(
     __in PYORI_LIBSH_PROCESS_BUFFER ThisBuffer
     )
 {
-    if (ThisBuffer->Buffer != NULL) {
-        YoriLibFree(ThisBuffer->Buffer);
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_LIBSH_PROCESS_BUFFER_SEGMENT Segment;
+
+    if (ThisBuffer->SegmentList.Next != NULL) {
+        ListEntry = YoriLibGetNextListEntry(&ThisBuffer->SegmentList, NULL);
+        while (ListEntry != NULL) {
+            Segment = CONTAINING_RECORD(ListEntry, YORI_LIBSH_PROCESS_BUFFER_SEGMENT, ListEntry);
+            ListEntry = YoriLibGetNextListEntry(&ThisBuffer->SegmentList, ListEntry);
+            YoriLibRemoveListItem(&Segment->ListEntry);
+            YoriLibFree(Segment);
+        }
+    }
+    if (ThisBuffer->hSpillFile != NULL) {
+        CloseHandle(ThisBuffer->hSpillFile);
+    }
+    if (ThisBuffer->SpillBuffer != NULL) {
+        YoriLibFree(ThisBuffer->SpillBuffer);
     }
     if (ThisBuffer->hMirror != NULL) {
         CloseHandle(ThisBuffer->hMirror);
@@ -184,6 +291,675 @@ YoriLibShFreeProcessBuffers(
     YoriLibFree(ThisBuffer);
 }
 
+/**
+ Allocate a new segment and add it to the end of the chain of segments for
+ a stream.
+
+ @param ThisBuffer Pointer to the stream to add a segment to.
+
+ @param BytesAllocated The number of bytes of data the segment should hold.
+
+ @return Pointer to the new segment, or NULL on allocation failure.
+ */
+PYORI_LIBSH_PROCESS_BUFFER_SEGMENT
+YoriLibShAllocateProcessBufferSegment(
+    __in PYORI_LIBSH_PROCESS_BUFFER ThisBuffer,
+    __in YORI_ALLOC_SIZE_T BytesAllocated
+    )
+{
+    PYORI_LIBSH_PROCESS_BUFFER_SEGMENT Segment;
+
+    Segment = YoriLibMalloc(sizeof(YORI_LIBSH_PROCESS_BUFFER_SEGMENT) + BytesAllocated);
+    if (Segment == NULL) {
+        return NULL;
+    }
+
+    Segment->BytesAllocated = BytesAllocated;
+    Segment->BytesPopulated = 0;
+    Segment->Buffer = (PUCHAR)(Segment + 1);
+
+    //
+    //  Readers walk the chain under the mutex, so it can only be extended
+    //  while the mutex is held.
+    //
+
+    AcquireMutex(ThisBuffer->Mutex);
+    YoriLibAppendList(&ThisBuffer->SegmentList, &Segment->ListEntry);
+    ReleaseMutex(ThisBuffer->Mutex);
+
+    return Segment;
+}
+
+/**
+ Create a temporary file to hold any further output from a stream that has
+ exceeded its spill threshold.  The file is deleted when its handle is
+ closed.
+
+ @param ThisBuffer Pointer to the stream.
+
+ @return TRUE to indicate the temporary file is ready for use, FALSE if it
+         could not be created, in which case further output is held in
+         memory.
+ */
+__success(return)
+BOOLEAN
+YoriLibShStartProcessBufferSpill(
+    __in PYORI_LIBSH_PROCESS_BUFFER ThisBuffer
+    )
+{
+    YORI_STRING TempPath;
+    YORI_STRING TempName;
+    YORI_STRING Prefix;
+    HANDLE hTemp;
+
+    ThisBuffer->SpillBuffer = YoriLibMalloc(YORI_LIBSH_PROCESS_BUFFER_SEGMENT_SIZE);
+    if (ThisBuffer->SpillBuffer == NULL) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&TempPath);
+    YoriLibInitEmptyString(&TempName);
+    YoriLibConstantString(&Prefix, _T("YSB"));
+
+    if (!YoriLibGetTempPath(&TempPath, 0)) {
+        YoriLibFree(ThisBuffer->SpillBuffer);
+        ThisBuffer->SpillBuffer = NULL;
+        return FALSE;
+    }
+
+    if (!YoriLibGetTempFileName(&TempPath, &Prefix, &hTemp, &TempName)) {
+        YoriLibFreeStringContents(&TempPath);
+        YoriLibFree(ThisBuffer->SpillBuffer);
+        ThisBuffer->SpillBuffer = NULL;
+        return FALSE;
+    }
+
+    //
+    //  Reopen the file so that it is deleted when the handle is closed,
+    //  including if the shell terminates unexpectedly.
+    //
+
+    CloseHandle(hTemp);
+    hTemp = CreateFile(TempName.StartOfString,
+                       GENERIC_READ | GENERIC_WRITE,
+                       FILE_SHARE_READ | FILE_SHARE_DELETE,
+                       NULL,
+                       OPEN_EXISTING,
+                       FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE,
+                       NULL);
+
+    if (hTemp == INVALID_HANDLE_VALUE) {
+        DeleteFile(TempName.StartOfString);
+        YoriLibFreeStringContents(&TempName);
+        YoriLibFreeStringContents(&TempPath);
+        YoriLibFree(ThisBuffer->SpillBuffer);
+        ThisBuffer->SpillBuffer = NULL;
+        return FALSE;
+    }
+
+    YoriLibFreeStringContents(&TempName);
+    YoriLibFreeStringContents(&TempPath);
+
+    //
+    //  Readers only consult the file for data beyond BytesInMemory, which
+    //  cannot exist until data is written to it under the mutex.
+    //
+
+    ThisBuffer->hSpillFile = hTemp;
+    return TRUE;
+}
+
+/**
+ Find a buffer for the pump thread to read more data from the process into.
+ This is the unused space at the end of the final segment if there is any.
+ If not, a new segment is allocated, unless the stream has exceeded its
+ spill threshold, in which case data is read into the spill buffer to be
+ written to the temporary file.
+
+ @param ThisBuffer Pointer to the stream.
+
+ @param ReadBuffer On successful completion, updated to point to the buffer
+        to read into.
+
+ @param BytesToRead On successful completion, updated to contain the size of
+        ReadBuffer, in bytes.
+
+ @return TRUE to indicate a buffer was found, FALSE on allocation failure.
+ */
+__success(return)
+BOOLEAN
+YoriLibShGetProcessBufferReadSpace(
+    __in PYORI_LIBSH_PROCESS_BUFFER ThisBuffer,
+    __out PUCHAR *ReadBuffer,
+    __out PDWORD BytesToRead
+    )
+{
+    PYORI_LIBSH_PROCESS_BUFFER_SEGMENT Segment;
+    YORI_ALLOC_SIZE_T BytesAllocated;
+
+    if (ThisBuffer->hSpillFile != NULL) {
+        *ReadBuffer = ThisBuffer->SpillBuffer;
+        *BytesToRead = YORI_LIBSH_PROCESS_BUFFER_SEGMENT_SIZE;
+        return TRUE;
+    }
+
+    Segment = NULL;
+    BytesAllocated = YORI_LIBSH_PROCESS_BUFFER_INITIAL_SEGMENT_SIZE;
+    if (!YoriLibIsListEmpty(&ThisBuffer->SegmentList)) {
+        Segment = CONTAINING_RECORD(ThisBuffer->SegmentList.Prev, YORI_LIBSH_PROCESS_BUFFER_SEGMENT, ListEntry);
+        if (Segment->BytesPopulated < Segment->BytesAllocated) {
+            *ReadBuffer = &Segment->Buffer[Segment->BytesPopulated];
+            *BytesToRead = Segment->BytesAllocated - Segment->BytesPopulated;
+            return TRUE;
+        }
+
+        BytesAllocated = Segment->BytesAllocated * 2;
+        if (BytesAllocated > YORI_LIBSH_PROCESS_BUFFER_SEGMENT_SIZE) {
+            BytesAllocated = YORI_LIBSH_PROCESS_BUFFER_SEGMENT_SIZE;
+        }
+    }
+
+    if (ThisBuffer->SpillThreshold != 0 &&
+        ThisBuffer->BytesInMemory + BytesAllocated > ThisBuffer->SpillThreshold &&
+        YoriLibShStartProcessBufferSpill(ThisBuffer)) {
+
+        *ReadBuffer = ThisBuffer->SpillBuffer;
+        *BytesToRead = YORI_LIBSH_PROCESS_BUFFER_SEGMENT_SIZE;
+        return TRUE;
+    }
+
+    Segment = YoriLibShAllocateProcessBufferSegment(ThisBuffer, BytesAllocated);
+    if (Segment == NULL) {
+        return FALSE;
+    }
+
+    *ReadBuffer = Segment->Buffer;
+    *BytesToRead = Segment->BytesAllocated;
+    return TRUE;
+}
+
+/**
+ Record data that the pump thread has read into the buffer returned from
+ YoriLibShGetProcessBufferReadSpace.  This is called with the mutex held.
+
+ @param ThisBuffer Pointer to the stream.
+
+ @param ReadBuffer Pointer to the buffer containing the data.
+
+ @param BytesRead The number of bytes of data read.
+
+ @return TRUE to indicate the data was recorded, FALSE if it could not be
+         written to the temporary file.
+ */
+__success(return)
+BOOLEAN
+YoriLibShCommitProcessBufferRead(
+    __in PYORI_LIBSH_PROCESS_BUFFER ThisBuffer,
+    __in PUCHAR ReadBuffer,
+    __in DWORD BytesRead
+    )
+{
+    PYORI_LIBSH_PROCESS_BUFFER_SEGMENT Segment;
+    OVERLAPPED Overlapped;
+    DWORDLONG SpillOffset;
+    DWORD BytesWritten;
+
+    if (ReadBuffer == ThisBuffer->SpillBuffer) {
+        SpillOffset = ThisBuffer->BytesPopulated - ThisBuffer->BytesInMemory;
+        ZeroMemory(&Overlapped, sizeof(Overlapped));
+        Overlapped.Offset = (DWORD)SpillOffset;
+        Overlapped.OffsetHigh = (DWORD)(SpillOffset >> 32);
+        if (!WriteFile(ThisBuffer->hSpillFile, ReadBuffer, BytesRead, &BytesWritten, &Overlapped) ||
+            BytesWritten != BytesRead) {
+
+            return FALSE;
+        }
+    } else {
+        Segment = CONTAINING_RECORD(ThisBuffer->SegmentList.Prev, YORI_LIBSH_PROCESS_BUFFER_SEGMENT, ListEntry);
+        ASSERT(ReadBuffer == &Segment->Buffer[Segment->BytesPopulated]);
+        Segment->BytesPopulated = Segment->BytesPopulated + (YORI_ALLOC_SIZE_T)BytesRead;
+        ASSERT(Segment->BytesPopulated <= Segment->BytesAllocated);
+        ThisBuffer->BytesInMemory = ThisBuffer->BytesInMemory + BytesRead;
+    }
+
+    ThisBuffer->BytesPopulated = ThisBuffer->BytesPopulated + BytesRead;
+    return TRUE;
+}
+
+/**
+ Return the contiguous range of data starting at a cursor.  Data held in
+ memory is returned in place.  Data that has been spilled to a temporary
+ file is read into a caller supplied buffer.  The caller is expected to
+ hold the mutex.
+
+ @param ThisBuffer Pointer to the stream.
+
+ @param Cursor Pointer to the position of the data to return.  This is not
+        advanced by this function; the caller should call
+        YoriLibShAdvanceProcessBufferCursor with the amount of data consumed.
+
+ @param StagingBuffer Optionally points to a buffer of
+        YORI_LIBSH_PROCESS_BUFFER_SEGMENT_SIZE bytes to read spilled data
+        into.  This is required if the stream has a temporary file.
+
+ @param Data On successful completion, updated to point to the data.
+
+ @param DataLength On successful completion, updated to contain the number
+        of bytes of data.
+
+ @return TRUE to indicate data was returned, FALSE if there is no more data
+         or it could not be read.
+ */
+__success(return)
+BOOLEAN
+YoriLibShGetProcessBufferData(
+    __in PYORI_LIBSH_PROCESS_BUFFER ThisBuffer,
+    __inout PYORI_LIBSH_PROCESS_BUFFER_CURSOR Cursor,
+    __in_opt PUCHAR StagingBuffer,
+    __out PUCHAR *Data,
+    __out PDWORD DataLength
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    OVERLAPPED Overlapped;
+    DWORDLONG SpillOffset;
+    DWORDLONG BytesRemaining;
+    DWORD BytesToRead;
+    DWORD BytesRead;
+
+    if (Cursor->Offset >= ThisBuffer->BytesPopulated) {
+        return FALSE;
+    }
+
+    if (Cursor->Offset < ThisBuffer->BytesInMemory) {
+        if (Cursor->Segment == NULL) {
+            ListEntry = YoriLibGetNextListEntry(&ThisBuffer->SegmentList, NULL);
+            Cursor->Segment = CONTAINING_RECORD(ListEntry, YORI_LIBSH_PROCESS_BUFFER_SEGMENT, ListEntry);
+            Cursor->SegmentOffset = (YORI_ALLOC_SIZE_T)Cursor->Offset;
+        }
+
+        while (Cursor->SegmentOffset >= Cursor->Segment->BytesPopulated) {
+            ListEntry = YoriLibGetNextListEntry(&ThisBuffer->SegmentList, &Cursor->Segment->ListEntry);
+            ASSERT(ListEntry != NULL);
+            Cursor->SegmentOffset = Cursor->SegmentOffset - Cursor->Segment->BytesPopulated;
+            Cursor->Segment = CONTAINING_RECORD(ListEntry, YORI_LIBSH_PROCESS_BUFFER_SEGMENT, ListEntry);
+        }
+
+        *Data = &Cursor->Segment->Buffer[Cursor->SegmentOffset];
+        *DataLength = Cursor->Segment->BytesPopulated - Cursor->SegmentOffset;
+        return TRUE;
+    }
+
+    if (ThisBuffer->hSpillFile == NULL || StagingBuffer == NULL) {
+        return FALSE;
+    }
+
+    SpillOffset = Cursor->Offset - ThisBuffer->BytesInMemory;
+    BytesRemaining = ThisBuffer->BytesPopulated - Cursor->Offset;
+    BytesToRead = YORI_LIBSH_PROCESS_BUFFER_SEGMENT_SIZE;
+    if (BytesRemaining < BytesToRead) {
+        BytesToRead = (DWORD)BytesRemaining;
+    }
+
+    ZeroMemory(&Overlapped, sizeof(Overlapped));
+    Overlapped.Offset = (DWORD)SpillOffset;
+    Overlapped.OffsetHigh = (DWORD)(SpillOffset >> 32);
+    if (!ReadFile(ThisBuffer->hSpillFile, StagingBuffer, BytesToRead, &BytesRead, &Overlapped) ||
+        BytesRead == 0) {
+
+        return FALSE;
+    }
+
+    *Data = StagingBuffer;
+    *DataLength = BytesRead;
+    return TRUE;
+}
+
+/**
+ Move a cursor forward after consuming data returned from
+ YoriLibShGetProcessBufferData.
+
+ @param Cursor Pointer to the cursor to advance.
+
+ @param BytesConsumed The number of bytes to advance by.
+ */
+VOID
+YoriLibShAdvanceProcessBufferCursor(
+    __inout PYORI_LIBSH_PROCESS_BUFFER_CURSOR Cursor,
+    __in DWORD BytesConsumed
+    )
+{
+    Cursor->Offset = Cursor->Offset + BytesConsumed;
+    if (Cursor->Segment != NULL) {
+        Cursor->SegmentOffset = Cursor->SegmentOffset + BytesConsumed;
+    }
+}
+
+/**
+ Write data from a stream to a handle, starting from a cursor, until either
+ all of the data populated so far has been written or a specified amount has
+ been written.  The caller is expected to hold the mutex.
+
+ @param ThisBuffer Pointer to the stream.
+
+ @param Cursor Pointer to the position of the data to write, which is
+        advanced by the amount of data written.
+
+ @param hTarget The handle to write data to.
+
+ @param StagingBuffer Optionally points to a buffer of
+        YORI_LIBSH_PROCESS_BUFFER_SEGMENT_SIZE bytes to read spilled data
+        into.  This is required if the stream has a temporary file.
+
+ @param MaximumBytes The largest number of bytes to write.
+
+ @return TRUE to indicate success, FALSE if the data could not be written.
+ */
+__success(return)
+BOOLEAN
+YoriLibShWriteProcessBufferData(
+    __in PYORI_LIBSH_PROCESS_BUFFER ThisBuffer,
+    __inout PYORI_LIBSH_PROCESS_BUFFER_CURSOR Cursor,
+    __in HANDLE hTarget,
+    __in_opt PUCHAR StagingBuffer,
+    __in DWORD MaximumBytes
+    )
+{
+    PUCHAR Data;
+    DWORD DataLength;
+    DWORD BytesWritten;
+    DWORD TotalWritten;
+
+    TotalWritten = 0;
+    while (Cursor->Offset < ThisBuffer->BytesPopulated && TotalWritten < MaximumBytes) {
+        if (!YoriLibShGetProcessBufferData(ThisBuffer, Cursor, StagingBuffer, &Data, &DataLength)) {
+            return FALSE;
+        }
+
+        if (DataLength > MaximumBytes - TotalWritten) {
+            DataLength = MaximumBytes - TotalWritten;
+        }
+
+        if (!WriteFile(hTarget, Data, DataLength, &BytesWritten, NULL)) {
+            return FALSE;
+        }
+
+        YoriLibShAdvanceProcessBufferCursor(Cursor, BytesWritten);
+        TotalWritten = TotalWritten + BytesWritten;
+        ASSERT(Cursor->Offset <= ThisBuffer->BytesPopulated);
+    }
+
+    return TRUE;
+}
+
+/**
+ Return the number of bytes at the end of a range of data in the input
+ encoding that form an incomplete character.  These need to be combined
+ with the start of the following range before conversion.
+
+ @param Encoding The input encoding.
+
+ @param Data Pointer to the data.
+
+ @param DataLength The number of bytes of data.
+
+ @return The number of bytes at the end of the data that form an incomplete
+         character.
+ */
+DWORD
+YoriLibShProcessBufferIncompleteCharBytes(
+    __in DWORD Encoding,
+    __in_ecount(DataLength) PUCHAR Data,
+    __in DWORD DataLength
+    )
+{
+    DWORD Index;
+    DWORD CharLength;
+    UCHAR Char;
+
+    if (Encoding == CP_UTF16) {
+        return DataLength % sizeof(WCHAR);
+    }
+
+    if (Encoding == CP_UTF8) {
+        for (Index = 1; Index <= 3 && Index <= DataLength; Index++) {
+            Char = Data[DataLength - Index];
+            if ((Char & 0xC0) == 0x80) {
+                continue;
+            }
+
+            CharLength = 1;
+            if (Char >= 0xF0) {
+                CharLength = 4;
+            } else if (Char >= 0xE0) {
+                CharLength = 3;
+            } else if (Char >= 0xC0) {
+                CharLength = 2;
+            }
+
+            if (CharLength > Index) {
+                return Index;
+            }
+            break;
+        }
+        return 0;
+    }
+
+    //
+    //  For double byte code pages, a trail byte can also be a valid lead
+    //  byte, so count the run of possible lead bytes at the end.  If it's
+    //  odd, the final byte is a lead byte.
+    //
+
+    for (Index = 0; Index < DataLength; Index++) {
+        if (!IsDBCSLeadByteEx(Encoding, Data[DataLength - Index - 1])) {
+            break;
+        }
+    }
+
+    return (Index % 2);
+}
+
+/**
+ Return the number of bytes in a character in the input encoding that starts
+ with a specified byte.
+
+ @param Encoding The input encoding.
+
+ @param LeadByte The first byte of the character.
+
+ @return The number of bytes in the character.
+ */
+DWORD
+YoriLibShProcessBufferCharLength(
+    __in DWORD Encoding,
+    __in UCHAR LeadByte
+    )
+{
+    if (Encoding == CP_UTF16) {
+        return sizeof(WCHAR);
+    }
+
+    if (Encoding == CP_UTF8) {
+        if (LeadByte >= 0xF0) {
+            return 4;
+        } else if (LeadByte >= 0xE0) {
+            return 3;
+        } else if (LeadByte >= 0xC0) {
+            return 2;
+        }
+        return 1;
+    }
+
+    if (IsDBCSLeadByteEx(Encoding, LeadByte)) {
+        return 2;
+    }
+
+    return 1;
+}
+
+/**
+ Convert a range of data in the input encoding to UTF16, or count the number
+ of characters it would convert to.
+
+ @param Encoding The input encoding.
+
+ @param Data Pointer to the data to convert.
+
+ @param DataLength The number of bytes of data.
+
+ @param Output Optionally points to a buffer to populate with the converted
+        data.  If NULL, the number of characters is counted.
+
+ @param OutputLength The number of characters in Output.
+
+ @param CharsPopulated On input, the number of characters already populated
+        in Output.  On successful completion, updated to include the
+        characters from this range.
+
+ @return TRUE to indicate success, FALSE if Output is too small or the
+         number of characters would exceed the maximum allocation size.
+ */
+__success(return)
+BOOLEAN
+YoriLibShProcessBufferConvertRange(
+    __in DWORD Encoding,
+    __in_ecount(DataLength) PUCHAR Data,
+    __in DWORD DataLength,
+    __out_ecount_opt(OutputLength) LPTSTR Output,
+    __in YORI_ALLOC_SIZE_T OutputLength,
+    __inout PYORI_ALLOC_SIZE_T CharsPopulated
+    )
+{
+    YORI_ALLOC_SIZE_T InputLength;
+    YORI_ALLOC_SIZE_T CharsNeeded;
+
+    if (DataLength == 0) {
+        return TRUE;
+    }
+
+    //
+    //  When the input is UTF16, the conversion functions take the length in
+    //  characters.
+    //
+
+    InputLength = (YORI_ALLOC_SIZE_T)DataLength;
+    if (Encoding == CP_UTF16) {
+        InputLength = InputLength / sizeof(WCHAR);
+    }
+
+    CharsNeeded = YoriLibGetMultibyteInputSizeNeeded((LPCSTR)Data, InputLength);
+    if (!YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)*CharsPopulated + CharsNeeded + 1)) {
+        return FALSE;
+    }
+
+    if (Output != NULL) {
+        if (*CharsPopulated + CharsNeeded > OutputLength) {
+            return FALSE;
+        }
+        YoriLibMultibyteInput((LPCSTR)Data, InputLength, &Output[*CharsPopulated], CharsNeeded);
+    }
+
+    *CharsPopulated = *CharsPopulated + CharsNeeded;
+    return TRUE;
+}
+
+/**
+ Convert the contents of a stream into UTF16, or count the number of
+ characters it would convert to.  Data is converted directly from each
+ segment, and characters which are split across segments are reassembled
+ before conversion.  The caller is expected to hold the mutex.
+
+ @param ThisBuffer Pointer to the stream.
+
+ @param StagingBuffer Optionally points to a buffer of
+        YORI_LIBSH_PROCESS_BUFFER_SEGMENT_SIZE bytes to read spilled data
+        into.  This is required if the stream has a temporary file.
+
+ @param Output Optionally points to a buffer to populate with the converted
+        data.  If NULL, the number of characters is counted.
+
+ @param OutputLength The number of characters in Output.
+
+ @param CharsPopulated On successful completion, updated to contain the
+        number of characters in the converted form.
+
+ @return TRUE to indicate success, FALSE on failure.
+ */
+__success(return)
+BOOLEAN
+YoriLibShProcessBufferToString(
+    __in PYORI_LIBSH_PROCESS_BUFFER ThisBuffer,
+    __in_opt PUCHAR StagingBuffer,
+    __out_ecount_opt(OutputLength) LPTSTR Output,
+    __in YORI_ALLOC_SIZE_T OutputLength,
+    __out PYORI_ALLOC_SIZE_T CharsPopulated
+    )
+{
+    YORI_LIBSH_PROCESS_BUFFER_CURSOR Cursor;
+    UCHAR Carry[4];
+    DWORD CarryLength;
+    DWORD CarryNeeded;
+    DWORD Encoding;
+    PUCHAR Data;
+    DWORD DataLength;
+    DWORD TailLength;
+    BOOLEAN FinalRange;
+
+    Encoding = YoriLibGetMultibyteInputEncoding();
+    ZeroMemory(&Cursor, sizeof(Cursor));
+    CarryLength = 0;
+    *CharsPopulated = 0;
+
+    while (Cursor.Offset < ThisBuffer->BytesPopulated) {
+        if (!YoriLibShGetProcessBufferData(ThisBuffer, &Cursor, StagingBuffer, &Data, &DataLength)) {
+            return FALSE;
+        }
+        YoriLibShAdvanceProcessBufferCursor(&Cursor, DataLength);
+        FinalRange = (BOOLEAN)(Cursor.Offset >= ThisBuffer->BytesPopulated);
+
+        //
+        //  If the previous range ended with an incomplete character, take
+        //  the remainder from the start of this range.
+        //
+
+        if (CarryLength > 0) {
+            CarryNeeded = YoriLibShProcessBufferCharLength(Encoding, Carry[0]);
+            while (CarryLength < CarryNeeded && DataLength > 0) {
+                Carry[CarryLength] = Data[0];
+                CarryLength++;
+                Data++;
+                DataLength--;
+            }
+
+            if (CarryLength < CarryNeeded && !FinalRange) {
+                continue;
+            }
+
+            if (!YoriLibShProcessBufferConvertRange(Encoding, Carry, CarryLength, Output, OutputLength, CharsPopulated)) {
+                return FALSE;
+            }
+            CarryLength = 0;
+        }
+
+        TailLength = 0;
+        if (!FinalRange) {
+            TailLength = YoriLibShProcessBufferIncompleteCharBytes(Encoding, Data, DataLength);
+        }
+
+        if (!YoriLibShProcessBufferConvertRange(Encoding, Data, DataLength - TailLength, Output, OutputLength, CharsPopulated)) {
+            return FALSE;
+        }
+
+        if (TailLength > 0) {
+            memcpy(Carry, &Data[DataLength - TailLength], TailLength);
+            CarryLength = TailLength;
+        }
+    }
+
+    return TRUE;
+}
+
 /**
  Code running on a dedicated thread for the duration of an outstanding process
  to populate data into its pipe.
@@ -198,35 +974,28 @@ YoriLibShCmdBufferPumpToNextProcess(
     )
 {
     PYORI_LIBSH_PROCESS_BUFFER ThisBuffer = (PYORI_LIBSH_PROCESS_BUFFER)Param;
-    DWORD BytesSent = 0;
-    DWORD BytesWritten;
-    DWORD BytesToWrite;
+    YORI_LIBSH_PROCESS_BUFFER_CURSOR Cursor;
 
-    while (TRUE) {
+    //
+    //  The thread that read data into the buffer has terminated, so its
+    //  spill buffer can be used to read any data from the temporary file.
+    //
 
-        BytesToWrite = 4096;
-        AcquireMutex(ThisBuffer->Mutex);
-        if (BytesSent + BytesToWrite > ThisBuffer->BytesPopulated) {
-            BytesToWrite = ThisBuffer->BytesPopulated - BytesSent;
-        }
+    ZeroMemory(&Cursor, sizeof(Cursor));
 
-        if (WriteFile(ThisBuffer->hSource,
-                      YoriLibAddToPointer(ThisBuffer->Buffer, BytesSent),
-                      BytesToWrite,
-                      &BytesWritten,
-                      NULL)) {
+    while (TRUE) {
 
-            BytesSent += BytesWritten;
-        } else {
+        AcquireMutex(ThisBuffer->Mutex);
+        if (Cursor.Offset >= ThisBuffer->BytesPopulated) {
             ReleaseMutex(ThisBuffer->Mutex);
             break;
         }
-        ReleaseMutex(ThisBuffer->Mutex);
 
-        ASSERT(BytesSent <= ThisBuffer->BytesPopulated);
-        if (BytesSent >= ThisBuffer->BytesPopulated) {
+        if (!YoriLibShWriteProcessBufferData(ThisBuffer, &Cursor, ThisBuffer->hSource, ThisBuffer->SpillBuffer, 4096)) {
+            ReleaseMutex(ThisBuffer->Mutex);
             break;
         }
+        ReleaseMutex(ThisBuffer->Mutex);
     }
 
     CloseHandle(ThisBuffer->hSource);
@@ -250,14 +1019,21 @@ YoriLibShCmdBufferPump(
     )
 {
     PYORI_LIBSH_PROCESS_BUFFER ThisBuffer = (PYORI_LIBSH_PROCESS_BUFFER)Param;
+    PUCHAR ReadBuffer;
+    DWORD BytesToRead;
     DWORD BytesRead;
     HANDLE hTemp;
 
     while (ThisBuffer->hSource != NULL) {
 
+        if (!YoriLibShGetProcessBufferReadSpace(ThisBuffer, &ReadBuffer, &BytesToRead)) {
+            AcquireMutex(ThisBuffer->Mutex);
+            break;
+        }
+
         if (ReadFile(ThisBuffer->hSource,
-                     YoriLibAddToPointer(ThisBuffer->Buffer, ThisBuffer->BytesPopulated),
-                     ThisBuffer->BytesAllocated - ThisBuffer->BytesPopulated,
+                     ReadBuffer,
+                     BytesToRead,
                      &BytesRead,
                      NULL)) {
 
@@ -267,27 +1043,8 @@ YoriLibShCmdBufferPump(
                 break;
             }
 
-            ThisBuffer->BytesPopulated = ThisBuffer->BytesPopulated + (YORI_ALLOC_SIZE_T)BytesRead;
-            ASSERT(ThisBuffer->BytesPopulated <= ThisBuffer->BytesAllocated);
-            if (ThisBuffer->BytesPopulated >= ThisBuffer->BytesAllocated) {
-                YORI_ALLOC_SIZE_T NewBytesAllocated;
-                PCHAR NewBuffer;
-
-                if (ThisBuffer->BytesAllocated >= YORI_MAX_ALLOC_SIZE) {
-                    break;
-                }
-
-                NewBytesAllocated = ThisBuffer->BytesAllocated * 4;
-
-                NewBuffer = YoriLibMalloc(NewBytesAllocated);
-                if (NewBuffer == NULL) {
-                    break;
-                }
-
-                memcpy(NewBuffer, ThisBuffer->Buffer, ThisBuffer->BytesAllocated);
-                YoriLibFree(ThisBuffer->Buffer);
-                ThisBuffer->Buffer = NewBuffer;
-                ThisBuffer->BytesAllocated = NewBytesAllocated;
+            if (!YoriLibShCommitProcessBufferRead(ThisBuffer, ReadBuffer, BytesRead)) {
+                break;
             }
         } else {
             SYSERR LastError = GetLastError();
@@ -307,33 +1064,18 @@ YoriLibShCmdBufferPump(
             }
         }
 
+        //
+        //  Any data in the spill buffer has been written to the temporary
+        //  file, so the spill buffer can be used to read it back.
+        //
+
         if (ThisBuffer->hMirror != NULL) {
-            while (ThisBuffer->BytesSent < ThisBuffer->BytesPopulated) {
-                DWORD BytesToWrite;
-                DWORD BytesWritten;
-                BytesToWrite = 4096;
-                if (ThisBuffer->BytesSent + BytesToWrite > ThisBuffer->BytesPopulated) {
-                    BytesToWrite = ThisBuffer->BytesPopulated - ThisBuffer->BytesSent;
-                }
-
-                if (WriteFile(ThisBuffer->hMirror,
-                              YoriLibAddToPointer(ThisBuffer->Buffer, ThisBuffer->BytesSent),
-                              BytesToWrite,
-                              &BytesWritten,
-                              NULL)) {
-
-                    ThisBuffer->BytesSent += BytesWritten;
-                } else {
-                    hTemp = ThisBuffer->hMirror;
-                    ThisBuffer->hMirror = NULL;
-                    CloseHandle(hTemp);
-                    ThisBuffer->BytesSent = 0;
-                    break;
-                }
-
-                ASSERT(ThisBuffer->BytesSent <= ThisBuffer->BytesPopulated);
+            if (!YoriLibShWriteProcessBufferData(ThisBuffer, &ThisBuffer->MirrorCursor, ThisBuffer->hMirror, ThisBuffer->SpillBuffer, (DWORD)-1)) {
+                hTemp = ThisBuffer->hMirror;
+                ThisBuffer->hMirror = NULL;
+                CloseHandle(hTemp);
+                ZeroMemory(&ThisBuffer->MirrorCursor, sizeof(ThisBuffer->MirrorCursor));
             }
-
         }
         ReleaseMutex(ThisBuffer->Mutex);
     }
@@ -360,28 +1102,55 @@ YoriLibShCmdBufferPump(
 
  @param Buffer Pointer to the buffer to allocate structures for.
 
+ @param SpillThreshold The number of bytes to hold in memory before writing
+        further data to a temporary file, or zero to hold all data in memory.
+
  @return TRUE if the buffer is successfully initialized, FALSE if it is not.
  */
 __success(return)
 BOOL
 YoriLibShAllocateSingleProcessBuffer(
-    __out PYORI_LIBSH_PROCESS_BUFFER Buffer
+    __out PYORI_LIBSH_PROCESS_BUFFER Buffer,
+    __in DWORDLONG SpillThreshold
     )
 {
-    Buffer->BytesAllocated = 1024;
-    Buffer->Buffer = YoriLibMalloc(Buffer->BytesAllocated);
-    if (Buffer->Buffer == NULL) {
-        return FALSE;
-    }
+    YoriLibInitializeListHead(&Buffer->SegmentList);
+    Buffer->SpillThreshold = SpillThreshold;
 
     Buffer->Mutex = CreateMutex(NULL, FALSE, NULL);
     if (Buffer->Mutex == NULL) {
         return FALSE;
     }
 
+    if (YoriLibShAllocateProcessBufferSegment(Buffer, YORI_LIBSH_PROCESS_BUFFER_INITIAL_SEGMENT_SIZE) == NULL) {
+        return FALSE;
+    }
+
     return TRUE;
 }
 
+/**
+ Return the number of bytes of output to hold in memory for each stream of a
+ buffered process before writing further output to a temporary file.  This
+ is specified in megabytes by the YORIBUFFERSPILL environment variable.
+
+ @return The number of bytes to hold in memory, or zero if all output should
+         be held in memory.
+ */
+DWORDLONG
+YoriLibShGetProcessBufferSpillThreshold(VOID)
+{
+    YORI_MAX_SIGNED_T Megabytes;
+
+    if (!YoriLibGetEnvVarAsNumber(_T("YORIBUFFERSPILL"), &Megabytes) ||
+        Megabytes <= 0) {
+
+        return 0;
+    }
+
+    return (DWORDLONG)Megabytes * 1024 * 1024;
+}
+
 /**
  Allocate a new buffered process item.
 
@@ -397,6 +1166,7 @@ YoriLibShCreateNewProcessBuffer(
     )
 {
     PYORI_LIBSH_BUFFERED_PROCESS ThisBuffer;
+    DWORDLONG SpillThreshold;
     DWORD ThreadId;
 
     if (BufferedProcessList.Next == NULL) {
@@ -431,8 +1201,10 @@ YoriLibShCreateNewProcessBuffer(
     //  pipes are already populated.
     //
 
+    SpillThreshold = YoriLibShGetProcessBufferSpillThreshold();
+
     if (ExecContext->StdOutType == StdOutTypeBuffer) {
-        if (!YoriLibShAllocateSingleProcessBuffer(&ThisBuffer->OutputBuffer)) {
+        if (!YoriLibShAllocateSingleProcessBuffer(&ThisBuffer->OutputBuffer, SpillThreshold)) {
             YoriLibShFreeProcessBuffers(ThisBuffer);
             return FALSE;
         }
@@ -449,7 +1221,7 @@ YoriLibShCreateNewProcessBuffer(
     }
 
     if (ExecContext->StdErrType == StdErrTypeBuffer) {
-        if (!YoriLibShAllocateSingleProcessBuffer(&ThisBuffer->ErrorBuffer)) {
+        if (!YoriLibShAllocateSingleProcessBuffer(&ThisBuffer->ErrorBuffer, SpillThreshold)) {
             YoriLibShFreeProcessBuffers(ThisBuffer);
             return FALSE;
         }
@@ -631,29 +1403,67 @@ YoriLibShGetProcessBuffer(
     )
 {
     YORI_ALLOC_SIZE_T LengthNeeded;
+    PUCHAR StagingBuffer;
 
-    if (ThisBuffer->Buffer == NULL) {
+    if (ThisBuffer->Mutex == NULL) {
         return FALSE;
     }
 
+    StagingBuffer = NULL;
     AcquireMutex(ThisBuffer->Mutex);
 
-    LengthNeeded = YoriLibGetMultibyteInputSizeNeeded(ThisBuffer->Buffer, ThisBuffer->BytesPopulated);
+    //
+    //  The pump thread may be using its spill buffer, so reading from the
+    //  temporary file needs a separate one.
+    //
+
+    if (ThisBuffer->hSpillFile != NULL) {
+        StagingBuffer = YoriLibMalloc(YORI_LIBSH_PROCESS_BUFFER_SEGMENT_SIZE);
+        if (StagingBuffer == NULL) {
+            ReleaseMutex(ThisBuffer->Mutex);
+            return FALSE;
+        }
+    }
+
+    if (!YoriLibShProcessBufferToString(ThisBuffer, StagingBuffer, NULL, 0, &LengthNeeded)) {
+        ReleaseMutex(ThisBuffer->Mutex);
+        if (StagingBuffer != NULL) {
+            YoriLibFree(StagingBuffer);
+        }
+        return FALSE;
+    }
+
     if (LengthNeeded == 0 && ThisBuffer->BytesPopulated == 0) {
         ReleaseMutex(ThisBuffer->Mutex);
+        if (StagingBuffer != NULL) {
+            YoriLibFree(StagingBuffer);
+        }
         YoriLibInitEmptyString(String);
         return TRUE;
     }
 
     if (!YoriLibAllocateString(String, LengthNeeded)) {
         ReleaseMutex(ThisBuffer->Mutex);
+        if (StagingBuffer != NULL) {
+            YoriLibFree(StagingBuffer);
+        }
         return FALSE;
     }
 
-    YoriLibMultibyteInput(ThisBuffer->Buffer, ThisBuffer->BytesPopulated, String->StartOfString, String->LengthAllocated);
-    String->LengthInChars = LengthNeeded;
+    if (!YoriLibShProcessBufferToString(ThisBuffer, StagingBuffer, String->StartOfString, String->LengthAllocated, &String->LengthInChars)) {
+        ReleaseMutex(ThisBuffer->Mutex);
+        if (StagingBuffer != NULL) {
+            YoriLibFree(StagingBuffer);
+        }
+        YoriLibFreeStringContents(String);
+        return FALSE;
+    }
     ReleaseMutex(ThisBuffer->Mutex);
 
+    if (StagingBuffer != NULL) {
+        YoriLibFree(StagingBuffer);
+    }
+
     return TRUE;
 }
 
@@ -924,7 +1734,7 @@ YoriLibShPipeProcessBuffers(
     //
 
     if (hPipeOutput != NULL) {
-        if (ThisBufferNonOpaque->OutputBuffer.Buffer != NULL) {
+        if (ThisBufferNonOpaque->OutputBuffer.Mutex != NULL) {
             HaveOutput = TRUE;
         } else {
             return FALSE;
@@ -932,7 +1742,7 @@ YoriLibShPipeProcessBuffers(
     }
 
     if (hPipeErrors != NULL) {
-        if (ThisBufferNonOpaque->ErrorBuffer.Buffer != NULL) {
+        if (ThisBufferNonOpaque->ErrorBuffer.Mutex != NULL) {
             HaveErrors = TRUE;
         } else {
             return FALSE;
@@ -982,12 +1792,12 @@ YoriLibShPipeProcessBuffers(
 
     if (HaveOutput) {
         ThisBufferNonOpaque->OutputBuffer.hMirror = hPipeOutput;
-        ASSERT(ThisBufferNonOpaque->OutputBuffer.BytesSent == 0);
+        ASSERT(ThisBufferNonOpaque->OutputBuffer.MirrorCursor.Offset == 0);
     }
 
     if (HaveErrors) {
         ThisBufferNonOpaque->ErrorBuffer.hMirror = hPipeErrors;
-        ASSERT(ThisBufferNonOpaque->ErrorBuffer.BytesSent == 0);
+        ASSERT(ThisBufferNonOpaque->ErrorBuffer.MirrorCursor.Offset == 0);
     }
 
     if (HaveOutput) {
@@ -3,7 +3,7 @@
  *
  * Parses an expression into component pieces
  *
- * Copyright (c) 2014-2019 Malcolm J. Smith
+ * Copyright (c) 2014-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -138,9 +138,9 @@ YoriLibShIsArgumentSeperator(
 }
 
 /**
- Allocate the ArgV and ArgContexts arrays within a CmdContext.  Optionally the
- caller can request additional bytes to be in this allocation, and if so, this
- routine will output a pointer to the additional payload.
+ Allocate the ArgV and ArgContexts arrays within a CmdContext from an arena.
+ Optionally the caller can request additional bytes to be in this allocation,
+ and if so, this routine will output a pointer to the additional payload.
 
  @param CmdContext Pointer to the CmdContext whose arrays should be allocated.
 
@@ -152,28 +152,40 @@ YoriLibShIsArgumentSeperator(
  @param ExtraData Pointer to a pointer that will receive the location of the
         extra allocation, if ExtraByteCount is nonzero.
 
+ @param Arena Optionally points to an arena to allocate from.  If NULL, the
+        arrays are allocated from the heap.
+
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 __success(return)
 BOOLEAN
-YoriLibShAllocateArgCount(
+YoriLibShAllocateArgCountFromArena(
     __out PYORI_LIBSH_CMD_CONTEXT CmdContext,
     __in YORI_ALLOC_SIZE_T ArgCount,
     __in YORI_ALLOC_SIZE_T ExtraByteCount,
-    __out_opt PVOID *ExtraData
+    __out_opt PVOID *ExtraData,
+    __inout_opt PYORI_LIB_ARENA Arena
     )
 {
     PVOID MemoryToFree;
-    MemoryToFree = YoriLibReferencedMalloc((ArgCount * (sizeof(YORI_STRING) + sizeof(YORI_LIBSH_ARG_CONTEXT))) +
-                                                       ExtraByteCount);
-    if (MemoryToFree == NULL) {
+    PVOID Buffer;
+    YORI_ALLOC_SIZE_T BytesNeeded;
+
+    BytesNeeded = (ArgCount * (sizeof(YORI_STRING) + sizeof(YORI_LIBSH_ARG_CONTEXT))) + ExtraByteCount;
+    if (Arena != NULL) {
+        Buffer = YoriLibArenaAllocate(Arena, BytesNeeded, &MemoryToFree);
+    } else {
+        Buffer = YoriLibReferencedMalloc(BytesNeeded);
+        MemoryToFree = Buffer;
+    }
+    if (Buffer == NULL) {
         return FALSE;
     }
 
-    ZeroMemory(MemoryToFree, ArgCount * (sizeof(YORI_STRING) + sizeof(YORI_LIBSH_ARG_CONTEXT)));
+    ZeroMemory(Buffer, ArgCount * (sizeof(YORI_STRING) + sizeof(YORI_LIBSH_ARG_CONTEXT)));
 
     CmdContext->ArgC = ArgCount;
-    CmdContext->ArgV = MemoryToFree;
+    CmdContext->ArgV = Buffer;
     CmdContext->MemoryToFreeArgV = MemoryToFree;
 
     YoriLibReference(MemoryToFree);
@@ -195,6 +207,35 @@ YoriLibShAllocateArgCount(
     return TRUE;
 }
 
+/**
+ Allocate the ArgV and ArgContexts arrays within a CmdContext.  Optionally the
+ caller can request additional bytes to be in this allocation, and if so, this
+ routine will output a pointer to the additional payload.
+
+ @param CmdContext Pointer to the CmdContext whose arrays should be allocated.
+
+ @param ArgCount Specifies the number of arguments to allocate.
+
+ @param ExtraByteCount Specifies the number of extra bytes to include in the
+        allocation.  If this is nonzero, the ExtraData argument is mandatory.
+
+ @param ExtraData Pointer to a pointer that will receive the location of the
+        extra allocation, if ExtraByteCount is nonzero.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriLibShAllocateArgCount(
+    __out PYORI_LIBSH_CMD_CONTEXT CmdContext,
+    __in YORI_ALLOC_SIZE_T ArgCount,
+    __in YORI_ALLOC_SIZE_T ExtraByteCount,
+    __out_opt PVOID *ExtraData
+    )
+{
+    return YoriLibShAllocateArgCountFromArena(CmdContext, ArgCount, ExtraByteCount, ExtraData, NULL);
+}
+
 /**
  Remove spaces from the beginning of a Yori string.  Note this implies
  advancing the StartOfString pointer, so a caller cannot assume this
@@ -1421,27 +1462,32 @@ YoriLibShCopyArg(
 }
 
 /**
- Perform a deep copy of a command context.  This will allocate a new argument
- array but reference any arguments from the source (so they must still be
- reallocated individually if/when modified.)
+ Perform a deep copy of a command context, allocating the new argument array
+ from an arena.  This will allocate a new argument array but reference any
+ arguments from the source (so they must still be reallocated individually
+ if/when modified.)
 
  @param DestCmdContext Pointer to the command context to populate with contents
         from the source.
 
  @param SrcCmdContext Pointer to the source command context.
 
+ @param Arena Optionally points to an arena to allocate from.  If NULL, the
+        argument array is allocated from the heap.
+
  @return TRUE to indicate success, or FALSE to indicate failure.
  */
 __success(return)
 BOOL
-YoriLibShCopyCmdContext(
+YoriLibShCopyCmdContextFromArena(
     __out PYORI_LIBSH_CMD_CONTEXT DestCmdContext,
-    __in PYORI_LIBSH_CMD_CONTEXT SrcCmdContext
+    __in PYORI_LIBSH_CMD_CONTEXT SrcCmdContext,
+    __inout_opt PYORI_LIB_ARENA Arena
     )
 {
     YORI_ALLOC_SIZE_T Count;
 
-    if (!YoriLibShAllocateArgCount(DestCmdContext, SrcCmdContext->ArgC, 0, NULL)) {
+    if (!YoriLibShAllocateArgCountFromArena(DestCmdContext, SrcCmdContext->ArgC, 0, NULL, Arena)) {
         return FALSE;
     }
 
@@ -1456,9 +1502,34 @@ YoriLibShCopyCmdContext(
     return TRUE;
 }
 
+/**
+ Perform a deep copy of a command context.  This will allocate a new argument
+ array but reference any arguments from the source (so they must still be
+ reallocated individually if/when modified.)
+
+ @param DestCmdContext Pointer to the command context to populate with contents
+        from the source.
+
+ @param SrcCmdContext Pointer to the source command context.
+
+ @return TRUE to indicate success, or FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibShCopyCmdContext(
+    __out PYORI_LIBSH_CMD_CONTEXT DestCmdContext,
+    __in PYORI_LIBSH_CMD_CONTEXT SrcCmdContext
+    )
+{
+    return YoriLibShCopyCmdContextFromArena(DestCmdContext, SrcCmdContext, NULL);
+}
+
 /**
  Add extra arguments into a CmdContext.  This routine can reallocate the
- ArgV and ArgContexts arrays to the specified size.
+ ArgV and ArgContexts arrays to the specified size.  The new arrays are
+ allocated from the heap, even if the existing arrays were allocated from
+ the arena of an exec plan, since that arena is only used while the plan is
+ being constructed.
 
  @param CmdContext Pointer to the command context to expand.
 
@@ -1778,6 +1849,9 @@ YoriLibShCheckForDeviceNameAndDuplicate(
         the character offset within the current argument for the cursor
         location.
 
+ @param Arena Optionally points to an arena to allocate the program's
+        argument array from.
+
  @return The number of arguments consumed while creating information about
          how to execute a single program.
  */
@@ -1789,7 +1863,8 @@ YoriLibShParseCmdContextToExecContext(
     __out PYORI_LIBSH_SINGLE_EXEC_CONTEXT ExecContext,
     __out_opt PBOOLEAN CurrentArgIsForProgram,
     __out_opt PYORI_ALLOC_SIZE_T CurrentArgIndex,
-    __out_opt PYORI_ALLOC_SIZE_T CurrentArgOffset
+    __out_opt PYORI_ALLOC_SIZE_T CurrentArgOffset,
+    __inout_opt PYORI_LIB_ARENA Arena
     )
 {
     YORI_ALLOC_SIZE_T Count;
@@ -1842,7 +1917,7 @@ YoriLibShParseCmdContextToExecContext(
 
     ArgumentsConsumed = Count - InitialArgument;
 
-    if (!YoriLibShAllocateArgCount(&ExecContext->CmdToExec, ArgumentsConsumed, 0, NULL)) {
+    if (!YoriLibShAllocateArgCountFromArena(&ExecContext->CmdToExec, ArgumentsConsumed, 0, NULL, Arena)) {
         return 0;
     }
     ExecContext->CmdToExec.ArgC = 0;
@@ -2089,7 +2164,11 @@ YoriLibShDereferenceExecContext(
     if (InterlockedDecrement((LONG *)&ExecContext->ReferenceCount) == 0) {
         YoriLibShFreeExecContext(ExecContext);
         if (Deallocate) {
-            YoriLibFree(ExecContext);
+            if (ExecContext->MemoryToFree != NULL) {
+                YoriLibDereference(ExecContext->MemoryToFree);
+            } else {
+                YoriLibFree(ExecContext);
+            }
         }
     }
 }
@@ -2169,10 +2248,14 @@ YoriLibShParseCmdContextToExecPlan(
     YORI_ALLOC_SIZE_T ArgOfLastOperatorIndex = 0;
     PYORI_LIBSH_SINGLE_EXEC_CONTEXT ThisProgram;
     PYORI_LIBSH_SINGLE_EXEC_CONTEXT PreviousProgram = NULL;
+    PVOID ThisProgramMemory;
     BOOLEAN LocalCurrentArgIsForProgram;
     BOOLEAN FoundProgramMatch;
     YORI_ALLOC_SIZE_T LocalCurrentArgIndex;
     YORI_ALLOC_SIZE_T LocalCurrentArgOffset;
+    YORI_ALLOC_SIZE_T ProgramCount;
+    YORI_ALLOC_SIZE_T Count;
+    YORI_LIB_ARENA Arena;
 
     if (CmdContext->ArgC == 0) {
         return FALSE;
@@ -2197,11 +2280,32 @@ YoriLibShParseCmdContextToExecPlan(
     ZeroMemory(ExecPlan, sizeof(YORI_LIBSH_EXEC_PLAN));
     FoundProgramMatch = FALSE;
 
+    //
+    //  Size an arena to hold the argument arrays for the entire command and
+    //  for each program, plus each program's exec context, so that a
+    //  typical command needs a single allocation for the whole plan.  Each
+    //  argument can be consumed by at most one program, and the number of
+    //  programs is bounded by the number of seperators.
+    //
+
+    ProgramCount = 1;
+    for (Count = 0; Count < CmdContext->ArgC; Count++) {
+        if (!CmdContext->ArgContexts[Count].Quoted &&
+            YoriLibShIsArgumentProgramSeperator(&CmdContext->ArgV[Count], (Count == CmdContext->ArgC - 1))) {
+            ProgramCount++;
+        }
+    }
+
+    YoriLibArenaInitialize(&Arena,
+                           2 * CmdContext->ArgC * (sizeof(YORI_STRING) + sizeof(YORI_LIBSH_ARG_CONTEXT) + 8) +
+                           ProgramCount * (sizeof(YORI_LIBSH_SINGLE_EXEC_CONTEXT) + 16) + 8);
+
     //
     //  First, turn the entire CmdContext into an ExecContext.
     //
 
-    if (!YoriLibShCopyCmdContext(&ExecPlan->EntireCmd.CmdToExec, CmdContext)) {
+    if (!YoriLibShCopyCmdContextFromArena(&ExecPlan->EntireCmd.CmdToExec, CmdContext, &Arena)) {
+        YoriLibArenaCleanup(&Arena);
         YoriLibShFreeExecPlan(ExecPlan);
         return FALSE;
     }
@@ -2211,15 +2315,18 @@ YoriLibShParseCmdContextToExecPlan(
 
     while (CurrentArg < CmdContext->ArgC) {
 
-        ThisProgram = YoriLibMalloc(sizeof(YORI_LIBSH_SINGLE_EXEC_CONTEXT));
+        ThisProgram = YoriLibArenaAllocate(&Arena, sizeof(YORI_LIBSH_SINGLE_EXEC_CONTEXT), &ThisProgramMemory);
         if (ThisProgram == NULL) {
+            YoriLibArenaCleanup(&Arena);
             YoriLibShFreeExecPlan(ExecPlan);
             return FALSE;
         }
 
-        ArgsConsumed = YoriLibShParseCmdContextToExecContext(CmdContext, CurrentArg, ThisProgram, &LocalCurrentArgIsForProgram, &LocalCurrentArgIndex, &LocalCurrentArgOffset);
+        ArgsConsumed = YoriLibShParseCmdContextToExecContext(CmdContext, CurrentArg, ThisProgram, &LocalCurrentArgIsForProgram, &LocalCurrentArgIndex, &LocalCurrentArgOffset, &Arena);
+        ThisProgram->MemoryToFree = ThisProgramMemory;
         if (ArgsConsumed == 0) {
             YoriLibShDereferenceExecContext(ThisProgram, TRUE);
+            YoriLibArenaCleanup(&Arena);
             YoriLibShFreeExecPlan(ExecPlan);
             return FALSE;
         }
@@ -2370,6 +2477,7 @@ YoriLibShParseCmdContextToExecPlan(
         }
     }
 
+    YoriLibArenaCleanup(&Arena);
     return TRUE;
 }
 
@@ -4,7 +4,7 @@
  * Header for library routines that are of value to the shell or other
  * components performing very shell like behavior.
  *
- * Copyright (c) 2017-2020 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -173,6 +173,13 @@ typedef struct _YORI_LIBSH_SINGLE_EXEC_CONTEXT {
      */
     DWORD ReferenceCount;
 
+    /**
+     If non-NULL, the referenced allocation containing this structure, which
+     is dereferenced rather than freed when the structure is deallocated.
+     This allows exec contexts to be allocated from an arena.
+     */
+    PVOID MemoryToFree;
+
     /**
      Specifies the type of the next program and the conditions under which
      it should execute.
@@ -678,6 +685,16 @@ YoriLibShBuildCmdContextForCmdBuckPass (
 
 // *** PARSE.C ***
 
+__success(return)
+BOOLEAN
+YoriLibShAllocateArgCountFromArena(
+    __out PYORI_LIBSH_CMD_CONTEXT CmdContext,
+    __in YORI_ALLOC_SIZE_T ArgCount,
+    __in YORI_ALLOC_SIZE_T ExtraByteCount,
+    __out_opt PVOID *ExtraData,
+    __inout_opt PYORI_LIB_ARENA Arena
+    );
+
 __success(return)
 BOOLEAN
 YoriLibShAllocateArgCount(
@@ -703,6 +720,14 @@ YoriLibShCheckIfArgNeedsQuotes(
     __in YORI_ALLOC_SIZE_T ArgIndex
     );
 
+__success(return)
+BOOL
+YoriLibShCopyCmdContextFromArena(
+    __out PYORI_LIBSH_CMD_CONTEXT DestCmdContext,
+    __in PYORI_LIBSH_CMD_CONTEXT SrcCmdContext,
+    __inout_opt PYORI_LIB_ARENA Arena
+    );
+
 __success(return)
 BOOL
 YoriLibShCopyCmdContext(
@@ -3,7 +3,7 @@
  *
  * Yori window multiline edit control
  *
- * Copyright (c) 2020-2024 Malcolm J. Smith
+ * Copyright (c) 2020-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -94,7 +94,8 @@ typedef struct _YORI_WIN_MULTILINE_EDIT_SELECT {
 typedef enum _YORI_WIN_CTRL_MULTILINE_EDIT_UNDO_OPERATION {
     YoriWinMultilineEditUndoInsertText = 0,
     YoriWinMultilineEditUndoOverwriteText = 1,
-    YoriWinMultilineEditUndoDeleteText = 2
+    YoriWinMultilineEditUndoDeleteText = 2,
+    YoriWinMultilineEditUndoDeleteLines = 3
 } YORI_WIN_CTRL_MULTILINE_EDIT_UNDO_OPERATION;
 
 /**
@@ -171,6 +172,27 @@ typedef struct _YORI_WIN_CTRL_MULTILINE_EDIT_UNDO {
 
         } DeleteText;
 
+        struct {
+
+            /**
+             The line index where the deleted lines should be reinserted.
+             */
+            YORI_ALLOC_SIZE_T FirstLine;
+
+            /**
+             The number of lines in the Lines array.
+             */
+            YORI_ALLOC_SIZE_T LineCount;
+
+            /**
+             An array of the lines that were removed from the buffer.  These
+             are the strings the buffer used to contain, so deleting and
+             reinserting entire lines does not copy their contents.
+             */
+            PYORI_STRING Lines;
+
+        } DeleteLines;
+
         struct {
             /**
              The first line of the range that was overwritten and should be
@@ -255,18 +277,29 @@ typedef struct _YORI_WIN_CTRL_MULTILINE_EDIT {
      */
     PYORI_WIN_NOTIFY_MULTILINE_EDIT_CURSOR_MOVE CursorMoveCallback;
 
+    /**
+     Optional pointer to a callback to invoke periodically while the
+     contents of the control are being loaded.
+     */
+    PYORI_WIN_NOTIFY_MULTILINE_EDIT_LOAD_MORE LoadMoreCallback;
+
     /**
      The caption to display above the edit control.
      */
     YORI_STRING Caption;
 
     /**
-     An array of lines corresponding to lines within a file.
+     An array of lines corresponding to lines within a file.  The unused
+     entries in this array form a gap at GapStart, so lines can be inserted
+     or deleted near the previous modification without moving every later
+     line.  Lines should be located with
+     @ref YoriWinMultilineEditLookupLine .
      */
     PYORI_STRING LineArray;
 
     /**
-     The number of lines allocated within LineArray.
+     The number of lines allocated within LineArray.  The difference between
+     this and LinesPopulated is the size of the gap.
      */
     YORI_ALLOC_SIZE_T LinesAllocated;
 
@@ -275,6 +308,13 @@ typedef struct _YORI_WIN_CTRL_MULTILINE_EDIT {
      */
     YORI_ALLOC_SIZE_T LinesPopulated;
 
+    /**
+     The index of the first unused entry in LineArray.  Lines before this
+     index are stored at their line index, and lines from this index onwards
+     are stored after the gap.
+     */
+    YORI_ALLOC_SIZE_T GapStart;
+
     /**
      A stack of changes which can be undone.
      */
@@ -391,6 +431,12 @@ typedef struct _YORI_WIN_CTRL_MULTILINE_EDIT {
      */
     PYORI_WIN_CTRL_HANDLE Timer;
 
+    /**
+     A timer that is used to invoke LoadMoreCallback.  This is NULL if no
+     load is in progress.
+     */
+    PYORI_WIN_CTRL_HANDLE LoadTimer;
+
     /**
      When inputting a character by value, the current value that has been
      accumulated (since this requires multiple key events.)
@@ -481,6 +527,103 @@ typedef struct _YORI_WIN_CTRL_MULTILINE_EDIT {
 
 } YORI_WIN_CTRL_MULTILINE_EDIT, *PYORI_WIN_CTRL_MULTILINE_EDIT;
 
+//
+//  =========================================
+//  LINE STORAGE FUNCTIONS
+//  =========================================
+//
+
+/**
+ Return the string describing a line within the multiline edit control.
+ The returned pointer is valid until lines are inserted or removed.
+
+ @param MultilineEdit Pointer to the multiline edit control.
+
+ @param LineIndex The index of the line to return.
+
+ @return Pointer to the line.
+ */
+PYORI_STRING
+YoriWinMultilineEditLookupLine(
+    __in PYORI_WIN_CTRL_MULTILINE_EDIT MultilineEdit,
+    __in YORI_ALLOC_SIZE_T LineIndex
+    )
+{
+    ASSERT(LineIndex < MultilineEdit->LinesPopulated);
+    if (LineIndex < MultilineEdit->GapStart) {
+        return &MultilineEdit->LineArray[LineIndex];
+    }
+
+    return &MultilineEdit->LineArray[LineIndex + MultilineEdit->LinesAllocated - MultilineEdit->LinesPopulated];
+}
+
+/**
+ Move the gap in the line array so that it starts at the specified line.
+ The cost of this operation is proportional to the distance the gap moves,
+ so repeated modifications near the same location are inexpensive.
+
+ @param MultilineEdit Pointer to the multiline edit control.
+
+ @param NewGapStart The line index that should immediately follow the lines
+        before the gap.
+ */
+VOID
+YoriWinMultilineEditMoveGap(
+    __in PYORI_WIN_CTRL_MULTILINE_EDIT MultilineEdit,
+    __in YORI_ALLOC_SIZE_T NewGapStart
+    )
+{
+    YORI_ALLOC_SIZE_T GapLength;
+    YORI_ALLOC_SIZE_T GapStart;
+
+    ASSERT(NewGapStart <= MultilineEdit->LinesPopulated);
+
+    GapStart = MultilineEdit->GapStart;
+    GapLength = MultilineEdit->LinesAllocated - MultilineEdit->LinesPopulated;
+
+    if (GapLength > 0) {
+        if (NewGapStart < GapStart) {
+            memmove(&MultilineEdit->LineArray[NewGapStart + GapLength],
+                    &MultilineEdit->LineArray[NewGapStart],
+                    (GapStart - NewGapStart) * sizeof(YORI_STRING));
+        } else if (NewGapStart > GapStart) {
+            memmove(&MultilineEdit->LineArray[GapStart],
+                    &MultilineEdit->LineArray[GapStart + GapLength],
+                    (NewGapStart - GapStart) * sizeof(YORI_STRING));
+        }
+    }
+
+    MultilineEdit->GapStart = NewGapStart;
+}
+
+/**
+ Remove a range of lines from the line array, merging their entries into the
+ gap.  This does not free the contents of the lines, which is the caller's
+ responsibility.
+
+ @param MultilineEdit Pointer to the multiline edit control.
+
+ @param FirstLine The first line to remove.
+
+ @param LineCount The number of lines to remove.
+ */
+VOID
+YoriWinMultilineEditRemoveLines(
+    __in PYORI_WIN_CTRL_MULTILINE_EDIT MultilineEdit,
+    __in YORI_ALLOC_SIZE_T FirstLine,
+    __in YORI_ALLOC_SIZE_T LineCount
+    )
+{
+    ASSERT(FirstLine + LineCount <= MultilineEdit->LinesPopulated);
+    if (LineCount == 0) {
+        return;
+    }
+
+    YoriWinMultilineEditMoveGap(MultilineEdit, FirstLine + LineCount);
+    MultilineEdit->GapStart = FirstLine;
+    MultilineEdit->LinesPopulated = MultilineEdit->LinesPopulated - LineCount;
+}
+
 //
 //  =========================================
 //  DISPLAY FUNCTIONS
@@ -555,7 +698,7 @@ YoriWinMultilineEditFindCursorCharFromDisplayChar(
         return;
     }
 
-    Line = &MultilineEdit->LineArray[LineIndex];
+    Line = YoriWinMultilineEditLookupLine(MultilineEdit, LineIndex);
 
     YoriWinTextBufferOffsetFromDisplayCellOffset(WinMgrHandle,
                                                  Line,
@@ -600,7 +743,7 @@ YoriWinMultilineEditFindDisplayCharFromCursorChar(
         return;
     }
 
-    Line = &MultilineEdit->LineArray[LineIndex];
+    Line = YoriWinMultilineEditLookupLine(MultilineEdit, LineIndex);
 
     YoriWinTextDisplayCellOffsetFromBufferOffset(WinMgrHandle,
                                                  Line,
@@ -851,7 +994,7 @@ YoriWinMultilineEditGenerateDisplayLine(
 
     TopLevelWindow = YoriWinGetTopLevelWindow(&MultilineEdit->Ctrl);
     WinMgrHandle = YoriWinGetWindowManagerHandle(TopLevelWindow);
-    SourceLine = &MultilineEdit->LineArray[LineIndex];
+    SourceLine = YoriWinMultilineEditLookupLine(MultilineEdit, LineIndex);
 
     //
     //  Create a string that corresponds to the current position in the
@@ -1319,6 +1462,8 @@ YoriWinMultilineEditFreeSingleUndo(
     __in PYORI_WIN_CTRL_MULTILINE_EDIT_UNDO Undo
     )
 {
+    YORI_ALLOC_SIZE_T Index;
+
     switch(Undo->Op) {
         case YoriWinMultilineEditUndoOverwriteText:
             YoriLibFreeStringContents(&Undo->u.OverwriteText.Text);
@@ -1326,6 +1471,14 @@ YoriWinMultilineEditFreeSingleUndo(
         case YoriWinMultilineEditUndoDeleteText:
             YoriLibFreeStringContents(&Undo->u.DeleteText.Text);
             break;
+        case YoriWinMultilineEditUndoDeleteLines:
+            if (Undo->u.DeleteLines.Lines != NULL) {
+                for (Index = 0; Index < Undo->u.DeleteLines.LineCount; Index++) {
+                    YoriLibFreeStringContents(&Undo->u.DeleteLines.Lines[Index]);
+                }
+                YoriLibFree(Undo->u.DeleteLines.Lines);
+            }
+            break;
     }
 
     YoriLibFree(Undo);
@@ -1552,6 +1705,13 @@ YoriWinMultilineEditGetUndoRecordForOperation(
                         Undo = NULL;
                     }
                     break;
+                case YoriWinMultilineEditUndoDeleteLines:
+                    if (LastLine == Undo->u.DeleteLines.FirstLine) {
+                        *NewRangeBeforeExistingRange = TRUE;
+                    } else if (FirstLine != Undo->u.DeleteLines.FirstLine) {
+                        Undo = NULL;
+                    }
+                    break;
                 case YoriWinMultilineEditUndoOverwriteText:
                     if (!YoriWinMultilineEditRangeImmediatelyFollows(MultilineEdit,
                                                                      Undo->u.OverwriteText.LastLineToDelete,
@@ -1592,6 +1752,11 @@ YoriWinMultilineEditGetUndoRecordForOperation(
                 Undo->u.DeleteText.FirstCharOffset = FirstCharOffset;
                 YoriLibInitEmptyString(&Undo->u.DeleteText.Text);
                 break;
+            case YoriWinMultilineEditUndoDeleteLines:
+                Undo->u.DeleteLines.FirstLine = FirstLine;
+                Undo->u.DeleteLines.LineCount = 0;
+                Undo->u.DeleteLines.Lines = NULL;
+                break;
             case YoriWinMultilineEditUndoOverwriteText:
                 Undo->u.OverwriteText.FirstLineToDelete = FirstLine;
                 Undo->u.OverwriteText.FirstCharOffsetToDelete = FirstCharOffset;
@@ -1804,6 +1969,20 @@ YoriWinMultilineEditCalculateEndingPointOfText(
     __out PYORI_ALLOC_SIZE_T LastCharOffset
     );
 
+__success(return)
+BOOLEAN
+YoriWinMultilineEditReinsertLines(
+    __in PYORI_WIN_CTRL_MULTILINE_EDIT MultilineEdit,
+    __inout PYORI_WIN_CTRL_MULTILINE_EDIT_UNDO Undo
+    );
+
+__success(return)
+BOOLEAN
+YoriWinMultilineEditEnsureLineCapacity(
+    __in PYORI_WIN_CTRL_MULTILINE_EDIT MultilineEdit,
+    __in DWORD LinesRequired
+    );
+
 /**
  Given an undo record, generate a record that would undo the undo.
 
@@ -1875,6 +2054,13 @@ YoriWinMultilineEditGenerateRedoRecordForUndo(
                                                            &Redo->u.InsertText.LastLineToDelete,
                                                            &Redo->u.InsertText.LastCharOffsetToDelete);
             break;
+        case YoriWinMultilineEditUndoDeleteLines:
+            Redo->Op = YoriWinMultilineEditUndoInsertText;
+            Redo->u.InsertText.FirstLineToDelete = Undo->u.DeleteLines.FirstLine;
+            Redo->u.InsertText.FirstCharOffsetToDelete = 0;
+            Redo->u.InsertText.LastLineToDelete = Undo->u.DeleteLines.FirstLine + Undo->u.DeleteLines.LineCount;
+            Redo->u.InsertText.LastCharOffsetToDelete = 0;
+            break;
         case YoriWinMultilineEditUndoOverwriteText:
 
             Redo->Op = Undo->Op;
@@ -1960,6 +2146,15 @@ YoriWinMultilineEditApplyUndoRecord(
                                                               NewLastLine);
             }
             break;
+        case YoriWinMultilineEditUndoDeleteLines:
+            NewLastLine = Undo->u.DeleteLines.FirstLine + Undo->u.DeleteLines.LineCount;
+            Success = YoriWinMultilineEditReinsertLines(MultilineEdit, Undo);
+            if (Success) {
+                YoriWinMultilineEditSetCursorLocationInternal(MultilineEdit,
+                                                              0,
+                                                              NewLastLine);
+            }
+            break;
         case YoriWinMultilineEditUndoOverwriteText:
             NewLastLine = 0;
             NewLastCharOffset = 0;
@@ -2158,26 +2353,26 @@ YoriWinMultilineEditGetTextRangeLength(
     if (FirstLine == LastLine) {
         ASSERT(LastCharOffset >= FirstCharOffset);
         CharsInRange = 0;
-        if (FirstCharOffset >= MultilineEdit->LineArray[FirstLine].LengthInChars) {
+        if (FirstCharOffset >= YoriWinMultilineEditLookupLine(MultilineEdit, FirstLine)->LengthInChars) {
             CharsInRange = 0;
-        } else if (LastCharOffset >= MultilineEdit->LineArray[FirstLine].LengthInChars) {
-            CharsInRange = MultilineEdit->LineArray[FirstLine].LengthInChars - FirstCharOffset;
+        } else if (LastCharOffset >= YoriWinMultilineEditLookupLine(MultilineEdit, FirstLine)->LengthInChars) {
+            CharsInRange = YoriWinMultilineEditLookupLine(MultilineEdit, FirstLine)->LengthInChars - FirstCharOffset;
         } else {
             CharsInRange = LastCharOffset - FirstCharOffset;
         }
     } else {
         LinesInRange = LastLine - FirstLine;
         CharsInRange = 0;
-        if (FirstCharOffset < MultilineEdit->LineArray[FirstLine].LengthInChars) {
-            CharsInRange += MultilineEdit->LineArray[FirstLine].LengthInChars - FirstCharOffset;
+        if (FirstCharOffset < YoriWinMultilineEditLookupLine(MultilineEdit, FirstLine)->LengthInChars) {
+            CharsInRange += YoriWinMultilineEditLookupLine(MultilineEdit, FirstLine)->LengthInChars - FirstCharOffset;
         }
         for (LineIndex = FirstLine + 1; LineIndex < LastLine; LineIndex++) {
-            CharsInRange += MultilineEdit->LineArray[LineIndex].LengthInChars;
+            CharsInRange += YoriWinMultilineEditLookupLine(MultilineEdit, LineIndex)->LengthInChars;
         }
-        if (LastCharOffset < MultilineEdit->LineArray[LineIndex].LengthInChars) {
+        if (LastCharOffset < YoriWinMultilineEditLookupLine(MultilineEdit, LineIndex)->LengthInChars) {
             CharsInRange += LastCharOffset;
         } else {
-            CharsInRange += MultilineEdit->LineArray[LineIndex].LengthInChars;
+            CharsInRange += YoriWinMultilineEditLookupLine(MultilineEdit, LineIndex)->LengthInChars;
         }
         CharsInRange += LinesInRange * NewlineLength;
     }
@@ -2239,7 +2434,7 @@ YoriWinMultilineEditGetIndentationOnLine(
 {
     PCYORI_STRING Line;
 
-    Line = &MultilineEdit->LineArray[LineIndex];
+    Line = YoriWinMultilineEditLookupLine(MultilineEdit, LineIndex);
     YoriWinMultilineEditGetIndentationOnString(Line, Indent);
 }
 
@@ -2284,7 +2479,7 @@ YoriWinMultilineEditFindPreviousIndentLine(
     //
 
     for (ProbeLine = MultilineEdit->AutoIndentAppliedLine; ProbeLine > 0; ProbeLine--) {
-        ProbeLineString = &MultilineEdit->LineArray[ProbeLine - 1];
+        ProbeLineString = YoriWinMultilineEditLookupLine(MultilineEdit, ProbeLine - 1);
         if (ProbeLineString->LengthInChars > 0) {
             YoriWinMultilineEditGetIndentationOnString(ProbeLineString, &ProbeIndent);
             MatchingLength = YoriLibCntStringMatchChars(&CurrentIndent, &ProbeIndent);
@@ -2344,7 +2539,7 @@ YoriWinMultilineEditPopulateTextRange(
     PYORI_STRING Line;
     LPTSTR Ptr;
 
-    Line = &MultilineEdit->LineArray[FirstLine];
+    Line = YoriWinMultilineEditLookupLine(MultilineEdit, FirstLine);
 
     if (FirstLine == LastLine) {
         if (FirstCharOffset > Line->LengthInChars) {
@@ -2369,18 +2564,18 @@ YoriWinMultilineEditPopulateTextRange(
             memcpy(Ptr, NewlineString->StartOfString, NewlineString->LengthInChars * sizeof(TCHAR));
             Ptr += NewlineString->LengthInChars;
             memcpy(Ptr,
-                   MultilineEdit->LineArray[LineIndex].StartOfString,
-                   MultilineEdit->LineArray[LineIndex].LengthInChars * sizeof(TCHAR));
-            Ptr += MultilineEdit->LineArray[LineIndex].LengthInChars;
+                   YoriWinMultilineEditLookupLine(MultilineEdit, LineIndex)->StartOfString,
+                   YoriWinMultilineEditLookupLine(MultilineEdit, LineIndex)->LengthInChars * sizeof(TCHAR));
+            Ptr += YoriWinMultilineEditLookupLine(MultilineEdit, LineIndex)->LengthInChars;
         }
         memcpy(Ptr, NewlineString->StartOfString, NewlineString->LengthInChars * sizeof(TCHAR));
         Ptr += NewlineString->LengthInChars;
-        if (LastCharOffset < MultilineEdit->LineArray[LastLine].LengthInChars) {
+        if (LastCharOffset < YoriWinMultilineEditLookupLine(MultilineEdit, LastLine)->LengthInChars) {
             CharsInRange = LastCharOffset;
         } else {
-            CharsInRange = MultilineEdit->LineArray[LastLine].LengthInChars;
+            CharsInRange = YoriWinMultilineEditLookupLine(MultilineEdit, LastLine)->LengthInChars;
         }
-        memcpy(Ptr, MultilineEdit->LineArray[LastLine].StartOfString, CharsInRange * sizeof(TCHAR));
+        memcpy(Ptr, YoriWinMultilineEditLookupLine(MultilineEdit, LastLine)->StartOfString, CharsInRange * sizeof(TCHAR));
         Ptr += LastCharOffset;
 
         SelectedText->LengthInChars = (YORI_ALLOC_SIZE_T)(Ptr - SelectedText->StartOfString);
@@ -2458,6 +2653,161 @@ YoriWinMultilineEditGetTextRange(
 }
 
 
+/**
+ Delete a range of entire lines.  The lines are removed from the buffer and
+ saved in an undo record, so their contents are not copied.
+
+ @param MultilineEdit Pointer to the multiline edit control containing the
+        contents of the buffer.
+
+ @param ChainWithNext If TRUE, when this delete is undone, the next operation
+        should be undone with it.
+
+ @param FirstLine Specifies the first line to delete.
+
+ @param LineCount Specifies the number of lines to delete.  At least one
+        line must remain after the deleted range.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriWinMultilineEditDeleteLines(
+    __in PYORI_WIN_CTRL_MULTILINE_EDIT MultilineEdit,
+    __in BOOLEAN ChainWithNext,
+    __in YORI_ALLOC_SIZE_T FirstLine,
+    __in YORI_ALLOC_SIZE_T LineCount
+    )
+{
+    PYORI_WIN_CTRL_MULTILINE_EDIT_UNDO Undo;
+    BOOLEAN RangeBeforeExistingRange;
+    PYORI_STRING Lines;
+    PYORI_STRING NewLines;
+    YORI_ALLOC_SIZE_T ExistingCount;
+    YORI_ALLOC_SIZE_T Index;
+
+    ASSERT(FirstLine + LineCount < MultilineEdit->LinesPopulated);
+
+    Undo = YoriWinMultilineEditGetUndoRecordForOperation(MultilineEdit,
+                                                         YoriWinMultilineEditUndoDeleteLines,
+                                                         FirstLine,
+                                                         0,
+                                                         FirstLine + LineCount,
+                                                         0,
+                                                         &RangeBeforeExistingRange);
+
+    //
+    //  If this deletion is adjacent to a previous one, the lines are merged
+    //  into the existing record so that a single undo restores both.  The
+    //  array describing the lines is reallocated, but line contents are
+    //  not copied.
+    //
+
+    Lines = NULL;
+    if (Undo != NULL) {
+        ExistingCount = Undo->u.DeleteLines.LineCount;
+        if (!YoriLibIsSizeAllocatable(((DWORD)ExistingCount + LineCount) * sizeof(YORI_STRING))) {
+            return FALSE;
+        }
+
+        NewLines = YoriLibMalloc((ExistingCount + LineCount) * sizeof(YORI_STRING));
+        if (NewLines == NULL) {
+            if (ExistingCount == 0) {
+                YoriLibRemoveListItem(&Undo->ListEntry);
+                YoriWinMultilineEditFreeSingleUndo(Undo);
+            }
+            return FALSE;
+        }
+
+        if (RangeBeforeExistingRange) {
+            Lines = NewLines;
+            if (ExistingCount > 0) {
+                memcpy(&NewLines[LineCount], Undo->u.DeleteLines.Lines, ExistingCount * sizeof(YORI_STRING));
+            }
+            Undo->u.DeleteLines.FirstLine = FirstLine;
+        } else {
+            Lines = &NewLines[ExistingCount];
+            if (ExistingCount > 0) {
+                memcpy(NewLines, Undo->u.DeleteLines.Lines, ExistingCount * sizeof(YORI_STRING));
+            }
+        }
+
+        if (Undo->u.DeleteLines.Lines != NULL) {
+            YoriLibFree(Undo->u.DeleteLines.Lines);
+        }
+        Undo->u.DeleteLines.Lines = NewLines;
+        Undo->u.DeleteLines.LineCount = ExistingCount + LineCount;
+        if (ChainWithNext) {
+            Undo->ChainWithNext = TRUE;
+        }
+    }
+
+    for (Index = 0; Index < LineCount; Index++) {
+        if (Lines != NULL) {
+            memcpy(&Lines[Index], YoriWinMultilineEditLookupLine(MultilineEdit, FirstLine + Index), sizeof(YORI_STRING));
+        } else {
+            YoriLibFreeStringContents(YoriWinMultilineEditLookupLine(MultilineEdit, FirstLine + Index));
+        }
+    }
+
+    YoriWinMultilineEditExpandDirtyRange(MultilineEdit, FirstLine, MultilineEdit->LinesPopulated);
+    YoriWinMultilineEditRemoveLines(MultilineEdit, FirstLine, LineCount);
+    MultilineEdit->UserModified = TRUE;
+
+    return TRUE;
+}
+
+/**
+ Reinsert lines that were removed by @ref YoriWinMultilineEditDeleteLines .
+ On success, the lines are owned by the buffer and are removed from the undo
+ record.
+
+ @param MultilineEdit Pointer to the multiline edit control containing the
+        contents of the buffer.
+
+ @param Undo Pointer to the undo record containing the lines to reinsert.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriWinMultilineEditReinsertLines(
+    __in PYORI_WIN_CTRL_MULTILINE_EDIT MultilineEdit,
+    __inout PYORI_WIN_CTRL_MULTILINE_EDIT_UNDO Undo
+    )
+{
+    YORI_ALLOC_SIZE_T FirstLine;
+    YORI_ALLOC_SIZE_T LineCount;
+    DWORD LinesRequired;
+
+    ASSERT(Undo->Op == YoriWinMultilineEditUndoDeleteLines);
+
+    FirstLine = Undo->u.DeleteLines.FirstLine;
+    LineCount = Undo->u.DeleteLines.LineCount;
+    ASSERT(FirstLine < MultilineEdit->LinesPopulated);
+
+    LinesRequired = MultilineEdit->LinesPopulated;
+    LinesRequired = LinesRequired + LineCount;
+    if (!YoriWinMultilineEditEnsureLineCapacity(MultilineEdit, LinesRequired)) {
+        return FALSE;
+    }
+
+    YoriWinMultilineEditClearSelection(MultilineEdit);
+    MultilineEdit->AutoIndentApplied = FALSE;
+
+    YoriWinMultilineEditMoveGap(MultilineEdit, FirstLine);
+    memcpy(&MultilineEdit->LineArray[FirstLine], Undo->u.DeleteLines.Lines, LineCount * sizeof(YORI_STRING));
+    MultilineEdit->GapStart = FirstLine + LineCount;
+    MultilineEdit->LinesPopulated = (YORI_ALLOC_SIZE_T)LinesRequired;
+
+    Undo->u.DeleteLines.LineCount = 0;
+
+    YoriWinMultilineEditExpandDirtyRange(MultilineEdit, FirstLine, MultilineEdit->LinesPopulated);
+    MultilineEdit->UserModified = TRUE;
+
+    return TRUE;
+}
+
 /**
  Delete a range of characters, which may span lines.  This is used when
  deleting a selection.  When deleting ranges that are not entire lines,
@@ -2513,8 +2863,6 @@ YoriWinMultilineEditDeleteTextRange(
     YORI_ALLOC_SIZE_T CharsToCopy;
     YORI_ALLOC_SIZE_T CharsToDelete;
     YORI_ALLOC_SIZE_T LinesToDelete;
-    YORI_ALLOC_SIZE_T LinesToCopy;
-    YORI_ALLOC_SIZE_T FirstLineIndexToKeep;
     YORI_ALLOC_SIZE_T LineIndexToDelete;
     PYORI_STRING Line;
     PYORI_STRING FinalLine;
@@ -2536,6 +2884,20 @@ YoriWinMultilineEditDeleteTextRange(
 
     YoriWinMultilineEditClearSelection(MultilineEdit);
 
+    //
+    //  If entire lines are being deleted, remove them from the buffer and
+    //  save them for undo without copying their contents.
+    //
+
+    if (!ProcessingUndo &&
+        FirstCharOffset == 0 &&
+        LastCharOffset == 0 &&
+        FirstLine < LastLine &&
+        LastLine < MultilineEdit->LinesPopulated) {
+
+        return YoriWinMultilineEditDeleteLines(MultilineEdit, ChainWithNext, FirstLine, LastLine - FirstLine);
+    }
+
     if (!ProcessingUndo) {
         BOOLEAN RangeBeforeExistingRange;
         Undo = YoriWinMultilineEditGetUndoRecordForOperation(MultilineEdit,
@@ -2588,7 +2950,7 @@ YoriWinMultilineEditDeleteTextRange(
         }
     }
 
-    Line = &MultilineEdit->LineArray[FirstLine];
+    Line = YoriWinMultilineEditLookupLine(MultilineEdit, FirstLine);
 
     //
     //  If the selection is one line, this is a simple case, because no
@@ -2625,7 +2987,7 @@ YoriWinMultilineEditDeleteTextRange(
     ASSERT(LastLine < MultilineEdit->LinesPopulated ||
            (LastLine == MultilineEdit->LinesPopulated && LastCharOffset == 0));
     if (LastLine < MultilineEdit->LinesPopulated) {
-        FinalLine = &MultilineEdit->LineArray[LastLine];
+        FinalLine = YoriWinMultilineEditLookupLine(MultilineEdit, LastLine);
     } else {
         FinalLine = NULL;
     }
@@ -2694,27 +3056,13 @@ YoriWinMultilineEditDeleteTextRange(
     }
 
     for (LineIndexToDelete = 0; LineIndexToDelete < LinesToDelete; LineIndexToDelete++) {
-        YoriLibFreeStringContents(&MultilineEdit->LineArray[FirstLine + 1 + LineIndexToDelete]);
-    }
-
-    FirstLineIndexToKeep = FirstLine + 1 + LinesToDelete;
-    if (FirstLineIndexToKeep < MultilineEdit->LinesPopulated) {
-        LinesToCopy = MultilineEdit->LinesPopulated - FirstLineIndexToKeep;
-    } else {
-        LinesToCopy = 0;
-    }
-
-    if (LinesToCopy > 0) {
-        memmove(&MultilineEdit->LineArray[FirstLine + 1],
-                &MultilineEdit->LineArray[FirstLine + 1 + LinesToDelete],
-                LinesToCopy * sizeof(YORI_STRING));
+        YoriLibFreeStringContents(YoriWinMultilineEditLookupLine(MultilineEdit, FirstLine + 1 + LineIndexToDelete));
     }
 
     YoriWinMultilineEditExpandDirtyRange(MultilineEdit, FirstLine, MultilineEdit->LinesPopulated);
+    YoriWinMultilineEditRemoveLines(MultilineEdit, FirstLine + 1, LinesToDelete);
     MultilineEdit->UserModified = TRUE;
 
-    MultilineEdit->LinesPopulated = MultilineEdit->LinesPopulated - LinesToDelete;
-
     return TRUE;
 }
 
@@ -2802,6 +3150,7 @@ YoriWinMultilineEditReallocateLineArray(
     PYORI_STRING NewLineArray;
     YORI_ALLOC_SIZE_T BytesToAllocate;
     YORI_ALLOC_SIZE_T NewLineCount;
+    YORI_ALLOC_SIZE_T TrailingLines;
 
     ASSERT(LinesDesired >= LinesRequired);
     ASSERT(LinesRequired > MultilineEdit->LinesPopulated);
@@ -2821,8 +3170,18 @@ YoriWinMultilineEditReallocateLineArray(
         return FALSE;
     }
 
-    if (MultilineEdit->LinesPopulated > 0) {
-        memcpy(NewLineArray, MultilineEdit->LineArray, MultilineEdit->LinesPopulated * sizeof(YORI_STRING));
+    //
+    //  Lines before the gap are at the start of the array, and lines after
+    //  the gap are at the end of the array.  The gap grows to consume the
+    //  new space in between.
+    //
+
+    if (MultilineEdit->LineArray != NULL) {
+        TrailingLines = MultilineEdit->LinesPopulated - MultilineEdit->GapStart;
+        memcpy(NewLineArray, MultilineEdit->LineArray, MultilineEdit->GapStart * sizeof(YORI_STRING));
+        memcpy(&NewLineArray[NewLineCount - TrailingLines],
+               &MultilineEdit->LineArray[MultilineEdit->LinesAllocated - TrailingLines],
+               TrailingLines * sizeof(YORI_STRING));
         YoriLibDereference(MultilineEdit->LineArray);
     }
 
@@ -2831,6 +3190,48 @@ YoriWinMultilineEditReallocateLineArray(
     return TRUE;
 }
 
+/**
+ Ensure the line array has space for at least the specified number of lines,
+ reallocating it if necessary.  When reallocating, extra space is allocated
+ so that the following insertions do not also reallocate.
+
+ @param MultilineEdit Pointer to the multiline edit control.
+
+ @param LinesRequired Specifies the minimum number of lines that the control
+        should have allocated.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriWinMultilineEditEnsureLineCapacity(
+    __in PYORI_WIN_CTRL_MULTILINE_EDIT MultilineEdit,
+    __in DWORD LinesRequired
+    )
+{
+    DWORD LinesDesired;
+
+    if (LinesRequired > MultilineEdit->LinesAllocated) {
+
+        LinesDesired = MultilineEdit->LinesAllocated;
+        LinesDesired = LinesDesired * 2;
+
+        if (LinesDesired < LinesRequired) {
+            LinesDesired = LinesRequired;
+            LinesDesired = LinesDesired + 0x1000;
+            LinesDesired = LinesDesired & ~(0xfff);
+        } else if (LinesDesired < 0x1000) {
+            LinesDesired = 0x1000;
+        }
+
+        if (!YoriWinMultilineEditReallocateLineArray(MultilineEdit, LinesRequired, LinesDesired)) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
 /**
  Trim any autoindent back to the specified offset.
 
@@ -2867,7 +3268,7 @@ YoriWinMultilineEditTrimAutoIndent(
         return FALSE;
     }
 
-    Line = &MultilineEdit->LineArray[LineIndex];
+    Line = YoriWinMultilineEditLookupLine(MultilineEdit, LineIndex);
 
     ASSERT(Line->LengthInChars == MultilineEdit->AutoIndentSourceLength);
     ASSERT(Line->LengthInChars != 0);
@@ -2927,29 +3328,15 @@ YoriWinMultilineEditInsertLines(
     YORI_ALLOC_SIZE_T TargetLine;
     YORI_ALLOC_SIZE_T Index;
     DWORD LinesRequired;
-    DWORD LinesDesired;
 
     LinesRequired = MultilineEdit->LinesPopulated;
     LinesRequired = LinesRequired + LineCount;
     if (MultilineEdit->LinesPopulated == 0) {
         LinesRequired++;
     }
-    if (LinesRequired > MultilineEdit->LinesAllocated) {
-
-        LinesDesired = MultilineEdit->LinesAllocated;
-        LinesDesired = LinesDesired * 2;
 
-        if (LinesDesired < LinesRequired) {
-            LinesDesired = LinesRequired;
-            LinesDesired = LinesDesired + 0x1000;
-            LinesDesired = LinesDesired & ~(0xfff);
-        } else if (LinesDesired < 0x1000) {
-            LinesDesired = 0x1000;
-        }
-
-        if (!YoriWinMultilineEditReallocateLineArray(MultilineEdit, LinesRequired, LinesDesired)) {
-            return FALSE;
-        }
+    if (!YoriWinMultilineEditEnsureLineCapacity(MultilineEdit, LinesRequired)) {
+        return FALSE;
     }
 
     if (MultilineEdit->LinesPopulated > 0) {
@@ -2959,18 +3346,19 @@ YoriWinMultilineEditInsertLines(
         SourceLine = FirstLine;
         TargetLine = SourceLine + LineCount + 1;
     }
-    if (SourceLine < MultilineEdit->LinesPopulated) {
-        DWORD LinesToMove;
-        LinesToMove = MultilineEdit->LinesPopulated - SourceLine;
-        memmove(&MultilineEdit->LineArray[TargetLine],
-                &MultilineEdit->LineArray[SourceLine],
-                LinesToMove * sizeof(YORI_STRING));
-    }
 
+    //
+    //  Move the gap to the insertion point and consume the beginning of it
+    //  for the new lines.  Lines after the insertion point remain after the
+    //  gap and do not need to be moved.
+    //
+
+    YoriWinMultilineEditMoveGap(MultilineEdit, SourceLine);
     for (Index = SourceLine; Index < TargetLine; Index++) {
         YoriLibInitEmptyString(&MultilineEdit->LineArray[Index]);
     }
 
+    MultilineEdit->GapStart = TargetLine;
     MultilineEdit->LinesPopulated = (YORI_ALLOC_SIZE_T)LinesRequired;
     return TRUE;
 }
@@ -3073,7 +3461,7 @@ YoriWinMultilineEditInsertTextRange(
 
         if (AutoIndentLeadingString.LengthInChars > 0 && Text->LengthInChars > 0) {
             TCHAR FirstChar;
-            Line = &MultilineEdit->LineArray[FirstLine];
+            Line = YoriWinMultilineEditLookupLine(MultilineEdit, FirstLine);
             FirstChar = Text->StartOfString[0];
             if (AutoIndentLeadingString.LengthInChars == Line->LengthInChars &&
                 (FirstChar == '\n' || FirstChar == '\r')) {
@@ -3106,7 +3494,7 @@ YoriWinMultilineEditInsertTextRange(
 
     YoriLibInitEmptyString(&TrailingPortionOfFirstLine);
     if (FirstLine < MultilineEdit->LinesPopulated) {
-        Line = &MultilineEdit->LineArray[FirstLine];
+        Line = YoriWinMultilineEditLookupLine(MultilineEdit, FirstLine);
         if (FirstCharOffset < Line->LengthInChars) {
             ASSERT(Line->MemoryToFree != NULL);
             YoriLibReference(Line->MemoryToFree);
@@ -3158,7 +3546,7 @@ YoriWinMultilineEditInsertTextRange(
                     CharsLastLine = CharsThisLine;
                 }
             } else {
-                Line = &MultilineEdit->LineArray[FirstLine + LineIndex];
+                Line = YoriWinMultilineEditLookupLine(MultilineEdit, FirstLine + LineIndex);
                 ASSERT(Line->LengthInChars == 0);
                 CharsNeeded = CharsThisLine;
                 if (LineIndex == LineCount) {
@@ -3266,7 +3654,7 @@ YoriWinMultilineEditInsertTextRange(
         ASSERT(AutoIndentLeadingString.StartOfString == NULL);
     }
 
-    Line = &MultilineEdit->LineArray[FirstLine];
+    Line = YoriWinMultilineEditLookupLine(MultilineEdit, FirstLine);
     if (FirstCharOffset + CharsFirstLine + TrailingPortionOfFirstLine.LengthInChars > Line->LengthAllocated) {
         if (!YoriLibReallocString(Line, FirstCharOffset + CharsFirstLine + TrailingPortionOfFirstLine.LengthInChars + YORI_WIN_MULTILINE_EDIT_LINE_PADDING)) {
             YoriLibFreeStringContents(&TrailingPortionOfFirstLine);
@@ -3320,7 +3708,7 @@ YoriWinMultilineEditInsertTextRange(
         //
 
         if (TruncateFirstLine) {
-            Line = &MultilineEdit->LineArray[FirstLine];
+            Line = YoriWinMultilineEditLookupLine(MultilineEdit, FirstLine);
             YoriWinMultilineEditDeleteTextRange(MultilineEdit,
                                                 TRUE,
                                                 FALSE,
@@ -3426,7 +3814,7 @@ YoriWinMultilineEditOverwriteTextRange(
             //
 
             if (Undo->u.OverwriteText.Text.StartOfString == NULL) {
-                Line = &MultilineEdit->LineArray[FirstLine];
+                Line = YoriWinMultilineEditLookupLine(MultilineEdit, FirstLine);
                 if (!YoriLibCopyString(&Undo->u.OverwriteText.Text, Line)) {
                     return FALSE;
                 }
@@ -3504,7 +3892,7 @@ YoriWinMultilineEditOverwriteTextRange(
                 StartOffsetThisLine = FirstCharOffset;
             }
 
-            Line = &MultilineEdit->LineArray[FirstLine + LineIndex];
+            Line = YoriWinMultilineEditLookupLine(MultilineEdit, FirstLine + LineIndex);
             CharsNeeded = StartOffsetThisLine + CharsThisLine;
             if (Line->LengthAllocated < CharsNeeded) {
                 YoriLibFreeStringContents(Line);
@@ -3532,7 +3920,7 @@ YoriWinMultilineEditOverwriteTextRange(
                 Line->LengthInChars = StartOffsetThisLine + CharsThisLine;
             } else if (MoveTrailingTextToNextLine && Line->LengthInChars > StartOffsetThisLine + CharsThisLine) {
                 PYORI_STRING NextLine;
-                NextLine = &MultilineEdit->LineArray[FirstLine + LineIndex + 1];
+                NextLine = YoriWinMultilineEditLookupLine(MultilineEdit, FirstLine + LineIndex + 1);
                 ASSERT(NextLine->LengthInChars == 0);
                 CharsNeeded = Line->LengthInChars - (StartOffsetThisLine + CharsThisLine);
                 if (NextLine->LengthAllocated < CharsNeeded) {
@@ -3633,12 +4021,19 @@ YoriWinMultilineEditAppendLinesNoDataCopy(
     PYORI_WIN_CTRL_MULTILINE_EDIT MultilineEdit;
     PYORI_WIN_CTRL Ctrl;
     DWORD LinesRequired;
-    DWORD LinesDesired;
 
     Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
     MultilineEdit = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_MULTILINE_EDIT, Ctrl);
 
-    YoriWinMultilineEditClearUndo(MultilineEdit);
+    //
+    //  While lines are being loaded in the background, the user may be
+    //  editing earlier lines.  Appending doesn't move those lines, so any
+    //  undo records describing them remain valid.
+    //
+
+    if (MultilineEdit->LoadMoreCallback == NULL) {
+        YoriWinMultilineEditClearUndo(MultilineEdit);
+    }
 
     LinesRequired = MultilineEdit->LinesPopulated;
     LinesRequired = LinesRequired + NewLineCount;
@@ -3646,27 +4041,15 @@ YoriWinMultilineEditAppendLinesNoDataCopy(
         LinesRequired++;
     }
 
-    if (LinesRequired > MultilineEdit->LinesAllocated) {
-
-        LinesDesired = MultilineEdit->LinesAllocated;
-        LinesDesired = LinesDesired * 2;
-
-        if (LinesDesired < LinesRequired) {
-            LinesDesired = LinesRequired;
-            LinesDesired = LinesDesired + 0x1000;
-            LinesDesired = LinesDesired & ~(0xfff);
-        } else if (LinesDesired < 0x1000) {
-            LinesDesired = 0x1000;
-        }
-
-        if (!YoriWinMultilineEditReallocateLineArray(MultilineEdit, LinesRequired, LinesDesired)) {
-            return FALSE;
-        }
+    if (!YoriWinMultilineEditEnsureLineCapacity(MultilineEdit, LinesRequired)) {
+        return FALSE;
     }
 
+    YoriWinMultilineEditMoveGap(MultilineEdit, MultilineEdit->LinesPopulated);
     memcpy(&MultilineEdit->LineArray[MultilineEdit->LinesPopulated], NewLines, NewLineCount * sizeof(YORI_STRING));
     YoriWinMultilineEditExpandDirtyRange(MultilineEdit, MultilineEdit->LinesPopulated, MultilineEdit->LinesPopulated + NewLineCount);
     MultilineEdit->LinesPopulated = MultilineEdit->LinesPopulated + NewLineCount;
+    MultilineEdit->GapStart = MultilineEdit->LinesPopulated;
 
     YoriWinMultilineEditPaint(MultilineEdit);
     return TRUE;
@@ -3799,8 +4182,8 @@ YoriWinMultilineEditCheckSelectionState(
     } else {
         ASSERT(Selection->LastLine != Selection->FirstLine || Selection->FirstCharOffset < Selection->LastCharOffset);
     }
-    ASSERT(Selection->FirstCharOffset <= MultilineEdit->LineArray[Selection->FirstLine].LengthInChars);
-    ASSERT(Selection->LastCharOffset <= MultilineEdit->LineArray[Selection->LastLine].LengthInChars);
+    ASSERT(Selection->FirstCharOffset <= YoriWinMultilineEditLookupLine(MultilineEdit, Selection->FirstLine)->LengthInChars);
+    ASSERT(Selection->LastCharOffset <= YoriWinMultilineEditLookupLine(MultilineEdit, Selection->LastLine)->LengthInChars);
 }
 
 /**
@@ -3859,13 +4242,13 @@ YoriWinMultilineEditStartSelectionAtCursor(
         } else if (EffectiveCursorLine >= MultilineEdit->LinesPopulated) {
 
             EffectiveCursorLine = MultilineEdit->LinesPopulated - 1;
-            EffectiveCursorOffset = MultilineEdit->LineArray[EffectiveCursorLine].LengthInChars;
+            EffectiveCursorOffset = YoriWinMultilineEditLookupLine(MultilineEdit, EffectiveCursorLine)->LengthInChars;
 
         }
 
         if (EffectiveCursorLine < MultilineEdit->LinesPopulated) {
-            if (EffectiveCursorOffset > MultilineEdit->LineArray[EffectiveCursorLine].LengthInChars) {
-                EffectiveCursorOffset = MultilineEdit->LineArray[EffectiveCursorLine].LengthInChars;
+            if (EffectiveCursorOffset > YoriWinMultilineEditLookupLine(MultilineEdit, EffectiveCursorLine)->LengthInChars) {
+                EffectiveCursorOffset = YoriWinMultilineEditLookupLine(MultilineEdit, EffectiveCursorLine)->LengthInChars;
             }
         }
 
@@ -3976,11 +4359,11 @@ YoriWinMultilineEditExtendSelectionToCursor(
     EffectiveCursorOffset = MultilineEdit->CursorOffset;
     if (EffectiveCursorLine >= MultilineEdit->LinesPopulated) {
         EffectiveCursorLine = MultilineEdit->LinesPopulated - 1;
-        EffectiveCursorOffset = MultilineEdit->LineArray[EffectiveCursorLine].LengthInChars;
+        EffectiveCursorOffset = YoriWinMultilineEditLookupLine(MultilineEdit, EffectiveCursorLine)->LengthInChars;
     }
 
-    if (EffectiveCursorOffset > MultilineEdit->LineArray[EffectiveCursorLine].LengthInChars) {
-        EffectiveCursorOffset = MultilineEdit->LineArray[EffectiveCursorLine].LengthInChars;
+    if (EffectiveCursorOffset > YoriWinMultilineEditLookupLine(MultilineEdit, EffectiveCursorLine)->LengthInChars) {
+        EffectiveCursorOffset = YoriWinMultilineEditLookupLine(MultilineEdit, EffectiveCursorLine)->LengthInChars;
     }
 
     if (EffectiveCursorLine < AnchorLine) {
@@ -4278,7 +4661,7 @@ YoriWinMultilineEditPasteText(
     if (MultilineEdit->AutoIndentApplied &&
         MultilineEdit->CursorLine == MultilineEdit->AutoIndentAppliedLine) {
 
-        Line = &MultilineEdit->LineArray[MultilineEdit->CursorLine];
+        Line = YoriWinMultilineEditLookupLine(MultilineEdit, MultilineEdit->CursorLine);
 
         for (Index = 0;
              Index < Line->LengthInChars &&
@@ -4547,11 +4930,12 @@ YoriWinMultilineEditClear(
     YoriWinMultilineEditClearSelection(MultilineEdit);
 
     for (Index = 0; Index < MultilineEdit->LinesPopulated; Index++) {
-        YoriLibFreeStringContents(&MultilineEdit->LineArray[Index]);
+        YoriLibFreeStringContents(YoriWinMultilineEditLookupLine(MultilineEdit, Index));
     }
     YoriWinMultilineEditClearUndo(MultilineEdit);
 
     MultilineEdit->LinesPopulated = 0;
+    MultilineEdit->GapStart = 0;
     MultilineEdit->ViewportTop = 0;
     MultilineEdit->ViewportLeft = 0;
 
@@ -4688,7 +5072,7 @@ YoriWinMultilineEditGetLineByIndex(
         return NULL;
     }
 
-    return &MultilineEdit->LineArray[Index];
+    return YoriWinMultilineEditLookupLine(MultilineEdit, Index);
 }
 
 /**
@@ -4845,9 +5229,9 @@ YoriWinMultilineEditSetTraditionalNavigation(
     YoriWinMultilineEditClearDesiredDisplayOffset(MultilineEdit);
     if (!MultilineEdit->TraditionalEditNavigation) {
         if (MultilineEdit->CursorLine < MultilineEdit->LinesPopulated) {
-            if (MultilineEdit->CursorOffset > MultilineEdit->LineArray[MultilineEdit->CursorLine].LengthInChars) {
+            if (MultilineEdit->CursorOffset > YoriWinMultilineEditLookupLine(MultilineEdit, MultilineEdit->CursorLine)->LengthInChars) {
                 YoriWinMultilineEditSetCursorLocationInternal(MultilineEdit,
-                                                              MultilineEdit->LineArray[MultilineEdit->CursorLine].LengthInChars,
+                                                              YoriWinMultilineEditLookupLine(MultilineEdit, MultilineEdit->CursorLine)->LengthInChars,
                                                               MultilineEdit->CursorLine);
             }
         }
@@ -4971,6 +5355,60 @@ YoriWinMultilineEditSetCursorMoveNotifyCallback(
     return TRUE;
 }
 
+/**
+ Set a function to call periodically while the contents of the control are
+ being loaded.  The function is expected to append any lines that have
+ become available and return FALSE once loading is complete, at which point
+ it will no longer be invoked.
+
+ @param CtrlHandle Pointer to the multiline edit control.
+
+ @param NotifyCallback Pointer to a function to invoke to load more lines.
+        If NULL, any existing callback is cancelled.
+
+ @return TRUE to indicate the callback function was successfully updated,
+         FALSE to indicate another callback function was already present or
+         a timer could not be allocated.
+ */
+BOOLEAN
+YoriWinMultilineEditSetLoadMoreNotifyCallback(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
+    __in_opt PYORI_WIN_NOTIFY_MULTILINE_EDIT_LOAD_MORE NotifyCallback
+    )
+{
+    PYORI_WIN_CTRL Ctrl;
+    PYORI_WIN_CTRL_MULTILINE_EDIT MultilineEdit;
+    PYORI_WIN_WINDOW TopLevelWindow;
+
+    Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
+    MultilineEdit = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_MULTILINE_EDIT, Ctrl);
+
+    if (NotifyCallback == NULL) {
+        if (MultilineEdit->LoadTimer != NULL) {
+            YoriWinMgrFreeTimer(MultilineEdit->LoadTimer);
+            MultilineEdit->LoadTimer = NULL;
+        }
+        MultilineEdit->LoadMoreCallback = NULL;
+        return TRUE;
+    }
+
+    if (MultilineEdit->LoadMoreCallback != NULL) {
+        return FALSE;
+    }
+
+    TopLevelWindow = YoriWinGetTopLevelWindow(&MultilineEdit->Ctrl);
+    MultilineEdit->LoadTimer = YoriWinMgrAllocateRecurringTimer(YoriWinGetWindowManagerHandle(TopLevelWindow),
+                                                                &MultilineEdit->Ctrl,
+                                                                50);
+    if (MultilineEdit->LoadTimer == NULL) {
+        return FALSE;
+    }
+
+    MultilineEdit->LoadMoreCallback = NotifyCallback;
+
+    return TRUE;
+}
+
 //
 //  =========================================
 //  INPUT HANDLING FUNCTIONS
@@ -5007,7 +5445,7 @@ YoriWinMultilineEditBackspace(
         return YoriWinMultilineEditDeleteSelection(&MultilineEdit->Ctrl);
     }
 
-    Line = &MultilineEdit->LineArray[MultilineEdit->CursorLine];
+    Line = YoriWinMultilineEditLookupLine(MultilineEdit, MultilineEdit->CursorLine);
 
     LastLine = MultilineEdit->CursorLine;
     LastCharOffset = MultilineEdit->CursorOffset;
@@ -5040,7 +5478,7 @@ YoriWinMultilineEditBackspace(
         }
 
         FirstLine = MultilineEdit->CursorLine - 1;
-        FirstCharOffset = MultilineEdit->LineArray[FirstLine].LengthInChars;
+        FirstCharOffset = YoriWinMultilineEditLookupLine(MultilineEdit, FirstLine)->LengthInChars;
     } else {
         FirstLine = LastLine;
         FirstCharOffset = LastCharOffset - 1;
@@ -5088,7 +5526,7 @@ YoriWinMultilineEditDelete(
         return YoriWinMultilineEditDeleteSelection(&MultilineEdit->Ctrl);
     }
 
-    Line = &MultilineEdit->LineArray[MultilineEdit->CursorLine];
+    Line = YoriWinMultilineEditLookupLine(MultilineEdit, MultilineEdit->CursorLine);
 
     FirstLine = MultilineEdit->CursorLine;
     FirstCharOffset = MultilineEdit->CursorOffset;
@@ -5351,7 +5789,7 @@ YoriWinMultilineEditNotifyDoubleClick(
         //  If it's beyond the end of the line, there's nothing to select.
         //
 
-        Line = &MultilineEdit->LineArray[NewCursorLine];
+        Line = YoriWinMultilineEditLookupLine(MultilineEdit, NewCursorLine);
         if (NewCursorChar >= Line->LengthInChars) {
             return;
         }
@@ -5527,8 +5965,8 @@ YoriWinMultilineEditScrollForMouseSelect(
     if (!MultilineEdit->TraditionalEditNavigation) {
         if (MultilineEdit->LinesPopulated > 0) {
             ASSERT(NewCursorLine < MultilineEdit->LinesPopulated);
-            if (NewCursorOffset > MultilineEdit->LineArray[NewCursorLine].LengthInChars) {
-                NewCursorOffset = MultilineEdit->LineArray[NewCursorLine].LengthInChars;
+            if (NewCursorOffset > YoriWinMultilineEditLookupLine(MultilineEdit, NewCursorLine)->LengthInChars) {
+                NewCursorOffset = YoriWinMultilineEditLookupLine(MultilineEdit, NewCursorLine)->LengthInChars;
             }
         }
     }
@@ -5665,7 +6103,7 @@ YoriWinMultilineEditProcessPossiblyEnhancedKey(
             if (MultilineEdit->CursorOffset == 0) {
                 ASSERT(!MultilineEdit->TraditionalEditNavigation);
                 NewCursorLine = NewCursorLine - 1;
-                NewCursorOffset = MultilineEdit->LineArray[NewCursorLine].LengthInChars;
+                NewCursorOffset = YoriWinMultilineEditLookupLine(MultilineEdit, NewCursorLine)->LengthInChars;
                 YoriWinMultilineEditTrimAutoIndent(MultilineEdit, MultilineEdit->CursorLine, 0);
             } else {
                 NewCursorOffset = MultilineEdit->CursorOffset - 1;
@@ -5683,7 +6121,7 @@ YoriWinMultilineEditProcessPossiblyEnhancedKey(
     } else if (Event->KeyDown.VirtualKeyCode == VK_RIGHT) {
         if (MultilineEdit->TraditionalEditNavigation ||
             (MultilineEdit->CursorLine < MultilineEdit->LinesPopulated &&
-             MultilineEdit->CursorOffset < MultilineEdit->LineArray[MultilineEdit->CursorLine].LengthInChars) ||
+             MultilineEdit->CursorOffset < YoriWinMultilineEditLookupLine(MultilineEdit, MultilineEdit->CursorLine)->LengthInChars) ||
             MultilineEdit->CursorLine + 1 < MultilineEdit->LinesPopulated) {
 
             if (Event->KeyDown.CtrlMask & SHIFT_PRESSED) {
@@ -5695,7 +6133,7 @@ YoriWinMultilineEditProcessPossiblyEnhancedKey(
             NewCursorOffset = MultilineEdit->CursorOffset + 1;
             if (!MultilineEdit->TraditionalEditNavigation) {
                 if ((NewCursorLine < MultilineEdit->LinesPopulated &&
-                     NewCursorOffset > MultilineEdit->LineArray[NewCursorLine].LengthInChars)) {
+                     NewCursorOffset > YoriWinMultilineEditLookupLine(MultilineEdit, NewCursorLine)->LengthInChars)) {
 
                     NewCursorLine = NewCursorLine + 1;
                     NewCursorOffset = 0;
@@ -5737,7 +6175,7 @@ YoriWinMultilineEditProcessPossiblyEnhancedKey(
             YoriWinMultilineEditClearSelection(MultilineEdit);
         }
         if (MultilineEdit->CursorLine < MultilineEdit->LinesPopulated) {
-            FinalChar = MultilineEdit->LineArray[MultilineEdit->CursorLine].LengthInChars;
+            FinalChar = YoriWinMultilineEditLookupLine(MultilineEdit, MultilineEdit->CursorLine)->LengthInChars;
         }
         if (MultilineEdit->CursorOffset != FinalChar) {
             YoriWinMultilineEditSetCursorLocationInternal(MultilineEdit, FinalChar, MultilineEdit->CursorLine);
@@ -5907,7 +6345,7 @@ YoriWinMultilineEditProcessPossiblyEnhancedCtrlKey(
             YoriWinMultilineEditClearSelection(MultilineEdit);
         }
         if (MultilineEdit->LinesPopulated > 0) {
-            FinalChar = MultilineEdit->LineArray[MultilineEdit->LinesPopulated - 1].LengthInChars;
+            FinalChar = YoriWinMultilineEditLookupLine(MultilineEdit, MultilineEdit->LinesPopulated - 1)->LengthInChars;
             if (MultilineEdit->CursorLine != MultilineEdit->LinesPopulated - 1 ||
                 MultilineEdit->CursorOffset != FinalChar) {
 
@@ -5936,7 +6374,7 @@ YoriWinMultilineEditProcessPossiblyEnhancedCtrlKey(
                 YORI_STRING WhitespaceChars = YORILIB_CONSTANT_STRING(_T(" -\t"));
                 PYORI_STRING Line;
 
-                Line = &MultilineEdit->LineArray[ProbeLine];
+                Line = YoriWinMultilineEditLookupLine(MultilineEdit, ProbeLine);
                 Index = ProbeOffset;
                 if (Index > Line->LengthInChars) {
                     Index = Line->LengthInChars;
@@ -5948,7 +6386,7 @@ YoriWinMultilineEditProcessPossiblyEnhancedCtrlKey(
                 }
                 if (Index == 0 && ProbeLine > 0) {
                     ProbeLine--;
-                    ProbeOffset = MultilineEdit->LineArray[ProbeLine].LengthInChars;
+                    ProbeOffset = YoriWinMultilineEditLookupLine(MultilineEdit, ProbeLine)->LengthInChars;
                     continue;
                 }
                 while(Index > 0 &&
@@ -5985,7 +6423,7 @@ YoriWinMultilineEditProcessPossiblyEnhancedCtrlKey(
                 YORI_STRING WhitespaceChars = YORILIB_CONSTANT_STRING(_T(" -\t"));
                 PYORI_STRING Line;
 
-                Line = &MultilineEdit->LineArray[ProbeLine];
+                Line = YoriWinMultilineEditLookupLine(MultilineEdit, ProbeLine);
                 Index = ProbeOffset;
                 if (Index > Line->LengthInChars) {
                     Index = Line->LengthInChars;
@@ -6047,9 +6485,13 @@ YoriWinMultilineEditEventHandler(
     MultilineEdit = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_MULTILINE_EDIT, Ctrl);
     switch(Event->EventType) {
         case YoriWinEventParentDestroyed:
+            if (MultilineEdit->LoadTimer != NULL) {
+                YoriWinMgrFreeTimer(MultilineEdit->LoadTimer);
+                MultilineEdit->LoadTimer = NULL;
+            }
             YoriWinMultilineEditClearUndo(MultilineEdit);
             for (Index = 0; Index < MultilineEdit->LinesPopulated; Index++) {
-                YoriLibFreeStringContents(&MultilineEdit->LineArray[Index]);
+                YoriLibFreeStringContents(YoriWinMultilineEditLookupLine(MultilineEdit, Index));
             }
             if (MultilineEdit->LineArray != NULL) {
                 YoriLibDereference(MultilineEdit->LineArray);
@@ -6107,7 +6549,7 @@ YoriWinMultilineEditEventHandler(
                                                                   0,
                                                                   0,
                                                                   MultilineEdit->LinesPopulated - 1,
-                                                                  MultilineEdit->LineArray[MultilineEdit->LinesPopulated - 1].LengthInChars);
+                                                                  YoriWinMultilineEditLookupLine(MultilineEdit, MultilineEdit->LinesPopulated - 1)->LengthInChars);
                         }
                         return TRUE;
                     } else if (Event->KeyDown.VirtualKeyCode == 'C') {
@@ -6308,6 +6750,13 @@ YoriWinMultilineEditEventHandler(
             }
             break;
         case YoriWinEventTimer:
+            if (Event->Timer.Timer == MultilineEdit->LoadTimer) {
+                ASSERT(MultilineEdit->LoadMoreCallback != NULL);
+                if (!MultilineEdit->LoadMoreCallback(&MultilineEdit->Ctrl)) {
+                    YoriWinMultilineEditSetLoadMoreNotifyCallback(&MultilineEdit->Ctrl, NULL);
+                }
+                break;
+            }
             ASSERT(MultilineEdit->MouseButtonDown);
             ASSERT(MultilineEdit->Selection.Active == YoriWinMultilineEditSelectMouseFromTopDown ||
                    MultilineEdit->Selection.Active == YoriWinMultilineEditSelectMouseFromBottomUp);
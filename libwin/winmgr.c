@@ -3,7 +3,7 @@
  *
  * Yori manage multiple overlapping windows
  *
- * Copyright (c) 2019-2022 Malcolm J. Smith
+ * Copyright (c) 2019-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -2487,11 +2487,17 @@ YoriWinMgrProcessExpiredTimers(
             Timer = CONTAINING_RECORD(ListEntry, YORI_WIN_TIMER, ListEntry);
             ListEntry = YoriLibGetNextListEntry(&WinMgr->TimerList, ListEntry);
             if (Timer->ExpirationTime < CurrentTime) {
+
+                //
+                //  Update the timer before notifying the control, since
+                //  the control may free the timer in response.
+                //
+
+                Timer->PeriodsExpired++;
+                YoriWinMgrCalculateNextExpiration(Timer);
                 Event.EventType = YoriWinEventTimer;
                 Event.Timer.Timer = Timer;
                 Timer->NotifyCtrl->NotifyEventFn(Timer->NotifyCtrl, &Event);
-                Timer->PeriodsExpired++;
-                YoriWinMgrCalculateNextExpiration(Timer);
             }
         }
     }
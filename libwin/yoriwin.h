@@ -4,7 +4,7 @@
  * Header for control and window toolkit routines that may be of value from
  * the shell as well as external tools.
  *
- * Copyright (c) 2019-2022 Malcolm J. Smith
+ * Copyright (c) 2019-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -841,6 +841,19 @@ typedef VOID YORI_WIN_NOTIFY_MULTILINE_EDIT_CURSOR_MOVE(PYORI_WIN_CTRL_HANDLE, D
  */
 typedef YORI_WIN_NOTIFY_MULTILINE_EDIT_CURSOR_MOVE *PYORI_WIN_NOTIFY_MULTILINE_EDIT_CURSOR_MOVE;
 
+/**
+ A function prototype that can be invoked periodically to supply more lines
+ to a multiline edit control while its contents are being loaded.  Returns
+ TRUE if it should be invoked again, or FALSE once loading is complete.
+ */
+typedef BOOLEAN YORI_WIN_NOTIFY_MULTILINE_EDIT_LOAD_MORE(PYORI_WIN_CTRL_HANDLE);
+
+/**
+ A pointer to a function that can be invoked periodically to supply more
+ lines to a multiline edit control while its contents are being loaded.
+ */
+typedef YORI_WIN_NOTIFY_MULTILINE_EDIT_LOAD_MORE *PYORI_WIN_NOTIFY_MULTILINE_EDIT_LOAD_MORE;
+
 /**
  The multiline edit should display a vertical scroll bar.
  */
@@ -1031,6 +1044,12 @@ YoriWinMultilineEditSetCursorMoveNotifyCallback(
     __in PYORI_WIN_NOTIFY_MULTILINE_EDIT_CURSOR_MOVE NotifyCallback
     );
 
+BOOLEAN
+YoriWinMultilineEditSetLoadMoreNotifyCallback(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
+    __in_opt PYORI_WIN_NOTIFY_MULTILINE_EDIT_LOAD_MORE NotifyCallback
+    );
+
 BOOLEAN
 YoriWinMultilineEditIsUndoAvailable(
     __in PYORI_WIN_CTRL_HANDLE CtrlHandle
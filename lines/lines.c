@@ -3,7 +3,7 @@
  *
  * Yori shell display count of lines in files
  *
- * Copyright (c) 2017-2019 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -98,25 +98,11 @@ typedef struct _LINES_CONTEXT {
     YORI_MAX_UNSIGNED_T FilesFoundThisArg;
 
     /**
-     Records the number of lines found in a single file.
+     Records the number of lines found in a single file, and if length stats
+     are requested, the shortest, longest and total length of lines in the
+     file.
      */
-    YORI_MAX_UNSIGNED_T FileLinesFound;
-
-    /**
-     The shortest line within a single file.
-     */
-    YORI_ALLOC_SIZE_T FileShortestLine;
-
-    /**
-     The longest line within a single file.
-     */
-    YORI_ALLOC_SIZE_T FileLongestLine;
-
-    /**
-     The total number of characters within all lines in a single file, used
-     to display an average if one is requested.
-     */
-    YORI_MAX_UNSIGNED_T FileTotalChars;
+    YORI_LIB_LINE_COUNT FileLines;
 
     /**
      Records the total number of lines processed for all files.
@@ -139,42 +125,20 @@ LinesProcessStream(
     __in PLINES_CONTEXT LinesContext
     )
 {
-    PVOID LineContext = NULL;
-    YORI_STRING LineString;
-    BOOLEAN OneLineFound;
-
-    YoriLibInitEmptyString(&LineString);
-
     LinesContext->FilesFound++;
     LinesContext->FilesFoundThisArg++;
-    LinesContext->FileLinesFound = 0;
-    LinesContext->FileShortestLine = 0;
-    LinesContext->FileLongestLine = 0;
-    LinesContext->FileTotalChars = 0;
-    OneLineFound = FALSE;
 
-    while (TRUE) {
-
-        if (!YoriLibReadLineToString(&LineString, &LineContext, hSource)) {
-            break;
-        }
-
-        LinesContext->FileLinesFound++;
-        LinesContext->FileTotalChars = LinesContext->FileTotalChars + LineString.LengthInChars;
-        if (LineString.LengthInChars > LinesContext->FileLongestLine) {
-            LinesContext->FileLongestLine = LineString.LengthInChars;
-        }
+    //
+    //  Lines are counted without being converted to UTF16, and line
+    //  lengths are only calculated if they will be displayed.
+    //
 
-        if (!OneLineFound || LineString.LengthInChars < LinesContext->FileShortestLine) {
-            LinesContext->FileShortestLine = LineString.LengthInChars;
-            OneLineFound = TRUE;
-        }
+    if (!YoriLibCountLines(hSource, LinesContext->DisplayLengthStats, &LinesContext->FileLines)) {
+        ZeroMemory(&LinesContext->FileLines, sizeof(LinesContext->FileLines));
+        return FALSE;
     }
 
-    YoriLibLineReadCloseOrCache(LineContext);
-    YoriLibFreeStringContents(&LineString);
-
-    LinesContext->TotalLinesFound += LinesContext->FileLinesFound;
+    LinesContext->TotalLinesFound += LinesContext->FileLines.LineCount;
     return TRUE;
 }
 
@@ -231,28 +195,36 @@ LinesFileFoundCallback(
         }
 
         LinesContext->SavedErrorThisArg = ERROR_SUCCESS;
-        LinesProcessStream(FileHandle, LinesContext);
+        if (!LinesProcessStream(FileHandle, LinesContext)) {
+            CloseHandle(FileHandle);
+            return FALSE;
+        }
 
         if (!LinesContext->SummaryOnly) {
             YORI_STRING StringFormOfLineCount;
             YORI_STRING UnescapedFilePath;
             TCHAR StackBuffer[16];
+            YORI_MAX_UNSIGNED_T AverageLine;
 
             YoriLibInitEmptyString(&StringFormOfLineCount);
             StringFormOfLineCount.StartOfString = StackBuffer;
             StringFormOfLineCount.LengthAllocated = sizeof(StackBuffer)/sizeof(StackBuffer[0]);
-            YoriLibNumberToString(&StringFormOfLineCount, LinesContext->FileLinesFound, 10, 3, ',');
+            YoriLibNumberToString(&StringFormOfLineCount, LinesContext->FileLines.LineCount, 10, 3, ',');
             YoriLibInitEmptyString(&UnescapedFilePath);
             YoriLibUnescapePath(FilePath, &UnescapedFilePath);
             if (LinesContext->DisplayLengthStats == FALSE) {
                 YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%16y %y\n"), &StringFormOfLineCount, &UnescapedFilePath);
             } else {
+                AverageLine = 0;
+                if (LinesContext->FileLines.LineCount > 0) {
+                    AverageLine = LinesContext->FileLines.TotalChars / LinesContext->FileLines.LineCount;
+                }
                 YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
                               _T("%16y %6lli %6lli %6lli %y\n"),
                               &StringFormOfLineCount,
-                              LinesContext->FileShortestLine,
-                              LinesContext->FileTotalChars / LinesContext->FileLinesFound,
-                              LinesContext->FileLongestLine,
+                              LinesContext->FileLines.ShortestLine,
+                              AverageLine,
+                              LinesContext->FileLines.LongestLine,
                               &UnescapedFilePath);
             }
             YoriLibFreeStringContents(&StringFormOfLineCount);
@@ -375,7 +347,7 @@ ENTRYPOINT(
                 LinesHelp();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2017-2023"));
+                YoriLibDisplayMitLicense(_T("2017-2026"));
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("b")) == 0) {
                 BasicEnumeration = TRUE;
@@ -0,0 +1,384 @@
+/**
+ * @file make/artifact.c
+ *
+ * Yori shell make artifact cache
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include <yorish.h>
+#include "make.h"
+
+/**
+ The version of the fingerprint calculation.  This is included in each
+ fingerprint so that a change to the calculation does not cause outputs
+ built with the old calculation to be restored.
+ */
+#define MAKE_ARTIFACT_VERSION 1
+
+/**
+ The amount of time, in NT units, that a file system may round a file's last
+ write time down by.  FAT records write times with a two second granularity.
+ A target is only stored in the cache if its file was written after its
+ recipe started, allowing for this rounding.
+ */
+#define MAKE_ARTIFACT_TIME_GRANULARITY (2 * 10 * 1000 * 1000)
+
+/**
+ Return a hash of the contents of a target's file.  Since a target can only
+ become ready after all of its parents have been built, parent files are not
+ modified after they have been hashed, so the hash is calculated once and
+ retained on the target.  A target that is not a file, such as a directory
+ or a target that does not exist, is given a hash of zero.
+
+ @param Target Pointer to the target.
+
+ @return The hash of the contents of the target's file.
+ */
+DWORDLONG
+MakeGetTargetContentHash(
+    __in PMAKE_TARGET Target
+    )
+{
+    DWORDLONG FileSize;
+
+    if (!Target->ContentHashCalculated) {
+        if (!MakeHashFileContents(&Target->HashEntry.Key, &FileSize, &Target->ContentHash)) {
+            Target->ContentHash = 0;
+        }
+        Target->ContentHashCalculated = TRUE;
+    }
+
+    return Target->ContentHash;
+}
+
+/**
+ Calculate the fingerprint of everything that can affect the output of a
+ target.  This consists of the name of the target, the environment, the
+ expanded commands in its recipe, and the name and contents of each target
+ that it depends on.  Note that commands which refer to inline files refer
+ to a temporary file name which differs on each execution, so these targets
+ will never be found in the cache.
+
+ @param MakeContext Pointer to the context.
+
+ @param Target Pointer to the target.  On successful completion,
+        ArtifactFingerprint is updated to contain the fingerprint.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+MakeCalculateArtifactFingerprint(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PMAKE_TARGET Target
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_CMD_TO_EXEC CmdToExec;
+    PMAKE_TARGET_DEPENDENCY Dependency;
+    DWORDLONG Hash;
+    DWORDLONG ContentHash;
+    DWORD Version;
+    DWORD EnvHash;
+
+    if (!MakeGetEnvironmentHash(MakeContext, &EnvHash)) {
+        return FALSE;
+    }
+
+    Version = MAKE_ARTIFACT_VERSION;
+    Hash = MAKE_FNV1A64_OFFSET_BASIS;
+    Hash = MakeHashBytes64(Hash, &Version, sizeof(Version));
+    Hash = MakeHashBytes64(Hash, &EnvHash, sizeof(EnvHash));
+    Hash = MakeHashString64(Hash, &Target->HashEntry.Key);
+
+    ListEntry = YoriLibGetNextListEntry(&Target->ExecCmds, NULL);
+    while (ListEntry != NULL) {
+        CmdToExec = CONTAINING_RECORD(ListEntry, MAKE_CMD_TO_EXEC, ListEntry);
+        Hash = MakeHashBytes64(Hash, &CmdToExec->IgnoreErrors, sizeof(CmdToExec->IgnoreErrors));
+        Hash = MakeHashString64(Hash, &CmdToExec->Cmd);
+        ListEntry = YoriLibGetNextListEntry(&Target->ExecCmds, ListEntry);
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&Target->ParentDependents, NULL);
+    while (ListEntry != NULL) {
+        Dependency = CONTAINING_RECORD(ListEntry, MAKE_TARGET_DEPENDENCY, ChildDependents);
+        ContentHash = MakeGetTargetContentHash(Dependency->Parent);
+        Hash = MakeHashString64(Hash, &Dependency->Parent->HashEntry.Key);
+        Hash = MakeHashBytes64(Hash, &ContentHash, sizeof(ContentHash));
+        ListEntry = YoriLibGetNextListEntry(&Target->ParentDependents, ListEntry);
+    }
+
+    Target->ArtifactFingerprint = Hash;
+    return TRUE;
+}
+
+/**
+ Generate the name of the file within the artifact cache directory that
+ contains the output for a fingerprint.
+
+ @param MakeContext Pointer to the context.
+
+ @param Fingerprint The fingerprint of the target.
+
+ @param Suffix Pointer to a NULL terminated string to append to the file
+        name.  This is used to generate temporary names.
+
+ @param FileName On successful completion, updated to contain a newly
+        allocated, NULL terminated file name.  The caller is expected to
+        free this with YoriLibFreeStringContents.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+MakeGetArtifactFileName(
+    __in PMAKE_CONTEXT MakeContext,
+    __in DWORDLONG Fingerprint,
+    __in LPCTSTR Suffix,
+    __out PYORI_STRING FileName
+    )
+{
+    YoriLibInitEmptyString(FileName);
+    if (YoriLibYPrintf(FileName, _T("%y\\%016llx%s"), &MakeContext->ArtifactCacheDir, Fingerprint, Suffix) < 0) {
+        YoriLibFreeStringContents(FileName);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Query the last write time of a file.
+
+ @param FileName Pointer to a NULL terminated file name.
+
+ @param LastWriteTime On successful completion, updated to contain the last
+        write time of the file.
+
+ @return TRUE to indicate the file exists and is not a directory, FALSE if
+         it does not exist, is a directory, or could not be queried.
+ */
+__success(return)
+BOOLEAN
+MakeGetArtifactWriteTime(
+    __in PCYORI_STRING FileName,
+    __out PLARGE_INTEGER LastWriteTime
+    )
+{
+    HANDLE FileHandle;
+    BY_HANDLE_FILE_INFORMATION FileInfo;
+    BOOL Result;
+
+    ASSERT(YoriLibIsStringNullTerminated(FileName));
+
+    FileHandle = CreateFile(FileName->StartOfString, FILE_READ_ATTRIBUTES | FILE_READ_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL);
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    Result = GetFileInformationByHandle(FileHandle, &FileInfo);
+    CloseHandle(FileHandle);
+
+    if (!Result || (FileInfo.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+        return FALSE;
+    }
+
+    LastWriteTime->HighPart = FileInfo.ftLastWriteTime.dwHighDateTime;
+    LastWriteTime->LowPart = FileInfo.ftLastWriteTime.dwLowDateTime;
+    return TRUE;
+}
+
+/**
+ Update the last write time of a file to the current time.  A file copied
+ from the cache retains the time it was originally written, which may be
+ older than the targets it depends on, so without this the target would be
+ considered out of date by the next build.
+
+ @param FileName Pointer to a NULL terminated file name.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+MakeTouchArtifact(
+    __in PCYORI_STRING FileName
+    )
+{
+    HANDLE FileHandle;
+    LARGE_INTEGER CurrentTime;
+    FILETIME WriteTime;
+    BOOL Result;
+
+    ASSERT(YoriLibIsStringNullTerminated(FileName));
+
+    FileHandle = CreateFile(FileName->StartOfString, FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL);
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    CurrentTime.QuadPart = YoriLibGetSystemTimeAsInteger();
+    WriteTime.dwHighDateTime = CurrentTime.HighPart;
+    WriteTime.dwLowDateTime = CurrentTime.LowPart;
+
+    Result = SetFileTime(FileHandle, NULL, NULL, &WriteTime);
+    CloseHandle(FileHandle);
+
+    if (!Result) {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ Check whether the output of a target that is ready to build can be restored
+ from the artifact cache rather than executing its recipe.  The fingerprint
+ of the target is calculated here, after all of its parents have been built
+ and before its recipe executes, and retained so that the output can be
+ added to the cache once the recipe completes.
+
+ Rebuilding was decided by timestamps, so this is where a target whose
+ inputs were touched but whose contents did not change is detected: the
+ fingerprint matches the one its output was stored under by a previous
+ build, and that output is restored without executing any commands.
+
+ @param MakeContext Pointer to the context.
+
+ @param Target Pointer to the target which is ready to build.
+
+ @return TRUE to indicate the target's output was restored and the target is
+         complete, FALSE to indicate the recipe should be executed.
+ */
+__success(return)
+BOOLEAN
+MakeRestoreTargetArtifact(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PMAKE_TARGET Target
+    )
+{
+    YORI_STRING CacheFileName;
+
+    if (MakeContext->ArtifactCacheDir.LengthInChars == 0 ||
+        Target->ArtifactLookupAttempted) {
+
+        return FALSE;
+    }
+
+    Target->ArtifactLookupAttempted = TRUE;
+    Target->ArtifactStartTime = YoriLibGetSystemTimeAsInteger();
+
+    if (!MakeCalculateArtifactFingerprint(MakeContext, Target)) {
+        return FALSE;
+    }
+
+    Target->ArtifactFingerprintValid = TRUE;
+
+    if (!MakeGetArtifactFileName(MakeContext, Target->ArtifactFingerprint, _T(""), &CacheFileName)) {
+        return FALSE;
+    }
+
+    if (YoriLibCopyFile(&CacheFileName, &Target->HashEntry.Key) != ERROR_SUCCESS) {
+        YoriLibFreeStringContents(&CacheFileName);
+        MakeContext->ArtifactCacheMisses++;
+        return FALSE;
+    }
+
+    YoriLibFreeStringContents(&CacheFileName);
+
+    //
+    //  If the time can't be updated, the output is still correct, so this
+    //  build can continue.  The next build will find the same fingerprint
+    //  and restore it again.
+    //
+
+    MakeTouchArtifact(&Target->HashEntry.Key);
+
+    MakeContext->ArtifactCacheHits++;
+    if (!MakeContext->SilentCommandLaunching) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Restored from artifact cache: %y\n"), &Target->HashEntry.Key);
+    }
+
+    return TRUE;
+}
+
+/**
+ After a target's recipe has completed successfully, add its output to the
+ artifact cache so that a later build with the same fingerprint can restore
+ it.  Only the target's own file is stored; targets which are not files,
+ such as pseudo targets or directories, are not stored.  A target whose
+ file was not written by its recipe is not stored either, since the file
+ may be left over from a build with different inputs.
+
+ The output is copied to a temporary name and renamed into place so that
+ another build sharing the cache never observes a partially written file.
+
+ @param MakeContext Pointer to the context.
+
+ @param Target Pointer to the target whose recipe has completed.
+ */
+VOID
+MakeStoreTargetArtifact(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PMAKE_TARGET Target
+    )
+{
+    YORI_STRING CacheFileName;
+    YORI_STRING TempFileName;
+    LARGE_INTEGER LastWriteTime;
+    TCHAR Suffix[32];
+
+    if (!Target->ArtifactFingerprintValid) {
+        return;
+    }
+
+    if (!MakeGetArtifactWriteTime(&Target->HashEntry.Key, &LastWriteTime)) {
+        return;
+    }
+
+    if (LastWriteTime.QuadPart + MAKE_ARTIFACT_TIME_GRANULARITY < Target->ArtifactStartTime) {
+        return;
+    }
+
+    if (!MakeGetArtifactFileName(MakeContext, Target->ArtifactFingerprint, _T(""), &CacheFileName)) {
+        return;
+    }
+
+    YoriLibSPrintf(Suffix, _T(".%x.tmp"), GetCurrentProcessId());
+    if (!MakeGetArtifactFileName(MakeContext, Target->ArtifactFingerprint, Suffix, &TempFileName)) {
+        YoriLibFreeStringContents(&CacheFileName);
+        return;
+    }
+
+    if (YoriLibCopyFile(&Target->HashEntry.Key, &TempFileName) == ERROR_SUCCESS) {
+        if (MoveFileEx(TempFileName.StartOfString, CacheFileName.StartOfString, MOVEFILE_REPLACE_EXISTING)) {
+            MakeContext->ArtifactCacheStores++;
+        } else {
+            DeleteFile(TempFileName.StartOfString);
+        }
+    }
+
+    YoriLibFreeStringContents(&TempFileName);
+    YoriLibFreeStringContents(&CacheFileName);
+}
+
+// vim:sw=4:ts=4:et:
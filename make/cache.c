@@ -0,0 +1,1753 @@
+/**
+ * @file make/cache.c
+ *
+ * Yori shell make file probe and dependency graph caches
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include <yorish.h>
+#include "make.h"
+
+/**
+ The signature at the start of a dependency graph cache file.
+ */
+#define MAKE_GRAPH_CACHE_SIGNATURE 0x31434759
+
+/**
+ The version of the dependency graph cache file format.  Files with a
+ different version are ignored.
+ */
+#define MAKE_GRAPH_CACHE_VERSION 1
+
+/**
+ A scope or target index indicating that no scope or target is present.
+ */
+#define MAKE_GRAPH_CACHE_NO_INDEX ((DWORD)-1)
+
+/**
+ A flag for a target in the dependency graph cache indicating that the
+ target has a recipe, either explicitly or via an inference rule.
+ */
+#define MAKE_GRAPH_CACHE_TARGET_BUILDABLE 0x00000001
+
+/**
+ The initial size of the buffer used to generate the dependency graph
+ cache.  This grows as needed.
+ */
+#define MAKE_GRAPH_CACHE_INITIAL_BUFFER (64 * 1024)
+
+/**
+ The size of each read when hashing the contents of a file.
+ */
+#define MAKE_GRAPH_CACHE_READ_SIZE (64 * 1024)
+
+/**
+ A buffer used to generate or parse a dependency graph cache file.
+ */
+typedef struct _MAKE_GRAPH_CACHE_BUFFER {
+
+    /**
+     The buffer.  When parsing, this is a referenced allocation so strings
+     within it can be retained by targets.
+     */
+    PUCHAR Buffer;
+
+    /**
+     The number of bytes in the buffer.  When parsing, this is the size of
+     the file.
+     */
+    DWORD BytesAllocated;
+
+    /**
+     The offset of the next byte to write or read.
+     */
+    DWORD Offset;
+
+    /**
+     TRUE if an allocation failed while generating the buffer, so its
+     contents are incomplete.
+     */
+    BOOLEAN Failed;
+
+} MAKE_GRAPH_CACHE_BUFFER, *PMAKE_GRAPH_CACHE_BUFFER;
+
+/**
+ Update a 64 bit FNV-1a hash with a range of bytes.
+
+ @param Hash The hash of any previous bytes.
+
+ @param Buffer Pointer to the bytes to include in the hash.
+
+ @param Length The number of bytes to include in the hash.
+
+ @return The updated hash.
+ */
+DWORDLONG
+MakeHashBytes64(
+    __in DWORDLONG Hash,
+    __in PVOID Buffer,
+    __in DWORD Length
+    )
+{
+    PUCHAR Bytes;
+    DWORD Index;
+
+    Bytes = (PUCHAR)Buffer;
+    for (Index = 0; Index < Length; Index++) {
+        Hash = Hash ^ Bytes[Index];
+        Hash = Hash * MAKE_FNV1A64_PRIME;
+    }
+
+    return Hash;
+}
+
+/**
+ Update a 64 bit FNV-1a hash with a string, followed by a NULL terminator so
+ that adjacent strings cannot be confused for each other.
+
+ @param Hash The hash of any previous strings.
+
+ @param String Pointer to the string to include in the hash.
+
+ @return The updated hash.
+ */
+DWORDLONG
+MakeHashString64(
+    __in DWORDLONG Hash,
+    __in PCYORI_STRING String
+    )
+{
+    TCHAR Terminator;
+
+    Terminator = '\0';
+    Hash = MakeHashBytes64(Hash, String->StartOfString, String->LengthInChars * sizeof(TCHAR));
+    Hash = MakeHashBytes64(Hash, &Terminator, sizeof(Terminator));
+    return Hash;
+}
+
+/**
+ Read a file and calculate its size and a hash of its contents.
+
+ @param FileName Pointer to a NULL terminated file name.
+
+ @param FileSize On successful completion, updated to contain the size of
+        the file.
+
+ @param ContentHash On successful completion, updated to contain a hash of
+        the contents of the file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+MakeHashFileContents(
+    __in PCYORI_STRING FileName,
+    __out PDWORDLONG FileSize,
+    __out PDWORDLONG ContentHash
+    )
+{
+    HANDLE hFile;
+    PUCHAR Buffer;
+    DWORD BytesRead;
+    DWORDLONG Hash;
+    DWORDLONG Size;
+    BOOLEAN Result;
+
+    ASSERT(YoriLibIsStringNullTerminated(FileName));
+
+    hFile = CreateFile(FileName->StartOfString, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    Buffer = YoriLibMalloc(MAKE_GRAPH_CACHE_READ_SIZE);
+    if (Buffer == NULL) {
+        CloseHandle(hFile);
+        return FALSE;
+    }
+
+    Hash = MAKE_FNV1A64_OFFSET_BASIS;
+    Size = 0;
+    Result = FALSE;
+
+    while (TRUE) {
+        if (!ReadFile(hFile, Buffer, MAKE_GRAPH_CACHE_READ_SIZE, &BytesRead, NULL)) {
+            break;
+        }
+
+        if (BytesRead == 0) {
+            Result = TRUE;
+            break;
+        }
+
+        Hash = MakeHashBytes64(Hash, Buffer, BytesRead);
+        Size = Size + BytesRead;
+    }
+
+    YoriLibFree(Buffer);
+    CloseHandle(hFile);
+
+    if (Result) {
+        *FileSize = Size;
+        *ContentHash = Hash;
+    }
+
+    return Result;
+}
+
+/**
+ Allocate a probe cache entry and insert it into the directory or file hash
+ table.  The name of the entry is stored in the same allocation.
+
+ @param MakeContext Pointer to the context.
+
+ @param DirName Pointer to the directory name.
+
+ @param FileName Optionally points to a NULL terminated file name within the
+        directory.  If not specified, the entry describes the directory
+        itself.
+
+ @return Pointer to the entry, or NULL on allocation failure.
+ */
+PMAKE_PROBE_CACHE_ENTRY
+MakeAllocateProbeCacheEntry(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PCYORI_STRING DirName,
+    __in_opt LPCTSTR FileName
+    )
+{
+    PMAKE_PROBE_CACHE_ENTRY Entry;
+    PYORI_OPEN_HASH_TABLE HashTable;
+    YORI_STRING Key;
+    YORI_ALLOC_SIZE_T FileNameLength;
+    YORI_ALLOC_SIZE_T CharsNeeded;
+
+    FileNameLength = 0;
+    CharsNeeded = DirName->LengthInChars + 1;
+    HashTable = MakeContext->ProbeDirectories;
+    if (FileName != NULL) {
+        FileNameLength = (YORI_ALLOC_SIZE_T)_tcslen(FileName);
+        CharsNeeded = CharsNeeded + 1 + FileNameLength;
+        HashTable = MakeContext->ProbeFiles;
+    }
+
+    Entry = YoriLibReferencedMalloc(sizeof(MAKE_PROBE_CACHE_ENTRY) + CharsNeeded * sizeof(TCHAR));
+    if (Entry == NULL) {
+        return NULL;
+    }
+
+    //
+    //  The hash table will reference the allocation containing the key, so
+    //  the entry is freed when it is removed from the hash table and
+    //  dereferenced by the list.
+    //
+
+    YoriLibInitEmptyString(&Key);
+    Key.StartOfString = (LPTSTR)(Entry + 1);
+    Key.LengthAllocated = CharsNeeded;
+    Key.MemoryToFree = Entry;
+    memcpy(Key.StartOfString, DirName->StartOfString, DirName->LengthInChars * sizeof(TCHAR));
+    Key.LengthInChars = DirName->LengthInChars;
+    if (FileName != NULL) {
+        Key.StartOfString[Key.LengthInChars] = '\\';
+        memcpy(&Key.StartOfString[Key.LengthInChars + 1], FileName, FileNameLength * sizeof(TCHAR));
+        Key.LengthInChars = Key.LengthInChars + 1 + FileNameLength;
+    }
+    Key.StartOfString[Key.LengthInChars] = '\0';
+
+    Entry->FileAttributes = 0;
+    Entry->LastWriteTime.QuadPart = 0;
+    Entry->EnumeratedDirectory = (BOOLEAN)(FileName == NULL);
+
+    if (!YoriLibOpenHashInsertByKey(HashTable, &Key, Entry, &Entry->HashEntry)) {
+        YoriLibDereference(Entry);
+        return NULL;
+    }
+
+    YoriLibAppendList(&MakeContext->ProbeCacheList, &Entry->ListEntry);
+    return Entry;
+}
+
+/**
+ Discard all probe cache entries.  This is used when files may have been
+ created or deleted, so previous enumerations are no longer accurate.
+
+ @param MakeContext Pointer to the context.
+ */
+VOID
+MakeInvalidateProbeCache(
+    __in PMAKE_CONTEXT MakeContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_PROBE_CACHE_ENTRY Entry;
+
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->ProbeCacheList, NULL);
+    while (ListEntry != NULL) {
+        Entry = CONTAINING_RECORD(ListEntry, MAKE_PROBE_CACHE_ENTRY, ListEntry);
+        YoriLibRemoveListItem(&Entry->ListEntry);
+        if (Entry->EnumeratedDirectory) {
+            YoriLibOpenHashRemoveByEntry(MakeContext->ProbeDirectories, &Entry->HashEntry);
+        } else {
+            YoriLibOpenHashRemoveByEntry(MakeContext->ProbeFiles, &Entry->HashEntry);
+        }
+        YoriLibDereference(Entry);
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->ProbeCacheList, NULL);
+    }
+}
+
+/**
+ Discard all probe cache entries and the hash tables used to find them.
+
+ @param MakeContext Pointer to the context.
+ */
+VOID
+MakeDeleteProbeCache(
+    __in PMAKE_CONTEXT MakeContext
+    )
+{
+    MakeInvalidateProbeCache(MakeContext);
+
+    if (MakeContext->ProbeDirectories != NULL) {
+        YoriLibFreeEmptyOpenHashTable(MakeContext->ProbeDirectories);
+        MakeContext->ProbeDirectories = NULL;
+    }
+
+    if (MakeContext->ProbeFiles != NULL) {
+        YoriLibFreeEmptyOpenHashTable(MakeContext->ProbeFiles);
+        MakeContext->ProbeFiles = NULL;
+    }
+}
+
+/**
+ Enumerate a directory and add an entry to the probe cache for every file
+ within it.
+
+ @param MakeContext Pointer to the context.
+
+ @param DirName Pointer to the directory to enumerate.
+
+ @return Pointer to the entry describing the directory, or NULL on
+         allocation failure.
+ */
+PMAKE_PROBE_CACHE_ENTRY
+MakeEnumerateProbeDirectory(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PCYORI_STRING DirName
+    )
+{
+    PMAKE_PROBE_CACHE_ENTRY DirEntry;
+    PMAKE_PROBE_CACHE_ENTRY FileEntry;
+    YORI_STRING SearchPath;
+    WIN32_FIND_DATA FindData;
+    HANDLE hFind;
+    DWORD Err;
+
+    DirEntry = MakeAllocateProbeCacheEntry(MakeContext, DirName, NULL);
+    if (DirEntry == NULL) {
+        return NULL;
+    }
+
+    MakeContext->ProbeDirectoriesEnumerated++;
+
+    //
+    //  Until enumeration completes, files in this directory need to be
+    //  queried individually.
+    //
+
+    DirEntry->FileAttributes = 0;
+
+    if (!YoriLibAllocateString(&SearchPath, DirName->LengthInChars + sizeof("\\*"))) {
+        return DirEntry;
+    }
+
+    SearchPath.LengthInChars = YoriLibSPrintf(SearchPath.StartOfString, _T("%y\\*"), DirName);
+    hFind = FindFirstFile(SearchPath.StartOfString, &FindData);
+    YoriLibFreeStringContents(&SearchPath);
+
+    if (hFind == INVALID_HANDLE_VALUE) {
+        Err = GetLastError();
+        if (Err == ERROR_FILE_NOT_FOUND) {
+            DirEntry->FileAttributes = FILE_ATTRIBUTE_DIRECTORY;
+        } else if (Err == ERROR_PATH_NOT_FOUND) {
+            DirEntry->FileAttributes = (DWORD)-1;
+        }
+        return DirEntry;
+    }
+
+    do {
+        if (FindData.cFileName[0] == '.' &&
+            (FindData.cFileName[1] == '\0' ||
+             (FindData.cFileName[1] == '.' && FindData.cFileName[2] == '\0'))) {
+
+            continue;
+        }
+
+        FileEntry = MakeAllocateProbeCacheEntry(MakeContext, DirName, FindData.cFileName);
+        if (FileEntry == NULL) {
+            FindClose(hFind);
+            return DirEntry;
+        }
+
+        FileEntry->FileAttributes = FindData.dwFileAttributes;
+        FileEntry->LastWriteTime.LowPart = FindData.ftLastWriteTime.dwLowDateTime;
+        FileEntry->LastWriteTime.HighPart = FindData.ftLastWriteTime.dwHighDateTime;
+
+    } while (FindNextFile(hFind, &FindData));
+
+    Err = GetLastError();
+    FindClose(hFind);
+
+    if (Err == ERROR_NO_MORE_FILES) {
+        DirEntry->FileAttributes = FILE_ATTRIBUTE_DIRECTORY;
+    }
+
+    return DirEntry;
+}
+
+/**
+ Attempt to find the attributes and last write time of a file from an
+ enumeration of its parent directory.  If the parent directory has not been
+ enumerated yet, it is enumerated now, on the basis that makefiles tend to
+ refer to many files in the same directory.
+
+ @param MakeContext Pointer to the context.
+
+ @param FullPath Pointer to the fully qualified path to the file.
+
+ @param FileAttributes On successful completion, updated to contain the
+        attributes of the file, or (DWORD)-1 if the file does not exist.
+
+ @param LastWriteTime On successful completion, updated to contain the last
+        write time of the file.
+
+ @return TRUE if the cache could describe the file, FALSE if the caller needs
+         to query the file directly.
+ */
+__success(return)
+BOOLEAN
+MakeLookupProbeCache(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PCYORI_STRING FullPath,
+    __out PDWORD FileAttributes,
+    __out PLARGE_INTEGER LastWriteTime
+    )
+{
+    YORI_STRING DirName;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T SepIndex;
+    PYORI_OPEN_HASH_ENTRY HashEntry;
+    PMAKE_PROBE_CACHE_ENTRY DirEntry;
+    PMAKE_PROBE_CACHE_ENTRY FileEntry;
+
+    if (MakeContext->ProbeDirectories == NULL ||
+        MakeContext->ProbeFiles == NULL) {
+
+        return FALSE;
+    }
+
+    //
+    //  Preprocessor commands launched early may be creating or deleting
+    //  files, so neither use nor populate the cache until they complete.
+    //
+
+    if (MakeContext->SpeculationsOutstanding > 0) {
+        return FALSE;
+    }
+
+    for (SepIndex = FullPath->LengthInChars; SepIndex > 0; SepIndex--) {
+        if (YoriLibIsSep(FullPath->StartOfString[SepIndex - 1])) {
+            break;
+        }
+    }
+
+    if (SepIndex <= 1 || SepIndex == FullPath->LengthInChars) {
+        return FALSE;
+    }
+
+    //
+    //  Enumeration returns long file names, so a short name can't be found
+    //  in the cache.  Wildcards can't be evaluated by the cache either.
+    //
+
+    for (Index = SepIndex; Index < FullPath->LengthInChars; Index++) {
+        if (FullPath->StartOfString[Index] == '~' ||
+            FullPath->StartOfString[Index] == '*' ||
+            FullPath->StartOfString[Index] == '?') {
+
+            return FALSE;
+        }
+    }
+
+    YoriLibInitEmptyString(&DirName);
+    DirName.StartOfString = FullPath->StartOfString;
+    DirName.LengthInChars = SepIndex - 1;
+
+    HashEntry = YoriLibOpenHashLookupByKey(MakeContext->ProbeDirectories, &DirName);
+    if (HashEntry != NULL) {
+        DirEntry = HashEntry->Context;
+    } else {
+        DirEntry = MakeEnumerateProbeDirectory(MakeContext, &DirName);
+        if (DirEntry == NULL) {
+            return FALSE;
+        }
+    }
+
+    if (DirEntry->FileAttributes == 0) {
+        return FALSE;
+    }
+
+    if (DirEntry->FileAttributes == (DWORD)-1) {
+        MakeContext->ProbesFromCache++;
+        *FileAttributes = (DWORD)-1;
+        LastWriteTime->QuadPart = 0;
+        return TRUE;
+    }
+
+    HashEntry = YoriLibOpenHashLookupByKey(MakeContext->ProbeFiles, FullPath);
+    if (HashEntry == NULL) {
+        MakeContext->ProbesFromCache++;
+        *FileAttributes = (DWORD)-1;
+        LastWriteTime->QuadPart = 0;
+        return TRUE;
+    }
+
+    //
+    //  Enumeration describes a link, not the object it refers to, so these
+    //  need to be opened.
+    //
+
+    FileEntry = HashEntry->Context;
+    if (FileEntry->FileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) {
+        return FALSE;
+    }
+
+    MakeContext->ProbesFromCache++;
+    *FileAttributes = FileEntry->FileAttributes;
+    LastWriteTime->QuadPart = FileEntry->LastWriteTime.QuadPart;
+    return TRUE;
+}
+
+/**
+ Check whether a file exists, without recording the result as an input to
+ the dependency graph.
+
+ @param MakeContext Pointer to the context.
+
+ @param FileName Pointer to the NULL terminated file name.
+
+ @return TRUE if the file exists, FALSE if it does not.
+ */
+BOOLEAN
+MakeQueryFileExists(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PCYORI_STRING FileName
+    )
+{
+    DWORD FileAttributes;
+    LARGE_INTEGER LastWriteTime;
+
+    if (!MakeLookupProbeCache(MakeContext, FileName, &FileAttributes, &LastWriteTime)) {
+        MakeContext->ProbesDirect++;
+        ASSERT(YoriLibIsStringNullTerminated(FileName));
+        FileAttributes = GetFileAttributes(FileName->StartOfString);
+    }
+
+    if (FileAttributes == (DWORD)-1) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Discard all recorded inputs to the dependency graph.  This also disables
+ saving the dependency graph, which is done if the inputs cannot be
+ recorded accurately.
+
+ @param MakeContext Pointer to the context.
+ */
+VOID
+MakeDeleteGraphCacheInputs(
+    __in PMAKE_CONTEXT MakeContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_GRAPH_CACHE_INPUT Input;
+
+    if (MakeContext->GraphCacheInputs == NULL) {
+        return;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->GraphCacheInputList, NULL);
+    while (ListEntry != NULL) {
+        Input = CONTAINING_RECORD(ListEntry, MAKE_GRAPH_CACHE_INPUT, ListEntry);
+        YoriLibRemoveListItem(&Input->ListEntry);
+        YoriLibOpenHashRemoveByEntry(MakeContext->GraphCacheInputs, &Input->HashEntry);
+        YoriLibDereference(Input);
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->GraphCacheInputList, NULL);
+    }
+
+    YoriLibFreeEmptyOpenHashTable(MakeContext->GraphCacheInputs);
+    MakeContext->GraphCacheInputs = NULL;
+}
+
+/**
+ Allocate a record of an input to the dependency graph.  The file name is
+ stored in the same allocation.
+
+ @param MakeContext Pointer to the context.
+
+ @param FileName Pointer to the file name.
+
+ @param InputType Indicates how the file was used.
+
+ @return Pointer to the input, or NULL on allocation failure.
+ */
+PMAKE_GRAPH_CACHE_INPUT
+MakeAllocateGraphCacheInput(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PCYORI_STRING FileName,
+    __in MAKE_GRAPH_CACHE_INPUT_TYPE InputType
+    )
+{
+    PMAKE_GRAPH_CACHE_INPUT Input;
+    YORI_STRING Key;
+
+    Input = YoriLibReferencedMalloc(sizeof(MAKE_GRAPH_CACHE_INPUT) + (FileName->LengthInChars + 1) * sizeof(TCHAR));
+    if (Input == NULL) {
+        return NULL;
+    }
+
+    YoriLibInitEmptyString(&Key);
+    Key.StartOfString = (LPTSTR)(Input + 1);
+    Key.LengthAllocated = FileName->LengthInChars + 1;
+    Key.LengthInChars = FileName->LengthInChars;
+    Key.MemoryToFree = Input;
+    memcpy(Key.StartOfString, FileName->StartOfString, FileName->LengthInChars * sizeof(TCHAR));
+    Key.StartOfString[Key.LengthInChars] = '\0';
+
+    Input->InputType = InputType;
+    Input->FileSize = 0;
+    Input->ContentHash = 0;
+
+    if (!YoriLibOpenHashInsertByKey(MakeContext->GraphCacheInputs, &Key, Input, &Input->HashEntry)) {
+        YoriLibDereference(Input);
+        return NULL;
+    }
+
+    YoriLibAppendList(&MakeContext->GraphCacheInputList, &Input->ListEntry);
+    return Input;
+}
+
+/**
+ Record that the contents of a file, such as a makefile, were used to
+ construct the dependency graph.  If the contents change, the dependency
+ graph cache cannot be used.
+
+ @param MakeContext Pointer to the context.
+
+ @param FileName Pointer to the file name.
+ */
+VOID
+MakeRecordGraphCacheFile(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING FileName
+    )
+{
+    PYORI_OPEN_HASH_ENTRY HashEntry;
+    PMAKE_GRAPH_CACHE_INPUT Input;
+
+    if (MakeContext->GraphCacheInputs == NULL || MakeContext->GraphCacheHit) {
+        return;
+    }
+
+    //
+    //  If the file was previously checked for existence, the hash of its
+    //  contents supersedes that check.
+    //
+
+    HashEntry = YoriLibOpenHashLookupByKey(MakeContext->GraphCacheInputs, FileName);
+    if (HashEntry != NULL) {
+        Input = HashEntry->Context;
+        if (Input->InputType == MakeGraphCacheInputFileContents) {
+            return;
+        }
+    } else {
+        Input = MakeAllocateGraphCacheInput(MakeContext, FileName, MakeGraphCacheInputFileContents);
+        if (Input == NULL) {
+            MakeDeleteGraphCacheInputs(MakeContext);
+            return;
+        }
+    }
+
+    if (!MakeHashFileContents(&Input->HashEntry.Key, &Input->FileSize, &Input->ContentHash)) {
+        MakeDeleteGraphCacheInputs(MakeContext);
+        return;
+    }
+
+    Input->InputType = MakeGraphCacheInputFileContents;
+}
+
+/**
+ Check whether a file exists.  This is used when the existence of the file
+ changes the dependency graph, such as when searching for a makefile or the
+ source file of an inference rule, so the result is recorded as an input to
+ the dependency graph.
+
+ @param MakeContext Pointer to the context.
+
+ @param FileName Pointer to the NULL terminated file name.
+
+ @return TRUE if the file exists, FALSE if it does not.
+ */
+BOOLEAN
+MakeProbeFileExists(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING FileName
+    )
+{
+    BOOLEAN FileExists;
+    MAKE_GRAPH_CACHE_INPUT_TYPE InputType;
+
+    FileExists = MakeQueryFileExists(MakeContext, FileName);
+
+    if (MakeContext->GraphCacheInputs != NULL &&
+        !MakeContext->GraphCacheHit &&
+        YoriLibOpenHashLookupByKey(MakeContext->GraphCacheInputs, FileName) == NULL) {
+
+        InputType = MakeGraphCacheInputFileMissing;
+        if (FileExists) {
+            InputType = MakeGraphCacheInputFileExists;
+        }
+
+        if (MakeAllocateGraphCacheInput(MakeContext, FileName, InputType) == NULL) {
+            MakeDeleteGraphCacheInputs(MakeContext);
+        }
+    }
+
+    return FileExists;
+}
+
+/**
+ Calculate a hash of everything outside of the file system which could
+ change the dependency graph.  This includes the command line arguments,
+ since they can define variables and targets, as well as the current
+ directory, makefile name, and program version.
+
+ @param MakeContext Pointer to the context.
+
+ @param ArgC The number of arguments.
+
+ @param ArgV An array of arguments.
+
+ @param MakeFileName Pointer to the fully qualified makefile name.
+ */
+VOID
+MakeCalculateGraphCacheArgsHash(
+    __in PMAKE_CONTEXT MakeContext,
+    __in YORI_ALLOC_SIZE_T ArgC,
+    __in YORI_STRING ArgV[],
+    __in PYORI_STRING MakeFileName
+    )
+{
+    DWORDLONG Hash;
+    DWORD Version;
+    YORI_ALLOC_SIZE_T Index;
+
+    Hash = MAKE_FNV1A64_OFFSET_BASIS;
+    Version = (YORI_VER_MAJOR << 16) | YORI_VER_MINOR;
+    Hash = MakeHashBytes64(Hash, &Version, sizeof(Version));
+
+    for (Index = 0; Index < ArgC; Index++) {
+        Hash = MakeHashString64(Hash, &ArgV[Index]);
+    }
+
+    Hash = MakeHashString64(Hash, &MakeContext->ProcessCurrentDirectory);
+    Hash = MakeHashString64(Hash, MakeFileName);
+
+    MakeContext->GraphCacheArgsHash = Hash;
+}
+
+/**
+ Generate the name of the dependency graph cache file from the name of the
+ makefile.
+
+ @param MakeFileName Pointer to the name of the makefile.
+
+ @param CacheFileName On successful completion, updated to contain a newly
+        allocated string referring to the file name of the cache file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+MakeGetGraphCacheFileName(
+    __in PYORI_STRING MakeFileName,
+    __out PYORI_STRING CacheFileName
+    )
+{
+    YoriLibInitEmptyString(CacheFileName);
+    if (MakeFileName->LengthInChars > 0) {
+        if (YoriLibAllocateString(CacheFileName, MakeFileName->LengthInChars + sizeof(".ygc"))) {
+            CacheFileName->LengthInChars = YoriLibSPrintf(CacheFileName->StartOfString, _T("%y.ygc"), MakeFileName);
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Append data to a buffer, reallocating it if needed.
+
+ @param Buffer Pointer to the buffer.
+
+ @param Data Pointer to the data to append.
+
+ @param Length The number of bytes to append.
+ */
+VOID
+MakeGraphCacheWrite(
+    __inout PMAKE_GRAPH_CACHE_BUFFER Buffer,
+    __in PVOID Data,
+    __in DWORD Length
+    )
+{
+    PUCHAR NewBuffer;
+    YORI_MAX_UNSIGNED_T NewSize;
+    YORI_MAX_UNSIGNED_T SizeNeeded;
+
+    if (Buffer->Failed) {
+        return;
+    }
+
+    SizeNeeded = (YORI_MAX_UNSIGNED_T)Buffer->Offset + Length;
+    if (SizeNeeded > Buffer->BytesAllocated) {
+        NewSize = Buffer->BytesAllocated;
+        while (NewSize < SizeNeeded) {
+            NewSize = NewSize * 2;
+        }
+
+        if (!YoriLibIsSizeAllocatable(NewSize)) {
+            Buffer->Failed = TRUE;
+            return;
+        }
+
+        NewBuffer = YoriLibMalloc((YORI_ALLOC_SIZE_T)NewSize);
+        if (NewBuffer == NULL) {
+            Buffer->Failed = TRUE;
+            return;
+        }
+
+        memcpy(NewBuffer, Buffer->Buffer, Buffer->Offset);
+        YoriLibFree(Buffer->Buffer);
+        Buffer->Buffer = NewBuffer;
+        Buffer->BytesAllocated = (DWORD)NewSize;
+    }
+
+    memcpy(&Buffer->Buffer[Buffer->Offset], Data, Length);
+    Buffer->Offset = Buffer->Offset + Length;
+}
+
+/**
+ Append a 32 bit value to a buffer.
+
+ @param Buffer Pointer to the buffer.
+
+ @param Value The value to append.
+ */
+VOID
+MakeGraphCacheWriteDword(
+    __inout PMAKE_GRAPH_CACHE_BUFFER Buffer,
+    __in DWORD Value
+    )
+{
+    MakeGraphCacheWrite(Buffer, &Value, sizeof(Value));
+}
+
+/**
+ Append a 64 bit value to a buffer.
+
+ @param Buffer Pointer to the buffer.
+
+ @param Value The value to append.
+ */
+VOID
+MakeGraphCacheWriteDwordLong(
+    __inout PMAKE_GRAPH_CACHE_BUFFER Buffer,
+    __in DWORDLONG Value
+    )
+{
+    MakeGraphCacheWrite(Buffer, &Value, sizeof(Value));
+}
+
+/**
+ Append a string to a buffer.  The string is preceeded by its length and
+ followed by a NULL terminator, so that it can be used directly from the
+ buffer when the file is loaded.
+
+ @param Buffer Pointer to the buffer.
+
+ @param String Pointer to the string to append.
+ */
+VOID
+MakeGraphCacheWriteString(
+    __inout PMAKE_GRAPH_CACHE_BUFFER Buffer,
+    __in PCYORI_STRING String
+    )
+{
+    TCHAR Terminator;
+
+    Terminator = '\0';
+    MakeGraphCacheWriteDword(Buffer, String->LengthInChars);
+    MakeGraphCacheWrite(Buffer, String->StartOfString, String->LengthInChars * sizeof(TCHAR));
+    MakeGraphCacheWrite(Buffer, &Terminator, sizeof(Terminator));
+}
+
+/**
+ Read data from a buffer.
+
+ @param Buffer Pointer to the buffer.
+
+ @param Data Pointer to a location to copy the data to.
+
+ @param Length The number of bytes to read.
+
+ @return TRUE to indicate success, FALSE if the buffer does not contain
+         enough data.
+ */
+__success(return)
+BOOLEAN
+MakeGraphCacheRead(
+    __inout PMAKE_GRAPH_CACHE_BUFFER Buffer,
+    __out PVOID Data,
+    __in DWORD Length
+    )
+{
+    if (Buffer->Offset > Buffer->BytesAllocated ||
+        Length > Buffer->BytesAllocated - Buffer->Offset) {
+
+        return FALSE;
+    }
+
+    memcpy(Data, &Buffer->Buffer[Buffer->Offset], Length);
+    Buffer->Offset = Buffer->Offset + Length;
+    return TRUE;
+}
+
+/**
+ Read a 32 bit value from a buffer.
+
+ @param Buffer Pointer to the buffer.
+
+ @param Value On successful completion, updated to contain the value.
+
+ @return TRUE to indicate success, FALSE if the buffer does not contain
+         enough data.
+ */
+__success(return)
+BOOLEAN
+MakeGraphCacheReadDword(
+    __inout PMAKE_GRAPH_CACHE_BUFFER Buffer,
+    __out PDWORD Value
+    )
+{
+    return MakeGraphCacheRead(Buffer, Value, sizeof(DWORD));
+}
+
+/**
+ Read a 64 bit value from a buffer.
+
+ @param Buffer Pointer to the buffer.
+
+ @param Value On successful completion, updated to contain the value.
+
+ @return TRUE to indicate success, FALSE if the buffer does not contain
+         enough data.
+ */
+__success(return)
+BOOLEAN
+MakeGraphCacheReadDwordLong(
+    __inout PMAKE_GRAPH_CACHE_BUFFER Buffer,
+    __out PDWORDLONG Value
+    )
+{
+    return MakeGraphCacheRead(Buffer, Value, sizeof(DWORDLONG));
+}
+
+/**
+ Read a string from a buffer.  The string refers to memory within the
+ buffer and is NULL terminated.  Its MemoryToFree refers to the buffer, so
+ a caller which needs to retain the string can clone it.
+
+ @param Buffer Pointer to the buffer.
+
+ @param String On successful completion, updated to describe the string.
+
+ @return TRUE to indicate success, FALSE if the buffer does not contain a
+         valid string.
+ */
+__success(return)
+BOOLEAN
+MakeGraphCacheReadString(
+    __inout PMAKE_GRAPH_CACHE_BUFFER Buffer,
+    __out PYORI_STRING String
+    )
+{
+    DWORD Length;
+    DWORD BytesRemaining;
+    LPTSTR Chars;
+
+    if (!MakeGraphCacheReadDword(Buffer, &Length)) {
+        return FALSE;
+    }
+
+    BytesRemaining = Buffer->BytesAllocated - Buffer->Offset;
+    if (Length >= YORI_MAX_ALLOC_SIZE ||
+        Length >= BytesRemaining / sizeof(TCHAR)) {
+
+        return FALSE;
+    }
+
+    Chars = (LPTSTR)&Buffer->Buffer[Buffer->Offset];
+    if (Chars[Length] != '\0') {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(String);
+    String->StartOfString = Chars;
+    String->LengthInChars = (YORI_ALLOC_SIZE_T)Length;
+    String->LengthAllocated = (YORI_ALLOC_SIZE_T)(Length + 1);
+    String->MemoryToFree = Buffer->Buffer;
+
+    Buffer->Offset = Buffer->Offset + (Length + 1) * sizeof(TCHAR);
+    return TRUE;
+}
+
+/**
+ Check that every file used to construct the cached dependency graph is
+ unchanged.
+
+ @param MakeContext Pointer to the context.
+
+ @param Reader Pointer to the buffer, positioned at the list of inputs.
+
+ @return TRUE if the inputs are unchanged, FALSE if they have changed or the
+         buffer is not valid.
+ */
+BOOLEAN
+MakeValidateGraphCacheInputs(
+    __in PMAKE_CONTEXT MakeContext,
+    __inout PMAKE_GRAPH_CACHE_BUFFER Reader
+    )
+{
+    DWORD InputCount;
+    DWORD Index;
+    DWORD InputType;
+    DWORDLONG ExpectedSize;
+    DWORDLONG ExpectedHash;
+    DWORDLONG FileSize;
+    DWORDLONG ContentHash;
+    YORI_STRING FileName;
+    BOOLEAN FileExists;
+
+    if (!MakeGraphCacheReadDword(Reader, &InputCount)) {
+        return FALSE;
+    }
+
+    for (Index = 0; Index < InputCount; Index++) {
+        if (!MakeGraphCacheReadDword(Reader, &InputType) ||
+            !MakeGraphCacheReadString(Reader, &FileName) ||
+            !MakeGraphCacheReadDwordLong(Reader, &ExpectedSize) ||
+            !MakeGraphCacheReadDwordLong(Reader, &ExpectedHash)) {
+
+            return FALSE;
+        }
+
+        if (InputType == MakeGraphCacheInputFileContents) {
+            if (!MakeHashFileContents(&FileName, &FileSize, &ContentHash) ||
+                FileSize != ExpectedSize ||
+                ContentHash != ExpectedHash) {
+
+                return FALSE;
+            }
+        } else if (InputType == MakeGraphCacheInputFileExists ||
+                   InputType == MakeGraphCacheInputFileMissing) {
+
+            FileExists = MakeQueryFileExists(MakeContext, &FileName);
+            if (FileExists != (BOOLEAN)(InputType == MakeGraphCacheInputFileExists)) {
+                return FALSE;
+            }
+        } else {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Parse the scopes, targets and dependencies from a dependency graph cache.
+ This is performed twice: once to check that the entire file is valid, and
+ once to construct the objects it describes, so that a corrupt file cannot
+ result in a partially constructed graph.
+
+ @param MakeContext Pointer to the context.
+
+ @param Reader Pointer to the buffer, positioned at the list of scopes.
+
+ @param Populate If FALSE, the buffer is checked for validity only.  If TRUE,
+        scopes, variables, targets and dependencies are created.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+MakeProcessGraphCacheGraph(
+    __in PMAKE_CONTEXT MakeContext,
+    __inout PMAKE_GRAPH_CACHE_BUFFER Reader,
+    __in BOOLEAN Populate
+    )
+{
+    PMAKE_SCOPE_CONTEXT *Scopes;
+    PMAKE_TARGET *Targets;
+    PMAKE_SCOPE_CONTEXT ScopeContext;
+    PMAKE_TARGET Target;
+    PYORI_OPEN_HASH_ENTRY HashEntry;
+    YORI_STRING Name;
+    YORI_STRING Value;
+    YORI_STRING Recipe;
+    YORI_STRING InferenceSource;
+    DWORD ScopeCount;
+    DWORD ScopeIndex;
+    DWORD ParentIndex;
+    DWORD VariableCount;
+    DWORD VariableIndex;
+    DWORD Undefined;
+    DWORD Precedence;
+    DWORD TargetCount;
+    DWORD TargetIndex;
+    DWORD TargetScopeIndex;
+    DWORD Flags;
+    DWORD EdgeCount;
+    DWORD EdgeIndex;
+    DWORD ChildIndex;
+    BOOLEAN Result;
+
+    Scopes = NULL;
+    Targets = NULL;
+    ScopeContext = NULL;
+    Result = FALSE;
+
+    //
+    //  Each scope and target record consumes more than a DWORD, so this
+    //  bounds the counts before allocating anything.
+    //
+
+    if (!MakeGraphCacheReadDword(Reader, &ScopeCount) ||
+        ScopeCount == 0 ||
+        ScopeCount > Reader->BytesAllocated / sizeof(DWORD)) {
+
+        goto Exit;
+    }
+
+    if (Populate) {
+        if (!YoriLibIsSizeAllocatable(ScopeCount * sizeof(PMAKE_SCOPE_CONTEXT))) {
+            goto Exit;
+        }
+        Scopes = YoriLibMalloc((YORI_ALLOC_SIZE_T)(ScopeCount * sizeof(PMAKE_SCOPE_CONTEXT)));
+        if (Scopes == NULL) {
+            goto Exit;
+        }
+    }
+
+    for (ScopeIndex = 0; ScopeIndex < ScopeCount; ScopeIndex++) {
+        if (!MakeGraphCacheReadString(Reader, &Name) ||
+            !MakeGraphCacheReadDword(Reader, &ParentIndex)) {
+
+            goto Exit;
+        }
+
+        //
+        //  The first scope is the root scope, which already exists.  Every
+        //  other scope is created after its parent.
+        //
+
+        if (ScopeIndex == 0) {
+            if (ParentIndex != MAKE_GRAPH_CACHE_NO_INDEX ||
+                YoriLibCompareStringIns(&Name, &MakeContext->RootScope->HashEntry.Key) != 0) {
+
+                goto Exit;
+            }
+        } else if (ParentIndex >= ScopeIndex) {
+            goto Exit;
+        }
+
+        if (Populate) {
+            if (ScopeIndex == 0) {
+                ScopeContext = MakeContext->RootScope;
+            } else {
+                if (YoriLibOpenHashLookupByKey(MakeContext->Scopes, &Name) != NULL) {
+                    goto Exit;
+                }
+
+                ScopeContext = MakeAllocateNewScope(MakeContext, &Name);
+                if (ScopeContext == NULL) {
+                    goto Exit;
+                }
+
+                //
+                //  The scope is not active, so only the reference from the
+                //  list of scopes is retained.
+                //
+
+                ScopeContext->ParentScope = Scopes[ParentIndex];
+                MakeDereferenceScope(ScopeContext);
+            }
+            Scopes[ScopeIndex] = ScopeContext;
+        }
+
+        if (!MakeGraphCacheReadDword(Reader, &VariableCount)) {
+            goto Exit;
+        }
+
+        for (VariableIndex = 0; VariableIndex < VariableCount; VariableIndex++) {
+            if (!MakeGraphCacheReadString(Reader, &Name) ||
+                !MakeGraphCacheReadString(Reader, &Value) ||
+                !MakeGraphCacheReadDword(Reader, &Undefined) ||
+                !MakeGraphCacheReadDword(Reader, &Precedence)) {
+
+                goto Exit;
+            }
+
+            if (Precedence > MakeVariablePrecedenceCommandLine) {
+                goto Exit;
+            }
+
+            if (Populate) {
+                ASSERT(ScopeContext != NULL);
+                __analysis_assume(ScopeContext != NULL);
+                if (!MakeSetVariable(ScopeContext, &Name, &Value, (BOOLEAN)(Undefined == 0), (MAKE_VARIABLE_PRECEDENCE)Precedence)) {
+                    goto Exit;
+                }
+            }
+        }
+    }
+
+    if (!MakeGraphCacheReadDword(Reader, &TargetCount) ||
+        TargetCount > Reader->BytesAllocated / sizeof(DWORD)) {
+
+        goto Exit;
+    }
+
+    if (Populate && TargetCount > 0) {
+        if (!YoriLibIsSizeAllocatable(TargetCount * sizeof(PMAKE_TARGET))) {
+            goto Exit;
+        }
+        Targets = YoriLibMalloc((YORI_ALLOC_SIZE_T)(TargetCount * sizeof(PMAKE_TARGET)));
+        if (Targets == NULL) {
+            goto Exit;
+        }
+    }
+
+    for (TargetIndex = 0; TargetIndex < TargetCount; TargetIndex++) {
+        if (!MakeGraphCacheReadString(Reader, &Name) ||
+            !MakeGraphCacheReadDword(Reader, &TargetScopeIndex) ||
+            !MakeGraphCacheReadDword(Reader, &Flags) ||
+            !MakeGraphCacheReadString(Reader, &Recipe) ||
+            !MakeGraphCacheReadString(Reader, &InferenceSource)) {
+
+            goto Exit;
+        }
+
+        if (TargetScopeIndex != MAKE_GRAPH_CACHE_NO_INDEX &&
+            TargetScopeIndex >= ScopeCount) {
+
+            goto Exit;
+        }
+
+        if (!Populate) {
+            continue;
+        }
+
+        //
+        //  The default target for each scope was created with the scope.
+        //  Everything else is created here.
+        //
+
+        HashEntry = YoriLibOpenHashLookupByKey(MakeContext->Targets, &Name);
+        if (HashEntry != NULL) {
+            Target = HashEntry->Context;
+        } else {
+            Target = MakeAllocateTarget(MakeContext, &Name);
+            if (Target == NULL) {
+                goto Exit;
+            }
+        }
+
+        if (TargetScopeIndex != MAKE_GRAPH_CACHE_NO_INDEX &&
+            Target->ScopeContext == NULL) {
+
+            MakeReferenceScope(Scopes[TargetScopeIndex]);
+            Target->ScopeContext = Scopes[TargetScopeIndex];
+        }
+
+        if (Flags & MAKE_GRAPH_CACHE_TARGET_BUILDABLE) {
+            Target->ExplicitRecipeFound = TRUE;
+        }
+
+        if (Recipe.LengthInChars > 0) {
+            YoriLibFreeStringContents(&Target->Recipe);
+            YoriLibCloneString(&Target->Recipe, &Recipe);
+        }
+
+        if (InferenceSource.LengthInChars > 0) {
+            YoriLibFreeStringContents(&Target->CachedInferenceSource);
+            YoriLibCloneString(&Target->CachedInferenceSource, &InferenceSource);
+        }
+
+        Targets[TargetIndex] = Target;
+    }
+
+    if (!MakeGraphCacheReadDword(Reader, &EdgeCount)) {
+        goto Exit;
+    }
+
+    for (EdgeIndex = 0; EdgeIndex < EdgeCount; EdgeIndex++) {
+        if (!MakeGraphCacheReadDword(Reader, &ChildIndex) ||
+            !MakeGraphCacheReadDword(Reader, &ParentIndex)) {
+
+            goto Exit;
+        }
+
+        if (ChildIndex >= TargetCount || ParentIndex >= TargetCount) {
+            goto Exit;
+        }
+
+        if (Populate) {
+            ASSERT(Targets != NULL);
+            __analysis_assume(Targets != NULL);
+            if (!MakeCreateParentChildDependency(MakeContext, Targets[ParentIndex], Targets[ChildIndex])) {
+                goto Exit;
+            }
+        }
+    }
+
+    if (Reader->Offset != Reader->BytesAllocated) {
+        goto Exit;
+    }
+
+    Result = TRUE;
+
+Exit:
+    if (Scopes != NULL) {
+        YoriLibFree(Scopes);
+    }
+    if (Targets != NULL) {
+        YoriLibFree(Targets);
+    }
+
+    return Result;
+}
+
+/**
+ Attempt to load the dependency graph from the cache written by a previous
+ build.  This succeeds only if the environment, command line arguments, and
+ every file used to construct the graph are unchanged.  Note that the
+ results of preprocessor commands are assumed to be unchanged, as with the
+ preprocessor cache.
+
+ @param MakeContext Pointer to the context.
+
+ @param MakeFileName Pointer to the name of the makefile.
+
+ @return TRUE to indicate the dependency graph was loaded, FALSE if it was
+         not and the makefile needs to be processed.  If an error occurred
+         after objects have been created, MAKE_CONTEXT::ErrorTermination is
+         set.
+ */
+BOOLEAN
+MakeLoadGraphCache(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING MakeFileName
+    )
+{
+    MAKE_GRAPH_CACHE_BUFFER Reader;
+    YORI_STRING CacheFileName;
+    HANDLE hCache;
+    DWORD FileSizeHigh;
+    DWORD FileSizeLow;
+    DWORD BytesRead;
+    DWORD Signature;
+    DWORD Version;
+    DWORD EnvHash;
+    DWORD ExpectedEnvHash;
+    DWORDLONG ArgsHash;
+    DWORD GraphOffset;
+    BOOLEAN Result;
+
+    if (!MakeGetGraphCacheFileName(MakeFileName, &CacheFileName)) {
+        return FALSE;
+    }
+
+    hCache = CreateFile(CacheFileName.StartOfString, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    YoriLibFreeStringContents(&CacheFileName);
+    if (hCache == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    FileSizeLow = GetFileSize(hCache, &FileSizeHigh);
+    if (FileSizeLow == INVALID_FILE_SIZE ||
+        FileSizeHigh != 0 ||
+        !YoriLibIsSizeAllocatable(FileSizeLow)) {
+
+        CloseHandle(hCache);
+        return FALSE;
+    }
+
+    ZeroMemory(&Reader, sizeof(Reader));
+    Reader.Buffer = YoriLibReferencedMalloc((YORI_ALLOC_SIZE_T)FileSizeLow);
+    if (Reader.Buffer == NULL) {
+        CloseHandle(hCache);
+        return FALSE;
+    }
+
+    if (!ReadFile(hCache, Reader.Buffer, FileSizeLow, &BytesRead, NULL) ||
+        BytesRead != FileSizeLow) {
+
+        CloseHandle(hCache);
+        YoriLibDereference(Reader.Buffer);
+        return FALSE;
+    }
+
+    CloseHandle(hCache);
+    Reader.BytesAllocated = FileSizeLow;
+    Result = FALSE;
+
+    if (!MakeGraphCacheReadDword(&Reader, &Signature) ||
+        !MakeGraphCacheReadDword(&Reader, &Version) ||
+        !MakeGraphCacheReadDword(&Reader, &EnvHash) ||
+        !MakeGraphCacheReadDwordLong(&Reader, &ArgsHash)) {
+
+        goto Exit;
+    }
+
+    if (Signature != MAKE_GRAPH_CACHE_SIGNATURE ||
+        Version != MAKE_GRAPH_CACHE_VERSION ||
+        ArgsHash != MakeContext->GraphCacheArgsHash) {
+
+        goto Exit;
+    }
+
+    if (!MakeGetEnvironmentHash(MakeContext, &ExpectedEnvHash) ||
+        EnvHash != ExpectedEnvHash) {
+
+        goto Exit;
+    }
+
+    if (!MakeValidateGraphCacheInputs(MakeContext, &Reader)) {
+        goto Exit;
+    }
+
+    GraphOffset = Reader.Offset;
+    if (!MakeProcessGraphCacheGraph(MakeContext, &Reader, FALSE)) {
+        goto Exit;
+    }
+
+    Reader.Offset = GraphOffset;
+    if (!MakeProcessGraphCacheGraph(MakeContext, &Reader, TRUE)) {
+        MakeContext->ErrorTermination = TRUE;
+        goto Exit;
+    }
+
+    Result = TRUE;
+
+Exit:
+    YoriLibDereference(Reader.Buffer);
+    return Result;
+}
+
+/**
+ Write the dependency graph to a cache file so that a later build with the
+ same makefiles, environment and arguments can skip preprocessing.  This is
+ called once the graph has been constructed, before any targets are
+ executed.
+
+ @param MakeContext Pointer to the context.
+
+ @param MakeFileName Pointer to the name of the makefile.
+ */
+VOID
+MakeSaveGraphCache(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING MakeFileName
+    )
+{
+    MAKE_GRAPH_CACHE_BUFFER Writer;
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_LIST_ENTRY VariableEntry;
+    PYORI_LIST_ENTRY DependencyEntry;
+    PMAKE_GRAPH_CACHE_INPUT Input;
+    PMAKE_SCOPE_CONTEXT ScopeContext;
+    PMAKE_VARIABLE Variable;
+    PMAKE_TARGET Target;
+    PMAKE_TARGET_DEPENDENCY Dependency;
+    PYORI_STRING Recipe;
+    YORI_STRING InferenceSource;
+    YORI_STRING CacheFileName;
+    HANDLE hCache;
+    DWORD Count;
+    DWORD Flags;
+    DWORD EnvHash;
+    DWORD BytesWritten;
+
+    if (MakeContext->GraphCacheInputs == NULL || MakeContext->GraphCacheHit) {
+        return;
+    }
+
+    //
+    //  Inline files are generated while preprocessing and deleted on exit,
+    //  so a graph that refers to them cannot be reused.
+    //
+
+    if (!YoriLibIsListEmpty(&MakeContext->InlineFileList)) {
+        return;
+    }
+
+    if (!MakeGetEnvironmentHash(MakeContext, &EnvHash)) {
+        return;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->ScopesList, NULL);
+    if (ListEntry == NULL ||
+        CONTAINING_RECORD(ListEntry, MAKE_SCOPE_CONTEXT, ListEntry) != MakeContext->RootScope) {
+
+        return;
+    }
+
+    ZeroMemory(&Writer, sizeof(Writer));
+    Writer.Buffer = YoriLibMalloc(MAKE_GRAPH_CACHE_INITIAL_BUFFER);
+    if (Writer.Buffer == NULL) {
+        return;
+    }
+    Writer.BytesAllocated = MAKE_GRAPH_CACHE_INITIAL_BUFFER;
+
+    MakeGraphCacheWriteDword(&Writer, MAKE_GRAPH_CACHE_SIGNATURE);
+    MakeGraphCacheWriteDword(&Writer, MAKE_GRAPH_CACHE_VERSION);
+    MakeGraphCacheWriteDword(&Writer, EnvHash);
+    MakeGraphCacheWriteDwordLong(&Writer, MakeContext->GraphCacheArgsHash);
+
+    //
+    //  Write the files used to construct the graph.
+    //
+
+    Count = 0;
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->GraphCacheInputList, NULL);
+    while (ListEntry != NULL) {
+        Count++;
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->GraphCacheInputList, ListEntry);
+    }
+
+    MakeGraphCacheWriteDword(&Writer, Count);
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->GraphCacheInputList, NULL);
+    while (ListEntry != NULL) {
+        Input = CONTAINING_RECORD(ListEntry, MAKE_GRAPH_CACHE_INPUT, ListEntry);
+        MakeGraphCacheWriteDword(&Writer, Input->InputType);
+        MakeGraphCacheWriteString(&Writer, &Input->HashEntry.Key);
+        MakeGraphCacheWriteDwordLong(&Writer, Input->FileSize);
+        MakeGraphCacheWriteDwordLong(&Writer, Input->ContentHash);
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->GraphCacheInputList, ListEntry);
+    }
+
+    //
+    //  Write each scope and its variables.  Scopes are listed in the order
+    //  they were created, so a parent is always written before its child.
+    //
+
+    Count = 0;
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->ScopesList, NULL);
+    while (ListEntry != NULL) {
+        ScopeContext = CONTAINING_RECORD(ListEntry, MAKE_SCOPE_CONTEXT, ListEntry);
+        ScopeContext->CacheIndex = Count;
+        Count++;
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->ScopesList, ListEntry);
+    }
+
+    MakeGraphCacheWriteDword(&Writer, Count);
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->ScopesList, NULL);
+    while (ListEntry != NULL) {
+        ScopeContext = CONTAINING_RECORD(ListEntry, MAKE_SCOPE_CONTEXT, ListEntry);
+        MakeGraphCacheWriteString(&Writer, &ScopeContext->HashEntry.Key);
+        if (ScopeContext->ParentScope != NULL) {
+            MakeGraphCacheWriteDword(&Writer, ScopeContext->ParentScope->CacheIndex);
+        } else {
+            MakeGraphCacheWriteDword(&Writer, MAKE_GRAPH_CACHE_NO_INDEX);
+        }
+
+        Count = 0;
+        VariableEntry = YoriLibGetNextListEntry(&ScopeContext->VariableList, NULL);
+        while (VariableEntry != NULL) {
+            Count++;
+            VariableEntry = YoriLibGetNextListEntry(&ScopeContext->VariableList, VariableEntry);
+        }
+
+        MakeGraphCacheWriteDword(&Writer, Count);
+        VariableEntry = YoriLibGetNextListEntry(&ScopeContext->VariableList, NULL);
+        while (VariableEntry != NULL) {
+            Variable = CONTAINING_RECORD(VariableEntry, MAKE_VARIABLE, ListEntry);
+            MakeGraphCacheWriteString(&Writer, &Variable->HashEntry.Key);
+            MakeGraphCacheWriteString(&Writer, &Variable->Value);
+            MakeGraphCacheWriteDword(&Writer, Variable->Undefined?1:0);
+            MakeGraphCacheWriteDword(&Writer, Variable->Precedence);
+            VariableEntry = YoriLibGetNextListEntry(&ScopeContext->VariableList, VariableEntry);
+        }
+
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->ScopesList, ListEntry);
+    }
+
+    //
+    //  Write each target.  Inference rule pseudo targets are not needed,
+    //  because the recipe and source file that each real target obtained
+    //  from its inference rule are written with the target.
+    //
+
+    Count = 0;
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsList, NULL);
+    while (ListEntry != NULL) {
+        Target = CONTAINING_RECORD(ListEntry, MAKE_TARGET, ListEntry);
+        if (Target->InferenceRulePseudoTarget) {
+            Target->CacheIndex = MAKE_GRAPH_CACHE_NO_INDEX;
+        } else {
+            Target->CacheIndex = Count;
+            Count++;
+        }
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsList, ListEntry);
+    }
+
+    MakeGraphCacheWriteDword(&Writer, Count);
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsList, NULL);
+    while (ListEntry != NULL) {
+        Target = CONTAINING_RECORD(ListEntry, MAKE_TARGET, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsList, ListEntry);
+        if (Target->CacheIndex == MAKE_GRAPH_CACHE_NO_INDEX) {
+            continue;
+        }
+
+        MakeGraphCacheWriteString(&Writer, &Target->HashEntry.Key);
+        if (Target->ScopeContext != NULL) {
+            MakeGraphCacheWriteDword(&Writer, Target->ScopeContext->CacheIndex);
+        } else {
+            MakeGraphCacheWriteDword(&Writer, MAKE_GRAPH_CACHE_NO_INDEX);
+        }
+
+        //
+        //  This follows the same logic as MakeGenerateExecScriptForTarget
+        //  to find the recipe that would be used.
+        //
+
+        Flags = 0;
+        Recipe = &Target->Recipe;
+        YoriLibInitEmptyString(&InferenceSource);
+        if (Target->ExplicitRecipeFound || Target->InferenceRule != NULL) {
+            Flags = Flags | MAKE_GRAPH_CACHE_TARGET_BUILDABLE;
+        }
+
+        if (Target->InferenceRule != NULL) {
+            if (Target->Recipe.LengthInChars == 0 &&
+                Target->InferenceRule->Target != NULL) {
+
+                Recipe = &Target->InferenceRule->Target->Recipe;
+            }
+
+            if (!MakeBuildInferenceSourceName(Target, &InferenceSource)) {
+                Writer.Failed = TRUE;
+            }
+        }
+
+        MakeGraphCacheWriteDword(&Writer, Flags);
+        MakeGraphCacheWriteString(&Writer, Recipe);
+        MakeGraphCacheWriteString(&Writer, &InferenceSource);
+        YoriLibFreeStringContents(&InferenceSource);
+    }
+
+    //
+    //  Write each dependency between targets that were written above.
+    //
+
+    for (Flags = 0; Flags < 2; Flags++) {
+        Count = 0;
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsList, NULL);
+        while (ListEntry != NULL) {
+            Target = CONTAINING_RECORD(ListEntry, MAKE_TARGET, ListEntry);
+            ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsList, ListEntry);
+            if (Target->CacheIndex == MAKE_GRAPH_CACHE_NO_INDEX) {
+                continue;
+            }
+
+            DependencyEntry = YoriLibGetNextListEntry(&Target->ParentDependents, NULL);
+            while (DependencyEntry != NULL) {
+                Dependency = CONTAINING_RECORD(DependencyEntry, MAKE_TARGET_DEPENDENCY, ChildDependents);
+                if (Dependency->Parent->CacheIndex != MAKE_GRAPH_CACHE_NO_INDEX) {
+                    if (Flags == 1) {
+                        MakeGraphCacheWriteDword(&Writer, Target->CacheIndex);
+                        MakeGraphCacheWriteDword(&Writer, Dependency->Parent->CacheIndex);
+                    }
+                    Count++;
+                }
+                DependencyEntry = YoriLibGetNextListEntry(&Target->ParentDependents, DependencyEntry);
+            }
+        }
+
+        if (Flags == 0) {
+            MakeGraphCacheWriteDword(&Writer, Count);
+        }
+    }
+
+    if (Writer.Failed) {
+        YoriLibFree(Writer.Buffer);
+        return;
+    }
+
+    if (!MakeGetGraphCacheFileName(MakeFileName, &CacheFileName)) {
+        YoriLibFree(Writer.Buffer);
+        return;
+    }
+
+    hCache = CreateFile(CacheFileName.StartOfString, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hCache != INVALID_HANDLE_VALUE) {
+        if (!WriteFile(hCache, Writer.Buffer, Writer.Offset, &BytesWritten, NULL) ||
+            BytesWritten != Writer.Offset) {
+
+            CloseHandle(hCache);
+            DeleteFile(CacheFileName.StartOfString);
+        } else {
+            CloseHandle(hCache);
+        }
+    }
+
+    YoriLibFreeStringContents(&CacheFileName);
+    YoriLibFree(Writer.Buffer);
+}
+
+// vim:sw=4:ts=4:et:
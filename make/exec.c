@@ -3,7 +3,7 @@
  *
  * Yori shell make execute child process support
  *
- * Copyright (c) 2020 Malcolm J. Smith
+ * Copyright (c) 2020-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -80,6 +80,96 @@ typedef struct _MAKE_CHILD_RECIPE {
     YORI_LIBSH_EXEC_PLAN ExecPlan;
 } MAKE_CHILD_RECIPE, *PMAKE_CHILD_RECIPE;
 
+/**
+ Information about a group of child processes that are waited for by a
+ helper thread.  This is used when more child processes are executing than
+ a single call to WaitForMultipleObjects can wait for.  Each helper thread
+ persists until all targets have executed, and waits for its group each
+ time its start event is signalled.
+ */
+typedef struct _MAKE_WAIT_GROUP {
+
+    /**
+     The index within the array of process handles of the first process
+     in this group.
+     */
+    DWORD FirstIndex;
+
+    /**
+     The number of handles in the Handles array, including the cancel event.
+     */
+    DWORD HandleCount;
+
+    /**
+     The result of the wait performed by the helper thread.
+     */
+    DWORD WaitResult;
+
+    /**
+     TRUE if the helper thread should exit when its start event is next
+     signalled, rather than waiting for the group.
+     */
+    BOOLEAN Terminate;
+
+    /**
+     An auto reset event which is signalled to indicate the helper thread
+     should wait for the handles in the group, or exit if Terminate is set.
+     */
+    HANDLE StartEvent;
+
+    /**
+     A manual reset event which is signalled by the helper thread when its
+     wait has completed and WaitResult is valid.
+     */
+    HANDLE CompleteEvent;
+
+    /**
+     The handles to wait for.  The first is the cancel event, which is
+     signalled to indicate the helper thread should stop waiting, and the
+     remaining handles are child processes.
+     */
+    HANDLE Handles[MAXIMUM_WAIT_OBJECTS];
+} MAKE_WAIT_GROUP, *PMAKE_WAIT_GROUP;
+
+/**
+ State used to wait for any one of the executing child processes to
+ complete.
+ */
+typedef struct _MAKE_WAIT_CONTEXT {
+
+    /**
+     An event which is signalled to indicate that helper threads should stop
+     waiting, because a child process has completed.  This is only allocated
+     if more child processes can execute than WaitForMultipleObjects can wait
+     for.
+     */
+    HANDLE CancelEvent;
+
+    /**
+     An array of groups of child processes.  This is only allocated if more
+     child processes can execute than WaitForMultipleObjects can wait for.
+     */
+    PMAKE_WAIT_GROUP Groups;
+
+    /**
+     The number of helper threads that have been started.  Each thread
+     corresponds to the group at the same index.
+     */
+    DWORD ThreadCount;
+
+    /**
+     Handles to the helper threads waiting for each group of child
+     processes.
+     */
+    HANDLE ThreadHandles[MAXIMUM_WAIT_OBJECTS];
+
+    /**
+     The complete event from each group, so that the scheduler can wait for
+     any or all of them.
+     */
+    HANDLE CompleteEvents[MAXIMUM_WAIT_OBJECTS];
+} MAKE_WAIT_CONTEXT, *PMAKE_WAIT_CONTEXT;
+
 /**
  Attempt to set the temporary directory for this process to match the
  specified JobId, creating the directory if it does not exist.
@@ -99,26 +189,28 @@ MakeSetTemporaryDirectory(
     __in DWORD JobId
     )
 {
-    DWORDLONG TestMask;
+    DWORD TestMask;
+    DWORD Offset;
     YORI_STRING JobTempPath;
 
     ASSERT(JobId < MakeContext->NumberProcesses);
+    Offset = JobId / MAKE_JOB_BITMAP_BITS;
     TestMask = 1;
-    TestMask = TestMask << JobId;
+    TestMask = TestMask << (JobId % MAKE_JOB_BITMAP_BITS);
 
-    if (!YoriLibAllocateString(&JobTempPath, MakeContext->TempPath.LengthInChars + sizeof("\\YMAKE12"))) {
+    if (!YoriLibAllocateString(&JobTempPath, MakeContext->TempPath.LengthInChars + sizeof("\\YMAKE1234"))) {
         return FALSE;
     }
 
     JobTempPath.LengthInChars = YoriLibSPrintf(JobTempPath.StartOfString, _T("%y\\YMAKE%i"), &MakeContext->TempPath, JobId);
 
-    if ((MakeContext->TempDirectoriesCreated & TestMask) == 0) {
+    if ((MakeContext->TempDirectoriesCreated[Offset] & TestMask) == 0) {
         if (!YoriLibCreateDirectoryAndParents(&JobTempPath)) {
             YoriLibFreeStringContents(&JobTempPath);
             return FALSE;
         }
 
-        MakeContext->TempDirectoriesCreated = MakeContext->TempDirectoriesCreated | TestMask;
+        MakeContext->TempDirectoriesCreated[Offset] = MakeContext->TempDirectoriesCreated[Offset] | TestMask;
     }
 
     if (!SetEnvironmentVariable(_T("TEMP"), JobTempPath.StartOfString)) {
@@ -148,17 +240,17 @@ MakeCleanupTemporaryDirectories(
     )
 {
     DWORD Probe;
-    DWORDLONG TestMask;
+    DWORD TestMask;
     YORI_STRING TempPath;
 
-    if (!YoriLibAllocateString(&TempPath, MakeContext->TempPath.LengthInChars + sizeof("\\YMAKE12"))) {
+    if (!YoriLibAllocateString(&TempPath, MakeContext->TempPath.LengthInChars + sizeof("\\YMAKE1234"))) {
         return;
     }
 
     for (Probe = 0; Probe < MakeContext->NumberProcesses; Probe++) {
         TestMask = 1;
-        TestMask = TestMask << Probe;
-        if ((MakeContext->TempDirectoriesCreated & TestMask) != 0) {
+        TestMask = TestMask << (Probe % MAKE_JOB_BITMAP_BITS);
+        if ((MakeContext->TempDirectoriesCreated[Probe / MAKE_JOB_BITMAP_BITS] & TestMask) != 0) {
             TempPath.LengthInChars = YoriLibSPrintf(TempPath.StartOfString, _T("%y\\YMAKE%i"), &MakeContext->TempPath, Probe);
             RemoveDirectory(TempPath.StartOfString);
         }
@@ -183,13 +275,15 @@ MakeAllocateJobId(
     )
 {
     DWORD Probe;
-    DWORDLONG TestMask;
+    DWORD Offset;
+    DWORD TestMask;
 
     for (Probe = 0; Probe < MakeContext->NumberProcesses; Probe++) {
+        Offset = Probe / MAKE_JOB_BITMAP_BITS;
         TestMask = 1;
-        TestMask = TestMask << Probe;
-        if ((MakeContext->JobIdsAllocated & TestMask) == 0) {
-            MakeContext->JobIdsAllocated = MakeContext->JobIdsAllocated | TestMask;
+        TestMask = TestMask << (Probe % MAKE_JOB_BITMAP_BITS);
+        if ((MakeContext->JobIdsAllocated[Offset] & TestMask) == 0) {
+            MakeContext->JobIdsAllocated[Offset] = MakeContext->JobIdsAllocated[Offset] | TestMask;
             MakeSetTemporaryDirectory(MakeContext, Probe);
             return Probe;
         }
@@ -212,14 +306,16 @@ MakeFreeJobId(
     __in DWORD JobId
     )
 {
-    DWORDLONG TestMask;
+    DWORD Offset;
+    DWORD TestMask;
 
     ASSERT(JobId < MakeContext->NumberProcesses);
 
+    Offset = JobId / MAKE_JOB_BITMAP_BITS;
     TestMask = 1;
-    TestMask = TestMask << JobId;
-    ASSERT(MakeContext->JobIdsAllocated & TestMask);
-    MakeContext->JobIdsAllocated = MakeContext->JobIdsAllocated & ~(TestMask);
+    TestMask = TestMask << (JobId % MAKE_JOB_BITMAP_BITS);
+    ASSERT(MakeContext->JobIdsAllocated[Offset] & TestMask);
+    MakeContext->JobIdsAllocated[Offset] = MakeContext->JobIdsAllocated[Offset] & ~(TestMask);
 }
 
 /**
@@ -739,6 +835,167 @@ MakeRecipeCompletion(
     YoriLibFreeStringContents(&ChildRecipe->CurrentDirectory);
 }
 
+/**
+ Add a target to the list of targets that are ready to execute.  The list is
+ ordered by critical path, so the targets with the longest chain of work
+ depending on them are launched first.  Targets with the same critical path
+ are launched in the order they became ready.  The caller is responsible
+ for recording when the target became ready, since targets that are ready
+ while the graph is being constructed only become ready to execute when
+ execution starts.
+
+ @param MakeContext Pointer to the context.
+
+ @param Target Pointer to the target that is ready to execute.
+ */
+VOID
+MakeAddTargetToReadyList(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PMAKE_TARGET Target
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_TARGET ReadyTarget;
+
+    //
+    //  Search backwards from the end of the list for a target whose
+    //  critical path is at least as long as this one.  A target that has
+    //  just become ready is further along its dependency chain than the
+    //  targets it depended on, so this search is normally short.
+    //
+
+    ListEntry = YoriLibGetPreviousListEntry(&MakeContext->TargetsReady, NULL);
+    while (ListEntry != NULL) {
+        ReadyTarget = CONTAINING_RECORD(ListEntry, MAKE_TARGET, RebuildList);
+        if (ReadyTarget->CriticalPathTime >= Target->CriticalPathTime) {
+            break;
+        }
+        ListEntry = YoriLibGetPreviousListEntry(&MakeContext->TargetsReady, ListEntry);
+    }
+
+    if (ListEntry == NULL) {
+        YoriLibInsertList(&MakeContext->TargetsReady, &Target->RebuildList);
+    } else {
+        YoriLibInsertList(ListEntry, &Target->RebuildList);
+    }
+}
+
+/**
+ Sort an array of targets so that targets with the longest critical path
+ are first.  Targets with the same critical path retain their order.
+
+ @param Targets Pointer to the array of targets to sort.
+
+ @param Scratch Pointer to an array that can hold at least half of the
+        targets, used while merging.
+
+ @param Count The number of targets in the array.
+ */
+VOID
+MakeMergeSortTargets(
+    __inout PMAKE_TARGET *Targets,
+    __inout PMAKE_TARGET *Scratch,
+    __in YORI_ALLOC_SIZE_T Count
+    )
+{
+    YORI_ALLOC_SIZE_T Half;
+    YORI_ALLOC_SIZE_T Left;
+    YORI_ALLOC_SIZE_T Right;
+    YORI_ALLOC_SIZE_T Dest;
+
+    if (Count < 2) {
+        return;
+    }
+
+    Half = Count / 2;
+    MakeMergeSortTargets(Targets, Scratch, Half);
+    MakeMergeSortTargets(&Targets[Half], Scratch, Count - Half);
+
+    //
+    //  Move the first half aside and merge back into the array.  The
+    //  destination can never overtake the unmerged second half.
+    //
+
+    memcpy(Scratch, Targets, Half * sizeof(PMAKE_TARGET));
+
+    Left = 0;
+    Right = Half;
+    Dest = 0;
+    while (Left < Half && Right < Count) {
+        if (Targets[Right]->CriticalPathTime > Scratch[Left]->CriticalPathTime) {
+            Targets[Dest] = Targets[Right];
+            Right++;
+        } else {
+            Targets[Dest] = Scratch[Left];
+            Left++;
+        }
+        Dest++;
+    }
+
+    while (Left < Half) {
+        Targets[Dest] = Scratch[Left];
+        Left++;
+        Dest++;
+    }
+}
+
+/**
+ Sort the list of targets that are ready to execute by critical path.  This
+ is used once the dependency graph is complete, since targets are added to
+ the ready list before their critical path is known.  If memory cannot be
+ allocated the list is left in its current order, which is still a valid
+ order to execute in.
+
+ @param MakeContext Pointer to the context.
+ */
+VOID
+MakeSortReadyTargets(
+    __in PMAKE_CONTEXT MakeContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_TARGET *Targets;
+    YORI_ALLOC_SIZE_T Count;
+    YORI_ALLOC_SIZE_T Index;
+
+    Count = 0;
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsReady, NULL);
+    while (ListEntry != NULL) {
+        Count++;
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsReady, ListEntry);
+    }
+
+    if (Count < 2) {
+        return;
+    }
+
+    if (!YoriLibIsSizeAllocatable(((YORI_MAX_UNSIGNED_T)Count + Count / 2) * sizeof(PMAKE_TARGET))) {
+        return;
+    }
+
+    Targets = YoriLibMalloc((Count + Count / 2) * sizeof(PMAKE_TARGET));
+    if (Targets == NULL) {
+        return;
+    }
+
+    Index = 0;
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsReady, NULL);
+    while (ListEntry != NULL) {
+        Targets[Index] = CONTAINING_RECORD(ListEntry, MAKE_TARGET, RebuildList);
+        Index++;
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsReady, ListEntry);
+    }
+
+    MakeMergeSortTargets(Targets, &Targets[Count], Count);
+
+    for (Index = 0; Index < Count; Index++) {
+        YoriLibRemoveListItem(&Targets[Index]->RebuildList);
+        YoriLibAppendList(&MakeContext->TargetsReady, &Targets[Index]->RebuildList);
+    }
+
+    YoriLibFree(Targets);
+}
+
 /**
  Launch the recipe for the next ready target.
 
@@ -758,6 +1015,7 @@ MakeLaunchNextTarget(
 {
     PMAKE_TARGET Target;
     PYORI_LIST_ENTRY ListEntry;
+    LARGE_INTEGER CurrentTime;
     BOOLEAN Result;
 
     //
@@ -785,6 +1043,10 @@ MakeLaunchNextTarget(
     YoriLibAppendList(&MakeContext->TargetsRunning, ListEntry);
     Target = CONTAINING_RECORD(ListEntry, MAKE_TARGET, RebuildList);
 
+    QueryPerformanceCounter(&CurrentTime);
+    Target->LaunchTime = CurrentTime.QuadPart;
+    MakeContext->TimeWaitingInQueue = MakeContext->TimeWaitingInQueue + Target->LaunchTime - Target->ReadyTime;
+
     ChildRecipe->Target = Target;
     ChildRecipe->Cmd = NULL;
 
@@ -832,6 +1094,10 @@ MakeUpdateDependenciesForTarget(
 {
     PYORI_LIST_ENTRY ListEntry;
     PMAKE_TARGET_DEPENDENCY Dependency;
+    LARGE_INTEGER CurrentTime;
+
+    QueryPerformanceCounter(&CurrentTime);
+    Target->CompletionTime = CurrentTime.QuadPart;
 
     YoriLibRemoveListItem(&Target->RebuildList);
     YoriLibAppendList(&MakeContext->TargetsFinished, &Target->RebuildList);
@@ -844,7 +1110,8 @@ MakeUpdateDependenciesForTarget(
             Dependency->Child->NumberParentsToBuild--;
             if (Dependency->Child->NumberParentsToBuild == 0) {
                 YoriLibRemoveListItem(&Dependency->Child->RebuildList);
-                YoriLibAppendList(&MakeContext->TargetsReady, &Dependency->Child->RebuildList);
+                Dependency->Child->ReadyTime = CurrentTime.QuadPart;
+                MakeAddTargetToReadyList(MakeContext, Dependency->Child);
             }
         }
         ListEntry = YoriLibGetNextListEntry(&Target->ChildDependents, ListEntry);
@@ -883,8 +1150,9 @@ MakeProcessCompletion(
     //
     //  Ideally this would wait for the process buffer threads rather than
     //  wait for process termination, then get here and wait for the process
-    //  buffer threads.  Unfortunately since there are two threads and we're
-    //  hitting the 64 object wait limit, it seems like the lesser evil.
+    //  buffer threads.  Unfortunately since there are two threads this would
+    //  triple the number of objects to wait for, so it seems like the lesser
+    //  evil.
     //
 
     if (ChildRecipe->ProcessHandle != NULL) {
@@ -957,7 +1225,8 @@ MakeProcessCompletion(
 
 /**
  Remove all targets that are in the front of the ready queue but really have
- no actions to perform.
+ no actions to perform.  This includes targets whose output can be restored
+ from the artifact cache.
 
  MSFIX This process should probably occur earlier, when a target moves from
  waiting it can move directly to completed if there is nothing to do.  This
@@ -983,7 +1252,9 @@ MakeCompleteReadyWithNoRecipe(
     ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsReady, NULL);
     while (ListEntry != NULL) {
         Target = CONTAINING_RECORD(ListEntry, MAKE_TARGET, RebuildList);
-        if (YoriLibIsListEmpty(&Target->ExecCmds)) {
+        if (YoriLibIsListEmpty(&Target->ExecCmds) ||
+            MakeRestoreTargetArtifact(MakeContext, Target)) {
+
             RemovedItem = TRUE;
             MakeUpdateDependenciesForTarget(MakeContext, Target);
         } else {
@@ -995,6 +1266,232 @@ MakeCompleteReadyWithNoRecipe(
     return RemovedItem;
 }
 
+/**
+ Code running on a helper thread to wait for any process within a group of
+ child processes to complete.  The thread waits each time its start event is
+ signalled, until it is asked to terminate.
+
+ @param Context Pointer to the wait group.
+
+ @return Thread return code, which is ignored for this thread.
+ */
+DWORD WINAPI
+MakeWaitGroupThread(
+    __in LPVOID Context
+    )
+{
+    PMAKE_WAIT_GROUP Group;
+
+    Group = (PMAKE_WAIT_GROUP)Context;
+    while (TRUE) {
+        WaitForSingleObject(Group->StartEvent, INFINITE);
+        if (Group->Terminate) {
+            break;
+        }
+        Group->WaitResult = WaitForMultipleObjectsEx(Group->HandleCount, Group->Handles, FALSE, INFINITE, FALSE);
+        SetEvent(Group->CompleteEvent);
+    }
+    return 0;
+}
+
+/**
+ Start a helper thread to wait for the next group of child processes.
+
+ @param WaitContext Pointer to the wait context.
+
+ @return TRUE if the thread was started, FALSE if it was not.
+ */
+__success(return)
+BOOLEAN
+MakeStartWaitGroupThread(
+    __in PMAKE_WAIT_CONTEXT WaitContext
+    )
+{
+    PMAKE_WAIT_GROUP Group;
+    DWORD ThreadId;
+
+    ASSERT(WaitContext->ThreadCount < MAXIMUM_WAIT_OBJECTS);
+    Group = &WaitContext->Groups[WaitContext->ThreadCount];
+    Group->Terminate = FALSE;
+    Group->StartEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (Group->StartEvent == NULL) {
+        return FALSE;
+    }
+
+    Group->CompleteEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (Group->CompleteEvent == NULL) {
+        CloseHandle(Group->StartEvent);
+        Group->StartEvent = NULL;
+        return FALSE;
+    }
+
+    WaitContext->ThreadHandles[WaitContext->ThreadCount] = CreateThread(NULL, 0, MakeWaitGroupThread, Group, 0, &ThreadId);
+    if (WaitContext->ThreadHandles[WaitContext->ThreadCount] == NULL) {
+        CloseHandle(Group->CompleteEvent);
+        Group->CompleteEvent = NULL;
+        CloseHandle(Group->StartEvent);
+        Group->StartEvent = NULL;
+        return FALSE;
+    }
+
+    WaitContext->CompleteEvents[WaitContext->ThreadCount] = Group->CompleteEvent;
+    WaitContext->ThreadCount++;
+    return TRUE;
+}
+
+/**
+ Stop helper threads from waiting for their groups of child processes, and
+ wait until each has observed the request.  The threads remain available for
+ the next wait.
+
+ @param WaitContext Pointer to the wait context.
+
+ @param GroupCount The number of groups that helper threads are waiting for.
+ */
+VOID
+MakeCancelWaitGroups(
+    __in PMAKE_WAIT_CONTEXT WaitContext,
+    __in DWORD GroupCount
+    )
+{
+    if (GroupCount == 0) {
+        return;
+    }
+
+    SetEvent(WaitContext->CancelEvent);
+    WaitForMultipleObjectsEx(GroupCount, WaitContext->CompleteEvents, TRUE, INFINITE, FALSE);
+    ResetEvent(WaitContext->CancelEvent);
+}
+
+/**
+ Terminate all helper threads and free the state used to wait for child
+ processes in groups.
+
+ @param WaitContext Pointer to the wait context.
+ */
+VOID
+MakeCleanupWaitContext(
+    __in PMAKE_WAIT_CONTEXT WaitContext
+    )
+{
+    PMAKE_WAIT_GROUP Group;
+    DWORD Index;
+
+    if (WaitContext->Groups == NULL) {
+        return;
+    }
+
+    for (Index = 0; Index < WaitContext->ThreadCount; Index++) {
+        Group = &WaitContext->Groups[Index];
+        Group->Terminate = TRUE;
+        SetEvent(Group->StartEvent);
+    }
+
+    if (WaitContext->ThreadCount > 0) {
+        WaitForMultipleObjectsEx(WaitContext->ThreadCount, WaitContext->ThreadHandles, TRUE, INFINITE, FALSE);
+    }
+
+    for (Index = 0; Index < WaitContext->ThreadCount; Index++) {
+        Group = &WaitContext->Groups[Index];
+        CloseHandle(WaitContext->ThreadHandles[Index]);
+        CloseHandle(Group->StartEvent);
+        CloseHandle(Group->CompleteEvent);
+    }
+
+    WaitContext->ThreadCount = 0;
+    YoriLibFree(WaitContext->Groups);
+    WaitContext->Groups = NULL;
+    CloseHandle(WaitContext->CancelEvent);
+    WaitContext->CancelEvent = NULL;
+}
+
+/**
+ Wait for any one of an array of child processes to complete.  If there are
+ more processes than WaitForMultipleObjects can wait for, the processes are
+ divided into groups, each of which is waited for by a helper thread, and
+ this thread waits for any helper thread to observe a completion.  Helper
+ threads are started when first needed and reused for later waits.
+
+ @param WaitContext Pointer to the wait context.
+
+ @param HandleCount The number of processes to wait for.
+
+ @param ProcessHandleArray Pointer to an array of process handles.
+
+ @return The index within the array of the process that completed.
+ */
+DWORD
+MakeWaitForChildProcess(
+    __in PMAKE_WAIT_CONTEXT WaitContext,
+    __in DWORD HandleCount,
+    __in_ecount(HandleCount) HANDLE *ProcessHandleArray
+    )
+{
+    DWORD HandlesPerGroup;
+    DWORD GroupCount;
+    DWORD GroupsStarted;
+    DWORD Result;
+    PMAKE_WAIT_GROUP Group;
+
+    if (HandleCount <= MAXIMUM_WAIT_OBJECTS) {
+        Result = WaitForMultipleObjectsEx(HandleCount, ProcessHandleArray, FALSE, INFINITE, FALSE);
+        return Result - WAIT_OBJECT_0;
+    }
+
+    ASSERT(WaitContext->Groups != NULL && WaitContext->CancelEvent != NULL);
+
+    HandlesPerGroup = MAXIMUM_WAIT_OBJECTS - 1;
+    GroupCount = (HandleCount + HandlesPerGroup - 1) / HandlesPerGroup;
+    ASSERT(GroupCount <= MAXIMUM_WAIT_OBJECTS);
+
+    for (GroupsStarted = 0; GroupsStarted < GroupCount; GroupsStarted++) {
+        if (GroupsStarted == WaitContext->ThreadCount &&
+            !MakeStartWaitGroupThread(WaitContext)) {
+
+            break;
+        }
+
+        Group = &WaitContext->Groups[GroupsStarted];
+        Group->FirstIndex = GroupsStarted * HandlesPerGroup;
+        Group->HandleCount = HandleCount - Group->FirstIndex;
+        if (Group->HandleCount > HandlesPerGroup) {
+            Group->HandleCount = HandlesPerGroup;
+        }
+        Group->Handles[0] = WaitContext->CancelEvent;
+        memcpy(&Group->Handles[1], &ProcessHandleArray[Group->FirstIndex], Group->HandleCount * sizeof(HANDLE));
+        Group->HandleCount++;
+        Group->WaitResult = WAIT_FAILED;
+        ResetEvent(Group->CompleteEvent);
+        SetEvent(Group->StartEvent);
+    }
+
+    //
+    //  If every group is being waited for, wait for one of them to observe
+    //  a process completion.
+    //
+
+    if (GroupsStarted == GroupCount) {
+        Result = WaitForMultipleObjectsEx(GroupCount, WaitContext->CompleteEvents, FALSE, INFINITE, FALSE);
+        Group = &WaitContext->Groups[Result - WAIT_OBJECT_0];
+        MakeCancelWaitGroups(WaitContext, GroupCount);
+        Result = Group->WaitResult;
+
+        if (Result > WAIT_OBJECT_0 && Result < WAIT_OBJECT_0 + Group->HandleCount) {
+            return Group->FirstIndex + Result - WAIT_OBJECT_0 - 1;
+        }
+    } else {
+        MakeCancelWaitGroups(WaitContext, GroupsStarted);
+    }
+
+    //
+    //  If helper threads could not be used, wait for the first group of
+    //  processes directly.  The others will be waited for as these complete.
+    //
+
+    Result = WaitForMultipleObjectsEx(MAXIMUM_WAIT_OBJECTS, ProcessHandleArray, FALSE, INFINITE, FALSE);
+    return Result - WAIT_OBJECT_0;
+}
+
 /**
  Execute commands required to build the requested target.
 
@@ -1012,6 +1509,10 @@ MakeExecuteRequiredTargets(
     DWORD Index;
     HANDLE *ProcessHandleArray;
     PMAKE_CHILD_RECIPE ChildRecipeArray;
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_TARGET Target;
+    LARGE_INTEGER CurrentTime;
+    MAKE_WAIT_CONTEXT WaitContext;
     BOOLEAN Result;
     BOOLEAN MoveToNextTarget;
     BOOLEAN TargetFailureObserved;
@@ -1019,8 +1520,33 @@ MakeExecuteRequiredTargets(
     NumberActiveProcesses = 0;
     TargetFailureObserved = FALSE;
 
+    ASSERT(MakeContext->NumberProcesses <= MAKE_MAX_PROCESSES);
+    ZeroMemory(&WaitContext, sizeof(WaitContext));
+
+    //
+    //  If more processes can execute than WaitForMultipleObjects can wait
+    //  for, prepare to wait for them in groups on helper threads.
+    //
+
+    if (MakeContext->NumberProcesses > MAXIMUM_WAIT_OBJECTS) {
+        WaitContext.CancelEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        if (WaitContext.CancelEvent == NULL) {
+            return FALSE;
+        }
+
+        WaitContext.Groups = YoriLibMalloc(MAXIMUM_WAIT_OBJECTS * sizeof(MAKE_WAIT_GROUP));
+        if (WaitContext.Groups == NULL) {
+            CloseHandle(WaitContext.CancelEvent);
+            return FALSE;
+        }
+    }
+
     ProcessHandleArray = YoriLibMalloc(MakeContext->NumberProcesses * sizeof(HANDLE));
     if (ProcessHandleArray == NULL) {
+        if (WaitContext.Groups != NULL) {
+            YoriLibFree(WaitContext.Groups);
+            CloseHandle(WaitContext.CancelEvent);
+        }
         return FALSE;
     }
 
@@ -1029,12 +1555,29 @@ MakeExecuteRequiredTargets(
     ChildRecipeArray = YoriLibMalloc(MakeContext->NumberProcesses * sizeof(MAKE_CHILD_RECIPE));
     if (ChildRecipeArray == NULL) {
         YoriLibFree(ProcessHandleArray);
+        if (WaitContext.Groups != NULL) {
+            YoriLibFree(WaitContext.Groups);
+            CloseHandle(WaitContext.CancelEvent);
+        }
         return FALSE;
     }
 
     ZeroMemory(ChildRecipeArray, MakeContext->NumberProcesses * sizeof(MAKE_CHILD_RECIPE));
     Result = TRUE;
 
+    //
+    //  Targets which were ready when the graph was constructed only start
+    //  waiting for a child process now.
+    //
+
+    QueryPerformanceCounter(&CurrentTime);
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsReady, NULL);
+    while (ListEntry != NULL) {
+        Target = CONTAINING_RECORD(ListEntry, MAKE_TARGET, RebuildList);
+        Target->ReadyTime = CurrentTime.QuadPart;
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsReady, ListEntry);
+    }
+
     while (TRUE) {
 
         while (NumberActiveProcesses < MakeContext->NumberProcesses && !YoriLibIsListEmpty(&MakeContext->TargetsReady)) {
@@ -1070,8 +1613,7 @@ MakeExecuteRequiredTargets(
             }
 
             if (Index == NumberActiveProcesses) {
-                Index = WaitForMultipleObjectsEx(NumberActiveProcesses, ProcessHandleArray, FALSE, INFINITE, FALSE);
-                Index = Index - WAIT_OBJECT_0;
+                Index = MakeWaitForChildProcess(&WaitContext, NumberActiveProcesses, ProcessHandleArray);
             }
 
             //
@@ -1102,6 +1644,7 @@ MakeExecuteRequiredTargets(
 
             if (MoveToNextTarget) {
                 if (Result) {
+                    MakeStoreTargetArtifact(MakeContext, ChildRecipeArray[Index].Target);
                     MakeUpdateDependenciesForTarget(MakeContext, ChildRecipeArray[Index].Target);
                 } else {
                     MakeRecipeCompletion(MakeContext, &ChildRecipeArray[Index]);
@@ -1166,8 +1709,7 @@ Drain:
         //
 
         if (Index == NumberActiveProcesses) {
-            Index = WaitForMultipleObjectsEx(NumberActiveProcesses, ProcessHandleArray, FALSE, INFINITE, FALSE);
-            Index = Index - WAIT_OBJECT_0;
+            Index = MakeWaitForChildProcess(&WaitContext, NumberActiveProcesses, ProcessHandleArray);
         }
 
         MakeProcessCompletion(MakeContext, &ChildRecipeArray[Index]);
@@ -1184,8 +1726,195 @@ Drain:
 
     YoriLibFree(ChildRecipeArray);
     YoriLibFree(ProcessHandleArray);
+    MakeCleanupWaitContext(&WaitContext);
 
     return Result;
 }
 
+/**
+ Display how long each target that was built waited in the ready list for a
+ child process to become available, and how long its recipe took to execute.
+
+ @param MakeContext Pointer to the context.
+ */
+VOID
+MakeDisplayTargetQueueTimes(
+    __in PMAKE_CONTEXT MakeContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_TARGET Target;
+    LARGE_INTEGER Frequency;
+    DWORDLONG QueueTime;
+    DWORDLONG ExecuteTime;
+
+    QueryPerformanceFrequency(&Frequency);
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("\nQueue ms   Exec ms  Critical  Target\n"));
+
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsFinished, NULL);
+    while (ListEntry != NULL) {
+        Target = CONTAINING_RECORD(ListEntry, MAKE_TARGET, RebuildList);
+        if (Target->LaunchTime != 0) {
+            QueueTime = (Target->LaunchTime - Target->ReadyTime) * 1000 / Frequency.QuadPart;
+            ExecuteTime = (Target->CompletionTime - Target->LaunchTime) * 1000 / Frequency.QuadPart;
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%8lli  %8lli  %8lli  %y\n"), QueueTime, ExecuteTime, Target->CriticalPathTime, &Target->HashEntry.Key);
+        }
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsFinished, ListEntry);
+    }
+}
+
+/**
+ Generate the name of the file used to record target durations from the
+ specified make file name.
+
+ @param MakeFileName Pointer to the make file name.
+
+ @param DurationFileName On successful completion, updated to contain a newly
+        allocated string referring to the file name of the duration file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+MakeGetDurationFileNameFromMakeFileName(
+    __in PYORI_STRING MakeFileName,
+    __out PYORI_STRING DurationFileName
+    )
+{
+    YoriLibInitEmptyString(DurationFileName);
+    if (MakeFileName->LengthInChars > 0) {
+        if (YoriLibAllocateString(DurationFileName, MakeFileName->LengthInChars + sizeof(".dur"))) {
+            DurationFileName->LengthInChars = YoriLibSPrintf(DurationFileName->StartOfString, _T("%y.dur"), MakeFileName);
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Load the time taken to build each target from a previous build.  Entries
+ for targets that are not known to this build are ignored.
+
+ @param MakeContext Pointer to the context.
+
+ @param MakeFileName Pointer to the file name of the makefile.  If this
+        contains a string, it will be used as the base name for the file.
+ */
+VOID
+MakeLoadTargetDurations(
+    __inout PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING MakeFileName
+    )
+{
+    PMAKE_TARGET Target;
+    PYORI_OPEN_HASH_ENTRY HashEntry;
+    YORI_STRING DurationFileName;
+    YORI_STRING Key;
+    YORI_STRING LineString;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+    YORI_MAX_SIGNED_T llTemp;
+    HANDLE hFile;
+    PVOID LineContext = NULL;
+
+    if (!MakeGetDurationFileNameFromMakeFileName(MakeFileName, &DurationFileName)) {
+        return;
+    }
+
+    hFile = CreateFile(DurationFileName.StartOfString, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    YoriLibFreeStringContents(&DurationFileName);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    YoriLibInitEmptyString(&LineString);
+
+    while (TRUE) {
+        if (!YoriLibReadLineToString(&LineString, &LineContext, hFile)) {
+            break;
+        }
+
+        //
+        //  The format of each line is expected to be:
+        //  DurationInMs:TargetName
+        //
+
+        if (!YoriLibStringToNumber(&LineString, FALSE, &llTemp, &CharsConsumed) ||
+            CharsConsumed == 0 ||
+            llTemp < 0 ||
+            CharsConsumed + 1 >= LineString.LengthInChars ||
+            LineString.StartOfString[CharsConsumed] != ':') {
+
+            break;
+        }
+
+        YoriLibInitEmptyString(&Key);
+        Key.StartOfString = &LineString.StartOfString[CharsConsumed + 1];
+        Key.LengthInChars = LineString.LengthInChars - CharsConsumed - 1;
+
+        HashEntry = YoriLibOpenHashLookupByKey(MakeContext->Targets, &Key);
+        if (HashEntry != NULL) {
+            Target = HashEntry->Context;
+            Target->RecordedDuration = (DWORD)llTemp;
+            Target->RecordedDurationFound = TRUE;
+        }
+    }
+
+    YoriLibLineReadCloseOrCache(LineContext);
+    YoriLibFreeStringContents(&LineString);
+    CloseHandle(hFile);
+}
+
+/**
+ Save the time taken to build each target so that a later build can launch
+ targets on the longest dependency chain first.  Targets built by this
+ build record their new duration; targets that were not built retain any
+ duration loaded from a previous build.
+
+ @param MakeContext Pointer to the context.
+
+ @param MakeFileName Pointer to the file name of the makefile.  If this
+        contains a string, it will be used as the base name for the file.
+ */
+VOID
+MakeSaveTargetDurations(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING MakeFileName
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_TARGET Target;
+    YORI_STRING DurationFileName;
+    LARGE_INTEGER Frequency;
+    DWORDLONG Duration;
+    HANDLE hFile;
+
+    if (!MakeGetDurationFileNameFromMakeFileName(MakeFileName, &DurationFileName)) {
+        return;
+    }
+
+    hFile = CreateFile(DurationFileName.StartOfString, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    YoriLibFreeStringContents(&DurationFileName);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    QueryPerformanceFrequency(&Frequency);
+
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsList, NULL);
+    while (ListEntry != NULL) {
+        Target = CONTAINING_RECORD(ListEntry, MAKE_TARGET, ListEntry);
+        if (Target->LaunchTime != 0 && Target->CompletionTime != 0) {
+            Duration = (Target->CompletionTime - Target->LaunchTime) * 1000 / Frequency.QuadPart;
+            YoriLibOutputToDevice(hFile, 0, _T("%lli:%y\n"), Duration, &Target->HashEntry.Key);
+        } else if (Target->RecordedDurationFound) {
+            YoriLibOutputToDevice(hFile, 0, _T("%i:%y\n"), Target->RecordedDuration, &Target->HashEntry.Key);
+        }
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsList, ListEntry);
+    }
+
+    CloseHandle(hFile);
+}
+
 // vim:sw=4:ts=4:et:
@@ -3,7 +3,7 @@
  *
  * Yori shell make program
  *
- * Copyright (c) 2020-2021 Malcolm J. Smith
+ * Copyright (c) 2020-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -37,17 +37,21 @@ CHAR strMakeHelpText[] =
         "\n"
         "Execute makefiles.\n"
         "\n"
-        "YMAKE [-license] [-f file] [-j n] [-m] [-perf] [-pru] [-s] [var=value] [target]\n"
+        "YMAKE [-license] [-cache dir] [-f file] [-graph] [-j n] [-m] [-perf] [-pru] [-s] [-spec] [-times] [var=value] [target]\n"
         "\n"
         "   --             Treat all further arguments as display parameters\n"
+        "   -cache         Restore targets whose inputs are unchanged from a cache directory\n"
         "   -f             Name of the makefile to use, default YMkFile or Makefile\n"
+        "   -graph         Cache the dependency graph to skip parsing unchanged makefiles\n"
         "   -j             The number of child processes, default number of processors+1\n"
         "   -k             Keep executing jobs after errors\n"
         "   -m             Perform tasks at low priority\n"
         "   -mm            Perform tasks at very low priority\n"
         "   -perf          Display how much time was spent in each phase of processing\n"
         "   -pru           Keep a cache of preprocessor recently executed results\n"
-        "   -s             Silently launch child processes\n";
+        "   -s             Silently launch child processes\n"
+        "   -spec          Launch preprocessor commands in parallel ahead of use\n"
+        "   -times         Record target build times so later builds start long chains first\n";
 
 
 /**
@@ -86,6 +90,7 @@ typedef struct _MAKE_DEFAULT_MACRO {
  to skip that extra parameter when parsing variables or targets.
  */
 CONST YORI_STRING MakeArgsWithParameter[] = {
+    YORILIB_CONSTANT_STRING(_T("cache")),
     YORILIB_CONSTANT_STRING(_T("f")),
     YORILIB_CONSTANT_STRING(_T("j"))
 };
@@ -367,6 +372,7 @@ ENTRYPOINT(
     YORI_ALLOC_SIZE_T CharsConsumed;
     MAKE_PRIORITY Priority;
     BOOLEAN ExplicitTargetFound;
+    BOOLEAN GraphCacheRequested;
     WORD PerformanceProcessors;
     WORD EfficiencyProcessors;
 
@@ -381,9 +387,13 @@ ENTRYPOINT(
     YoriLibInitializeListHead(&MakeContext.TargetsReady);
     YoriLibInitializeListHead(&MakeContext.TargetsWaiting);
     YoriLibInitializeListHead(&MakeContext.PreprocessorCacheList);
+    YoriLibInitializeListHead(&MakeContext.ProbeCacheList);
+    YoriLibInitializeListHead(&MakeContext.SpeculationList);
+    YoriLibInitializeListHead(&MakeContext.GraphCacheInputList);
     YoriLibInitEmptyString(&FullFileName);
     Priority = MakePriorityNormal;
     ExplicitTargetFound = FALSE;
+    GraphCacheRequested = FALSE;
 
     {
         MAKE_BUILTIN_NAME_MAPPING CONST *BuiltinNameMapping = MakeBuiltinCmds;
@@ -437,18 +447,30 @@ ENTRYPOINT(
         MakeContext.TempPath.LengthInChars--;
     }
 
-    MakeContext.Scopes = YoriLibAllocateHashTable(1000);
+    MakeContext.Scopes = YoriLibAllocateOpenHashTable(1000);
     if (MakeContext.Scopes == NULL) {
         Result = EXIT_FAILURE;
         goto Cleanup;
     }
 
-    MakeContext.Targets = YoriLibAllocateHashTable(4000);
+    MakeContext.Targets = YoriLibAllocateOpenHashTable(4000);
     if (MakeContext.Targets == NULL) {
         Result = EXIT_FAILURE;
         goto Cleanup;
     }
 
+    MakeContext.ProbeDirectories = YoriLibAllocateOpenHashTable(100);
+    if (MakeContext.ProbeDirectories == NULL) {
+        Result = EXIT_FAILURE;
+        goto Cleanup;
+    }
+
+    MakeContext.ProbeFiles = YoriLibAllocateOpenHashTable(4000);
+    if (MakeContext.ProbeFiles == NULL) {
+        Result = EXIT_FAILURE;
+        goto Cleanup;
+    }
+
     for (i = 1; i < ArgC; i++) {
 
         ArgumentUnderstood = FALSE;
@@ -463,6 +485,15 @@ ENTRYPOINT(
                 YoriLibDisplayMitLicense(_T("2021"));
                 Result = EXIT_SUCCESS;
                 goto Cleanup;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("cache")) == 0) {
+                if (i + 1 < ArgC) {
+                    YoriLibFreeStringContents(&MakeContext.ArtifactCacheDir);
+                    if (YoriLibUserToSingleFilePath(&ArgV[i + 1], TRUE, &MakeContext.ArtifactCacheDir)) {
+                        ArgumentUnderstood = TRUE;
+                    } else {
+                        YoriLibInitEmptyString(&MakeContext.ArtifactCacheDir);
+                    }
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("f")) == 0) {
                 if (i + 1 < ArgC) {
                     FileName = &ArgV[i + 1];
@@ -478,6 +509,16 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("k")) == 0) {
                 MakeContext.KeepGoing = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("graph")) == 0) {
+                if (MakeContext.GraphCacheInputs == NULL) {
+                    MakeContext.GraphCacheInputs = YoriLibAllocateOpenHashTable(100);
+                    if (MakeContext.GraphCacheInputs == NULL) {
+                        Result = EXIT_FAILURE;
+                        goto Cleanup;
+                    }
+                }
+                GraphCacheRequested = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("m")) == 0) {
                 Priority = MakePriorityLow;
                 ArgumentUnderstood = TRUE;
@@ -491,7 +532,7 @@ ENTRYPOINT(
                 ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("pru")) == 0) {
                 if (MakeContext.PreprocessorCache == NULL) {
-                    MakeContext.PreprocessorCache = YoriLibAllocateHashTable(100);
+                    MakeContext.PreprocessorCache = YoriLibAllocateOpenHashTable(100);
                     if (MakeContext.PreprocessorCache == NULL) {
                         Result = EXIT_FAILURE;
                         goto Cleanup;
@@ -502,6 +543,12 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("s")) == 0) {
                 MakeContext.SilentCommandLaunching = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("spec")) == 0) {
+                MakeContext.SpeculatePreprocessor = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("times")) == 0) {
+                MakeContext.RecordTargetDurations = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("wundef")) == 0) {
                 MakeContext.WarnOnUndefinedVariable = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -541,6 +588,19 @@ ENTRYPOINT(
         StartArg = ArgC;
     }
 
+    //
+    //  If an artifact cache was requested, create its directory now so that
+    //  targets can be added to it as they are built.
+    //
+
+    if (MakeContext.ArtifactCacheDir.LengthInChars > 0) {
+        if (!YoriLibCreateDirectoryAndParents(&MakeContext.ArtifactCacheDir)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Could not create artifact cache directory %y\n"), &MakeContext.ArtifactCacheDir);
+            Result = EXIT_FAILURE;
+            goto Cleanup;
+        }
+    }
+
     //
     //  If -j isn't specified, attempt to set the number of jobs based on the
     //  environment variable.
@@ -609,12 +669,14 @@ ENTRYPOINT(
     }
 
     //
-    //  WaitForMultipleObjects has a limit of 64 things to wait for, so this
-    //  program can't currently have more than 64 children.
+    //  WaitForMultipleObjects has a limit of 64 things to wait for.  Beyond
+    //  that, children are waited for in groups by helper threads, but the
+    //  main thread still waits for those with WaitForMultipleObjects, which
+    //  gives an upper bound.
     //
 
-    if (MakeContext.NumberProcesses > 64) {
-        MakeContext.NumberProcesses = 64;
+    if (MakeContext.NumberProcesses > MAKE_MAX_PROCESSES) {
+        MakeContext.NumberProcesses = MAKE_MAX_PROCESSES;
     }
 
     //
@@ -730,31 +792,53 @@ ENTRYPOINT(
         MakeLoadPreprocessorCacheEntries(&MakeContext, &FullFileName);
     }
 
-    hStream = CreateFile(FullFileName.StartOfString, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL);
-    if (hStream == INVALID_HANDLE_VALUE) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("No makefile found\n"));
-        Result = EXIT_FAILURE;
-        goto Cleanup;
-    }
-
     //
-    //  Preprocess the makefile
+    //  When caching the dependency graph, try to load the graph from a
+    //  previous build.  If nothing it depends on has changed, this replaces
+    //  preprocessing the makefile.
     //
 
-    QueryPerformanceCounter(&StartTime);
-    MakeProcessStream(hStream, &MakeContext, &FullFileName);
-    QueryPerformanceCounter(&EndTime);
+    if (MakeContext.GraphCacheInputs != NULL) {
+        MakeCalculateGraphCacheArgsHash(&MakeContext, ArgC, ArgV, &FullFileName);
+        QueryPerformanceCounter(&StartTime);
+        MakeContext.GraphCacheHit = MakeLoadGraphCache(&MakeContext, &FullFileName);
+        QueryPerformanceCounter(&EndTime);
+        MakeContext.TimeInPreprocessor = EndTime.QuadPart - StartTime.QuadPart;
 
-    MakeContext.TimeInPreprocessor = EndTime.QuadPart - StartTime.QuadPart;
+        if (MakeContext.ErrorTermination) {
+            Result = EXIT_FAILURE;
+            goto Cleanup;
+        }
+    }
 
-    CloseHandle(hStream);
+    if (!MakeContext.GraphCacheHit) {
+        hStream = CreateFile(FullFileName.StartOfString, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL);
+        if (hStream == INVALID_HANDLE_VALUE) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("No makefile found\n"));
+            Result = EXIT_FAILURE;
+            goto Cleanup;
+        }
 
-    if (MakeContext.ErrorTermination) {
-        Result = EXIT_FAILURE;
-        goto Cleanup;
-    }
+        //
+        //  Preprocess the makefile
+        //
+
+        QueryPerformanceCounter(&StartTime);
+        MakeProcessStream(hStream, &MakeContext, &FullFileName);
+        QueryPerformanceCounter(&EndTime);
+
+        MakeContext.TimeInPreprocessor = MakeContext.TimeInPreprocessor + EndTime.QuadPart - StartTime.QuadPart;
 
-    MakeFindInferenceRulesForScope(MakeContext.RootScope);
+        CloseHandle(hStream);
+        MakeDiscardSpeculativeCommands(&MakeContext);
+
+        if (MakeContext.ErrorTermination) {
+            Result = EXIT_FAILURE;
+            goto Cleanup;
+        }
+
+        MakeFindInferenceRulesForScope(MakeContext.RootScope);
+    }
 
     //
     //  Determine the tasks to execute
@@ -812,6 +896,26 @@ ENTRYPOINT(
         }
     }
 
+    //
+    //  Save the graph so a later build can skip preprocessing.  This is
+    //  done before executing any targets, since the graph describes the
+    //  makefiles rather than the state of the build.
+    //
+
+    if (MakeContext.GraphCacheInputs != NULL && !MakeContext.GraphCacheHit) {
+        MakeSaveGraphCache(&MakeContext, &FullFileName);
+    }
+
+    //
+    //  Order the targets that are ready to build so the ones with the
+    //  longest chain of work depending on them start first.  If durations
+    //  were recorded by a previous build, use those as the estimates, even
+    //  if this build is not recording them.
+    //
+
+    MakeLoadTargetDurations(&MakeContext, &FullFileName);
+    MakeCalculateCriticalPaths(&MakeContext);
+
     QueryPerformanceCounter(&EndTime);
     MakeContext.TimeBuildingGraph = EndTime.QuadPart - StartTime.QuadPart;
 
@@ -822,12 +926,23 @@ ENTRYPOINT(
     StartTime.QuadPart = EndTime.QuadPart;
     if (!MakeExecuteRequiredTargets(&MakeContext)) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Failed to build targets.\n"));
+        if (MakeContext.RecordTargetDurations) {
+            MakeSaveTargetDurations(&MakeContext, &FullFileName);
+        }
         Result = EXIT_FAILURE;
         goto Cleanup;
     }
     QueryPerformanceCounter(&EndTime);
     MakeContext.TimeInExecute = EndTime.QuadPart - StartTime.QuadPart;
 
+    if (MakeContext.RecordTargetDurations) {
+        MakeSaveTargetDurations(&MakeContext, &FullFileName);
+    }
+
+    if (MakeContext.PerfDisplay) {
+        MakeDisplayTargetQueueTimes(&MakeContext);
+    }
+
 
     Result = EXIT_SUCCESS;
 
@@ -835,6 +950,7 @@ Cleanup:
 
     QueryPerformanceCounter(&StartTime);
 
+    MakeDiscardSpeculativeCommands(&MakeContext);
     MakeDeleteInlineFiles(&MakeContext);
     MakeCleanupTemporaryDirectories(&MakeContext);
 
@@ -851,15 +967,18 @@ Cleanup:
     MakeDeleteAllTargets(&MakeContext);
 
     if (MakeContext.Targets != NULL) {
-        YoriLibFreeEmptyHashTable(MakeContext.Targets);
+        YoriLibFreeEmptyOpenHashTable(MakeContext.Targets);
     }
 
     MakeDeleteAllScopes(&MakeContext);
     MakeSaveAndDeleteAllPreprocessorCacheEntries(&MakeContext, &FullFileName);
+    MakeDeleteGraphCacheInputs(&MakeContext);
+    MakeDeleteProbeCache(&MakeContext);
 
     YoriLibFreeStringContents(&FullFileName);
 
     YoriLibFreeStringContents(&MakeContext.TempPath);
+    YoriLibFreeStringContents(&MakeContext.ArtifactCacheDir);
     YoriLibFreeStringContents(&MakeContext.ProcessCurrentDirectory);
     YoriLibFreeStringContents(&MakeContext.FilesToProbe[0]);
     YoriLibFreeStringContents(&MakeContext.FilesToProbe[1]);
@@ -884,13 +1003,28 @@ Cleanup:
         MakeContext.TimeInPreprocessor = MakeContext.TimeInPreprocessor * 1000 / Frequency.QuadPart;
         MakeContext.TimeBuildingGraph = MakeContext.TimeBuildingGraph * 1000 / Frequency.QuadPart;
         MakeContext.TimeInExecute = MakeContext.TimeInExecute * 1000 / Frequency.QuadPart;
+        MakeContext.TimeWaitingInQueue = MakeContext.TimeWaitingInQueue * 1000 / Frequency.QuadPart;
         MakeContext.TimeInCleanup = MakeContext.TimeInCleanup * 1000 / Frequency.QuadPart;
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("\n"));
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Time in preprocessor child processes: %lli ms\n"), MakeContext.TimeInPreprocessorCreateProcess);
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Time in preprocessor: %lli ms\n"), MakeContext.TimeInPreprocessor);
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Time building graph: %lli ms\n"), MakeContext.TimeBuildingGraph);
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Time executing commands: %lli ms\n"), MakeContext.TimeInExecute);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Time targets waited in queue (total): %lli ms\n"), MakeContext.TimeWaitingInQueue);
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Time cleaning up: %lli ms\n"), MakeContext.TimeInCleanup);
+        if (MakeContext.GraphCacheHit) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Dependency graph cache: hit\n"));
+        } else if (GraphCacheRequested) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Dependency graph cache: miss\n"));
+        }
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("File probes from directory cache: %i (%i directories enumerated)\n"), MakeContext.ProbesFromCache, MakeContext.ProbeDirectoriesEnumerated);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("File probes queried directly: %i\n"), MakeContext.ProbesDirect);
+        if (MakeContext.SpeculatePreprocessor) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Preprocessor commands launched early: %i (%i used)\n"), MakeContext.SpeculationsLaunched, MakeContext.SpeculationsUsed);
+        }
+        if (MakeContext.ArtifactCacheDir.LengthInChars > 0) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Artifact cache: %i hits, %i misses, %i stored\n"), MakeContext.ArtifactCacheHits, MakeContext.ArtifactCacheMisses, MakeContext.ArtifactCacheStores);
+        }
 
 #if MAKE_DEBUG_PERF
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Number dependency allocs: %i\n"), MakeContext.AllocDependency);
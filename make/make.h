@@ -3,7 +3,7 @@
  *
  * Yori shell make master header
  *
- * Copyright (c) 2020-2021 Malcolm J. Smith
+ * Copyright (c) 2020-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -58,6 +58,34 @@
  */
 #define MAKE_DEBUG_PERF         0
 
+/**
+ The maximum number of child processes that can execute concurrently.  The
+ main thread can wait on MAXIMUM_WAIT_OBJECTS helper threads, each of which
+ waits for a cancel event and MAXIMUM_WAIT_OBJECTS - 1 child processes.
+ */
+#define MAKE_MAX_PROCESSES (MAXIMUM_WAIT_OBJECTS * (MAXIMUM_WAIT_OBJECTS - 1))
+
+/**
+ The number of bits in each element of the job identifier bitmaps.
+ */
+#define MAKE_JOB_BITMAP_BITS (sizeof(DWORD) * 8)
+
+/**
+ The estimated time in milliseconds to execute each command of a target
+ whose duration was not recorded by a previous build.
+ */
+#define MAKE_DEFAULT_CMD_DURATION 1000
+
+/**
+ The initial value of a 64 bit FNV-1a hash.
+ */
+#define MAKE_FNV1A64_OFFSET_BASIS (((DWORDLONG)0xcbf29ce4 << 32) | 0x84222325)
+
+/**
+ The multiplier of a 64 bit FNV-1a hash.
+ */
+#define MAKE_FNV1A64_PRIME (((DWORDLONG)0x00000100 << 32) | 0x000001b3)
+
 
 /**
  A structure to record information about how to allocate fixed sized
@@ -99,7 +127,7 @@ typedef struct _MAKE_PREPROC_EXEC_CACHE_ENTRY {
      if a different compilation environment is used, the cache will not
      match.
      */
-    YORI_HASH_ENTRY HashEntry;
+    YORI_OPEN_HASH_ENTRY HashEntry;
 
     /**
      A list of all entries to facilitate efficient teardown.
@@ -113,6 +141,79 @@ typedef struct _MAKE_PREPROC_EXEC_CACHE_ENTRY {
 
 } MAKE_PREPROC_EXEC_CACHE_ENTRY, *PMAKE_PREPROC_EXEC_CACHE_ENTRY;
 
+/**
+ A preprocessor command which has been launched before the preprocessor
+ reached it.  Its output is buffered so that it can be displayed when the
+ preprocessor consumes the result, keeping output in makefile order.
+ */
+typedef struct _MAKE_PREPROC_SPECULATION {
+
+    /**
+     The list of outstanding speculative commands, in the order they were
+     launched.  Paired with MAKE_CONTEXT::SpeculationList.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The command after variable expansion.  The result can only be used if
+     the preprocessor later executes exactly this command.
+     */
+    YORI_STRING Cmd;
+
+    /**
+     The parsed form of the command.
+     */
+    YORI_LIBSH_CMD_CONTEXT CmdContext;
+
+    /**
+     The plan used to execute the command, containing the process handle
+     and output buffer.
+     */
+    YORI_LIBSH_EXEC_PLAN ExecPlan;
+
+} MAKE_PREPROC_SPECULATION, *PMAKE_PREPROC_SPECULATION;
+
+/**
+ The lines of a makefile which is being preprocessed, read in advance so
+ that later preprocessor commands can be found and launched early.
+ */
+typedef struct _MAKE_PREPROC_LOOKAHEAD {
+
+    /**
+     An array of lines.  Each refers to memory within Text.
+     */
+    PYORI_STRING Lines;
+
+    /**
+     The number of elements in Lines.
+     */
+    DWORD LineCount;
+
+    /**
+     The index of the line currently being processed.
+     */
+    DWORD CurrentLine;
+
+    /**
+     The index of the first line that has not yet been scanned for
+     commands to launch.
+     */
+    DWORD NextLineToScan;
+
+    /**
+     Set to TRUE if scanning stopped at the start or end of a conditional
+     block.  Lines from NextLineToScan onwards may not be evaluated, so they
+     are not scanned until the preprocessor reaches them.
+     */
+    BOOLEAN ScanReachedBlock;
+
+    /**
+     The contents of every line.
+     */
+    YORI_STRING Text;
+
+} MAKE_PREPROC_LOOKAHEAD, *PMAKE_PREPROC_LOOKAHEAD;
+
 /**
  The name of the default target within a scope.  This refers to the first
  user defined target within the scope.  Note this name is chosen to be an
@@ -184,7 +285,7 @@ typedef struct _MAKE_SCOPE_CONTEXT {
      refers to the path that contains the original makefile being built,
      without being updated for includes.
      */
-    YORI_HASH_ENTRY HashEntry;
+    YORI_OPEN_HASH_ENTRY HashEntry;
 
     /**
      The list entry for the scope to facilitate easy cleanup.
@@ -259,6 +360,12 @@ typedef struct _MAKE_SCOPE_CONTEXT {
      */
     BOOLEAN ActiveConditionalNestingLevelExecutionOccurred;
 
+    /**
+     The index of this scope within the dependency graph cache.  This is
+     only meaningful while the cache is being written.
+     */
+    DWORD CacheIndex;
+
 } MAKE_SCOPE_CONTEXT, *PMAKE_SCOPE_CONTEXT;
 
 
@@ -449,7 +556,7 @@ typedef struct _MAKE_TARGET {
     /**
      The hash entry.  Key is fully qualified path name.
      */
-    YORI_HASH_ENTRY HashEntry;
+    YORI_OPEN_HASH_ENTRY HashEntry;
 
     /**
      A list of MAKE_TARGET_DEPENDENCY objects that this target depends upon.
@@ -495,6 +602,38 @@ typedef struct _MAKE_TARGET {
      */
     DWORD NumberParentsToBuild;
 
+    /**
+     The time in milliseconds that the recipe for this target took to execute
+     in a previous build.  This is only meaningful if RecordedDurationFound
+     is TRUE.
+     */
+    DWORD RecordedDuration;
+
+    /**
+     The estimated time in milliseconds to execute the recipe for this target
+     and the longest chain of targets that cannot start until this target
+     has completed.  Ready targets with a longer critical path are launched
+     first.
+     */
+    DWORDLONG CriticalPathTime;
+
+    /**
+     The time when this target became ready to execute.  This is when it
+     was added to the ready list, or when execution started if it was ready
+     when the graph was constructed.
+     */
+    DWORDLONG ReadyTime;
+
+    /**
+     The time when the recipe for this target started executing.
+     */
+    DWORDLONG LaunchTime;
+
+    /**
+     The time when the recipe for this target finished executing.
+     */
+    DWORDLONG CompletionTime;
+
     /**
      TRUE if an explicit recipe has been found.  That line may list
      dependencies only (ie., the recipe may have no tasks to perform) but
@@ -555,6 +694,16 @@ typedef struct _MAKE_TARGET {
      */
     BOOLEAN InferenceRulePseudoTarget;
 
+    /**
+     TRUE if RecordedDuration has been loaded from a previous build.
+     */
+    BOOLEAN RecordedDurationFound;
+
+    /**
+     TRUE if CriticalPathTime has been calculated.
+     */
+    BOOLEAN CriticalPathCalculated;
+
     /**
      The timestamp of the file.  This is only meaningful if FileExists is
      TRUE (implying FileProbed is also TRUE.)
@@ -583,12 +732,60 @@ typedef struct _MAKE_TARGET {
      */
     YORI_STRING Recipe;
 
+    /**
+     The source file of the inference rule that was used to construct this
+     target, as loaded from the dependency graph cache.  When the graph is
+     loaded from the cache no inference rules exist, so this is used to
+     expand $< instead.
+     */
+    YORI_STRING CachedInferenceSource;
+
     /**
      The set of commands to execute to construct this target.  Paired with
      MAKE_CMD_TO_EXEC::ListEntry .
      */
     YORI_LIST_ENTRY ExecCmds;
 
+    /**
+     The index of this target within the dependency graph cache.  This is
+     only meaningful while the cache is being written.
+     */
+    DWORD CacheIndex;
+
+    /**
+     A hash of the contents of the target's file.  This is only meaningful
+     if ContentHashCalculated is TRUE.
+     */
+    DWORDLONG ContentHash;
+
+    /**
+     A hash of everything that can affect the output of this target, used
+     to locate its output in the artifact cache.  This is only meaningful if
+     ArtifactFingerprintValid is TRUE.
+     */
+    DWORDLONG ArtifactFingerprint;
+
+    /**
+     The system time when the artifact cache was checked for this target,
+     immediately before its recipe is executed.
+     */
+    LONGLONG ArtifactStartTime;
+
+    /**
+     TRUE if ContentHash has been calculated.
+     */
+    BOOLEAN ContentHashCalculated;
+
+    /**
+     TRUE if the artifact cache has been checked for this target.
+     */
+    BOOLEAN ArtifactLookupAttempted;
+
+    /**
+     TRUE if ArtifactFingerprint has been calculated.
+     */
+    BOOLEAN ArtifactFingerprintValid;
+
 } MAKE_TARGET, *PMAKE_TARGET;
 
 /**
@@ -616,6 +813,93 @@ typedef struct _MAKE_INLINE_FILE {
     HANDLE FileHandle;
 } MAKE_INLINE_FILE, *PMAKE_INLINE_FILE;
 
+/**
+ The result of querying a file or directory from an enumeration of its
+ parent directory.  Entries for directories that have been enumerated are
+ kept in MAKE_CONTEXT::ProbeDirectories, and entries for the files found
+ within them are kept in MAKE_CONTEXT::ProbeFiles.
+ */
+typedef struct _MAKE_PROBE_CACHE_ENTRY {
+
+    /**
+     The hash entry for the file.  The key is the fully qualified path.
+     */
+    YORI_OPEN_HASH_ENTRY HashEntry;
+
+    /**
+     The list entry for the file.  Paired with
+     MAKE_CONTEXT::ProbeCacheList.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     For a file, the attributes of the file.  For an enumerated directory,
+     FILE_ATTRIBUTE_DIRECTORY if every file within it has an entry, (DWORD)-1
+     if the directory does not exist, or zero if the directory could not be
+     enumerated so each file within it must be queried directly.
+     */
+    DWORD FileAttributes;
+
+    /**
+     The last write time of the file.
+     */
+    LARGE_INTEGER LastWriteTime;
+
+    /**
+     TRUE if this entry describes an enumerated directory and is in
+     MAKE_CONTEXT::ProbeDirectories, FALSE if it describes a file found by
+     enumeration and is in MAKE_CONTEXT::ProbeFiles.
+     */
+    BOOLEAN EnumeratedDirectory;
+
+} MAKE_PROBE_CACHE_ENTRY, *PMAKE_PROBE_CACHE_ENTRY;
+
+/**
+ The kind of file system state that a dependency graph depends on.
+ */
+typedef enum _MAKE_GRAPH_CACHE_INPUT_TYPE {
+    MakeGraphCacheInputFileContents = 0,
+    MakeGraphCacheInputFileExists = 1,
+    MakeGraphCacheInputFileMissing = 2
+} MAKE_GRAPH_CACHE_INPUT_TYPE;
+
+/**
+ A file whose contents or existence was used to construct the dependency
+ graph.  If any of these change, a cached graph cannot be used.
+ */
+typedef struct _MAKE_GRAPH_CACHE_INPUT {
+
+    /**
+     The hash entry for the input.  The key is the file name.  Paired with
+     MAKE_CONTEXT::GraphCacheInputs.
+     */
+    YORI_OPEN_HASH_ENTRY HashEntry;
+
+    /**
+     The list entry for the input, in the order they were found.  Paired
+     with MAKE_CONTEXT::GraphCacheInputList.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     Indicates whether the contents of the file were consumed or whether its
+     existence was checked.
+     */
+    MAKE_GRAPH_CACHE_INPUT_TYPE InputType;
+
+    /**
+     The size of the file.  Only meaningful for MakeGraphCacheInputFileContents.
+     */
+    DWORDLONG FileSize;
+
+    /**
+     A hash of the contents of the file.  Only meaningful for
+     MakeGraphCacheInputFileContents.
+     */
+    DWORDLONG ContentHash;
+
+} MAKE_GRAPH_CACHE_INPUT, *PMAKE_GRAPH_CACHE_INPUT;
+
 /**
  Current state of the operation.
  */
@@ -649,7 +933,7 @@ typedef struct _MAKE_CONTEXT {
     /**
      A hash table of scopes whose key is their directory.
      */
-    PYORI_HASH_TABLE Scopes;
+    PYORI_OPEN_HASH_TABLE Scopes;
 
     /**
      A list of known scopes, used to facilitate bulk delete.
@@ -668,7 +952,7 @@ typedef struct _MAKE_CONTEXT {
      as dependencies even if they are assumed to already exist (source files.)
      The key of this hash table is fully qualified path.
      */
-    PYORI_HASH_TABLE Targets;
+    PYORI_OPEN_HASH_TABLE Targets;
 
     /**
      A list of known targets, used to facilitate bulk delete.
@@ -700,13 +984,60 @@ typedef struct _MAKE_CONTEXT {
     /**
      A hash table of cached preprocessor commands.
      */
-    PYORI_HASH_TABLE PreprocessorCache;
+    PYORI_OPEN_HASH_TABLE PreprocessorCache;
 
     /**
      A list of known preprocessor scope entries, used to facilitate bulk delete.
      */
     YORI_LIST_ENTRY PreprocessorCacheList;
 
+    /**
+     A list of preprocessor commands which have been launched speculatively
+     and whose result has not yet been consumed.
+     */
+    YORI_LIST_ENTRY SpeculationList;
+
+    /**
+     The lines of the makefile currently being preprocessed, if preprocessor
+     commands are being launched speculatively.
+     */
+    PMAKE_PREPROC_LOOKAHEAD ActiveLookahead;
+
+    /**
+     A hash table of directories which have been enumerated to answer file
+     probes.  The key is the directory name.
+     */
+    PYORI_OPEN_HASH_TABLE ProbeDirectories;
+
+    /**
+     A hash table of files found by enumerating directories.  The key is the
+     fully qualified file name.
+     */
+    PYORI_OPEN_HASH_TABLE ProbeFiles;
+
+    /**
+     A list of all probe cache entries, used to facilitate bulk delete.
+     */
+    YORI_LIST_ENTRY ProbeCacheList;
+
+    /**
+     A hash table of files used to construct the dependency graph.  This is
+     only allocated if the dependency graph cache is in use.
+     */
+    PYORI_OPEN_HASH_TABLE GraphCacheInputs;
+
+    /**
+     A list of files used to construct the dependency graph, in the order
+     they were found.
+     */
+    YORI_LIST_ENTRY GraphCacheInputList;
+
+    /**
+     A hash of the command line arguments, current directory and program
+     version.  A cached dependency graph is only used if this matches.
+     */
+    DWORDLONG GraphCacheArgsHash;
+
     /**
      Allocations used to generate files to look for when determining which
      inference rules to apply.  Because these are very temporary, they are
@@ -724,14 +1055,21 @@ typedef struct _MAKE_CONTEXT {
     YORI_STRING TempPath;
 
     /**
-     A bitmask representing which job IDs have been allocated.
+     The directory containing outputs of previously built targets, named by
+     the fingerprint of their inputs.  If empty, the artifact cache is not
+     used.
      */
-    DWORDLONG JobIdsAllocated;
+    YORI_STRING ArtifactCacheDir;
 
     /**
-     A bitmask representing temporary directories which have been created.
+     A bitmap representing which job IDs have been allocated.
      */
-    DWORDLONG TempDirectoriesCreated;
+    DWORD JobIdsAllocated[MAKE_MAX_PROCESSES / MAKE_JOB_BITMAP_BITS];
+
+    /**
+     A bitmap representing temporary directories which have been created.
+     */
+    DWORD TempDirectoriesCreated[MAKE_MAX_PROCESSES / MAKE_JOB_BITMAP_BITS];
 
     /**
      The time taken to execute processes as part of preprocessor commands.
@@ -753,6 +1091,12 @@ typedef struct _MAKE_CONTEXT {
      */
     DWORDLONG TimeInExecute;
 
+    /**
+     The total time that targets spent in the ready list waiting for a
+     child process to become available.
+     */
+    DWORDLONG TimeWaitingInQueue;
+
     /**
      The time spent cleaning up state, mainly freeing memory.
      */
@@ -788,10 +1132,56 @@ typedef struct _MAKE_CONTEXT {
      */
     DWORD AllocExpandedLine;
 
+    /**
+     The number of directories enumerated to answer file probes.
+     */
+    DWORD ProbeDirectoriesEnumerated;
+
+    /**
+     The number of file probes answered from directory enumerations.
+     */
+    DWORD ProbesFromCache;
+
+    /**
+     The number of file probes that required opening the file.
+     */
+    DWORD ProbesDirect;
+
+    /**
+     The number of entries in SpeculationList.
+     */
+    DWORD SpeculationsOutstanding;
+
+    /**
+     The number of preprocessor commands launched speculatively.
+     */
+    DWORD SpeculationsLaunched;
+
+    /**
+     The number of speculatively launched preprocessor commands whose
+     result was used.
+     */
+    DWORD SpeculationsUsed;
+
+    /**
+     The number of targets restored from the artifact cache.
+     */
+    DWORD ArtifactCacheHits;
+
+    /**
+     The number of targets checked in the artifact cache and not found.
+     */
+    DWORD ArtifactCacheMisses;
+
+    /**
+     The number of targets added to the artifact cache.
+     */
+    DWORD ArtifactCacheStores;
+
     /**
      The number of child processes to execute concurrently.  This defaults
-     to the number of logical processors, but is limited to 64 due to
-     WaitForMultipleObjects.
+     to the number of logical processors, but is limited to
+     MAKE_MAX_PROCESSES.
      */
     YORI_ALLOC_SIZE_T NumberProcesses;
 
@@ -814,11 +1204,29 @@ typedef struct _MAKE_CONTEXT {
      */
     BOOLEAN PerfDisplay;
 
+    /**
+     TRUE to record the time taken to build each target so that a later
+     build can launch targets on the longest dependency chain first.
+     */
+    BOOLEAN RecordTargetDurations;
+
     /**
      TRUE to indicate that EnvHash above has been calculated.
      */
     BOOLEAN EnvHashCalculated;
 
+    /**
+     TRUE if the dependency graph was loaded from the cache rather than by
+     preprocessing makefiles.
+     */
+    BOOLEAN GraphCacheHit;
+
+    /**
+     TRUE to scan ahead of the preprocessor and launch preprocessor commands
+     concurrently before their results are needed.
+     */
+    BOOLEAN SpeculatePreprocessor;
+
     /**
      TRUE to indicate that execution should continue after failure as much
      as possible.
@@ -926,6 +1334,24 @@ MakeFindMakefileInDirectory(
     __out PYORI_STRING FileName
     );
 
+VOID
+MakeSpeculatePreprocessorCommands(
+    __in PMAKE_SCOPE_CONTEXT ScopeContext
+    );
+
+__success(return)
+BOOLEAN
+MakeConsumeSpeculativeCommand(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING Cmd,
+    __out PDWORD ExitCode
+    );
+
+VOID
+MakeDiscardSpeculativeCommands(
+    __in PMAKE_CONTEXT MakeContext
+    );
+
 BOOL
 MakeProcessStream(
     __in HANDLE hSource,
@@ -950,6 +1376,13 @@ MakeDeleteInlineFiles(
     __in PMAKE_CONTEXT MakeContext
     );
 
+__success(return)
+BOOLEAN
+MakeGetEnvironmentHash(
+    __in PMAKE_CONTEXT MakeContext,
+    __out PDWORD EnvHash
+    );
+
 // *** SCOPE.C ***
 
 PMAKE_SCOPE_CONTEXT
@@ -1004,6 +1437,12 @@ MakeLookupTarget(
     __in PYORI_STRING TargetName
     );
 
+PMAKE_TARGET
+MakeAllocateTarget(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING FullPath
+    );
+
 PMAKE_TARGET
 MakeLookupOrCreateTarget(
     __in PMAKE_SCOPE_CONTEXT ScopeContext,
@@ -1050,6 +1489,18 @@ MakeDetermineDependencies(
     __in PMAKE_CONTEXT MakeContext
     );
 
+VOID
+MakeCalculateCriticalPaths(
+    __in PMAKE_CONTEXT MakeContext
+    );
+
+__success(return)
+BOOLEAN
+MakeBuildInferenceSourceName(
+    __in PMAKE_TARGET Target,
+    __out PYORI_STRING SourceName
+    );
+
 __success(return)
 BOOLEAN
 MakeExpandTargetVariable(
@@ -1059,6 +1510,100 @@ MakeExpandTargetVariable(
     __out PYORI_STRING VariableData
     );
 
+// *** ARTIFACT.C ***
+
+__success(return)
+BOOLEAN
+MakeRestoreTargetArtifact(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PMAKE_TARGET Target
+    );
+
+VOID
+MakeStoreTargetArtifact(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PMAKE_TARGET Target
+    );
+
+// *** CACHE.C ***
+
+DWORDLONG
+MakeHashBytes64(
+    __in DWORDLONG Hash,
+    __in PVOID Buffer,
+    __in DWORD Length
+    );
+
+DWORDLONG
+MakeHashString64(
+    __in DWORDLONG Hash,
+    __in PCYORI_STRING String
+    );
+
+__success(return)
+BOOLEAN
+MakeHashFileContents(
+    __in PCYORI_STRING FileName,
+    __out PDWORDLONG FileSize,
+    __out PDWORDLONG ContentHash
+    );
+
+VOID
+MakeInvalidateProbeCache(
+    __in PMAKE_CONTEXT MakeContext
+    );
+
+VOID
+MakeDeleteProbeCache(
+    __in PMAKE_CONTEXT MakeContext
+    );
+
+__success(return)
+BOOLEAN
+MakeLookupProbeCache(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PCYORI_STRING FullPath,
+    __out PDWORD FileAttributes,
+    __out PLARGE_INTEGER LastWriteTime
+    );
+
+BOOLEAN
+MakeProbeFileExists(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING FileName
+    );
+
+VOID
+MakeRecordGraphCacheFile(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING FileName
+    );
+
+VOID
+MakeCalculateGraphCacheArgsHash(
+    __in PMAKE_CONTEXT MakeContext,
+    __in YORI_ALLOC_SIZE_T ArgC,
+    __in YORI_STRING ArgV[],
+    __in PYORI_STRING MakeFileName
+    );
+
+BOOLEAN
+MakeLoadGraphCache(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING MakeFileName
+    );
+
+VOID
+MakeSaveGraphCache(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING MakeFileName
+    );
+
+VOID
+MakeDeleteGraphCacheInputs(
+    __in PMAKE_CONTEXT MakeContext
+    );
+
 // *** EXEC.C ***
 
 VOID
@@ -1066,7 +1611,35 @@ MakeCleanupTemporaryDirectories(
     __in PMAKE_CONTEXT MakeContext
     );
 
+VOID
+MakeAddTargetToReadyList(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PMAKE_TARGET Target
+    );
+
+VOID
+MakeSortReadyTargets(
+    __in PMAKE_CONTEXT MakeContext
+    );
+
 BOOLEAN
 MakeExecuteRequiredTargets(
     __in PMAKE_CONTEXT MakeContext
     );
+
+VOID
+MakeDisplayTargetQueueTimes(
+    __in PMAKE_CONTEXT MakeContext
+    );
+
+VOID
+MakeLoadTargetDurations(
+    __inout PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING MakeFileName
+    );
+
+VOID
+MakeSaveTargetDurations(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING MakeFileName
+    );
@@ -3,7 +3,7 @@
  *
  * Yori shell make preprocessor
  *
- * Copyright (c) 2020 Malcolm J. Smith
+ * Copyright (c) 2020-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -793,7 +793,11 @@ MakeLoadPreprocessorCacheEntries(
         memcpy(Key.StartOfString, &LineString.StartOfString[CharsConsumed + 1], (LineString.LengthInChars - CharsConsumed - 1) * sizeof(TCHAR));
         Key.LengthInChars = LineString.LengthInChars - CharsConsumed - 1;
 
-        YoriLibHashInsertByKey(MakeContext->PreprocessorCache, &Key, Entry, &Entry->HashEntry);
+        if (!YoriLibOpenHashInsertByKey(MakeContext->PreprocessorCache, &Key, Entry, &Entry->HashEntry)) {
+            YoriLibFreeStringContents(&Key);
+            YoriLibFree(Entry);
+            break;
+        }
 
         YoriLibAppendList(&MakeContext->PreprocessorCacheList, &Entry->ListEntry);
 
@@ -847,17 +851,52 @@ MakeSaveAndDeleteAllPreprocessorCacheEntries(
             YoriLibOutputToDevice(hCache, 0, _T("%i:%y\n"), Entry->ExitCode, &Entry->HashEntry.Key);
         }
         YoriLibRemoveListItem(&Entry->ListEntry);
-        YoriLibHashRemoveByEntry(&Entry->HashEntry);
+        YoriLibOpenHashRemoveByEntry(MakeContext->PreprocessorCache, &Entry->HashEntry);
         YoriLibFree(Entry);
         ListEntry = YoriLibGetNextListEntry(&MakeContext->PreprocessorCacheList, NULL);
     }
-    YoriLibFreeEmptyHashTable(MakeContext->PreprocessorCache);
+    YoriLibFreeEmptyOpenHashTable(MakeContext->PreprocessorCache);
 
     if (hCache != NULL) {
         CloseHandle(hCache);
     }
 }
 
+/**
+ Return a hash of the environment block.  This process does not modify its
+ own environment, so this is calculated once and reused.
+
+ @param MakeContext Pointer to the context.
+
+ @param EnvHash On successful completion, updated to contain the hash of the
+        environment block.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+MakeGetEnvironmentHash(
+    __in PMAKE_CONTEXT MakeContext,
+    __out PDWORD EnvHash
+    )
+{
+    YORI_STRING Env;
+
+    if (!MakeContext->EnvHashCalculated) {
+        if (!YoriLibGetEnvironmentStrings(&Env)) {
+            return FALSE;
+        }
+
+        MakeContext->EnvHash = YoriLibHashString32(0, &Env);
+        MakeContext->EnvHashCalculated = TRUE;
+
+        YoriLibFreeStringContents(&Env);
+    }
+
+    *EnvHash = MakeContext->EnvHash;
+    return TRUE;
+}
+
 /**
  Given a command and a point in time in execution, calculate the cache key
  for the command.  The key consists of a hash of the environment, a hash of
@@ -882,27 +921,14 @@ MakeBuildKeyForCacheCmd(
     __out PYORI_STRING Key
     )
 {
-    YORI_STRING Env;
     YORI_STRING Substring;
-    PMAKE_CONTEXT MakeContext;
     DWORD EnvHash;
     DWORD VarHash;
 
-    MakeContext = ScopeContext->MakeContext;
-
-    if (!MakeContext->EnvHashCalculated) {
-        if (!YoriLibGetEnvironmentStrings(&Env)) {
-            return FALSE;
-        }
-
-        MakeContext->EnvHash = YoriLibHashString32(0, &Env);
-        MakeContext->EnvHashCalculated = TRUE;
-
-        YoriLibFreeStringContents(&Env);
+    if (!MakeGetEnvironmentHash(ScopeContext->MakeContext, &EnvHash)) {
+        return FALSE;
     }
 
-    EnvHash = MakeContext->EnvHash;
-
     VarHash = MakeHashAllVariables(ScopeContext);
 
     if (!YoriLibAllocateString(Key, (sizeof(EnvHash) + sizeof(VarHash)) * 2 + Cmd->LengthInChars + 1)) {
@@ -959,7 +985,7 @@ MakeLookupPreprocessorCache(
     __in PYORI_STRING Cmd
     )
 {
-    PYORI_HASH_ENTRY HashEntry;
+    PYORI_OPEN_HASH_ENTRY HashEntry;
     PMAKE_PREPROC_EXEC_CACHE_ENTRY Entry;
     YORI_STRING Key;
 
@@ -967,7 +993,7 @@ MakeLookupPreprocessorCache(
         return NULL;
     }
 
-    HashEntry = YoriLibHashLookupByKey(ScopeContext->MakeContext->PreprocessorCache, &Key);
+    HashEntry = YoriLibOpenHashLookupByKey(ScopeContext->MakeContext->PreprocessorCache, &Key);
     YoriLibFreeStringContents(&Key);
     if (HashEntry == NULL) {
         return NULL;
@@ -995,14 +1021,14 @@ MakeAddToPreprocessorCache(
     )
 {
     PMAKE_PREPROC_EXEC_CACHE_ENTRY Entry;
-    PYORI_HASH_ENTRY HashEntry;
+    PYORI_OPEN_HASH_ENTRY HashEntry;
     YORI_STRING Key;
 
     if (!MakeBuildKeyForCacheCmd(ScopeContext, Cmd, &Key)) {
         return;
     }
 
-    HashEntry = YoriLibHashLookupByKey(ScopeContext->MakeContext->PreprocessorCache, &Key);
+    HashEntry = YoriLibOpenHashLookupByKey(ScopeContext->MakeContext->PreprocessorCache, &Key);
     if (HashEntry != NULL) {
         YoriLibFreeStringContents(&Key);
         return;
@@ -1017,7 +1043,11 @@ MakeAddToPreprocessorCache(
     ZeroMemory(Entry, sizeof(MAKE_PREPROC_EXEC_CACHE_ENTRY));
     Entry->ExitCode = ExitCode;
 
-    YoriLibHashInsertByKey(ScopeContext->MakeContext->PreprocessorCache, &Key, Entry, &Entry->HashEntry);
+    if (!YoriLibOpenHashInsertByKey(ScopeContext->MakeContext->PreprocessorCache, &Key, Entry, &Entry->HashEntry)) {
+        YoriLibFreeStringContents(&Key);
+        YoriLibFree(Entry);
+        return;
+    }
 
     YoriLibAppendList(&ScopeContext->MakeContext->PreprocessorCacheList, &Entry->ListEntry);
     YoriLibFreeStringContents(&Key);
@@ -1067,6 +1097,19 @@ MakeExecuteCommandCaptureExitCode(
         }
     }
 
+    //
+    //  If speculating, launch this command along with any later commands,
+    //  then wait for this one.  Commands which can't be launched early are
+    //  executed below.
+    //
+
+    if (ScopeContext->MakeContext->SpeculatePreprocessor) {
+        MakeSpeculatePreprocessorCommands(ScopeContext);
+        if (MakeConsumeSpeculativeCommand(ScopeContext->MakeContext, Cmd, &ExitCode)) {
+            goto Executed;
+        }
+    }
+
     if (!YoriLibShParseCmdlineToCmdContext(Cmd, 0, &CmdContext)) {
         goto Complete;
     }
@@ -1081,6 +1124,15 @@ MakeExecuteCommandCaptureExitCode(
     YoriLibShFreeExecPlan(&ExecPlan);
     YoriLibShFreeCmdContext(&CmdContext);
 
+Executed:
+
+    //
+    //  The command may have created or deleted files, so any directory
+    //  enumerations performed before it are no longer accurate.
+    //
+
+    MakeInvalidateProbeCache(ScopeContext->MakeContext);
+
     if (ScopeContext->MakeContext->PreprocessorCache != NULL) {
         MakeAddToPreprocessorCache(ScopeContext, Cmd, ExitCode);
     }
@@ -1518,6 +1570,732 @@ MakePreprocessorEvaluateCondition(
     return CumulativeResult;
 }
 
+/**
+ Free a speculatively launched preprocessor command.  The process should
+ have completed before this is called.
+
+ @param Speculation Pointer to the speculative command to free.
+ */
+VOID
+MakeFreeSpeculation(
+    __in PMAKE_PREPROC_SPECULATION Speculation
+    )
+{
+    YoriLibShFreeExecPlan(&Speculation->ExecPlan);
+    YoriLibShFreeCmdContext(&Speculation->CmdContext);
+    YoriLibFreeStringContents(&Speculation->Cmd);
+    YoriLibFree(Speculation);
+}
+
+/**
+ Find a speculatively launched preprocessor command matching a command the
+ preprocessor needs to execute.
+
+ @param MakeContext Pointer to the context.
+
+ @param Cmd Pointer to the command after variable expansion.
+
+ @return Pointer to the speculative command, or NULL if the command has not
+         been launched.
+ */
+PMAKE_PREPROC_SPECULATION
+MakeFindSpeculativeCommand(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PCYORI_STRING Cmd
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_PREPROC_SPECULATION Speculation;
+
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->SpeculationList, NULL);
+    while (ListEntry != NULL) {
+        Speculation = CONTAINING_RECORD(ListEntry, MAKE_PREPROC_SPECULATION, ListEntry);
+        if (YoriLibCompareString(&Speculation->Cmd, Cmd) == 0) {
+            return Speculation;
+        }
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->SpeculationList, ListEntry);
+    }
+
+    return NULL;
+}
+
+/**
+ Launch a preprocessor command before the preprocessor needs its result.
+ Only a single external program whose output is displayed or discarded is
+ launched this way, since builtins execute in this process and redirection
+ to files or pipes between programs may make commands dependent on each
+ other.  Anything else is left to execute when the preprocessor reaches it.
+
+ @param ScopeContext Pointer to the scope context.
+
+ @param Cmd Pointer to the command after variable expansion.
+
+ @return TRUE if the command was launched, has already been launched, has
+         a result in the preprocessor cache, or is not suitable for
+         launching early.  FALSE if the limit of outstanding commands has
+         been reached.
+ */
+BOOLEAN
+MakeLaunchSpeculativeCommand(
+    __in PMAKE_SCOPE_CONTEXT ScopeContext,
+    __in PYORI_STRING Cmd
+    )
+{
+    PMAKE_CONTEXT MakeContext;
+    PMAKE_PREPROC_SPECULATION Speculation;
+    PYORI_LIBSH_SINGLE_EXEC_CONTEXT ExecContext;
+    YORI_STRING FoundInPath;
+    BOOL FailedInRedirection;
+
+    MakeContext = ScopeContext->MakeContext;
+    if (MakeFindSpeculativeCommand(MakeContext, Cmd) != NULL) {
+        return TRUE;
+    }
+
+    if (MakeContext->PreprocessorCache != NULL &&
+        MakeLookupPreprocessorCache(ScopeContext, Cmd) != NULL) {
+
+        return TRUE;
+    }
+
+    if (MakeContext->SpeculationsOutstanding >= MakeContext->NumberProcesses) {
+        return FALSE;
+    }
+
+    Speculation = YoriLibMalloc(sizeof(MAKE_PREPROC_SPECULATION));
+    if (Speculation == NULL) {
+        return TRUE;
+    }
+
+    ZeroMemory(Speculation, sizeof(MAKE_PREPROC_SPECULATION));
+    if (!YoriLibAllocateString(&Speculation->Cmd, Cmd->LengthInChars + 1)) {
+        YoriLibFree(Speculation);
+        return TRUE;
+    }
+
+    memcpy(Speculation->Cmd.StartOfString, Cmd->StartOfString, Cmd->LengthInChars * sizeof(TCHAR));
+    Speculation->Cmd.StartOfString[Cmd->LengthInChars] = '\0';
+    Speculation->Cmd.LengthInChars = Cmd->LengthInChars;
+
+    if (!YoriLibShParseCmdlineToCmdContext(&Speculation->Cmd, 0, &Speculation->CmdContext)) {
+        YoriLibFreeStringContents(&Speculation->Cmd);
+        YoriLibFree(Speculation);
+        return TRUE;
+    }
+
+    if (!YoriLibShParseCmdContextToExecPlan(&Speculation->CmdContext, &Speculation->ExecPlan, NULL, NULL, NULL, NULL)) {
+        YoriLibShFreeCmdContext(&Speculation->CmdContext);
+        YoriLibFreeStringContents(&Speculation->Cmd);
+        YoriLibFree(Speculation);
+        return TRUE;
+    }
+
+    ExecContext = Speculation->ExecPlan.FirstCmd;
+    if (Speculation->ExecPlan.NumberCommands != 1 ||
+        ExecContext->CmdToExec.ArgC == 0 ||
+        ExecContext->StdInType == StdInTypePipe ||
+        YoriLibShLookupBuiltinByName(&ExecContext->CmdToExec.ArgV[0]) != NULL) {
+
+        MakeFreeSpeculation(Speculation);
+        return TRUE;
+    }
+
+    //
+    //  Capture output that would go to the console so it can be displayed
+    //  in order.  Output discarded by the command is fine too.
+    //
+
+    if (ExecContext->StdOutType == StdOutTypeDefault) {
+        ExecContext->StdOutType = StdOutTypeBuffer;
+        if (ExecContext->StdErrType == StdErrTypeDefault) {
+            ExecContext->StdErrType = StdErrTypeStdOut;
+        }
+    }
+
+    if ((ExecContext->StdOutType != StdOutTypeBuffer && ExecContext->StdOutType != StdOutTypeNull) ||
+        (ExecContext->StdErrType != StdErrTypeStdOut && ExecContext->StdErrType != StdErrTypeNull)) {
+
+        MakeFreeSpeculation(Speculation);
+        return TRUE;
+    }
+
+    YoriLibInitEmptyString(&FoundInPath);
+    if (!YoriLibLocateExecutableInPath(&ExecContext->CmdToExec.ArgV[0], NULL, NULL, &FoundInPath) ||
+        FoundInPath.LengthInChars == 0) {
+
+        YoriLibFreeStringContents(&FoundInPath);
+        MakeFreeSpeculation(Speculation);
+        return TRUE;
+    }
+
+    YoriLibFreeStringContents(&ExecContext->CmdToExec.ArgV[0]);
+    memcpy(&ExecContext->CmdToExec.ArgV[0], &FoundInPath, sizeof(YORI_STRING));
+
+    //
+    //  If the process can't be launched now, it will be launched again when
+    //  the preprocessor reaches it, which will report the failure.
+    //
+
+    if (YoriLibShCreateProcess(ExecContext, NULL, &FailedInRedirection) != ERROR_SUCCESS) {
+        YoriLibShCleanupFailedProcessLaunch(ExecContext);
+        MakeFreeSpeculation(Speculation);
+        return TRUE;
+    }
+
+    CloseHandle(ExecContext->hPrimaryThread);
+    ExecContext->hPrimaryThread = NULL;
+    YoriLibShCommenceProcessBuffersIfNeeded(ExecContext);
+
+    YoriLibAppendList(&MakeContext->SpeculationList, &Speculation->ListEntry);
+    MakeContext->SpeculationsOutstanding++;
+    MakeContext->SpeculationsLaunched++;
+
+#if MAKE_DEBUG_PREPROCESSOR_CREATEPROCESS
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Speculatively executing preprocessor command: %y\n"), Cmd);
+#endif
+
+    return TRUE;
+}
+
+/**
+ Wait for a speculatively launched preprocessor command to complete, display
+ its output, and return its exit code.  The command is removed from the list
+ of outstanding commands and freed.
+
+ @param MakeContext Pointer to the context.
+
+ @param Speculation Pointer to the speculative command.
+
+ @param DisplayOutput If TRUE, output from the command is displayed.  If
+        FALSE, the command's result is not needed and its output is
+        discarded.
+
+ @return The exit code of the command.
+ */
+DWORD
+MakeCompleteSpeculativeCommand(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PMAKE_PREPROC_SPECULATION Speculation,
+    __in BOOLEAN DisplayOutput
+    )
+{
+    PYORI_LIBSH_SINGLE_EXEC_CONTEXT ExecContext;
+    YORI_STRING ProcessOutput;
+    DWORD ExitCode;
+
+    ExecContext = Speculation->ExecPlan.FirstCmd;
+    ExitCode = 255;
+    WaitForSingleObject(ExecContext->hProcess, INFINITE);
+    GetExitCodeProcess(ExecContext->hProcess, &ExitCode);
+
+    YoriLibRemoveListItem(&Speculation->ListEntry);
+    MakeContext->SpeculationsOutstanding--;
+
+    //
+    //  The command may have created or deleted files.  The probe cache is
+    //  not used while commands are outstanding, but may contain entries
+    //  from before the command was launched.
+    //
+
+    MakeInvalidateProbeCache(MakeContext);
+
+    if (ExecContext->StdOutType == StdOutTypeBuffer &&
+        ExecContext->StdOut.Buffer.ProcessBuffers != NULL) {
+
+        YoriLibShWaitForProcessBufferToFinalize(ExecContext->StdOut.Buffer.ProcessBuffers);
+        if (DisplayOutput &&
+            YoriLibShGetProcessOutputBuffer(ExecContext->StdOut.Buffer.ProcessBuffers, &ProcessOutput)) {
+
+            if (ProcessOutput.LengthInChars > 0) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &ProcessOutput);
+            }
+            YoriLibFreeStringContents(&ProcessOutput);
+        }
+
+        YoriLibShTeardownProcessBuffersIfCompleted(ExecContext->StdOut.Buffer.ProcessBuffers);
+    }
+
+    MakeFreeSpeculation(Speculation);
+    return ExitCode;
+}
+
+/**
+ If a preprocessor command has been launched speculatively, wait for it and
+ return its result.
+
+ @param MakeContext Pointer to the context.
+
+ @param Cmd Pointer to the command after variable expansion.
+
+ @param ExitCode On successful completion, updated to contain the exit code
+        of the command.
+
+ @return TRUE if the command had been launched and its result is returned,
+         FALSE if the command needs to be executed.
+ */
+__success(return)
+BOOLEAN
+MakeConsumeSpeculativeCommand(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING Cmd,
+    __out PDWORD ExitCode
+    )
+{
+    PMAKE_PREPROC_SPECULATION Speculation;
+
+    Speculation = MakeFindSpeculativeCommand(MakeContext, Cmd);
+    if (Speculation == NULL) {
+        return FALSE;
+    }
+
+    *ExitCode = MakeCompleteSpeculativeCommand(MakeContext, Speculation, TRUE);
+    MakeContext->SpeculationsUsed++;
+    return TRUE;
+}
+
+/**
+ Wait for all speculatively launched preprocessor commands which were never
+ needed, and discard their results.  This occurs once preprocessing is
+ complete, because the variables a command refers to may have changed
+ before it was reached.
+
+ @param MakeContext Pointer to the context.
+ */
+VOID
+MakeDiscardSpeculativeCommands(
+    __in PMAKE_CONTEXT MakeContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_PREPROC_SPECULATION Speculation;
+
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->SpeculationList, NULL);
+    while (ListEntry != NULL) {
+        Speculation = CONTAINING_RECORD(ListEntry, MAKE_PREPROC_SPECULATION, ListEntry);
+        MakeCompleteSpeculativeCommand(MakeContext, Speculation, FALSE);
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->SpeculationList, NULL);
+    }
+}
+
+/**
+ Find the commands within a preprocessor !IF expression and launch them.
+ This parses the expression in the same way as
+ MakePreprocessorEvaluateCondition, but ignores anything it does not
+ understand, since any error will be reported when the expression is
+ evaluated.
+
+ @param ScopeContext Pointer to the scope context.
+
+ @param Expression Pointer to the expression after variable expansion.
+
+ @return TRUE if every command in the expression was considered, FALSE if
+         the limit of outstanding commands was reached.
+ */
+BOOLEAN
+MakeSpeculateCondition(
+    __in PMAKE_SCOPE_CONTEXT ScopeContext,
+    __in PYORI_STRING Expression
+    )
+{
+    YORI_STRING CompoundMatches[MAKE_IF_COMPOUND_OPERATOR_BEYOND_MAX];
+    YORI_STRING OperatorMatches[MAKE_IF_OPERATOR_BEYOND_MAX];
+    YORI_STRING Parts[2];
+    YORI_STRING Current;
+    YORI_STRING Remaining;
+    YORI_STRING Substring;
+    PYORI_STRING MatchingOperator;
+    YORI_ALLOC_SIZE_T OperatorIndex;
+    DWORD PartIndex;
+
+    YoriLibConstantString(&CompoundMatches[MAKE_IF_COMPOUND_OPERATOR_AND], _T("&&"));
+    YoriLibConstantString(&CompoundMatches[MAKE_IF_COMPOUND_OPERATOR_OR], _T("||"));
+
+    YoriLibConstantString(&OperatorMatches[MAKE_IF_OPERATOR_EXACT_MATCH], _T("=="));
+    YoriLibConstantString(&OperatorMatches[MAKE_IF_OPERATOR_NO_MATCH], _T("!="));
+    YoriLibConstantString(&OperatorMatches[MAKE_IF_OPERATOR_GREATER_OR_EQUAL], _T(">="));
+    YoriLibConstantString(&OperatorMatches[MAKE_IF_OPERATOR_LESS_OR_EQUAL], _T("<="));
+    YoriLibConstantString(&OperatorMatches[MAKE_IF_OPERATOR_GREATER], _T(">"));
+    YoriLibConstantString(&OperatorMatches[MAKE_IF_OPERATOR_LESS], _T("<"));
+
+    YoriLibInitEmptyString(&Remaining);
+    YoriLibInitEmptyString(&Current);
+    Remaining.StartOfString = Expression->StartOfString;
+    Remaining.LengthInChars = Expression->LengthInChars;
+
+    while (Remaining.LengthInChars > 0) {
+
+        MatchingOperator = MakeFindFirstMatchingSubstringSkipQuotes(&Remaining, sizeof(CompoundMatches)/sizeof(CompoundMatches[0]), CompoundMatches, &OperatorIndex);
+        Current.StartOfString = Remaining.StartOfString;
+        if (MatchingOperator == NULL) {
+            Current.LengthInChars = Remaining.LengthInChars;
+            Remaining.LengthInChars = 0;
+        } else {
+            Current.LengthInChars = OperatorIndex;
+            Remaining.StartOfString = Remaining.StartOfString + OperatorIndex + MatchingOperator->LengthInChars;
+            Remaining.LengthInChars = Remaining.LengthInChars - OperatorIndex - MatchingOperator->LengthInChars;
+        }
+
+        MakeTrimWhitespace(&Current);
+        MakeTrimWhitespace(&Remaining);
+
+        MatchingOperator = MakeFindFirstMatchingSubstringSkipQuotes(&Current, sizeof(OperatorMatches)/sizeof(OperatorMatches[0]), OperatorMatches, &OperatorIndex);
+        if (MatchingOperator == NULL) {
+            continue;
+        }
+
+        YoriLibInitEmptyString(&Parts[0]);
+        Parts[0].StartOfString = Current.StartOfString;
+        Parts[0].LengthInChars = OperatorIndex;
+
+        YoriLibInitEmptyString(&Parts[1]);
+        Parts[1].StartOfString = Current.StartOfString + OperatorIndex + MatchingOperator->LengthInChars;
+        Parts[1].LengthInChars = Current.LengthInChars - OperatorIndex - MatchingOperator->LengthInChars;
+
+        for (PartIndex = 0; PartIndex < sizeof(Parts)/sizeof(Parts[0]); PartIndex++) {
+            MakeTrimWhitespace(&Parts[PartIndex]);
+            if (Parts[PartIndex].LengthInChars > 2 &&
+                Parts[PartIndex].StartOfString[0] == '[' &&
+                Parts[PartIndex].StartOfString[Parts[PartIndex].LengthInChars - 1] == ']') {
+
+                YoriLibInitEmptyString(&Substring);
+                Substring.StartOfString = &Parts[PartIndex].StartOfString[1];
+                Substring.LengthInChars = Parts[PartIndex].LengthInChars - 2;
+                if (!MakeLaunchSpeculativeCommand(ScopeContext, &Substring)) {
+                    return FALSE;
+                }
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Scan ahead of the preprocessor for !IF lines which execute commands, and
+ launch those commands so they run concurrently.  Only commands which are
+ certain to be evaluated are launched, being those on the line currently
+ being evaluated and those on the first !IF line that follows it, so the
+ scan stops at the first line that starts, continues or ends a conditional
+ block.  Variables are expanded using their current values, and a result is
+ only used if the preprocessor later executes exactly the same command.
+ This assumes that preprocessor commands do not depend on each other's side
+ effects, consistent with the preprocessor cache assuming their results
+ are stable.
+
+ @param ScopeContext Pointer to the scope context.
+ */
+VOID
+MakeSpeculatePreprocessorCommands(
+    __in PMAKE_SCOPE_CONTEXT ScopeContext
+    )
+{
+    PMAKE_CONTEXT MakeContext;
+    PMAKE_PREPROC_LOOKAHEAD Lookahead;
+    YORI_STRING Line;
+    YORI_STRING ExpandedLine;
+    YORI_STRING Arg;
+    YORI_ALLOC_SIZE_T ArgOffset;
+    MAKE_PREPROCESSOR_LINE_TYPE PreprocessorLineType;
+    DWORD LineIndex;
+    BOOLEAN Continued;
+
+    MakeContext = ScopeContext->MakeContext;
+    Lookahead = MakeContext->ActiveLookahead;
+    if (Lookahead == NULL) {
+        return;
+    }
+
+    //
+    //  If the last scan stopped at a conditional block, nothing further is
+    //  known to be evaluated until the preprocessor moves beyond it.
+    //
+
+    if (Lookahead->ScanReachedBlock) {
+        if (Lookahead->CurrentLine < Lookahead->NextLineToScan) {
+            return;
+        }
+        Lookahead->ScanReachedBlock = FALSE;
+    }
+
+    if (Lookahead->NextLineToScan < Lookahead->CurrentLine) {
+        Lookahead->NextLineToScan = Lookahead->CurrentLine;
+    }
+
+    YoriLibInitEmptyString(&ExpandedLine);
+    YoriLibInitEmptyString(&Line);
+    Continued = FALSE;
+    if (Lookahead->NextLineToScan > 0) {
+        Line.StartOfString = Lookahead->Lines[Lookahead->NextLineToScan - 1].StartOfString;
+        Line.LengthInChars = Lookahead->Lines[Lookahead->NextLineToScan - 1].LengthInChars;
+        MakeTruncateComments(&Line);
+        if (Line.LengthInChars > 0 && Line.StartOfString[Line.LengthInChars - 1] == '\\') {
+            Continued = TRUE;
+        }
+    }
+
+    //
+    //  If the line being evaluated is joined with earlier lines, the scan
+    //  can't tell what kind of line it is, so it can't tell whether later
+    //  lines will be evaluated.
+    //
+
+    if (Continued) {
+        Lookahead->NextLineToScan = Lookahead->CurrentLine + 1;
+        Lookahead->ScanReachedBlock = TRUE;
+        return;
+    }
+
+    for (LineIndex = Lookahead->NextLineToScan; LineIndex < Lookahead->LineCount; LineIndex++) {
+
+        YoriLibInitEmptyString(&Line);
+        Line.StartOfString = Lookahead->Lines[LineIndex].StartOfString;
+        Line.LengthInChars = Lookahead->Lines[LineIndex].LengthInChars;
+        MakeTruncateComments(&Line);
+
+        //
+        //  Lines that are joined with the previous line, or are joined to
+        //  the next line, are left for the preprocessor.  A joined
+        //  preprocessor line may start or end a conditional block, so the
+        //  scan stops there.
+        //
+
+        if (Continued) {
+            Continued = FALSE;
+            if (Line.LengthInChars > 0 && Line.StartOfString[Line.LengthInChars - 1] == '\\') {
+                Continued = TRUE;
+            }
+            Lookahead->NextLineToScan = LineIndex + 1;
+            continue;
+        }
+
+        if (Line.LengthInChars > 0 && Line.StartOfString[Line.LengthInChars - 1] == '\\') {
+            MakeTrimWhitespace(&Line);
+            if (Line.StartOfString[0] == '!') {
+                Lookahead->ScanReachedBlock = TRUE;
+                break;
+            }
+            Continued = TRUE;
+            Lookahead->NextLineToScan = LineIndex + 1;
+            continue;
+        }
+
+        MakeTrimWhitespace(&Line);
+        if (Line.LengthInChars == 0 || Line.StartOfString[0] != '!') {
+            Lookahead->NextLineToScan = LineIndex + 1;
+            continue;
+        }
+
+        if (!MakeExpandVariables(ScopeContext, NULL, &ExpandedLine, &Line, NULL)) {
+            Lookahead->NextLineToScan = LineIndex + 1;
+            continue;
+        }
+
+        //
+        //  Trim a copy so the expanded line allocation can be reused.
+        //
+
+        YoriLibInitEmptyString(&Line);
+        Line.StartOfString = ExpandedLine.StartOfString;
+        Line.LengthInChars = ExpandedLine.LengthInChars;
+        MakeTrimWhitespace(&Line);
+        if (Line.LengthInChars == 0 || Line.StartOfString[0] != '!') {
+            Lookahead->NextLineToScan = LineIndex + 1;
+            continue;
+        }
+
+        PreprocessorLineType = MakeDeterminePreprocessorLineType(&Line, &ArgOffset);
+        if (PreprocessorLineType == MakePreprocessorLineTypeUnknown ||
+            PreprocessorLineType == MakePreprocessorLineTypeInclude ||
+            PreprocessorLineType == MakePreprocessorLineTypeMessage ||
+            PreprocessorLineType == MakePreprocessorLineTypeUndef) {
+
+            Lookahead->NextLineToScan = LineIndex + 1;
+            continue;
+        }
+
+        //
+        //  This line starts, continues or ends a conditional block, or
+        //  terminates processing, so later lines may not be evaluated.
+        //  The condition on this line is evaluated if the preprocessor is
+        //  evaluating it now, or if it is an !IF reached from here.
+        //
+
+        if (LineIndex == Lookahead->CurrentLine ||
+            PreprocessorLineType == MakePreprocessorLineTypeIf) {
+
+            if (PreprocessorLineType == MakePreprocessorLineTypeIf ||
+                PreprocessorLineType == MakePreprocessorLineTypeElseIf) {
+
+                YoriLibInitEmptyString(&Arg);
+                if (ArgOffset < Line.LengthInChars) {
+                    Arg.StartOfString = &Line.StartOfString[ArgOffset];
+                    Arg.LengthInChars = Line.LengthInChars - ArgOffset;
+                    MakeTrimWhitespace(&Arg);
+                }
+
+                if (!MakeSpeculateCondition(ScopeContext, &Arg)) {
+                    break;
+                }
+            }
+
+            Lookahead->NextLineToScan = LineIndex + 1;
+        }
+
+        Lookahead->ScanReachedBlock = TRUE;
+        break;
+    }
+
+    YoriLibFreeStringContents(&ExpandedLine);
+}
+
+/**
+ Read every line of a makefile into memory so that the preprocessor can scan
+ ahead for commands to launch.
+
+ @param hSource Handle to the makefile.
+
+ @param Lookahead On successful completion, populated with the lines of the
+        makefile.
+
+ @return TRUE to indicate success, FALSE to indicate failure.  On failure,
+         the stream position is undefined.
+ */
+__success(return)
+BOOLEAN
+MakeReadLookahead(
+    __in HANDLE hSource,
+    __out PMAKE_PREPROC_LOOKAHEAD Lookahead
+    )
+{
+    PVOID LineContext;
+    YORI_STRING LineString;
+    PYORI_ALLOC_SIZE_T LineLengths;
+    PYORI_ALLOC_SIZE_T NewLineLengths;
+    YORI_ALLOC_SIZE_T LinesAllocated;
+    YORI_STRING NewText;
+    YORI_MAX_UNSIGNED_T NewSize;
+    DWORD LineIndex;
+    YORI_ALLOC_SIZE_T Offset;
+    BOOLEAN Result;
+
+    ZeroMemory(Lookahead, sizeof(MAKE_PREPROC_LOOKAHEAD));
+    YoriLibInitEmptyString(&Lookahead->Text);
+    YoriLibInitEmptyString(&LineString);
+    LineContext = NULL;
+    LineLengths = NULL;
+    LinesAllocated = 0;
+    Result = FALSE;
+
+    //
+    //  Accumulate the text of every line into a single allocation, along
+    //  with the length of each line.
+    //
+
+    while (YoriLibReadLineToString(&LineString, &LineContext, hSource)) {
+
+        if (Lookahead->LineCount >= LinesAllocated) {
+            NewSize = LinesAllocated * 2;
+            if (NewSize == 0) {
+                NewSize = 256;
+            }
+            if (!YoriLibIsSizeAllocatable(NewSize * sizeof(YORI_ALLOC_SIZE_T))) {
+                goto Exit;
+            }
+            NewLineLengths = YoriLibMalloc((YORI_ALLOC_SIZE_T)(NewSize * sizeof(YORI_ALLOC_SIZE_T)));
+            if (NewLineLengths == NULL) {
+                goto Exit;
+            }
+            if (LineLengths != NULL) {
+                memcpy(NewLineLengths, LineLengths, Lookahead->LineCount * sizeof(YORI_ALLOC_SIZE_T));
+                YoriLibFree(LineLengths);
+            }
+            LineLengths = NewLineLengths;
+            LinesAllocated = (YORI_ALLOC_SIZE_T)NewSize;
+        }
+
+        if (Lookahead->Text.LengthInChars + LineString.LengthInChars > Lookahead->Text.LengthAllocated) {
+            NewSize = Lookahead->Text.LengthAllocated * 2;
+            if (NewSize < 4096) {
+                NewSize = 4096;
+            }
+            while (NewSize < (YORI_MAX_UNSIGNED_T)Lookahead->Text.LengthInChars + LineString.LengthInChars) {
+                NewSize = NewSize * 2;
+            }
+            if (!YoriLibIsSizeAllocatable(NewSize * sizeof(TCHAR))) {
+                goto Exit;
+            }
+            if (!YoriLibAllocateString(&NewText, (YORI_ALLOC_SIZE_T)NewSize)) {
+                goto Exit;
+            }
+            memcpy(NewText.StartOfString, Lookahead->Text.StartOfString, Lookahead->Text.LengthInChars * sizeof(TCHAR));
+            NewText.LengthInChars = Lookahead->Text.LengthInChars;
+            YoriLibFreeStringContents(&Lookahead->Text);
+            memcpy(&Lookahead->Text, &NewText, sizeof(YORI_STRING));
+        }
+
+        memcpy(&Lookahead->Text.StartOfString[Lookahead->Text.LengthInChars], LineString.StartOfString, LineString.LengthInChars * sizeof(TCHAR));
+        Lookahead->Text.LengthInChars = Lookahead->Text.LengthInChars + LineString.LengthInChars;
+        LineLengths[Lookahead->LineCount] = LineString.LengthInChars;
+        Lookahead->LineCount++;
+    }
+
+    //
+    //  Now that the text won't move, describe each line.
+    //
+
+    if (Lookahead->LineCount > 0) {
+        if (!YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)Lookahead->LineCount * sizeof(YORI_STRING))) {
+            goto Exit;
+        }
+        Lookahead->Lines = YoriLibMalloc((YORI_ALLOC_SIZE_T)(Lookahead->LineCount * sizeof(YORI_STRING)));
+        if (Lookahead->Lines == NULL) {
+            goto Exit;
+        }
+
+        Offset = 0;
+        for (LineIndex = 0; LineIndex < Lookahead->LineCount; LineIndex++) {
+            YoriLibInitEmptyString(&Lookahead->Lines[LineIndex]);
+            Lookahead->Lines[LineIndex].StartOfString = &Lookahead->Text.StartOfString[Offset];
+            Lookahead->Lines[LineIndex].LengthInChars = LineLengths[LineIndex];
+            Offset = Offset + LineLengths[LineIndex];
+        }
+    }
+
+    Result = TRUE;
+
+Exit:
+    if (LineLengths != NULL) {
+        YoriLibFree(LineLengths);
+    }
+    YoriLibLineReadCloseOrCache(LineContext);
+    YoriLibFreeStringContents(&LineString);
+
+    if (!Result) {
+        YoriLibFreeStringContents(&Lookahead->Text);
+        Lookahead->LineCount = 0;
+    }
+
+    return Result;
+}
+
+/**
+ Free the lines of a makefile read by MakeReadLookahead.
+
+ @param Lookahead Pointer to the lines to free.
+ */
+VOID
+MakeFreeLookahead(
+    __in PMAKE_PREPROC_LOOKAHEAD Lookahead
+    )
+{
+    if (Lookahead->Lines != NULL) {
+        YoriLibFree(Lookahead->Lines);
+        Lookahead->Lines = NULL;
+    }
+    YoriLibFreeStringContents(&Lookahead->Text);
+    Lookahead->LineCount = 0;
+}
+
 /**
  Include a new makefile at the current line.
 
@@ -1906,7 +2684,7 @@ MakeFindMakefileInDirectory(
 
     for (Index = 0; Index < sizeof(MakefileNameCandidates)/sizeof(MakefileNameCandidates[0]); Index++) {
         ProbeName.LengthInChars = YoriLibSPrintf(ProbeName.StartOfString, _T("%y\\%y"), &ScopeContext->HashEntry.Key, &MakefileNameCandidates[Index]);
-        if (GetFileAttributes(ProbeName.StartOfString) != (DWORD)-1) {
+        if (MakeProbeFileExists(ScopeContext->MakeContext, &ProbeName)) {
             memcpy(FileName, &ProbeName, sizeof(YORI_STRING));
             return TRUE;
         }
@@ -2106,6 +2884,8 @@ MakeCreateFileListDependency(
         return FALSE;
     }
 
+    MakeRecordGraphCacheFile(MakeContext, &FullPath);
+
     LineContext = NULL;
     Result = TRUE;
     YoriLibInitEmptyString(&LineString);
@@ -2700,6 +3480,8 @@ MakeProcessStream(
     LPTSTR PrefixString;
     PMAKE_TARGET ActiveRecipeTarget = NULL;
     PMAKE_SCOPE_CONTEXT ScopeContext;
+    PMAKE_PREPROC_LOOKAHEAD SavedLookahead;
+    MAKE_PREPROC_LOOKAHEAD Lookahead;
     DWORD LineNumber;
 
     ScopeContext = MakeContext->ActiveScope;
@@ -2710,13 +3492,38 @@ MakeProcessStream(
     YoriLibInitEmptyString(&ExpandedLine);
     LineNumber = 0;
 
+    MakeRecordGraphCacheFile(MakeContext, FileName);
+
 #if MAKE_DEBUG_PREPROCESSOR
     YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Processing %y\n"), FileName);
 #endif
 
+    //
+    //  If preprocessor commands are being launched early, read the whole
+    //  makefile so later lines can be scanned.  Included makefiles have
+    //  their own lines, so the includer's are restored on exit.
+    //
+
+    SavedLookahead = MakeContext->ActiveLookahead;
+    if (MakeContext->SpeculatePreprocessor) {
+        if (!MakeReadLookahead(hSource, &Lookahead)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%y: could not read makefile\n"), FileName);
+            MakeContext->ErrorTermination = TRUE;
+            return FALSE;
+        }
+        MakeContext->ActiveLookahead = &Lookahead;
+    }
+
     while (TRUE) {
 
-        if (!YoriLibReadLineToString(&LineString, &LineContext, hSource)) {
+        if (MakeContext->SpeculatePreprocessor) {
+            if (LineNumber >= Lookahead.LineCount) {
+                break;
+            }
+            LineString.StartOfString = Lookahead.Lines[LineNumber].StartOfString;
+            LineString.LengthInChars = Lookahead.Lines[LineNumber].LengthInChars;
+            Lookahead.CurrentLine = LineNumber;
+        } else if (!YoriLibReadLineToString(&LineString, &LineContext, hSource)) {
             break;
         }
         LineNumber++;
@@ -2875,8 +3682,13 @@ MakeProcessStream(
         JoinedLine.LengthInChars = 0;
     }
 
-    YoriLibLineReadCloseOrCache(LineContext);
-    YoriLibFreeStringContents(&LineString);
+    if (MakeContext->SpeculatePreprocessor) {
+        MakeContext->ActiveLookahead = SavedLookahead;
+        MakeFreeLookahead(&Lookahead);
+    } else {
+        YoriLibLineReadCloseOrCache(LineContext);
+        YoriLibFreeStringContents(&LineString);
+    }
     YoriLibFreeStringContents(&JoinedLine);
     YoriLibFreeStringContents(&ExpandedLine);
 
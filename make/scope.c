@@ -3,7 +3,7 @@
  *
  * Yori shell scope support routines
  *
- * Copyright (c) 2020 Malcolm J. Smith
+ * Copyright (c) 2020-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -79,7 +79,12 @@ MakeAllocateNewScope(
     memcpy(ScopeContext->CurrentIncludeDirectory.StartOfString, Directory->StartOfString, Directory->LengthInChars * sizeof(TCHAR));
     ScopeContext->CurrentIncludeDirectory.StartOfString[Directory->LengthInChars] = '\0';
 
-    YoriLibHashInsertByKey(MakeContext->Scopes, &ScopeContext->CurrentIncludeDirectory, ScopeContext, &ScopeContext->HashEntry);
+    if (!YoriLibOpenHashInsertByKey(MakeContext->Scopes, &ScopeContext->CurrentIncludeDirectory, ScopeContext, &ScopeContext->HashEntry)) {
+        YoriLibFreeEmptyHashTable(ScopeContext->Variables);
+        YoriLibFreeStringContents(&ScopeContext->CurrentIncludeDirectory);
+        YoriLibDereference(ScopeContext);
+        return NULL;
+    }
 
     YoriLibInitializeListHead(&ScopeContext->VariableList);
     YoriLibInitializeListHead(&ScopeContext->InferenceRuleList);
@@ -91,6 +96,7 @@ MakeAllocateNewScope(
     ScopeContext->ParserState = MakeParserDefault;
     ScopeContext->ActiveConditionalNestingLevelExecutionEnabled = TRUE;
     ScopeContext->ActiveConditionalNestingLevelExecutionOccurred = FALSE;
+    ScopeContext->CacheIndex = 0;
 
     YoriLibConstantString(&Default, MAKE_DEFAULT_SCOPE_TARGET_NAME);
     ScopeContext->FirstUserTarget = NULL;
@@ -100,7 +106,7 @@ MakeAllocateNewScope(
             YoriLibFreeEmptyHashTable(ScopeContext->Variables);
         }
         YoriLibRemoveListItem(&ScopeContext->ListEntry);
-        YoriLibHashRemoveByEntry(&ScopeContext->HashEntry);
+        YoriLibOpenHashRemoveByEntry(MakeContext->Scopes, &ScopeContext->HashEntry);
         YoriLibFreeStringContents(&ScopeContext->CurrentIncludeDirectory);
         YoriLibDereference(ScopeContext);
         return NULL;
@@ -138,7 +144,7 @@ MakeDereferenceScope(
         YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Deleting scope %y\n"), &ScopeContext->HashEntry.Key);
 #endif
 
-        YoriLibHashRemoveByEntry(&ScopeContext->HashEntry);
+        YoriLibOpenHashRemoveByEntry(ScopeContext->MakeContext->Scopes, &ScopeContext->HashEntry);
         YoriLibFreeStringContents(&ScopeContext->CurrentIncludeDirectory);
         MakeDeleteAllVariables(ScopeContext);
         if (ScopeContext->Variables != NULL) {
@@ -173,7 +179,7 @@ MakeActivateScope(
     )
 {
     PMAKE_SCOPE_CONTEXT ScopeContext;
-    PYORI_HASH_ENTRY HashEntry;
+    PYORI_OPEN_HASH_ENTRY HashEntry;
     YORI_STRING FullDir;
 
     YoriLibInitEmptyString(&FullDir);
@@ -183,7 +189,7 @@ MakeActivateScope(
         return FALSE;
     }
 
-    HashEntry = YoriLibHashLookupByKey(MakeContext->Scopes, &FullDir);
+    HashEntry = YoriLibOpenHashLookupByKey(MakeContext->Scopes, &FullDir);
     if (HashEntry != NULL) {
         YoriLibFreeStringContents(&FullDir);
         ScopeContext = HashEntry->Context;
@@ -265,7 +271,7 @@ MakeDeleteAllScopes(
         MakeDereferenceScope(ScopeContext);
         ListEntry = YoriLibGetNextListEntry(&MakeContext->ScopesList, NULL);
     }
-    YoriLibFreeEmptyHashTable(MakeContext->Scopes);
+    YoriLibFreeEmptyOpenHashTable(MakeContext->Scopes);
 }
 
 // vim:sw=4:ts=4:et:
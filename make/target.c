@@ -3,7 +3,7 @@
  *
  * Yori shell make target support
  *
- * Copyright (c) 2020 Malcolm J. Smith
+ * Copyright (c) 2020-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -50,6 +50,7 @@ MakeDereferenceTarget(
     if (InterlockedDecrement((INTERLOCKED_VOLATILE LONG *)&Target->ReferenceCount) == 0) {
 
         YoriLibFreeStringContents(&Target->Recipe);
+        YoriLibFreeStringContents(&Target->CachedInferenceSource);
 
         if (Target->InferenceRule != NULL) {
             MakeDereferenceInferenceRule(Target->InferenceRule);
@@ -83,10 +84,13 @@ MakeDereferenceTarget(
  Indicate that a target can no longer be resolved, dereferencing it since it
  is no longer active.  It may still be referenced by inference rules.
 
+ @param MakeContext Pointer to the context.
+
  @param Target Pointer to the target to deactivate.
  */
 VOID
 MakeDeactivateTarget(
+    __in PMAKE_CONTEXT MakeContext,
     __in PMAKE_TARGET Target
     )
 {
@@ -94,7 +98,7 @@ MakeDeactivateTarget(
     ASSERT(YoriLibIsListEmpty(&Target->ChildDependents));
 
     YoriLibRemoveListItem(&Target->ListEntry);
-    YoriLibHashRemoveByEntry(&Target->HashEntry);
+    YoriLibOpenHashRemoveByEntry(MakeContext->Targets, &Target->HashEntry);
     MakeDereferenceTarget(Target);
 }
 
@@ -153,7 +157,7 @@ MakeDeleteAllTargets(
         }
 
         ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsList, &Target->ListEntry);
-        MakeDeactivateTarget(Target);
+        MakeDeactivateTarget(MakeContext, Target);
     }
 
 }
@@ -162,15 +166,20 @@ MakeDeleteAllTargets(
  Open the target and query its timestamp.  The target may not exist (implying
  it needs to be rebuilt.)
 
+ @param MakeContext Pointer to the context.
+
  @param Target Pointer to the target to query.
  */
 VOID
 MakeProbeTargetFile(
+    __in PMAKE_CONTEXT MakeContext,
     __in PMAKE_TARGET Target
     )
 {
     HANDLE FileHandle;
     BY_HANDLE_FILE_INFORMATION FileInfo;
+    DWORD FileAttributes;
+    LARGE_INTEGER LastWriteTime;
 
     if (Target->FileProbed) {
         return;
@@ -178,6 +187,27 @@ MakeProbeTargetFile(
 
     ASSERT(!Target->FileExists);
 
+    //
+    //  Most targets are in directories containing many other targets, so
+    //  try to answer this from a single enumeration of the directory.
+    //
+
+    if (MakeLookupProbeCache(MakeContext, &Target->HashEntry.Key, &FileAttributes, &LastWriteTime)) {
+        if (FileAttributes != (DWORD)-1) {
+            Target->FileExists = TRUE;
+
+            if (FileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+                Target->ModifiedTime.QuadPart = 0;
+            } else {
+                Target->ModifiedTime.QuadPart = LastWriteTime.QuadPart;
+            }
+        }
+        Target->FileProbed = TRUE;
+        return;
+    }
+
+    MakeContext->ProbesDirect++;
+
     //
     //  Check if the object already exists, and if so, when it was last
     //  modified.  Normally this would only need FILE_READ_ATTRIBUTES,
@@ -280,7 +310,7 @@ MakeLookupTarget(
     YORI_STRING FullPath;
     YORI_STRING TargetNoQuotes;
     PMAKE_TARGET Target;
-    PYORI_HASH_ENTRY HashEntry;
+    PYORI_OPEN_HASH_ENTRY HashEntry;
     PMAKE_CONTEXT MakeContext;
 
     if (!MakeResolveFullTargetName(ScopeContext, TargetName, &TargetNoQuotes, &FullPath)) {
@@ -289,7 +319,7 @@ MakeLookupTarget(
 
     MakeContext = ScopeContext->MakeContext;
 
-    HashEntry = YoriLibHashLookupByKey(MakeContext->Targets, &FullPath);
+    HashEntry = YoriLibOpenHashLookupByKey(MakeContext->Targets, &FullPath);
     YoriLibFreeStringContents(&FullPath);
     if (HashEntry != NULL) {
         Target = HashEntry->Context;
@@ -299,6 +329,76 @@ MakeLookupTarget(
     return NULL;
 }
 
+/**
+ Allocate a new target and insert it into the hash table of known targets.
+
+ @param MakeContext Pointer to the context.
+
+ @param FullPath Pointer to the fully qualified path to the target.  This
+        must not already be a known target.
+
+ @return Pointer to the newly created target, or NULL on allocation failure.
+ */
+PMAKE_TARGET
+MakeAllocateTarget(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING FullPath
+    )
+{
+    PMAKE_TARGET Target;
+
+    Target = MakeSlabAlloc(&MakeContext->TargetAllocator, sizeof(MAKE_TARGET));
+    if (Target == NULL) {
+        return NULL;
+    }
+    MakeContext->AllocTarget++;
+
+    YoriLibInitializeListHead(&Target->ParentDependents);
+    YoriLibInitializeListHead(&Target->ChildDependents);
+    YoriLibInitializeListHead(&Target->RebuildList);
+    YoriLibInitializeListHead(&Target->InferenceRuleNeededList);
+
+    Target->ScopeContext = NULL;
+    Target->ReferenceCount = 1;
+    Target->NumberParentsToBuild = 0;
+    Target->RecordedDuration = 0;
+    Target->CriticalPathTime = 0;
+    Target->ReadyTime = 0;
+    Target->LaunchTime = 0;
+    Target->CompletionTime = 0;
+    Target->ExplicitRecipeFound = FALSE;
+    Target->Executed = FALSE;
+    Target->FileProbed = FALSE;
+    Target->FileExists = FALSE;
+    Target->ExecuteViaShell = FALSE;
+    Target->RebuildRequired = FALSE;
+    Target->DependenciesEvaluated = FALSE;
+    Target->EvaluatingDependencies = FALSE;
+    Target->InferenceRulePseudoTarget = FALSE;
+    Target->RecordedDurationFound = FALSE;
+    Target->CriticalPathCalculated = FALSE;
+    Target->ModifiedTime.QuadPart = 0;
+    Target->InferenceRule = NULL;
+    Target->InferenceRuleParentTarget = NULL;
+    Target->CacheIndex = 0;
+    Target->ContentHash = 0;
+    Target->ArtifactFingerprint = 0;
+    Target->ArtifactStartTime = 0;
+    Target->ContentHashCalculated = FALSE;
+    Target->ArtifactLookupAttempted = FALSE;
+    Target->ArtifactFingerprintValid = FALSE;
+    YoriLibInitEmptyString(&Target->Recipe);
+    YoriLibInitEmptyString(&Target->CachedInferenceSource);
+    YoriLibInitializeListHead(&Target->ExecCmds);
+    if (!YoriLibOpenHashInsertByKey(MakeContext->Targets, FullPath, Target, &Target->HashEntry)) {
+        MakeSlabFree(Target);
+        return NULL;
+    }
+    YoriLibAppendList(&MakeContext->TargetsList, &Target->ListEntry);
+
+    return Target;
+}
+
 /**
  Lookup a target in the current hash table of targets, and if it doesn't
  exist, create a new entry for it.
@@ -324,7 +424,7 @@ MakeLookupOrCreateTarget(
     YORI_STRING FullPath;
     YORI_STRING TargetNoQuotes;
     PMAKE_TARGET Target;
-    PYORI_HASH_ENTRY HashEntry;
+    PYORI_OPEN_HASH_ENTRY HashEntry;
     PMAKE_CONTEXT MakeContext;
 
     if (!MakeResolveFullTargetName(ScopeContext, TargetName, &TargetNoQuotes, &FullPath)) {
@@ -333,45 +433,16 @@ MakeLookupOrCreateTarget(
 
     MakeContext = ScopeContext->MakeContext;
 
-    HashEntry = YoriLibHashLookupByKey(MakeContext->Targets, &FullPath);
+    HashEntry = YoriLibOpenHashLookupByKey(MakeContext->Targets, &FullPath);
     if (HashEntry != NULL) {
         Target = HashEntry->Context;
         YoriLibFreeStringContents(&FullPath);
     } else {
-
-        Target = MakeSlabAlloc(&ScopeContext->MakeContext->TargetAllocator, sizeof(MAKE_TARGET));
+        Target = MakeAllocateTarget(MakeContext, &FullPath);
+        YoriLibFreeStringContents(&FullPath);
         if (Target == NULL) {
-            YoriLibFreeStringContents(&FullPath);
             return NULL;
         }
-        ScopeContext->MakeContext->AllocTarget++;
-
-        YoriLibInitializeListHead(&Target->ParentDependents);
-        YoriLibInitializeListHead(&Target->ChildDependents);
-        YoriLibInitializeListHead(&Target->RebuildList);
-        YoriLibInitializeListHead(&Target->InferenceRuleNeededList);
-
-        Target->ScopeContext = NULL;
-        Target->ReferenceCount = 1;
-        Target->NumberParentsToBuild = 0;
-        Target->ExplicitRecipeFound = FALSE;
-        Target->Executed = FALSE;
-        Target->FileProbed = FALSE;
-        Target->FileExists = FALSE;
-        Target->ExecuteViaShell = FALSE;
-        Target->RebuildRequired = FALSE;
-        Target->DependenciesEvaluated = FALSE;
-        Target->EvaluatingDependencies = FALSE;
-        Target->InferenceRulePseudoTarget = FALSE;
-        Target->ModifiedTime.QuadPart = 0;
-        Target->InferenceRule = NULL;
-        Target->InferenceRuleParentTarget = NULL;
-        YoriLibInitEmptyString(&Target->Recipe);
-        YoriLibInitializeListHead(&Target->ExecCmds);
-        YoriLibHashInsertByKey(MakeContext->Targets, &FullPath, Target, &Target->HashEntry);
-        YoriLibAppendList(&MakeContext->TargetsList, &Target->ListEntry);
-
-        YoriLibFreeStringContents(&FullPath);
     }
 
 #if MAKE_DEBUG_TARGETS
@@ -388,7 +459,7 @@ MakeLookupOrCreateTarget(
         YoriLibCompareStringLitIns(&TargetNoQuotes, MAKE_DEFAULT_SCOPE_TARGET_NAME) != 0) {
 
         if (!MakeCreateParentChildDependency(ScopeContext->MakeContext, Target, ScopeContext->DefaultTarget)) {
-            MakeDeactivateTarget(Target);
+            MakeDeactivateTarget(ScopeContext->MakeContext, Target);
             return NULL;
         }
 
@@ -987,7 +1058,7 @@ MakeFindInferenceRuleForTarget(
 #if MAKE_DEBUG_TARGETS
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("GetFileAttributes for: %s\n"), FileToProbe->StartOfString);
 #endif
-            if (GetFileAttributes(FileToProbe->StartOfString) != (DWORD)-1) {
+            if (MakeProbeFileExists(ScopeContext->MakeContext, FileToProbe)) {
                 FileToProbe->LengthInChars = FileToProbe->LengthInChars + InferenceRule->SourceExtension.LengthInChars;
                 if (!MakeAssignInferenceRuleToTarget(ScopeContext, Target, InferenceRule, FileToProbe)) {
                     return FALSE;
@@ -1041,7 +1112,7 @@ MakeFindInferenceRuleForTarget(
 #if MAKE_DEBUG_TARGETS
                     YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Nested GetFileAttributes for: %s\n"), NestedFileToProbe->StartOfString);
 #endif
-                    if (GetFileAttributes(NestedFileToProbe->StartOfString) != (DWORD)-1) {
+                    if (MakeProbeFileExists(ScopeContext->MakeContext, NestedFileToProbe)) {
 
                         //
                         //  First, generate the outer rule, assigning the
@@ -1213,6 +1284,59 @@ MakeCreateParentChildDependency(
     return TRUE;
 }
 
+/**
+ Generate the name of the source file that the inference rule for a target
+ will use to construct it.  This is the value of $< for the target.
+
+ @param Target Pointer to the target, which must have an inference rule.
+
+ @param SourceName On successful completion, updated to contain a newly
+        allocated string containing the source file name.  The caller is
+        expected to free this with @ref YoriLibFreeStringContents .
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+MakeBuildInferenceSourceName(
+    __in PMAKE_TARGET Target,
+    __out PYORI_STRING SourceName
+    )
+{
+    YORI_STRING BaseName;
+    YORI_ALLOC_SIZE_T CharsNeeded;
+    YORI_ALLOC_SIZE_T Index;
+    BOOLEAN PathMatch;
+
+    ASSERT(Target->InferenceRule != NULL);
+
+    CharsNeeded = MakeCountExtraInferenceRuleChars(Target->InferenceRule);
+    if (!YoriLibAllocateString(SourceName, Target->HashEntry.Key.LengthInChars + CharsNeeded + 1)) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&BaseName);
+    BaseName.StartOfString = Target->HashEntry.Key.StartOfString;
+    BaseName.LengthInChars = Target->HashEntry.Key.LengthInChars;
+    for (Index = Target->HashEntry.Key.LengthInChars; Index > 0; Index--) {
+        if (Target->HashEntry.Key.StartOfString[Index - 1] == '.') {
+            BaseName.LengthInChars = Index;
+            break;
+        }
+    }
+
+    PathMatch = MakeBuildProbeNameFromInferenceRule(Target->InferenceRule, &BaseName, SourceName);
+
+    //
+    //  An inference rule shouldn't be attached to the target if it
+    //  can't process the target.
+    //
+
+    ASSERT(PathMatch);
+
+    return TRUE;
+}
+
 /**
  Expand a target specific special variable.
 
@@ -1257,7 +1381,7 @@ MakeExpandTargetVariable(
     if (SymbolChars == 0) {
         return FALSE;
     }
-    MakeProbeTargetFile(Target);
+    MakeProbeTargetFile(MakeContext, Target);
 
     YoriLibInitEmptyString(&BaseVariableName);
     BaseVariableName.StartOfString = VariableName->StartOfString;
@@ -1305,7 +1429,7 @@ MakeExpandTargetVariable(
         ListEntry = YoriLibGetNextListEntry(&Target->ParentDependents, NULL);
         while (ListEntry != NULL) {
             DependentTarget = CONTAINING_RECORD(ListEntry, MAKE_TARGET_DEPENDENCY, ChildDependents);
-            MakeProbeTargetFile(DependentTarget->Parent);
+            MakeProbeTargetFile(MakeContext, DependentTarget->Parent);
             if (!Target->FileExists ||
                 !DependentTarget->Parent->FileExists ||
                 DependentTarget->Parent->ModifiedTime.QuadPart > Target->ModifiedTime.QuadPart) {
@@ -1324,7 +1448,7 @@ MakeExpandTargetVariable(
         ListEntry = YoriLibGetNextListEntry(&Target->ParentDependents, NULL);
         while (ListEntry != NULL) {
             DependentTarget = CONTAINING_RECORD(ListEntry, MAKE_TARGET_DEPENDENCY, ChildDependents);
-            MakeProbeTargetFile(DependentTarget->Parent);
+            MakeProbeTargetFile(MakeContext, DependentTarget->Parent);
             if (!Target->FileExists ||
                 !DependentTarget->Parent->FileExists ||
                 DependentTarget->Parent->ModifiedTime.QuadPart > Target->ModifiedTime.QuadPart) {
@@ -1378,35 +1502,16 @@ MakeExpandTargetVariable(
     } else if (YoriLibCompareStringLit(&BaseVariableName, _T("<")) == 0 &&
                Target->InferenceRule != NULL) {
 
-        YORI_STRING BaseName;
-        YORI_ALLOC_SIZE_T CharsNeeded;
-        BOOLEAN PathMatch;
-
-        CharsNeeded = MakeCountExtraInferenceRuleChars(Target->InferenceRule);
-        if (!YoriLibAllocateString(VariableData, Target->HashEntry.Key.LengthInChars + CharsNeeded + 1)) {
+        if (!MakeBuildInferenceSourceName(Target, VariableData)) {
             return FALSE;
         }
         MakeContext->AllocVariableData++;
+        Result = TRUE;
+    } else if (YoriLibCompareStringLit(&BaseVariableName, _T("<")) == 0 &&
+               Target->CachedInferenceSource.LengthInChars > 0) {
 
-        YoriLibInitEmptyString(&BaseName);
-        BaseName.StartOfString = Target->HashEntry.Key.StartOfString;
-        BaseName.LengthInChars = Target->HashEntry.Key.LengthInChars;
-        for (Index = Target->HashEntry.Key.LengthInChars; Index > 0; Index--) {
-            if (Target->HashEntry.Key.StartOfString[Index - 1] == '.') {
-                BaseName.LengthInChars = Index;
-                break;
-            }
-        }
-
-        PathMatch = MakeBuildProbeNameFromInferenceRule(Target->InferenceRule, &BaseName, VariableData);
-
-        //
-        //  An inference rule shouldn't be attached to the target if it
-        //  can't process the target.
-        //
-
-        ASSERT(PathMatch);
-
+        VariableData->StartOfString = Target->CachedInferenceSource.StartOfString;
+        VariableData->LengthInChars = Target->CachedInferenceSource.LengthInChars;
         Result = TRUE;
     }
 
@@ -1664,18 +1769,16 @@ MakeMarkTargetForRebuild(
     }
 
     //
-    //  MSFIX Ideally these lists would be sorted or approximately sorted
-    //  where the targets that have the most dependencies are done before
-    //  those with fewer dependencies.  Doing this intelligently really
-    //  requires knowledge of all ancestors.  Appending to the end means
-    //  that depth first traversal should ensure that all dependencies are
-    //  satisfied, and if many targets depend on one target that target
-    //  should be uncovered relatively early.
+    //  The ready list is ordered by critical path, but that can't be known
+    //  until all ancestors have been discovered.  At this point every
+    //  target has the same priority so it is appended to the end, and the
+    //  list is sorted by MakeCalculateCriticalPaths once the graph is
+    //  complete.
     //
 
     Target->RebuildRequired = TRUE;
     if (Target->NumberParentsToBuild == 0) {
-        YoriLibAppendList(&MakeContext->TargetsReady, &Target->RebuildList);
+        MakeAddTargetToReadyList(MakeContext, Target);
     } else {
         YoriLibAppendList(&MakeContext->TargetsWaiting, &Target->RebuildList);
     }
@@ -1760,7 +1863,7 @@ MakeDetermineDependenciesForTarget(
         return FALSE;
     }
 
-    MakeProbeTargetFile(Target);
+    MakeProbeTargetFile(MakeContext, Target);
 
     Target->EvaluatingDependencies = TRUE;
 
@@ -1802,7 +1905,7 @@ MakeDetermineDependenciesForTarget(
             Target->NumberParentsToBuild = Target->NumberParentsToBuild + 1;
             SetRebuildRequired = TRUE;
         }
-        MakeProbeTargetFile(Parent);
+        MakeProbeTargetFile(MakeContext, Parent);
         if (Parent->FileExists && Target->FileExists && Parent->ModifiedTime.QuadPart > Target->ModifiedTime.QuadPart) {
             SetRebuildRequired = TRUE;
         }
@@ -1942,4 +2045,103 @@ MakeDetermineDependencies(
     return MakeDetermineDependenciesForTarget(MakeContext, Target);
 }
 
+/**
+ Calculate the critical path for a target.  This is the estimated time to
+ execute the recipe for the target plus the longest critical path of any
+ target that depends on it and also needs to be rebuilt.
+
+ @param Target Pointer to the target to calculate the critical path for.
+
+ @return The critical path time for the target, in milliseconds.
+ */
+DWORDLONG
+MakeCalculateCriticalPathForTarget(
+    __in PMAKE_TARGET Target
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_TARGET_DEPENDENCY Dependency;
+    DWORDLONG LongestChild;
+    DWORDLONG ChildTime;
+    DWORDLONG OwnTime;
+
+    if (Target->CriticalPathCalculated) {
+        return Target->CriticalPathTime;
+    }
+
+    //
+    //  Mark the target as calculated before recursing.  The dependency
+    //  graph has already been checked for cycles, but this ensures that
+    //  any cycle here terminates.
+    //
+
+    Target->CriticalPathCalculated = TRUE;
+    Target->CriticalPathTime = 0;
+
+    LongestChild = 0;
+    ListEntry = YoriLibGetNextListEntry(&Target->ChildDependents, NULL);
+    while (ListEntry != NULL) {
+        Dependency = CONTAINING_RECORD(ListEntry, MAKE_TARGET_DEPENDENCY, ParentDependents);
+        if (Dependency->Child->RebuildRequired) {
+            ChildTime = MakeCalculateCriticalPathForTarget(Dependency->Child);
+            if (ChildTime > LongestChild) {
+                LongestChild = ChildTime;
+            }
+        }
+        ListEntry = YoriLibGetNextListEntry(&Target->ChildDependents, ListEntry);
+    }
+
+    //
+    //  If a previous build recorded how long this target took, use that.
+    //  Otherwise, assume each command takes a fixed amount of time, which
+    //  means targets with more commands are assumed to take longer.
+    //
+
+    if (Target->RecordedDurationFound) {
+        OwnTime = Target->RecordedDuration;
+    } else {
+        OwnTime = 0;
+        ListEntry = YoriLibGetNextListEntry(&Target->ExecCmds, NULL);
+        while (ListEntry != NULL) {
+            OwnTime = OwnTime + MAKE_DEFAULT_CMD_DURATION;
+            ListEntry = YoriLibGetNextListEntry(&Target->ExecCmds, ListEntry);
+        }
+    }
+
+    Target->CriticalPathTime = OwnTime + LongestChild;
+    return Target->CriticalPathTime;
+}
+
+/**
+ Calculate the critical path for every target that requires rebuilding, and
+ sort the list of targets that are ready to execute so that the targets on
+ the longest dependency chains are launched first.
+
+ @param MakeContext Pointer to the context.
+ */
+VOID
+MakeCalculateCriticalPaths(
+    __in PMAKE_CONTEXT MakeContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_TARGET Target;
+
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsReady, NULL);
+    while (ListEntry != NULL) {
+        Target = CONTAINING_RECORD(ListEntry, MAKE_TARGET, RebuildList);
+        MakeCalculateCriticalPathForTarget(Target);
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsReady, ListEntry);
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsWaiting, NULL);
+    while (ListEntry != NULL) {
+        Target = CONTAINING_RECORD(ListEntry, MAKE_TARGET, RebuildList);
+        MakeCalculateCriticalPathForTarget(Target);
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsWaiting, ListEntry);
+    }
+
+    MakeSortReadyTargets(MakeContext);
+}
+
 // vim:sw=4:ts=4:et:
@@ -0,0 +1,768 @@
+/**
+ * @file more/filter.c
+ *
+ * Yori shell more apply filters to lines in parallel
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "more.h"
+
+/**
+ The results of applying a filter to one range of physical lines.
+ */
+typedef struct _MORE_FILTER_RANGE_RESULT {
+
+    /**
+     A bitmap with one bit per line in the range, set if the line matches the
+     filter.
+     */
+    DWORD Matches[MORE_LINE_INDEX_CHUNK_SIZE / 32];
+
+    /**
+     Set to TRUE once the range has been completely processed.
+     */
+    LONG Complete;
+} MORE_FILTER_RANGE_RESULT, *PMORE_FILTER_RANGE_RESULT;
+
+/**
+ State for a pass which applies a filter to lines that have already been
+ ingested.  Lines are divided into ranges of MORE_LINE_INDEX_CHUNK_SIZE lines
+ which are processed by any number of threads, and results are published to
+ the FilteredLines index by a single coordinating thread in line order.
+ */
+typedef struct _MORE_FILTER_PASS {
+
+    /**
+     Pointer to the more context whose lines are being filtered.
+     */
+    PMORE_CONTEXT MoreContext;
+
+    /**
+     A private copy of the search strings to match.  The pass does not refer
+     to the strings in the more context, since the user can edit those while
+     the pass is running.
+     */
+    YORI_STRING SearchStrings[MORE_MAX_SEARCHES];
+
+    /**
+     The number of elements in SearchStrings.
+     */
+    UCHAR SearchCount;
+
+    /**
+     The compiled form of SearchStrings if they are regular expressions.
+     */
+    PYORI_LIB_REGEX SearchRegex;
+
+    /**
+     The compiled form of SearchStrings if they are text to find.
+     */
+    PYORI_LIB_SUBSTR_MATCHER SearchMatcher;
+
+    /**
+     A copy of the array of chunks from the PhysicalLines index, captured
+     under the PhysicalLineMutex, describing the lines being processed.  The
+     chunks themselves never move, so this can be used without the mutex.
+     */
+    PMORE_LINE_INDEX_CHUNK *Chunks;
+
+    /**
+     The number of elements allocated in Chunks.
+     */
+    YORI_ALLOC_SIZE_T ChunksAllocated;
+
+    /**
+     The position of the first line being processed in the current round.
+     */
+    DWORDLONG FirstLine;
+
+    /**
+     The position after the final line being processed in the current round.
+     */
+    DWORDLONG EndLine;
+
+    /**
+     An array of results, one per range in the current round.
+     */
+    PMORE_FILTER_RANGE_RESULT Results;
+
+    /**
+     The number of elements allocated in Results.
+     */
+    LONG ResultsAllocated;
+
+    /**
+     The number of ranges in the current round.
+     */
+    LONG RangeCount;
+
+    /**
+     The next range for a thread to process.  Threads claim ranges by
+     incrementing this value.
+     */
+    LONG NextRange;
+
+    /**
+     Set to TRUE to indicate that all threads should stop processing.
+     */
+    LONG Cancel;
+
+    /**
+     An event that is signalled each time a range has been processed.
+     */
+    HANDLE RangeCompleteEvent;
+
+    /**
+     The thread that processes ranges and publishes results.
+     */
+    HANDLE CoordinatorThread;
+} MORE_FILTER_PASS;
+
+/**
+ Check whether a physical line matches the filter being applied by a pass.
+
+ @param Pass Pointer to the filter pass.
+
+ @param Line Pointer to the physical line to check.
+
+ @return TRUE if the line matches, FALSE if it does not.
+ */
+BOOLEAN
+MoreFilterPassMatchLine(
+    __in PMORE_FILTER_PASS Pass,
+    __in PMORE_PHYSICAL_LINE Line
+    )
+{
+    PYORI_STRING Found;
+
+    if (Pass->SearchRegex != NULL) {
+        Found = MoreRegexFindFirstNonEmpty(Pass->SearchRegex, &Line->LineContents, NULL, NULL);
+    } else if (Pass->SearchMatcher != NULL) {
+        Found = YoriLibSubstrMatcherFindFirst(Pass->SearchMatcher, &Line->LineContents, NULL);
+    } else {
+        Found = YoriLibFindFirstMatchSubstrIns(&Line->LineContents, Pass->SearchCount, Pass->SearchStrings, NULL);
+    }
+
+    if (Found != NULL) {
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/**
+ Return a physical line from the set captured by a filter pass.
+
+ @param Pass Pointer to the filter pass.
+
+ @param Position The zero based position of the line within PhysicalLines.
+
+ @return Pointer to the physical line.
+ */
+PMORE_PHYSICAL_LINE
+MoreFilterPassGetLine(
+    __in PMORE_FILTER_PASS Pass,
+    __in DWORDLONG Position
+    )
+{
+    return Pass->Chunks[Position / MORE_LINE_INDEX_CHUNK_SIZE]->Lines[Position % MORE_LINE_INDEX_CHUNK_SIZE];
+}
+
+/**
+ Claim and process ranges of lines until no more ranges are available or
+ the pass is cancelled.
+
+ @param Pass Pointer to the filter pass.
+
+ @param ReturnAfterOne If TRUE, return after processing a single range, so
+        the caller can publish results.
+
+ @return TRUE if a range was processed, FALSE if no ranges remain.
+ */
+BOOLEAN
+MoreFilterPassProcessRanges(
+    __in PMORE_FILTER_PASS Pass,
+    __in BOOLEAN ReturnAfterOne
+    )
+{
+    LONG RangeIndex;
+    DWORDLONG Position;
+    DWORDLONG RangeEnd;
+    DWORD LineInRange;
+    PMORE_FILTER_RANGE_RESULT Result;
+    BOOLEAN Processed;
+
+    Processed = FALSE;
+    while (Pass->Cancel == FALSE) {
+        RangeIndex = InterlockedIncrement(&Pass->NextRange) - 1;
+        if (RangeIndex >= Pass->RangeCount) {
+            break;
+        }
+
+        Result = &Pass->Results[RangeIndex];
+        ZeroMemory(Result->Matches, sizeof(Result->Matches));
+
+        Position = Pass->FirstLine + (DWORDLONG)RangeIndex * MORE_LINE_INDEX_CHUNK_SIZE;
+        RangeEnd = Position + MORE_LINE_INDEX_CHUNK_SIZE;
+        if (RangeEnd > Pass->EndLine) {
+            RangeEnd = Pass->EndLine;
+        }
+
+        for (LineInRange = 0; Position < RangeEnd; Position++, LineInRange++) {
+            if (Pass->Cancel) {
+                break;
+            }
+            if (MoreFilterPassMatchLine(Pass, MoreFilterPassGetLine(Pass, Position))) {
+                Result->Matches[LineInRange / 32] |= ((DWORD)1 << (LineInRange % 32));
+            }
+        }
+
+        InterlockedExchange(&Result->Complete, TRUE);
+        SetEvent(Pass->RangeCompleteEvent);
+        Processed = TRUE;
+
+        if (ReturnAfterOne) {
+            break;
+        }
+    }
+
+    return Processed;
+}
+
+/**
+ A worker thread which processes ranges of lines for a filter pass.
+
+ @param Context Pointer to the filter pass.
+
+ @return DWORD, ignored.
+ */
+DWORD WINAPI
+MoreFilterPassWorker(
+    __in LPVOID Context
+    )
+{
+    MoreFilterPassProcessRanges((PMORE_FILTER_PASS)Context, FALSE);
+    return 0;
+}
+
+/**
+ Add the matching lines from a processed range to the FilteredLines index.
+ The caller is expected to hold the PhysicalLineMutex.
+
+ @param Pass Pointer to the filter pass.
+
+ @param RangeIndex Specifies the range to publish.
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.
+ */
+__success(return)
+BOOLEAN
+MoreFilterPassPublishRange(
+    __in PMORE_FILTER_PASS Pass,
+    __in LONG RangeIndex
+    )
+{
+    PMORE_CONTEXT MoreContext;
+    PMORE_FILTER_RANGE_RESULT Result;
+    DWORDLONG Position;
+    DWORDLONG RangeEnd;
+    DWORD LineInRange;
+
+    MoreContext = Pass->MoreContext;
+    Result = &Pass->Results[RangeIndex];
+
+    Position = Pass->FirstLine + (DWORDLONG)RangeIndex * MORE_LINE_INDEX_CHUNK_SIZE;
+    RangeEnd = Position + MORE_LINE_INDEX_CHUNK_SIZE;
+    if (RangeEnd > Pass->EndLine) {
+        RangeEnd = Pass->EndLine;
+    }
+
+    ASSERT(MoreContext->FilterLinesProcessed == Position);
+
+    for (LineInRange = 0; Position < RangeEnd; Position++, LineInRange++) {
+        if (Result->Matches[LineInRange / 32] & ((DWORD)1 << (LineInRange % 32))) {
+            if (!MoreLineIndexAppend(&MoreContext->FilteredLines, MoreFilterPassGetLine(Pass, Position))) {
+                return FALSE;
+            }
+            MoreContext->FilteredLineCount++;
+        }
+        MoreContext->FilterLinesProcessed++;
+    }
+
+    return TRUE;
+}
+
+/**
+ Capture the set of lines that have been ingested but not yet filtered, and
+ prepare to process them in ranges.  The caller is expected to hold the
+ PhysicalLineMutex.
+
+ @param Pass Pointer to the filter pass.
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.
+ */
+__success(return)
+BOOLEAN
+MoreFilterPassCaptureLines(
+    __in PMORE_FILTER_PASS Pass
+    )
+{
+    PMORE_CONTEXT MoreContext;
+    PMORE_LINE_INDEX Index;
+    LONG RangeCount;
+
+    MoreContext = Pass->MoreContext;
+    Index = &MoreContext->PhysicalLines;
+
+    if (Index->ChunkCount > Pass->ChunksAllocated) {
+        if (Pass->Chunks != NULL) {
+            YoriLibFree(Pass->Chunks);
+        }
+        Pass->ChunksAllocated = 0;
+        Pass->Chunks = YoriLibMalloc(Index->ChunkCount * sizeof(PMORE_LINE_INDEX_CHUNK));
+        if (Pass->Chunks == NULL) {
+            return FALSE;
+        }
+        Pass->ChunksAllocated = Index->ChunkCount;
+    }
+
+    if (Index->ChunkCount > 0) {
+        memcpy(Pass->Chunks, Index->Chunks, Index->ChunkCount * sizeof(PMORE_LINE_INDEX_CHUNK));
+    }
+    Pass->FirstLine = MoreContext->FilterLinesProcessed;
+    Pass->EndLine = Index->LineCount;
+
+    RangeCount = (LONG)((Pass->EndLine - Pass->FirstLine + MORE_LINE_INDEX_CHUNK_SIZE - 1) / MORE_LINE_INDEX_CHUNK_SIZE);
+    if (RangeCount > Pass->ResultsAllocated) {
+        if (Pass->Results != NULL) {
+            YoriLibFree(Pass->Results);
+        }
+        Pass->ResultsAllocated = 0;
+        Pass->Results = YoriLibMalloc(RangeCount * sizeof(MORE_FILTER_RANGE_RESULT));
+        if (Pass->Results == NULL) {
+            return FALSE;
+        }
+        Pass->ResultsAllocated = RangeCount;
+    }
+
+    Pass->RangeCount = RangeCount;
+    Pass->NextRange = 0;
+    if (RangeCount > 0) {
+        ZeroMemory(Pass->Results, RangeCount * sizeof(MORE_FILTER_RANGE_RESULT));
+    }
+
+    return TRUE;
+}
+
+/**
+ Apply the filter to a captured set of lines using all available processors,
+ publishing results in order as ranges complete.
+
+ @param Pass Pointer to the filter pass.
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.
+ */
+__success(return)
+BOOLEAN
+MoreFilterPassProcessRound(
+    __in PMORE_FILTER_PASS Pass
+    )
+{
+    PMORE_CONTEXT MoreContext;
+    SYSTEM_INFO SystemInfo;
+    HANDLE WorkerThreads[MAXIMUM_WAIT_OBJECTS];
+    DWORD WorkerCount;
+    DWORD WorkerIndex;
+    DWORD ThreadId;
+    LONG NextToPublish;
+    BOOLEAN Result;
+
+    MoreContext = Pass->MoreContext;
+
+    //
+    //  This thread processes ranges too, so start one fewer worker than the
+    //  number of processors, and don't start workers that would have no
+    //  range to process.
+    //
+
+    GetSystemInfo(&SystemInfo);
+    WorkerCount = SystemInfo.dwNumberOfProcessors;
+    if (WorkerCount > (DWORD)Pass->RangeCount) {
+        WorkerCount = (DWORD)Pass->RangeCount;
+    }
+    if (WorkerCount > MAXIMUM_WAIT_OBJECTS) {
+        WorkerCount = MAXIMUM_WAIT_OBJECTS;
+    }
+    if (WorkerCount > 0) {
+        WorkerCount--;
+    }
+
+    for (WorkerIndex = 0; WorkerIndex < WorkerCount; WorkerIndex++) {
+        WorkerThreads[WorkerIndex] = CreateThread(NULL, 0, MoreFilterPassWorker, Pass, 0, &ThreadId);
+        if (WorkerThreads[WorkerIndex] == NULL) {
+            break;
+        }
+    }
+    WorkerCount = WorkerIndex;
+
+    //
+    //  Publish any ranges that are complete, then help process the next
+    //  range.  If all ranges have been claimed, wait for another thread to
+    //  complete one.
+    //
+
+    Result = TRUE;
+    NextToPublish = 0;
+    while (NextToPublish < Pass->RangeCount && !Pass->Cancel) {
+        if (Pass->Results[NextToPublish].Complete) {
+            WaitForSingleObject(MoreContext->PhysicalLineMutex, INFINITE);
+            while (NextToPublish < Pass->RangeCount &&
+                   Pass->Results[NextToPublish].Complete) {
+
+                if (!MoreFilterPassPublishRange(Pass, NextToPublish)) {
+                    Result = FALSE;
+                    break;
+                }
+                NextToPublish++;
+            }
+            ReleaseMutex(MoreContext->PhysicalLineMutex);
+
+            SetEvent(MoreContext->PhysicalLineAvailableEvent);
+            SetEvent(MoreContext->FilterProgressEvent);
+
+            if (!Result) {
+                InterlockedExchange(&Pass->Cancel, TRUE);
+                break;
+            }
+            continue;
+        }
+
+        if (!MoreFilterPassProcessRanges(Pass, TRUE)) {
+            WaitForSingleObject(Pass->RangeCompleteEvent, INFINITE);
+        }
+    }
+
+    for (WorkerIndex = 0; WorkerIndex < WorkerCount; WorkerIndex++) {
+        WaitForSingleObject(WorkerThreads[WorkerIndex], INFINITE);
+        CloseHandle(WorkerThreads[WorkerIndex]);
+    }
+
+    return Result;
+}
+
+/**
+ The thread which coordinates a filter pass.  Lines that have been ingested
+ are filtered in parallel, and while that happens the ingest thread continues
+ to add more lines.  Once few enough lines remain, they are filtered with the
+ PhysicalLineMutex held, so that the ingest thread can filter each line as it
+ is added from then on.
+
+ @param Context Pointer to the filter pass.
+
+ @return DWORD, ignored.
+ */
+DWORD WINAPI
+MoreFilterPassCoordinator(
+    __in LPVOID Context
+    )
+{
+    PMORE_FILTER_PASS Pass;
+    PMORE_CONTEXT MoreContext;
+    DWORDLONG Position;
+
+    Pass = (PMORE_FILTER_PASS)Context;
+    MoreContext = Pass->MoreContext;
+
+    while (!Pass->Cancel) {
+        WaitForSingleObject(MoreContext->PhysicalLineMutex, INFINITE);
+
+        //
+        //  If less than a range remains, finish here while holding the
+        //  mutex.
+        //
+
+        if (MoreContext->LineCount - MoreContext->FilterLinesProcessed < MORE_LINE_INDEX_CHUNK_SIZE) {
+            for (Position = MoreContext->FilterLinesProcessed; Position < MoreContext->LineCount; Position++) {
+                if (MoreFilterPassMatchLine(Pass, MoreLineIndexGetLine(&MoreContext->PhysicalLines, Position))) {
+                    if (!MoreLineIndexAppend(&MoreContext->FilteredLines, MoreLineIndexGetLine(&MoreContext->PhysicalLines, Position))) {
+                        MoreContext->OutOfMemory = TRUE;
+                        break;
+                    }
+                    MoreContext->FilteredLineCount++;
+                }
+                MoreContext->FilterLinesProcessed++;
+            }
+            ReleaseMutex(MoreContext->PhysicalLineMutex);
+            break;
+        }
+
+        if (!MoreFilterPassCaptureLines(Pass)) {
+            ReleaseMutex(MoreContext->PhysicalLineMutex);
+            MoreContext->OutOfMemory = TRUE;
+            break;
+        }
+        ReleaseMutex(MoreContext->PhysicalLineMutex);
+
+        if (!MoreFilterPassProcessRound(Pass)) {
+            MoreContext->OutOfMemory = TRUE;
+            break;
+        }
+    }
+
+    SetEvent(MoreContext->PhysicalLineAvailableEvent);
+    SetEvent(MoreContext->FilterProgressEvent);
+    return 0;
+}
+
+/**
+ Free a filter pass.  The pass must not be running.
+
+ @param Pass Pointer to the filter pass to free.
+ */
+VOID
+MoreFreeFilterPass(
+    __in PMORE_FILTER_PASS Pass
+    )
+{
+    UCHAR Index;
+
+    if (Pass->CoordinatorThread != NULL) {
+        CloseHandle(Pass->CoordinatorThread);
+    }
+
+    if (Pass->RangeCompleteEvent != NULL) {
+        CloseHandle(Pass->RangeCompleteEvent);
+    }
+
+    if (Pass->SearchRegex != NULL) {
+        YoriLibFreeRegex(Pass->SearchRegex);
+    }
+
+    if (Pass->SearchMatcher != NULL) {
+        YoriLibFreeSubstrMatcher(Pass->SearchMatcher);
+    }
+
+    for (Index = 0; Index < Pass->SearchCount; Index++) {
+        YoriLibFreeStringContents(&Pass->SearchStrings[Index]);
+    }
+
+    if (Pass->Chunks != NULL) {
+        YoriLibFree(Pass->Chunks);
+    }
+
+    if (Pass->Results != NULL) {
+        YoriLibFree(Pass->Results);
+    }
+
+    YoriLibFree(Pass);
+}
+
+/**
+ Stop any filter pass that is running and free it.  This waits for the pass
+ to stop, so it must not be called while holding the PhysicalLineMutex.
+
+ @param MoreContext Pointer to the more context.
+ */
+VOID
+MoreCancelFilterPass(
+    __inout PMORE_CONTEXT MoreContext
+    )
+{
+    PMORE_FILTER_PASS Pass;
+
+    Pass = MoreContext->FilterPass;
+    if (Pass == NULL) {
+        return;
+    }
+
+    InterlockedExchange(&Pass->Cancel, TRUE);
+    if (Pass->CoordinatorThread != NULL) {
+        WaitForSingleObject(Pass->CoordinatorThread, INFINITE);
+    }
+
+    MoreContext->FilterPass = NULL;
+    MoreFreeFilterPass(Pass);
+}
+
+/**
+ Start a pass to apply the current search strings to all lines that have
+ been ingested.  The caller is expected to have cancelled any previous pass
+ and reset the FilteredLines index.  Results are published to FilteredLines
+ as they become available.
+
+ @param MoreContext Pointer to the more context.
+
+ @return TRUE to indicate the pass was started, FALSE on failure.
+ */
+__success(return)
+BOOLEAN
+MoreStartFilterPass(
+    __inout PMORE_CONTEXT MoreContext
+    )
+{
+    PMORE_FILTER_PASS Pass;
+    DWORD ThreadId;
+    UCHAR CountFound;
+    UCHAR Index;
+
+    ASSERT(MoreContext->FilterPass == NULL);
+
+    Pass = YoriLibMalloc(sizeof(MORE_FILTER_PASS));
+    if (Pass == NULL) {
+        return FALSE;
+    }
+
+    ZeroMemory(Pass, sizeof(MORE_FILTER_PASS));
+    Pass->MoreContext = MoreContext;
+
+    CountFound = MoreSearchCountActive(MoreContext);
+    for (Index = 0; Index < CountFound; Index++) {
+        if (!YoriLibCopyString(&Pass->SearchStrings[Index], &MoreContext->SearchStrings[Index])) {
+            MoreFreeFilterPass(Pass);
+            return FALSE;
+        }
+        Pass->SearchCount++;
+    }
+
+    if (CountFound > 0) {
+        if (MoreContext->RegexSearch) {
+            Pass->SearchRegex = YoriLibAllocateRegex(CountFound, Pass->SearchStrings, TRUE, NULL, NULL);
+        }
+        if (Pass->SearchRegex == NULL) {
+            Pass->SearchMatcher = YoriLibAllocateSubstrMatcher(CountFound, Pass->SearchStrings, TRUE);
+        }
+    }
+
+    Pass->RangeCompleteEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (Pass->RangeCompleteEvent == NULL) {
+        MoreFreeFilterPass(Pass);
+        return FALSE;
+    }
+
+    //
+    //  If a thread can't be created, apply the filter synchronously.
+    //
+
+    MoreContext->FilterPass = Pass;
+    Pass->CoordinatorThread = CreateThread(NULL, 0, MoreFilterPassCoordinator, Pass, 0, &ThreadId);
+    if (Pass->CoordinatorThread == NULL) {
+        MoreFilterPassCoordinator(Pass);
+    }
+
+    return TRUE;
+}
+
+/**
+ Apply a new search criteria to update the set of filtered lines.  The
+ filter is applied in the background, and lines are published to the
+ FilteredLines index in order as they are processed.  This function only
+ waits for lines up to the currently displayed line to be processed, so
+ that it can find a line to display; later lines are added to the viewport
+ as they are published.
+
+ @param MoreContext Pointer to the more context, indicating the current search
+        terms.
+
+ @param PreviousStartPoint Optionally points to a physical line which is
+        currently displayed.  If specified, this function attempts to return
+        a "good" physical line to display once the new filter has been
+        applied.
+
+ @return Pointer to a physical line which should be used to display after the
+         filter has been updated.
+ */
+PMORE_PHYSICAL_LINE
+MoreUpdateFilteredLines(
+    __in PMORE_CONTEXT MoreContext,
+    __in_opt PMORE_PHYSICAL_LINE PreviousStartPoint
+    )
+{
+    DWORDLONG PreviousStartLineNumber;
+    PMORE_PHYSICAL_LINE NewStartPoint;
+    HANDLE WaitHandles[2];
+    DWORD WaitCount;
+
+    PreviousStartLineNumber = 1;
+    if (PreviousStartPoint != NULL) {
+        PreviousStartLineNumber = PreviousStartPoint->LineNumber;
+    }
+
+    MoreCancelFilterPass(MoreContext);
+
+    WaitForSingleObject(MoreContext->PhysicalLineMutex, INFINITE);
+    MoreLineIndexCleanup(&MoreContext->FilteredLines);
+    if (!MoreContext->FilterToSearch) {
+        MoreContext->FilteredLineCount = MoreContext->LineCount;
+        MoreContext->FilterLinesProcessed = MoreContext->LineCount;
+        if (PreviousStartPoint != NULL) {
+            NewStartPoint = PreviousStartPoint;
+        } else {
+            NewStartPoint = MoreLineIndexGetLine(&MoreContext->PhysicalLines, 0);
+        }
+        ReleaseMutex(MoreContext->PhysicalLineMutex);
+        return NewStartPoint;
+    }
+
+    MoreContext->FilteredLineCount = 0;
+    MoreContext->FilterLinesProcessed = 0;
+    ReleaseMutex(MoreContext->PhysicalLineMutex);
+
+    ResetEvent(MoreContext->FilterProgressEvent);
+    if (!MoreStartFilterPass(MoreContext)) {
+        MoreContext->OutOfMemory = TRUE;
+        return NULL;
+    }
+
+    //
+    //  Wait for the pass to publish a line at or after the line that was
+    //  previously displayed, or for it to finish.  Since lines are published
+    //  in order, the line found is the same as if the filter had been
+    //  applied to all lines.
+    //
+
+    WaitCount = 0;
+    WaitHandles[WaitCount++] = MoreContext->FilterProgressEvent;
+    if (MoreContext->FilterPass->CoordinatorThread != NULL) {
+        WaitHandles[WaitCount++] = MoreContext->FilterPass->CoordinatorThread;
+    }
+
+    while (TRUE) {
+        WaitForSingleObject(MoreContext->PhysicalLineMutex, INFINITE);
+        NewStartPoint = MoreLineIndexGetLine(&MoreContext->FilteredLines,
+                                             MoreLineIndexFindLineNumber(&MoreContext->FilteredLines, PreviousStartLineNumber));
+        if (NewStartPoint != NULL ||
+            MoreContext->FilterLinesProcessed == MoreContext->LineCount ||
+            MoreContext->OutOfMemory) {
+
+            break;
+        }
+        ReleaseMutex(MoreContext->PhysicalLineMutex);
+
+        WaitForMultipleObjectsEx(WaitCount, WaitHandles, FALSE, INFINITE, FALSE);
+    }
+    ReleaseMutex(MoreContext->PhysicalLineMutex);
+
+    return NewStartPoint;
+}
+
+// vim:sw=4:ts=4:et:
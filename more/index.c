@@ -0,0 +1,217 @@
+/**
+ * @file more/index.c
+ *
+ * Yori shell more index of physical lines
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "more.h"
+
+/**
+ Initialize a line index to contain no lines.  No memory is allocated until
+ a line is appended.
+
+ @param Index Pointer to the index to initialize.
+ */
+VOID
+MoreLineIndexInitialize(
+    __out PMORE_LINE_INDEX Index
+    )
+{
+    Index->Chunks = NULL;
+    Index->LineCount = 0;
+    Index->ChunkCount = 0;
+    Index->ChunkArraySize = 0;
+}
+
+/**
+ Free all memory used by a line index.  This does not free the physical lines
+ that the index refers to, since a physical line can be referred to by more
+ than one index.  On completion the index contains no lines and can be used
+ again.
+
+ @param Index Pointer to the index to clean up.
+ */
+VOID
+MoreLineIndexCleanup(
+    __inout PMORE_LINE_INDEX Index
+    )
+{
+    YORI_ALLOC_SIZE_T ChunkIndex;
+
+    for (ChunkIndex = 0; ChunkIndex < Index->ChunkCount; ChunkIndex++) {
+        YoriLibFree(Index->Chunks[ChunkIndex]);
+    }
+
+    if (Index->Chunks != NULL) {
+        YoriLibFree(Index->Chunks);
+    }
+
+    MoreLineIndexInitialize(Index);
+}
+
+/**
+ Add a physical line to the end of a line index.  The caller is expected to
+ hold the lock that synchronizes the index.
+
+ @param Index Pointer to the index to add the line to.
+
+ @param Line Pointer to the physical line to add.
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.
+ */
+__success(return)
+BOOLEAN
+MoreLineIndexAppend(
+    __inout PMORE_LINE_INDEX Index,
+    __in PMORE_PHYSICAL_LINE Line
+    )
+{
+    YORI_ALLOC_SIZE_T ChunkIndex;
+    YORI_ALLOC_SIZE_T LineInChunk;
+    YORI_ALLOC_SIZE_T NewArraySize;
+    PMORE_LINE_INDEX_CHUNK *NewChunks;
+
+    ChunkIndex = (YORI_ALLOC_SIZE_T)(Index->LineCount / MORE_LINE_INDEX_CHUNK_SIZE);
+    LineInChunk = (YORI_ALLOC_SIZE_T)(Index->LineCount % MORE_LINE_INDEX_CHUNK_SIZE);
+
+    if (ChunkIndex >= Index->ChunkCount) {
+
+        //
+        //  Grow the array of chunks if needed.  The chunks themselves don't
+        //  move, so only the pointers are copied.
+        //
+
+        if (Index->ChunkCount >= Index->ChunkArraySize) {
+            NewArraySize = Index->ChunkArraySize * 2;
+            if (NewArraySize < 16) {
+                NewArraySize = 16;
+            }
+
+            NewChunks = YoriLibMalloc(NewArraySize * sizeof(PMORE_LINE_INDEX_CHUNK));
+            if (NewChunks == NULL) {
+                return FALSE;
+            }
+
+            if (Index->Chunks != NULL) {
+                memcpy(NewChunks, Index->Chunks, Index->ChunkCount * sizeof(PMORE_LINE_INDEX_CHUNK));
+                YoriLibFree(Index->Chunks);
+            }
+
+            Index->Chunks = NewChunks;
+            Index->ChunkArraySize = NewArraySize;
+        }
+
+        Index->Chunks[Index->ChunkCount] = YoriLibMalloc(sizeof(MORE_LINE_INDEX_CHUNK));
+        if (Index->Chunks[Index->ChunkCount] == NULL) {
+            return FALSE;
+        }
+        Index->ChunkCount++;
+    }
+
+    Index->Chunks[ChunkIndex]->Lines[LineInChunk] = Line;
+    Index->LineCount++;
+    return TRUE;
+}
+
+/**
+ Return the physical line at a specified position within a line index.
+
+ @param Index Pointer to the index.
+
+ @param Position The zero based position of the line within the index.
+
+ @return Pointer to the physical line, or NULL if the position is beyond the
+         end of the index.
+ */
+PMORE_PHYSICAL_LINE
+MoreLineIndexGetLine(
+    __in PMORE_LINE_INDEX Index,
+    __in DWORDLONG Position
+    )
+{
+    if (Position >= Index->LineCount) {
+        return NULL;
+    }
+
+    return Index->Chunks[Position / MORE_LINE_INDEX_CHUNK_SIZE]->Lines[Position % MORE_LINE_INDEX_CHUNK_SIZE];
+}
+
+/**
+ Find the position of the first line within an index whose line number is
+ greater than or equal to a specified line number.  Lines within an index are
+ always sorted by line number, so this is a binary search.
+
+ @param Index Pointer to the index.
+
+ @param LineNumber The line number to find.
+
+ @return The zero based position of the first line whose line number is
+         greater than or equal to LineNumber.  If no line is, this is the
+         number of lines in the index.
+ */
+DWORDLONG
+MoreLineIndexFindLineNumber(
+    __in PMORE_LINE_INDEX Index,
+    __in DWORDLONG LineNumber
+    )
+{
+    DWORDLONG Start;
+    DWORDLONG End;
+    DWORDLONG Middle;
+
+    Start = 0;
+    End = Index->LineCount;
+
+    while (Start < End) {
+        Middle = Start + (End - Start) / 2;
+        if (MoreLineIndexGetLine(Index, Middle)->LineNumber < LineNumber) {
+            Start = Middle + 1;
+        } else {
+            End = Middle;
+        }
+    }
+
+    return Start;
+}
+
+/**
+ Return the number of bytes allocated to describe the lines in an index.
+
+ @param Index Pointer to the index.
+
+ @return The number of bytes allocated by the index.
+ */
+DWORDLONG
+MoreLineIndexGetAllocatedBytes(
+    __in PMORE_LINE_INDEX Index
+    )
+{
+    DWORDLONG Bytes;
+
+    Bytes = (DWORDLONG)Index->ChunkArraySize * sizeof(PMORE_LINE_INDEX_CHUNK);
+    Bytes = Bytes + (DWORDLONG)Index->ChunkCount * sizeof(MORE_LINE_INDEX_CHUNK);
+    return Bytes;
+}
+
+// vim:sw=4:ts=4:et:
@@ -3,7 +3,7 @@
  *
  * Yori shell more input strings and record them in memory
  *
- * Copyright (c) 2017-2021 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -128,6 +128,7 @@ MoreAddPhysicalLineToBuffer(
             MoreContext->OutOfMemory = TRUE;
             return FALSE;
         }
+        MoreContext->LineBufferBytes = MoreContext->LineBufferBytes + AllocContext->BytesRemainingInBuffer;
     }
 
     //
@@ -137,12 +138,9 @@ MoreAddPhysicalLineToBuffer(
     NewLine = (PMORE_PHYSICAL_LINE)YoriLibAddToPointer(AllocContext->Buffer, AllocContext->BufferOffset);
 
     YoriLibReference(AllocContext->Buffer);
-    NewLine->FilteredLineList.Next = NULL;
-    NewLine->FilteredLineList.Prev = NULL;
     NewLine->MemoryToFree = AllocContext->Buffer;
     NewLine->InitialColor = AllocContext->PreviousColor;
     NewLine->LineNumber = MoreContext->LineCount + 1;
-    NewLine->FilteredLineNumber = NewLine->LineNumber;
     YoriLibReference(AllocContext->Buffer);
     NewLine->LineContents.MemoryToFree = AllocContext->Buffer;
     NewLine->LineContents.StartOfString = (LPTSTR)(NewLine + 1);
@@ -189,6 +187,7 @@ MoreAddPhysicalLineToBuffer(
     NewLine->LineContents.StartOfString[DestIndex] = '\0';
     NewLine->LineContents.LengthInChars = DestIndex;
     NewLine->LineContents.LengthAllocated = DestIndex + 1;
+    MoreContext->LineTextBytes = MoreContext->LineTextBytes + (DestIndex + 1) * sizeof(TCHAR);
 
     AllocContext->BufferOffset = AllocContext->BufferOffset + BytesRequired;
     AllocContext->BytesRemainingInBuffer = AllocContext->BytesRemainingInBuffer - BytesRequired;
@@ -206,18 +205,33 @@ MoreAddPhysicalLineToBuffer(
     }
 
     //
-    //  Insert the new line into the list
+    //  Insert the new line into the index.  If a filter pass is still
+    //  working through earlier lines, it will apply the filter to this line
+    //  when it reaches it, since filtered lines must remain in order.
     //
 
     WaitForSingleObject(MoreContext->PhysicalLineMutex, INFINITE);
+    if (!MoreLineIndexAppend(&MoreContext->PhysicalLines, NewLine)) {
+        ReleaseMutex(MoreContext->PhysicalLineMutex);
+        YoriLibDereference(AllocContext->Buffer);
+        YoriLibDereference(AllocContext->Buffer);
+        MoreContext->OutOfMemory = TRUE;
+        return FALSE;
+    }
     MoreContext->LineCount++;
-    YoriLibAppendList(&MoreContext->PhysicalLineList, &NewLine->LineList);
-    if (!MoreContext->FilterToSearch ||
-        MoreFindNextSearchMatch(MoreContext, &NewLine->LineContents, NULL, NULL)) {
-
-        YoriLibAppendList(&MoreContext->FilteredPhysicalLineList, &NewLine->FilteredLineList);
+    if (!MoreContext->FilterToSearch) {
         MoreContext->FilteredLineCount++;
-        NewLine->FilteredLineNumber = MoreContext->FilteredLineCount;
+        MoreContext->FilterLinesProcessed++;
+    } else if (MoreContext->FilterLinesProcessed + 1 == MoreContext->LineCount) {
+        if (MoreFindNextSearchMatch(MoreContext, &NewLine->LineContents, NULL, NULL, NULL)) {
+            if (!MoreLineIndexAppend(&MoreContext->FilteredLines, NewLine)) {
+                ReleaseMutex(MoreContext->PhysicalLineMutex);
+                MoreContext->OutOfMemory = TRUE;
+                return FALSE;
+            }
+            MoreContext->FilteredLineCount++;
+        }
+        MoreContext->FilterLinesProcessed++;
     }
     ReleaseMutex(MoreContext->PhysicalLineMutex);
 
@@ -389,6 +403,20 @@ MoreFileFoundCallback(
         }
         SetFilePointer(FileHandle, 0, NULL, FILE_BEGIN);
 
+        //
+        //  If the user only wants the end of the file, find where its
+        //  final lines start by scanning backwards, so that the lines
+        //  before them are never read.  If this fails, load the entire
+        //  file.
+        //
+
+        if (MoreContext->StartAtEnd) {
+            YORI_MAX_UNSIGNED_T FinalLinesOffset;
+            if (!YoriLibFindFinalLines(FileHandle, MORE_FINAL_LINE_COUNT, &FinalLinesOffset)) {
+                SetFilePointer(FileHandle, 0, NULL, FILE_BEGIN);
+            }
+        }
+
         MoreProcessStream(FileHandle, MoreContext);
 
         YoriLibSetMultibyteInputEncoding(SavedEncoding);
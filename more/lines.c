@@ -3,7 +3,7 @@
  *
  * Yori shell more search and split lines
  *
- * Copyright (c) 2017-2022 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -79,6 +79,110 @@ MoreSearchCountActive(
     return CountFound;
 }
 
+/**
+ Rebuild the compiled form of the search strings after any of them has been
+ modified.  The new matcher is swapped in under the physical line mutex so
+ the ingest thread never observes a matcher that is being freed.  If the
+ matcher cannot be allocated, searches fall back to comparing each search
+ string in turn.  If search strings are regular expressions but any of them
+ is not valid, which happens while an expression is being typed, the
+ strings are matched as text until they are valid.
+
+ @param MoreContext Pointer to the more context containing the search strings.
+ */
+VOID
+MoreSearchStringsChanged(
+    __in PMORE_CONTEXT MoreContext
+    )
+{
+    PYORI_LIB_SUBSTR_MATCHER NewMatcher;
+    PYORI_LIB_SUBSTR_MATCHER OldMatcher;
+    PYORI_LIB_REGEX NewRegex;
+    PYORI_LIB_REGEX OldRegex;
+    UCHAR CountFound;
+
+    NewMatcher = NULL;
+    NewRegex = NULL;
+    CountFound = MoreSearchCountActive(MoreContext);
+    if (CountFound > 0) {
+        if (MoreContext->RegexSearch) {
+            NewRegex = YoriLibAllocateRegex(CountFound, MoreContext->SearchStrings, TRUE, NULL, NULL);
+        }
+        if (NewRegex == NULL) {
+            NewMatcher = YoriLibAllocateSubstrMatcher(CountFound, MoreContext->SearchStrings, TRUE);
+        }
+    }
+
+    WaitForSingleObject(MoreContext->PhysicalLineMutex, INFINITE);
+    OldMatcher = MoreContext->SearchMatcher;
+    OldRegex = MoreContext->SearchRegex;
+    MoreContext->SearchMatcher = NewMatcher;
+    MoreContext->SearchRegex = NewRegex;
+    ReleaseMutex(MoreContext->PhysicalLineMutex);
+
+    if (OldMatcher != NULL) {
+        YoriLibFreeSubstrMatcher(OldMatcher);
+    }
+
+    if (OldRegex != NULL) {
+        YoriLibFreeRegex(OldRegex);
+    }
+}
+
+/**
+ Find the first nonempty match of a regular expression within a string.
+ Empty matches cannot be highlighted, so they are skipped.
+
+ @param Regex Pointer to the compiled expression.
+
+ @param StringToSearch Pointer to the string to search within.
+
+ @param MatchOffset Optionally points to a value to update on successful
+        completion indicating the offset within StringToSearch where a match
+        was found.
+
+ @param MatchLength Optionally points to a value to update on successful
+        completion indicating the number of characters matched.
+
+ @return Pointer to the pattern that matched, or NULL if no nonempty match
+         was found.
+ */
+PYORI_STRING
+MoreRegexFindFirstNonEmpty(
+    __in PYORI_LIB_REGEX Regex,
+    __in PCYORI_STRING StringToSearch,
+    __out_opt PYORI_ALLOC_SIZE_T MatchOffset,
+    __out_opt PYORI_ALLOC_SIZE_T MatchLength
+    )
+{
+    PYORI_STRING Found;
+    YORI_ALLOC_SIZE_T Offset;
+    YORI_ALLOC_SIZE_T FoundOffset;
+    YORI_ALLOC_SIZE_T FoundLength;
+
+    Offset = 0;
+    while (Offset < StringToSearch->LengthInChars) {
+        Found = YoriLibRegexFindFirst(Regex, StringToSearch, Offset, &FoundOffset, &FoundLength);
+        if (Found == NULL) {
+            break;
+        }
+
+        if (FoundLength > 0) {
+            if (MatchOffset != NULL) {
+                *MatchOffset = FoundOffset;
+            }
+            if (MatchLength != NULL) {
+                *MatchLength = FoundLength;
+            }
+            return Found;
+        }
+
+        Offset = FoundOffset + 1;
+    }
+
+    return NULL;
+}
+
 /**
  Find the next search match within a physical line.
 
@@ -92,6 +196,9 @@ MoreSearchCountActive(
         completion indicating the offset within StringToSearch where a match
         was found.
 
+ @param MatchLength Optionally points to a value to update on successful
+        completion indicating the number of characters matched.
+
  @param MatchIndex Optionally points to a value to update on successful
         completion indicating which matching string was located.
 
@@ -103,17 +210,32 @@ MoreFindNextSearchMatch(
     __in PMORE_CONTEXT MoreContext,
     __in PCYORI_STRING StringToSearch,
     __out_opt PYORI_ALLOC_SIZE_T MatchOffset,
+    __out_opt PYORI_ALLOC_SIZE_T MatchLength,
     __out_opt PUCHAR MatchIndex
     )
 {
     PYORI_STRING Found;
+    YORI_ALLOC_SIZE_T FoundLength;
     UCHAR Index;
     UCHAR CountFound;
 
     CountFound = MoreSearchCountActive(MoreContext);
 
-    Found = YoriLibFindFirstMatchSubstrIns(StringToSearch, CountFound, MoreContext->SearchStrings, MatchOffset);
+    if (MoreContext->SearchRegex != NULL) {
+        Found = MoreRegexFindFirstNonEmpty(MoreContext->SearchRegex, StringToSearch, MatchOffset, &FoundLength);
+    } else if (MoreContext->SearchMatcher != NULL) {
+        Found = YoriLibSubstrMatcherFindFirst(MoreContext->SearchMatcher, StringToSearch, MatchOffset);
+    } else {
+        Found = YoriLibFindFirstMatchSubstrIns(StringToSearch, CountFound, MoreContext->SearchStrings, MatchOffset);
+    }
     if (Found != NULL) {
+        if (MatchLength != NULL) {
+            if (MoreContext->SearchRegex == NULL) {
+                FoundLength = Found->LengthInChars;
+            }
+            *MatchLength = FoundLength;
+        }
+
         if (MatchIndex != NULL) {
 
             for (Index = 0; Index < CountFound; Index++) {
@@ -238,6 +360,8 @@ MoreSearchIndexFree(
 
     YoriLibInitEmptyString(&MoreContext->SearchStrings[Index]);
     MoreContext->SearchContext[Index].ColorIndex = (UCHAR)-1;
+
+    MoreSearchStringsChanged(MoreContext);
 }
 
 /**
@@ -297,7 +421,8 @@ MoreTruncateStringToVisibleChars(
 /**
  Return the next filtered physical line.  This refers to a physical line that
  matches the search criteria when filtering is enabled.  If filtering is not
- in effect, this is the same as getting the next physical line.
+ in effect, this is the same as getting the next physical line.  The caller
+ is expected to hold the PhysicalLineMutex.
 
  @param MoreContext Pointer to the more context.
 
@@ -314,27 +439,32 @@ MoreGetNextFilteredPhysicalLine(
     __in_opt PMORE_PHYSICAL_LINE PreviousLine
     )
 {
-    PYORI_LIST_ENTRY ListEntry;
     PMORE_PHYSICAL_LINE ThisLine;
+    DWORDLONG Position;
 
-    if (PreviousLine != NULL) {
-        ListEntry = YoriLibGetNextListEntry(&MoreContext->FilteredPhysicalLineList, &PreviousLine->FilteredLineList);
-    } else {
-        ListEntry = YoriLibGetNextListEntry(&MoreContext->FilteredPhysicalLineList, NULL);
-    }
-
-    if (ListEntry == NULL) {
-        return NULL;
-    }
+    if (!MoreContext->FilterToSearch) {
 
-    ThisLine = CONTAINING_RECORD(ListEntry, MORE_PHYSICAL_LINE, FilteredLineList);
+        //
+        //  Line numbers start at one and positions start at zero, so the
+        //  position of the next line is the line number of this one.
+        //
 
-    //
-    //  Check that the list is sorted
-    //
+        if (PreviousLine != NULL) {
+            Position = PreviousLine->LineNumber;
+        } else {
+            Position = 0;
+        }
+        ThisLine = MoreLineIndexGetLine(&MoreContext->PhysicalLines, Position);
+    } else {
+        if (PreviousLine != NULL) {
+            Position = MoreLineIndexFindLineNumber(&MoreContext->FilteredLines, PreviousLine->LineNumber + 1);
+        } else {
+            Position = 0;
+        }
+        ThisLine = MoreLineIndexGetLine(&MoreContext->FilteredLines, Position);
+    }
 
-    ASSERT(PreviousLine == NULL || ThisLine->FilteredLineNumber == PreviousLine->FilteredLineNumber + 1);
-    ASSERT(PreviousLine == NULL || ThisLine->LineNumber > PreviousLine->LineNumber);
+    ASSERT(ThisLine == NULL || PreviousLine == NULL || ThisLine->LineNumber > PreviousLine->LineNumber);
 
     return ThisLine;
 }
@@ -342,7 +472,8 @@ MoreGetNextFilteredPhysicalLine(
 /**
  Return the previous filtered physical line.  This refers to a physical line
  that matches the search criteria when filtering is enabled.  If filtering is
- not in effect, this is the same as getting the previous physical line.
+ not in effect, this is the same as getting the previous physical line.  The
+ caller is expected to hold the PhysicalLineMutex.
 
  @param MoreContext Pointer to the more context.
 
@@ -359,122 +490,60 @@ MoreGetPreviousFilteredPhysicalLine(
     __in_opt PMORE_PHYSICAL_LINE NextLine
     )
 {
-    PYORI_LIST_ENTRY ListEntry;
     PMORE_PHYSICAL_LINE ThisLine;
+    PMORE_LINE_INDEX Index;
+    DWORDLONG Position;
 
-    if (NextLine != NULL) {
-        ListEntry = YoriLibGetPreviousListEntry(&MoreContext->FilteredPhysicalLineList, &NextLine->FilteredLineList);
+    if (!MoreContext->FilterToSearch) {
+        Index = &MoreContext->PhysicalLines;
+        if (NextLine != NULL) {
+            Position = NextLine->LineNumber - 1;
+        } else {
+            Position = Index->LineCount;
+        }
     } else {
-        ListEntry = YoriLibGetPreviousListEntry(&MoreContext->FilteredPhysicalLineList, NULL);
+        Index = &MoreContext->FilteredLines;
+        if (NextLine != NULL) {
+            Position = MoreLineIndexFindLineNumber(Index, NextLine->LineNumber);
+        } else {
+            Position = Index->LineCount;
+        }
     }
 
-    if (ListEntry == NULL) {
+    if (Position == 0) {
         return NULL;
     }
 
-    ThisLine = CONTAINING_RECORD(ListEntry, MORE_PHYSICAL_LINE, FilteredLineList);
-
-    //
-    //  Check that the list is sorted
-    //
+    ThisLine = MoreLineIndexGetLine(Index, Position - 1);
 
-    ASSERT(NextLine == NULL || ThisLine->FilteredLineNumber + 1 == NextLine->FilteredLineNumber);
-    ASSERT(NextLine == NULL || ThisLine->LineNumber < NextLine->LineNumber);
+    ASSERT(ThisLine == NULL || NextLine == NULL || ThisLine->LineNumber < NextLine->LineNumber);
     return ThisLine;
 }
 
 /**
- Apply a new search criteria to update the set of filtered lines.
+ Return the number of a physical line within the set of lines which match the
+ filter criteria.  If filtering is not enabled, this is the line number of
+ the physical line.  The caller is expected to hold the PhysicalLineMutex.
 
- MSFIX This routine wants to be much smarter.  Ideally it would initiate an
- asynchronous process that gets synchronized when next/previous lines are
- needed.  This would allow the display to rapidly update while the number of
- filtered lines is updated in the background (refreshing the status line.)
-
- @param MoreContext Pointer to the more context, indicating the current search
-        terms.
+ @param MoreContext Pointer to the more context.
 
- @param PreviousStartPoint Optionally points to a physical line which is
-        currently displayed.  If specified, this function attempts to return
-        a "good" physical line to display once the new filter has been
-        applied.
+ @param PhysicalLine Pointer to the physical line.
 
- @return Pointer to a physical line which should be used to display after the
-         filter has been updated.
+ @return The one based number of the line within the filtered lines.
  */
-PMORE_PHYSICAL_LINE
-MoreUpdateFilteredLines(
+DWORDLONG
+MoreGetFilteredLineNumber(
     __in PMORE_CONTEXT MoreContext,
-    __in_opt PMORE_PHYSICAL_LINE PreviousStartPoint
+    __in PMORE_PHYSICAL_LINE PhysicalLine
     )
 {
-    PYORI_LIST_ENTRY ListEntry;
-    PMORE_PHYSICAL_LINE PreviousFilteredLine;
-    PMORE_PHYSICAL_LINE ThisLine;
-    BOOLEAN MatchFound;
-    DWORDLONG FilteredLineNumber;
-    DWORDLONG PreviousStartLineNumber;
-    PMORE_PHYSICAL_LINE NewStartPoint;
-
-    PreviousStartLineNumber = 0;
-    NewStartPoint = NULL;
-    if (PreviousStartPoint != NULL) {
-        PreviousStartLineNumber = PreviousStartPoint->LineNumber;
-    }
-
-    WaitForSingleObject(MoreContext->PhysicalLineMutex, INFINITE);
-
-    PreviousFilteredLine = NULL;
-    FilteredLineNumber = 0;
-    ListEntry = YoriLibGetNextListEntry(&MoreContext->PhysicalLineList, NULL);
-
-    while (ListEntry != NULL) {
-
-        ThisLine = CONTAINING_RECORD(ListEntry, MORE_PHYSICAL_LINE, LineList);
-        if (MoreContext->FilterToSearch) {
-            MatchFound = MoreFindNextSearchMatch(MoreContext, &ThisLine->LineContents, NULL, NULL);
-        } else {
-            MatchFound = TRUE;
-        }
-
-        if (!MatchFound) {
-            if (ThisLine->FilteredLineList.Next != NULL) {
-                ASSERT(MoreContext->FilteredLineCount > 0);
-                MoreContext->FilteredLineCount--;
-                YoriLibRemoveListItem(&ThisLine->FilteredLineList);
-                ThisLine->FilteredLineList.Next = NULL;
-            }
-        } else {
-            if (ThisLine->FilteredLineList.Next == NULL) {
-                if (PreviousFilteredLine != NULL) {
-                    ASSERT(ThisLine->LineNumber > PreviousFilteredLine->LineNumber);
-                    YoriLibInsertList(&PreviousFilteredLine->FilteredLineList, &ThisLine->FilteredLineList);
-                } else {
-                    YoriLibInsertList(&MoreContext->FilteredPhysicalLineList, &ThisLine->FilteredLineList);
-                }
-                MoreContext->FilteredLineCount++;
-                ASSERT(MoreContext->FilteredLineCount <= MoreContext->LineCount);
-            }
-            FilteredLineNumber++;
-            ThisLine->FilteredLineNumber = FilteredLineNumber;
-            PreviousFilteredLine = ThisLine;
-            if (NewStartPoint == NULL && ThisLine->LineNumber >= PreviousStartLineNumber) {
-                NewStartPoint = ThisLine;
-            }
-        }
-
-
-        ListEntry = YoriLibGetNextListEntry(&MoreContext->PhysicalLineList, &ThisLine->LineList);
+    if (!MoreContext->FilterToSearch) {
+        return PhysicalLine->LineNumber;
     }
 
-    ASSERT(MoreContext->FilteredLineCount == FilteredLineNumber);
-
-    ReleaseMutex(MoreContext->PhysicalLineMutex);
-
-    return NewStartPoint;
+    return MoreLineIndexFindLineNumber(&MoreContext->FilteredLines, PhysicalLine->LineNumber) + 1;
 }
 
-
 /**
  Return the number of characters within a subset of a physical line which
  will form a logical line.  Conceptually this represents either the minimum
@@ -580,9 +649,8 @@ MoreGetLogicalLineLength(
             YoriLibInitEmptyString(&StringForNextMatch);
             StringForNextMatch.StartOfString = &PhysicalLineSubset->StartOfString[SourceIndex];
             StringForNextMatch.LengthInChars = PhysicalLineSubset->LengthInChars - SourceIndex;
-            MatchFound = MoreFindNextSearchMatch(MoreContext, &StringForNextMatch, &MatchOffset, &MatchIndex);
+            MatchFound = MoreFindNextSearchMatch(MoreContext, &StringForNextMatch, &MatchOffset, &MatchLength, &MatchIndex);
             if (MatchFound) {
-                MatchLength = MoreContext->SearchStrings[MatchIndex].LengthInChars;
                 SearchColor = MoreContext->SearchColors[MoreContext->SearchContext[MatchIndex].ColorIndex];
                 MatchOffset = MatchOffset + SourceIndex;
             }
@@ -870,9 +938,8 @@ MoreCopyRangeIntoLogicalLine(
                 YoriLibInitEmptyString(&StringForNextMatch);
                 StringForNextMatch.StartOfString = &PhysicalLineSubset.StartOfString[SourceIndex];
                 StringForNextMatch.LengthInChars = LogicalLine->PhysicalLine->LineContents.LengthInChars - LogicalLine->PhysicalLineCharacterOffset - SourceIndex;
-                MatchFound = MoreFindNextSearchMatch(MoreContext, &StringForNextMatch, &MatchOffset, &MatchIndex);
+                MatchFound = MoreFindNextSearchMatch(MoreContext, &StringForNextMatch, &MatchOffset, &MatchLength, &MatchIndex);
                 if (MatchFound) {
-                    MatchLength = MoreContext->SearchStrings[MatchIndex].LengthInChars;
                     SearchColor = MoreContext->SearchColors[MoreContext->SearchContext[MatchIndex].ColorIndex];
                     MatchOffset = MatchOffset + SourceIndex;
                 }
@@ -1330,6 +1397,7 @@ MoreFindNextLineWithSearchMatch(
 {
     PMORE_PHYSICAL_LINE SearchLine;
     PYORI_STRING SearchString;
+    PYORI_LIB_REGEX SearchRegex;
     YORI_ALLOC_SIZE_T MatchOffset;
     YORI_ALLOC_SIZE_T Count;
     YORI_ALLOC_SIZE_T LogicalLinesThisPhysicalLine;
@@ -1361,6 +1429,11 @@ MoreFindNextLineWithSearchMatch(
     SearchString = &MoreContext->SearchStrings[MoreContext->SearchColorIndex];
     ASSERT(SearchString->LengthInChars > 0);
 
+    SearchRegex = NULL;
+    if (!MatchAny && MoreContext->RegexSearch) {
+        SearchRegex = YoriLibAllocateRegex(1, SearchString, TRUE, NULL, NULL);
+    }
+
     WaitForSingleObject(MoreContext->PhysicalLineMutex, INFINITE);
 
     while (TRUE) {
@@ -1370,7 +1443,11 @@ MoreFindNextLineWithSearchMatch(
         }
 
         if (MatchAny) {
-            if (MoreFindNextSearchMatch(MoreContext, &SearchLine->LineContents, NULL, NULL)) {
+            if (MoreFindNextSearchMatch(MoreContext, &SearchLine->LineContents, NULL, NULL, NULL)) {
+                break;
+            }
+        } else if (SearchRegex != NULL) {
+            if (MoreRegexFindFirstNonEmpty(SearchRegex, &SearchLine->LineContents, NULL, NULL)) {
                 break;
             }
         } else {
@@ -1394,6 +1471,11 @@ MoreFindNextLineWithSearchMatch(
     }
 
     ReleaseMutex(MoreContext->PhysicalLineMutex);
+
+    if (SearchRegex != NULL) {
+        YoriLibFreeRegex(SearchRegex);
+    }
+
     return SearchLine;
 }
 
@@ -1437,6 +1519,7 @@ MoreFindPreviousLineWithSearchMatch(
 {
     PMORE_PHYSICAL_LINE SearchLine;
     PYORI_STRING SearchString;
+    PYORI_LIB_REGEX SearchRegex;
     YORI_ALLOC_SIZE_T MatchOffset;
     YORI_ALLOC_SIZE_T Count;
     YORI_ALLOC_SIZE_T LogicalLinesThisPhysicalLine;
@@ -1456,6 +1539,11 @@ MoreFindPreviousLineWithSearchMatch(
     SearchString = &MoreContext->SearchStrings[MoreContext->SearchColorIndex];
     ASSERT(SearchString->LengthInChars > 0);
 
+    SearchRegex = NULL;
+    if (!MatchAny && MoreContext->RegexSearch) {
+        SearchRegex = YoriLibAllocateRegex(1, SearchString, TRUE, NULL, NULL);
+    }
+
     WaitForSingleObject(MoreContext->PhysicalLineMutex, INFINITE);
 
     while (TRUE) {
@@ -1465,7 +1553,11 @@ MoreFindPreviousLineWithSearchMatch(
         }
 
         if (MatchAny) {
-            if (MoreFindNextSearchMatch(MoreContext, &SearchLine->LineContents, NULL, NULL)) {
+            if (MoreFindNextSearchMatch(MoreContext, &SearchLine->LineContents, NULL, NULL, NULL)) {
+                break;
+            }
+        } else if (SearchRegex != NULL) {
+            if (MoreRegexFindFirstNonEmpty(SearchRegex, &SearchLine->LineContents, NULL, NULL)) {
                 break;
             }
         } else {
@@ -1489,6 +1581,11 @@ MoreFindPreviousLineWithSearchMatch(
     }
 
     ReleaseMutex(MoreContext->PhysicalLineMutex);
+
+    if (SearchRegex != NULL) {
+        YoriLibFreeRegex(SearchRegex);
+    }
+
     return SearchLine;
 }
 
@@ -3,7 +3,7 @@
  *
  * Yori shell display file contents
  *
- * Copyright (c) 2017-2021 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -34,12 +34,15 @@ CHAR strMoreHelpText[] =
         "\n"
         "Output the contents of one or more files with paging and scrolling.\n"
         "\n"
-        "MORE [-license] [-b] [-dd] [-f] [-s] [<file>...]\n"
+        "MORE [-license] [-b] [-dd] [-e] [-f] [-l] [-m] [-r] [-s] [<file>...]\n"
         "\n"
         "   -b             Use basic search criteria for files only\n"
         "   -dd            Use the debug display\n"
+        "   -e             Start at the end, loading only the final lines of files\n"
         "   -f             Wait for more contents to be added to the file\n"
         "   -l             Display until Ctrl+Q, Scroll Lock, or pause\n"
+        "   -m             Display memory used to store lines on exit\n"
+        "   -r             Treat search strings as regular expressions\n"
         "   -s             Process files from all subdirectories\n";
 
 /**
@@ -94,6 +97,9 @@ ENTRYPOINT(
     BOOLEAN DebugDisplay = FALSE;
     BOOLEAN SuspendPagination = FALSE;
     BOOLEAN WaitForMore = FALSE;
+    BOOLEAN StartAtEnd = FALSE;
+    BOOLEAN RegexSearch = FALSE;
+    BOOLEAN DisplayMemoryUsage = FALSE;
     MORE_CONTEXT MoreContext;
     YORI_STRING Arg;
 
@@ -109,7 +115,7 @@ ENTRYPOINT(
                 MoreHelp();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2017-2021"));
+                YoriLibDisplayMitLicense(_T("2017-2026"));
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("b")) == 0) {
                 BasicEnumeration = TRUE;
@@ -117,12 +123,21 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("dd")) == 0) {
                 DebugDisplay = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("e")) == 0) {
+                StartAtEnd = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("f")) == 0) {
                 WaitForMore = TRUE;
                 ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("l")) == 0) {
                 SuspendPagination = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("m")) == 0) {
+                DisplayMemoryUsage = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("r")) == 0) {
+                RegexSearch = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("s")) == 0) {
                 Recursive = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -163,9 +178,9 @@ ENTRYPOINT(
     YoriLibCancelEnable(FALSE);
 
     if (StartArg == 0 || StartArg == ArgC) {
-        InitComplete = MoreInitContext(&MoreContext, 0, NULL, Recursive, BasicEnumeration, DebugDisplay, SuspendPagination, WaitForMore);
+        InitComplete = MoreInitContext(&MoreContext, 0, NULL, Recursive, BasicEnumeration, DebugDisplay, SuspendPagination, WaitForMore, StartAtEnd, RegexSearch, DisplayMemoryUsage);
     } else {
-        InitComplete = MoreInitContext(&MoreContext, ArgC-StartArg, &ArgV[StartArg], Recursive, BasicEnumeration, DebugDisplay, SuspendPagination, WaitForMore);
+        InitComplete = MoreInitContext(&MoreContext, ArgC-StartArg, &ArgV[StartArg], Recursive, BasicEnumeration, DebugDisplay, SuspendPagination, WaitForMore, StartAtEnd, RegexSearch, DisplayMemoryUsage);
     }
 
     Result = EXIT_SUCCESS;
@@ -3,7 +3,7 @@
  *
  * Yori shell display master header
  *
- * Copyright (c) 2017-2018 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -38,22 +38,11 @@
 /**
  Data describing a physical line.  A physical line is a line of text from the
  data source, which may take more characters than fit on a viewport line.
+ Physical lines are found by position via a @ref MORE_LINE_INDEX , so they
+ contain no linkage of their own.
  */
 typedef struct _MORE_PHYSICAL_LINE {
 
-    /**
-     A list of physical lines.  Paired with MORE_CONTEXT::PhysicalLineList
-     and synchronized with MORE_CONTEXT::PhysicalLineMutex .
-     */
-    YORI_LIST_ENTRY LineList;
-
-    /**
-     A list of physical lines matching the current search criteria.  Paired
-     with MORE_CONTEXT::FilteredPhysicalLineList and synchronized with
-     MORE_CONTEXT::PhysicalLineMutex .
-     */
-    YORI_LIST_ENTRY FilteredLineList;
-
     /**
      Pointer to the referenced allocation that contains this physical line.
      */
@@ -70,19 +59,65 @@ typedef struct _MORE_PHYSICAL_LINE {
      */
     DWORDLONG LineNumber;
 
-    /**
-     The number of this physical line within the set of lines which match the
-     filter criteria.  If filtering is not enabled, this is the same as
-     LineNumber, above.
-     */
-    DWORDLONG FilteredLineNumber;
-
     /**
      The contents of the physical line.
      */
     YORI_STRING LineContents;
 } MORE_PHYSICAL_LINE, *PMORE_PHYSICAL_LINE;
 
+/**
+ The number of physical lines described by each chunk of a line index.
+ */
+#define MORE_LINE_INDEX_CHUNK_SIZE (4096)
+
+/**
+ The number of lines to load from the end of each file when the user has
+ requested to start at the end of files.
+ */
+#define MORE_FINAL_LINE_COUNT (10000)
+
+/**
+ A fixed size array of pointers to physical lines.  Once allocated, a chunk
+ never moves, so a thread can continue to use a chunk after the index that
+ refers to it has grown.
+ */
+typedef struct _MORE_LINE_INDEX_CHUNK {
+
+    /**
+     Pointers to each physical line in this chunk.
+     */
+    PMORE_PHYSICAL_LINE Lines[MORE_LINE_INDEX_CHUNK_SIZE];
+} MORE_LINE_INDEX_CHUNK, *PMORE_LINE_INDEX_CHUNK;
+
+/**
+ An ordered set of physical lines, stored as an array of chunks so that any
+ line can be found by position without walking the preceding lines, and
+ each line costs only a pointer.
+ */
+typedef struct _MORE_LINE_INDEX {
+
+    /**
+     An array of pointers to chunks.  This array may be reallocated when the
+     index grows.
+     */
+    PMORE_LINE_INDEX_CHUNK *Chunks;
+
+    /**
+     The number of lines in the index.
+     */
+    DWORDLONG LineCount;
+
+    /**
+     The number of chunks that have been allocated.
+     */
+    YORI_ALLOC_SIZE_T ChunkCount;
+
+    /**
+     The number of elements in the Chunks array.
+     */
+    YORI_ALLOC_SIZE_T ChunkArraySize;
+} MORE_LINE_INDEX, *PMORE_LINE_INDEX;
+
 /**
  A logical line, meaning a line rendered for display on the console.
  */
@@ -216,33 +251,53 @@ typedef struct _MORE_SEARCH_CONTEXT {
 
 } MORE_SEARCH_CONTEXT, *PMORE_SEARCH_CONTEXT;
 
+/**
+ State for a pass which applies a filter to lines that have already been
+ ingested.  This is defined in filter.c.
+ */
+typedef struct _MORE_FILTER_PASS *PMORE_FILTER_PASS;
+
 /**
  Context passed to the callback which is invoked for each file found.
  */
 typedef struct _MORE_CONTEXT {
 
     /**
-     A linked list of physical lines.
+     An index of all physical lines.
      */
-    YORI_LIST_ENTRY PhysicalLineList;
+    MORE_LINE_INDEX PhysicalLines;
 
     /**
-     A linked list of physical lines matching the current search criteria.
+     An index of physical lines matching the current search criteria.  This
+     is only populated when FilterToSearch is TRUE; otherwise PhysicalLines
+     describes the lines to display.
      */
-    YORI_LIST_ENTRY FilteredPhysicalLineList;
+    MORE_LINE_INDEX FilteredLines;
 
     /**
-     Synchronization around PhysicalLineList.
+     Synchronization around PhysicalLines and FilteredLines.
      */
     HANDLE PhysicalLineMutex;
 
     /**
      An event that is signalled when new lines are added to the
-     PhysicalLineList in case the viewport thread wants to update display
-     when lines are added.
+     PhysicalLines or FilteredLines in case the viewport thread wants to
+     update display when lines are added.
      */
     HANDLE PhysicalLineAvailableEvent;
 
+    /**
+     An event that is signalled each time a filter pass publishes results.
+     */
+    HANDLE FilterProgressEvent;
+
+    /**
+     The filter pass that is applying the current filter to previously
+     ingested lines, or NULL if no pass has been started.  This is only
+     accessed by the viewport thread.
+     */
+    PMORE_FILTER_PASS FilterPass;
+
     /**
      An event that is signalled when the ingest process should be terminated
      quickly and the application should exit.
@@ -269,14 +324,14 @@ typedef struct _MORE_CONTEXT {
 
     /**
      An array of size ViewportHeight of lines currently displayed.  Note these
-     refer to the strings in the PhysicalLineList.
+     refer to the strings in PhysicalLines.
      */
     PMORE_LOGICAL_LINE DisplayViewportLines;
 
     /**
      An array of size ViewportHeight of lines that are being constructed to
      display in future.  Note these refer to the strings in the
-     PhysicalLineList.
+     PhysicalLines.
      */
     PMORE_LOGICAL_LINE StagingViewportLines;
 
@@ -286,6 +341,12 @@ typedef struct _MORE_CONTEXT {
      */
     DWORDLONG TotalLinesInViewportStatus;
 
+    /**
+     TRUE if a filter pass was still running when the status line was last
+     calculated.
+     */
+    BOOLEAN FilterActiveInViewportStatus;
+
     /**
      Specifies the number of lines within DisplayViewportLines that are
      currently populated with data.  Since population is a process, this
@@ -348,6 +409,23 @@ typedef struct _MORE_CONTEXT {
      */
     UCHAR SearchColorIndex;
 
+    /**
+     The active search strings compiled so that all of them can be found
+     with a single pass over each line.  This is rebuilt whenever the search
+     strings change, and is NULL if no search is active or if it could not
+     be allocated.  This is protected by PhysicalLineMutex.
+     */
+    PYORI_LIB_SUBSTR_MATCHER SearchMatcher;
+
+    /**
+     The active search strings compiled as regular expressions, if search
+     strings are regular expressions and they are all valid.  If this is
+     NULL, SearchMatcher is used instead, so search strings are matched as
+     text while an expression is incomplete.  This is protected by
+     PhysicalLineMutex.
+     */
+    PYORI_LIB_REGEX SearchRegex;
+
     /**
      Handle to the thread that is adding to the physical line array.
      */
@@ -424,6 +502,24 @@ typedef struct _MORE_CONTEXT {
      */
     BOOLEAN WaitForMore;
 
+    /**
+     TRUE if only the final lines of each file should be loaded, and the
+     viewport should be moved to the end once they have been loaded.  FALSE
+     if files should be loaded from the beginning.
+     */
+    BOOLEAN StartAtEnd;
+
+    /**
+     TRUE if search strings are regular expressions.  FALSE if they are
+     text to find.
+     */
+    BOOLEAN RegexSearch;
+
+    /**
+     TRUE if the memory used to store lines should be displayed on exit.
+     */
+    BOOLEAN DisplayMemoryUsage;
+
     /**
      Records the total number of files processed.
      */
@@ -440,6 +536,23 @@ typedef struct _MORE_CONTEXT {
      */
     DWORDLONG FilteredLineCount;
 
+    /**
+     The number of physical lines that the current filter has been applied
+     to.  If this is less than LineCount, a filter pass is still running and
+     FilteredLines does not yet describe later lines.
+     */
+    DWORDLONG FilterLinesProcessed;
+
+    /**
+     The number of bytes allocated to hold physical lines.
+     */
+    DWORDLONG LineBufferBytes;
+
+    /**
+     The number of bytes of physical line text, including NULL terminators.
+     */
+    DWORDLONG LineTextBytes;
+
 } MORE_CONTEXT, *PMORE_CONTEXT;
 
 VOID
@@ -467,7 +580,10 @@ MoreInitContext(
     __in BOOLEAN BasicEnumeration,
     __in BOOLEAN DebugDisplay,
     __in BOOLEAN SuspendPagination,
-    __in BOOLEAN WaitForMore
+    __in BOOLEAN WaitForMore,
+    __in BOOLEAN StartAtEnd,
+    __in BOOLEAN RegexSearch,
+    __in BOOLEAN DisplayMemoryUsage
     );
 
 VOID
@@ -480,6 +596,51 @@ MoreGracefulExit(
     __inout PMORE_CONTEXT MoreContext
     );
 
+VOID
+MoreLineIndexInitialize(
+    __out PMORE_LINE_INDEX Index
+    );
+
+VOID
+MoreLineIndexCleanup(
+    __inout PMORE_LINE_INDEX Index
+    );
+
+__success(return)
+BOOLEAN
+MoreLineIndexAppend(
+    __inout PMORE_LINE_INDEX Index,
+    __in PMORE_PHYSICAL_LINE Line
+    );
+
+PMORE_PHYSICAL_LINE
+MoreLineIndexGetLine(
+    __in PMORE_LINE_INDEX Index,
+    __in DWORDLONG Position
+    );
+
+DWORDLONG
+MoreLineIndexFindLineNumber(
+    __in PMORE_LINE_INDEX Index,
+    __in DWORDLONG LineNumber
+    );
+
+DWORDLONG
+MoreLineIndexGetAllocatedBytes(
+    __in PMORE_LINE_INDEX Index
+    );
+
+VOID
+MoreCancelFilterPass(
+    __inout PMORE_CONTEXT MoreContext
+    );
+
+__success(return)
+BOOLEAN
+MoreStartFilterPass(
+    __inout PMORE_CONTEXT MoreContext
+    );
+
 DWORD WINAPI
 MoreIngestThread(
     __in LPVOID Context
@@ -507,12 +668,26 @@ MoreSearchIndexFree(
     __in UCHAR SearchIndex
     );
 
+VOID
+MoreSearchStringsChanged(
+    __in PMORE_CONTEXT MoreContext
+    );
+
+PYORI_STRING
+MoreRegexFindFirstNonEmpty(
+    __in PYORI_LIB_REGEX Regex,
+    __in PCYORI_STRING StringToSearch,
+    __out_opt PYORI_ALLOC_SIZE_T MatchOffset,
+    __out_opt PYORI_ALLOC_SIZE_T MatchLength
+    );
+
 __success(return)
 BOOLEAN
 MoreFindNextSearchMatch(
     __in PMORE_CONTEXT MoreContext,
     __in PCYORI_STRING StringToSearch,
     __out_opt PYORI_ALLOC_SIZE_T MatchOffset,
+    __out_opt PYORI_ALLOC_SIZE_T MatchLength,
     __out_opt PUCHAR MatchIndex
     );
 
@@ -592,4 +767,10 @@ MoreUpdateFilteredLines(
     __in_opt PMORE_PHYSICAL_LINE PreviousStartPoint
     );
 
+DWORDLONG
+MoreGetFilteredLineNumber(
+    __in PMORE_CONTEXT MoreContext,
+    __in PMORE_PHYSICAL_LINE PhysicalLine
+    );
+
 // vim:sw=4:ts=4:et:
@@ -3,7 +3,7 @@
  *
  * Yori shell more initialization
  *
- * Copyright (c) 2017-2022 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -129,6 +129,15 @@ MoreAllocateViewportStructures(
         that this program cannot move to the next file.  FALSE if this program
         should read until the end of each file and move to the next.
 
+ @param StartAtEnd TRUE if only the final lines of each file should be
+        loaded, and the viewport should start at the end of the data.
+
+ @param RegexSearch TRUE if search strings should be treated as regular
+        expressions, FALSE if they should be treated as text to find.
+
+ @param DisplayMemoryUsage TRUE if the memory used to store lines should be
+        displayed when the program exits.
+
  @return TRUE to indicate successful completion, meaning a background thread
          is executing and this should be drained with @ref MoreGracefulExit.
          FALSE to indicate initialization was unsuccessful, and the
@@ -143,7 +152,10 @@ MoreInitContext(
     __in BOOLEAN BasicEnumeration,
     __in BOOLEAN DebugDisplay,
     __in BOOLEAN SuspendPagination,
-    __in BOOLEAN WaitForMore
+    __in BOOLEAN WaitForMore,
+    __in BOOLEAN StartAtEnd,
+    __in BOOLEAN RegexSearch,
+    __in BOOLEAN DisplayMemoryUsage
     )
 {
     CONSOLE_SCREEN_BUFFER_INFO ScreenInfo;
@@ -166,10 +178,13 @@ MoreInitContext(
     MoreContext->DebugDisplay = DebugDisplay;
     MoreContext->SuspendPagination = SuspendPagination;
     MoreContext->WaitForMore = WaitForMore;
+    MoreContext->StartAtEnd = StartAtEnd;
+    MoreContext->RegexSearch = RegexSearch;
+    MoreContext->DisplayMemoryUsage = DisplayMemoryUsage;
     MoreContext->TabWidth = 4;
 
-    YoriLibInitializeListHead(&MoreContext->PhysicalLineList);
-    YoriLibInitializeListHead(&MoreContext->FilteredPhysicalLineList);
+    MoreLineIndexInitialize(&MoreContext->PhysicalLines);
+    MoreLineIndexInitialize(&MoreContext->FilteredLines);
     MoreContext->PhysicalLineMutex = CreateMutex(NULL, FALSE, NULL);
     if (MoreContext->PhysicalLineMutex == NULL) {
         return FALSE;
@@ -185,6 +200,11 @@ MoreInitContext(
         return FALSE;
     }
 
+    MoreContext->FilterProgressEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (MoreContext->FilterProgressEvent == NULL) {
+        return FALSE;
+    }
+
     if (!GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &ScreenInfo)) {
         return FALSE;
     }
@@ -241,8 +261,9 @@ MoreCleanupContext(
 {
     YORI_ALLOC_SIZE_T Index;
 
-    ASSERT(YoriLibIsListEmpty(&MoreContext->PhysicalLineList));
-    ASSERT(YoriLibIsListEmpty(&MoreContext->FilteredPhysicalLineList));
+    ASSERT(MoreContext->FilterPass == NULL);
+    ASSERT(MoreContext->PhysicalLines.LineCount == 0);
+    ASSERT(MoreContext->FilteredLines.LineCount == 0);
 
     if (MoreContext->DisplayViewportLines != NULL) {
         YoriLibFree(MoreContext->DisplayViewportLines);
@@ -264,6 +285,11 @@ MoreCleanupContext(
         MoreContext->ShutdownEvent = NULL;
     }
 
+    if (MoreContext->FilterProgressEvent != NULL) {
+        CloseHandle(MoreContext->FilterProgressEvent);
+        MoreContext->FilterProgressEvent = NULL;
+    }
+
     if (MoreContext->PhysicalLineMutex != NULL) {
         CloseHandle(MoreContext->PhysicalLineMutex);
         MoreContext->PhysicalLineMutex = NULL;
@@ -279,9 +305,61 @@ MoreCleanupContext(
         MoreContext->SearchContext[Index].ColorIndex = (UCHAR)-1;
     }
 
+    if (MoreContext->SearchMatcher != NULL) {
+        YoriLibFreeSubstrMatcher(MoreContext->SearchMatcher);
+        MoreContext->SearchMatcher = NULL;
+    }
+
+    if (MoreContext->SearchRegex != NULL) {
+        YoriLibFreeRegex(MoreContext->SearchRegex);
+        MoreContext->SearchRegex = NULL;
+    }
+
     MoreContext->SearchColorIndex = 0;
 }
 
+/**
+ Display the amount of memory used to store physical lines.  Overhead refers
+ to any memory that is not line text, which includes the structure that
+ describes each line, alignment padding, unused space at the end of each
+ buffer, and the indexes used to find lines.
+
+ @param MoreContext Pointer to the more context.
+ */
+VOID
+MoreDisplayMemoryUsage(
+    __in PMORE_CONTEXT MoreContext
+    )
+{
+    DWORDLONG IndexBytes;
+    DWORDLONG OverheadBytes;
+    DWORDLONG LineCount;
+
+    IndexBytes = MoreLineIndexGetAllocatedBytes(&MoreContext->PhysicalLines) +
+                 MoreLineIndexGetAllocatedBytes(&MoreContext->FilteredLines);
+    OverheadBytes = MoreContext->LineBufferBytes - MoreContext->LineTextBytes + IndexBytes;
+    LineCount = MoreContext->LineCount;
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                  _T("Lines:              %lli\n")
+                  _T("Text bytes:         %lli\n")
+                  _T("Buffer bytes:       %lli\n")
+                  _T("Index bytes:        %lli\n")
+                  _T("Overhead bytes:     %lli\n"),
+                  LineCount,
+                  MoreContext->LineTextBytes,
+                  MoreContext->LineBufferBytes,
+                  IndexBytes,
+                  OverheadBytes);
+
+    if (LineCount > 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                      _T("Overhead per line:  %lli.%02lli bytes\n"),
+                      OverheadBytes / LineCount,
+                      (OverheadBytes % LineCount) * 100 / LineCount);
+    }
+}
+
 /**
  Indicate that the ingest thread should terminate, wait for it to die, and
  clean up any state.
@@ -294,33 +372,31 @@ MoreGracefulExit(
     __inout PMORE_CONTEXT MoreContext
     )
 {
-    PYORI_LIST_ENTRY ListEntry;
     PMORE_PHYSICAL_LINE PhysicalLine;
     YORI_ALLOC_SIZE_T Index;
+    DWORDLONG Position;
 
     YoriLibCancelSet();
     SetEvent(MoreContext->ShutdownEvent);
+    MoreCancelFilterPass(MoreContext);
     WaitForSingleObject(MoreContext->IngestThread, INFINITE);
     for (Index = 0; Index < MoreContext->ViewportHeight; Index++) {
         YoriLibFreeStringContents(&MoreContext->DisplayViewportLines[Index].Line);
     }
 
-    ListEntry = YoriLibGetNextListEntry(&MoreContext->FilteredPhysicalLineList, NULL);
-    while (ListEntry != NULL) {
-        PhysicalLine = CONTAINING_RECORD(ListEntry, MORE_PHYSICAL_LINE, LineList);
-        YoriLibRemoveListItem(ListEntry);
-        ListEntry = YoriLibGetNextListEntry(&MoreContext->FilteredPhysicalLineList, NULL);
+    if (MoreContext->DisplayMemoryUsage) {
+        MoreDisplayMemoryUsage(MoreContext);
     }
 
-    ListEntry = YoriLibGetNextListEntry(&MoreContext->PhysicalLineList, NULL);
-    while (ListEntry != NULL) {
-        PhysicalLine = CONTAINING_RECORD(ListEntry, MORE_PHYSICAL_LINE, LineList);
-        YoriLibRemoveListItem(ListEntry);
+    for (Position = 0; Position < MoreContext->PhysicalLines.LineCount; Position++) {
+        PhysicalLine = MoreLineIndexGetLine(&MoreContext->PhysicalLines, Position);
         YoriLibFreeStringContents(&PhysicalLine->LineContents);
         YoriLibDereference(PhysicalLine->MemoryToFree);
-        ListEntry = YoriLibGetNextListEntry(&MoreContext->PhysicalLineList, NULL);
     }
 
+    MoreLineIndexCleanup(&MoreContext->FilteredLines);
+    MoreLineIndexCleanup(&MoreContext->PhysicalLines);
+
     MoreCleanupContext(MoreContext);
 }
 
@@ -3,7 +3,7 @@
  *
  * Yori shell more console display
  *
- * Copyright (c) 2017-2022 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -115,6 +115,7 @@ MoreDrawStatusLine(
     DWORDLONG TotalFilteredLines;
     BOOL PageFull;
     BOOL ThreadActive;
+    BOOLEAN FilterActive;
     LPTSTR StringToDisplay;
     YORI_STRING LineToDisplay;
     PYORI_STRING SearchString;
@@ -146,12 +147,14 @@ MoreDrawStatusLine(
 
     TotalLines = MoreContext->LineCount;
     TotalFilteredLines = MoreContext->FilteredLineCount;
+    FilterActive = (BOOLEAN)(MoreContext->FilterLinesProcessed < TotalLines);
     MoreContext->TotalLinesInViewportStatus = TotalFilteredLines;
+    MoreContext->FilterActiveInViewportStatus = FilterActive;
 
     if (MoreContext->FilterToSearch) {
         if (MoreContext->LinesInViewport > 0) {
-            FirstViewportLine = MoreContext->DisplayViewportLines[0].PhysicalLine->FilteredLineNumber;
-            LastViewportLine = MoreContext->DisplayViewportLines[MoreContext->LinesInViewport - 1].PhysicalLine->FilteredLineNumber;
+            FirstViewportLine = MoreGetFilteredLineNumber(MoreContext, MoreContext->DisplayViewportLines[0].PhysicalLine);
+            LastViewportLine = MoreGetFilteredLineNumber(MoreContext, MoreContext->DisplayViewportLines[MoreContext->LinesInViewport - 1].PhysicalLine);
             ASSERT(TotalFilteredLines > 0);
             Percent = (DWORD)(LastViewportLine * 100 / TotalFilteredLines);
         } else {
@@ -187,7 +190,7 @@ MoreDrawStatusLine(
         ThreadActive = TRUE;
     }
 
-    if (!ThreadActive && TotalFilteredLines == LastViewportLine) {
+    if (!ThreadActive && !FilterActive && TotalFilteredLines == LastViewportLine) {
         StringToDisplay = _T("End");
     } else if (!PageFull) {
         StringToDisplay = _T("Awaiting data");
@@ -225,7 +228,7 @@ MoreDrawStatusLine(
                       LastViewportLine,
                       TotalFilteredLines,
                       Percent,
-                      (MoreContext->FilterToSearch?_T(" (filtered)"):_T("")),
+                      (MoreContext->FilterToSearch?(FilterActive?_T(" (filtering)"):_T(" (filtered)")):_T("")),
                       &SearchColorString,
                       SearchString);
     } else {
@@ -256,7 +259,7 @@ MoreDrawStatusLine(
                           LastViewportLine,
                           TotalFilteredLines,
                           Percent,
-                          (MoreContext->FilterToSearch?_T(" (filtered)"):_T("")));
+                          (MoreContext->FilterToSearch?(FilterActive?_T(" (filtering)"):_T(" (filtered)")):_T("")));
 
 
             //
@@ -1657,8 +1660,6 @@ MoreAreMoreLinesAvailable(
 {
     DWORDLONG LastViewportLineNumber;
     DWORDLONG LastPhysicalLineNumber;
-    PYORI_LIST_ENTRY ListEntry;
-    PMORE_PHYSICAL_LINE LastPhysicalLine;
     PMORE_LOGICAL_LINE LastViewportLine;
 
     //
@@ -1691,9 +1692,7 @@ MoreAreMoreLinesAvailable(
     LastViewportLineNumber = LastViewportLine->PhysicalLine->LineNumber;
 
     WaitForSingleObject(MoreContext->PhysicalLineMutex, INFINITE);
-    ListEntry = YoriLibGetPreviousListEntry(&MoreContext->PhysicalLineList, NULL);
-    LastPhysicalLine = CONTAINING_RECORD(ListEntry, MORE_PHYSICAL_LINE, LineList);
-    LastPhysicalLineNumber = LastPhysicalLine->LineNumber;
+    LastPhysicalLineNumber = MoreContext->LineCount;
     ReleaseMutex(MoreContext->PhysicalLineMutex);
 
     if (LastPhysicalLineNumber > LastViewportLineNumber) {
@@ -1793,6 +1792,7 @@ MoreAppendToSearchString(
         SearchString->LengthInChars = SearchString->LengthInChars + String->LengthInChars;
     }
     MoreContext->SearchContext[SearchIndex].ColorIndex = MoreContext->SearchColorIndex;
+    MoreSearchStringsChanged(MoreContext);
     MoreContext->SearchDirty = TRUE;
     return TRUE;
 }
@@ -1957,6 +1957,7 @@ MoreProcessKeyDown(
                     }
                 } else {
                     SearchString->LengthInChars = SearchString->LengthInChars - InputRecord->Event.KeyEvent.wRepeatCount;
+                    MoreSearchStringsChanged(MoreContext);
                 }
                 MoreContext->SearchDirty = TRUE;
             } else if (Char == '\r') {
@@ -2235,7 +2236,9 @@ MoreCheckForStatusLineChange(
     __inout PMORE_CONTEXT MoreContext
     )
 {
-    if (MoreContext->TotalLinesInViewportStatus != MoreContext->FilteredLineCount || MoreContext->SearchDirty) {
+    if (MoreContext->TotalLinesInViewportStatus != MoreContext->FilteredLineCount ||
+        MoreContext->FilterActiveInViewportStatus != (MoreContext->FilterLinesProcessed < MoreContext->LineCount) ||
+        MoreContext->SearchDirty) {
         MoreClearStatusLine(MoreContext);
         MoreDrawStatusLine(MoreContext);
     }
@@ -2846,6 +2849,9 @@ MoreViewportDisplay(
                 } else {
                     WaitForIngestThread = FALSE;
                     ReleaseMutex(MoreContext->PhysicalLineMutex);
+                    if (MoreContext->StartAtEnd) {
+                        MoreMoveViewportToBottom(MoreContext);
+                    }
                     if (MoreContext->LinesInPage < MoreContext->ViewportHeight) {
                         break;
                     }
@@ -3,7 +3,7 @@
  *
  * Yori shell functions exported out of this module
  *
- * Copyright (c) 2018-2019 Malcolm J. Smith
+ * Copyright (c) 2018-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -47,27 +47,17 @@ YoriPkgUpgradeInstalledPackages(
     )
 {
     YORI_STRING PkgIniFile;
-    YORI_STRING InstalledSection;
-    LPTSTR ThisLine;
-    LPTSTR Equals;
-    YORI_STRING PkgNameOnly;
-    YORI_STRING InstalledVersion;
+    YORI_LIB_INI_DOCUMENT PkgIni;
+    PYORI_LIB_INI_SECTION InstalledSection;
+    PYORI_LIB_INI_KEY InstalledKey;
+    LPTSTR PkgName;
     YORI_STRING UpgradePath;
     YORI_STRING RedirectedPath;
-    YORI_ALLOC_SIZE_T LineLength;
     DWORD Error;
     BOOL Result;
     BOOL UpgradeThisPackage;
     YORIPKG_PACKAGES_PENDING_INSTALL PendingPackages;
 
-    if (DllKernel32.pGetPrivateProfileIntW == NULL ||
-        DllKernel32.pGetPrivateProfileSectionW == NULL ||
-        DllKernel32.pGetPrivateProfileStringW == NULL ||
-        DllKernel32.pWritePrivateProfileStringW == NULL) {
-
-        return FALSE;
-    }
-
     if (!YoriPkgInitializePendingPackages(&PendingPackages)) {
         return FALSE;
     }
@@ -77,79 +67,53 @@ YoriPkgUpgradeInstalledPackages(
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&InstalledSection, YORIPKG_MAX_SECTION_LENGTH)) {
+    if (!YoriLibAllocateString(&UpgradePath, YORIPKG_MAX_FIELD_LENGTH)) {
         YoriPkgDeletePendingPackages(&PendingPackages);
         YoriLibFreeStringContents(&PkgIniFile);
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&UpgradePath, YORIPKG_MAX_FIELD_LENGTH)) {
+    if (!YoriLibIniLoad(&PkgIni, &PkgIniFile)) {
         YoriPkgDeletePendingPackages(&PendingPackages);
-        YoriLibFreeStringContents(&InstalledSection);
+        YoriLibFreeStringContents(&UpgradePath);
         YoriLibFreeStringContents(&PkgIniFile);
         return FALSE;
     }
 
-    InstalledSection.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileSectionW(_T("Installed"),
-                                               InstalledSection.StartOfString,
-                                               InstalledSection.LengthAllocated,
-                                               PkgIniFile.StartOfString);
+    //
+    //  The document is only read here.  Installing packages updates the
+    //  file directly, and this copy is never saved.
+    //
 
-    YoriLibInitEmptyString(&PkgNameOnly);
-    ThisLine = InstalledSection.StartOfString;
+    InstalledSection = YoriLibIniFindSection(&PkgIni, _T("Installed"));
+    InstalledKey = NULL;
+    if (InstalledSection != NULL) {
+        InstalledKey = YoriLibIniGetNextKey(InstalledSection, NULL);
+    }
 
     Result = FALSE;
-    while (*ThisLine != '\0') {
-        LineLength = (YORI_ALLOC_SIZE_T)_tcslen(ThisLine);
-        PkgNameOnly.StartOfString = ThisLine;
-        Equals = _tcschr(ThisLine, '=');
-        if (Equals != NULL) {
-            PkgNameOnly.LengthInChars = (YORI_ALLOC_SIZE_T)(Equals - ThisLine);
-            *Equals = '\0';
-            YoriLibConstantString(&InstalledVersion, Equals + 1);
-        } else {
-            PkgNameOnly.LengthInChars = LineLength;
-            YoriLibInitEmptyString(&InstalledVersion);
-        }
+    while (InstalledKey != NULL) {
+        PkgName = InstalledKey->Name.StartOfString;
 
         UpgradePath.LengthInChars = 0;
         if (Prefer == YoriPkgUpgradePreferStable) {
-            UpgradePath.LengthInChars = (YORI_ALLOC_SIZE_T)
-                DllKernel32.pGetPrivateProfileStringW(PkgNameOnly.StartOfString,
-                                                      _T("UpgradeToStablePath"),
-                                                      _T(""),
-                                                      UpgradePath.StartOfString,
-                                                      UpgradePath.LengthAllocated,
-                                                      PkgIniFile.StartOfString);
+            YoriLibIniGetString(&PkgIni, PkgName, _T("UpgradeToStablePath"), &UpgradePath);
         } else if (Prefer == YoriPkgUpgradePreferDaily) {
-            UpgradePath.LengthInChars = (YORI_ALLOC_SIZE_T)
-                DllKernel32.pGetPrivateProfileStringW(PkgNameOnly.StartOfString,
-                                                      _T("UpgradeToDailyPath"),
-                                                      _T(""),
-                                                      UpgradePath.StartOfString,
-                                                      UpgradePath.LengthAllocated,
-                                                      PkgIniFile.StartOfString);
+            YoriLibIniGetString(&PkgIni, PkgName, _T("UpgradeToDailyPath"), &UpgradePath);
         }
 
         if (UpgradePath.LengthInChars == 0) {
-            UpgradePath.LengthInChars = (YORI_ALLOC_SIZE_T)
-                DllKernel32.pGetPrivateProfileStringW(PkgNameOnly.StartOfString,
-                                                      _T("UpgradePath"),
-                                                      _T(""),
-                                                      UpgradePath.StartOfString,
-                                                      UpgradePath.LengthAllocated,
-                                                      PkgIniFile.StartOfString);
+            YoriLibIniGetString(&PkgIni, PkgName, _T("UpgradePath"), &UpgradePath);
         }
         if (UpgradePath.LengthInChars > 0) {
             UpgradeThisPackage = TRUE;
             YoriLibInitEmptyString(&RedirectedPath);
             if (NewArchitecture != NULL) {
-                YoriPkgBuildUpgradeLocationForNewArchitecture(&PkgNameOnly, NewArchitecture, &PkgIniFile, &UpgradePath);
+                YoriPkgBuildUpgradeLocationForNewArchitecture(&InstalledKey->Name, NewArchitecture, &PkgIni, &UpgradePath);
             } else {
-                if (!YoriPkgIsNewerVersionAvailable(&PendingPackages, &PkgIniFile, &UpgradePath, &InstalledVersion, &RedirectedPath)) {
+                if (!YoriPkgIsNewerVersionAvailable(&PendingPackages, &PkgIniFile, &UpgradePath, &InstalledKey->Value, &RedirectedPath)) {
                     YoriLibFreeStringContents(&RedirectedPath);
-                    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y version %y is already installed\n"), &PkgNameOnly, &InstalledVersion);
+                    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y version %y is already installed\n"), &InstalledKey->Name, &InstalledKey->Value);
                     UpgradeThisPackage = FALSE;
                 }
             }
@@ -166,12 +130,8 @@ YoriPkgUpgradeInstalledPackages(
                 }
             }
         }
-        if (Equals) {
-            *Equals = '=';
-        }
 
-        ThisLine += LineLength;
-        ThisLine++;
+        InstalledKey = YoriLibIniGetNextKey(InstalledSection, InstalledKey);
     }
 
     //
@@ -182,6 +142,8 @@ YoriPkgUpgradeInstalledPackages(
 
 Exit:
 
+    YoriLibIniCleanup(&PkgIni);
+
     //
     //  If there's any backup left, abort the install of those packages.
     //
@@ -193,7 +155,6 @@ Exit:
     YoriPkgDeletePendingPackages(&PendingPackages);
 
     YoriLibFreeStringContents(&PkgIniFile);
-    YoriLibFreeStringContents(&InstalledSection);
     YoriLibFreeStringContents(&UpgradePath);
 
     return TRUE;
@@ -221,17 +182,11 @@ YoriPkgUpgradeSinglePackage(
 {
     YORI_STRING PkgIniFile;
     YORI_STRING IniValue;
+    YORI_LIB_INI_DOCUMENT PkgIni;
     BOOL Result;
     DWORD Error;
     YORIPKG_PACKAGES_PENDING_INSTALL PendingPackages;
 
-    if (DllKernel32.pGetPrivateProfileIntW == NULL ||
-        DllKernel32.pGetPrivateProfileStringW == NULL ||
-        DllKernel32.pWritePrivateProfileStringW == NULL) {
-
-        return FALSE;
-    }
-
     if (!YoriPkgInitializePendingPackages(&PendingPackages)) {
         return FALSE;
     }
@@ -247,14 +202,16 @@ YoriPkgUpgradeSinglePackage(
         return FALSE;
     }
 
-    IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(_T("Installed"),
-                                              PackageName->StartOfString,
-                                              _T(""),
-                                              IniValue.StartOfString,
-                                              IniValue.LengthAllocated,
-                                              PkgIniFile.StartOfString);
+    if (!YoriLibIniLoad(&PkgIni, &PkgIniFile)) {
+        YoriPkgDeletePendingPackages(&PendingPackages);
+        YoriLibFreeStringContents(&PkgIniFile);
+        YoriLibFreeStringContents(&IniValue);
+        return FALSE;
+    }
+
+    YoriLibIniGetString(&PkgIni, _T("Installed"), PackageName->StartOfString, &IniValue);
     if (IniValue.LengthInChars == 0) {
+        YoriLibIniCleanup(&PkgIni);
         YoriPkgDeletePendingPackages(&PendingPackages);
         YoriLibFreeStringContents(&PkgIniFile);
         YoriLibFreeStringContents(&IniValue);
@@ -264,34 +221,17 @@ YoriPkgUpgradeSinglePackage(
 
     IniValue.LengthInChars = 0;
     if (Prefer == YoriPkgUpgradePreferStable) {
-        IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
-            DllKernel32.pGetPrivateProfileStringW(PackageName->StartOfString,
-                                                  _T("UpgradeToStablePath"),
-                                                  _T(""),
-                                                  IniValue.StartOfString,
-                                                  IniValue.LengthAllocated,
-                                                  PkgIniFile.StartOfString);
+        YoriLibIniGetString(&PkgIni, PackageName->StartOfString, _T("UpgradeToStablePath"), &IniValue);
     } else if (Prefer == YoriPkgUpgradePreferDaily) {
-        IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
-            DllKernel32.pGetPrivateProfileStringW(PackageName->StartOfString,
-                                                  _T("UpgradeToDailyPath"),
-                                                  _T(""),
-                                                  IniValue.StartOfString,
-                                                  IniValue.LengthAllocated,
-                                                  PkgIniFile.StartOfString);
+        YoriLibIniGetString(&PkgIni, PackageName->StartOfString, _T("UpgradeToDailyPath"), &IniValue);
     }
 
     if (IniValue.LengthInChars == 0) {
-        IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
-            DllKernel32.pGetPrivateProfileStringW(PackageName->StartOfString,
-                                                  _T("UpgradePath"),
-                                                  _T(""),
-                                                  IniValue.StartOfString,
-                                                  IniValue.LengthAllocated,
-                                                  PkgIniFile.StartOfString);
+        YoriLibIniGetString(&PkgIni, PackageName->StartOfString, _T("UpgradePath"), &IniValue);
     }
 
     if (IniValue.LengthInChars == 0) {
+        YoriLibIniCleanup(&PkgIni);
         YoriPkgDeletePendingPackages(&PendingPackages);
         YoriLibFreeStringContents(&PkgIniFile);
         YoriLibFreeStringContents(&IniValue);
@@ -300,9 +240,11 @@ YoriPkgUpgradeSinglePackage(
     }
 
     if (NewArchitecture != NULL) {
-        YoriPkgBuildUpgradeLocationForNewArchitecture(PackageName, NewArchitecture, &PkgIniFile, &IniValue);
+        YoriPkgBuildUpgradeLocationForNewArchitecture(PackageName, NewArchitecture, &PkgIni, &IniValue);
     }
 
+    YoriLibIniCleanup(&PkgIni);
+
     Result = FALSE;
     Error = YoriPkgPreparePackageForInstallRedirectBuild(&PkgIniFile, NULL, &PendingPackages, &IniValue);
     if (Error != ERROR_SUCCESS) {
@@ -347,10 +289,6 @@ YoriPkgInstallSinglePackage(
     DWORD Error;
     YORIPKG_PACKAGES_PENDING_INSTALL PendingPackages;
 
-    if (DllKernel32.pWritePrivateProfileStringW == NULL) {
-        return FALSE;
-    }
-
     if (!YoriPkgInitializePendingPackages(&PendingPackages)) {
         return FALSE;
     }
@@ -394,24 +332,14 @@ BOOL
 YoriPkgInstallSourceForInstalledPackages(VOID)
 {
     YORI_STRING PkgIniFile;
-    YORI_STRING InstalledSection;
-    LPTSTR ThisLine;
-    LPTSTR Equals;
-    YORI_STRING PkgNameOnly;
+    YORI_LIB_INI_DOCUMENT PkgIni;
+    PYORI_LIB_INI_SECTION InstalledSection;
+    PYORI_LIB_INI_KEY InstalledKey;
     YORI_STRING SourcePath;
-    YORI_ALLOC_SIZE_T LineLength;
     DWORD Error;
     BOOL Result;
     YORIPKG_PACKAGES_PENDING_INSTALL PendingPackages;
 
-    if (DllKernel32.pGetPrivateProfileIntW == NULL ||
-        DllKernel32.pGetPrivateProfileSectionW == NULL ||
-        DllKernel32.pGetPrivateProfileStringW == NULL ||
-        DllKernel32.pWritePrivateProfileStringW == NULL) {
-
-        return FALSE;
-    }
-
     if (!YoriPkgInitializePendingPackages(&PendingPackages)) {
         return FALSE;
     }
@@ -421,50 +349,31 @@ YoriPkgInstallSourceForInstalledPackages(VOID)
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&InstalledSection, YORIPKG_MAX_SECTION_LENGTH)) {
+    if (!YoriLibAllocateString(&SourcePath, YORIPKG_MAX_FIELD_LENGTH)) {
         YoriPkgDeletePendingPackages(&PendingPackages);
         YoriLibFreeStringContents(&PkgIniFile);
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&SourcePath, YORIPKG_MAX_FIELD_LENGTH)) {
+    if (!YoriLibIniLoad(&PkgIni, &PkgIniFile)) {
         YoriPkgDeletePendingPackages(&PendingPackages);
-        YoriLibFreeStringContents(&InstalledSection);
+        YoriLibFreeStringContents(&SourcePath);
         YoriLibFreeStringContents(&PkgIniFile);
         return FALSE;
     }
 
-    InstalledSection.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileSectionW(_T("Installed"),
-                                               InstalledSection.StartOfString,
-                                               InstalledSection.LengthAllocated,
-                                               PkgIniFile.StartOfString);
-
-    YoriLibInitEmptyString(&PkgNameOnly);
-    ThisLine = InstalledSection.StartOfString;
+    InstalledSection = YoriLibIniFindSection(&PkgIni, _T("Installed"));
+    InstalledKey = NULL;
+    if (InstalledSection != NULL) {
+        InstalledKey = YoriLibIniGetNextKey(InstalledSection, NULL);
+    }
 
     Result = FALSE;
-    while (*ThisLine != '\0') {
-        LineLength = (YORI_ALLOC_SIZE_T)_tcslen(ThisLine);
-        PkgNameOnly.StartOfString = ThisLine;
-        Equals = _tcschr(ThisLine, '=');
-        if (Equals != NULL) {
-            PkgNameOnly.LengthInChars = (YORI_ALLOC_SIZE_T)(Equals - ThisLine);
-            *Equals = '\0';
-        } else {
-            PkgNameOnly.LengthInChars = LineLength;
-        }
-
-        SourcePath.LengthInChars = (YORI_ALLOC_SIZE_T)
-            DllKernel32.pGetPrivateProfileStringW(PkgNameOnly.StartOfString,
-                                                  _T("SourcePath"),
-                                                  _T(""),
-                                                  SourcePath.StartOfString,
-                                                  SourcePath.LengthAllocated,
-                                                  PkgIniFile.StartOfString);
+    while (InstalledKey != NULL) {
+        YoriLibIniGetString(&PkgIni, InstalledKey->Name.StartOfString, _T("SourcePath"), &SourcePath);
         if (SourcePath.LengthInChars > 0) {
             if (YoriLibIsPathUrl(&SourcePath)) {
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Downloading source for %y from %y...\n"), &PkgNameOnly, &SourcePath);
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Downloading source for %y from %y...\n"), &InstalledKey->Name, &SourcePath);
             }
             Error = YoriPkgPreparePackageForInstall(&PkgIniFile, NULL, &PendingPackages, &SourcePath, NULL);
             if (Error != ERROR_SUCCESS) {
@@ -472,12 +381,8 @@ YoriPkgInstallSourceForInstalledPackages(VOID)
                 goto Exit;
             }
         }
-        if (Equals) {
-            *Equals = '=';
-        }
 
-        ThisLine += LineLength;
-        ThisLine++;
+        InstalledKey = YoriLibIniGetNextKey(InstalledSection, InstalledKey);
     }
 
     //
@@ -488,6 +393,8 @@ YoriPkgInstallSourceForInstalledPackages(VOID)
 
 Exit:
 
+    YoriLibIniCleanup(&PkgIni);
+
     //
     //  If there's any backup left, abort the install of those packages.
     //
@@ -499,7 +406,6 @@ Exit:
     YoriPkgDeletePendingPackages(&PendingPackages);
 
     YoriLibFreeStringContents(&PkgIniFile);
-    YoriLibFreeStringContents(&InstalledSection);
     YoriLibFreeStringContents(&SourcePath);
 
     return TRUE;
@@ -519,17 +425,11 @@ YoriPkgInstallSourceForSinglePackage(
 {
     YORI_STRING PkgIniFile;
     YORI_STRING IniValue;
+    YORI_LIB_INI_DOCUMENT PkgIni;
     BOOL Result;
     DWORD Error;
     YORIPKG_PACKAGES_PENDING_INSTALL PendingPackages;
 
-    if (DllKernel32.pGetPrivateProfileIntW == NULL ||
-        DllKernel32.pGetPrivateProfileStringW == NULL ||
-        DllKernel32.pWritePrivateProfileStringW == NULL) {
-
-        return FALSE;
-    }
-
     if (!YoriPkgInitializePendingPackages(&PendingPackages)) {
         return FALSE;
     }
@@ -545,14 +445,16 @@ YoriPkgInstallSourceForSinglePackage(
         return FALSE;
     }
 
-    IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(_T("Installed"),
-                                              PackageName->StartOfString,
-                                              _T(""),
-                                              IniValue.StartOfString,
-                                              IniValue.LengthAllocated,
-                                              PkgIniFile.StartOfString);
+    if (!YoriLibIniLoad(&PkgIni, &PkgIniFile)) {
+        YoriPkgDeletePendingPackages(&PendingPackages);
+        YoriLibFreeStringContents(&PkgIniFile);
+        YoriLibFreeStringContents(&IniValue);
+        return FALSE;
+    }
+
+    YoriLibIniGetString(&PkgIni, _T("Installed"), PackageName->StartOfString, &IniValue);
     if (IniValue.LengthInChars == 0) {
+        YoriLibIniCleanup(&PkgIni);
         YoriPkgDeletePendingPackages(&PendingPackages);
         YoriLibFreeStringContents(&PkgIniFile);
         YoriLibFreeStringContents(&IniValue);
@@ -560,13 +462,8 @@ YoriPkgInstallSourceForSinglePackage(
         return FALSE;
     }
 
-    IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(PackageName->StartOfString,
-                                              _T("SourcePath"),
-                                              _T(""),
-                                              IniValue.StartOfString,
-                                              IniValue.LengthAllocated,
-                                              PkgIniFile.StartOfString);
+    YoriLibIniGetString(&PkgIni, PackageName->StartOfString, _T("SourcePath"), &IniValue);
+    YoriLibIniCleanup(&PkgIni);
 
     if (IniValue.LengthInChars == 0) {
         YoriPkgDeletePendingPackages(&PendingPackages);
@@ -610,25 +507,15 @@ BOOL
 YoriPkgInstallSymbolsForInstalledPackages(VOID)
 {
     YORI_STRING PkgIniFile;
-    YORI_STRING InstalledSection;
-    LPTSTR ThisLine;
-    LPTSTR Equals;
-    YORI_STRING PkgNameOnly;
+    YORI_LIB_INI_DOCUMENT PkgIni;
+    PYORI_LIB_INI_SECTION InstalledSection;
+    PYORI_LIB_INI_KEY InstalledKey;
     YORI_STRING SymbolPath;
-    YORI_ALLOC_SIZE_T LineLength;
     DWORD TotalCount;
     DWORD Error;
     BOOL Result;
     YORIPKG_PACKAGES_PENDING_INSTALL PendingPackages;
 
-    if (DllKernel32.pGetPrivateProfileIntW == NULL ||
-        DllKernel32.pGetPrivateProfileSectionW == NULL ||
-        DllKernel32.pGetPrivateProfileStringW == NULL ||
-        DllKernel32.pWritePrivateProfileStringW == NULL) {
-
-        return FALSE;
-    }
-
     if (!YoriPkgInitializePendingPackages(&PendingPackages)) {
         return FALSE;
     }
@@ -638,51 +525,32 @@ YoriPkgInstallSymbolsForInstalledPackages(VOID)
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&InstalledSection, YORIPKG_MAX_SECTION_LENGTH)) {
+    if (!YoriLibAllocateString(&SymbolPath, YORIPKG_MAX_FIELD_LENGTH)) {
         YoriPkgDeletePendingPackages(&PendingPackages);
         YoriLibFreeStringContents(&PkgIniFile);
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&SymbolPath, YORIPKG_MAX_FIELD_LENGTH)) {
+    if (!YoriLibIniLoad(&PkgIni, &PkgIniFile)) {
         YoriPkgDeletePendingPackages(&PendingPackages);
-        YoriLibFreeStringContents(&InstalledSection);
+        YoriLibFreeStringContents(&SymbolPath);
         YoriLibFreeStringContents(&PkgIniFile);
         return FALSE;
     }
 
-    InstalledSection.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileSectionW(_T("Installed"),
-                                               InstalledSection.StartOfString,
-                                               InstalledSection.LengthAllocated,
-                                               PkgIniFile.StartOfString);
-
-    YoriLibInitEmptyString(&PkgNameOnly);
-    ThisLine = InstalledSection.StartOfString;
+    InstalledSection = YoriLibIniFindSection(&PkgIni, _T("Installed"));
+    InstalledKey = NULL;
+    if (InstalledSection != NULL) {
+        InstalledKey = YoriLibIniGetNextKey(InstalledSection, NULL);
+    }
 
     TotalCount = 0;
     Result = FALSE;
-    while (*ThisLine != '\0') {
-        LineLength = (YORI_ALLOC_SIZE_T)_tcslen(ThisLine);
-        PkgNameOnly.StartOfString = ThisLine;
-        Equals = _tcschr(ThisLine, '=');
-        if (Equals != NULL) {
-            PkgNameOnly.LengthInChars = (YORI_ALLOC_SIZE_T)(Equals - ThisLine);
-            *Equals = '\0';
-        } else {
-            PkgNameOnly.LengthInChars = LineLength;
-        }
-
-        SymbolPath.LengthInChars = (YORI_ALLOC_SIZE_T)
-            DllKernel32.pGetPrivateProfileStringW(PkgNameOnly.StartOfString,
-                                                  _T("SymbolPath"),
-                                                  _T(""),
-                                                  SymbolPath.StartOfString,
-                                                  SymbolPath.LengthAllocated,
-                                                  PkgIniFile.StartOfString);
+    while (InstalledKey != NULL) {
+        YoriLibIniGetString(&PkgIni, InstalledKey->Name.StartOfString, _T("SymbolPath"), &SymbolPath);
         if (SymbolPath.LengthInChars > 0) {
             if (YoriLibIsPathUrl(&SymbolPath)) {
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Downloading symbols for %y from %y...\n"), &PkgNameOnly, &SymbolPath);
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Downloading symbols for %y from %y...\n"), &InstalledKey->Name, &SymbolPath);
             }
             Error = YoriPkgPreparePackageForInstall(&PkgIniFile, NULL, &PendingPackages, &SymbolPath, NULL);
             if (Error != ERROR_SUCCESS) {
@@ -691,12 +559,8 @@ YoriPkgInstallSymbolsForInstalledPackages(VOID)
             }
             TotalCount++;
         }
-        if (Equals) {
-            *Equals = '=';
-        }
 
-        ThisLine += LineLength;
-        ThisLine++;
+        InstalledKey = YoriLibIniGetNextKey(InstalledSection, InstalledKey);
     }
 
     //
@@ -707,6 +571,8 @@ YoriPkgInstallSymbolsForInstalledPackages(VOID)
 
 Exit:
 
+    YoriLibIniCleanup(&PkgIni);
+
     //
     //  If there's any backup left, abort the install of those packages.
     //
@@ -718,7 +584,6 @@ Exit:
     YoriPkgDeletePendingPackages(&PendingPackages);
 
     YoriLibFreeStringContents(&PkgIniFile);
-    YoriLibFreeStringContents(&InstalledSection);
     YoriLibFreeStringContents(&SymbolPath);
 
     return TRUE;
@@ -738,17 +603,11 @@ YoriPkgInstallSymbolForSinglePackage(
 {
     YORI_STRING PkgIniFile;
     YORI_STRING IniValue;
+    YORI_LIB_INI_DOCUMENT PkgIni;
     DWORD Error;
     BOOL Result;
     YORIPKG_PACKAGES_PENDING_INSTALL PendingPackages;
 
-    if (DllKernel32.pGetPrivateProfileIntW == NULL ||
-        DllKernel32.pGetPrivateProfileStringW == NULL ||
-        DllKernel32.pWritePrivateProfileStringW == NULL) {
-
-        return FALSE;
-    }
-
     if (!YoriPkgInitializePendingPackages(&PendingPackages)) {
         return FALSE;
     }
@@ -764,14 +623,16 @@ YoriPkgInstallSymbolForSinglePackage(
         return FALSE;
     }
 
-    IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(_T("Installed"),
-                                              PackageName->StartOfString,
-                                              _T(""),
-                                              IniValue.StartOfString,
-                                              IniValue.LengthAllocated,
-                                              PkgIniFile.StartOfString);
+    if (!YoriLibIniLoad(&PkgIni, &PkgIniFile)) {
+        YoriPkgDeletePendingPackages(&PendingPackages);
+        YoriLibFreeStringContents(&PkgIniFile);
+        YoriLibFreeStringContents(&IniValue);
+        return FALSE;
+    }
+
+    YoriLibIniGetString(&PkgIni, _T("Installed"), PackageName->StartOfString, &IniValue);
     if (IniValue.LengthInChars == 0) {
+        YoriLibIniCleanup(&PkgIni);
         YoriPkgDeletePendingPackages(&PendingPackages);
         YoriLibFreeStringContents(&PkgIniFile);
         YoriLibFreeStringContents(&IniValue);
@@ -779,13 +640,8 @@ YoriPkgInstallSymbolForSinglePackage(
         return FALSE;
     }
 
-    IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(PackageName->StartOfString,
-                                              _T("SymbolPath"),
-                                              _T(""),
-                                              IniValue.StartOfString,
-                                              IniValue.LengthAllocated,
-                                              PkgIniFile.StartOfString);
+    YoriLibIniGetString(&PkgIni, PackageName->StartOfString, _T("SymbolPath"), &IniValue);
+    YoriLibIniCleanup(&PkgIni);
 
     if (IniValue.LengthInChars == 0) {
         YoriPkgDeletePendingPackages(&PendingPackages);
@@ -834,80 +690,45 @@ YoriPkgListInstalledPackages(
     )
 {
     YORI_STRING PkgIniFile;
-    YORI_STRING InstalledSection;
-    LPTSTR ThisLine;
-    LPTSTR Equals;
-    YORI_STRING PkgNameOnly;
-    YORI_STRING PkgVersion;
+    YORI_LIB_INI_DOCUMENT PkgIni;
+    PYORI_LIB_INI_SECTION InstalledSection;
+    PYORI_LIB_INI_KEY InstalledKey;
+    PYORI_LIB_INI_KEY ArchKey;
     YORI_STRING PkgArch;
 
-    if (DllKernel32.pGetPrivateProfileIntW == NULL ||
-        DllKernel32.pGetPrivateProfileSectionW == NULL ||
-        DllKernel32.pGetPrivateProfileStringW == NULL) {
-        return FALSE;
-    }
-
     if (!YoriPkgGetPackageIniFile(NULL, &PkgIniFile)) {
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&InstalledSection, YORIPKG_MAX_SECTION_LENGTH)) {
+    if (!YoriLibIniLoad(&PkgIni, &PkgIniFile)) {
         YoriLibFreeStringContents(&PkgIniFile);
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&PkgArch, YORIPKG_MAX_FIELD_LENGTH)) {
-        YoriLibFreeStringContents(&InstalledSection);
-        YoriLibFreeStringContents(&PkgIniFile);
-        return FALSE;
+    InstalledSection = YoriLibIniFindSection(&PkgIni, _T("Installed"));
+    InstalledKey = NULL;
+    if (InstalledSection != NULL) {
+        InstalledKey = YoriLibIniGetNextKey(InstalledSection, NULL);
     }
 
-    InstalledSection.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileSectionW(_T("Installed"),
-                                               InstalledSection.StartOfString,
-                                               InstalledSection.LengthAllocated,
-                                               PkgIniFile.StartOfString);
-
-    YoriLibInitEmptyString(&PkgNameOnly);
-    YoriLibInitEmptyString(&PkgVersion);
-    ThisLine = InstalledSection.StartOfString;
-
-    while (*ThisLine != '\0') {
-        PkgNameOnly.StartOfString = ThisLine;
-        Equals = _tcschr(ThisLine, '=');
-        if (Equals != NULL) {
-            PkgNameOnly.LengthInChars = (YORI_ALLOC_SIZE_T)(Equals - ThisLine);
-            PkgVersion.StartOfString = Equals + 1;
-            PkgVersion.LengthInChars = (YORI_ALLOC_SIZE_T)_tcslen(Equals + 1);
-        } else {
-            PkgNameOnly.LengthInChars = (YORI_ALLOC_SIZE_T)_tcslen(ThisLine);
-            PkgVersion.StartOfString = NULL;
-            PkgVersion.LengthInChars = 0;
-        }
-
-        ThisLine += _tcslen(ThisLine);
-        ThisLine++;
-
-        PkgNameOnly.StartOfString[PkgNameOnly.LengthInChars] = '\0';
-
-        PkgArch.LengthInChars = (YORI_ALLOC_SIZE_T)
-            DllKernel32.pGetPrivateProfileStringW(PkgNameOnly.StartOfString,
-                                                  _T("Architecture"),
-                                                  _T(""),
-                                                  PkgArch.StartOfString,
-                                                  PkgArch.LengthAllocated,
-                                                  PkgIniFile.StartOfString);
-
+    while (InstalledKey != NULL) {
         if (Verbose) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y %y (%y)\n"), &PkgNameOnly, &PkgVersion, &PkgArch);
+            ArchKey = YoriLibIniFindSectionKey(&PkgIni, InstalledKey->Name.StartOfString, _T("Architecture"));
+            if (ArchKey != NULL) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y %y (%y)\n"), &InstalledKey->Name, &InstalledKey->Value, &ArchKey->Value);
+            } else {
+                YoriLibInitEmptyString(&PkgArch);
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y %y (%y)\n"), &InstalledKey->Name, &InstalledKey->Value, &PkgArch);
+            }
         } else {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), &PkgNameOnly);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), &InstalledKey->Name);
         }
+
+        InstalledKey = YoriLibIniGetNextKey(InstalledSection, InstalledKey);
     }
 
+    YoriLibIniCleanup(&PkgIni);
     YoriLibFreeStringContents(&PkgIniFile);
-    YoriLibFreeStringContents(&InstalledSection);
-    YoriLibFreeStringContents(&PkgArch);
 
     return TRUE;
 }
@@ -934,53 +755,38 @@ YoriPkgDeletePackage(
     )
 {
     YORI_STRING PkgIniFile;
-    YORI_STRING IniValue;
+    YORI_LIB_INI_DOCUMENT PkgIni;
     DWORD FileCount;
     DWORD Error;
 
-    if (DllKernel32.pGetPrivateProfileIntW == NULL ||
-        DllKernel32.pGetPrivateProfileStringW == NULL ||
-        DllKernel32.pWritePrivateProfileStringW == NULL) {
-
-        return FALSE;
-    }
-
     if (!YoriPkgGetPackageIniFile(TargetDirectory, &PkgIniFile)) {
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&IniValue, YORIPKG_MAX_FIELD_LENGTH)) {
+    if (!YoriLibIniLoad(&PkgIni, &PkgIniFile)) {
         YoriLibFreeStringContents(&PkgIniFile);
         return FALSE;
     }
 
-    IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(_T("Installed"),
-                                              PackageName->StartOfString,
-                                              _T(""),
-                                              IniValue.StartOfString,
-                                              IniValue.LengthAllocated,
-                                              PkgIniFile.StartOfString);
-    if (IniValue.LengthInChars == 0) {
+    if (YoriLibIniFindSectionKey(&PkgIni, _T("Installed"), PackageName->StartOfString) == NULL) {
         if (WarnIfNotInstalled) {
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%y is not an installed package\n"), PackageName);
         }
+        YoriLibIniCleanup(&PkgIni);
         YoriLibFreeStringContents(&PkgIniFile);
-        YoriLibFreeStringContents(&IniValue);
         return FALSE;
     }
 
-    FileCount = DllKernel32.pGetPrivateProfileIntW(PackageName->StartOfString, _T("FileCount"), 0, PkgIniFile.StartOfString);
+    FileCount = YoriLibIniGetInt(&PkgIni, PackageName->StartOfString, _T("FileCount"), 0);
+    YoriLibIniCleanup(&PkgIni);
     if (FileCount == 0) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%y contains nothing to remove\n"), PackageName);
         YoriLibFreeStringContents(&PkgIniFile);
-        YoriLibFreeStringContents(&IniValue);
         return FALSE;
     }
 
     Error = YoriPkgDeletePackageInternal(&PkgIniFile, TargetDirectory, PackageName, FALSE);
     YoriLibFreeStringContents(&PkgIniFile);
-    YoriLibFreeStringContents(&IniValue);
     if (Error != ERROR_SUCCESS) {
         YoriPkgDisplayErrorStringForInstallFailure(Error);
         return FALSE;
@@ -997,38 +803,33 @@ BOOL
 YoriPkgDeleteAllPackages(VOID)
 {
     YORI_STRING PkgIniFile;
-    YORI_STRING InstalledSection;
-    LPTSTR ThisLine;
-    LPTSTR Equals;
-    YORI_STRING PkgNameOnly;
+    YORI_LIB_INI_DOCUMENT PkgIni;
+    PYORI_LIB_INI_SECTION InstalledSection;
+    PYORI_LIB_INI_KEY InstalledKey;
     BOOL Result;
     DWORD Error;
 
-    if (DllKernel32.pGetPrivateProfileIntW == NULL ||
-        DllKernel32.pGetPrivateProfileSectionW == NULL ||
-        DllKernel32.pGetPrivateProfileStringW == NULL ||
-        DllKernel32.pWritePrivateProfileStringW == NULL) {
-
-        return FALSE;
-    }
-
     if (!YoriPkgGetPackageIniFile(NULL, &PkgIniFile)) {
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&InstalledSection, YORIPKG_MAX_SECTION_LENGTH)) {
+    if (!YoriLibIniLoad(&PkgIni, &PkgIniFile)) {
         YoriLibFreeStringContents(&PkgIniFile);
         return FALSE;
     }
 
-    InstalledSection.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileSectionW(_T("Installed"),
-                                               InstalledSection.StartOfString,
-                                               InstalledSection.LengthAllocated,
-                                               PkgIniFile.StartOfString);
+    //
+    //  The document is used to enumerate installed packages.  Deleting
+    //  each package updates the file directly, and this copy is never
+    //  saved.
+    //
 
-    YoriLibInitEmptyString(&PkgNameOnly);
-    ThisLine = InstalledSection.StartOfString;
+    InstalledSection = YoriLibIniFindSection(&PkgIni, _T("Installed"));
+    if (InstalledSection == NULL) {
+        YoriLibIniCleanup(&PkgIni);
+        YoriLibFreeStringContents(&PkgIniFile);
+        return TRUE;
+    }
 
     //
     //  First, check whether all packages can be deleted.  If any cannot
@@ -1037,67 +838,37 @@ YoriPkgDeleteAllPackages(VOID)
     //
 
     Result = TRUE;
-    while (*ThisLine != '\0') {
-        PkgNameOnly.StartOfString = ThisLine;
-        Equals = _tcschr(ThisLine, '=');
-        if (Equals != NULL) {
-            PkgNameOnly.LengthInChars = (YORI_ALLOC_SIZE_T)(Equals - ThisLine);
-        } else {
-            PkgNameOnly.LengthInChars = (YORI_ALLOC_SIZE_T)_tcslen(ThisLine);
-        }
-
-        ThisLine += _tcslen(ThisLine);
-        ThisLine++;
-
-        PkgNameOnly.StartOfString[PkgNameOnly.LengthInChars] = '\0';
-        if (!YoriPkgCheckIfPackageDeleteable(&PkgIniFile, NULL, &PkgNameOnly, TRUE)) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Could not remove package %y\n"), &PkgNameOnly);
+    InstalledKey = YoriLibIniGetNextKey(InstalledSection, NULL);
+    while (InstalledKey != NULL) {
+        if (!YoriPkgCheckIfPackageDeleteable(&PkgIniFile, NULL, &InstalledKey->Name, TRUE)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Could not remove package %y\n"), &InstalledKey->Name);
             Result = FALSE;
             break;
         }
+        InstalledKey = YoriLibIniGetNextKey(InstalledSection, InstalledKey);
     }
 
     if (!Result) {
+        YoriLibIniCleanup(&PkgIni);
         YoriLibFreeStringContents(&PkgIniFile);
-        YoriLibFreeStringContents(&InstalledSection);
 
         return Result;
     }
 
-    InstalledSection.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileSectionW(_T("Installed"),
-                                               InstalledSection.StartOfString,
-                                               InstalledSection.LengthAllocated,
-                                               PkgIniFile.StartOfString);
-
-    YoriLibInitEmptyString(&PkgNameOnly);
-    ThisLine = InstalledSection.StartOfString;
-
-    Result = TRUE;
-    while (*ThisLine != '\0') {
-        PkgNameOnly.StartOfString = ThisLine;
-        Equals = _tcschr(ThisLine, '=');
-        if (Equals != NULL) {
-            PkgNameOnly.LengthInChars = (YORI_ALLOC_SIZE_T)(Equals - ThisLine);
-        } else {
-            PkgNameOnly.LengthInChars = (YORI_ALLOC_SIZE_T)_tcslen(ThisLine);
-        }
-
-        ThisLine += _tcslen(ThisLine);
-        ThisLine++;
-
-        PkgNameOnly.StartOfString[PkgNameOnly.LengthInChars] = '\0';
-        Error = YoriPkgDeletePackageInternal(&PkgIniFile, NULL, &PkgNameOnly, TRUE);
+    InstalledKey = YoriLibIniGetNextKey(InstalledSection, NULL);
+    while (InstalledKey != NULL) {
+        Error = YoriPkgDeletePackageInternal(&PkgIniFile, NULL, &InstalledKey->Name, TRUE);
         if (Error != ERROR_SUCCESS) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Could not remove package %y\n"), &PkgNameOnly);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Could not remove package %y\n"), &InstalledKey->Name);
             YoriPkgDisplayErrorStringForInstallFailure(Error);
             Result = FALSE;
             break;
         }
+        InstalledKey = YoriLibIniGetNextKey(InstalledSection, InstalledKey);
     }
 
+    YoriLibIniCleanup(&PkgIni);
     YoriLibFreeStringContents(&PkgIniFile);
-    YoriLibFreeStringContents(&InstalledSection);
 
     return Result;
 }
@@ -1135,34 +906,48 @@ YoriPkgInstallPseudoPackage(
     )
 {
     YORI_STRING PkgIniFile;
+    YORI_LIB_INI_DOCUMENT PkgIni;
     DWORD FileIndex;
     TCHAR FileIndexString[16];
+    BOOL Result;
 
-    if (DllKernel32.pWritePrivateProfileStringW == NULL) {
+    if (!YoriPkgGetPackageIniFile(TargetDirectory, &PkgIniFile)) {
         return FALSE;
     }
 
-    if (!YoriPkgGetPackageIniFile(TargetDirectory, &PkgIniFile)) {
+    if (!YoriLibIniLoad(&PkgIni, &PkgIniFile)) {
+        YoriLibFreeStringContents(&PkgIniFile);
         return FALSE;
     }
 
-    DllKernel32.pWritePrivateProfileStringW(_T("Installed"), Name->StartOfString, Version->StartOfString, PkgIniFile.StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(Name->StartOfString, _T("Version"), Version->StartOfString, PkgIniFile.StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(Name->StartOfString, _T("Architecture"), Architecture->StartOfString, PkgIniFile.StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(Name->StartOfString, _T("BestEffortDelete"), _T("1"), PkgIniFile.StartOfString);
+    Result = FALSE;
+    if (!YoriLibIniSetString(&PkgIni, _T("Installed"), Name->StartOfString, Version->StartOfString) ||
+        !YoriLibIniSetString(&PkgIni, Name->StartOfString, _T("Version"), Version->StartOfString) ||
+        !YoriLibIniSetString(&PkgIni, Name->StartOfString, _T("Architecture"), Architecture->StartOfString) ||
+        !YoriLibIniSetString(&PkgIni, Name->StartOfString, _T("BestEffortDelete"), _T("1"))) {
+
+        goto Exit;
+    }
 
     for (FileIndex = 1; FileIndex <= FileCount; FileIndex++) {
         YoriLibSPrintf(FileIndexString, _T("File%i"), FileIndex);
 
-        DllKernel32.pWritePrivateProfileStringW(Name->StartOfString, FileIndexString, FileArray[FileIndex - 1].StartOfString, PkgIniFile.StartOfString);
+        if (!YoriLibIniSetString(&PkgIni, Name->StartOfString, FileIndexString, FileArray[FileIndex - 1].StartOfString)) {
+            goto Exit;
+        }
     }
     YoriLibSPrintf(FileIndexString, _T("%i"), FileCount);
-    DllKernel32.pWritePrivateProfileStringW(Name->StartOfString, _T("FileCount"), FileIndexString, PkgIniFile.StartOfString);
+    if (!YoriLibIniSetString(&PkgIni, Name->StartOfString, _T("FileCount"), FileIndexString)) {
+        goto Exit;
+    }
 
+    Result = YoriLibIniSave(&PkgIni);
 
+Exit:
+    YoriLibIniCleanup(&PkgIni);
     YoriLibFreeStringContents(&PkgIniFile);
 
-    return TRUE;
+    return Result;
 }
 
 /**
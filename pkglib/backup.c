@@ -3,7 +3,7 @@
  *
  * Yori package manager move existing files to backups and restore from them
  *
- * Copyright (c) 2018-2019 Malcolm J. Smith
+ * Copyright (c) 2018-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -93,22 +93,20 @@ YoriPkgDeleteRenamedFiles(
 
 /**
  Rename all backed up files back into their original location.  Optionally
- this also restores each file entry back into the INI file.  Note this routine
- is best effort and continues on error.
+ this also restores each file entry back into an INI document.  Note this
+ routine is best effort and continues on error.
 
- @param IniPath Pointer to the system global INI file.
+ @param PkgIni Optionally points to an in memory copy of the system global
+        INI file.  If specified, File entries in the document are restored to
+        match the names of backed up files.  If NULL, no INI state is
+        touched.  The caller is responsible for saving the document.
 
  @param PackageBackup Pointer to the backed up package.
-
- @param RestoreIni If TRUE, File entries in the INI file are restored to
-        match the names of backed up files.  If FALSE, the INI file is not
-        touched.
  */
 VOID
 YoriPkgRollbackRenamedFiles(
-    __in PCYORI_STRING IniPath,
-    __in PYORIPKG_BACKUP_PACKAGE PackageBackup,
-    __in BOOL RestoreIni
+    __in_opt PYORI_LIB_INI_DOCUMENT PkgIni,
+    __in PYORIPKG_BACKUP_PACKAGE PackageBackup
     )
 {
     PYORI_LIST_ENTRY ListEntry = NULL;
@@ -117,8 +115,6 @@ YoriPkgRollbackRenamedFiles(
     DWORD Index;
     BOOL Result;
 
-    ASSERT(DllKernel32.pWritePrivateProfileStringW != NULL);
-
     ListEntry = YoriLibGetNextListEntry(&PackageBackup->FileList, ListEntry);
     Index = 1;
     while (ListEntry != NULL) {
@@ -126,10 +122,9 @@ YoriPkgRollbackRenamedFiles(
         ASSERT(YoriLibIsStringNullTerminated(&BackupFile->OriginalName));
         ASSERT(YoriLibIsStringNullTerminated(&BackupFile->OriginalRelativeName));
 
-        if (RestoreIni) {
+        if (PkgIni != NULL) {
             YoriLibSPrintf(FileIndexString, _T("File%i"), Index);
-            DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, FileIndexString, BackupFile->OriginalRelativeName.StartOfString, IniPath->StartOfString);
-
+            YoriLibIniSetString(PkgIni, PackageBackup->PackageName.StartOfString, FileIndexString, BackupFile->OriginalRelativeName.StartOfString);
         }
 
         //
@@ -170,9 +165,9 @@ YoriPkgRollbackPackage(
     __in PYORIPKG_BACKUP_PACKAGE PackageBackup
     )
 {
+    YORI_LIB_INI_DOCUMENT PkgIni;
     TCHAR FileCountString[16];
-
-    ASSERT(DllKernel32.pWritePrivateProfileStringW != NULL);
+    LPCTSTR PackageName;
 
     ASSERT(YoriLibIsStringNullTerminated(IniPath));
 
@@ -184,67 +179,74 @@ YoriPkgRollbackPackage(
     ASSERT(PackageBackup->Version.LengthInChars > 0);
     ASSERT(PackageBackup->Architecture.LengthInChars > 0);
 
+    //
+    //  If the INI file can't be loaded, the files can still be put back,
+    //  which is the best that can be done.
+    //
+
+    if (!YoriLibIniLoad(&PkgIni, IniPath)) {
+        YoriLibIniCleanup(&PkgIni);
+        YoriPkgRollbackRenamedFiles(NULL, PackageBackup);
+        return;
+    }
+
+    PackageName = PackageBackup->PackageName.StartOfString;
+
     //
     //  Delete the entire existing section.  This will clear out any files
     //  added there that aren't part of the backed up package.
     //
 
-    DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, NULL, NULL, IniPath->StartOfString);
+    YoriLibIniDeleteSection(&PkgIni, PackageName);
 
     //
     //  Put back the files and recreate their INI entries.
     //
 
-    YoriPkgRollbackRenamedFiles(IniPath, PackageBackup, TRUE);
+    YoriPkgRollbackRenamedFiles(&PkgIni, PackageBackup);
     YoriLibSPrintf(FileCountString, _T("%i"), PackageBackup->FileCount);
 
     //
     //  Restore all of the fixed headers for the package.
     //
 
-    DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("FileCount"), FileCountString, IniPath->StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("Version"), PackageBackup->Version.StartOfString, IniPath->StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("Architecture"), PackageBackup->Architecture.StartOfString, IniPath->StartOfString);
+    YoriLibIniSetString(&PkgIni, PackageName, _T("FileCount"), FileCountString);
+    YoriLibIniSetString(&PkgIni, PackageName, _T("Version"), PackageBackup->Version.StartOfString);
+    YoriLibIniSetString(&PkgIni, PackageName, _T("Architecture"), PackageBackup->Architecture.StartOfString);
 
     //
-    //  Restore any optional headers for the package.
+    //  Restore any optional headers for the package.  Since the section was
+    //  deleted above, there is nothing to remove if a header is empty.
     //
 
     if (PackageBackup->UpgradePath.LengthInChars > 0) {
-        DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("UpgradePath"), PackageBackup->UpgradePath.StartOfString, IniPath->StartOfString);
-    } else {
-        DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("UpgradePath"), NULL, IniPath->StartOfString);
+        YoriLibIniSetString(&PkgIni, PackageName, _T("UpgradePath"), PackageBackup->UpgradePath.StartOfString);
     }
 
     if (PackageBackup->SourcePath.LengthInChars > 0) {
-        DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("SourcePath"), PackageBackup->SourcePath.StartOfString, IniPath->StartOfString);
-    } else {
-        DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("SourcePath"), NULL, IniPath->StartOfString);
+        YoriLibIniSetString(&PkgIni, PackageName, _T("SourcePath"), PackageBackup->SourcePath.StartOfString);
     }
 
     if (PackageBackup->SymbolPath.LengthInChars > 0) {
-        DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("SymbolPath"), PackageBackup->SymbolPath.StartOfString, IniPath->StartOfString);
-    } else {
-        DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("SymbolPath"), NULL, IniPath->StartOfString);
+        YoriLibIniSetString(&PkgIni, PackageName, _T("SymbolPath"), PackageBackup->SymbolPath.StartOfString);
     }
 
     if (PackageBackup->UpgradeToDailyPath.LengthInChars > 0) {
-        DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("UpgradeToDailyPath"), PackageBackup->UpgradeToDailyPath.StartOfString, IniPath->StartOfString);
-    } else {
-        DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("UpgradeToDailyPath"), NULL, IniPath->StartOfString);
+        YoriLibIniSetString(&PkgIni, PackageName, _T("UpgradeToDailyPath"), PackageBackup->UpgradeToDailyPath.StartOfString);
     }
 
     if (PackageBackup->UpgradeToStablePath.LengthInChars > 0) {
-        DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("UpgradeToStablePath"), PackageBackup->UpgradeToStablePath.StartOfString, IniPath->StartOfString);
-    } else {
-        DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("UpgradeToStablePath"), NULL, IniPath->StartOfString);
+        YoriLibIniSetString(&PkgIni, PackageName, _T("UpgradeToStablePath"), PackageBackup->UpgradeToStablePath.StartOfString);
     }
 
     //
     //  Indicate the package is installed.
     //
 
-    DllKernel32.pWritePrivateProfileStringW(_T("Installed"), PackageBackup->PackageName.StartOfString, PackageBackup->Version.StartOfString, IniPath->StartOfString);
+    YoriLibIniSetString(&PkgIni, _T("Installed"), PackageName, PackageBackup->Version.StartOfString);
+
+    YoriLibIniSave(&PkgIni);
+    YoriLibIniCleanup(&PkgIni);
 }
 
 /**
@@ -280,19 +282,13 @@ YoriPkgBackupPackage(
 {
     PYORIPKG_BACKUP_PACKAGE Context;
     PYORIPKG_BACKUP_FILE BackupFile;
+    YORI_LIB_INI_DOCUMENT PkgIni;
     YORI_STRING FullTargetDirectory;
     YORI_STRING IniValue;
     DWORD FileIndex;
     DWORD Err;
     TCHAR FileIndexString[16];
 
-    if (DllKernel32.pGetPrivateProfileIntW == NULL ||
-        DllKernel32.pGetPrivateProfileStringW == NULL ||
-        DllKernel32.pWritePrivateProfileStringW == NULL) {
-
-        return ERROR_PROC_NOT_FOUND;
-    }
-
     Context = YoriLibMalloc(sizeof(YORIPKG_BACKUP_PACKAGE));
     if (Context == NULL) {
         return ERROR_NOT_ENOUGH_MEMORY;
@@ -339,15 +335,28 @@ YoriPkgBackupPackage(
         return ERROR_NOT_ENOUGH_MEMORY;
     }
 
-    Context->FileCount = DllKernel32.pGetPrivateProfileIntW(Context->PackageName.StartOfString, _T("FileCount"), 0, IniPath->StartOfString);
-    if (Context->FileCount == 0) {
+    //
+    //  Load the INI file once and query every file from memory.
+    //
+
+    if (!YoriLibIniLoad(&PkgIni, IniPath)) {
         Err = GetLastError();
+        YoriLibIniCleanup(&PkgIni);
         YoriLibFreeStringContents(&FullTargetDirectory);
         YoriPkgFreeBackupPackage(Context);
         return Err;
     }
 
+    Context->FileCount = YoriLibIniGetInt(&PkgIni, Context->PackageName.StartOfString, _T("FileCount"), 0);
+    if (Context->FileCount == 0) {
+        YoriLibIniCleanup(&PkgIni);
+        YoriLibFreeStringContents(&FullTargetDirectory);
+        YoriPkgFreeBackupPackage(Context);
+        return ERROR_FILE_NOT_FOUND;
+    }
+
     if (!YoriLibAllocateString(&IniValue, YORIPKG_MAX_FIELD_LENGTH)) {
+        YoriLibIniCleanup(&PkgIni);
         YoriLibFreeStringContents(&FullTargetDirectory);
         YoriPkgFreeBackupPackage(Context);
         return ERROR_NOT_ENOUGH_MEMORY;
@@ -356,13 +365,7 @@ YoriPkgBackupPackage(
     for (FileIndex = 1; FileIndex <= Context->FileCount; FileIndex++) {
         YoriLibSPrintf(FileIndexString, _T("File%i"), FileIndex);
 
-        IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
-            DllKernel32.pGetPrivateProfileStringW(Context->PackageName.StartOfString,
-                                                  FileIndexString,
-                                                  _T(""),
-                                                  IniValue.StartOfString,
-                                                  IniValue.LengthAllocated,
-                                                  IniPath->StartOfString);
+        YoriLibIniGetString(&PkgIni, Context->PackageName.StartOfString, FileIndexString, &IniValue);
 
         //
         //  Don't backup files with absolute paths
@@ -374,7 +377,8 @@ YoriPkgBackupPackage(
 
         BackupFile = YoriLibReferencedMalloc(sizeof(YORIPKG_BACKUP_FILE));
         if (BackupFile == NULL) {
-            YoriPkgRollbackRenamedFiles(IniPath, Context, FALSE);
+            YoriPkgRollbackRenamedFiles(NULL, Context);
+            YoriLibIniCleanup(&PkgIni);
             YoriLibFreeStringContents(&FullTargetDirectory);
             YoriLibFreeStringContents(&IniValue);
             YoriPkgFreeBackupPackage(Context);
@@ -385,7 +389,8 @@ YoriPkgBackupPackage(
 
         YoriLibYPrintf(&BackupFile->OriginalName, _T("%y\\%y"), &FullTargetDirectory, &IniValue);
         if (BackupFile->OriginalName.LengthInChars == 0) {
-            YoriPkgRollbackRenamedFiles(IniPath, Context, FALSE);
+            YoriPkgRollbackRenamedFiles(NULL, Context);
+            YoriLibIniCleanup(&PkgIni);
             YoriLibFreeStringContents(&FullTargetDirectory);
             YoriLibFreeStringContents(&IniValue);
             YoriLibDereference(BackupFile);
@@ -401,7 +406,8 @@ YoriPkgBackupPackage(
         if (!YoriLibRenameFileToBackupName(&BackupFile->OriginalName, &BackupFile->BackupName)) {
             Err = GetLastError();
             if (Err != ERROR_FILE_NOT_FOUND) {
-                YoriPkgRollbackRenamedFiles(IniPath, Context, FALSE);
+                YoriPkgRollbackRenamedFiles(NULL, Context);
+                YoriLibIniCleanup(&PkgIni);
                 YoriLibFreeStringContents(&BackupFile->OriginalName);
                 YoriLibFreeStringContents(&FullTargetDirectory);
                 YoriLibFreeStringContents(&IniValue);
@@ -414,6 +420,7 @@ YoriPkgBackupPackage(
         YoriLibAppendList(&Context->FileList, &BackupFile->ListEntry);
 
     }
+    YoriLibIniCleanup(&PkgIni);
     YoriLibFreeStringContents(&FullTargetDirectory);
     YoriLibFreeStringContents(&IniValue);
 
@@ -425,8 +432,10 @@ YoriPkgBackupPackage(
  Remove any references to a package from the INI file.  This is used once a
  backup has been generated, so all of these values can be restored.  It ensures
  the INI file is clean in preparation for a subsequent package installation.
+ The caller is responsible for saving the document.
 
- @param IniPath Pointer to the INI file name to remove all entries from.
+ @param PkgIni Pointer to the in memory copy of the INI file to remove all
+        entries from.
 
  @param PackageBackup Pointer to a package backup structure.  All that's
         needed here is the package name, but the structure is used to 
@@ -434,14 +443,12 @@ YoriPkgBackupPackage(
  */
 VOID
 YoriPkgRemoveSystemReferencesToPackage(
-    __in PYORI_STRING IniPath,
+    __inout PYORI_LIB_INI_DOCUMENT PkgIni,
     __in PYORIPKG_BACKUP_PACKAGE PackageBackup
     )
 {
-    ASSERT(DllKernel32.pWritePrivateProfileStringW != NULL);
-
-    DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, NULL, NULL, IniPath->StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(_T("Installed"), PackageBackup->PackageName.StartOfString, NULL, IniPath->StartOfString);
+    YoriLibIniDeleteSection(PkgIni, PackageBackup->PackageName.StartOfString);
+    YoriLibIniDeleteKey(PkgIni, _T("Installed"), PackageBackup->PackageName.StartOfString);
 }
 
 /**
@@ -469,8 +476,6 @@ YoriPkgRollbackAndFreeBackupPackageList(
     PYORI_LIST_ENTRY ListEntry = NULL;
     PYORIPKG_BACKUP_PACKAGE BackupPackage;
 
-    ASSERT(DllKernel32.pWritePrivateProfileStringW != NULL);
-
     ListEntry = YoriLibGetNextListEntry(ListHead, ListEntry);
     while (ListEntry != NULL) {
         BackupPackage = CONTAINING_RECORD(ListEntry, YORIPKG_BACKUP_PACKAGE, PackageList);
@@ -619,74 +624,54 @@ YoriPkgAddExistingFilesToPendingPackages(
     __in PYORIPKG_PACKAGES_PENDING_INSTALL PendingPackages
     )
 {
-    YORI_STRING InstalledSection;
-    LPTSTR ThisLine;
-    LPTSTR Equals;
-    YORI_STRING PkgNameOnly;
+    YORI_LIB_INI_DOCUMENT PkgIni;
+    PYORI_LIB_INI_SECTION InstalledSection;
+    PYORI_LIB_INI_KEY InstalledKey;
     YORI_STRING IniValue;
-    YORI_ALLOC_SIZE_T LineLength;
     DWORD FileCount;
     DWORD FileIndex;
     TCHAR FileIndexString[16];
 
-    if (DllKernel32.pGetPrivateProfileIntW == NULL ||
-        DllKernel32.pGetPrivateProfileSectionW == NULL ||
-        DllKernel32.pGetPrivateProfileStringW == NULL) {
+    if (!YoriLibAllocateString(&IniValue, YORIPKG_MAX_FIELD_LENGTH)) {
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&InstalledSection, YORIPKG_MAX_SECTION_LENGTH)) {
-        return FALSE;
-    }
+    //
+    //  Every installed package and every file within it is queried here,
+    //  so load the INI file once rather than parsing it for each value.
+    //
 
-    if (!YoriLibAllocateString(&IniValue, YORIPKG_MAX_FIELD_LENGTH)) {
-        YoriLibFreeStringContents(&InstalledSection);
+    if (!YoriLibIniLoad(&PkgIni, PkgIniFile)) {
+        YoriLibIniCleanup(&PkgIni);
+        YoriLibFreeStringContents(&IniValue);
         return FALSE;
     }
 
-    InstalledSection.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileSectionW(_T("Installed"),
-                                               InstalledSection.StartOfString,
-                                               InstalledSection.LengthAllocated,
-                                               PkgIniFile->StartOfString);
-
-    YoriLibInitEmptyString(&PkgNameOnly);
-    ThisLine = InstalledSection.StartOfString;
-
-    while (*ThisLine != '\0') {
-        PkgNameOnly.StartOfString = ThisLine;
-        Equals = _tcschr(ThisLine, '=');
-        LineLength = (YORI_ALLOC_SIZE_T)_tcslen(ThisLine);
-        if (Equals != NULL) {
-            PkgNameOnly.LengthInChars = (YORI_ALLOC_SIZE_T)(Equals - ThisLine);
-        } else {
-            PkgNameOnly.LengthInChars = LineLength;
-        }
-        ThisLine += LineLength;
-        ThisLine++;
-        PkgNameOnly.StartOfString[PkgNameOnly.LengthInChars] = '\0';
+    InstalledSection = YoriLibIniFindSection(&PkgIni, _T("Installed"));
+    InstalledKey = NULL;
+    if (InstalledSection != NULL) {
+        InstalledKey = YoriLibIniGetNextKey(InstalledSection, NULL);
+    }
 
-        FileCount = DllKernel32.pGetPrivateProfileIntW(PkgNameOnly.StartOfString, _T("FileCount"), 0, PkgIniFile->StartOfString);
+    while (InstalledKey != NULL) {
+        ASSERT(YoriLibIsStringNullTerminated(&InstalledKey->Name));
+        FileCount = YoriLibIniGetInt(&PkgIni, InstalledKey->Name.StartOfString, _T("FileCount"), 0);
 
         for (FileIndex = 1; FileIndex <= FileCount; FileIndex++) {
             YoriLibSPrintf(FileIndexString, _T("File%i"), FileIndex);
 
-            IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
-                DllKernel32.pGetPrivateProfileStringW(PkgNameOnly.StartOfString,
-                                                      FileIndexString,
-                                                      _T(""),
-                                                      IniValue.StartOfString,
-                                                      IniValue.LengthAllocated,
-                                                      PkgIniFile->StartOfString);
+            YoriLibIniGetString(&PkgIni, InstalledKey->Name.StartOfString, FileIndexString, &IniValue);
             if (!YoriPkgAddExistingFileToPendingPackages(PendingPackages, &IniValue)) {
-                YoriLibFreeStringContents(&InstalledSection);
+                YoriLibIniCleanup(&PkgIni);
                 YoriLibFreeStringContents(&IniValue);
                 return FALSE;
             }
         }
+
+        InstalledKey = YoriLibIniGetNextKey(InstalledSection, InstalledKey);
     }
 
-    YoriLibFreeStringContents(&InstalledSection);
+    YoriLibIniCleanup(&PkgIni);
     YoriLibFreeStringContents(&IniValue);
 
     return TRUE;
@@ -837,22 +822,16 @@ YoriPkgPreparePackageForInstall(
     YORI_STRING PkgInfoFile;
     YORI_STRING TempPath;
     YORI_STRING ErrorString;
-    YORI_STRING ReplacesList;
     YORI_STRING PkgInstalled;
-    YORI_STRING PkgToReplace;
-    YORI_ALLOC_SIZE_T LineLength;
+    YORI_LIB_INI_DOCUMENT PkgIni;
+    YORI_LIB_INI_DOCUMENT PkgInfoIni;
+    PYORI_LIB_INI_SECTION ReplacesSection;
+    PYORI_LIB_INI_KEY PkgToReplace;
     YORI_MAX_SIGNED_T RequiredBuildNumber;
     YORI_ALLOC_SIZE_T CharsConsumed;
-    LPTSTR ThisLine;
-    LPTSTR Equals;
     PYORIPKG_BACKUP_PACKAGE BackupPackage;
     DWORD Result = ERROR_SUCCESS;
 
-    if (DllKernel32.pGetPrivateProfileSectionW == NULL ||
-        DllKernel32.pGetPrivateProfileStringW == NULL) {
-        return ERROR_PROC_NOT_FOUND;
-    }
-
     if (RedirectToPackageUrl != NULL) {
         YoriLibInitEmptyString(RedirectToPackageUrl);
     }
@@ -874,6 +853,8 @@ YoriPkgPreparePackageForInstall(
 
     YoriLibConstantString(&PkgInfoFile, _T("pkginfo.ini"));
     YoriLibInitEmptyString(&TempPath);
+    ZeroMemory(&PkgIni, sizeof(PkgIni));
+    ZeroMemory(&PkgInfoIni, sizeof(PkgInfoIni));
 
     PendingPackage = YoriLibMalloc(sizeof(YORIPKG_PACKAGE_PENDING_INSTALL));
     if (PendingPackage == NULL) {
@@ -938,18 +919,17 @@ YoriPkgPreparePackageForInstall(
     //  is already present.  If it is, we need to delete it.
     //
 
+    if (!YoriLibIniLoad(&PkgIni, PkgIniFile)) {
+        Result = GetLastError();
+        goto Exit;
+    }
+
     if (!YoriLibAllocateString(&PkgInstalled, YORIPKG_MAX_FIELD_LENGTH)) {
         Result = ERROR_NOT_ENOUGH_MEMORY;
         goto Exit;
     }
 
-    PkgInstalled.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(_T("Installed"),
-                                              PendingPackage->PackageName.StartOfString,
-                                              _T(""),
-                                              PkgInstalled.StartOfString,
-                                              PkgInstalled.LengthAllocated,
-                                              PkgIniFile->StartOfString);
+    YoriLibIniGetString(&PkgIni, _T("Installed"), PendingPackage->PackageName.StartOfString, &PkgInstalled);
 
     //
     //  If the version being installed is already there, we're done.
@@ -997,7 +977,7 @@ YoriPkgPreparePackageForInstall(
             YoriLibFreeStringContents(&PkgInstalled);
             goto Exit;
         }
-        YoriPkgRemoveSystemReferencesToPackage(PkgIniFile, BackupPackage);
+        YoriPkgRemoveSystemReferencesToPackage(&PkgIni, BackupPackage);
         YoriLibAppendList(&PackageList->BackupPackages, &BackupPackage->PackageList);
     }
 
@@ -1006,57 +986,50 @@ YoriPkgPreparePackageForInstall(
     //  them
     //
 
-    if (!YoriLibAllocateString(&ReplacesList, YORIPKG_MAX_SECTION_LENGTH)) {
+    if (!YoriLibIniLoad(&PkgInfoIni, &TempPath)) {
         YoriLibFreeStringContents(&PkgInstalled);
-        Result = ERROR_NOT_ENOUGH_MEMORY;
+        Result = GetLastError();
         goto Exit;
     }
 
-    YoriLibInitEmptyString(&PkgToReplace);
-    ReplacesList.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileSectionW(_T("Replaces"),
-                                               ReplacesList.StartOfString,
-                                               ReplacesList.LengthAllocated,
-                                               TempPath.StartOfString);
-    ThisLine = ReplacesList.StartOfString;
-
-    while (*ThisLine != '\0') {
-        LineLength = (YORI_ALLOC_SIZE_T)_tcslen(ThisLine);
-        PkgToReplace.StartOfString = ThisLine;
-        Equals = _tcschr(ThisLine, '=');
-        if (Equals != NULL) {
-            PkgToReplace.LengthInChars = (YORI_ALLOC_SIZE_T)(Equals - ThisLine);
-        } else {
-            PkgToReplace.LengthInChars = LineLength;
-        }
-        PkgToReplace.StartOfString[PkgToReplace.LengthInChars] = '\0';
+    PkgToReplace = NULL;
+    ReplacesSection = YoriLibIniFindSection(&PkgInfoIni, _T("Replaces"));
+    if (ReplacesSection != NULL) {
+        PkgToReplace = YoriLibIniGetNextKey(ReplacesSection, NULL);
+    }
+
+    while (PkgToReplace != NULL) {
 
         //
         //  Check if the package that the new package wants to replace
-        //  is installed, and if so, back it up too
+        //  is installed, and if so, back it up too.  Packages backed up
+        //  above have already been removed from the in memory INI file, so
+        //  they are not found again here.
         //
 
-        PkgInstalled.LengthInChars = (YORI_ALLOC_SIZE_T)
-            DllKernel32.pGetPrivateProfileStringW(_T("Installed"),
-                                                  PkgToReplace.StartOfString,
-                                                  _T(""),
-                                                  PkgInstalled.StartOfString,
-                                                  PkgInstalled.LengthAllocated,
-                                                  PkgIniFile->StartOfString);
+        ASSERT(YoriLibIsStringNullTerminated(&PkgToReplace->Name));
+        YoriLibIniGetString(&PkgIni, _T("Installed"), PkgToReplace->Name.StartOfString, &PkgInstalled);
         if (PkgInstalled.LengthInChars > 0) {
-            Result = YoriPkgBackupPackage(PkgIniFile, &PkgToReplace, TargetDirectory, &BackupPackage);
+            Result = YoriPkgBackupPackage(PkgIniFile, &PkgToReplace->Name, TargetDirectory, &BackupPackage);
             if (Result != ERROR_SUCCESS) {
-                YoriLibFreeStringContents(&ReplacesList);
+                YoriLibFreeStringContents(&PkgInstalled);
                 goto Exit;
             }
-            YoriPkgRemoveSystemReferencesToPackage(PkgIniFile, BackupPackage);
+            YoriPkgRemoveSystemReferencesToPackage(&PkgIni, BackupPackage);
             YoriLibAppendList(&PackageList->BackupPackages, &BackupPackage->PackageList);
         }
-        ThisLine += LineLength + 1;
+        PkgToReplace = YoriLibIniGetNextKey(ReplacesSection, PkgToReplace);
     }
-    YoriLibFreeStringContents(&ReplacesList);
     YoriLibFreeStringContents(&PkgInstalled);
 
+    //
+    //  Write back the removal of all backed up packages in one pass.
+    //
+
+    YoriLibIniSave(&PkgIni);
+    YoriLibIniCleanup(&PkgIni);
+    YoriLibIniCleanup(&PkgInfoIni);
+
     DeleteFile(TempPath.StartOfString);
     YoriLibFreeStringContents(&TempPath);
 
@@ -1065,6 +1038,16 @@ YoriPkgPreparePackageForInstall(
 
 Exit:
 
+    //
+    //  Any packages which were backed up have been added to the backup list
+    //  and will be restored by the caller, so record their removal now to
+    //  keep the INI file consistent with the files on disk.
+    //
+
+    YoriLibIniSave(&PkgIni);
+    YoriLibIniCleanup(&PkgIni);
+    YoriLibIniCleanup(&PkgInfoIni);
+
     if (TempPath.LengthInChars > 0) {
         DeleteFile(TempPath.StartOfString);
     }
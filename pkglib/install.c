@@ -3,7 +3,7 @@
  *
  * Yori shell install packages
  *
- * Copyright (c) 2018 Malcolm J. Smith
+ * Copyright (c) 2018-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -130,6 +130,7 @@ YoriPkgCheckIfPackageDeleteable(
     YORI_STRING AppPath;
     YORI_STRING IniValue;
     YORI_STRING FileToDelete;
+    YORI_LIB_INI_DOCUMENT PkgIni;
     PYORI_STRING FileBeingDeleted;
     DWORD FileCount;
     DWORD FileIndex;
@@ -137,12 +138,6 @@ YoriPkgCheckIfPackageDeleteable(
     BOOL DeleteResult;
     BOOL BestEffortDelete;
 
-    if (DllKernel32.pGetPrivateProfileIntW == NULL ||
-        DllKernel32.pGetPrivateProfileStringW == NULL) {
-
-        return FALSE;
-    }
-
     if (!YoriLibAllocateString(&IniValue, YORIPKG_MAX_FIELD_LENGTH)) {
         return FALSE;
     }
@@ -161,10 +156,17 @@ YoriPkgCheckIfPackageDeleteable(
         AppPath.LengthInChars = TargetDirectory->LengthInChars;
     }
 
-    BestEffortDelete = DllKernel32.pGetPrivateProfileIntW(PackageName->StartOfString, _T("BestEffortDelete"), 0, PkgIniFile->StartOfString);
+    if (!YoriLibIniLoad(&PkgIni, PkgIniFile)) {
+        YoriLibFreeStringContents(&AppPath);
+        YoriLibFreeStringContents(&IniValue);
+        return FALSE;
+    }
+
+    BestEffortDelete = YoriLibIniGetInt(&PkgIni, PackageName->StartOfString, _T("BestEffortDelete"), 0);
 
-    FileCount = DllKernel32.pGetPrivateProfileIntW(PackageName->StartOfString, _T("FileCount"), 0, PkgIniFile->StartOfString);
+    FileCount = YoriLibIniGetInt(&PkgIni, PackageName->StartOfString, _T("FileCount"), 0);
     if (FileCount == 0) {
+        YoriLibIniCleanup(&PkgIni);
         YoriLibFreeStringContents(&AppPath);
         YoriLibFreeStringContents(&IniValue);
         return FALSE;
@@ -172,6 +174,7 @@ YoriPkgCheckIfPackageDeleteable(
 
     YoriLibInitEmptyString(&FileToDelete);
     if (!YoriLibAllocateString(&FileToDelete, AppPath.LengthInChars + YORIPKG_MAX_FIELD_LENGTH)) {
+        YoriLibIniCleanup(&PkgIni);
         YoriLibFreeStringContents(&AppPath);
         YoriLibFreeStringContents(&IniValue);
         return FALSE;
@@ -180,13 +183,7 @@ YoriPkgCheckIfPackageDeleteable(
     for (FileIndex = 1; FileIndex <= FileCount; FileIndex++) {
         YoriLibSPrintf(FileIndexString, _T("File%i"), FileIndex);
 
-        IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
-            DllKernel32.pGetPrivateProfileStringW(PackageName->StartOfString,
-                                                  FileIndexString,
-                                                  _T(""),
-                                                  IniValue.StartOfString,
-                                                  IniValue.LengthAllocated,
-                                                  PkgIniFile->StartOfString);
+        YoriLibIniGetString(&PkgIni, PackageName->StartOfString, FileIndexString, &IniValue);
         if (IniValue.LengthInChars > 0) {
             if (!YoriLibIsPathPrefixed(&IniValue)) {
                 YoriLibYPrintf(&FileToDelete, _T("%y\\%y"), &AppPath, &IniValue);
@@ -220,6 +217,7 @@ YoriPkgCheckIfPackageDeleteable(
             //
 
             if (!DeleteResult && !BestEffortDelete) {
+                YoriLibIniCleanup(&PkgIni);
                 YoriLibFreeStringContents(&IniValue);
                 YoriLibFreeStringContents(&AppPath);
                 YoriLibFreeStringContents(&FileToDelete);
@@ -228,6 +226,7 @@ YoriPkgCheckIfPackageDeleteable(
         }
     }
 
+    YoriLibIniCleanup(&PkgIni);
     YoriLibFreeStringContents(&IniValue);
     YoriLibFreeStringContents(&AppPath);
     YoriLibFreeStringContents(&FileToDelete);
@@ -344,6 +343,7 @@ YoriPkgDeletePackageInternal(
     YORI_STRING AppPath;
     YORI_STRING IniValue;
     YORI_STRING FileToDelete;
+    YORI_LIB_INI_DOCUMENT PkgIni;
     PYORI_STRING FileBeingDeleted;
     DWORD FileCount;
     DWORD FileIndex;
@@ -351,13 +351,6 @@ YoriPkgDeletePackageInternal(
     DWORD DeleteResult;
     BOOL BestEffortDelete;
 
-    if (DllKernel32.pGetPrivateProfileIntW == NULL ||
-        DllKernel32.pGetPrivateProfileStringW == NULL ||
-        DllKernel32.pWritePrivateProfileStringW == NULL) {
-
-        return ERROR_PROC_NOT_FOUND;
-    }
-
     if (!YoriLibAllocateString(&IniValue, YORIPKG_MAX_FIELD_LENGTH)) {
         return ERROR_NOT_ENOUGH_MEMORY;
     }
@@ -376,10 +369,18 @@ YoriPkgDeletePackageInternal(
         AppPath.LengthInChars = TargetDirectory->LengthInChars;
     }
 
-    BestEffortDelete = DllKernel32.pGetPrivateProfileIntW(PackageName->StartOfString, _T("BestEffortDelete"), 0, PkgIniFile->StartOfString);
+    if (!YoriLibIniLoad(&PkgIni, PkgIniFile)) {
+        DeleteResult = GetLastError();
+        YoriLibFreeStringContents(&AppPath);
+        YoriLibFreeStringContents(&IniValue);
+        return DeleteResult;
+    }
+
+    BestEffortDelete = YoriLibIniGetInt(&PkgIni, PackageName->StartOfString, _T("BestEffortDelete"), 0);
 
-    FileCount = DllKernel32.pGetPrivateProfileIntW(PackageName->StartOfString, _T("FileCount"), 0, PkgIniFile->StartOfString);
+    FileCount = YoriLibIniGetInt(&PkgIni, PackageName->StartOfString, _T("FileCount"), 0);
     if (FileCount == 0) {
+        YoriLibIniCleanup(&PkgIni);
         YoriLibFreeStringContents(&AppPath);
         YoriLibFreeStringContents(&IniValue);
         return ERROR_MOD_NOT_FOUND;
@@ -387,6 +388,7 @@ YoriPkgDeletePackageInternal(
 
     YoriLibInitEmptyString(&FileToDelete);
     if (!YoriLibAllocateString(&FileToDelete, AppPath.LengthInChars + YORIPKG_MAX_FIELD_LENGTH)) {
+        YoriLibIniCleanup(&PkgIni);
         YoriLibFreeStringContents(&AppPath);
         YoriLibFreeStringContents(&IniValue);
         return ERROR_NOT_ENOUGH_MEMORY;
@@ -395,13 +397,7 @@ YoriPkgDeletePackageInternal(
     for (FileIndex = 1; FileIndex <= FileCount; FileIndex++) {
         YoriLibSPrintf(FileIndexString, _T("File%i"), FileIndex);
 
-        IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
-            DllKernel32.pGetPrivateProfileStringW(PackageName->StartOfString,
-                                                  FileIndexString,
-                                                  _T(""),
-                                                  IniValue.StartOfString,
-                                                  IniValue.LengthAllocated,
-                                                  PkgIniFile->StartOfString);
+        YoriLibIniGetString(&PkgIni, PackageName->StartOfString, FileIndexString, &IniValue);
         if (IniValue.LengthInChars > 0) {
             if (!YoriLibIsPathPrefixed(&IniValue)) {
                 YoriLibYPrintf(&FileToDelete, _T("%y\\%y"), &AppPath, &IniValue);
@@ -440,33 +436,34 @@ YoriPkgDeletePackageInternal(
             //
 
             if (DeleteResult != ERROR_SUCCESS && !BestEffortDelete && FileIndex == 1) {
+                YoriLibIniCleanup(&PkgIni);
                 YoriLibFreeStringContents(&IniValue);
                 YoriLibFreeStringContents(&AppPath);
                 YoriLibFreeStringContents(&FileToDelete);
                 return DeleteResult;
             }
         }
-
-        DllKernel32.pWritePrivateProfileStringW(PackageName->StartOfString, FileIndexString, NULL, PkgIniFile->StartOfString);
     }
 
-    DllKernel32.pWritePrivateProfileStringW(PackageName->StartOfString, _T("FileCount"), NULL, PkgIniFile->StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(PackageName->StartOfString, _T("Architecture"), NULL, PkgIniFile->StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(PackageName->StartOfString, _T("UpgradePath"), NULL, PkgIniFile->StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(PackageName->StartOfString, _T("SourcePath"), NULL, PkgIniFile->StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(PackageName->StartOfString, _T("SymbolPath"), NULL, PkgIniFile->StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(PackageName->StartOfString, _T("UpgradeToDailyPath"), NULL, PkgIniFile->StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(PackageName->StartOfString, _T("UpgradeToStablePath"), NULL, PkgIniFile->StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(PackageName->StartOfString, _T("Version"), NULL, PkgIniFile->StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(_T("Installed"), PackageName->StartOfString, NULL, PkgIniFile->StartOfString);
+    //
+    //  Remove the package's section and its entry in the installed list.
+    //  All of the changes are written to the file at once.
+    //
+
+    YoriLibIniDeleteSection(&PkgIni, PackageName->StartOfString);
+    YoriLibIniDeleteKey(&PkgIni, _T("Installed"), PackageName->StartOfString);
 
-    DllKernel32.pWritePrivateProfileStringW(PackageName->StartOfString, NULL, NULL, PkgIniFile->StartOfString);
+    DeleteResult = ERROR_SUCCESS;
+    if (!YoriLibIniSave(&PkgIni)) {
+        DeleteResult = GetLastError();
+    }
 
+    YoriLibIniCleanup(&PkgIni);
     YoriLibFreeStringContents(&IniValue);
     YoriLibFreeStringContents(&AppPath);
     YoriLibFreeStringContents(&FileToDelete);
 
-    return ERROR_SUCCESS;
+    return DeleteResult;
 }
 
 
@@ -482,9 +479,11 @@ typedef struct _YORIPKG_INSTALL_PKG_CONTEXT {
     PYORIPKG_PACKAGES_PENDING_INSTALL PendingPackages;
 
     /**
-     Path to the INI file recording package installation.
+     The INI document recording package installation.  Each file is added
+     to it as it is extracted, and the document is written once the package
+     has been installed.
      */
-    PYORI_STRING IniFileName;
+    PYORI_LIB_INI_DOCUMENT PkgIni;
 
     /**
      The name of the package being installed.
@@ -536,8 +535,6 @@ YoriPkgInstallPackageFileCallback(
     PYORIPKG_INSTALL_PKG_CONTEXT InstallContext = (PYORIPKG_INSTALL_PKG_CONTEXT)Context;
     TCHAR FileIndexString[16];
 
-    ASSERT(DllKernel32.pWritePrivateProfileStringW != NULL);
-
     if (InstallContext->ConflictingFileFound) {
         return FALSE;
     }
@@ -557,10 +554,10 @@ YoriPkgInstallPackageFileCallback(
     InstallContext->NumberFiles++;
     YoriLibSPrintf(FileIndexString, _T("File%i"), InstallContext->NumberFiles);
 
-    DllKernel32.pWritePrivateProfileStringW(InstallContext->PackageName->StartOfString,
-                                            FileIndexString,
-                                            RelativePath->StartOfString,
-                                            InstallContext->IniFileName->StartOfString);
+    YoriLibIniSetString(InstallContext->PkgIni,
+                        InstallContext->PackageName->StartOfString,
+                        FileIndexString,
+                        RelativePath->StartOfString);
     return TRUE;
 }
 
@@ -620,6 +617,7 @@ YoriPkgInstallPackage(
 {
     YORI_STRING PkgInfoFile;
     YORI_STRING PkgIniFile;
+    YORI_LIB_INI_DOCUMENT PkgIni;
     YORI_STRING FullTargetDirectory;
 
     YORI_STRING ErrorString;
@@ -630,18 +628,13 @@ YoriPkgInstallPackage(
     TCHAR FileIndexString[16];
 
     ZeroMemory(&InstallContext, sizeof(InstallContext));
+    ZeroMemory(&PkgIni, sizeof(PkgIni));
 
     YoriLibConstantString(&PkgInfoFile, _T("pkginfo.ini"));
 
     YoriLibInitEmptyString(&FullTargetDirectory);
     YoriLibInitEmptyString(&PkgIniFile);
 
-    if (DllKernel32.pGetPrivateProfileStringW == NULL ||
-        DllKernel32.pWritePrivateProfileStringW == NULL) {
-
-        goto Exit;
-    }
-
     //
     //  Create path to system packages.ini
     //
@@ -651,6 +644,10 @@ YoriPkgInstallPackage(
         goto Exit;
     }
 
+    if (!YoriLibIniLoad(&PkgIni, &PkgIniFile)) {
+        goto Exit;
+    }
+
     if (TargetDirectory != NULL) {
         if (!YoriLibUserToSingleFilePath(TargetDirectory, FALSE, &FullTargetDirectory)) {
             YoriLibInitEmptyString(&FullTargetDirectory);
@@ -678,13 +675,7 @@ YoriPkgInstallPackage(
             goto Exit;
         }
 
-        PkgToDelete.LengthInChars = (YORI_ALLOC_SIZE_T)
-            DllKernel32.pGetPrivateProfileStringW(_T("Installed"),
-                                                  Package->PackageName.StartOfString,
-                                                  _T(""),
-                                                  PkgToDelete.StartOfString,
-                                                  PkgToDelete.LengthAllocated,
-                                                  PkgIniFile.StartOfString);
+        YoriLibIniGetString(&PkgIni, _T("Installed"), Package->PackageName.StartOfString, &PkgToDelete);
 
         //
         //  If the version being installed is already there, we're done.
@@ -712,15 +703,27 @@ YoriPkgInstallPackage(
     //
     //  Before starting, indicate that the package is installed with a
     //  version of zero.  This ensures that if anything goes wrong, an
-    //  upgrade will detect a new version and will retry.
+    //  upgrade will detect a new version and will retry.  This is written
+    //  immediately so it survives if the process does not.  The list of
+    //  files is only written once extraction is complete.
     //
 
-    DllKernel32.pWritePrivateProfileStringW(_T("Installed"), Package->PackageName.StartOfString, _T("0"), PkgIniFile.StartOfString);
+    if (!YoriLibIniSetString(&PkgIni, _T("Installed"), Package->PackageName.StartOfString, _T("0"))) {
+        goto Exit;
+    }
     if (Package->UpgradePath.LengthInChars > 0) {
-        DllKernel32.pWritePrivateProfileStringW(Package->PackageName.StartOfString,
-                                                _T("UpgradePath"),
-                                                Package->UpgradePath.StartOfString,
-                                                PkgIniFile.StartOfString);
+        if (!YoriLibIniSetString(&PkgIni,
+                                 Package->PackageName.StartOfString,
+                                 _T("UpgradePath"),
+                                 Package->UpgradePath.StartOfString)) {
+            goto Exit;
+        }
+    }
+
+    if (!YoriLibIniSave(&PkgIni)) {
+        Error = GetLastError();
+        YoriPkgDisplayErrorStringForInstallFailure(Error);
+        goto Exit;
     }
 
     if (YoriLibGetWofVersionAvailable(&FullTargetDirectory)) {
@@ -740,7 +743,7 @@ YoriPkgInstallPackage(
     //
 
     InstallContext.PendingPackages = PendingPackages;
-    InstallContext.IniFileName = &PkgIniFile;
+    InstallContext.PkgIni = &PkgIni;
     InstallContext.PackageName = &Package->PackageName;
     InstallContext.NumberFiles = 0;
     InstallContext.ConflictingFileFound = FALSE;
@@ -762,7 +765,8 @@ YoriPkgInstallPackage(
         //  Mark the package as not requiring upgrade
         //
 
-        DllKernel32.pWritePrivateProfileStringW(_T("Installed"), Package->PackageName.StartOfString, NULL, PkgIniFile.StartOfString);
+        YoriLibIniDeleteKey(&PkgIni, _T("Installed"), Package->PackageName.StartOfString);
+        YoriLibIniSave(&PkgIni);
 
         //
         //  Remove any trailing newlines in the returned error string
@@ -789,44 +793,66 @@ YoriPkgInstallPackage(
     }
 
     if (InstallContext.ConflictingFileFound) {
-        DllKernel32.pWritePrivateProfileStringW(_T("Installed"), Package->PackageName.StartOfString, NULL, PkgIniFile.StartOfString);
+        YoriLibIniDeleteKey(&PkgIni, _T("Installed"), Package->PackageName.StartOfString);
+        YoriLibIniSave(&PkgIni);
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Install aborted due to file conflict\n"));
         goto Exit;
     }
 
-    DllKernel32.pWritePrivateProfileStringW(Package->PackageName.StartOfString, _T("Version"), Package->Version.StartOfString, PkgIniFile.StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(Package->PackageName.StartOfString, _T("Architecture"), Package->Architecture.StartOfString, PkgIniFile.StartOfString);
+    YoriLibSPrintf(FileIndexString, _T("%i"), InstallContext.NumberFiles);
+
+    if (!YoriLibIniSetString(&PkgIni, Package->PackageName.StartOfString, _T("Version"), Package->Version.StartOfString) ||
+        !YoriLibIniSetString(&PkgIni, Package->PackageName.StartOfString, _T("Architecture"), Package->Architecture.StartOfString)) {
+        goto Exit;
+    }
     if (Package->UpgradePath.LengthInChars > 0) {
-        DllKernel32.pWritePrivateProfileStringW(Package->PackageName.StartOfString, _T("UpgradePath"), Package->UpgradePath.StartOfString, PkgIniFile.StartOfString);
+        if (!YoriLibIniSetString(&PkgIni, Package->PackageName.StartOfString, _T("UpgradePath"), Package->UpgradePath.StartOfString)) {
+            goto Exit;
+        }
     }
     if (Package->SourcePath.LengthInChars > 0) {
-        DllKernel32.pWritePrivateProfileStringW(Package->PackageName.StartOfString, _T("SourcePath"), Package->SourcePath.StartOfString, PkgIniFile.StartOfString);
+        if (!YoriLibIniSetString(&PkgIni, Package->PackageName.StartOfString, _T("SourcePath"), Package->SourcePath.StartOfString)) {
+            goto Exit;
+        }
     }
     if (Package->SymbolPath.LengthInChars > 0) {
-        DllKernel32.pWritePrivateProfileStringW(Package->PackageName.StartOfString, _T("SymbolPath"), Package->SymbolPath.StartOfString, PkgIniFile.StartOfString);
+        if (!YoriLibIniSetString(&PkgIni, Package->PackageName.StartOfString, _T("SymbolPath"), Package->SymbolPath.StartOfString)) {
+            goto Exit;
+        }
     }
     if (Package->UpgradeToDailyPath.LengthInChars > 0) {
-        DllKernel32.pWritePrivateProfileStringW(Package->PackageName.StartOfString,
-                                                _T("UpgradeToDailyPath"),
-                                                Package->UpgradeToDailyPath.StartOfString,
-                                                PkgIniFile.StartOfString);
+        if (!YoriLibIniSetString(&PkgIni,
+                                 Package->PackageName.StartOfString,
+                                 _T("UpgradeToDailyPath"),
+                                 Package->UpgradeToDailyPath.StartOfString)) {
+            goto Exit;
+        }
     }
 
     if (Package->UpgradeToStablePath.LengthInChars > 0) {
-        DllKernel32.pWritePrivateProfileStringW(Package->PackageName.StartOfString,
-                                                _T("UpgradeToStablePath"),
-                                                Package->UpgradeToStablePath.StartOfString,
-                                                PkgIniFile.StartOfString);
+        if (!YoriLibIniSetString(&PkgIni,
+                                 Package->PackageName.StartOfString,
+                                 _T("UpgradeToStablePath"),
+                                 Package->UpgradeToStablePath.StartOfString)) {
+            goto Exit;
+        }
     }
 
-    YoriLibSPrintf(FileIndexString, _T("%i"), InstallContext.NumberFiles);
+    if (!YoriLibIniSetString(&PkgIni, Package->PackageName.StartOfString, _T("FileCount"), FileIndexString) ||
+        !YoriLibIniSetString(&PkgIni, _T("Installed"), Package->PackageName.StartOfString, Package->Version.StartOfString)) {
+        goto Exit;
+    }
 
-    DllKernel32.pWritePrivateProfileStringW(Package->PackageName.StartOfString, _T("FileCount"), FileIndexString, PkgIniFile.StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(_T("Installed"), Package->PackageName.StartOfString, Package->Version.StartOfString, PkgIniFile.StartOfString);
+    if (!YoriLibIniSave(&PkgIni)) {
+        Error = GetLastError();
+        YoriPkgDisplayErrorStringForInstallFailure(Error);
+        goto Exit;
+    }
 
     Result = TRUE;
 
 Exit:
+    YoriLibIniCleanup(&PkgIni);
     YoriLibFreeStringContents(&PkgIniFile);
     YoriLibFreeStringContents(&FullTargetDirectory);
     if (InstallContext.CompressFiles) {
@@ -846,7 +872,8 @@ Exit:
 
  @param NewArchitecture The new architecture to apply.
 
- @param PkgIniFile Path to the system global store of installed packages.
+ @param PkgIni Pointer to the loaded system global store of installed
+        packages.
 
  @param UpgradePath On input, refers to a fully qualified upgrade path for
         the package.  On successful completion, this is updated to contain
@@ -862,28 +889,18 @@ BOOL
 YoriPkgBuildUpgradeLocationForNewArchitecture(
     __in PYORI_STRING PackageName,
     __in PYORI_STRING NewArchitecture,
-    __in PYORI_STRING PkgIniFile,
+    __in PYORI_LIB_INI_DOCUMENT PkgIni,
     __inout PYORI_STRING UpgradePath
     )
 {
     YORI_STRING IniValue;
     YORI_STRING ExistingArchAndExtension;
 
-    if (DllKernel32.pGetPrivateProfileStringW == NULL) {
-        return FALSE;
-    }
-
     if (!YoriLibAllocateString(&IniValue, YORIPKG_MAX_FIELD_LENGTH)) {
         return FALSE;
     }
 
-    IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(PackageName->StartOfString,
-                                              _T("Architecture"),
-                                              _T(""),
-                                              IniValue.StartOfString,
-                                              IniValue.LengthAllocated,
-                                              PkgIniFile->StartOfString);
+    YoriLibIniGetString(PkgIni, PackageName->StartOfString, _T("Architecture"), &IniValue);
     if (IniValue.LengthInChars == 0) {
         YoriLibFreeStringContents(&IniValue);
         return FALSE;
@@ -3,7 +3,7 @@
  *
  * Yori package manager remote source query and search
  *
- * Copyright (c) 2018-2019 Malcolm J. Smith
+ * Copyright (c) 2018-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -353,7 +353,7 @@ YoriPkgFreeRemotePackage(
  local packages.ini file or it might be a pkglist.ini file on a remote source
  (ie., remote sources can refer to other remote sources.)
 
- @param IniPath Pointer to the local copy of the INI file.
+ @param Ini Pointer to an in memory copy of the INI file.
 
  @param SourcesList Pointer to the list of sources which can be updated with
         newly found sources.
@@ -362,7 +362,7 @@ YoriPkgFreeRemotePackage(
  */
 BOOL
 YoriPkgCollectSourcesFromIni(
-    __in PCYORI_STRING IniPath,
+    __in PYORI_LIB_INI_DOCUMENT Ini,
     __inout_opt PYORI_LIST_ENTRY SourcesList
     )
 {
@@ -378,10 +378,6 @@ YoriPkgCollectSourcesFromIni(
     YoriLibInitEmptyString(&IniValue);
     YoriLibInitEmptyString(&IniKey);
 
-    if (DllKernel32.pGetPrivateProfileStringW == NULL) {
-        goto Exit;
-    }
-
     if (!YoriLibAllocateString(&IniValue, YORIPKG_MAX_FIELD_LENGTH)) {
         goto Exit;
     }
@@ -394,13 +390,7 @@ YoriPkgCollectSourcesFromIni(
         Index = 1;
         while (TRUE) {
             IniKey.LengthInChars = YoriLibSPrintf(IniKey.StartOfString, _T("Source%i"), Index);
-            IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
-                DllKernel32.pGetPrivateProfileStringW(_T("Sources"),
-                                                      IniKey.StartOfString,
-                                                      _T(""),
-                                                      IniValue.StartOfString,
-                                                      IniValue.LengthAllocated,
-                                                      IniPath->StartOfString);
+            YoriLibIniGetString(Ini, _T("Sources"), IniKey.StartOfString, &IniValue);
             if (IniValue.LengthInChars == 0) {
                 break;
             }
@@ -462,7 +452,12 @@ YoriPkgCollectSourcesFromIniWithDefaults(
     )
 {
     PYORIPKG_REMOTE_SOURCE Source;
-    YoriPkgCollectSourcesFromIni(PackagesIni, SourcesList);
+    YORI_LIB_INI_DOCUMENT Ini;
+
+    if (YoriLibIniLoad(&Ini, PackagesIni)) {
+        YoriPkgCollectSourcesFromIni(&Ini, SourcesList);
+    }
+    YoriLibIniCleanup(&Ini);
 
     //
     //  If the INI file provides no place to search, default to malsmith.net
@@ -519,16 +514,16 @@ YoriPkgCollectPackagesFromSource(
     )
 {
     YORI_STRING LocalPath;
-    YORI_STRING ProvidesSection;
-    YORI_STRING PkgNameOnly;
+    YORI_LIB_INI_DOCUMENT PkgList;
+    PYORI_LIB_INI_SECTION ProvidesSection;
+    PYORI_LIB_INI_KEY ProvidesKey;
+    PYORI_STRING PkgNameOnly;
     YORI_STRING PkgVersion;
     YORI_STRING IniValue;
     YORI_STRING Architecture;
     YORI_STRING MinimumOSBuild;
     YORI_STRING PackagePathForOlderBuilds;
     BOOLEAN DeleteWhenFinished = FALSE;
-    LPTSTR ThisLine;
-    LPTSTR Equals;
     LPTSTR KnownArchitectures[] = {_T("noarch"),
                                    _T("win32"),
                                    _T("mips"),
@@ -546,18 +541,11 @@ YoriPkgCollectPackagesFromSource(
     DWORD Result;
 
     YoriLibInitEmptyString(&LocalPath);
-    YoriLibInitEmptyString(&ProvidesSection);
     YoriLibInitEmptyString(&IniValue);
     YoriLibInitEmptyString(&PkgVersion);
     YoriLibInitEmptyString(&MinimumOSBuild);
     YoriLibInitEmptyString(&PackagePathForOlderBuilds);
-
-    if (DllKernel32.pGetPrivateProfileSectionW == NULL) {
-        Result = FALSE;
-        YoriLibInitEmptyString(&LocalPath);
-        DeleteWhenFinished = FALSE;
-        goto Exit;
-    }
+    ZeroMemory(&PkgList, sizeof(PkgList));
 
     Result = YoriPkgPackagePathToLocalPath(&Source->SourcePkgList, PackagesIni, &LocalPath, &DeleteWhenFinished);
     if (Result != ERROR_SUCCESS) {
@@ -566,11 +554,6 @@ YoriPkgCollectPackagesFromSource(
         goto Exit;
     }
 
-    if (!YoriLibAllocateString(&ProvidesSection, YORIPKG_MAX_SECTION_LENGTH)) {
-        Result = ERROR_NOT_ENOUGH_MEMORY;
-        goto Exit;
-    }
-
     if (!YoriLibAllocateString(&PkgVersion, YORIPKG_MAX_SECTION_LENGTH)) {
         Result = ERROR_NOT_ENOUGH_MEMORY;
         goto Exit;
@@ -591,47 +574,33 @@ YoriPkgCollectPackagesFromSource(
         goto Exit;
     }
 
-    ProvidesSection.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileSectionW(_T("Provides"),
-                                               ProvidesSection.StartOfString,
-                                               ProvidesSection.LengthAllocated,
-                                               LocalPath.StartOfString);
-
-    YoriLibInitEmptyString(&PkgNameOnly);
-    ThisLine = ProvidesSection.StartOfString;
+    //
+    //  A source can provide many packages, each with several keys per
+    //  architecture, so parse the package list once and query it from
+    //  memory.
+    //
 
-    while (*ThisLine != '\0') {
-        PkgNameOnly.StartOfString = ThisLine;
-        Equals = _tcschr(ThisLine, '=');
-        if (Equals != NULL) {
-            PkgNameOnly.LengthInChars = (YORI_ALLOC_SIZE_T)(Equals - ThisLine);
-        } else {
-            PkgNameOnly.LengthInChars = (YORI_ALLOC_SIZE_T)_tcslen(ThisLine);
-        }
+    if (!YoriLibIniLoad(&PkgList, &LocalPath)) {
+        Result = GetLastError();
+        goto Exit;
+    }
 
-        ThisLine += _tcslen(ThisLine);
-        ThisLine++;
+    ProvidesKey = NULL;
+    ProvidesSection = YoriLibIniFindSection(&PkgList, _T("Provides"));
+    if (ProvidesSection != NULL) {
+        ProvidesKey = YoriLibIniGetNextKey(ProvidesSection, NULL);
+    }
 
-        PkgNameOnly.StartOfString[PkgNameOnly.LengthInChars] = '\0';
+    while (ProvidesKey != NULL) {
+        PkgNameOnly = &ProvidesKey->Name;
+        ASSERT(YoriLibIsStringNullTerminated(PkgNameOnly));
 
-        PkgVersion.LengthInChars = (YORI_ALLOC_SIZE_T)
-            DllKernel32.pGetPrivateProfileStringW(PkgNameOnly.StartOfString,
-                                                  _T("Version"),
-                                                  _T(""),
-                                                  PkgVersion.StartOfString,
-                                                  PkgVersion.LengthAllocated,
-                                                  LocalPath.StartOfString);
+        YoriLibIniGetString(&PkgList, PkgNameOnly->StartOfString, _T("Version"), &PkgVersion);
 
         if (PkgVersion.LengthInChars > 0) {
             for (ArchIndex = 0; ArchIndex < sizeof(KnownArchitectures)/sizeof(KnownArchitectures[0]); ArchIndex++) {
                 YoriLibConstantString(&Architecture, KnownArchitectures[ArchIndex]);
-                IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
-                    DllKernel32.pGetPrivateProfileStringW(PkgNameOnly.StartOfString,
-                                                          Architecture.StartOfString,
-                                                          _T(""),
-                                                          IniValue.StartOfString,
-                                                          IniValue.LengthAllocated,
-                                                          LocalPath.StartOfString);
+                YoriLibIniGetString(&PkgList, PkgNameOnly->StartOfString, Architecture.StartOfString, &IniValue);
                 if (IniValue.LengthInChars > 0) {
                     PYORIPKG_REMOTE_PACKAGE Package;
 
@@ -639,25 +608,13 @@ YoriPkgCollectPackagesFromSource(
 
                     YoriLibSPrintf(IniKey, _T("%y.minimumosbuild"), &Architecture);
 
-                    MinimumOSBuild.LengthInChars = (YORI_ALLOC_SIZE_T)
-                        DllKernel32.pGetPrivateProfileStringW(PkgNameOnly.StartOfString,
-                                                              IniKey,
-                                                              _T(""),
-                                                              MinimumOSBuild.StartOfString,
-                                                              MinimumOSBuild.LengthAllocated,
-                                                              LocalPath.StartOfString);
+                    YoriLibIniGetString(&PkgList, PkgNameOnly->StartOfString, IniKey, &MinimumOSBuild);
                     if (MinimumOSBuild.LengthInChars > 0) {
                         YoriLibSPrintf(IniKey, _T("%y.packagepathforolderbuilds"), &Architecture);
-                        PackagePathForOlderBuilds.LengthInChars = (YORI_ALLOC_SIZE_T)
-                            DllKernel32.pGetPrivateProfileStringW(PkgNameOnly.StartOfString,
-                                                                  IniKey,
-                                                                  _T(""),
-                                                                  PackagePathForOlderBuilds.StartOfString,
-                                                                  PackagePathForOlderBuilds.LengthAllocated,
-                                                                  LocalPath.StartOfString);
+                        YoriLibIniGetString(&PkgList, PkgNameOnly->StartOfString, IniKey, &PackagePathForOlderBuilds);
                     }
 
-                    Package = YoriPkgAllocateRemotePackage(&PkgNameOnly,
+                    Package = YoriPkgAllocateRemotePackage(PkgNameOnly,
                                                            &PkgVersion,
                                                            &Architecture,
                                                            &MinimumOSBuild,
@@ -670,9 +627,11 @@ YoriPkgCollectPackagesFromSource(
                 }
             }
         }
+
+        ProvidesKey = YoriLibIniGetNextKey(ProvidesSection, ProvidesKey);
     }
 
-    if (!YoriPkgCollectSourcesFromIni(&LocalPath, SourcesList)) {
+    if (!YoriPkgCollectSourcesFromIni(&PkgList, SourcesList)) {
         Result = ERROR_NOT_ENOUGH_MEMORY;
         goto Exit;
     }
@@ -682,7 +641,7 @@ Exit:
         DeleteFile(LocalPath.StartOfString);
     }
     YoriLibFreeStringContents(&LocalPath);
-    YoriLibFreeStringContents(&ProvidesSection);
+    YoriLibIniCleanup(&PkgList);
     YoriLibFreeStringContents(&IniValue);
     YoriLibFreeStringContents(&PkgVersion);
     YoriLibFreeStringContents(&MinimumOSBuild);
@@ -925,13 +884,11 @@ YoriPkgDownloadRemotePackages(
     YORI_STRING FullFinalName;
     YORI_STRING TempLocalPath;
     YORI_STRING PackagesIni;
+    YORI_LIB_INI_DOCUMENT PkgList;
     YORI_ALLOC_SIZE_T Index;
     DWORD Err;
     BOOLEAN DeleteWhenFinished;
-
-    if (DllKernel32.pWritePrivateProfileStringW == NULL) {
-        return FALSE;
-    }
+    BOOL Result;
 
     YoriPkgCollectAllSourcesAndPackages(Source, NULL, &SourcesList, &PackageList);
 
@@ -942,6 +899,18 @@ YoriPkgDownloadRemotePackages(
         return FALSE;
     }
 
+    //
+    //  Entries for every package are accumulated in memory and the package
+    //  list is written once all packages have been downloaded.
+    //
+
+    if (!YoriLibIniLoad(&PkgList, &PackagesIni)) {
+        YoriLibIniCleanup(&PkgList);
+        YoriPkgFreeAllSourcesAndPackages(&SourcesList, &PackageList);
+        YoriLibFreeStringContents(&PackagesIni);
+        return FALSE;
+    }
+
     //
     //  Download the packages we found.
     //
@@ -1002,27 +971,27 @@ YoriPkgDownloadRemotePackages(
 
             if (Err == ERROR_SUCCESS) {
                 YORI_STRING TempKeyString;
-                DllKernel32.pWritePrivateProfileStringW(_T("Provides"),
-                                                        Package->PackageName.StartOfString,
-                                                        Package->Version.StartOfString,
-                                                        PackagesIni.StartOfString);
-                DllKernel32.pWritePrivateProfileStringW(Package->PackageName.StartOfString,
-                                                        _T("Version"),
-                                                        Package->Version.StartOfString,
-                                                        PackagesIni.StartOfString);
-                DllKernel32.pWritePrivateProfileStringW(Package->PackageName.StartOfString,
-                                                        Package->Architecture.StartOfString,
-                                                        FinalFileName.StartOfString,
-                                                        PackagesIni.StartOfString);
+                YoriLibIniSetString(&PkgList,
+                                    _T("Provides"),
+                                    Package->PackageName.StartOfString,
+                                    Package->Version.StartOfString);
+                YoriLibIniSetString(&PkgList,
+                                    Package->PackageName.StartOfString,
+                                    _T("Version"),
+                                    Package->Version.StartOfString);
+                YoriLibIniSetString(&PkgList,
+                                    Package->PackageName.StartOfString,
+                                    Package->Architecture.StartOfString,
+                                    FinalFileName.StartOfString);
 
                 if (Package->MinimumOSBuild.LengthInChars != 0) {
                     YoriLibInitEmptyString(&TempKeyString);
                     YoriLibYPrintf(&TempKeyString, _T("%y.minimumosbuild"), &Package->Architecture);
                     if (TempKeyString.LengthInChars > 0) {
-                        DllKernel32.pWritePrivateProfileStringW(Package->PackageName.StartOfString,
-                                                                TempKeyString.StartOfString,
-                                                                Package->MinimumOSBuild.StartOfString,
-                                                                PackagesIni.StartOfString);
+                        YoriLibIniSetString(&PkgList,
+                                            Package->PackageName.StartOfString,
+                                            TempKeyString.StartOfString,
+                                            Package->MinimumOSBuild.StartOfString);
                         YoriLibFreeStringContents(&TempKeyString);
                     }
 
@@ -1032,10 +1001,10 @@ YoriPkgDownloadRemotePackages(
                     YoriLibInitEmptyString(&TempKeyString);
                     YoriLibYPrintf(&TempKeyString, _T("%y.packagepathforolderbuilds"), &Package->Architecture);
                     if (TempKeyString.LengthInChars > 0) {
-                        DllKernel32.pWritePrivateProfileStringW(Package->PackageName.StartOfString,
-                                                                TempKeyString.StartOfString,
-                                                                Package->PackagePathForOlderBuilds.StartOfString,
-                                                                PackagesIni.StartOfString);
+                        YoriLibIniSetString(&PkgList,
+                                            Package->PackageName.StartOfString,
+                                            TempKeyString.StartOfString,
+                                            Package->PackagePathForOlderBuilds.StartOfString);
                         YoriLibFreeStringContents(&TempKeyString);
                     }
 
@@ -1055,10 +1024,17 @@ YoriPkgDownloadRemotePackages(
         PackageEntry = YoriLibGetNextListEntry(&PackageList, PackageEntry);
     }
 
+    Result = YoriLibIniSave(&PkgList);
+    if (!Result) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Error saving %y: "), &PackagesIni);
+        YoriPkgDisplayErrorStringForInstallFailure(GetLastError());
+    }
+
+    YoriLibIniCleanup(&PkgList);
     YoriPkgFreeAllSourcesAndPackages(&SourcesList, &PackageList);
     YoriLibFreeStringContents(&PackagesIni);
 
-    return TRUE;
+    return Result;
 }
 
 /**
@@ -1815,6 +1791,55 @@ YoriPkgDisplaySources(VOID)
     return TRUE;
 }
 
+/**
+ Replace the Sources section of packages.ini with a list of sources.  The
+ file is rewritten once after all sources have been added.
+
+ @param IniFilePath Pointer to the path to the packages.ini file.
+
+ @param SourcesList Pointer to the list of sources to write.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriPkgWriteSourcesToIni(
+    __in PYORI_STRING IniFilePath,
+    __in PYORI_LIST_ENTRY SourcesList
+    )
+{
+    YORI_LIB_INI_DOCUMENT PkgIni;
+    PYORI_LIST_ENTRY SourceEntry;
+    PYORIPKG_REMOTE_SOURCE Source;
+    TCHAR IniKey[16];
+    DWORD Index;
+    BOOL Result;
+
+    if (!YoriLibIniLoad(&PkgIni, IniFilePath)) {
+        YoriLibIniCleanup(&PkgIni);
+        return FALSE;
+    }
+
+    YoriLibIniDeleteSection(&PkgIni, _T("Sources"));
+    SourceEntry = NULL;
+    Index = 1;
+    SourceEntry = YoriLibGetNextListEntry(SourcesList, SourceEntry);
+    while (SourceEntry != NULL) {
+        Source = CONTAINING_RECORD(SourceEntry, YORIPKG_REMOTE_SOURCE, SourceList);
+        SourceEntry = YoriLibGetNextListEntry(SourcesList, SourceEntry);
+        YoriLibSPrintf(IniKey, _T("Source%i"), Index);
+        if (!YoriLibIniSetString(&PkgIni, _T("Sources"), IniKey, Source->SourceRootUrl.StartOfString)) {
+            YoriLibIniCleanup(&PkgIni);
+            return FALSE;
+        }
+        Index++;
+    }
+
+    Result = YoriLibIniSave(&PkgIni);
+    YoriLibIniCleanup(&PkgIni);
+    return Result;
+}
+
 /**
  Install a new remote source and add it to packages.ini
 
@@ -1836,15 +1861,10 @@ YoriPkgAddNewSource(
     PYORIPKG_REMOTE_SOURCE Source;
     BOOLEAN DefaultsUsed;
     YORI_STRING PackagesIni;
-    DWORD Index;
-    YORI_STRING IniKey;
+    BOOL Result;
 
     YoriLibInitializeListHead(&SourcesList);
 
-    if (DllKernel32.pWritePrivateProfileStringW == NULL) {
-        return FALSE;
-    }
-
     if (!YoriPkgGetPackageIniFile(NULL, &PackagesIni)) {
         return FALSE;
     }
@@ -1884,28 +1904,12 @@ YoriPkgAddNewSource(
     //  Delete the existing sources section and write the new list
     //
 
-    if (!YoriLibAllocateString(&IniKey, YORIPKG_MAX_FIELD_LENGTH)) {
-        YoriPkgFreeAllSourcesAndPackages(&SourcesList, NULL);
-        YoriLibFreeStringContents(&PackagesIni);
-        return FALSE;
-    }
-    DllKernel32.pWritePrivateProfileStringW(_T("Sources"), NULL, NULL, PackagesIni.StartOfString);
-    SourceEntry = NULL;
-    Index = 1;
-    SourceEntry = YoriLibGetNextListEntry(&SourcesList, SourceEntry);
-    while (SourceEntry != NULL) {
-        Source = CONTAINING_RECORD(SourceEntry, YORIPKG_REMOTE_SOURCE, SourceList);
-        SourceEntry = YoriLibGetNextListEntry(&SourcesList, SourceEntry);
-        IniKey.LengthInChars = YoriLibSPrintf(IniKey.StartOfString, _T("Source%i"), Index);
-        DllKernel32.pWritePrivateProfileStringW(_T("Sources"), IniKey.StartOfString, Source->SourceRootUrl.StartOfString, PackagesIni.StartOfString);
-        Index++;
-    }
+    Result = YoriPkgWriteSourcesToIni(&PackagesIni, &SourcesList);
 
-    YoriLibFreeStringContents(&IniKey);
     YoriPkgFreeAllSourcesAndPackages(&SourcesList, NULL);
     YoriLibFreeStringContents(&PackagesIni);
 
-    return TRUE;
+    return Result;
 }
 
 /**
@@ -1925,8 +1929,7 @@ YoriPkgDeleteSource(
     PYORIPKG_REMOTE_SOURCE Source;
     BOOLEAN DefaultsUsed;
     YORI_STRING PackagesIni;
-    DWORD Index;
-    YORI_STRING IniKey;
+    BOOL Result;
 
     YoriLibInitializeListHead(&SourcesList);
 
@@ -1958,31 +1961,12 @@ YoriPkgDeleteSource(
     //  Delete the existing sources section and write the new list
     //
 
-    if (!YoriLibAllocateString(&IniKey, YORIPKG_MAX_FIELD_LENGTH)) {
-        YoriPkgFreeAllSourcesAndPackages(&SourcesList, NULL);
-        YoriLibFreeStringContents(&PackagesIni);
-        return FALSE;
-    }
-    DllKernel32.pWritePrivateProfileStringW(_T("Sources"), NULL, NULL, PackagesIni.StartOfString);
-    SourceEntry = NULL;
-    Index = 1;
-    SourceEntry = YoriLibGetNextListEntry(&SourcesList, SourceEntry);
-    while (SourceEntry != NULL) {
-        Source = CONTAINING_RECORD(SourceEntry, YORIPKG_REMOTE_SOURCE, SourceList);
-        SourceEntry = YoriLibGetNextListEntry(&SourcesList, SourceEntry);
-        IniKey.LengthInChars = YoriLibSPrintf(IniKey.StartOfString, _T("Source%i"), Index);
-        DllKernel32.pWritePrivateProfileStringW(_T("Sources"),
-                                                IniKey.StartOfString,
-                                                Source->SourceRootUrl.StartOfString,
-                                                PackagesIni.StartOfString);
-        Index++;
-    }
+    Result = YoriPkgWriteSourcesToIni(&PackagesIni, &SourcesList);
 
-    YoriLibFreeStringContents(&IniKey);
     YoriPkgFreeAllSourcesAndPackages(&SourcesList, NULL);
     YoriLibFreeStringContents(&PackagesIni);
 
-    return TRUE;
+    return Result;
 }
 
 // vim:sw=4:ts=4:et:
@@ -3,7 +3,7 @@
  *
  * Yori package manager helper functions
  *
- * Copyright (c) 2018-2021 Malcolm J. Smith
+ * Copyright (c) 2018-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -197,136 +197,80 @@ YoriPkgGetPackageInfo(
     __out PYORI_STRING UpgradeToStablePath
     )
 {
+    YORI_LIB_INI_DOCUMENT Ini;
     YORI_STRING TempBuffer;
     YORI_ALLOC_SIZE_T MaxFieldSize = YORIPKG_MAX_FIELD_LENGTH;
 
-    if (DllKernel32.pGetPrivateProfileStringW == NULL) {
+    if (!YoriLibAllocateString(&TempBuffer, 10 * MaxFieldSize)) {
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&TempBuffer, 10 * MaxFieldSize)) {
+    if (!YoriLibIniLoad(&Ini, IniPath)) {
+        YoriLibIniCleanup(&Ini);
+        YoriLibFreeStringContents(&TempBuffer);
         return FALSE;
     }
 
     YoriLibCloneString(PackageName, &TempBuffer);
     PackageName->LengthAllocated = MaxFieldSize;
 
-    PackageName->LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(_T("Package"),
-                                              _T("Name"),
-                                              _T(""),
-                                              PackageName->StartOfString,
-                                              PackageName->LengthAllocated,
-                                              IniPath->StartOfString);
+    YoriLibIniGetString(&Ini, _T("Package"), _T("Name"), PackageName);
 
     YoriLibCloneString(PackageVersion, &TempBuffer);
     PackageVersion->StartOfString += 1 * MaxFieldSize;
     PackageVersion->LengthAllocated = MaxFieldSize;
 
-    PackageVersion->LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(_T("Package"),
-                                              _T("Version"),
-                                              _T(""),
-                                              PackageVersion->StartOfString,
-                                              PackageVersion->LengthAllocated,
-                                              IniPath->StartOfString);
+    YoriLibIniGetString(&Ini, _T("Package"), _T("Version"), PackageVersion);
 
     YoriLibCloneString(PackageArch, &TempBuffer);
     PackageArch->StartOfString += 2 * MaxFieldSize;
     PackageArch->LengthAllocated = MaxFieldSize;
 
-    PackageArch->LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(_T("Package"),
-                                              _T("Architecture"),
-                                              _T(""),
-                                              PackageArch->StartOfString,
-                                              PackageArch->LengthAllocated,
-                                              IniPath->StartOfString);
+    YoriLibIniGetString(&Ini, _T("Package"), _T("Architecture"), PackageArch);
 
     YoriLibCloneString(MinimumOSBuild, &TempBuffer);
     MinimumOSBuild->StartOfString += 3 * MaxFieldSize;
     MinimumOSBuild->LengthAllocated = MaxFieldSize;
 
-    MinimumOSBuild->LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(_T("Package"),
-                                              _T("MinimumOSBuild"),
-                                              _T(""),
-                                              MinimumOSBuild->StartOfString,
-                                              MinimumOSBuild->LengthAllocated,
-                                              IniPath->StartOfString);
+    YoriLibIniGetString(&Ini, _T("Package"), _T("MinimumOSBuild"), MinimumOSBuild);
 
     YoriLibCloneString(PackagePathForOlderBuilds, &TempBuffer);
     PackagePathForOlderBuilds->StartOfString += 4 * MaxFieldSize;
     PackagePathForOlderBuilds->LengthAllocated = MaxFieldSize;
 
-    PackagePathForOlderBuilds->LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(_T("Package"),
-                                              _T("PackagePathForOlderBuilds"),
-                                              _T(""),
-                                              PackagePathForOlderBuilds->StartOfString,
-                                              PackagePathForOlderBuilds->LengthAllocated,
-                                              IniPath->StartOfString);
+    YoriLibIniGetString(&Ini, _T("Package"), _T("PackagePathForOlderBuilds"), PackagePathForOlderBuilds);
 
     YoriLibCloneString(UpgradePath, &TempBuffer);
     UpgradePath->StartOfString += 5 * MaxFieldSize;
     UpgradePath->LengthAllocated = MaxFieldSize;
 
-    UpgradePath->LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(_T("Package"),
-                                              _T("UpgradePath"),
-                                              _T(""),
-                                              UpgradePath->StartOfString,
-                                              UpgradePath->LengthAllocated,
-                                              IniPath->StartOfString);
+    YoriLibIniGetString(&Ini, _T("Package"), _T("UpgradePath"), UpgradePath);
 
     YoriLibCloneString(SourcePath, &TempBuffer);
     SourcePath->StartOfString += 6 * MaxFieldSize;
     SourcePath->LengthAllocated = MaxFieldSize;
 
-    SourcePath->LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(_T("Package"),
-                                              _T("SourcePath"),
-                                              _T(""),
-                                              SourcePath->StartOfString,
-                                              SourcePath->LengthAllocated,
-                                              IniPath->StartOfString);
+    YoriLibIniGetString(&Ini, _T("Package"), _T("SourcePath"), SourcePath);
 
     YoriLibCloneString(SymbolPath, &TempBuffer);
     SymbolPath->StartOfString += 7 * MaxFieldSize;
     SymbolPath->LengthAllocated = MaxFieldSize;
 
-    SymbolPath->LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(_T("Package"),
-                                              _T("SymbolPath"),
-                                              _T(""),
-                                              SymbolPath->StartOfString,
-                                              SymbolPath->LengthAllocated,
-                                              IniPath->StartOfString);
+    YoriLibIniGetString(&Ini, _T("Package"), _T("SymbolPath"), SymbolPath);
 
     YoriLibCloneString(UpgradeToDailyPath, &TempBuffer);
     UpgradeToDailyPath->StartOfString += 8 * MaxFieldSize;
     UpgradeToDailyPath->LengthAllocated = MaxFieldSize;
 
-    UpgradeToDailyPath->LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(_T("Package"),
-                                              _T("UpgradeToDailyPath"),
-                                              _T(""),
-                                              UpgradeToDailyPath->StartOfString,
-                                              UpgradeToDailyPath->LengthAllocated,
-                                              IniPath->StartOfString);
+    YoriLibIniGetString(&Ini, _T("Package"), _T("UpgradeToDailyPath"), UpgradeToDailyPath);
 
     YoriLibCloneString(UpgradeToStablePath, &TempBuffer);
     UpgradeToStablePath->StartOfString += 9 * MaxFieldSize;
     UpgradeToStablePath->LengthAllocated = MaxFieldSize;
 
-    UpgradeToStablePath->LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(_T("Package"),
-                                              _T("UpgradeToStablePath"),
-                                              _T(""),
-                                              UpgradeToStablePath->StartOfString,
-                                              UpgradeToStablePath->LengthAllocated,
-                                              IniPath->StartOfString);
+    YoriLibIniGetString(&Ini, _T("Package"), _T("UpgradeToStablePath"), UpgradeToStablePath);
 
+    YoriLibIniCleanup(&Ini);
     YoriLibFreeStringContents(&TempBuffer);
     return TRUE;
 }
@@ -376,103 +320,65 @@ YoriPkgGetInstalledPackageInfo(
     __out PYORI_STRING UpgradeToStablePath
     )
 {
+    YORI_LIB_INI_DOCUMENT Ini;
     YORI_STRING TempBuffer;
     YORI_ALLOC_SIZE_T MaxFieldSize = YORIPKG_MAX_FIELD_LENGTH;
 
     ASSERT(YoriLibIsStringNullTerminated(IniPath));
     ASSERT(YoriLibIsStringNullTerminated(PackageName));
 
-    if (DllKernel32.pGetPrivateProfileStringW == NULL) {
+    if (!YoriLibAllocateString(&TempBuffer, 7 * MaxFieldSize)) {
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&TempBuffer, 7 * MaxFieldSize)) {
+    if (!YoriLibIniLoad(&Ini, IniPath)) {
+        YoriLibIniCleanup(&Ini);
+        YoriLibFreeStringContents(&TempBuffer);
         return FALSE;
     }
 
     YoriLibCloneString(PackageVersion, &TempBuffer);
     PackageVersion->LengthAllocated = MaxFieldSize;
 
-    PackageVersion->LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(PackageName->StartOfString,
-                                              _T("Version"),
-                                              _T(""),
-                                              PackageVersion->StartOfString,
-                                              PackageVersion->LengthAllocated,
-                                              IniPath->StartOfString);
+    YoriLibIniGetString(&Ini, PackageName->StartOfString, _T("Version"), PackageVersion);
 
     YoriLibCloneString(PackageArch, &TempBuffer);
     PackageArch->StartOfString += 1 * MaxFieldSize;
     PackageArch->LengthAllocated = MaxFieldSize;
 
-    PackageArch->LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(PackageName->StartOfString,
-                                              _T("Architecture"),
-                                              _T(""),
-                                              PackageArch->StartOfString,
-                                              PackageArch->LengthAllocated,
-                                              IniPath->StartOfString);
+    YoriLibIniGetString(&Ini, PackageName->StartOfString, _T("Architecture"), PackageArch);
 
     YoriLibCloneString(UpgradePath, &TempBuffer);
     UpgradePath->StartOfString += 2 * MaxFieldSize;
     UpgradePath->LengthAllocated = MaxFieldSize;
 
-    UpgradePath->LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(PackageName->StartOfString,
-                                              _T("UpgradePath"),
-                                              _T(""),
-                                              UpgradePath->StartOfString,
-                                              UpgradePath->LengthAllocated,
-                                              IniPath->StartOfString);
+    YoriLibIniGetString(&Ini, PackageName->StartOfString, _T("UpgradePath"), UpgradePath);
 
     YoriLibCloneString(SourcePath, &TempBuffer);
     SourcePath->StartOfString += 3 * MaxFieldSize;
     SourcePath->LengthAllocated = MaxFieldSize;
 
-    SourcePath->LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(PackageName->StartOfString,
-                                              _T("SourcePath"),
-                                              _T(""),
-                                              SourcePath->StartOfString,
-                                              SourcePath->LengthAllocated,
-                                              IniPath->StartOfString);
+    YoriLibIniGetString(&Ini, PackageName->StartOfString, _T("SourcePath"), SourcePath);
 
     YoriLibCloneString(SymbolPath, &TempBuffer);
     SymbolPath->StartOfString += 4 * MaxFieldSize;
     SymbolPath->LengthAllocated = MaxFieldSize;
 
-    SymbolPath->LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(PackageName->StartOfString,
-                                              _T("SymbolPath"),
-                                              _T(""),
-                                              SymbolPath->StartOfString,
-                                              SymbolPath->LengthAllocated,
-                                              IniPath->StartOfString);
+    YoriLibIniGetString(&Ini, PackageName->StartOfString, _T("SymbolPath"), SymbolPath);
 
     YoriLibCloneString(UpgradeToDailyPath, &TempBuffer);
     UpgradeToDailyPath->StartOfString += 5 * MaxFieldSize;
     UpgradeToDailyPath->LengthAllocated = MaxFieldSize;
 
-    UpgradeToDailyPath->LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(PackageName->StartOfString,
-                                              _T("UpgradeToDailyPath"),
-                                              _T(""),
-                                              UpgradeToDailyPath->StartOfString,
-                                              UpgradeToDailyPath->LengthAllocated,
-                                              IniPath->StartOfString);
+    YoriLibIniGetString(&Ini, PackageName->StartOfString, _T("UpgradeToDailyPath"), UpgradeToDailyPath);
 
     YoriLibCloneString(UpgradeToStablePath, &TempBuffer);
-    UpgradeToStablePath->StartOfString += 5 * MaxFieldSize;
+    UpgradeToStablePath->StartOfString += 6 * MaxFieldSize;
     UpgradeToStablePath->LengthAllocated = MaxFieldSize;
 
-    UpgradeToStablePath->LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(PackageName->StartOfString,
-                                              _T("UpgradeToStablePath"),
-                                              _T(""),
-                                              UpgradeToStablePath->StartOfString,
-                                              UpgradeToStablePath->LengthAllocated,
-                                              IniPath->StartOfString);
+    YoriLibIniGetString(&Ini, PackageName->StartOfString, _T("UpgradeToStablePath"), UpgradeToStablePath);
 
+    YoriLibIniCleanup(&Ini);
     YoriLibFreeStringContents(&TempBuffer);
     return TRUE;
 }
@@ -684,6 +590,52 @@ YoriPkgDisplayMirrors(VOID)
     return TRUE;
 }
 
+/**
+ Replace the Mirrors section of packages.ini with a list of mirrors.  Each
+ mirror is expected to be in its storage format, where any '=' has been
+ converted to '%'.  The file is rewritten once after all mirrors have been
+ added.
+
+ @param IniFilePath Pointer to the path to the packages.ini file.
+
+ @param MirrorsList Pointer to the list of mirrors to write.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriPkgWriteMirrorsToIni(
+    __in PYORI_STRING IniFilePath,
+    __in PYORI_LIST_ENTRY MirrorsList
+    )
+{
+    YORI_LIB_INI_DOCUMENT PkgIni;
+    PYORI_LIST_ENTRY MirrorEntry;
+    PYORIPKG_MIRROR Mirror;
+    BOOL Result;
+
+    if (!YoriLibIniLoad(&PkgIni, IniFilePath)) {
+        YoriLibIniCleanup(&PkgIni);
+        return FALSE;
+    }
+
+    YoriLibIniDeleteSection(&PkgIni, _T("Mirrors"));
+    MirrorEntry = NULL;
+    MirrorEntry = YoriLibGetNextListEntry(MirrorsList, MirrorEntry);
+    while (MirrorEntry != NULL) {
+        Mirror = CONTAINING_RECORD(MirrorEntry, YORIPKG_MIRROR, MirrorList);
+        MirrorEntry = YoriLibGetNextListEntry(MirrorsList, MirrorEntry);
+        if (!YoriLibIniSetString(&PkgIni, _T("Mirrors"), Mirror->SourceName.StartOfString, Mirror->TargetName.StartOfString)) {
+            YoriLibIniCleanup(&PkgIni);
+            return FALSE;
+        }
+    }
+
+    Result = YoriLibIniSave(&PkgIni);
+    YoriLibIniCleanup(&PkgIni);
+    return Result;
+}
+
 /**
  Install a new mirror and add it to packages.ini
 
@@ -709,13 +661,10 @@ YoriPkgAddNewMirror(
     PYORIPKG_MIRROR NewMirror;
     YORI_STRING PackagesIni;
     DWORD Index;
+    BOOL Result;
 
     YoriLibInitializeListHead(&MirrorsList);
 
-    if (DllKernel32.pWritePrivateProfileStringW == NULL) {
-        return FALSE;
-    }
-
     if (!YoriPkgGetPackageIniFile(NULL, &PackagesIni)) {
         return FALSE;
     }
@@ -812,14 +761,7 @@ YoriPkgAddNewMirror(
     //  Rewrite the section
     //
 
-    DllKernel32.pWritePrivateProfileStringW(_T("Mirrors"), NULL, NULL, PackagesIni.StartOfString);
-    MirrorEntry = NULL;
-    MirrorEntry = YoriLibGetNextListEntry(&MirrorsList, MirrorEntry);
-    while (MirrorEntry != NULL) {
-        Mirror = CONTAINING_RECORD(MirrorEntry, YORIPKG_MIRROR, MirrorList);
-        MirrorEntry = YoriLibGetNextListEntry(&MirrorsList, MirrorEntry);
-        DllKernel32.pWritePrivateProfileStringW(_T("Mirrors"), Mirror->SourceName.StartOfString, Mirror->TargetName.StartOfString, PackagesIni.StartOfString);
-    }
+    Result = YoriPkgWriteMirrorsToIni(&PackagesIni, &MirrorsList);
 
     //
     //  Free the mirrors we found.
@@ -827,7 +769,7 @@ YoriPkgAddNewMirror(
 
     YoriPkgFreeMirrorList(&MirrorsList);
     YoriLibFreeStringContents(&PackagesIni);
-    return TRUE;
+    return Result;
 }
 
 /**
@@ -847,13 +789,10 @@ YoriPkgDeleteMirror(
     PYORIPKG_MIRROR Mirror;
     YORI_STRING PackagesIni;
     DWORD Index;
+    BOOL Result;
 
     YoriLibInitializeListHead(&MirrorsList);
 
-    if (DllKernel32.pWritePrivateProfileStringW == NULL) {
-        return FALSE;
-    }
-
     if (!YoriPkgGetPackageIniFile(NULL, &PackagesIni)) {
         return FALSE;
     }
@@ -900,14 +839,7 @@ YoriPkgDeleteMirror(
     //  Rewrite the section
     //
 
-    DllKernel32.pWritePrivateProfileStringW(_T("Mirrors"), NULL, NULL, PackagesIni.StartOfString);
-    MirrorEntry = NULL;
-    MirrorEntry = YoriLibGetNextListEntry(&MirrorsList, MirrorEntry);
-    while (MirrorEntry != NULL) {
-        Mirror = CONTAINING_RECORD(MirrorEntry, YORIPKG_MIRROR, MirrorList);
-        MirrorEntry = YoriLibGetNextListEntry(&MirrorsList, MirrorEntry);
-        DllKernel32.pWritePrivateProfileStringW(_T("Mirrors"), Mirror->SourceName.StartOfString, Mirror->TargetName.StartOfString, PackagesIni.StartOfString);
-    }
+    Result = YoriPkgWriteMirrorsToIni(&PackagesIni, &MirrorsList);
 
     //
     //  Free the mirrors we found.
@@ -915,7 +847,7 @@ YoriPkgDeleteMirror(
 
     YoriPkgFreeMirrorList(&MirrorsList);
     YoriLibFreeStringContents(&PackagesIni);
-    return TRUE;
+    return Result;
 }
 
 
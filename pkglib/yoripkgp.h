@@ -3,7 +3,7 @@
  *
  * Private/internal header for Yori package routines
  *
- * Copyright (c) 2018-2021 Malcolm J. Smith
+ * Copyright (c) 2018-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -355,7 +355,7 @@ BOOL
 YoriPkgBuildUpgradeLocationForNewArchitecture(
     __in PYORI_STRING PackageName,
     __in PYORI_STRING NewArchitecture,
-    __in PYORI_STRING PkgIniFile,
+    __in PYORI_LIB_INI_DOCUMENT PkgIni,
     __inout PYORI_STRING UpgradePath
     );
 
@@ -419,7 +419,7 @@ YoriPkgBackupPackage(
 
 VOID
 YoriPkgRemoveSystemReferencesToPackage(
-    __in PYORI_STRING IniPath,
+    __inout PYORI_LIB_INI_DOCUMENT PkgIni,
     __in PYORIPKG_BACKUP_PACKAGE PackageBackup
     );
 
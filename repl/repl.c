@@ -3,7 +3,7 @@
  *
  * Yori shell replace text with other text on an input stream
  *
- * Copyright (c) 2018-2021 Malcolm J. Smith
+ * Copyright (c) 2018-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -36,10 +36,11 @@ CHAR strReplHelpText[] =
         "Output the contents of one or more files with specified text replaced\n"
         "with alternate text.\n"
         "\n"
-        "REPL [-license] [-b] [-i] [-s] <old text> [<new text> [<file>...]]\n"
+        "REPL [-license] [-b] [-i] [-r] [-s] <old text> [<new text> [<file>...]]\n"
         "\n"
         "   -b             Use basic search criteria for files only\n"
         "   -i             Match insensitively\n"
+        "   -r             Treat old text as a regular expression\n"
         "   -s             Process files from all subdirectories\n";
 
 /**
@@ -87,8 +88,83 @@ typedef struct _REPL_CONTEXT {
      */
     PYORI_STRING NewString;
 
+    /**
+     If MatchString is a regular expression, the compiled form of it.  If
+     MatchString is text to find, this is NULL.
+     */
+    PYORI_LIB_REGEX Regex;
+
 } REPL_CONTEXT, *PREPL_CONTEXT;
 
+/**
+ Replace every match of a regular expression within a line.  Matches are
+ found in the original line, so replacement text is never searched.  An
+ empty match inserts the replacement text before the next character.
+
+ @param ReplContext Pointer to the context containing the compiled
+        expression and the replacement text.
+
+ @param LineString The line to search.
+
+ @param Output On successful completion, updated to contain the line with
+        any replacements applied.  This string may be reallocated.
+
+ @return TRUE to indicate success, FALSE on allocation failure.
+ */
+__success(return)
+BOOLEAN
+ReplRegexReplace(
+    __in PREPL_CONTEXT ReplContext,
+    __in PYORI_STRING LineString,
+    __inout PYORI_STRING Output
+    )
+{
+    YORI_STRING Portion;
+    YORI_ALLOC_SIZE_T Offset;
+    YORI_ALLOC_SIZE_T MatchOffset;
+    YORI_ALLOC_SIZE_T MatchLength;
+
+    YoriLibInitEmptyString(&Portion);
+    Output->LengthInChars = 0;
+    Offset = 0;
+
+    while (Offset <= LineString->LengthInChars) {
+        if (YoriLibRegexFindFirst(ReplContext->Regex, LineString, Offset, &MatchOffset, &MatchLength) == NULL) {
+            break;
+        }
+
+        Portion.StartOfString = &LineString->StartOfString[Offset];
+        Portion.LengthInChars = MatchOffset - Offset;
+        if (!YoriLibStringConcat(Output, &Portion) ||
+            !YoriLibStringConcat(Output, ReplContext->NewString)) {
+
+            return FALSE;
+        }
+
+        Offset = MatchOffset + MatchLength;
+        if (MatchLength == 0) {
+            if (Offset < LineString->LengthInChars) {
+                Portion.StartOfString = &LineString->StartOfString[Offset];
+                Portion.LengthInChars = 1;
+                if (!YoriLibStringConcat(Output, &Portion)) {
+                    return FALSE;
+                }
+            }
+            Offset++;
+        }
+    }
+
+    if (Offset < LineString->LengthInChars) {
+        Portion.StartOfString = &LineString->StartOfString[Offset];
+        Portion.LengthInChars = LineString->LengthInChars - Offset;
+        if (!YoriLibStringConcat(Output, &Portion)) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
 /**
  Process a stream and apply the repl criteria before outputting to standard
  output.
@@ -139,7 +215,13 @@ ReplProcessStream(
         SourceString = &LineString;
         SearchOffset = 0;
         NextAlternate = 0;
-        while(TRUE) {
+        if (ReplContext->Regex != NULL &&
+            ReplRegexReplace(ReplContext, &LineString, &AlternateStrings[0])) {
+
+            SourceString = &AlternateStrings[0];
+        }
+
+        while(ReplContext->Regex == NULL) {
 
             //
             //  Continue searching after any previous replacements
@@ -366,6 +448,7 @@ ENTRYPOINT(
     YORI_ALLOC_SIZE_T StartArg = 0;
     WORD MatchFlags;
     BOOLEAN BasicEnumeration = FALSE;
+    BOOLEAN UseRegex = FALSE;
     REPL_CONTEXT ReplContext;
     YORI_STRING Arg;
     YORI_STRING EmptyString;
@@ -383,7 +466,7 @@ ENTRYPOINT(
                 ReplHelp();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2018-2021"));
+                YoriLibDisplayMitLicense(_T("2018-2026"));
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("b")) == 0) {
                 BasicEnumeration = TRUE;
@@ -391,6 +474,9 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("i")) == 0) {
                 ReplContext.Insensitive = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("r")) == 0) {
+                UseRegex = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("s")) == 0) {
                 ReplContext.Recursive = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -434,6 +520,19 @@ ENTRYPOINT(
     }
     StartArg += 2;
 
+    if (UseRegex) {
+        YORI_ALLOC_SIZE_T ErrorPattern;
+        YORI_ALLOC_SIZE_T ErrorOffset;
+
+        ReplContext.Regex = YoriLibAllocateRegex(1, ReplContext.MatchString, ReplContext.Insensitive, &ErrorPattern, &ErrorOffset);
+        if (ReplContext.Regex == NULL) {
+            if (ErrorPattern == 0) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("repl: invalid regular expression %y at offset %i\n"), ReplContext.MatchString, ErrorOffset);
+            }
+            return EXIT_FAILURE;
+        }
+    }
+
 #if YORI_BUILTIN
     YoriLibCancelEnable(FALSE);
 #endif
@@ -446,6 +545,9 @@ ENTRYPOINT(
     if (StartArg == 0 || StartArg >= ArgC) {
         if (YoriLibIsStdInConsole()) {
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("No file or pipe for input\n"));
+            if (ReplContext.Regex != NULL) {
+                YoriLibFreeRegex(ReplContext.Regex);
+            }
             return EXIT_FAILURE;
         }
 
@@ -474,6 +576,10 @@ ENTRYPOINT(
     YoriLibLineReadCleanupCache();
 #endif
 
+    if (ReplContext.Regex != NULL) {
+        YoriLibFreeRegex(ReplContext.Regex);
+    }
+
     if (ReplContext.FilesFound == 0) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("repl: no matching files found\n"));
         return EXIT_FAILURE;
@@ -6,7 +6,7 @@
  *
  * This module implements the core logic of displaying directories.
  *
- * Copyright (c) 2014-2018 Malcolm J. Smith
+ * Copyright (c) 2014-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -42,9 +42,10 @@ YORI_ALLOC_SIZE_T SdirAllocatedDirents;
 PYORI_FILE_INFO SdirDirCollection;
 
 /**
- Pointer to an array of pointers to directory entries.  These pointers
- are maintained sorted based on the user's sort criteria so that files
- can be displayed in order from this indirection.
+ Pointer to an array of pointers to directory entries.  These pointers are
+ recorded in the order files are found, and are sorted based on the user's
+ sort criteria before display so that files can be displayed in order from
+ this indirection.
  */
 PYORI_FILE_INFO * SdirDirSorted;
 
@@ -207,8 +208,6 @@ SdirAddToCollection (
     ) 
 {
     PYORI_FILE_INFO CurrentEntry;
-    YORI_ALLOC_SIZE_T i, j;
-    DWORD CompareResult = 0;
 
     if (SdirDirCollectionCurrent >= SdirAllocatedDirents) {
         if (SdirDirCollectionCurrent < ((YORI_ALLOC_SIZE_T)-1)) {
@@ -240,47 +239,406 @@ SdirAddToCollection (
     }
 
     //
-    //  Now that our internal entry is fully poulated, insert it into the
-    //  correct sorted position.  As an optimization, check if we just need
-    //  to insert at the end (for file name sort on NTFS, this is the
-    //  common case.)
+    //  Entries are recorded in the order they are found and sorted once
+    //  all of them have been found, by @ref SdirSortCollection .
     //
 
-    if (SdirDirCollectionCurrent > 1 &&
-        Opts->Sort[0].CompareFn(SdirDirSorted[SdirDirCollectionCurrent - 2], CurrentEntry) == Opts->Sort[0].CompareInverseCondition) {
+    SdirDirSorted[SdirDirCollectionCurrent - 1] = CurrentEntry;
+    return TRUE;
+}
 
-        SdirDirSorted[SdirDirCollectionCurrent - 1] = CurrentEntry;
-        return TRUE;
+/**
+ A prototype for a function that returns a sort key for a directory entry.
+ If the keys for two entries differ, they must be in the same order as the
+ comparison function they are generated for would place the entries.  Two
+ entries with the same key are ordered with the comparison function.
+ */
+typedef DWORDLONG SDIR_SORT_KEY_FN(PYORI_FILE_INFO);
+
+/**
+ A pointer to a function that returns a sort key for a directory entry.
+ */
+typedef SDIR_SORT_KEY_FN *PSDIR_SORT_KEY_FN;
+
+/**
+ An association between a comparison function and a function which
+ generates sort keys consistent with it.
+ */
+typedef struct _SDIR_SORT_KEY_GENERATOR {
+
+    /**
+     The comparison function the sort keys are generated for.
+     */
+    SDIR_COMPARE_FN CompareFn;
+
+    /**
+     The function to generate a sort key for an entry.
+     */
+    PSDIR_SORT_KEY_FN KeyFn;
+} SDIR_SORT_KEY_GENERATOR;
+
+/**
+ A directory entry along with the key used to sort it.
+ */
+typedef struct _SDIR_SORT_ENTRY {
+
+    /**
+     The key generated for the first sort criteria.
+     */
+    DWORDLONG Key;
+
+    /**
+     Pointer to the directory entry.
+     */
+    PYORI_FILE_INFO Entry;
+} SDIR_SORT_ENTRY, *PSDIR_SORT_ENTRY;
+
+/**
+ Generate a sort key from the date component of a time stamp.
+
+ @param Time Pointer to the time stamp.
+
+ @return The sort key.
+ */
+DWORDLONG
+SdirSortKeyFromDate(
+    __in LPSYSTEMTIME Time
+    )
+{
+    return ((DWORDLONG)Time->wYear << 32) |
+           ((DWORDLONG)Time->wMonth << 16) |
+           Time->wDay;
+}
+
+/**
+ Generate a sort key from the time component of a time stamp.
+
+ @param Time Pointer to the time stamp.
+
+ @return The sort key.
+ */
+DWORDLONG
+SdirSortKeyFromTime(
+    __in LPSYSTEMTIME Time
+    )
+{
+    return ((DWORDLONG)Time->wHour << 48) |
+           ((DWORDLONG)Time->wMinute << 32) |
+           ((DWORDLONG)Time->wSecond << 16) |
+           Time->wMilliseconds;
+}
+
+/**
+ Generate a sort key for the access date of an entry.
+
+ @param Entry Pointer to the directory entry.
+
+ @return The sort key.
+ */
+DWORDLONG
+SdirSortKeyAccessDate(
+    __in PYORI_FILE_INFO Entry
+    )
+{
+    return SdirSortKeyFromDate(&Entry->AccessTime);
+}
+
+/**
+ Generate a sort key for the access time of an entry.
+
+ @param Entry Pointer to the directory entry.
+
+ @return The sort key.
+ */
+DWORDLONG
+SdirSortKeyAccessTime(
+    __in PYORI_FILE_INFO Entry
+    )
+{
+    return SdirSortKeyFromTime(&Entry->AccessTime);
+}
+
+/**
+ Generate a sort key for the allocation size of an entry.
+
+ @param Entry Pointer to the directory entry.
+
+ @return The sort key.
+ */
+DWORDLONG
+SdirSortKeyAllocationSize(
+    __in PYORI_FILE_INFO Entry
+    )
+{
+    return (DWORDLONG)Entry->AllocationSize.QuadPart;
+}
+
+/**
+ Generate a sort key for the compressed size of an entry.
+
+ @param Entry Pointer to the directory entry.
+
+ @return The sort key.
+ */
+DWORDLONG
+SdirSortKeyCompressedFileSize(
+    __in PYORI_FILE_INFO Entry
+    )
+{
+    return (DWORDLONG)Entry->CompressedFileSize.QuadPart;
+}
+
+/**
+ Generate a sort key for the create date of an entry.
+
+ @param Entry Pointer to the directory entry.
+
+ @return The sort key.
+ */
+DWORDLONG
+SdirSortKeyCreateDate(
+    __in PYORI_FILE_INFO Entry
+    )
+{
+    return SdirSortKeyFromDate(&Entry->CreateTime);
+}
+
+/**
+ Generate a sort key for the create time of an entry.
+
+ @param Entry Pointer to the directory entry.
+
+ @return The sort key.
+ */
+DWORDLONG
+SdirSortKeyCreateTime(
+    __in PYORI_FILE_INFO Entry
+    )
+{
+    return SdirSortKeyFromTime(&Entry->CreateTime);
+}
+
+/**
+ Generate a sort key for the size of an entry.
+
+ @param Entry Pointer to the directory entry.
+
+ @return The sort key.
+ */
+DWORDLONG
+SdirSortKeyFileSize(
+    __in PYORI_FILE_INFO Entry
+    )
+{
+    return (DWORDLONG)Entry->FileSize.QuadPart;
+}
+
+/**
+ Generate a sort key for the write date of an entry.
+
+ @param Entry Pointer to the directory entry.
+
+ @return The sort key.
+ */
+DWORDLONG
+SdirSortKeyWriteDate(
+    __in PYORI_FILE_INFO Entry
+    )
+{
+    return SdirSortKeyFromDate(&Entry->WriteTime);
+}
+
+/**
+ Generate a sort key for the write time of an entry.
+
+ @param Entry Pointer to the directory entry.
+
+ @return The sort key.
+ */
+DWORDLONG
+SdirSortKeyWriteTime(
+    __in PYORI_FILE_INFO Entry
+    )
+{
+    return SdirSortKeyFromTime(&Entry->WriteTime);
+}
+
+/**
+ The set of comparison functions which can use a sort key to avoid most
+ comparisons.  Other comparisons are sorted by calling the comparison
+ function only.  Names and extensions are compared without regard to case
+ by the C library, so a key can't be generated that is guaranteed to order
+ them the same way.
+ */
+CONST SDIR_SORT_KEY_GENERATOR SdirSortKeyGenerators[] = {
+    {YoriLibCompareAccessDate,           SdirSortKeyAccessDate},
+    {YoriLibCompareAccessTime,           SdirSortKeyAccessTime},
+    {YoriLibCompareAllocationSize,       SdirSortKeyAllocationSize},
+    {YoriLibCompareCompressedFileSize,   SdirSortKeyCompressedFileSize},
+    {YoriLibCompareCreateDate,           SdirSortKeyCreateDate},
+    {YoriLibCompareCreateTime,           SdirSortKeyCreateTime},
+    {YoriLibCompareFileSize,             SdirSortKeyFileSize},
+    {YoriLibCompareWriteDate,            SdirSortKeyWriteDate},
+    {YoriLibCompareWriteTime,            SdirSortKeyWriteTime},
+};
+
+/**
+ Compare two directory entries using all of the user's sort criteria.  If
+ the entries are equal, they are ordered by their position in the
+ collection, which is the order they were found, so that the sort is
+ stable.
+
+ @param Left Pointer to the first entry.
+
+ @param Right Pointer to the second entry.
+
+ @return Negative if Left should be displayed before Right, positive if
+         Right should be displayed before Left.
+ */
+int
+SdirCompareEntries(
+    __in PYORI_FILE_INFO Left,
+    __in PYORI_FILE_INFO Right
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    DWORD CompareResult;
+
+    for (Index = 0; Index < Opts->CurrentSort; Index++) {
+        CompareResult = Opts->Sort[Index].CompareFn(Left, Right);
+        if (CompareResult == Opts->Sort[Index].CompareBreakCondition) {
+            return 1;
+        } else if (CompareResult == Opts->Sort[Index].CompareInverseCondition) {
+            return -1;
+        }
     }
 
-    //
-    //  Currently sorting is done very inefficiently by a selection sort
-    //  type algorithm.  Generally this doesn't run due to the optimization
-    //  above.  When a different sort order is requested, performance could
-    //  be improved by using a better algorithm here.
-    //
+    if (Left < Right) {
+        return -1;
+    } else if (Left > Right) {
+        return 1;
+    }
+    return 0;
+}
 
-    for (i = 0; i < SdirDirCollectionCurrent - 1; i++) {
+/**
+ Compare two sort entries, using their keys if they differ and the user's
+ sort criteria if they do not.
 
-        for (j = 0; j < Opts->CurrentSort; j++) {
-            CompareResult = Opts->Sort[j].CompareFn(SdirDirSorted[i], CurrentEntry);
+ @param Element1 Pointer to the first SDIR_SORT_ENTRY.
 
-            if (CompareResult == Opts->Sort[j].CompareBreakCondition ||
-                CompareResult == Opts->Sort[j].CompareInverseCondition) {
-                break;
-            }
+ @param Element2 Pointer to the second SDIR_SORT_ENTRY.
+
+ @param Context Unused.
+
+ @return Negative if Element1 should be displayed before Element2, positive
+         if Element2 should be displayed before Element1.
+ */
+int
+SdirSortCompareKeys(
+    __in PVOID Element1,
+    __in PVOID Element2,
+    __in_opt PVOID Context
+    )
+{
+    PSDIR_SORT_ENTRY Left;
+    PSDIR_SORT_ENTRY Right;
+    int Result;
+
+    UNREFERENCED_PARAMETER(Context);
+
+    Left = (PSDIR_SORT_ENTRY)Element1;
+    Right = (PSDIR_SORT_ENTRY)Element2;
+
+    if (Left->Key != Right->Key) {
+        Result = (Left->Key < Right->Key)?-1:1;
+        if (Opts->Sort[0].CompareBreakCondition == YORI_LIB_LESS_THAN) {
+            Result = -Result;
         }
+        return Result;
+    }
 
-        if (CompareResult == Opts->Sort[j].CompareBreakCondition) {
-            for (j = SdirDirCollectionCurrent - 1; j > i; j--) {
-                SdirDirSorted[j] = SdirDirSorted[j - 1];
-            }
-            SdirDirSorted[i] = CurrentEntry;
-            return TRUE;
+    return SdirCompareEntries(Left->Entry, Right->Entry);
+}
+
+/**
+ Compare two pointers to directory entries using the user's sort criteria.
+
+ @param Element1 Pointer to the first PYORI_FILE_INFO.
+
+ @param Element2 Pointer to the second PYORI_FILE_INFO.
+
+ @param Context Unused.
+
+ @return Negative if Element1 should be displayed before Element2, positive
+         if Element2 should be displayed before Element1.
+ */
+int
+SdirSortCompareEntries(
+    __in PVOID Element1,
+    __in PVOID Element2,
+    __in_opt PVOID Context
+    )
+{
+    UNREFERENCED_PARAMETER(Context);
+
+    return SdirCompareEntries(*(PYORI_FILE_INFO *)Element1, *(PYORI_FILE_INFO *)Element2);
+}
+
+/**
+ Sort the entries that have been found according to the user's sort
+ criteria.  Where the first criteria supports it, a key is generated for
+ each entry first so that most comparisons are a single integer comparison.
+ Large collections are sorted with multiple threads.
+ */
+VOID
+SdirSortCollection(VOID)
+{
+    PSDIR_SORT_ENTRY SortEntries;
+    PSDIR_SORT_KEY_FN KeyFn;
+    YORI_ALLOC_SIZE_T Index;
+
+    if (SdirDirCollectionCurrent < 2) {
+        return;
+    }
+
+    KeyFn = NULL;
+    for (Index = 0; Index < sizeof(SdirSortKeyGenerators)/sizeof(SdirSortKeyGenerators[0]); Index++) {
+        if (SdirSortKeyGenerators[Index].CompareFn == Opts->Sort[0].CompareFn) {
+            KeyFn = SdirSortKeyGenerators[Index].KeyFn;
+            break;
         }
     }
-    SdirDirSorted[SdirDirCollectionCurrent - 1] = CurrentEntry;
-    return TRUE;
+
+    //
+    //  If there's no key for this criteria, or no memory to hold keys,
+    //  sort the entries directly.
+    //
+
+    SortEntries = NULL;
+    if (KeyFn != NULL &&
+        YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)SdirDirCollectionCurrent * sizeof(SDIR_SORT_ENTRY))) {
+
+        SortEntries = YoriLibMalloc(SdirDirCollectionCurrent * sizeof(SDIR_SORT_ENTRY));
+    }
+
+    if (SortEntries == NULL) {
+        YoriLibSortArray(SdirDirSorted, SdirDirCollectionCurrent, sizeof(PYORI_FILE_INFO), SdirSortCompareEntries, NULL, YORILIB_SORT_PARALLEL);
+        return;
+    }
+
+    for (Index = 0; Index < SdirDirCollectionCurrent; Index++) {
+        SortEntries[Index].Entry = SdirDirSorted[Index];
+        SortEntries[Index].Key = KeyFn(SdirDirSorted[Index]);
+    }
+
+    YoriLibSortArray(SortEntries, SdirDirCollectionCurrent, sizeof(SDIR_SORT_ENTRY), SdirSortCompareKeys, NULL, YORILIB_SORT_PARALLEL);
+
+    for (Index = 0; Index < SdirDirCollectionCurrent; Index++) {
+        SdirDirSorted[Index] = SortEntries[Index].Entry;
+    }
+
+    YoriLibFree(SortEntries);
 }
 
 /**
@@ -483,8 +841,7 @@ SdirItemFoundCallback(
  When this occurs the pointer values in the old array need to be adjusted
  from the old allocation to the new allocation.  In addition, entries may
  have been inserted into the old collection which should not be preserved
- because they will be reenumerated.  When this occurs they will be in the
- sorted array in sorted order, so any entry beyond the end of the
+ because they will be reenumerated.  Any entry beyond the end of the
  collection array should not be propagated to the new sort array.
 
  @param OldCollection Pointer to the previous array of directory entries.
@@ -926,6 +1283,8 @@ SdirDisplayCollection(VOID)
     }
 #endif
 
+    SdirSortCollection();
+
     //
     //  If we're allowed to shorten names to make the display more
     //  legible, we won't allow a longest name greater than twice
@@ -3,7 +3,7 @@
  *
  * Yori exported API for modules to call
  *
- * Copyright (c) 2017-2025 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -116,6 +116,18 @@ YoriApiBuiltinUnregister(
     return YoriLibShBuiltinUnregister(BuiltinCmd, CallbackFn);
 }
 
+/**
+ Discard all cached executable locations.
+
+ @return TRUE to indicate success.
+ */
+BOOL
+YoriApiClearExecutableCache(VOID)
+{
+    YoriShClearExecutableCache();
+    return TRUE;
+}
+
 /**
  Clear existing history strings.
 
@@ -335,6 +347,26 @@ YoriApiGetEscapedArgumentsEx(
     return TRUE;
 }
 
+/**
+ Build the set of executables located via the executable cache into an
+ array of key value pairs and return a pointer to the result.  This must be
+ freed with a subsequent call to @ref YoriApiFreeYoriString .
+
+ @param CacheStrings Pointer to a string structure to populate with a newly
+        allocated string containing a set of NULL terminated strings.
+
+ @return TRUE to indicate success, or FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriApiGetExecutableCacheStrings(
+    __out PYORI_STRING CacheStrings
+    )
+{
+    YoriLibInitEmptyString(CacheStrings);
+    return YoriShGetExecutableCacheStrings(CacheStrings);
+}
+
 /**
  Build history into an array of NULL terminated strings terminated by an
  additional NULL terminator.  The result must be freed with a subsequent
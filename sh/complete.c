@@ -3,7 +3,7 @@
  *
  * Yori shell tab completion
  *
- * Copyright (c) 2017-2020 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -533,10 +533,10 @@ YoriShPerformExecutableTabCompletion(
     //
 
     YoriLibInitEmptyString(&FoundExecutable);
-    Result = YoriLibLocateExecutableInPath(&SearchString,
-                                           YoriShAddExecutableToTabList,
-                                           &ExecTabContext,
-                                           &FoundExecutable);
+    Result = YoriShLocateExecutableInPath(&SearchString,
+                                          YoriShAddExecutableToTabList,
+                                          &ExecTabContext,
+                                          &FoundExecutable);
     YoriLibInitEmptyString(&FoundExecutable);
 
     //
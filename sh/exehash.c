@@ -0,0 +1,1309 @@
+/**
+ * @file sh/exehash.c
+ *
+ * Yori shell executable lookup cache
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yori.h"
+
+/**
+ The search order for file extensions if the PATHEXT environment variable is
+ not defined.  This matches the default used by the path resolver in yorilib.
+ */
+#define YORI_SH_EXEHASH_DEFAULT_PATHEXT _T(".com;.exe;.bat;.cmd")
+
+/**
+ The minimum number of milliseconds between checks of a directory's last
+ write time, for directories that cannot be monitored with change
+ notifications.
+ */
+#define YORI_SH_EXEHASH_RECHECK_INTERVAL (2000)
+
+/**
+ The number of files each per directory hash table is initially sized for.
+ The table grows as needed for directories containing more executables.
+ */
+#define YORI_SH_EXEHASH_INITIAL_FILES (64)
+
+/**
+ Information about a single directory within PATH.
+ */
+typedef struct _YORI_SH_EXEHASH_DIRECTORY {
+
+    /**
+     Links between all directories in PATH, in search order.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The name of the directory, as specified in PATH.  This is NULL
+     terminated.
+     */
+    YORI_STRING DirectoryName;
+
+    /**
+     A list of every executable file found within the directory.
+     */
+    YORI_LIST_ENTRY FileList;
+
+    /**
+     A hash table of executable files, keyed by the file name without its
+     extension.  Where a directory has multiple files with the same base
+     name, the one with the earliest PATHEXT extension is present in the
+     hash table.
+     */
+    PYORI_OPEN_HASH_TABLE FileHash;
+
+    /**
+     A change notification handle used to detect when the directory
+     contents have changed.  If this is NULL, the directory's last write
+     time is used instead.
+     */
+    HANDLE ChangeHandle;
+
+    /**
+     The last write time of the directory when it was last enumerated.  Only
+     meaningful if ChangeHandle is NULL.
+     */
+    FILETIME LastWriteTime;
+
+    /**
+     The tick count when the last write time was last checked.  Only
+     meaningful if ChangeHandle is NULL.
+     */
+    DWORD LastCheckTick;
+
+    /**
+     TRUE if the directory is a fully specified path whose contents can be
+     cached.  FALSE if the directory is relative to the current directory,
+     in which case it is searched each time.
+     */
+    BOOLEAN Cacheable;
+
+    /**
+     TRUE if FileList and FileHash describe the contents of the directory.
+     FALSE if the directory needs to be enumerated before use.
+     */
+    BOOLEAN Populated;
+} YORI_SH_EXEHASH_DIRECTORY, *PYORI_SH_EXEHASH_DIRECTORY;
+
+/**
+ Information about a single executable file within a directory.
+ */
+typedef struct _YORI_SH_EXEHASH_FILE {
+
+    /**
+     Links between all executable files in a directory.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     Link within the directory hash table, keyed by the file name without
+     its extension.  Only valid if Hashed is TRUE.
+     */
+    YORI_OPEN_HASH_ENTRY HashEntry;
+
+    /**
+     The name of the file, including its extension.  This is NULL terminated
+     and allocated as part of this structure.
+     */
+    YORI_STRING FileName;
+
+    /**
+     The number of characters in FileName that precede the extension.
+     */
+    YORI_ALLOC_SIZE_T BaseNameLength;
+
+    /**
+     The index of the extension within PATHEXT.
+     */
+    YORI_ALLOC_SIZE_T PathExtIndex;
+
+    /**
+     The number of times this file has been returned as the result of a
+     command lookup.
+     */
+    DWORD Hits;
+
+    /**
+     TRUE if this file is inserted into the directory hash table.
+     */
+    BOOLEAN Hashed;
+} YORI_SH_EXEHASH_FILE, *PYORI_SH_EXEHASH_FILE;
+
+/**
+ State for the executable lookup cache.
+ */
+typedef struct _YORI_SH_EXEHASH {
+
+    /**
+     A list of directories in PATH, in search order.
+     */
+    YORI_LIST_ENTRY DirectoryList;
+
+    /**
+     The value of PATH that DirectoryList was constructed from.
+     */
+    YORI_STRING Path;
+
+    /**
+     The value of PATHEXT that Extensions was constructed from.
+     */
+    YORI_STRING PathExt;
+
+    /**
+     An array of extensions in PATHEXT search order.  These point into the
+     PathExt allocation.
+     */
+    PYORI_STRING Extensions;
+
+    /**
+     The number of elements in Extensions.
+     */
+    YORI_ALLOC_SIZE_T ExtensionCount;
+
+    /**
+     TRUE if the above fields have been initialized from PATH and PATHEXT.
+     */
+    BOOLEAN Valid;
+} YORI_SH_EXEHASH, *PYORI_SH_EXEHASH;
+
+/**
+ Global state for the executable lookup cache.
+ */
+YORI_SH_EXEHASH YoriShExeHash;
+
+/**
+ A callback invoked for each executable file found when enumerating a
+ directory.
+
+ @param Context Caller supplied context.
+
+ @param FileName The name of the file that was found.
+
+ @param BaseNameLength The number of characters in FileName that precede the
+        extension.
+
+ @param PathExtIndex The index of the matching extension within PATHEXT.
+
+ @return TRUE to continue enumerating, FALSE to indicate failure.
+ */
+typedef BOOLEAN YORI_SH_EXEHASH_FOUND_FN(PVOID Context, PYORI_STRING FileName, YORI_ALLOC_SIZE_T BaseNameLength, YORI_ALLOC_SIZE_T PathExtIndex);
+
+/**
+ A pointer to a callback invoked for each executable file found when
+ enumerating a directory.
+ */
+typedef YORI_SH_EXEHASH_FOUND_FN *PYORI_SH_EXEHASH_FOUND_FN;
+
+/**
+ Discard the contents of a directory, leaving it to be enumerated again on
+ next use.
+
+ @param Directory Pointer to the directory.
+ */
+VOID
+YoriShExeHashFreeDirectoryContents(
+    __in PYORI_SH_EXEHASH_DIRECTORY Directory
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_SH_EXEHASH_FILE File;
+
+    ListEntry = YoriLibGetNextListEntry(&Directory->FileList, NULL);
+    while (ListEntry != NULL) {
+        File = CONTAINING_RECORD(ListEntry, YORI_SH_EXEHASH_FILE, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&Directory->FileList, ListEntry);
+        if (File->Hashed) {
+            YoriLibOpenHashRemoveByEntry(Directory->FileHash, &File->HashEntry);
+        }
+        YoriLibRemoveListItem(&File->ListEntry);
+        YoriLibFreeStringContents(&File->FileName);
+        YoriLibDereference(File);
+    }
+
+    Directory->Populated = FALSE;
+}
+
+/**
+ Free a directory and all of its contents.
+
+ @param Directory Pointer to the directory.
+ */
+VOID
+YoriShExeHashFreeDirectory(
+    __in PYORI_SH_EXEHASH_DIRECTORY Directory
+    )
+{
+    YoriShExeHashFreeDirectoryContents(Directory);
+    if (Directory->FileHash != NULL) {
+        YoriLibFreeEmptyOpenHashTable(Directory->FileHash);
+    }
+    if (Directory->ChangeHandle != NULL) {
+        FindCloseChangeNotification(Directory->ChangeHandle);
+    }
+    YoriLibRemoveListItem(&Directory->ListEntry);
+    YoriLibFreeStringContents(&Directory->DirectoryName);
+    YoriLibDereference(Directory);
+}
+
+/**
+ Discard all cached information about executables.  The cache is rebuilt on
+ next use.
+ */
+VOID
+YoriShClearExecutableCache(VOID)
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_SH_EXEHASH_DIRECTORY Directory;
+
+    if (YoriShExeHash.DirectoryList.Next != NULL) {
+        ListEntry = YoriLibGetNextListEntry(&YoriShExeHash.DirectoryList, NULL);
+        while (ListEntry != NULL) {
+            Directory = CONTAINING_RECORD(ListEntry, YORI_SH_EXEHASH_DIRECTORY, ListEntry);
+            ListEntry = YoriLibGetNextListEntry(&YoriShExeHash.DirectoryList, ListEntry);
+            YoriShExeHashFreeDirectory(Directory);
+        }
+    }
+
+    if (YoriShExeHash.Extensions != NULL) {
+        YoriLibFree(YoriShExeHash.Extensions);
+        YoriShExeHash.Extensions = NULL;
+    }
+    YoriShExeHash.ExtensionCount = 0;
+    YoriLibFreeStringContents(&YoriShExeHash.Path);
+    YoriLibFreeStringContents(&YoriShExeHash.PathExt);
+    YoriShExeHash.Valid = FALSE;
+}
+
+/**
+ Returns TRUE if a directory from PATH is fully specified, so its contents
+ do not depend on the current directory.
+
+ @param DirectoryName The directory name.
+
+ @return TRUE if the directory is fully specified, FALSE if not.
+ */
+BOOLEAN
+YoriShExeHashIsDirectoryCacheable(
+    __in PYORI_STRING DirectoryName
+    )
+{
+    if (YoriLibIsDrvLetterColonSlash(DirectoryName)) {
+        return TRUE;
+    }
+
+    if (DirectoryName->LengthInChars >= 2 &&
+        YoriLibIsSep(DirectoryName->StartOfString[0]) &&
+        YoriLibIsSep(DirectoryName->StartOfString[1])) {
+
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/**
+ Construct the array of PATHEXT components and the list of PATH directories
+ from the current values of those variables.  The directories are not
+ enumerated until they are needed.
+
+ @param Path The current value of PATH.  On success, ownership of this string
+        transfers to the cache.
+
+ @param PathExt The current value of PATHEXT.  On success, ownership of this
+        string transfers to the cache.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriShExeHashBuild(
+    __in PYORI_STRING Path,
+    __in PYORI_STRING PathExt
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T Start;
+    YORI_ALLOC_SIZE_T Count;
+    YORI_STRING Component;
+    PYORI_SH_EXEHASH_DIRECTORY Directory;
+
+    ASSERT(!YoriShExeHash.Valid);
+
+    if (YoriShExeHash.DirectoryList.Next == NULL) {
+        YoriLibInitializeListHead(&YoriShExeHash.DirectoryList);
+    }
+
+    //
+    //  Count and capture each extension.  Empty components are ignored.
+    //
+
+    Count = 0;
+    for (Index = 0; Index <= PathExt->LengthInChars; Index++) {
+        if (Index == PathExt->LengthInChars || PathExt->StartOfString[Index] == ';') {
+            Count++;
+        }
+    }
+
+    YoriShExeHash.Extensions = YoriLibMalloc(Count * sizeof(YORI_STRING));
+    if (YoriShExeHash.Extensions == NULL) {
+        return FALSE;
+    }
+
+    Count = 0;
+    Start = 0;
+    for (Index = 0; Index <= PathExt->LengthInChars; Index++) {
+        if (Index == PathExt->LengthInChars || PathExt->StartOfString[Index] == ';') {
+            if (Index > Start) {
+                YoriLibInitEmptyString(&YoriShExeHash.Extensions[Count]);
+                YoriShExeHash.Extensions[Count].StartOfString = &PathExt->StartOfString[Start];
+                YoriShExeHash.Extensions[Count].LengthInChars = Index - Start;
+                Count++;
+            }
+            Start = Index + 1;
+        }
+    }
+    YoriShExeHash.ExtensionCount = Count;
+
+    //
+    //  Create an entry for each directory in PATH, in search order.
+    //
+
+    Start = 0;
+    for (Index = 0; Index <= Path->LengthInChars; Index++) {
+        if (Index == Path->LengthInChars || Path->StartOfString[Index] == ';') {
+            if (Index > Start) {
+                YoriLibInitEmptyString(&Component);
+                Component.StartOfString = &Path->StartOfString[Start];
+                Component.LengthInChars = Index - Start;
+
+                Directory = YoriLibReferencedMalloc(sizeof(YORI_SH_EXEHASH_DIRECTORY) + (Component.LengthInChars + 1) * sizeof(TCHAR));
+                if (Directory == NULL) {
+                    YoriLibFree(YoriShExeHash.Extensions);
+                    YoriShExeHash.Extensions = NULL;
+                    YoriShExeHash.ExtensionCount = 0;
+                    YoriShClearExecutableCache();
+                    return FALSE;
+                }
+
+                ZeroMemory(Directory, sizeof(YORI_SH_EXEHASH_DIRECTORY));
+                YoriLibInitializeListHead(&Directory->FileList);
+                YoriLibInitEmptyString(&Directory->DirectoryName);
+                Directory->DirectoryName.StartOfString = (LPTSTR)(Directory + 1);
+                YoriLibReference(Directory);
+                Directory->DirectoryName.MemoryToFree = Directory;
+                memcpy(Directory->DirectoryName.StartOfString, Component.StartOfString, Component.LengthInChars * sizeof(TCHAR));
+                Directory->DirectoryName.StartOfString[Component.LengthInChars] = '\0';
+                Directory->DirectoryName.LengthInChars = Component.LengthInChars;
+                Directory->DirectoryName.LengthAllocated = Component.LengthInChars + 1;
+                Directory->Cacheable = YoriShExeHashIsDirectoryCacheable(&Directory->DirectoryName);
+                YoriLibAppendList(&YoriShExeHash.DirectoryList, &Directory->ListEntry);
+            }
+            Start = Index + 1;
+        }
+    }
+
+    memcpy(&YoriShExeHash.Path, Path, sizeof(YORI_STRING));
+    memcpy(&YoriShExeHash.PathExt, PathExt, sizeof(YORI_STRING));
+    YoriShExeHash.Valid = TRUE;
+    return TRUE;
+}
+
+/**
+ Check whether PATH or PATHEXT have changed since the cache was constructed,
+ and if so, discard the cache and construct a new one.
+
+ @return TRUE to indicate the cache reflects the current values of PATH and
+         PATHEXT, FALSE if it could not be constructed.
+ */
+__success(return)
+BOOLEAN
+YoriShExeHashSyncWithEnvironment(VOID)
+{
+    YORI_STRING Path;
+    YORI_STRING PathExt;
+
+    YoriLibInitEmptyString(&Path);
+    YoriLibInitEmptyString(&PathExt);
+
+    if (!YoriLibAllocateAndGetEnvVar(_T("PATH"), &Path)) {
+        return FALSE;
+    }
+
+    if (!YoriLibAllocateAndGetEnvVar(_T("PATHEXT"), &PathExt)) {
+        YoriLibFreeStringContents(&Path);
+        return FALSE;
+    }
+
+    if (PathExt.LengthInChars == 0) {
+        YoriLibFreeStringContents(&PathExt);
+        YoriLibConstantString(&PathExt, YORI_SH_EXEHASH_DEFAULT_PATHEXT);
+    }
+
+    if (YoriShExeHash.Valid) {
+        if (YoriLibCompareString(&Path, &YoriShExeHash.Path) == 0 &&
+            YoriLibCompareString(&PathExt, &YoriShExeHash.PathExt) == 0) {
+
+            YoriLibFreeStringContents(&Path);
+            YoriLibFreeStringContents(&PathExt);
+            return TRUE;
+        }
+
+        YoriShClearExecutableCache();
+    }
+
+    if (!YoriShExeHashBuild(&Path, &PathExt)) {
+        YoriLibFreeStringContents(&Path);
+        YoriLibFreeStringContents(&PathExt);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Determine whether a file name ends in an extension from PATHEXT, and if so,
+ which one.
+
+ @param FileName The file name.
+
+ @param PathExtIndex On successful completion, updated to contain the index
+        of the earliest matching extension in PATHEXT.
+
+ @return TRUE if the file name has an extension in PATHEXT, FALSE if it does
+         not.
+ */
+__success(return)
+BOOLEAN
+YoriShExeHashFindExtension(
+    __in PYORI_STRING FileName,
+    __out PYORI_ALLOC_SIZE_T PathExtIndex
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    PYORI_STRING Extension;
+    YORI_STRING FileExtension;
+
+    YoriLibInitEmptyString(&FileExtension);
+
+    for (Index = 0; Index < YoriShExeHash.ExtensionCount; Index++) {
+        Extension = &YoriShExeHash.Extensions[Index];
+        if (FileName->LengthInChars > Extension->LengthInChars) {
+            FileExtension.StartOfString = &FileName->StartOfString[FileName->LengthInChars - Extension->LengthInChars];
+            FileExtension.LengthInChars = Extension->LengthInChars;
+            if (YoriLibCompareStringIns(&FileExtension, Extension) == 0) {
+                *PathExtIndex = Index;
+                return TRUE;
+            }
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Enumerate a directory and invoke a callback for each file that has an
+ extension in PATHEXT.
+
+ @param DirectoryName The directory to enumerate.
+
+ @param Prefix The prefix of file names to return.  This can be an empty
+        string to return all executable files.
+
+ @param Callback The function to invoke for each file found.
+
+ @param Context Context to pass to Callback.
+
+ @return TRUE to indicate success, FALSE to indicate failure.  If the
+         directory does not exist, this is considered a successful
+         enumeration that found nothing.
+ */
+__success(return)
+BOOLEAN
+YoriShExeHashEnumerateDirectory(
+    __in PYORI_STRING DirectoryName,
+    __in PYORI_STRING Prefix,
+    __in PYORI_SH_EXEHASH_FOUND_FN Callback,
+    __in PVOID Context
+    )
+{
+    YORI_STRING SearchName;
+    YORI_STRING FileName;
+    WIN32_FIND_DATA FindData;
+    HANDLE hFind;
+    LPTSTR Seperator;
+    YORI_ALLOC_SIZE_T PathExtIndex;
+    YORI_ALLOC_SIZE_T PathExtLength;
+
+    //
+    //  If the directory is just an X: prefix, adding a seperator would
+    //  change its meaning.  If it ends in a seperator already, don't add
+    //  another.
+    //
+
+    Seperator = _T("\\");
+    if (DirectoryName->LengthInChars == 2 &&
+        DirectoryName->StartOfString[1] == ':') {
+
+        Seperator = _T("");
+    } else if (DirectoryName->LengthInChars > 0 &&
+               YoriLibIsSep(DirectoryName->StartOfString[DirectoryName->LengthInChars - 1])) {
+
+        Seperator = _T("");
+    }
+
+    if (!YoriLibAllocateString(&SearchName, DirectoryName->LengthInChars + Prefix->LengthInChars + 3)) {
+        return FALSE;
+    }
+
+    SearchName.LengthInChars = YoriLibSPrintf(SearchName.StartOfString, _T("%y%s%y*"), DirectoryName, Seperator, Prefix);
+
+    hFind = FindFirstFile(SearchName.StartOfString, &FindData);
+    YoriLibFreeStringContents(&SearchName);
+    if (hFind == INVALID_HANDLE_VALUE) {
+        return TRUE;
+    }
+
+    do {
+        if ((FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+            YoriLibConstantString(&FileName, FindData.cFileName);
+            if (YoriShExeHashFindExtension(&FileName, &PathExtIndex)) {
+                PathExtLength = YoriShExeHash.Extensions[PathExtIndex].LengthInChars;
+                if (!Callback(Context, &FileName, FileName.LengthInChars - PathExtLength, PathExtIndex)) {
+                    FindClose(hFind);
+                    return FALSE;
+                }
+            }
+        }
+    } while (FindNextFile(hFind, &FindData));
+
+    FindClose(hFind);
+    return TRUE;
+}
+
+/**
+ A callback invoked when populating a directory for each executable file
+ found.
+
+ @param Context Pointer to the directory being populated.
+
+ @param FileName The name of the file that was found.
+
+ @param BaseNameLength The number of characters in FileName that precede the
+        extension.
+
+ @param PathExtIndex The index of the matching extension within PATHEXT.
+
+ @return TRUE to continue enumerating, FALSE to indicate failure.
+ */
+BOOLEAN
+YoriShExeHashAddFile(
+    __in PVOID Context,
+    __in PYORI_STRING FileName,
+    __in YORI_ALLOC_SIZE_T BaseNameLength,
+    __in YORI_ALLOC_SIZE_T PathExtIndex
+    )
+{
+    PYORI_SH_EXEHASH_DIRECTORY Directory = (PYORI_SH_EXEHASH_DIRECTORY)Context;
+    PYORI_SH_EXEHASH_FILE File;
+    PYORI_SH_EXEHASH_FILE ExistingFile;
+    PYORI_OPEN_HASH_ENTRY HashEntry;
+    YORI_STRING BaseName;
+
+    File = YoriLibReferencedMalloc(sizeof(YORI_SH_EXEHASH_FILE) + (FileName->LengthInChars + 1) * sizeof(TCHAR));
+    if (File == NULL) {
+        return FALSE;
+    }
+
+    ZeroMemory(File, sizeof(YORI_SH_EXEHASH_FILE));
+    YoriLibInitEmptyString(&File->FileName);
+    File->FileName.StartOfString = (LPTSTR)(File + 1);
+    YoriLibReference(File);
+    File->FileName.MemoryToFree = File;
+    memcpy(File->FileName.StartOfString, FileName->StartOfString, FileName->LengthInChars * sizeof(TCHAR));
+    File->FileName.StartOfString[FileName->LengthInChars] = '\0';
+    File->FileName.LengthInChars = FileName->LengthInChars;
+    File->FileName.LengthAllocated = FileName->LengthInChars + 1;
+    File->BaseNameLength = BaseNameLength;
+    File->PathExtIndex = PathExtIndex;
+    YoriLibAppendList(&Directory->FileList, &File->ListEntry);
+
+    //
+    //  Only the file with the earliest extension in PATHEXT is reachable
+    //  when searching by base name.
+    //
+
+    YoriLibInitEmptyString(&BaseName);
+    BaseName.StartOfString = File->FileName.StartOfString;
+    BaseName.LengthInChars = BaseNameLength;
+    BaseName.MemoryToFree = File;
+
+    HashEntry = YoriLibOpenHashLookupByKey(Directory->FileHash, &BaseName);
+    if (HashEntry != NULL) {
+        ExistingFile = (PYORI_SH_EXEHASH_FILE)HashEntry->Context;
+        if (ExistingFile->PathExtIndex <= PathExtIndex) {
+            return TRUE;
+        }
+        YoriLibOpenHashRemoveByEntry(Directory->FileHash, &ExistingFile->HashEntry);
+        ExistingFile->Hashed = FALSE;
+    }
+
+    if (!YoriLibOpenHashInsertByKey(Directory->FileHash, &BaseName, File, &File->HashEntry)) {
+        return FALSE;
+    }
+    File->Hashed = TRUE;
+    return TRUE;
+}
+
+/**
+ Query the last write time of a directory.
+
+ @param DirectoryName The directory to query.
+
+ @param LastWriteTime On successful completion, populated with the last write
+        time of the directory.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriShExeHashGetDirectoryWriteTime(
+    __in PYORI_STRING DirectoryName,
+    __out PFILETIME LastWriteTime
+    )
+{
+    HANDLE hDir;
+    BY_HANDLE_FILE_INFORMATION FileInfo;
+
+    hDir = CreateFile(DirectoryName->StartOfString,
+                      FILE_READ_ATTRIBUTES,
+                      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                      NULL,
+                      OPEN_EXISTING,
+                      FILE_FLAG_BACKUP_SEMANTICS,
+                      NULL);
+
+    if (hDir == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    if (!GetFileInformationByHandle(hDir, &FileInfo)) {
+        CloseHandle(hDir);
+        return FALSE;
+    }
+
+    CloseHandle(hDir);
+    LastWriteTime->dwLowDateTime = FileInfo.ftLastWriteTime.dwLowDateTime;
+    LastWriteTime->dwHighDateTime = FileInfo.ftLastWriteTime.dwHighDateTime;
+    return TRUE;
+}
+
+/**
+ Ensure the cached contents of a directory reflect the directory on disk,
+ enumerating it if it has not been enumerated or has changed since it was
+ enumerated.
+
+ @param Directory Pointer to the directory.
+
+ @return TRUE to indicate the cached contents are usable, FALSE if they
+         could not be populated.
+ */
+__success(return)
+BOOLEAN
+YoriShExeHashRefreshDirectory(
+    __in PYORI_SH_EXEHASH_DIRECTORY Directory
+    )
+{
+    FILETIME LastWriteTime;
+    DWORD CurrentTick;
+    YORI_STRING Prefix;
+    HANDLE ChangeHandle;
+
+    ASSERT(Directory->Cacheable);
+
+    if (Directory->Populated) {
+
+        //
+        //  If the directory is monitored, it's current unless a change has
+        //  been signalled.  Rearm the notification before enumerating so
+        //  that any change made during enumeration is not lost.
+        //
+
+        if (Directory->ChangeHandle != NULL) {
+            if (WaitForSingleObject(Directory->ChangeHandle, 0) != WAIT_OBJECT_0) {
+                return TRUE;
+            }
+            if (!FindNextChangeNotification(Directory->ChangeHandle)) {
+                FindCloseChangeNotification(Directory->ChangeHandle);
+                Directory->ChangeHandle = NULL;
+            }
+        } else {
+
+            //
+            //  If the directory can't be monitored, check its timestamp,
+            //  but don't go back to the file system on every lookup.
+            //
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1700)
+#pragma warning(suppress: 28159) // Deprecated GetTickCount; overflows are
+                                 // deterministic
+#endif
+            CurrentTick = GetTickCount();
+            if (CurrentTick - Directory->LastCheckTick < YORI_SH_EXEHASH_RECHECK_INTERVAL) {
+                return TRUE;
+            }
+
+            Directory->LastCheckTick = CurrentTick;
+            if (!YoriShExeHashGetDirectoryWriteTime(&Directory->DirectoryName, &LastWriteTime)) {
+                LastWriteTime.dwLowDateTime = 0;
+                LastWriteTime.dwHighDateTime = 0;
+            }
+
+            if (LastWriteTime.dwLowDateTime == Directory->LastWriteTime.dwLowDateTime &&
+                LastWriteTime.dwHighDateTime == Directory->LastWriteTime.dwHighDateTime) {
+
+                return TRUE;
+            }
+        }
+
+        YoriShExeHashFreeDirectoryContents(Directory);
+
+    } else if (Directory->ChangeHandle == NULL) {
+
+        //
+        //  On first use, try to monitor the directory for files being
+        //  created, deleted or renamed.  Some file systems don't support
+        //  this, in which case fall back to checking timestamps.
+        //
+
+        ChangeHandle = FindFirstChangeNotification(Directory->DirectoryName.StartOfString, FALSE, FILE_NOTIFY_CHANGE_FILE_NAME);
+        if (ChangeHandle != INVALID_HANDLE_VALUE && ChangeHandle != NULL) {
+            Directory->ChangeHandle = ChangeHandle;
+        }
+    }
+
+    if (Directory->ChangeHandle == NULL) {
+#if defined(_MSC_VER) && (_MSC_VER >= 1700)
+#pragma warning(suppress: 28159) // Deprecated GetTickCount; overflows are
+                                 // deterministic
+#endif
+        Directory->LastCheckTick = GetTickCount();
+        if (!YoriShExeHashGetDirectoryWriteTime(&Directory->DirectoryName, &Directory->LastWriteTime)) {
+            Directory->LastWriteTime.dwLowDateTime = 0;
+            Directory->LastWriteTime.dwHighDateTime = 0;
+        }
+    }
+
+    if (Directory->FileHash == NULL) {
+        Directory->FileHash = YoriLibAllocateOpenHashTable(YORI_SH_EXEHASH_INITIAL_FILES);
+        if (Directory->FileHash == NULL) {
+            return FALSE;
+        }
+    }
+
+    YoriLibInitEmptyString(&Prefix);
+    if (!YoriShExeHashEnumerateDirectory(&Directory->DirectoryName, &Prefix, YoriShExeHashAddFile, Directory)) {
+        YoriShExeHashFreeDirectoryContents(Directory);
+        return FALSE;
+    }
+
+    Directory->Populated = TRUE;
+    return TRUE;
+}
+
+/**
+ Generate a full path to a file within a directory.
+
+ @param DirectoryName The directory containing the file.
+
+ @param FileName The name of the file within the directory.
+
+ @param FullPath On successful completion, populated with a newly allocated
+        string containing the full path to the file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriShExeHashBuildFullPath(
+    __in PYORI_STRING DirectoryName,
+    __in PYORI_STRING FileName,
+    __out PYORI_STRING FullPath
+    )
+{
+    YORI_STRING RelativePath;
+    LPTSTR FilePart;
+    LPTSTR Seperator;
+
+    Seperator = _T("\\");
+    if (DirectoryName->LengthInChars == 2 &&
+        DirectoryName->StartOfString[1] == ':') {
+
+        Seperator = _T("");
+    } else if (DirectoryName->LengthInChars > 0 &&
+               YoriLibIsSep(DirectoryName->StartOfString[DirectoryName->LengthInChars - 1])) {
+
+        Seperator = _T("");
+    }
+
+    if (!YoriLibAllocateString(&RelativePath, DirectoryName->LengthInChars + FileName->LengthInChars + 2)) {
+        return FALSE;
+    }
+
+    RelativePath.LengthInChars = YoriLibSPrintf(RelativePath.StartOfString, _T("%y%s%y"), DirectoryName, Seperator, FileName);
+
+    YoriLibInitEmptyString(FullPath);
+    if (!YoriLibGetFullPathNameAlloc(&RelativePath, FALSE, FullPath, &FilePart)) {
+        YoriLibFreeStringContents(&RelativePath);
+        return FALSE;
+    }
+
+    YoriLibFreeStringContents(&RelativePath);
+    return TRUE;
+}
+
+/**
+ Context used when searching a directory that is not cached.
+ */
+typedef struct _YORI_SH_EXEHASH_SEARCH_CONTEXT {
+
+    /**
+     The directory being searched.
+     */
+    PYORI_STRING DirectoryName;
+
+    /**
+     The name being searched for, without any trailing wildcard.
+     */
+    PYORI_STRING SearchFor;
+
+    /**
+     If TRUE, every file starting with SearchFor is reported to
+     MatchAllCallback.  If FALSE, the best exact match is returned in
+     BestMatch.
+     */
+    BOOLEAN PartialMatch;
+
+    /**
+     The callback to invoke for each match, if PartialMatch is TRUE.
+     */
+    PYORI_LIB_PATH_MATCH_FN MatchAllCallback;
+
+    /**
+     Context to pass to MatchAllCallback.
+     */
+    PVOID MatchAllContext;
+
+    /**
+     The best exact match found so far, if PartialMatch is FALSE.
+     */
+    YORI_STRING BestMatch;
+
+    /**
+     The PATHEXT index of BestMatch.
+     */
+    YORI_ALLOC_SIZE_T BestPathExtIndex;
+} YORI_SH_EXEHASH_SEARCH_CONTEXT, *PYORI_SH_EXEHASH_SEARCH_CONTEXT;
+
+/**
+ A callback invoked when searching a directory that is not cached for each
+ executable file found.
+
+ @param Context Pointer to the search context.
+
+ @param FileName The name of the file that was found.
+
+ @param BaseNameLength The number of characters in FileName that precede the
+        extension.
+
+ @param PathExtIndex The index of the matching extension within PATHEXT.
+
+ @return TRUE to continue enumerating, FALSE to indicate failure.
+ */
+BOOLEAN
+YoriShExeHashSearchFile(
+    __in PVOID Context,
+    __in PYORI_STRING FileName,
+    __in YORI_ALLOC_SIZE_T BaseNameLength,
+    __in YORI_ALLOC_SIZE_T PathExtIndex
+    )
+{
+    PYORI_SH_EXEHASH_SEARCH_CONTEXT SearchContext = (PYORI_SH_EXEHASH_SEARCH_CONTEXT)Context;
+    YORI_STRING FullPath;
+    BOOL Result;
+
+    if (SearchContext->PartialMatch) {
+        if (!YoriShExeHashBuildFullPath(SearchContext->DirectoryName, FileName, &FullPath)) {
+            return FALSE;
+        }
+        Result = SearchContext->MatchAllCallback(&FullPath, SearchContext->MatchAllContext);
+        YoriLibFreeStringContents(&FullPath);
+        return (BOOLEAN)Result;
+    }
+
+    if (BaseNameLength != SearchContext->SearchFor->LengthInChars) {
+        return TRUE;
+    }
+
+    if (SearchContext->BestMatch.LengthInChars > 0 &&
+        SearchContext->BestPathExtIndex <= PathExtIndex) {
+
+        return TRUE;
+    }
+
+    YoriLibFreeStringContents(&SearchContext->BestMatch);
+    if (!YoriShExeHashBuildFullPath(SearchContext->DirectoryName, FileName, &SearchContext->BestMatch)) {
+        return FALSE;
+    }
+    SearchContext->BestPathExtIndex = PathExtIndex;
+    return TRUE;
+}
+
+/**
+ Search a single directory that is not cached for an executable.
+
+ @param DirectoryName The directory to search.
+
+ @param SearchFor The name to search for, without any trailing wildcard.
+
+ @param PartialMatch If TRUE, report every executable whose name starts with
+        SearchFor to MatchAllCallback.  If FALSE, return the best exact
+        match in FoundPath.
+
+ @param MatchAllCallback The callback to invoke for each match if
+        PartialMatch is TRUE.
+
+ @param MatchAllContext Context to pass to MatchAllCallback.
+
+ @param FoundPath On successful completion, if PartialMatch is FALSE, updated
+        to contain a newly allocated string with the full path to the match,
+        or an empty string if no match was found.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriShExeHashSearchUncachedDirectory(
+    __in PYORI_STRING DirectoryName,
+    __in PYORI_STRING SearchFor,
+    __in BOOLEAN PartialMatch,
+    __in_opt PYORI_LIB_PATH_MATCH_FN MatchAllCallback,
+    __in_opt PVOID MatchAllContext,
+    __out PYORI_STRING FoundPath
+    )
+{
+    YORI_SH_EXEHASH_SEARCH_CONTEXT SearchContext;
+
+    SearchContext.DirectoryName = DirectoryName;
+    SearchContext.SearchFor = SearchFor;
+    SearchContext.PartialMatch = PartialMatch;
+    SearchContext.MatchAllCallback = MatchAllCallback;
+    SearchContext.MatchAllContext = MatchAllContext;
+    SearchContext.BestPathExtIndex = 0;
+    YoriLibInitEmptyString(&SearchContext.BestMatch);
+
+    if (!YoriShExeHashEnumerateDirectory(DirectoryName, SearchFor, YoriShExeHashSearchFile, &SearchContext)) {
+        YoriLibFreeStringContents(&SearchContext.BestMatch);
+        return FALSE;
+    }
+
+    memcpy(FoundPath, &SearchContext.BestMatch, sizeof(YORI_STRING));
+    return TRUE;
+}
+
+/**
+ Search a single PATH directory for an executable, using the cache if the
+ directory is cacheable.
+
+ @param Directory The directory to search.
+
+ @param SearchFor The name to search for, without any trailing wildcard.
+
+ @param PartialMatch If TRUE, report every executable whose name starts with
+        SearchFor to MatchAllCallback.  If FALSE, return the best exact
+        match in FoundPath.
+
+ @param MatchAllCallback The callback to invoke for each match if
+        PartialMatch is TRUE.
+
+ @param MatchAllContext Context to pass to MatchAllCallback.
+
+ @param FoundPath On successful completion, if PartialMatch is FALSE, updated
+        to contain a newly allocated string with the full path to the match,
+        or an empty string if no match was found.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriShExeHashSearchDirectory(
+    __in PYORI_SH_EXEHASH_DIRECTORY Directory,
+    __in PYORI_STRING SearchFor,
+    __in BOOLEAN PartialMatch,
+    __in_opt PYORI_LIB_PATH_MATCH_FN MatchAllCallback,
+    __in_opt PVOID MatchAllContext,
+    __out PYORI_STRING FoundPath
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_OPEN_HASH_ENTRY HashEntry;
+    PYORI_SH_EXEHASH_FILE File;
+    YORI_STRING FullPath;
+
+    YoriLibInitEmptyString(FoundPath);
+
+    if (!Directory->Cacheable) {
+        return YoriShExeHashSearchUncachedDirectory(&Directory->DirectoryName, SearchFor, PartialMatch, MatchAllCallback, MatchAllContext, FoundPath);
+    }
+
+    if (!YoriShExeHashRefreshDirectory(Directory)) {
+        return FALSE;
+    }
+
+    if (!PartialMatch) {
+        HashEntry = YoriLibOpenHashLookupByKey(Directory->FileHash, SearchFor);
+        if (HashEntry == NULL) {
+            return TRUE;
+        }
+
+        File = (PYORI_SH_EXEHASH_FILE)HashEntry->Context;
+        if (!YoriShExeHashBuildFullPath(&Directory->DirectoryName, &File->FileName, FoundPath)) {
+            return FALSE;
+        }
+        File->Hits++;
+        return TRUE;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&Directory->FileList, NULL);
+    while (ListEntry != NULL) {
+        File = CONTAINING_RECORD(ListEntry, YORI_SH_EXEHASH_FILE, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&Directory->FileList, ListEntry);
+        if (YoriLibCompareStringInsCnt(&File->FileName, SearchFor, SearchFor->LengthInChars) == 0) {
+            if (!YoriShExeHashBuildFullPath(&Directory->DirectoryName, &File->FileName, &FullPath)) {
+                return FALSE;
+            }
+            if (!MatchAllCallback(&FullPath, MatchAllContext)) {
+                YoriLibFreeStringContents(&FullPath);
+                return FALSE;
+            }
+            YoriLibFreeStringContents(&FullPath);
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Search for an executable within the current directory and PATH, consulting
+ the executable cache for directories in PATH.  This has the same semantics
+ as @ref YoriLibLocateExecutableInPath , which is used directly if the
+ request refers to a path or extension, contains wildcards, or if the cache
+ cannot be used.
+
+ @param SearchFor The file name to search for.  If MatchAllCallback is
+        specified, this can end in a single '*' to find all executables
+        whose name begins with the specified string.
+
+ @param MatchAllCallback An optional callback to invoke each time a
+        candidate match is found.
+
+ @param MatchAllContext Context information to supply to MatchAllCallback
+        if it is specified.
+
+ @param PathName On successful completion, if MatchAllCallback is not
+        specified, updated to contain a newly allocated string describing the
+        first match, or an empty string if no match was found.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriShLocateExecutableInPath(
+    __in PYORI_STRING SearchFor,
+    __in_opt PYORI_LIB_PATH_MATCH_FN MatchAllCallback,
+    __in_opt PVOID MatchAllContext,
+    __out PYORI_STRING PathName
+    )
+{
+    YORI_STRING BaseName;
+    YORI_STRING FoundPath;
+    YORI_STRING CurrentDirectory;
+    YORI_ALLOC_SIZE_T Index;
+    BOOLEAN PartialMatch;
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_SH_EXEHASH_DIRECTORY Directory;
+
+    //
+    //  Only plain names are cached.  Anything with a path, extension, or
+    //  wildcard other than a single trailing '*' for completion goes to the
+    //  general purpose resolver.
+    //
+
+    YoriLibInitEmptyString(&BaseName);
+    BaseName.StartOfString = SearchFor->StartOfString;
+    BaseName.LengthInChars = SearchFor->LengthInChars;
+    PartialMatch = FALSE;
+
+    if (MatchAllCallback != NULL &&
+        BaseName.LengthInChars > 0 &&
+        BaseName.StartOfString[BaseName.LengthInChars - 1] == '*') {
+
+        BaseName.LengthInChars--;
+        PartialMatch = TRUE;
+    }
+
+    for (Index = 0; Index < BaseName.LengthInChars; Index++) {
+        if (BaseName.StartOfString[Index] == '.' ||
+            BaseName.StartOfString[Index] == ':' ||
+            BaseName.StartOfString[Index] == '*' ||
+            BaseName.StartOfString[Index] == '?' ||
+            YoriLibIsSep(BaseName.StartOfString[Index])) {
+
+            break;
+        }
+    }
+
+    if (Index < BaseName.LengthInChars ||
+        (BaseName.LengthInChars == 0 && !PartialMatch) ||
+        (MatchAllCallback != NULL && !PartialMatch) ||
+        !YoriShExeHashSyncWithEnvironment()) {
+
+        return YoriLibLocateExecutableInPath(SearchFor, MatchAllCallback, MatchAllContext, PathName);
+    }
+
+    //
+    //  The current directory is searched first, and is never cached.
+    //
+
+    YoriLibConstantString(&CurrentDirectory, _T("."));
+    if (!YoriShExeHashSearchUncachedDirectory(&CurrentDirectory, &BaseName, PartialMatch, MatchAllCallback, MatchAllContext, &FoundPath)) {
+        return FALSE;
+    }
+
+    if (FoundPath.LengthInChars == 0) {
+        ListEntry = YoriLibGetNextListEntry(&YoriShExeHash.DirectoryList, NULL);
+        while (ListEntry != NULL) {
+            Directory = CONTAINING_RECORD(ListEntry, YORI_SH_EXEHASH_DIRECTORY, ListEntry);
+            if (!YoriShExeHashSearchDirectory(Directory, &BaseName, PartialMatch, MatchAllCallback, MatchAllContext, &FoundPath)) {
+                return FALSE;
+            }
+            if (FoundPath.LengthInChars > 0) {
+                break;
+            }
+            ListEntry = YoriLibGetNextListEntry(&YoriShExeHash.DirectoryList, ListEntry);
+        }
+    }
+
+    if (MatchAllCallback != NULL) {
+        YoriLibFreeStringContents(&FoundPath);
+        YoriLibInitEmptyString(PathName);
+    } else {
+        memcpy(PathName, &FoundPath, sizeof(YORI_STRING));
+    }
+
+    return TRUE;
+}
+
+/**
+ Build the set of executables that have been located via the executable
+ cache into an array of key value pairs, where the key is the command name
+ and the value is the path to the executable.
+
+ @param CacheStrings On successful completion, populated with a newly
+        allocated set of NULL terminated strings, terminated by an additional
+        NULL.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriShGetExecutableCacheStrings(
+    __inout PYORI_STRING CacheStrings
+    )
+{
+    YORI_ALLOC_SIZE_T CharsNeeded;
+    YORI_ALLOC_SIZE_T StringOffset;
+    YORI_ALLOC_SIZE_T Pass;
+    PYORI_LIST_ENTRY DirectoryEntry;
+    PYORI_LIST_ENTRY FileEntry;
+    PYORI_SH_EXEHASH_DIRECTORY Directory;
+    PYORI_SH_EXEHASH_FILE File;
+    YORI_STRING BaseName;
+    LPTSTR Seperator;
+
+    CharsNeeded = 1;
+    StringOffset = 0;
+
+    //
+    //  The first pass counts the space needed, and the second pass fills it
+    //  in.
+    //
+
+    for (Pass = 0; Pass < 2; Pass++) {
+
+        if (Pass == 1) {
+            YoriLibFreeStringContents(CacheStrings);
+            if (!YoriLibAllocateString(CacheStrings, CharsNeeded)) {
+                return FALSE;
+            }
+        }
+
+        if (YoriShExeHash.Valid) {
+            DirectoryEntry = YoriLibGetNextListEntry(&YoriShExeHash.DirectoryList, NULL);
+            while (DirectoryEntry != NULL) {
+                Directory = CONTAINING_RECORD(DirectoryEntry, YORI_SH_EXEHASH_DIRECTORY, ListEntry);
+                Seperator = _T("\\");
+                if (Directory->DirectoryName.LengthInChars > 0 &&
+                    YoriLibIsSep(Directory->DirectoryName.StartOfString[Directory->DirectoryName.LengthInChars - 1])) {
+
+                    Seperator = _T("");
+                }
+
+                FileEntry = YoriLibGetNextListEntry(&Directory->FileList, NULL);
+                while (FileEntry != NULL) {
+                    File = CONTAINING_RECORD(FileEntry, YORI_SH_EXEHASH_FILE, ListEntry);
+                    if (File->Hits > 0) {
+                        if (Pass == 0) {
+                            CharsNeeded += File->BaseNameLength + 1 + Directory->DirectoryName.LengthInChars + 1 + File->FileName.LengthInChars + 1;
+                        } else {
+                            YoriLibInitEmptyString(&BaseName);
+                            BaseName.StartOfString = File->FileName.StartOfString;
+                            BaseName.LengthInChars = File->BaseNameLength;
+                            StringOffset += YoriLibSPrintf(&CacheStrings->StartOfString[StringOffset], _T("%y=%y%s%y"), &BaseName, &Directory->DirectoryName, Seperator, &File->FileName);
+                            StringOffset++;
+                        }
+                    }
+                    FileEntry = YoriLibGetNextListEntry(&Directory->FileList, FileEntry);
+                }
+                DirectoryEntry = YoriLibGetNextListEntry(&YoriShExeHash.DirectoryList, DirectoryEntry);
+            }
+        }
+    }
+
+    CacheStrings->StartOfString[StringOffset] = '\0';
+    CacheStrings->LengthInChars = StringOffset;
+    return TRUE;
+}
+
+// vim:sw=4:ts=4:et:
@@ -3,7 +3,7 @@
  *
  * Parses an expression into component pieces
  *
- * Copyright (c) 2014-2020 Malcolm J. Smith
+ * Copyright (c) 2014-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -57,7 +57,7 @@ YoriShResolveCommandToExecutable(
         YoriLibCloneString(&ExpandedCmd, &CmdContext->ArgV[0]);
     }
 
-    if (YoriLibLocateExecutableInPath(&ExpandedCmd, NULL, NULL, &FoundExecutable)) {
+    if (YoriShLocateExecutableInPath(&ExpandedCmd, NULL, NULL, &FoundExecutable)) {
 
         if (FoundExecutable.LengthInChars > 0) {
             YoriLibFreeStringContents(&CmdContext->ArgV[0]);
@@ -3,7 +3,7 @@
  *
  * Yori shell function declaration header file
  *
- * Copyright (c) 2017-2019 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -280,6 +280,26 @@ YoriShExecuteExpression(
     __in PYORI_STRING Expression
     );
 
+// *** EXEHASH.C ***
+
+VOID
+YoriShClearExecutableCache(VOID);
+
+__success(return)
+BOOLEAN
+YoriShLocateExecutableInPath(
+    __in PYORI_STRING SearchFor,
+    __in_opt PYORI_LIB_PATH_MATCH_FN MatchAllCallback,
+    __in_opt PVOID MatchAllContext,
+    __out PYORI_STRING PathName
+    );
+
+__success(return)
+BOOLEAN
+YoriShGetExecutableCacheStrings(
+    __inout PYORI_STRING CacheStrings
+    );
+
 // *** HISTORY.C ***
 
 __success(return)
@@ -3,7 +3,7 @@
  *
  * Yori table of supported builtins for the regular build of Yori
  *
- * Copyright (c) 2017-2019 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -51,6 +51,11 @@ YORI_CMD_BUILTIN YoriCmd_DIRENV;
  */
 YORI_CMD_BUILTIN YoriCmd_YECHO;
 
+/**
+ Declaration for the builtin command.
+ */
+YORI_CMD_BUILTIN YoriCmd_EXEHASH;
+
 /**
  Declaration for the builtin command.
  */
@@ -161,6 +166,7 @@ YoriShBuiltins[] = {
                     {_T("COLOR"),     YoriCmd_COLOR},
                     {_T("DIRENV"),    YoriCmd_DIRENV},
                     {_T("ECHO"),      YoriCmd_YECHO},
+                    {_T("EXEHASH"),   YoriCmd_EXEHASH},
                     {_T("EXIT"),      YoriCmd_EXIT},
                     {_T("FALSE"),     YoriCmd_FALSE},
                     {_T("FG"),        YoriCmd_FG},
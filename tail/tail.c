@@ -3,7 +3,7 @@
  *
  * Yori shell display the final lines in a file
  *
- * Copyright (c) 2017-2019 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -32,6 +32,14 @@
  */
 #define MAX_LINE_COUNT (1*1024*1024)
 
+/**
+ The maximum number of milliseconds between checks of every followed file.
+ File systems can defer updating a file's size in its directory while
+ another process has the file open, so notifications alone may not report
+ every write.
+ */
+#define TAIL_FOLLOW_RECHECK_INTERVAL (1000)
+
 #if defined(_MSC_VER) && _MSC_VER >= 900
 #pragma warning(disable: 4220) // Varargs matches remaining parameters
 #endif
@@ -44,12 +52,13 @@ CHAR strTailHelpText[] =
         "\n"
         "Output the final lines of one or more files.\n"
         "\n"
-        "TAIL [-license] [-b] [-f] [-s] [-n count] [-c line] [<file>...]\n"
+        "TAIL [-license] [-b] [-f] [-p] [-s] [-n count] [-c line] [<file>...]\n"
         "\n"
         "   -b             Use basic search criteria for files only\n"
         "   -c             Specify a line to display context around instead of EOF\n"
-        "   -f             Wait for new output and continue outputting\n"
+        "   -f             Wait for new output in all files and continue outputting\n"
         "   -n             Specify the number of lines to display\n"
+        "   -p             Prefix each line with the name of its file\n"
         "   -s             Process files from all subdirectories\n";
 
 /**
@@ -66,6 +75,98 @@ TailHelp(VOID)
     return TRUE;
 }
 
+/**
+ A directory containing one or more files that are being followed.
+ */
+typedef struct _TAIL_DIRECTORY {
+
+    /**
+     The entry for this directory on the list of followed directories.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The full path to the directory.
+     */
+    YORI_STRING DirectoryName;
+
+    /**
+     A change notification handle which is signalled when files in the
+     directory are written, resized, created, deleted or renamed.  This can
+     be NULL if the file system does not support change notifications, in
+     which case files are checked periodically.
+     */
+    HANDLE ChangeHandle;
+
+} TAIL_DIRECTORY, *PTAIL_DIRECTORY;
+
+/**
+ Information which uniquely identifies a file, used to detect when the file
+ at a path has been replaced.
+ */
+typedef struct _TAIL_FILE_IDENTITY {
+
+    /**
+     The serial number of the volume containing the file.
+     */
+    DWORD VolumeSerialNumber;
+
+    /**
+     The high 32 bits of the file's identifier within its volume.
+     */
+    DWORD FileIndexHigh;
+
+    /**
+     The low 32 bits of the file's identifier within its volume.
+     */
+    DWORD FileIndexLow;
+
+} TAIL_FILE_IDENTITY, *PTAIL_FILE_IDENTITY;
+
+/**
+ A single file whose lines are being displayed.
+ */
+typedef struct _TAIL_FILE {
+
+    /**
+     The entry for this file on the list of followed files.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The full path to the file, used to check whether it has been replaced.
+     This is empty when reading from standard input, which is not closed.
+     */
+    YORI_STRING FilePath;
+
+    /**
+     The name of the file to display when prefixing lines.
+     */
+    YORI_STRING DisplayName;
+
+    /**
+     A handle to the opened file.
+     */
+    HANDLE FileHandle;
+
+    /**
+     The line reading context for the file.  This retains any partial line
+     that has not yet been terminated.
+     */
+    PVOID LineContext;
+
+    /**
+     The directory containing the file, if it is being followed.
+     */
+    PTAIL_DIRECTORY Directory;
+
+    /**
+     The identity of the file that FileHandle refers to.
+     */
+    TAIL_FILE_IDENTITY Identity;
+
+} TAIL_FILE, *PTAIL_FILE;
+
 /**
  Context passed to the callback which is invoked for each file found.
  */
@@ -134,13 +235,55 @@ typedef struct _TAIL_CONTEXT {
      */
     BOOLEAN StartLineSpecified;
 
+    /**
+     TRUE if each line should be prefixed with the name of its file.
+     */
+    BOOLEAN PrefixFileName;
+
+    /**
+     A list of files to follow once the requested lines from every file
+     have been output.
+     */
+    YORI_LIST_ENTRY FollowFiles;
+
+    /**
+     A list of directories containing followed files.
+     */
+    YORI_LIST_ENTRY FollowDirectories;
+
 } TAIL_CONTEXT, *PTAIL_CONTEXT;
 
+/**
+ Output a line from a file, prefixed with the name of the file if requested.
+
+ @param TailContext Pointer to context information specifying how to display
+        lines.
+
+ @param TailFile Pointer to the file that the line was read from.
+
+ @param LineString Pointer to the line to output.
+ */
+VOID
+TailOutputLine(
+    __in PTAIL_CONTEXT TailContext,
+    __in PTAIL_FILE TailFile,
+    __in PYORI_STRING LineString
+    )
+{
+    if (TailContext->PrefixFileName && TailFile->DisplayName.LengthInChars > 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y: %y\n"), &TailFile->DisplayName, LineString);
+    } else {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), LineString);
+    }
+}
+
 /**
  Process a single opened stream, enumerating through all lines and displaying
- the set requested by the user.
+ the set requested by the user.  If the user requested that tail wait for
+ more output, the final partial line is retained in the file's line context
+ so it can be completed when following the file.
 
- @param hSource The opened source stream.
+ @param TailFile Pointer to the opened file.
 
  @param TailContext Pointer to context information specifying which lines to
         display.
@@ -149,135 +292,528 @@ typedef struct _TAIL_CONTEXT {
  */
 BOOL
 TailProcessStream(
-    __in HANDLE hSource,
+    __in PTAIL_FILE TailFile,
     __in PTAIL_CONTEXT TailContext
     )
 {
-    PVOID LineContext = NULL;
+    HANDLE hSource = TailFile->FileHandle;
     YORI_MAX_UNSIGNED_T StartLine = 0;
     YORI_MAX_UNSIGNED_T CurrentLine;
     PYORI_STRING LineString;
     YORI_LIB_LINE_ENDING LineEnding;
     BOOL TimeoutReached;
-    DWORD SeekToEndOffset = 0;
-    DWORD Err;
-    DWORD BytesWritten;
+    YORI_MAX_UNSIGNED_T FinalLinesOffset;
 
     DWORD FileType = GetFileType(hSource);
     FileType = FileType & ~(FILE_TYPE_REMOTE);
 
     //
-    //  If it's a file and we want the final few lines, start searching
-    //  from the end, assuming an average line size of 256 bytes.
+    //  If it's a file and we want the final few lines, find where they
+    //  begin by scanning backwards from the end of the file, so the lines
+    //  before them are never read.  If that fails, read the whole file.
     //
 
     if (FileType == FILE_TYPE_DISK &&
         !TailContext->StartLineSpecified &&
         TailContext->FinalLine == 0) {
 
-        SeekToEndOffset = 256 * TailContext->LinesToDisplay;
+        if (!YoriLibFindFinalLines(hSource, TailContext->LinesToDisplay, &FinalLinesOffset)) {
+            if (YoriLibIsOperationCancelled()) {
+                return FALSE;
+            }
+            SetFilePointer(hSource, 0L, NULL, FILE_BEGIN);
+        }
     }
 
     TailContext->FilesFound++;
     TailContext->FilesFoundThisArg++;
+    TailContext->LinesFound = 0;
 
     while (TRUE) {
 
-        if (SeekToEndOffset != 0) {
-            if (!SetFilePointer(hSource, -1 * SeekToEndOffset, NULL, FILE_END)) {
-                SeekToEndOffset = 0;
-                SetFilePointer(hSource, 0L, NULL, FILE_BEGIN);
-            }
+        if (!YoriLibReadLineToStringEx(&TailContext->LinesArray[TailContext->LinesFound % TailContext->LinesToDisplay],
+                                       &TailFile->LineContext,
+                                       !TailContext->WaitForMore,
+                                       INFINITE,
+                                       hSource,
+                                       &LineEnding,
+                                       &TimeoutReached)) {
+            break;
         }
-        TailContext->LinesFound = 0;
 
-        while (TRUE) {
+        TailContext->LinesFound++;
 
-            if (!YoriLibReadLineToStringEx(&TailContext->LinesArray[TailContext->LinesFound % TailContext->LinesToDisplay],
-                                           &LineContext,
-                                           !TailContext->WaitForMore,
-                                           INFINITE,
-                                           hSource,
-                                           &LineEnding,
-                                           &TimeoutReached)) {
-                break;
-            }
+        if (TailContext->FinalLine != 0 && TailContext->LinesFound >= TailContext->FinalLine) {
+            break;
+        }
+    }
 
-            TailContext->LinesFound++;
+    if (TailContext->StartLineSpecified) {
+        StartLine = TailContext->StartLine;
+    } else if (TailContext->LinesFound > TailContext->LinesToDisplay) {
+        StartLine = TailContext->LinesFound - TailContext->LinesToDisplay;
+    }
 
-            if (TailContext->FinalLine != 0 && TailContext->LinesFound >= TailContext->FinalLine) {
-                break;
-            }
+    for (CurrentLine = StartLine; CurrentLine < TailContext->LinesFound; CurrentLine++) {
+        LineString = &TailContext->LinesArray[CurrentLine % TailContext->LinesToDisplay];
+        TailOutputLine(TailContext, TailFile, LineString);
+    }
+
+    return TRUE;
+}
+
+/**
+ Query the identity of the file that a handle refers to, so that it can be
+ compared against the file found at the same path later.
+
+ @param FileHandle Handle to the file.
+
+ @param Identity On completion, populated with the identity of the file.  If
+        this cannot be determined, it is zero.
+ */
+VOID
+TailGetFileIdentity(
+    __in HANDLE FileHandle,
+    __out PTAIL_FILE_IDENTITY Identity
+    )
+{
+    BY_HANDLE_FILE_INFORMATION FileInfo;
+
+    if (!GetFileInformationByHandle(FileHandle, &FileInfo)) {
+        ZeroMemory(&FileInfo, sizeof(FileInfo));
+    }
+
+    Identity->VolumeSerialNumber = FileInfo.dwVolumeSerialNumber;
+    Identity->FileIndexHigh = FileInfo.nFileIndexHigh;
+    Identity->FileIndexLow = FileInfo.nFileIndexLow;
+}
+
+/**
+ Open a file for reading, allowing other processes to continue writing,
+ renaming and deleting it.
+
+ @param FilePath Pointer to the full path to the file.
+
+ @return Handle to the file, or INVALID_HANDLE_VALUE on failure.
+ */
+HANDLE
+TailOpenFile(
+    __in PYORI_STRING FilePath
+    )
+{
+    HANDLE FileHandle;
+
+    FileHandle = CreateFile(FilePath->StartOfString,
+                            GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS,
+                            NULL);
+
+    if (FileHandle == NULL) {
+        FileHandle = INVALID_HANDLE_VALUE;
+    }
+
+    return FileHandle;
+}
+
+/**
+ Close a file and free the structure describing it.
+
+ @param TailFile Pointer to the file to free.
+ */
+VOID
+TailFreeFile(
+    __in PTAIL_FILE TailFile
+    )
+{
+    YoriLibLineReadCloseOrCache(TailFile->LineContext);
+    if (TailFile->FilePath.LengthInChars > 0) {
+        CloseHandle(TailFile->FileHandle);
+    }
+    YoriLibFreeStringContents(&TailFile->FilePath);
+    YoriLibFreeStringContents(&TailFile->DisplayName);
+    YoriLibFree(TailFile);
+}
+
+/**
+ Output any complete lines that have been added to a file since it was last
+ read.
+
+ @param TailContext Pointer to context information specifying how to display
+        lines.
+
+ @param TailFile Pointer to the file to read.
+
+ @param FinalLines If TRUE, the file will not be read again, so a final line
+        without a line ending should be output.  If FALSE, a partial line is
+        retained until it is completed.
+ */
+VOID
+TailReadNewLines(
+    __in PTAIL_CONTEXT TailContext,
+    __in PTAIL_FILE TailFile,
+    __in BOOLEAN FinalLines
+    )
+{
+    YORI_LIB_LINE_ENDING LineEnding;
+    BOOL TimeoutReached;
+
+    while (YoriLibReadLineToStringEx(&TailContext->LinesArray[0],
+                                     &TailFile->LineContext,
+                                     FinalLines,
+                                     INFINITE,
+                                     TailFile->FileHandle,
+                                     &LineEnding,
+                                     &TimeoutReached)) {
+
+        TailOutputLine(TailContext, TailFile, &TailContext->LinesArray[0]);
+    }
+}
+
+/**
+ Check a followed file for new lines.  If the file has been truncated, it
+ is displayed again from the beginning.  If the path now refers to a
+ different file, which happens when logs are rotated, the remainder of the
+ previous file is output and the new file is followed from its beginning.
+
+ @param TailContext Pointer to context information specifying how to display
+        lines.
+
+ @param TailFile Pointer to the file to check.
+ */
+VOID
+TailCheckFile(
+    __in PTAIL_CONTEXT TailContext,
+    __in PTAIL_FILE TailFile
+    )
+{
+    TAIL_FILE_IDENTITY NewIdentity;
+    HANDLE NewHandle;
+    DWORD SizeHigh;
+    DWORD SizeLow;
+    LONG PositionHigh;
+    DWORD PositionLow;
+    YORI_MAX_UNSIGNED_T FileSize;
+    YORI_MAX_UNSIGNED_T Position;
+
+    //
+    //  If the file is now smaller than the amount that has been read from
+    //  it, it has been truncated, and any buffered data is stale.
+    //
+
+    SizeLow = GetFileSize(TailFile->FileHandle, &SizeHigh);
+    PositionHigh = 0;
+    PositionLow = SetFilePointer(TailFile->FileHandle, 0, &PositionHigh, FILE_CURRENT);
+    if ((SizeLow != INVALID_FILE_SIZE || GetLastError() == NO_ERROR) &&
+        (PositionLow != INVALID_SET_FILE_POINTER || GetLastError() == NO_ERROR)) {
+
+        FileSize = ((YORI_MAX_UNSIGNED_T)SizeHigh << 32) | SizeLow;
+        Position = ((YORI_MAX_UNSIGNED_T)(DWORD)PositionHigh << 32) | PositionLow;
+        if (FileSize < Position) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("tail: %y: file truncated\n"), &TailFile->DisplayName);
+            YoriLibLineReadCloseOrCache(TailFile->LineContext);
+            TailFile->LineContext = NULL;
+            SetFilePointer(TailFile->FileHandle, 0, NULL, FILE_BEGIN);
         }
+    }
 
-        if (TailContext->StartLineSpecified) {
-            StartLine = TailContext->StartLine;
-            break;
-        } else if (TailContext->LinesFound > TailContext->LinesToDisplay) {
-            StartLine = TailContext->LinesFound - TailContext->LinesToDisplay;
-            break;
-        } else if (SeekToEndOffset != 0) {
-            DWORD DesiredSeek;
-            DesiredSeek = 4096;
-            DesiredSeek = DesiredSeek * TailContext->LinesToDisplay;
-
-            //
-            //  If we didn't get enough lines and we have a file that
-            //  supports arbitrary seeks, try to grab more data.  If
-            //  we've already hit our arbitrary maximum (a 4Kb average
-            //  line size) start scanning from the top.
-            //
-
-            if (SeekToEndOffset < DesiredSeek) {
-                SeekToEndOffset = DesiredSeek;
-            } else {
-                SeekToEndOffset = 0;
-                SetFilePointer(hSource, 0L, NULL, FILE_BEGIN);
+    TailReadNewLines(TailContext, TailFile, FALSE);
+
+    if (TailFile->FilePath.LengthInChars == 0) {
+        return;
+    }
+
+    //
+    //  Check whether the path still refers to the file being followed.  If
+    //  the path doesn't exist, the file may have been renamed and a new one
+    //  not yet created, so keep following the existing file.
+    //
+
+    NewHandle = TailOpenFile(&TailFile->FilePath);
+    if (NewHandle == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    TailGetFileIdentity(NewHandle, &NewIdentity);
+    if (NewIdentity.VolumeSerialNumber == TailFile->Identity.VolumeSerialNumber &&
+        NewIdentity.FileIndexHigh == TailFile->Identity.FileIndexHigh &&
+        NewIdentity.FileIndexLow == TailFile->Identity.FileIndexLow) {
+
+        CloseHandle(NewHandle);
+        return;
+    }
+
+    TailReadNewLines(TailContext, TailFile, TRUE);
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("tail: %y has been replaced; following new file\n"), &TailFile->DisplayName);
+
+    YoriLibLineReadCloseOrCache(TailFile->LineContext);
+    TailFile->LineContext = NULL;
+    CloseHandle(TailFile->FileHandle);
+    TailFile->FileHandle = NewHandle;
+    memcpy(&TailFile->Identity, &NewIdentity, sizeof(TAIL_FILE_IDENTITY));
+
+    TailReadNewLines(TailContext, TailFile, FALSE);
+}
+
+/**
+ Add a file to the set of files to follow, and request change notifications
+ for the directory containing it.
+
+ @param TailContext Pointer to context information containing the files
+        being followed.
+
+ @param TailFile Pointer to the file to follow.
+ */
+VOID
+TailFollowFile(
+    __in PTAIL_CONTEXT TailContext,
+    __in PTAIL_FILE TailFile
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PTAIL_DIRECTORY Directory;
+    YORI_STRING DirectoryName;
+    LPTSTR FilePart;
+
+    YoriLibAppendList(&TailContext->FollowFiles, &TailFile->ListEntry);
+
+    if (TailFile->FilePath.LengthInChars == 0) {
+        return;
+    }
+
+    FilePart = YoriLibFindRightMostCharacter(&TailFile->FilePath, '\\');
+    if (FilePart == NULL) {
+        return;
+    }
+
+    YoriLibInitEmptyString(&DirectoryName);
+    DirectoryName.StartOfString = TailFile->FilePath.StartOfString;
+    DirectoryName.LengthInChars = (YORI_ALLOC_SIZE_T)(FilePart - DirectoryName.StartOfString);
+
+    //
+    //  The root of a volume needs its trailing backslash, or the name
+    //  refers to the volume rather than the directory.
+    //
+
+    if (DirectoryName.LengthInChars > 0 &&
+        DirectoryName.StartOfString[DirectoryName.LengthInChars - 1] == ':') {
+
+        DirectoryName.LengthInChars++;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&TailContext->FollowDirectories, NULL);
+    while (ListEntry != NULL) {
+        Directory = CONTAINING_RECORD(ListEntry, TAIL_DIRECTORY, ListEntry);
+        if (YoriLibCompareStringIns(&Directory->DirectoryName, &DirectoryName) == 0) {
+            TailFile->Directory = Directory;
+            return;
+        }
+        ListEntry = YoriLibGetNextListEntry(&TailContext->FollowDirectories, ListEntry);
+    }
+
+    Directory = YoriLibMalloc(sizeof(TAIL_DIRECTORY));
+    if (Directory == NULL) {
+        return;
+    }
+
+    ZeroMemory(Directory, sizeof(TAIL_DIRECTORY));
+    if (!YoriLibCopyString(&Directory->DirectoryName, &DirectoryName)) {
+        YoriLibFree(Directory);
+        return;
+    }
+
+    //
+    //  Some file systems don't support change notifications, in which case
+    //  files in the directory are checked periodically.
+    //
+
+    Directory->ChangeHandle = FindFirstChangeNotification(Directory->DirectoryName.StartOfString,
+                                                          FALSE,
+                                                          FILE_NOTIFY_CHANGE_FILE_NAME |
+                                                            FILE_NOTIFY_CHANGE_SIZE |
+                                                            FILE_NOTIFY_CHANGE_LAST_WRITE);
+    if (Directory->ChangeHandle == INVALID_HANDLE_VALUE) {
+        Directory->ChangeHandle = NULL;
+    }
+
+    YoriLibAppendList(&TailContext->FollowDirectories, &Directory->ListEntry);
+    TailFile->Directory = Directory;
+}
+
+/**
+ Return the number of milliseconds since the system was started.  This wraps
+ after 49 days, so only the difference between two values is meaningful.
+
+ @return The number of milliseconds since the system was started.
+ */
+DWORD
+TailGetTickCount(VOID)
+{
+#if defined(_MSC_VER) && (_MSC_VER >= 1700)
+#pragma warning(suppress: 28159) // Deprecated GetTickCount; overflows are
+                                 // deterministic
+#endif
+    return GetTickCount();
+}
+
+/**
+ Wait for changes to any followed file and output new lines as they arrive,
+ until the operation is cancelled or the output is closed.  Files are
+ checked when the directory containing them reports a change, and all files
+ are checked at least once every TAIL_FOLLOW_RECHECK_INTERVAL, even if
+ change notifications keep arriving.
+
+ @param TailContext Pointer to context information containing the files to
+        follow.
+ */
+VOID
+TailFollowFiles(
+    __in PTAIL_CONTEXT TailContext
+    )
+{
+    HANDLE WaitHandles[MAXIMUM_WAIT_OBJECTS];
+    PTAIL_DIRECTORY WaitDirectories[MAXIMUM_WAIT_OBJECTS];
+    PYORI_LIST_ENTRY ListEntry;
+    PTAIL_DIRECTORY Directory;
+    PTAIL_FILE TailFile;
+    HANDLE CancelEvent;
+    DWORD HandleCount;
+    DWORD FirstDirectory;
+    DWORD WaitResult;
+    DWORD BytesWritten;
+    DWORD Err;
+    DWORD LastFullCheck;
+    DWORD Elapsed;
+    DWORD Timeout;
+
+    LastFullCheck = TailGetTickCount();
+
+    while (TRUE) {
+
+        HandleCount = 0;
+        CancelEvent = YoriLibCancelGetEvent();
+        if (CancelEvent != NULL) {
+            WaitHandles[HandleCount] = CancelEvent;
+            HandleCount++;
+        }
+
+        FirstDirectory = HandleCount;
+        ListEntry = YoriLibGetNextListEntry(&TailContext->FollowDirectories, NULL);
+        while (ListEntry != NULL && HandleCount < MAXIMUM_WAIT_OBJECTS) {
+            Directory = CONTAINING_RECORD(ListEntry, TAIL_DIRECTORY, ListEntry);
+            if (Directory->ChangeHandle != NULL) {
+                WaitHandles[HandleCount] = Directory->ChangeHandle;
+                WaitDirectories[HandleCount] = Directory;
+                HandleCount++;
             }
-            YoriLibLineReadCloseOrCache(LineContext);
-            LineContext = NULL;
-            continue;
+            ListEntry = YoriLibGetNextListEntry(&TailContext->FollowDirectories, ListEntry);
+        }
+
+        Elapsed = TailGetTickCount() - LastFullCheck;
+        Timeout = 0;
+        if (Elapsed < TAIL_FOLLOW_RECHECK_INTERVAL) {
+            Timeout = TAIL_FOLLOW_RECHECK_INTERVAL - Elapsed;
+        }
+
+        if (HandleCount > 0) {
+            WaitResult = WaitForMultipleObjects(HandleCount, WaitHandles, FALSE, Timeout);
         } else {
-            StartLine = 0;
+            Sleep(Timeout);
+            WaitResult = WAIT_TIMEOUT;
+        }
+
+        if (YoriLibIsOperationCancelled()) {
             break;
         }
-    }
 
-    for (CurrentLine = StartLine; CurrentLine < TailContext->LinesFound; CurrentLine++) {
-        LineString = &TailContext->LinesArray[CurrentLine % TailContext->LinesToDisplay];
-        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), LineString);
-    }
+        //
+        //  If a directory reported a change, only check the files within
+        //  it, unless it is time to check all files.  Otherwise check all
+        //  files.
+        //
 
-    if (TailContext->WaitForMore) {
-        while (TRUE) {
+        Directory = NULL;
+        if (WaitResult >= WAIT_OBJECT_0 + FirstDirectory &&
+            WaitResult < WAIT_OBJECT_0 + HandleCount) {
 
-            if (!YoriLibReadLineToStringEx(&TailContext->LinesArray[0], &LineContext, FALSE, INFINITE, hSource, &LineEnding, &TimeoutReached)) {
+            Directory = WaitDirectories[WaitResult - WAIT_OBJECT_0];
+            if (!FindNextChangeNotification(Directory->ChangeHandle)) {
+                FindCloseChangeNotification(Directory->ChangeHandle);
+                Directory->ChangeHandle = NULL;
+            }
+        } else if (WaitResult == WAIT_FAILED) {
+            Sleep(TAIL_FOLLOW_RECHECK_INTERVAL);
+        }
 
-                //
-                //  Check if the target handle is still around
-                //
+        if (Directory != NULL &&
+            TailGetTickCount() - LastFullCheck >= TAIL_FOLLOW_RECHECK_INTERVAL) {
 
-                if (!WriteFile(GetStdHandle(STD_OUTPUT_HANDLE), NULL, 0L, &BytesWritten, NULL)) {
-                    Err = GetLastError();
-                    if (Err == ERROR_NO_DATA ||
-                        Err == ERROR_PIPE_NOT_CONNECTED) {
-                        break;
-                    }
-                }
+            Directory = NULL;
+        }
 
-                if (YoriLibIsOperationCancelled()) {
-                    break;
-                }
+        if (Directory == NULL) {
+            LastFullCheck = TailGetTickCount();
+        }
+
+        ListEntry = YoriLibGetNextListEntry(&TailContext->FollowFiles, NULL);
+        while (ListEntry != NULL) {
+            TailFile = CONTAINING_RECORD(ListEntry, TAIL_FILE, ListEntry);
+            if (Directory == NULL || TailFile->Directory == Directory) {
+                TailCheckFile(TailContext, TailFile);
+            }
+            ListEntry = YoriLibGetNextListEntry(&TailContext->FollowFiles, ListEntry);
+        }
 
-                Sleep(200L);
-                continue;
+        //
+        //  Check if the target handle is still around
+        //
+
+        if (!WriteFile(GetStdHandle(STD_OUTPUT_HANDLE), NULL, 0L, &BytesWritten, NULL)) {
+            Err = GetLastError();
+            if (Err == ERROR_NO_DATA ||
+                Err == ERROR_PIPE_NOT_CONNECTED) {
+                break;
             }
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), &TailContext->LinesArray[0]);
         }
     }
+}
 
-    YoriLibLineReadCloseOrCache(LineContext);
-    return TRUE;
+/**
+ Stop following all files, closing them and any change notifications.
+
+ @param TailContext Pointer to context information containing the files
+        being followed.
+ */
+VOID
+TailFreeFollowedFiles(
+    __in PTAIL_CONTEXT TailContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PTAIL_DIRECTORY Directory;
+    PTAIL_FILE TailFile;
+
+    ListEntry = YoriLibGetNextListEntry(&TailContext->FollowFiles, NULL);
+    while (ListEntry != NULL) {
+        TailFile = CONTAINING_RECORD(ListEntry, TAIL_FILE, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&TailContext->FollowFiles, ListEntry);
+        YoriLibRemoveListItem(&TailFile->ListEntry);
+        TailFreeFile(TailFile);
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&TailContext->FollowDirectories, NULL);
+    while (ListEntry != NULL) {
+        Directory = CONTAINING_RECORD(ListEntry, TAIL_DIRECTORY, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&TailContext->FollowDirectories, ListEntry);
+        YoriLibRemoveListItem(&Directory->ListEntry);
+        if (Directory->ChangeHandle != NULL) {
+            FindCloseChangeNotification(Directory->ChangeHandle);
+        }
+        YoriLibFreeStringContents(&Directory->DirectoryName);
+        YoriLibFree(Directory);
+    }
 }
 
 /**
@@ -305,6 +841,7 @@ TailFileFoundCallback(
     )
 {
     HANDLE FileHandle;
+    PTAIL_FILE TailFile;
     PTAIL_CONTEXT TailContext = (PTAIL_CONTEXT)Context;
 
     UNREFERENCED_PARAMETER(Depth);
@@ -314,15 +851,9 @@ TailFileFoundCallback(
     if (FileInfo == NULL ||
         (FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
 
-        FileHandle = CreateFile(FilePath->StartOfString,
-                                GENERIC_READ,
-                                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
-                                NULL,
-                                OPEN_EXISTING,
-                                FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS,
-                                NULL);
+        FileHandle = TailOpenFile(FilePath);
 
-        if (FileHandle == NULL || FileHandle == INVALID_HANDLE_VALUE) {
+        if (FileHandle == INVALID_HANDLE_VALUE) {
             if (TailContext->SavedErrorThisArg == ERROR_SUCCESS) {
                 SYSERR LastError = GetLastError();
                 LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
@@ -333,9 +864,39 @@ TailFileFoundCallback(
         }
 
         TailContext->SavedErrorThisArg = ERROR_SUCCESS;
-        TailProcessStream(FileHandle, TailContext);
 
-        CloseHandle(FileHandle);
+        TailFile = YoriLibMalloc(sizeof(TAIL_FILE));
+        if (TailFile == NULL) {
+            CloseHandle(FileHandle);
+            return FALSE;
+        }
+
+        ZeroMemory(TailFile, sizeof(TAIL_FILE));
+        TailFile->FileHandle = FileHandle;
+        if (!YoriLibCopyString(&TailFile->FilePath, FilePath)) {
+            CloseHandle(FileHandle);
+            YoriLibFree(TailFile);
+            return FALSE;
+        }
+        if (!YoriLibUnescapePath(FilePath, &TailFile->DisplayName)) {
+            YoriLibCloneString(&TailFile->DisplayName, &TailFile->FilePath);
+        }
+
+        TailProcessStream(TailFile, TailContext);
+
+        //
+        //  If following output, keep the file open and check it for more
+        //  lines once all files have been displayed.
+        //
+
+        if (TailContext->WaitForMore &&
+            (GetFileType(FileHandle) & ~(FILE_TYPE_REMOTE)) == FILE_TYPE_DISK) {
+
+            TailGetFileIdentity(FileHandle, &TailFile->Identity);
+            TailFollowFile(TailContext, TailFile);
+        } else {
+            TailFreeFile(TailFile);
+        }
     }
 
     return TRUE;
@@ -437,11 +998,14 @@ ENTRYPOINT(
     DWORD Count;
     BOOLEAN BasicEnumeration = FALSE;
     TAIL_CONTEXT TailContext;
+    PTAIL_FILE TailFile;
     YORI_MAX_SIGNED_T ContextLine;
     YORI_STRING Arg;
 
     ZeroMemory(&TailContext, sizeof(TailContext));
     TailContext.LinesToDisplay = 10;
+    YoriLibInitializeListHead(&TailContext.FollowFiles);
+    YoriLibInitializeListHead(&TailContext.FollowDirectories);
     ContextLine = -1;
 
     for (i = 1; i < ArgC; i++) {
@@ -455,7 +1019,7 @@ ENTRYPOINT(
                 TailHelp();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2017-2019"));
+                YoriLibDisplayMitLicense(_T("2017-2026"));
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("b")) == 0) {
                 BasicEnumeration = TRUE;
@@ -505,6 +1069,9 @@ ENTRYPOINT(
                         i++;
                     }
                 }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("p")) == 0) {
+                TailContext.PrefixFileName = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("s")) == 0) {
                 TailContext.Recursive = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -560,7 +1127,28 @@ ENTRYPOINT(
             return EXIT_FAILURE;
         }
 
-        TailProcessStream(GetStdHandle(STD_INPUT_HANDLE), &TailContext);
+        TailFile = YoriLibMalloc(sizeof(TAIL_FILE));
+        if (TailFile == NULL) {
+            YoriLibFree(TailContext.LinesArray);
+            return EXIT_FAILURE;
+        }
+
+        //
+        //  Standard input has no path, so it is never closed, and can only
+        //  be followed if it refers to a file.  A pipe has already been
+        //  read until the writer closed it.
+        //
+
+        ZeroMemory(TailFile, sizeof(TAIL_FILE));
+        TailFile->FileHandle = GetStdHandle(STD_INPUT_HANDLE);
+        TailProcessStream(TailFile, &TailContext);
+        if (TailContext.WaitForMore &&
+            (GetFileType(TailFile->FileHandle) & ~(FILE_TYPE_REMOTE)) == FILE_TYPE_DISK) {
+
+            TailFollowFile(&TailContext, TailFile);
+        } else {
+            TailFreeFile(TailFile);
+        }
     } else {
         MatchFlags = YORILIB_ENUM_RETURN_FILES | YORILIB_ENUM_DIRECTORY_CONTENTS;
         if (TailContext.Recursive) {
@@ -597,6 +1185,11 @@ ENTRYPOINT(
         }
     }
 
+    if (TailContext.WaitForMore && !YoriLibIsListEmpty(&TailContext.FollowFiles)) {
+        TailFollowFiles(&TailContext);
+    }
+    TailFreeFollowedFiles(&TailContext);
+
     for (Count = 0; Count < TailContext.LinesToDisplay; Count++) {
         YoriLibFreeStringContents(&TailContext.LinesArray[Count]);
     }
@@ -0,0 +1,787 @@
+/**
+ * @file test/base64.c
+ *
+ * Yori shell base64 encode and decode tests
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "test.h"
+
+/**
+ A string and its expected decoded form.
+ */
+typedef struct _TEST_BASE64_CASE {
+
+    /**
+     The decoded form of the string.
+     */
+    LPCSTR Decoded;
+
+    /**
+     The encoded form of the string.  If Decoded is NULL, this string is not
+     valid base64 and decoding it is expected to fail.
+     */
+    LPCSTR Encoded;
+
+    /**
+     If decoding is expected to fail, the offset of the character which is
+     expected to be reported as invalid.  If the failure is expected to be
+     detected at the end of the input, this is -1.
+     */
+    DWORD InvalidOffset;
+} TEST_BASE64_CASE;
+
+/**
+ Constant pointer to a base64 test case.
+ */
+typedef TEST_BASE64_CASE CONST *PCTEST_BASE64_CASE;
+
+/**
+ Strings which are encoded and decoded with known results, without line
+ breaks.  These include the examples from RFC 4648.
+ */
+CONST TEST_BASE64_CASE TestBase64KnownCases[] = {
+    {"",       "",         0},
+    {"f",      "Zg==",     0},
+    {"fo",     "Zm8=",     0},
+    {"foo",    "Zm9v",     0},
+    {"foob",   "Zm9vYg==", 0},
+    {"fooba",  "Zm9vYmE=", 0},
+    {"foobar", "Zm9vYmFy", 0},
+    {"The quick brown fox jumps over the lazy dog",
+     "VGhlIHF1aWNrIGJyb3duIGZveCBqdW1wcyBvdmVyIHRoZSBsYXp5IGRvZw==",
+     0},
+};
+
+/**
+ Strings which are only decoded, either because they contain whitespace or
+ omit padding, or because they are invalid.
+ */
+CONST TEST_BASE64_CASE TestBase64DecodeCases[] = {
+    {"foob",   " Z m 9 v\r\n\tYg== \r\n",                                 0},
+    {"foob",   "Zm9vYg",                                                  0},
+    {"fooba",  "Zm9vYmE",                                                 0},
+    {"foobar", "Zm9v\r\nYmFy\r\n",                                        0},
+    {NULL,     "Zm9v!A==",                                                4},
+    {NULL,     "Zg=a",                                                    3},
+    {NULL,     "Zg===",                                                   4},
+    {NULL,     "=Zg=",                                                    0},
+    {NULL,     "Zm9vYg==Zm9v",                                            8},
+    {NULL,     "QUFBQUFBQUFBQUFBQUFBQUFBQUFBQUFBQUFBQUFBQUE$QUFB",       43},
+    {NULL,     "QUFBQUFBQUFBQUFBQUFBQUFBQUFBQUFBQUFBQUFBQUFBQ",          (DWORD)-1},
+};
+
+/**
+ Lengths of generated data which are encoded and decoded to check that data
+ survives a round trip.  These cover each possible remainder, partial and
+ complete vectors, and multiple lines.
+ */
+CONST DWORD TestBase64RoundTripLengths[] = {0, 1, 2, 3, 11, 12, 13, 47, 48, 49, 1000, 100000};
+
+/**
+ The line lengths used when checking that data survives a round trip.
+ */
+CONST DWORD TestBase64LineLengths[] = {0, YORI_LIB_BASE64_DEFAULT_LINE_LENGTH, 76};
+
+/**
+ The sizes of each update used when checking that data supplied in pieces
+ produces the same result as data supplied at once.  Zero indicates the
+ entire buffer.
+ */
+CONST DWORD TestBase64UpdateSizes[] = {0, 1, 7, 16, 64, 4097};
+
+/**
+ The number of bytes encoded and decoded when measuring throughput.
+ */
+#define TEST_BASE64_PERF_LENGTH (64 * 1024 * 1024)
+
+/**
+ The number of bytes supplied to each update when measuring throughput.
+ This corresponds to the size of each read performed by the base64 command.
+ */
+#define TEST_BASE64_PERF_UPDATE_SIZE (64 * 1024)
+
+/**
+ Return the length of a NULL terminated narrow string.
+
+ @param String Pointer to the string.
+
+ @return The number of characters in the string, not including the NULL.
+ */
+DWORD
+TestBase64StringLength(
+    __in LPCSTR String
+    )
+{
+    DWORD Length;
+
+    for (Length = 0; String[Length] != '\0'; Length++);
+    return Length;
+}
+
+/**
+ Fill a buffer with generated data.
+
+ @param Buffer Pointer to the buffer to fill.
+
+ @param Length The number of bytes in Buffer.
+ */
+VOID
+TestBase64GenerateData(
+    __out_ecount(Length) PUCHAR Buffer,
+    __in DWORD Length
+    )
+{
+    DWORD Index;
+
+    for (Index = 0; Index < Length; Index++) {
+        Buffer[Index] = (UCHAR)(Index * 7 + Index / 251);
+    }
+}
+
+/**
+ Encode a buffer, supplying it to the encoder in pieces.
+
+ @param Input Pointer to the data to encode.
+
+ @param InputLength The number of bytes in Input.
+
+ @param LineLength The number of characters to output before each line
+        break, or zero to output no line breaks.
+
+ @param UpdateSize The number of bytes to supply to each update, or zero to
+        supply all of the data at once.
+
+ @param Output On successful completion, updated to point to a newly
+        allocated buffer containing the encoded form.  The caller should free
+        this with @ref YoriLibFree .
+
+ @param OutputLength On successful completion, updated to contain the number
+        of characters in Output.
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.
+ */
+__success(return)
+BOOLEAN
+TestBase64Encode(
+    __in_ecount(InputLength) CONST UCHAR * Input,
+    __in DWORD InputLength,
+    __in DWORD LineLength,
+    __in DWORD UpdateSize,
+    __out PUCHAR * Output,
+    __out PDWORD OutputLength
+    )
+{
+    YORI_LIB_BASE64_ENCODE_CONTEXT Context;
+    PUCHAR Buffer;
+    DWORD Offset;
+    DWORD BytesThisUpdate;
+    DWORD CharsGenerated;
+
+    if (UpdateSize == 0) {
+        UpdateSize = InputLength;
+    }
+
+    YoriLibBase64EncodeInitialize(&Context, LineLength);
+    Buffer = YoriLibMalloc(YoriLibBase64EncodeGetBufferSize(&Context, InputLength) + YORI_LIB_BASE64_ENCODE_FINAL_SIZE);
+    if (Buffer == NULL) {
+        return FALSE;
+    }
+
+    CharsGenerated = 0;
+    for (Offset = 0; Offset < InputLength; Offset = Offset + BytesThisUpdate) {
+        BytesThisUpdate = UpdateSize;
+        if (BytesThisUpdate > InputLength - Offset) {
+            BytesThisUpdate = InputLength - Offset;
+        }
+        CharsGenerated = CharsGenerated + YoriLibBase64EncodeUpdate(&Context, Input + Offset, BytesThisUpdate, Buffer + CharsGenerated);
+    }
+
+    CharsGenerated = CharsGenerated + YoriLibBase64EncodeFinalize(&Context, Buffer + CharsGenerated);
+
+    *Output = Buffer;
+    *OutputLength = CharsGenerated;
+    return TRUE;
+}
+
+/**
+ Decode a buffer, supplying it to the decoder in pieces.
+
+ @param Input Pointer to the characters to decode.
+
+ @param InputLength The number of characters in Input.
+
+ @param UpdateSize The number of characters to supply to each update, or zero
+        to supply all of the data at once.
+
+ @param Output On successful completion, updated to point to a newly
+        allocated buffer containing the decoded form.  The caller should free
+        this with @ref YoriLibFree .
+
+ @param OutputLength On successful completion, updated to contain the number
+        of bytes in Output.
+
+ @param InvalidOffset On failure, updated to contain the offset of the
+        invalid character, or -1 if the input ended unexpectedly.  On
+        allocation failure, Output is NULL.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+TestBase64Decode(
+    __in_ecount(InputLength) CONST UCHAR * Input,
+    __in DWORD InputLength,
+    __in DWORD UpdateSize,
+    __out PUCHAR * Output,
+    __out PDWORD OutputLength,
+    __out PDWORD InvalidOffset
+    )
+{
+    YORI_LIB_BASE64_DECODE_CONTEXT Context;
+    PUCHAR Buffer;
+    DWORD Offset;
+    DWORD BytesThisUpdate;
+    DWORD BytesGenerated;
+    YORI_ALLOC_SIZE_T BytesThisOutput;
+
+    *Output = NULL;
+    *InvalidOffset = (DWORD)-1;
+
+    if (UpdateSize == 0) {
+        UpdateSize = InputLength;
+    }
+
+    YoriLibBase64DecodeInitialize(&Context);
+    Buffer = YoriLibMalloc(YoriLibBase64DecodeGetBufferSize(&Context, InputLength) + YORI_LIB_BASE64_DECODE_FINAL_SIZE);
+    if (Buffer == NULL) {
+        return FALSE;
+    }
+
+    BytesGenerated = 0;
+    for (Offset = 0; Offset < InputLength; Offset = Offset + BytesThisUpdate) {
+        BytesThisUpdate = UpdateSize;
+        if (BytesThisUpdate > InputLength - Offset) {
+            BytesThisUpdate = InputLength - Offset;
+        }
+        if (!YoriLibBase64DecodeUpdate(&Context, Input + Offset, BytesThisUpdate, Buffer + BytesGenerated, &BytesThisOutput)) {
+            *InvalidOffset = (DWORD)Context.CharsProcessed;
+            YoriLibFree(Buffer);
+            return FALSE;
+        }
+        BytesGenerated = BytesGenerated + BytesThisOutput;
+    }
+
+    if (!YoriLibBase64DecodeFinalize(&Context, Buffer + BytesGenerated, &BytesThisOutput)) {
+        YoriLibFree(Buffer);
+        return FALSE;
+    }
+    BytesGenerated = BytesGenerated + BytesThisOutput;
+
+    *Output = Buffer;
+    *OutputLength = BytesGenerated;
+    return TRUE;
+}
+
+/**
+ Check that base64 encode and decode generate known results, generate the
+ same result regardless of how the data is supplied, tolerate whitespace,
+ and detect invalid input.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+TestBase64(VOID)
+{
+    PUCHAR Buffer;
+    PUCHAR Encoded;
+    PUCHAR Decoded;
+    PUCHAR Expected;
+    DWORD BufferLength;
+    DWORD EncodedLength;
+    DWORD DecodedLength;
+    DWORD ExpectedLength;
+    DWORD InvalidOffset;
+    DWORD CaseIndex;
+    DWORD LineIndex;
+    DWORD UpdateIndex;
+    DWORD Length;
+    DWORD UpdateSize;
+    PCTEST_BASE64_CASE Case;
+    BOOLEAN Result;
+
+    Result = FALSE;
+    Encoded = NULL;
+    Decoded = NULL;
+    Expected = NULL;
+    ExpectedLength = 0;
+
+    BufferLength = TestBase64RoundTripLengths[sizeof(TestBase64RoundTripLengths)/sizeof(TestBase64RoundTripLengths[0]) - 1];
+    Buffer = YoriLibMalloc(BufferLength);
+    if (Buffer == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation failure\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+
+    TestBase64GenerateData(Buffer, BufferLength);
+
+    //
+    //  Check strings with known encoded forms.
+    //
+
+    for (CaseIndex = 0; CaseIndex < sizeof(TestBase64KnownCases)/sizeof(TestBase64KnownCases[0]); CaseIndex++) {
+        Case = &TestBase64KnownCases[CaseIndex];
+        Length = TestBase64StringLength(Case->Decoded);
+        for (UpdateIndex = 0; UpdateIndex < sizeof(TestBase64UpdateSizes)/sizeof(TestBase64UpdateSizes[0]); UpdateIndex++) {
+            UpdateSize = TestBase64UpdateSizes[UpdateIndex];
+            if (!TestBase64Encode((CONST UCHAR *)Case->Decoded, Length, 0, UpdateSize, &Encoded, &EncodedLength)) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation failure\n"), __FILE__, __LINE__);
+                goto Exit;
+            }
+
+            if (EncodedLength != TestBase64StringLength(Case->Encoded) ||
+                memcmp(Encoded, Case->Encoded, EncodedLength) != 0) {
+
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                              _T("%hs:%i encode of %hs in updates of %i returned %i chars, expected %hs\n"),
+                              __FILE__,
+                              __LINE__,
+                              Case->Decoded,
+                              UpdateSize,
+                              EncodedLength,
+                              Case->Encoded);
+                goto Exit;
+            }
+            YoriLibFree(Encoded);
+            Encoded = NULL;
+
+            if (!TestBase64Decode((CONST UCHAR *)Case->Encoded, TestBase64StringLength(Case->Encoded), UpdateSize, &Decoded, &DecodedLength, &InvalidOffset) ||
+                DecodedLength != Length ||
+                memcmp(Decoded, Case->Decoded, Length) != 0) {
+
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                              _T("%hs:%i decode of %hs in updates of %i did not return %hs\n"),
+                              __FILE__,
+                              __LINE__,
+                              Case->Encoded,
+                              UpdateSize,
+                              Case->Decoded);
+                goto Exit;
+            }
+            YoriLibFree(Decoded);
+            Decoded = NULL;
+        }
+    }
+
+    //
+    //  Check strings which contain whitespace, omit padding, or are invalid.
+    //
+
+    for (CaseIndex = 0; CaseIndex < sizeof(TestBase64DecodeCases)/sizeof(TestBase64DecodeCases[0]); CaseIndex++) {
+        Case = &TestBase64DecodeCases[CaseIndex];
+        for (UpdateIndex = 0; UpdateIndex < sizeof(TestBase64UpdateSizes)/sizeof(TestBase64UpdateSizes[0]); UpdateIndex++) {
+            UpdateSize = TestBase64UpdateSizes[UpdateIndex];
+            if (TestBase64Decode((CONST UCHAR *)Case->Encoded, TestBase64StringLength(Case->Encoded), UpdateSize, &Decoded, &DecodedLength, &InvalidOffset)) {
+                if (Case->Decoded == NULL ||
+                    DecodedLength != TestBase64StringLength(Case->Decoded) ||
+                    memcmp(Decoded, Case->Decoded, DecodedLength) != 0) {
+
+                    YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                                  _T("%hs:%i decode of %hs in updates of %i returned unexpected data\n"),
+                                  __FILE__,
+                                  __LINE__,
+                                  Case->Encoded,
+                                  UpdateSize);
+                    goto Exit;
+                }
+                YoriLibFree(Decoded);
+                Decoded = NULL;
+            } else if (Case->Decoded != NULL || InvalidOffset != Case->InvalidOffset) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                              _T("%hs:%i decode of %hs in updates of %i failed at %i, expected %i\n"),
+                              __FILE__,
+                              __LINE__,
+                              Case->Encoded,
+                              UpdateSize,
+                              InvalidOffset,
+                              Case->InvalidOffset);
+                goto Exit;
+            }
+        }
+    }
+
+    //
+    //  Check that generated data survives a round trip, and that the
+    //  encoded form does not depend on how the data was supplied.
+    //
+
+    for (CaseIndex = 0; CaseIndex < sizeof(TestBase64RoundTripLengths)/sizeof(TestBase64RoundTripLengths[0]); CaseIndex++) {
+        Length = TestBase64RoundTripLengths[CaseIndex];
+        for (LineIndex = 0; LineIndex < sizeof(TestBase64LineLengths)/sizeof(TestBase64LineLengths[0]); LineIndex++) {
+            for (UpdateIndex = 0; UpdateIndex < sizeof(TestBase64UpdateSizes)/sizeof(TestBase64UpdateSizes[0]); UpdateIndex++) {
+                UpdateSize = TestBase64UpdateSizes[UpdateIndex];
+                if (!TestBase64Encode(Buffer, Length, TestBase64LineLengths[LineIndex], UpdateSize, &Encoded, &EncodedLength)) {
+                    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation failure\n"), __FILE__, __LINE__);
+                    goto Exit;
+                }
+
+                if (Expected == NULL) {
+                    Expected = Encoded;
+                    ExpectedLength = EncodedLength;
+                } else if (EncodedLength != ExpectedLength ||
+                           memcmp(Encoded, Expected, EncodedLength) != 0) {
+
+                    YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                                  _T("%hs:%i encode of %i bytes with line length %i in updates of %i differs from a single update\n"),
+                                  __FILE__,
+                                  __LINE__,
+                                  Length,
+                                  TestBase64LineLengths[LineIndex],
+                                  UpdateSize);
+                    goto Exit;
+                }
+
+                if (!TestBase64Decode(Encoded, EncodedLength, UpdateSize, &Decoded, &DecodedLength, &InvalidOffset) ||
+                    DecodedLength != Length ||
+                    memcmp(Decoded, Buffer, Length) != 0) {
+
+                    YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                                  _T("%hs:%i round trip of %i bytes with line length %i in updates of %i failed\n"),
+                                  __FILE__,
+                                  __LINE__,
+                                  Length,
+                                  TestBase64LineLengths[LineIndex],
+                                  UpdateSize);
+                    goto Exit;
+                }
+                YoriLibFree(Decoded);
+                Decoded = NULL;
+
+                if (Encoded != Expected) {
+                    YoriLibFree(Encoded);
+                }
+                Encoded = NULL;
+            }
+
+            YoriLibFree(Expected);
+            Expected = NULL;
+        }
+    }
+
+    Result = TRUE;
+
+Exit:
+    if (Encoded != NULL && Encoded != Expected) {
+        YoriLibFree(Encoded);
+    }
+    if (Expected != NULL) {
+        YoriLibFree(Expected);
+    }
+    if (Decoded != NULL) {
+        YoriLibFree(Decoded);
+    }
+    if (Buffer != NULL) {
+        YoriLibFree(Buffer);
+    }
+    return Result;
+}
+
+/**
+ Encode a known string with line breaks, write the encoded text to a
+ temporary file with @ref YoriLibOutputAsciiToDevice using a specified output
+ encoding, and check that the file contains the text in that encoding.
+
+ @param Encoding The output encoding to use.  This should be CP_UTF16 or an
+        encoding which is a superset of ASCII.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+TestBase64OutputWithEncoding(
+    __in DWORD Encoding
+    )
+{
+    PCTEST_BASE64_CASE Case;
+    HANDLE TempHandle;
+    YORI_STRING TempName;
+    YORI_STRING TextBuffer;
+    PUCHAR Encoded;
+    PUCHAR FileContents;
+    DWORD EncodedLength;
+    DWORD FirstLineLength;
+    DWORD CharSize;
+    DWORD BytesRead;
+    DWORD Index;
+    DWORD OldEncoding;
+    BOOLEAN Result;
+
+    Case = &TestBase64KnownCases[sizeof(TestBase64KnownCases)/sizeof(TestBase64KnownCases[0]) - 1];
+    if (!TestBase64Encode((CONST UCHAR *)Case->Decoded, TestBase64StringLength(Case->Decoded), 16, 0, &Encoded, &EncodedLength)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation failure\n"), __FILE__, __LINE__);
+        return FALSE;
+    }
+
+    //
+    //  Write the first line separately from the remainder, so the second
+    //  write reuses the buffer allocated by the first.
+    //
+
+    for (FirstLineLength = 0; FirstLineLength < EncodedLength; FirstLineLength++) {
+        if (Encoded[FirstLineLength] == '\n') {
+            FirstLineLength++;
+            break;
+        }
+    }
+
+    CharSize = 1;
+    if (Encoding == CP_UTF16) {
+        CharSize = sizeof(WCHAR);
+    }
+
+    FileContents = YoriLibMalloc(EncodedLength * CharSize + 1);
+    if (FileContents == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation failure\n"), __FILE__, __LINE__);
+        YoriLibFree(Encoded);
+        return FALSE;
+    }
+
+    if (!TestCreateTempFile(&TempHandle, &TempName)) {
+        YoriLibFree(FileContents);
+        YoriLibFree(Encoded);
+        return FALSE;
+    }
+
+    Result = FALSE;
+    YoriLibInitEmptyString(&TextBuffer);
+    OldEncoding = YoriLibGetMultibyteOutputEncoding();
+    YoriLibSetMultibyteOutputEncoding(Encoding);
+
+    if (!YoriLibOutputAsciiToDevice(TempHandle, Encoded, (YORI_ALLOC_SIZE_T)FirstLineLength, &TextBuffer) ||
+        !YoriLibOutputAsciiToDevice(TempHandle, Encoded + FirstLineLength, (YORI_ALLOC_SIZE_T)(EncodedLength - FirstLineLength), &TextBuffer)) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i write failure\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+
+    SetFilePointer(TempHandle, 0, NULL, FILE_BEGIN);
+    if (!ReadFile(TempHandle, FileContents, EncodedLength * CharSize + 1, &BytesRead, NULL)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i read failure\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+
+    if (BytesRead != EncodedLength * CharSize) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i encoding %i wrote %i bytes, expected %i\n"), __FILE__, __LINE__, Encoding, BytesRead, EncodedLength * CharSize);
+        goto Exit;
+    }
+
+    for (Index = 0; Index < EncodedLength; Index++) {
+        if (FileContents[Index * CharSize] != Encoded[Index] ||
+            (CharSize == sizeof(WCHAR) && FileContents[Index * CharSize + 1] != 0)) {
+
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i encoding %i differs at char %i\n"), __FILE__, __LINE__, Encoding, Index);
+            goto Exit;
+        }
+    }
+
+    Result = TRUE;
+
+Exit:
+    YoriLibSetMultibyteOutputEncoding(OldEncoding);
+    YoriLibFreeStringContents(&TextBuffer);
+    CloseHandle(TempHandle);
+    DeleteFile(TempName.StartOfString);
+    YoriLibFreeStringContents(&TempName);
+    YoriLibFree(FileContents);
+    YoriLibFree(Encoded);
+    return Result;
+}
+
+/**
+ Check that encoded text is written in the active output encoding, including
+ UTF-16, where each character must be widened.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+TestBase64Output(VOID)
+{
+    if (!TestBase64OutputWithEncoding(CP_UTF16)) {
+        return FALSE;
+    }
+
+    if (!TestBase64OutputWithEncoding(CP_UTF8)) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Display the throughput of an operation.
+
+ @param Name The name of the operation.
+
+ @param Frequency The frequency of the performance counter.
+
+ @param Start The performance counter value when the operation started.
+
+ @param End The performance counter value when the operation completed.
+ */
+VOID
+TestBase64DisplayThroughput(
+    __in LPCTSTR Name,
+    __in PLARGE_INTEGER Frequency,
+    __in PLARGE_INTEGER Start,
+    __in PLARGE_INTEGER End
+    )
+{
+    DWORDLONG ElapsedUs;
+
+    ElapsedUs = (DWORDLONG)(End->QuadPart - Start->QuadPart) * 1000000 / Frequency->QuadPart;
+    if (ElapsedUs == 0) {
+        ElapsedUs = 1;
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                  _T("  %-16s %i MB: %10lli us, %6lli MB/s\n"),
+                  Name,
+                  TEST_BASE64_PERF_LENGTH / (1024 * 1024),
+                  ElapsedUs,
+                  (DWORDLONG)TEST_BASE64_PERF_LENGTH * 1000000 / (1024 * 1024) / ElapsedUs);
+}
+
+/**
+ Measure the throughput of base64 encode and decode, and compare it to the
+ CryptBinaryToString and CryptStringToBinary functions if they are
+ available.  Note the Crypt32 functions operate on the entire buffer at
+ once, which requires the entire input and output to be held in memory.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+TestBase64Perf(VOID)
+{
+    PUCHAR Buffer;
+    PUCHAR Encoded;
+    PUCHAR Decoded;
+    LPTSTR CryptEncoded;
+    DWORD EncodedLength;
+    DWORD DecodedLength;
+    DWORD CharsRequired;
+    DWORD BytesRequired;
+    DWORD InvalidOffset;
+    LARGE_INTEGER Frequency;
+    LARGE_INTEGER Start;
+    LARGE_INTEGER End;
+    BOOLEAN Result;
+
+    Result = FALSE;
+    Encoded = NULL;
+    Decoded = NULL;
+    CryptEncoded = NULL;
+
+    Buffer = YoriLibMalloc(TEST_BASE64_PERF_LENGTH);
+    if (Buffer == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation failure\n"), __FILE__, __LINE__);
+        return FALSE;
+    }
+
+    TestBase64GenerateData(Buffer, TEST_BASE64_PERF_LENGTH);
+    QueryPerformanceFrequency(&Frequency);
+
+    QueryPerformanceCounter(&Start);
+    if (!TestBase64Encode(Buffer, TEST_BASE64_PERF_LENGTH, YORI_LIB_BASE64_DEFAULT_LINE_LENGTH, TEST_BASE64_PERF_UPDATE_SIZE, &Encoded, &EncodedLength)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation failure\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+    QueryPerformanceCounter(&End);
+    TestBase64DisplayThroughput(_T("Encode"), &Frequency, &Start, &End);
+
+    QueryPerformanceCounter(&Start);
+    if (!TestBase64Decode(Encoded, EncodedLength, TEST_BASE64_PERF_UPDATE_SIZE, &Decoded, &DecodedLength, &InvalidOffset)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i decode failure at %i\n"), __FILE__, __LINE__, InvalidOffset);
+        goto Exit;
+    }
+    QueryPerformanceCounter(&End);
+    TestBase64DisplayThroughput(_T("Decode"), &Frequency, &Start, &End);
+
+    if (DecodedLength != TEST_BASE64_PERF_LENGTH ||
+        memcmp(Decoded, Buffer, DecodedLength) != 0) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i round trip failed\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+
+    YoriLibLoadCrypt32Functions();
+    if (DllCrypt32.pCryptBinaryToStringW == NULL ||
+        DllCrypt32.pCryptStringToBinaryW == NULL) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  Crypt32 base64 support not present\n"));
+        Result = TRUE;
+        goto Exit;
+    }
+
+    QueryPerformanceCounter(&Start);
+    if (!DllCrypt32.pCryptBinaryToStringW(Buffer, TEST_BASE64_PERF_LENGTH, CRYPT_STRING_BASE64, NULL, &CharsRequired)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i CryptBinaryToString failure\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+    CryptEncoded = YoriLibMalloc(CharsRequired * sizeof(TCHAR));
+    if (CryptEncoded == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation failure\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+    if (!DllCrypt32.pCryptBinaryToStringW(Buffer, TEST_BASE64_PERF_LENGTH, CRYPT_STRING_BASE64, CryptEncoded, &CharsRequired)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i CryptBinaryToString failure\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+    QueryPerformanceCounter(&End);
+    TestBase64DisplayThroughput(_T("Crypt32 encode"), &Frequency, &Start, &End);
+
+    QueryPerformanceCounter(&Start);
+    BytesRequired = TEST_BASE64_PERF_LENGTH;
+    if (!DllCrypt32.pCryptStringToBinaryW(CryptEncoded, CharsRequired, CRYPT_STRING_BASE64, Decoded, &BytesRequired, NULL, NULL)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i CryptStringToBinary failure\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+    QueryPerformanceCounter(&End);
+    TestBase64DisplayThroughput(_T("Crypt32 decode"), &Frequency, &Start, &End);
+
+    Result = TRUE;
+
+Exit:
+    if (CryptEncoded != NULL) {
+        YoriLibFree(CryptEncoded);
+    }
+    if (Encoded != NULL) {
+        YoriLibFree(Encoded);
+    }
+    if (Decoded != NULL) {
+        YoriLibFree(Decoded);
+    }
+    YoriLibFree(Buffer);
+    return Result;
+}
+
+// vim:sw=4:ts=4:et:
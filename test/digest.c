@@ -0,0 +1,324 @@
+/**
+ * @file test/digest.c
+ *
+ * Yori shell message digest tests
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "test.h"
+
+/**
+ The digest algorithms implemented by the library.
+ */
+typedef enum _TEST_DIGEST_ALGORITHM {
+    TestDigestSha256 = 0,
+    TestDigestXxh3 = 1,
+    TestDigestBlake3 = 2,
+    TestDigestAlgorithmCount = 3
+} TEST_DIGEST_ALGORITHM;
+
+/**
+ The names of each algorithm, for display.
+ */
+CONST LPCTSTR TestDigestNames[TestDigestAlgorithmCount] = {
+    _T("SHA256"),
+    _T("XXH3"),
+    _T("BLAKE3")
+};
+
+/**
+ The number of bytes in each algorithm's digest.
+ */
+CONST YORI_ALLOC_SIZE_T TestDigestSizes[TestDigestAlgorithmCount] = {
+    YORI_LIB_SHA256_DIGEST_SIZE,
+    YORI_LIB_XXH3_DIGEST_SIZE,
+    YORI_LIB_BLAKE3_DIGEST_SIZE
+};
+
+/**
+ The digest of a generated buffer of a specified length.
+ */
+typedef struct _TEST_DIGEST_CASE {
+
+    /**
+     The number of bytes of generated data to hash.
+     */
+    DWORD Length;
+
+    /**
+     The expected digest from each algorithm, in hex.
+     */
+    LPCTSTR Expected[TestDigestAlgorithmCount];
+} TEST_DIGEST_CASE;
+
+/**
+ Constant pointer to the digest of a generated buffer.
+ */
+typedef TEST_DIGEST_CASE CONST *PCTEST_DIGEST_CASE;
+
+/**
+ Digests with known results.  These lengths cover each of the input size
+ classes that XXH3 handles differently, and multiple chunks and tree levels
+ of BLAKE3.
+ */
+CONST TEST_DIGEST_CASE TestDigestCases[] = {
+    {0,       {_T("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"),
+               _T("2d06800538d394c2"),
+               _T("af1349b9f5f9a1a6a0404dea36dcc9499bcb25c9adc112b7cc9a93cae41f3262")}},
+    {3,       {_T("b361d0f9a938a2bb4fbdc9c21dc5a859788041b0040919d8a811c1888184f4df"),
+               _T("c3489259e968ad9e"),
+               _T("f7ead025f69c8b1aa936df3360e05924e4e12c854d595b47370e80527a92769c")}},
+    {17,      {_T("e060fc0bb46619525f8ec49b48b5a6d6ceaa3157a887381212af57296d355d20"),
+               _T("f34c3c9cf5a112d1"),
+               _T("58315ef4220fabffc668455554211a649eda3e1958487c8ea21026d703000fc8")}},
+    {200,     {_T("b531abd8dae7232c861ac9f50aff9952d29c8d4c3772551cc5bce5d39d2cd08d"),
+               _T("7c64f3b17285e96a"),
+               _T("42f9c70671b24c29674166eb39d4a7b28091898ab82416c8e672cb7b1ad0a405")}},
+    {1025,    {_T("0c1d9a9a54273e71d7a559e37115f4aa8951f16f5c482f1e9c9d108441c13565"),
+               _T("2aa0034e7827ee42"),
+               _T("684ca1ef136f1bab95a3696d9133fc2cb920f506d76820ed5576a996ed33a556")}},
+    {4097,    {_T("675301e8092030088fa914a0aecc8934a3dd312ed9e9b9e65b4cb2b3d2415ad3"),
+               _T("82428610e00365c5"),
+               _T("47cd4a03b7c8d6fbd6de063dfe05f7e80409da11172ad4899e8eaf3eb3e2b745")}},
+    {100000,  {_T("6b4e3f3d1dee15db72c519f5962bad253dfc7d4183d7e30e656259ce1eeab007"),
+               _T("4e16d63e05fac6ed"),
+               _T("01e5d9882459d2bb2336317403897a45e97e28bb0e7488e23ac7f1b07be37c02")}},
+    {1048577, {_T("7d129a470ea3dee543fdd2b4423cb950a5037750f9427a1b4b6488a7b7ff574c"),
+               _T("47de1db22d792a57"),
+               _T("f12ef13e0ea965895ab91f8873a297f3115047117cab07910fa44812629f4ce8")}},
+};
+
+/**
+ The sizes of each update used when checking that data supplied in pieces
+ produces the same result as data supplied at once.  Zero indicates the
+ entire buffer.
+ */
+CONST DWORD TestDigestUpdateSizes[] = {0, 1, 7, 64, 65, 255, 256, 1000, 4097};
+
+/**
+ The number of bytes hashed by each algorithm when measuring throughput.
+ */
+#define TEST_DIGEST_PERF_LENGTH (64 * 1024 * 1024)
+
+/**
+ Fill a buffer with generated data.
+
+ @param Buffer Pointer to the buffer to fill.
+
+ @param Length The number of bytes in Buffer.
+ */
+VOID
+TestDigestGenerateData(
+    __out_ecount(Length) PUCHAR Buffer,
+    __in DWORD Length
+    )
+{
+    DWORD Index;
+
+    for (Index = 0; Index < Length; Index++) {
+        Buffer[Index] = (UCHAR)(Index * 7 + Index / 251);
+    }
+}
+
+/**
+ Calculate the digest of a buffer.
+
+ @param Algorithm The algorithm to use.
+
+ @param Buffer Pointer to the data to hash.
+
+ @param Length The number of bytes in Buffer.
+
+ @param UpdateSize The number of bytes to supply to each update, or zero to
+        supply all of the data at once.
+
+ @param Digest On completion, populated with the digest.
+ */
+VOID
+TestDigestCalculate(
+    __in TEST_DIGEST_ALGORITHM Algorithm,
+    __in_ecount(Length) CONST UCHAR * Buffer,
+    __in DWORD Length,
+    __in DWORD UpdateSize,
+    __out_ecount(32) PUCHAR Digest
+    )
+{
+    YORI_LIB_SHA256_CONTEXT Sha256;
+    YORI_LIB_XXH3_CONTEXT Xxh3;
+    YORI_LIB_BLAKE3_CONTEXT Blake3;
+    DWORD Offset;
+    DWORD BytesThisUpdate;
+
+    if (UpdateSize == 0) {
+        UpdateSize = Length;
+    }
+
+    YoriLibSha256Initialize(&Sha256);
+    YoriLibXxh3Initialize(&Xxh3);
+    YoriLibBlake3Initialize(&Blake3);
+
+    for (Offset = 0; Offset < Length; Offset = Offset + BytesThisUpdate) {
+        BytesThisUpdate = UpdateSize;
+        if (BytesThisUpdate > Length - Offset) {
+            BytesThisUpdate = Length - Offset;
+        }
+        switch(Algorithm) {
+            case TestDigestSha256:
+                YoriLibSha256Update(&Sha256, Buffer + Offset, BytesThisUpdate);
+                break;
+            case TestDigestXxh3:
+                YoriLibXxh3Update(&Xxh3, Buffer + Offset, BytesThisUpdate);
+                break;
+            case TestDigestBlake3:
+                YoriLibBlake3Update(&Blake3, Buffer + Offset, BytesThisUpdate);
+                break;
+        }
+    }
+
+    switch(Algorithm) {
+        case TestDigestSha256:
+            YoriLibSha256Finalize(&Sha256, Digest);
+            break;
+        case TestDigestXxh3:
+            YoriLibXxh3Finalize(&Xxh3, Digest);
+            break;
+        case TestDigestBlake3:
+            YoriLibBlake3Finalize(&Blake3, Digest);
+            break;
+    }
+}
+
+/**
+ Check that each digest algorithm generates known results, and generates the
+ same result regardless of how the data is supplied.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+TestDigest(VOID)
+{
+    PUCHAR Buffer;
+    DWORD BufferLength;
+    DWORD CaseIndex;
+    DWORD UpdateIndex;
+    DWORD Algorithm;
+    PCTEST_DIGEST_CASE Case;
+    UCHAR Digest[32];
+    YORI_STRING DigestString;
+    BOOLEAN Result;
+
+    Result = FALSE;
+    YoriLibInitEmptyString(&DigestString);
+
+    BufferLength = TestDigestCases[sizeof(TestDigestCases)/sizeof(TestDigestCases[0]) - 1].Length;
+    Buffer = YoriLibMalloc(BufferLength);
+    if (Buffer == NULL ||
+        !YoriLibAllocateString(&DigestString, sizeof(Digest) * 2 + 1)) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation failure\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+
+    TestDigestGenerateData(Buffer, BufferLength);
+
+    for (CaseIndex = 0; CaseIndex < sizeof(TestDigestCases)/sizeof(TestDigestCases[0]); CaseIndex++) {
+        Case = &TestDigestCases[CaseIndex];
+        for (Algorithm = 0; Algorithm < TestDigestAlgorithmCount; Algorithm++) {
+            for (UpdateIndex = 0; UpdateIndex < sizeof(TestDigestUpdateSizes)/sizeof(TestDigestUpdateSizes[0]); UpdateIndex++) {
+
+                TestDigestCalculate((TEST_DIGEST_ALGORITHM)Algorithm, Buffer, Case->Length, TestDigestUpdateSizes[UpdateIndex], Digest);
+                YoriLibHexBufferToString(Digest, TestDigestSizes[Algorithm], &DigestString);
+                if (YoriLibCompareStringLit(&DigestString, Case->Expected[Algorithm]) != 0) {
+                    YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                                  _T("%hs:%i %s of %i bytes in updates of %i returned %y, expected %s\n"),
+                                  __FILE__,
+                                  __LINE__,
+                                  TestDigestNames[Algorithm],
+                                  Case->Length,
+                                  TestDigestUpdateSizes[UpdateIndex],
+                                  &DigestString,
+                                  Case->Expected[Algorithm]);
+                    goto Exit;
+                }
+            }
+        }
+    }
+
+    Result = TRUE;
+
+Exit:
+    if (Buffer != NULL) {
+        YoriLibFree(Buffer);
+    }
+    YoriLibFreeStringContents(&DigestString);
+    return Result;
+}
+
+/**
+ Measure the throughput of each digest algorithm.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+TestDigestPerf(VOID)
+{
+    PUCHAR Buffer;
+    DWORD Algorithm;
+    UCHAR Digest[32];
+    LARGE_INTEGER Frequency;
+    LARGE_INTEGER Start;
+    LARGE_INTEGER End;
+    DWORDLONG ElapsedUs;
+
+    Buffer = YoriLibMalloc(TEST_DIGEST_PERF_LENGTH);
+    if (Buffer == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation failure\n"), __FILE__, __LINE__);
+        return FALSE;
+    }
+
+    TestDigestGenerateData(Buffer, TEST_DIGEST_PERF_LENGTH);
+    QueryPerformanceFrequency(&Frequency);
+
+    for (Algorithm = 0; Algorithm < TestDigestAlgorithmCount; Algorithm++) {
+        QueryPerformanceCounter(&Start);
+        TestDigestCalculate((TEST_DIGEST_ALGORITHM)Algorithm, Buffer, TEST_DIGEST_PERF_LENGTH, 1024 * 1024, Digest);
+        QueryPerformanceCounter(&End);
+        ElapsedUs = (DWORDLONG)(End.QuadPart - Start.QuadPart) * 1000000 / Frequency.QuadPart;
+        if (ElapsedUs == 0) {
+            ElapsedUs = 1;
+        }
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                      _T("  %-6s %i MB: %10lli us, %6lli MB/s\n"),
+                      TestDigestNames[Algorithm],
+                      TEST_DIGEST_PERF_LENGTH / (1024 * 1024),
+                      ElapsedUs,
+                      (DWORDLONG)TEST_DIGEST_PERF_LENGTH * 1000000 / (1024 * 1024) / ElapsedUs);
+    }
+
+    YoriLibFree(Buffer);
+    return TRUE;
+}
+
+// vim:sw=4:ts=4:et:
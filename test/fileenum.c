@@ -3,7 +3,7 @@
  *
  * Yori shell test file enumeration
  *
- * Copyright (c) 2022 Malcolm J. Smith
+ * Copyright (c) 2022-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -391,4 +391,311 @@ TestEnumWindows(VOID)
     return TRUE;
 }
 
+/**
+ The number of levels of subdirectories in the tree used to measure
+ recursive enumeration.
+ */
+#define TEST_ENUM_TREE_DEPTH 6
+
+/**
+ The number of subdirectories in each directory of the tree used to measure
+ recursive enumeration.
+ */
+#define TEST_ENUM_TREE_FANOUT 3
+
+/**
+ The number of files in each directory of the tree used to measure recursive
+ enumeration.
+ */
+#define TEST_ENUM_TREE_FILES 8
+
+/**
+ Context passed to the callbacks used when enumerating a generated tree.
+ These may be invoked concurrently.
+ */
+typedef struct _TEST_ENUM_TREE_CONTEXT {
+
+    /**
+     The number of objects found.
+     */
+    LONG ObjectsFound;
+
+    /**
+     Set to TRUE if an object could not be deleted.
+     */
+    BOOLEAN Failed;
+
+    /**
+     If TRUE, each object found is deleted.
+     */
+    BOOLEAN Delete;
+
+} TEST_ENUM_TREE_CONTEXT, *PTEST_ENUM_TREE_CONTEXT;
+
+/**
+ A callback that is invoked for each object found in a generated tree.  If
+ requested, this deletes the object, which can only succeed for a directory
+ if everything within it has already been reported.
+
+ @param FilePath Pointer to the file path that was found.
+
+ @param FileInfo Information about the file.
+
+ @param Depth Specifies recursion depth.  Ignored in this function.
+
+ @param Context Pointer to the tree context.
+
+ @return TRUE to continute enumerating, FALSE to abort.
+ */
+BOOL
+TestEnumTreeFoundCallback(
+    __in PYORI_STRING FilePath,
+    __in_opt PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    PTEST_ENUM_TREE_CONTEXT TreeContext = (PTEST_ENUM_TREE_CONTEXT)Context;
+
+    UNREFERENCED_PARAMETER(Depth);
+
+    InterlockedIncrement(&TreeContext->ObjectsFound);
+
+    if (TreeContext->Delete && FileInfo != NULL) {
+        if (FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            if (!RemoveDirectory(FilePath->StartOfString)) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i could not remove directory %y, error %i\n"), __FILE__, __LINE__, FilePath, GetLastError());
+                TreeContext->Failed = TRUE;
+            }
+        } else {
+            if (!DeleteFile(FilePath->StartOfString)) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i could not delete file %y, error %i\n"), __FILE__, __LINE__, FilePath, GetLastError());
+                TreeContext->Failed = TRUE;
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Create a directory containing files and a tree of subdirectories.
+
+ @param DirName Pointer to the directory to create.  This buffer is used to
+        construct child names and is restored before returning.
+
+ @param Depth The number of levels of subdirectories to create.
+
+ @param ObjectsCreated On successful completion, incremented by the number
+        of files and subdirectories created within the directory.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+TestEnumCreateTree(
+    __inout PYORI_STRING DirName,
+    __in DWORD Depth,
+    __inout PDWORD ObjectsCreated
+    )
+{
+    HANDLE FileHandle;
+    YORI_ALLOC_SIZE_T OriginalLength;
+    DWORD Index;
+
+    if (!CreateDirectory(DirName->StartOfString, NULL)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i could not create directory %y, error %i\n"), __FILE__, __LINE__, DirName, GetLastError());
+        return FALSE;
+    }
+
+    OriginalLength = DirName->LengthInChars;
+
+    for (Index = 0; Index < TEST_ENUM_TREE_FILES; Index++) {
+        DirName->LengthInChars = OriginalLength;
+        DirName->LengthInChars = (YORI_ALLOC_SIZE_T)(DirName->LengthInChars + YoriLibSPrintf(&DirName->StartOfString[DirName->LengthInChars], _T("\\File%i.txt"), Index));
+        FileHandle = CreateFile(DirName->StartOfString, GENERIC_WRITE, 0, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (FileHandle == INVALID_HANDLE_VALUE) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i could not create file %y, error %i\n"), __FILE__, __LINE__, DirName, GetLastError());
+            DirName->LengthInChars = OriginalLength;
+            DirName->StartOfString[OriginalLength] = '\0';
+            return FALSE;
+        }
+        CloseHandle(FileHandle);
+        (*ObjectsCreated)++;
+    }
+
+    if (Depth > 0) {
+        for (Index = 0; Index < TEST_ENUM_TREE_FANOUT; Index++) {
+            DirName->LengthInChars = OriginalLength;
+            DirName->LengthInChars = (YORI_ALLOC_SIZE_T)(DirName->LengthInChars + YoriLibSPrintf(&DirName->StartOfString[DirName->LengthInChars], _T("\\Dir%i"), Index));
+            (*ObjectsCreated)++;
+            if (!TestEnumCreateTree(DirName, Depth - 1, ObjectsCreated)) {
+                DirName->LengthInChars = OriginalLength;
+                DirName->StartOfString[OriginalLength] = '\0';
+                return FALSE;
+            }
+        }
+    }
+
+    DirName->LengthInChars = OriginalLength;
+    DirName->StartOfString[OriginalLength] = '\0';
+    return TRUE;
+}
+
+/**
+ Enumerate a generated tree and measure the time taken.
+
+ @param FileSpec Pointer to the enumeration criteria.
+
+ @param MatchFlags The flags to pass to the enumerate.
+
+ @param TreeContext Pointer to the tree context, whose count is reset before
+        enumerating.
+
+ @param Time On successful completion, updated to contain the time taken in
+        milliseconds.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+TestEnumTimeTree(
+    __in PYORI_STRING FileSpec,
+    __in WORD MatchFlags,
+    __in PTEST_ENUM_TREE_CONTEXT TreeContext,
+    __out PDWORDLONG Time
+    )
+{
+    LARGE_INTEGER Frequency;
+    LARGE_INTEGER Start;
+    LARGE_INTEGER End;
+
+    TreeContext->ObjectsFound = 0;
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+    if (!YoriLibForEachFile(FileSpec, MatchFlags, 0, TestEnumTreeFoundCallback, NULL, TreeContext)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibForEachFile failed searching %y, error %i\n"), __FILE__, __LINE__, FileSpec, GetLastError());
+        return FALSE;
+    }
+    QueryPerformanceCounter(&End);
+    *Time = (DWORDLONG)(End.QuadPart - Start.QuadPart) * 1000 / Frequency.QuadPart;
+    return TRUE;
+}
+
+/**
+ A test variation to generate a deep tree and compare the time taken to
+ enumerate it recursively on a single thread and in parallel.  The tree is
+ removed by a parallel enumerate that reports directories after their
+ contents, which fails if that ordering is not preserved.
+ */
+BOOLEAN
+TestEnumTreePerf(VOID)
+{
+    TEST_ENUM_TREE_CONTEXT TreeContext;
+    YORI_STRING TempPath;
+    YORI_STRING RootDir;
+    YORI_STRING FileSpec;
+    DWORD ObjectsCreated;
+    DWORDLONG SerialTime;
+    DWORDLONG ParallelTime;
+    DWORDLONG DeleteTime;
+    BOOLEAN Result;
+
+    Result = FALSE;
+    YoriLibInitEmptyString(&RootDir);
+    YoriLibInitEmptyString(&FileSpec);
+    ZeroMemory(&TreeContext, sizeof(TreeContext));
+
+    if (!YoriLibGetTempPath(&TempPath, 0)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i could not find temporary path\n"), __FILE__, __LINE__);
+        return FALSE;
+    }
+
+    //
+    //  Allocate enough space for the deepest file name in the tree.
+    //
+
+    if (!YoriLibAllocateString(&RootDir, TempPath.LengthInChars + 32 + (TEST_ENUM_TREE_DEPTH + 1) * 16)) {
+        YoriLibFreeStringContents(&TempPath);
+        return FALSE;
+    }
+
+    if (TempPath.LengthInChars > 0 && YoriLibIsSep(TempPath.StartOfString[TempPath.LengthInChars - 1])) {
+        TempPath.LengthInChars--;
+    }
+
+    RootDir.LengthInChars = YoriLibSPrintf(RootDir.StartOfString, _T("%y\\YTE%x"), &TempPath, GetCurrentProcessId());
+    YoriLibFreeStringContents(&TempPath);
+
+    ObjectsCreated = 0;
+    if (!TestEnumCreateTree(&RootDir, TEST_ENUM_TREE_DEPTH, &ObjectsCreated)) {
+        goto Exit;
+    }
+
+    if (YoriLibYPrintf(&FileSpec, _T("%y\\*"), &RootDir) < 0) {
+        goto Exit;
+    }
+
+    if (!TestEnumTimeTree(&FileSpec,
+                          YORILIB_ENUM_RETURN_FILES | YORILIB_ENUM_RETURN_DIRECTORIES | YORILIB_ENUM_REC_AFTER_RETURN | YORILIB_ENUM_BASIC_EXPANSION,
+                          &TreeContext,
+                          &SerialTime)) {
+        goto Exit;
+    }
+
+    if ((DWORD)TreeContext.ObjectsFound != ObjectsCreated) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i serial enumerate found %i objects, expected %i\n"), __FILE__, __LINE__, TreeContext.ObjectsFound, ObjectsCreated);
+        goto Exit;
+    }
+
+    if (!TestEnumTimeTree(&FileSpec,
+                          YORILIB_ENUM_RETURN_FILES | YORILIB_ENUM_RETURN_DIRECTORIES | YORILIB_ENUM_REC_AFTER_RETURN | YORILIB_ENUM_BASIC_EXPANSION | YORILIB_ENUM_PARALLEL,
+                          &TreeContext,
+                          &ParallelTime)) {
+        goto Exit;
+    }
+
+    if ((DWORD)TreeContext.ObjectsFound != ObjectsCreated) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i parallel enumerate found %i objects, expected %i\n"), __FILE__, __LINE__, TreeContext.ObjectsFound, ObjectsCreated);
+        goto Exit;
+    }
+
+    TreeContext.Delete = TRUE;
+    if (!TestEnumTimeTree(&FileSpec,
+                          YORILIB_ENUM_RETURN_FILES | YORILIB_ENUM_RETURN_DIRECTORIES | YORILIB_ENUM_REC_BEFORE_RETURN | YORILIB_ENUM_BASIC_EXPANSION | YORILIB_ENUM_PARALLEL,
+                          &TreeContext,
+                          &DeleteTime)) {
+        goto Exit;
+    }
+
+    if ((DWORD)TreeContext.ObjectsFound != ObjectsCreated || TreeContext.Failed) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i parallel delete found %i objects, expected %i\n"), __FILE__, __LINE__, TreeContext.ObjectsFound, ObjectsCreated);
+        goto Exit;
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                  _T("  %i objects: serial %lli ms, parallel %lli ms, parallel delete %lli ms\n"),
+                  ObjectsCreated,
+                  SerialTime,
+                  ParallelTime,
+                  DeleteTime);
+
+    Result = TRUE;
+
+Exit:
+    if (!Result) {
+        TreeContext.Delete = TRUE;
+        YoriLibForEachFile(&FileSpec,
+                           YORILIB_ENUM_RETURN_FILES | YORILIB_ENUM_RETURN_DIRECTORIES | YORILIB_ENUM_REC_BEFORE_RETURN | YORILIB_ENUM_BASIC_EXPANSION,
+                           0,
+                           TestEnumTreeFoundCallback,
+                           NULL,
+                           &TreeContext);
+    }
+    if (RootDir.StartOfString != NULL) {
+        RemoveDirectory(RootDir.StartOfString);
+    }
+    YoriLibFreeStringContents(&FileSpec);
+    YoriLibFreeStringContents(&RootDir);
+    return Result;
+}
+
 // vim:sw=4:ts=4:et:
@@ -0,0 +1,399 @@
+/**
+ * @file test/hash.c
+ *
+ * Yori shell hash table tests
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "test.h"
+
+/**
+ A single object inserted into both forms of hash table.
+ */
+typedef struct _TEST_HASH_OBJECT {
+
+    /**
+     The entry for this object in an open addressed hash table.
+     */
+    YORI_OPEN_HASH_ENTRY OpenEntry;
+
+    /**
+     The entry for this object in a chained hash table.
+     */
+    YORI_HASH_ENTRY ChainedEntry;
+
+    /**
+     The key of the object.
+     */
+    YORI_STRING Key;
+
+    /**
+     Storage for the key of the object.
+     */
+    TCHAR KeyBuffer[24];
+
+} TEST_HASH_OBJECT, *PTEST_HASH_OBJECT;
+
+/**
+ Allocate an array of objects with unique keys.  The keys resemble file
+ names, so that different objects share long common prefixes.
+
+ @param Count The number of objects to allocate.
+
+ @return Pointer to the array of objects, or NULL on allocation failure.
+         The caller should free this with YoriLibFree.
+ */
+PTEST_HASH_OBJECT
+TestHashAllocateObjects(
+    __in YORI_ALLOC_SIZE_T Count
+    )
+{
+    PTEST_HASH_OBJECT Objects;
+    YORI_ALLOC_SIZE_T Index;
+
+    if (!YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)Count * sizeof(TEST_HASH_OBJECT))) {
+        return NULL;
+    }
+
+    Objects = YoriLibMalloc(Count * sizeof(TEST_HASH_OBJECT));
+    if (Objects == NULL) {
+        return NULL;
+    }
+
+    ZeroMemory(Objects, Count * sizeof(TEST_HASH_OBJECT));
+    for (Index = 0; Index < Count; Index++) {
+        Objects[Index].Key.StartOfString = Objects[Index].KeyBuffer;
+        Objects[Index].Key.LengthAllocated = sizeof(Objects[Index].KeyBuffer)/sizeof(Objects[Index].KeyBuffer[0]);
+        Objects[Index].Key.LengthInChars = (YORI_ALLOC_SIZE_T)YoriLibSPrintf(Objects[Index].KeyBuffer, _T("obj\\file%08x.obj"), Index);
+    }
+
+    return Objects;
+}
+
+/**
+ A test variation to insert, find, enumerate and remove entries from an open
+ addressed hash table, including while the table is being resized.
+ */
+BOOLEAN
+TestOpenHashTable(VOID)
+{
+    PYORI_OPEN_HASH_TABLE HashTable;
+    PYORI_OPEN_HASH_ENTRY HashEntry;
+    PYORI_OPEN_HASH_ENTRY NextEntry;
+    PTEST_HASH_OBJECT Objects;
+    PTEST_HASH_OBJECT Object;
+    YORI_ALLOC_SIZE_T Count;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T Found;
+    YORI_STRING UpcaseKey;
+    BOOLEAN Result;
+
+    Count = 5000;
+    Objects = TestHashAllocateObjects(Count);
+    if (Objects == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation failure\n"), __FILE__, __LINE__);
+        return FALSE;
+    }
+
+    //
+    //  Start with a small table so that it is forced to grow many times.
+    //
+
+    Result = FALSE;
+    YoriLibInitEmptyString(&UpcaseKey);
+    HashTable = YoriLibAllocateOpenHashTable(0);
+    if (HashTable == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation failure\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+
+    for (Index = 0; Index < Count; Index++) {
+        if (!YoriLibOpenHashInsertByKey(HashTable, &Objects[Index].Key, &Objects[Index], &Objects[Index].OpenEntry)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i insert failed for %y\n"), __FILE__, __LINE__, &Objects[Index].Key);
+            goto Exit;
+        }
+    }
+
+    if (HashTable->EntryCount != Count) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i table contains %i entries, expected %i\n"), __FILE__, __LINE__, HashTable->EntryCount, Count);
+        goto Exit;
+    }
+
+    for (Index = 0; Index < Count; Index++) {
+        HashEntry = YoriLibOpenHashLookupByKey(HashTable, &Objects[Index].Key);
+        if (HashEntry != &Objects[Index].OpenEntry || HashEntry->Context != &Objects[Index]) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i lookup failed for %y\n"), __FILE__, __LINE__, &Objects[Index].Key);
+            goto Exit;
+        }
+    }
+
+    //
+    //  Lookups should not depend on case.
+    //
+
+    if (!YoriLibCopyString(&UpcaseKey, &Objects[Count / 2].Key)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation failure\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+    for (Index = 0; Index < UpcaseKey.LengthInChars; Index++) {
+        UpcaseKey.StartOfString[Index] = YoriLibUpcaseChar(UpcaseKey.StartOfString[Index]);
+    }
+    if (YoriLibOpenHashLookupByKey(HashTable, &UpcaseKey) != &Objects[Count / 2].OpenEntry) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i case insensitive lookup failed for %y\n"), __FILE__, __LINE__, &UpcaseKey);
+        goto Exit;
+    }
+
+    //
+    //  Enumerate, removing every odd object while enumerating.
+    //
+
+    Found = 0;
+    HashEntry = YoriLibOpenHashGetNextEntry(HashTable, NULL);
+    while (HashEntry != NULL) {
+        Found++;
+        NextEntry = YoriLibOpenHashGetNextEntry(HashTable, HashEntry);
+        Object = HashEntry->Context;
+        if (((Object - Objects) % 2) != 0) {
+            YoriLibOpenHashRemoveByEntry(HashTable, HashEntry);
+        }
+        HashEntry = NextEntry;
+    }
+
+    if (Found != Count) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i enumerate found %i entries, expected %i\n"), __FILE__, __LINE__, Found, Count);
+        goto Exit;
+    }
+
+    for (Index = 0; Index < Count; Index++) {
+        HashEntry = YoriLibOpenHashLookupByKey(HashTable, &Objects[Index].Key);
+        if ((Index % 2) != 0 && HashEntry != NULL) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i found removed entry %y\n"), __FILE__, __LINE__, &Objects[Index].Key);
+            goto Exit;
+        }
+        if ((Index % 2) == 0 && HashEntry != &Objects[Index].OpenEntry) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i lookup failed after removal for %y\n"), __FILE__, __LINE__, &Objects[Index].Key);
+            goto Exit;
+        }
+    }
+
+    //
+    //  Reinsert the removed entries, which reuses removed slots, and check
+    //  everything can be found and removed by key.
+    //
+
+    for (Index = 1; Index < Count; Index += 2) {
+        if (!YoriLibOpenHashInsertByKey(HashTable, &Objects[Index].Key, &Objects[Index], &Objects[Index].OpenEntry)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i reinsert failed for %y\n"), __FILE__, __LINE__, &Objects[Index].Key);
+            goto Exit;
+        }
+    }
+
+    for (Index = 0; Index < Count; Index++) {
+        if (YoriLibOpenHashRemoveByKey(HashTable, &Objects[Index].Key) != &Objects[Index].OpenEntry) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i remove failed for %y\n"), __FILE__, __LINE__, &Objects[Index].Key);
+            goto Exit;
+        }
+    }
+
+    if (HashTable->EntryCount != 0 ||
+        YoriLibOpenHashGetNextEntry(HashTable, NULL) != NULL) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i table not empty after removing all entries\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+
+    Result = TRUE;
+
+Exit:
+    if (HashTable != NULL) {
+        if (!Result) {
+            HashEntry = YoriLibOpenHashGetNextEntry(HashTable, NULL);
+            while (HashEntry != NULL) {
+                NextEntry = YoriLibOpenHashGetNextEntry(HashTable, HashEntry);
+                YoriLibOpenHashRemoveByEntry(HashTable, HashEntry);
+                HashEntry = NextEntry;
+            }
+        }
+        YoriLibFreeEmptyOpenHashTable(HashTable);
+    }
+    YoriLibFreeStringContents(&UpcaseKey);
+    YoriLibFree(Objects);
+    return Result;
+}
+
+/**
+ Convert a performance counter delta into microseconds.
+
+ @param Start The starting performance counter value.
+
+ @param End The ending performance counter value.
+
+ @param Frequency The performance counter frequency.
+
+ @return The number of microseconds between the two values.
+ */
+DWORDLONG
+TestHashElapsedMicroseconds(
+    __in PLARGE_INTEGER Start,
+    __in PLARGE_INTEGER End,
+    __in PLARGE_INTEGER Frequency
+    )
+{
+    return (DWORDLONG)(End->QuadPart - Start->QuadPart) * 1000000 / Frequency->QuadPart;
+}
+
+/**
+ Measure the time to insert and look up a specified number of keys in both
+ the chained hash table and the open addressed hash table, and display the
+ result.
+
+ @param Count The number of keys to use.
+
+ @return TRUE to indicate the measurement completed, FALSE if it could not
+         complete.
+ */
+BOOLEAN
+TestHashTablePerfOneSize(
+    __in YORI_ALLOC_SIZE_T Count
+    )
+{
+    PTEST_HASH_OBJECT Objects;
+    PYORI_HASH_TABLE ChainedTable;
+    PYORI_OPEN_HASH_TABLE OpenTable;
+    YORI_ALLOC_SIZE_T Index;
+    LARGE_INTEGER Frequency;
+    LARGE_INTEGER Start;
+    LARGE_INTEGER Inserted;
+    LARGE_INTEGER LookedUp;
+    DWORDLONG ChainedInsert;
+    DWORDLONG ChainedLookup;
+    DWORDLONG OpenInsert;
+    DWORDLONG OpenLookup;
+    BOOLEAN Result;
+
+    Objects = TestHashAllocateObjects(Count);
+    if (Objects == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation failure\n"), __FILE__, __LINE__);
+        return FALSE;
+    }
+
+    QueryPerformanceFrequency(&Frequency);
+    Result = FALSE;
+
+    //
+    //  The chained table is sized the way ymake sizes its target table.
+    //
+
+    ChainedTable = YoriLibAllocateHashTable(4000);
+    OpenTable = YoriLibAllocateOpenHashTable(0);
+    if (ChainedTable == NULL || OpenTable == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation failure\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+
+    QueryPerformanceCounter(&Start);
+    for (Index = 0; Index < Count; Index++) {
+        YoriLibHashInsertByKey(ChainedTable, &Objects[Index].Key, &Objects[Index], &Objects[Index].ChainedEntry);
+    }
+    QueryPerformanceCounter(&Inserted);
+    for (Index = 0; Index < Count; Index++) {
+        if (YoriLibHashLookupByKey(ChainedTable, &Objects[Index].Key) != &Objects[Index].ChainedEntry) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i lookup failed for %y\n"), __FILE__, __LINE__, &Objects[Index].Key);
+            goto Exit;
+        }
+    }
+    QueryPerformanceCounter(&LookedUp);
+    ChainedInsert = TestHashElapsedMicroseconds(&Start, &Inserted, &Frequency);
+    ChainedLookup = TestHashElapsedMicroseconds(&Inserted, &LookedUp, &Frequency);
+
+    QueryPerformanceCounter(&Start);
+    for (Index = 0; Index < Count; Index++) {
+        if (!YoriLibOpenHashInsertByKey(OpenTable, &Objects[Index].Key, &Objects[Index], &Objects[Index].OpenEntry)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i insert failed for %y\n"), __FILE__, __LINE__, &Objects[Index].Key);
+            goto Exit;
+        }
+    }
+    QueryPerformanceCounter(&Inserted);
+    for (Index = 0; Index < Count; Index++) {
+        if (YoriLibOpenHashLookupByKey(OpenTable, &Objects[Index].Key) != &Objects[Index].OpenEntry) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i lookup failed for %y\n"), __FILE__, __LINE__, &Objects[Index].Key);
+            goto Exit;
+        }
+    }
+    QueryPerformanceCounter(&LookedUp);
+    OpenInsert = TestHashElapsedMicroseconds(&Start, &Inserted, &Frequency);
+    OpenLookup = TestHashElapsedMicroseconds(&Inserted, &LookedUp, &Frequency);
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                  _T("  %8i keys: chained insert %10lli us lookup %10lli us, open insert %10lli us lookup %10lli us\n"),
+                  Count,
+                  ChainedInsert,
+                  ChainedLookup,
+                  OpenInsert,
+                  OpenLookup);
+
+    Result = TRUE;
+
+Exit:
+    if (ChainedTable != NULL) {
+        for (Index = 0; Index < Count; Index++) {
+            if (Objects[Index].ChainedEntry.Key.StartOfString != NULL) {
+                YoriLibHashRemoveByEntry(&Objects[Index].ChainedEntry);
+            }
+        }
+        YoriLibFreeEmptyHashTable(ChainedTable);
+    }
+    if (OpenTable != NULL) {
+        for (Index = 0; Index < Count; Index++) {
+            if (OpenTable->EntryCount == 0) {
+                break;
+            }
+            if (YoriLibOpenHashLookupByKey(OpenTable, &Objects[Index].Key) == &Objects[Index].OpenEntry) {
+                YoriLibOpenHashRemoveByEntry(OpenTable, &Objects[Index].OpenEntry);
+            }
+        }
+        YoriLibFreeEmptyOpenHashTable(OpenTable);
+    }
+    YoriLibFree(Objects);
+    return Result;
+}
+
+/**
+ A test variation to compare the performance of the chained hash table with
+ the open addressed hash table at different sizes.
+ */
+BOOLEAN
+TestHashTablePerf(VOID)
+{
+    if (!TestHashTablePerfOneSize(1000) ||
+        !TestHashTablePerfOneSize(100000) ||
+        !TestHashTablePerfOneSize(1000000)) {
+
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+// vim:sw=4:ts=4:et:
@@ -0,0 +1,604 @@
+/**
+ * @file test/ini.c
+ *
+ * Yori shell INI document tests
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "test.h"
+
+/**
+ An INI file containing comments, whitespace, quoted values, a section that
+ appears twice, and a key that appears twice.
+ */
+CONST CHAR TestIniText[] =
+    "; preamble comment\r\n"
+    "[Installed]\r\n"
+    "alpha=1.0\r\n"
+    "  beta =  2.0  \r\n"
+    "\r\n"
+    "[alpha]\r\n"
+    "Version=\"1.0\"\r\n"
+    "Path = 'C:\\with space\\'\r\n"
+    "; comment inside\r\n"
+    "FileCount=2\n"
+    "[ Installed ]\n"
+    "gamma=3.0\n"
+    "[alpha]\n"
+    "Version=duplicate\n";
+
+/**
+ Create a temporary file for INI tests and populate it with text.
+
+ @param Buffer Pointer to the text to write into the file.
+
+ @param Length The number of bytes to write.
+
+ @param TempName On successful completion, updated to contain the name of the
+        file.  The caller should free this with YoriLibFreeStringContents.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+TestIniCreateFile(
+    __in PVOID Buffer,
+    __in DWORD Length,
+    __out PYORI_STRING TempName
+    )
+{
+    HANDLE TempHandle;
+    DWORD BytesWritten;
+
+    if (!TestCreateTempFile(&TempHandle, TempName)) {
+        return FALSE;
+    }
+
+    if (!WriteFile(TempHandle, Buffer, Length, &BytesWritten, NULL) ||
+        BytesWritten != Length) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i write failure\n"), __FILE__, __LINE__);
+        CloseHandle(TempHandle);
+        DeleteFile(TempName->StartOfString);
+        YoriLibFreeStringContents(TempName);
+        return FALSE;
+    }
+
+    CloseHandle(TempHandle);
+    return TRUE;
+}
+
+/**
+ Read the first bytes of a file.
+
+ @param FileName Pointer to the name of the file to read.
+
+ @param Buffer Pointer to a buffer to populate with the contents of the file.
+        The buffer is NULL terminated.
+
+ @param Length The size of the buffer, in bytes.
+
+ @return The number of bytes read, not including the NULL terminator.
+ */
+DWORD
+TestIniReadFile(
+    __in PYORI_STRING FileName,
+    __out_bcount(Length) PUCHAR Buffer,
+    __in DWORD Length
+    )
+{
+    HANDLE FileHandle;
+    DWORD BytesRead;
+
+    Buffer[0] = '\0';
+    FileHandle = CreateFile(FileName->StartOfString,
+                            GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL,
+                            NULL);
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+
+    if (!ReadFile(FileHandle, Buffer, Length - 1, &BytesRead, NULL)) {
+        BytesRead = 0;
+    }
+    Buffer[BytesRead] = '\0';
+    CloseHandle(FileHandle);
+    return BytesRead;
+}
+
+/**
+ Check that a key in an INI document has an expected value.
+
+ @param Document Pointer to the INI document.
+
+ @param Section The section containing the key.
+
+ @param Key The key to check.
+
+ @param Expected The expected value.  If NULL, the key is expected not to
+        exist.
+
+ @return TRUE to indicate the key has the expected value, FALSE if it does
+         not.
+ */
+BOOLEAN
+TestIniCheckValue(
+    __in PYORI_LIB_INI_DOCUMENT Document,
+    __in LPCTSTR Section,
+    __in LPCTSTR Key,
+    __in_opt LPCTSTR Expected
+    )
+{
+    PYORI_LIB_INI_KEY IniKey;
+
+    IniKey = YoriLibIniFindSectionKey(Document, Section, Key);
+    if (Expected == NULL) {
+        if (IniKey != NULL) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i [%s] %s found with value '%y', expected no key\n"), __FILE__, __LINE__, Section, Key, &IniKey->Value);
+            return FALSE;
+        }
+        return TRUE;
+    }
+
+    if (IniKey == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i [%s] %s not found, expected '%s'\n"), __FILE__, __LINE__, Section, Key, Expected);
+        return FALSE;
+    }
+
+    if (YoriLibCompareStringLit(&IniKey->Value, Expected) != 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i [%s] %s is '%y', expected '%s'\n"), __FILE__, __LINE__, Section, Key, &IniKey->Value, Expected);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ A test variation to check parsing, querying, updating and saving an INI
+ document.
+ */
+BOOLEAN
+TestIni(VOID)
+{
+    YORI_LIB_INI_DOCUMENT Document;
+    PYORI_LIB_INI_SECTION Section;
+    PYORI_LIB_INI_KEY Key;
+    YORI_STRING TempName;
+    YORI_STRING Value;
+    UCHAR FileContents[1024];
+    DWORD Count;
+    BOOLEAN Result;
+    WCHAR Utf16Text[] = {0xFEFF, '[', 's', ']', '\r', '\n', 'k', '=', 'v', '\r', '\n'};
+
+    if (!TestIniCreateFile((PVOID)TestIniText, sizeof(TestIniText) - 1, &TempName)) {
+        return FALSE;
+    }
+
+    Result = FALSE;
+    YoriLibInitEmptyString(&Value);
+    ZeroMemory(&Document, sizeof(Document));
+
+    if (!YoriLibAllocateString(&Value, 64)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation failure\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+
+    if (!YoriLibIniLoad(&Document, &TempName)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i could not load %y\n"), __FILE__, __LINE__, &TempName);
+        goto Exit;
+    }
+
+    //
+    //  Check values are trimmed and unquoted, repeated sections are merged,
+    //  the first instance of a repeated key is used, and names are not case
+    //  sensitive.
+    //
+
+    if (!TestIniCheckValue(&Document, _T("Installed"), _T("alpha"), _T("1.0")) ||
+        !TestIniCheckValue(&Document, _T("Installed"), _T("beta"), _T("2.0")) ||
+        !TestIniCheckValue(&Document, _T("Installed"), _T("gamma"), _T("3.0")) ||
+        !TestIniCheckValue(&Document, _T("INSTALLED"), _T("ALPHA"), _T("1.0")) ||
+        !TestIniCheckValue(&Document, _T("alpha"), _T("Version"), _T("1.0")) ||
+        !TestIniCheckValue(&Document, _T("alpha"), _T("Path"), _T("C:\\with space\\")) ||
+        !TestIniCheckValue(&Document, _T("alpha"), _T("missing"), NULL) ||
+        !TestIniCheckValue(&Document, _T("missing"), _T("alpha"), NULL)) {
+
+        goto Exit;
+    }
+
+    if (YoriLibIniGetInt(&Document, _T("alpha"), _T("FileCount"), 0) != 2 ||
+        YoriLibIniGetInt(&Document, _T("alpha"), _T("Version"), 7) != 1 ||
+        YoriLibIniGetInt(&Document, _T("alpha"), _T("missing"), 7) != 7) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i integer query returned unexpected value\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+
+    Value.LengthAllocated = 4;
+    if (!YoriLibIniGetString(&Document, _T("alpha"), _T("Path"), &Value) ||
+        YoriLibCompareStringLit(&Value, _T("C:\\")) != 0) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i truncated query returned '%y'\n"), __FILE__, __LINE__, &Value);
+        goto Exit;
+    }
+    Value.LengthAllocated = 64;
+
+    Count = 0;
+    Section = YoriLibIniGetNextSection(&Document, NULL);
+    while (Section != NULL) {
+        Count++;
+        Section = YoriLibIniGetNextSection(&Document, Section);
+    }
+    if (Count != 2) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i found %i sections, expected 2\n"), __FILE__, __LINE__, Count);
+        goto Exit;
+    }
+
+    Count = 0;
+    Section = YoriLibIniFindSection(&Document, _T("Installed"));
+    Key = YoriLibIniGetNextKey(Section, NULL);
+    while (Key != NULL) {
+        Count++;
+        Key = YoriLibIniGetNextKey(Section, Key);
+    }
+    if (Count != 3) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i found %i installed keys, expected 3\n"), __FILE__, __LINE__, Count);
+        goto Exit;
+    }
+
+    //
+    //  Setting a value to its current contents should not require the file
+    //  to be written.
+    //
+
+    if (!YoriLibIniSetString(&Document, _T("alpha"), _T("Version"), _T("1.0")) ||
+        Document.Modified) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i unchanged value marked document modified\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+
+    //
+    //  Apply a batch of changes and save them.
+    //
+
+    if (!YoriLibIniSetString(&Document, _T("alpha"), _T("Version"), _T("1.1")) ||
+        !YoriLibIniSetString(&Document, _T("delta"), _T("Padded"), _T("  padded  ")) ||
+        !YoriLibIniSetString(&Document, _T("Installed"), _T("delta"), _T("4.0"))) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i could not set values\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+
+    YoriLibIniDeleteKey(&Document, _T("Installed"), _T("beta"));
+    YoriLibIniDeleteSection(&Document, _T("missing"));
+
+    if (!YoriLibIniSave(&Document) || Document.Modified) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i could not save %y\n"), __FILE__, __LINE__, &TempName);
+        goto Exit;
+    }
+
+    YoriLibIniCleanup(&Document);
+
+    if (!YoriLibIniLoad(&Document, &TempName)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i could not reload %y\n"), __FILE__, __LINE__, &TempName);
+        goto Exit;
+    }
+
+    if (!TestIniCheckValue(&Document, _T("Installed"), _T("alpha"), _T("1.0")) ||
+        !TestIniCheckValue(&Document, _T("Installed"), _T("beta"), NULL) ||
+        !TestIniCheckValue(&Document, _T("Installed"), _T("gamma"), _T("3.0")) ||
+        !TestIniCheckValue(&Document, _T("Installed"), _T("delta"), _T("4.0")) ||
+        !TestIniCheckValue(&Document, _T("alpha"), _T("Version"), _T("1.1")) ||
+        !TestIniCheckValue(&Document, _T("alpha"), _T("Path"), _T("C:\\with space\\")) ||
+        !TestIniCheckValue(&Document, _T("delta"), _T("Padded"), _T("  padded  "))) {
+
+        goto Exit;
+    }
+
+    //
+    //  Comments should survive being rewritten.
+    //
+
+    TestIniReadFile(&TempName, FileContents, sizeof(FileContents));
+    if (strstr((LPCSTR)FileContents, "; preamble comment\r\n") == NULL ||
+        strstr((LPCSTR)FileContents, "; comment inside\r\n") == NULL) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i comments were not preserved\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+
+    YoriLibIniCleanup(&Document);
+    DeleteFile(TempName.StartOfString);
+    YoriLibFreeStringContents(&TempName);
+
+    //
+    //  Check that a UTF-16 file is rewritten as UTF-16.
+    //
+
+    if (!TestIniCreateFile(Utf16Text, sizeof(Utf16Text), &TempName)) {
+        goto Exit;
+    }
+
+    if (!YoriLibIniLoad(&Document, &TempName) ||
+        !TestIniCheckValue(&Document, _T("s"), _T("k"), _T("v")) ||
+        !YoriLibIniSetString(&Document, _T("s"), _T("k"), _T("w")) ||
+        !YoriLibIniSave(&Document)) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i could not update UTF-16 file %y\n"), __FILE__, __LINE__, &TempName);
+        goto Exit;
+    }
+
+    Count = TestIniReadFile(&TempName, FileContents, sizeof(FileContents));
+    if (Count < 2 || FileContents[0] != 0xFF || FileContents[1] != 0xFE) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i UTF-16 file was not saved as UTF-16\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+
+    YoriLibIniCleanup(&Document);
+    if (!YoriLibIniLoad(&Document, &TempName) ||
+        !TestIniCheckValue(&Document, _T("s"), _T("k"), _T("w"))) {
+
+        goto Exit;
+    }
+
+    Result = TRUE;
+
+Exit:
+    YoriLibIniCleanup(&Document);
+    YoriLibFreeStringContents(&Value);
+    if (TempName.StartOfString != NULL) {
+        DeleteFile(TempName.StartOfString);
+        YoriLibFreeStringContents(&TempName);
+    }
+    return Result;
+}
+
+/**
+ The number of packages to describe in the INI benchmark.
+ */
+#define TEST_INI_PERF_PACKAGES 1000
+
+/**
+ The number of files installed by each package in the INI benchmark.
+ */
+#define TEST_INI_PERF_FILES 20
+
+/**
+ A test variation to measure the time taken to query every installed package
+ and file from a package INI file, using an in memory INI document compared
+ to the system profile functions.
+ */
+BOOLEAN
+TestIniPerf(VOID)
+{
+    YORI_LIB_INI_DOCUMENT Document;
+    PYORI_LIB_INI_SECTION Section;
+    PYORI_LIB_INI_KEY Key;
+    YORI_STRING TempName;
+    YORI_STRING Value;
+    YORI_STRING InstalledSection;
+    LPTSTR ThisLine;
+    LPTSTR Equals;
+    TCHAR PackageName[32];
+    TCHAR KeyName[32];
+    TCHAR NewValue[64];
+    DWORD PackageIndex;
+    DWORD FileIndex;
+    DWORD FileCount;
+    DWORDLONG DocumentChars;
+    DWORDLONG ProfileChars;
+    DWORDLONG WriteTime;
+    DWORDLONG DocumentTime;
+    DWORDLONG ProfileTime;
+    LARGE_INTEGER Frequency;
+    LARGE_INTEGER Start;
+    LARGE_INTEGER End;
+    BOOLEAN Result;
+
+    if (!TestIniCreateFile("", 0, &TempName)) {
+        return FALSE;
+    }
+
+    Result = FALSE;
+    YoriLibInitEmptyString(&Value);
+    YoriLibInitEmptyString(&InstalledSection);
+    ZeroMemory(&Document, sizeof(Document));
+    QueryPerformanceFrequency(&Frequency);
+
+    if (!YoriLibAllocateString(&Value, 256) ||
+        !YoriLibAllocateString(&InstalledSection, 64 * 1024)) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation failure\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+
+    //
+    //  Generate a package INI file describing every package, and write it
+    //  as a single batch.
+    //
+
+    QueryPerformanceCounter(&Start);
+    if (!YoriLibIniLoad(&Document, &TempName)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i could not load %y\n"), __FILE__, __LINE__, &TempName);
+        goto Exit;
+    }
+
+    for (PackageIndex = 0; PackageIndex < TEST_INI_PERF_PACKAGES; PackageIndex++) {
+        YoriLibSPrintf(PackageName, _T("package%04i"), PackageIndex);
+        YoriLibSPrintf(NewValue, _T("1.%i"), PackageIndex);
+        if (!YoriLibIniSetString(&Document, _T("Installed"), PackageName, NewValue) ||
+            !YoriLibIniSetString(&Document, PackageName, _T("Version"), NewValue) ||
+            !YoriLibIniSetString(&Document, PackageName, _T("Architecture"), _T("amd64"))) {
+
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i could not set values\n"), __FILE__, __LINE__);
+            goto Exit;
+        }
+
+        YoriLibSPrintf(NewValue, _T("%i"), TEST_INI_PERF_FILES);
+        if (!YoriLibIniSetString(&Document, PackageName, _T("FileCount"), NewValue)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i could not set values\n"), __FILE__, __LINE__);
+            goto Exit;
+        }
+
+        for (FileIndex = 1; FileIndex <= TEST_INI_PERF_FILES; FileIndex++) {
+            YoriLibSPrintf(KeyName, _T("File%i"), FileIndex);
+            YoriLibSPrintf(NewValue, _T("%s\\file%02i.exe"), PackageName, FileIndex);
+            if (!YoriLibIniSetString(&Document, PackageName, KeyName, NewValue)) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i could not set values\n"), __FILE__, __LINE__);
+                goto Exit;
+            }
+        }
+    }
+
+    if (!YoriLibIniSave(&Document)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i could not save %y\n"), __FILE__, __LINE__, &TempName);
+        goto Exit;
+    }
+    YoriLibIniCleanup(&Document);
+    QueryPerformanceCounter(&End);
+    WriteTime = (DWORDLONG)(End.QuadPart - Start.QuadPart) * 1000 / Frequency.QuadPart;
+
+    //
+    //  Query every package and file from an in memory document.
+    //
+
+    DocumentChars = 0;
+    QueryPerformanceCounter(&Start);
+    if (!YoriLibIniLoad(&Document, &TempName)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i could not load %y\n"), __FILE__, __LINE__, &TempName);
+        goto Exit;
+    }
+
+    Key = NULL;
+    Section = YoriLibIniFindSection(&Document, _T("Installed"));
+    if (Section != NULL) {
+        Key = YoriLibIniGetNextKey(Section, NULL);
+    }
+    while (Key != NULL) {
+        YoriLibIniGetString(&Document, Key->Name.StartOfString, _T("Version"), &Value);
+        DocumentChars = DocumentChars + Value.LengthInChars;
+        YoriLibIniGetString(&Document, Key->Name.StartOfString, _T("Architecture"), &Value);
+        DocumentChars = DocumentChars + Value.LengthInChars;
+        FileCount = YoriLibIniGetInt(&Document, Key->Name.StartOfString, _T("FileCount"), 0);
+        for (FileIndex = 1; FileIndex <= FileCount; FileIndex++) {
+            YoriLibSPrintf(KeyName, _T("File%i"), FileIndex);
+            YoriLibIniGetString(&Document, Key->Name.StartOfString, KeyName, &Value);
+            DocumentChars = DocumentChars + Value.LengthInChars;
+        }
+        Key = YoriLibIniGetNextKey(Section, Key);
+    }
+    YoriLibIniCleanup(&Document);
+    QueryPerformanceCounter(&End);
+    DocumentTime = (DWORDLONG)(End.QuadPart - Start.QuadPart) * 1000 / Frequency.QuadPart;
+
+    if (DocumentChars == 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i no values found in generated file\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+
+    if (DllKernel32.pGetPrivateProfileIntW == NULL ||
+        DllKernel32.pGetPrivateProfileSectionW == NULL ||
+        DllKernel32.pGetPrivateProfileStringW == NULL) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                      _T("  %i packages: write %lli ms, document read %lli ms, profile functions not available\n"),
+                      TEST_INI_PERF_PACKAGES,
+                      WriteTime,
+                      DocumentTime);
+        Result = TRUE;
+        goto Exit;
+    }
+
+    //
+    //  Query the same values with the profile functions, which parse the
+    //  file for every request.
+    //
+
+    ProfileChars = 0;
+    QueryPerformanceCounter(&Start);
+    InstalledSection.LengthInChars = (YORI_ALLOC_SIZE_T)
+        DllKernel32.pGetPrivateProfileSectionW(_T("Installed"),
+                                               InstalledSection.StartOfString,
+                                               InstalledSection.LengthAllocated,
+                                               TempName.StartOfString);
+    ThisLine = InstalledSection.StartOfString;
+    while (*ThisLine != '\0') {
+        Equals = _tcschr(ThisLine, '=');
+        if (Equals != NULL) {
+            *Equals = '\0';
+        }
+
+        Value.LengthInChars = (YORI_ALLOC_SIZE_T)
+            DllKernel32.pGetPrivateProfileStringW(ThisLine, _T("Version"), _T(""), Value.StartOfString, Value.LengthAllocated, TempName.StartOfString);
+        ProfileChars = ProfileChars + Value.LengthInChars;
+        Value.LengthInChars = (YORI_ALLOC_SIZE_T)
+            DllKernel32.pGetPrivateProfileStringW(ThisLine, _T("Architecture"), _T(""), Value.StartOfString, Value.LengthAllocated, TempName.StartOfString);
+        ProfileChars = ProfileChars + Value.LengthInChars;
+        FileCount = DllKernel32.pGetPrivateProfileIntW(ThisLine, _T("FileCount"), 0, TempName.StartOfString);
+        for (FileIndex = 1; FileIndex <= FileCount; FileIndex++) {
+            YoriLibSPrintf(KeyName, _T("File%i"), FileIndex);
+            Value.LengthInChars = (YORI_ALLOC_SIZE_T)
+                DllKernel32.pGetPrivateProfileStringW(ThisLine, KeyName, _T(""), Value.StartOfString, Value.LengthAllocated, TempName.StartOfString);
+            ProfileChars = ProfileChars + Value.LengthInChars;
+        }
+
+        ThisLine += _tcslen(ThisLine);
+        ThisLine++;
+        if (Equals != NULL) {
+            ThisLine += _tcslen(ThisLine);
+            ThisLine++;
+        }
+    }
+    QueryPerformanceCounter(&End);
+    ProfileTime = (DWORDLONG)(End.QuadPart - Start.QuadPart) * 1000 / Frequency.QuadPart;
+
+    if (ProfileChars != DocumentChars) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i document read %lli chars, profile functions read %lli\n"), __FILE__, __LINE__, DocumentChars, ProfileChars);
+        goto Exit;
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                  _T("  %i packages: write %lli ms, document read %lli ms, profile read %lli ms\n"),
+                  TEST_INI_PERF_PACKAGES,
+                  WriteTime,
+                  DocumentTime,
+                  ProfileTime);
+
+    Result = TRUE;
+
+Exit:
+    YoriLibIniCleanup(&Document);
+    YoriLibFreeStringContents(&Value);
+    YoriLibFreeStringContents(&InstalledSection);
+    DeleteFile(TempName.StartOfString);
+    YoriLibFreeStringContents(&TempName);
+    return Result;
+}
+
+// vim:sw=4:ts=4:et:
@@ -0,0 +1,1169 @@
+/**
+ * @file test/lineread.c
+ *
+ * Yori shell line reading tests
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "test.h"
+
+/**
+ A line that is expected to be returned from the line reader.
+ */
+typedef struct _TEST_LINE_READ_EXPECTED {
+
+    /**
+     The text of the line.
+     */
+    LPCTSTR Text;
+
+    /**
+     The line ending that should terminate the line.
+     */
+    YORI_LIB_LINE_ENDING LineEnding;
+} TEST_LINE_READ_EXPECTED, *PTEST_LINE_READ_EXPECTED;
+
+/**
+ The lines that are expected from reading either encoded form of the test
+ file.
+ */
+CONST TEST_LINE_READ_EXPECTED TestLineReadExpected[] = {
+    {_T("first"),                                              YoriLibLineEndingCRLF},
+    {_T(""),                                                   YoriLibLineEndingCRLF},
+    {_T("a line that is longer than one vector of characters"), YoriLibLineEndingLF},
+    {_T("caf\x00e9"),                                          YoriLibLineEndingCR},
+    {_T("cr only"),                                            YoriLibLineEndingCR},
+    {_T(""),                                                   YoriLibLineEndingLF},
+    {_T("last"),                                               YoriLibLineEndingNone},
+};
+
+/**
+ The UTF-8 form of the test file, including a byte order mark.
+ */
+CONST CHAR TestLineReadUtf8[] =
+    "\xEF\xBB\xBF" "first\r\n"
+    "\r\n"
+    "a line that is longer than one vector of characters\n"
+    "caf\xC3\xA9\r"
+    "cr only\r"
+    "\n"
+    "last";
+
+/**
+ Write a buffer to a file.
+
+ @param FileHandle The file to write to.
+
+ @param Buffer Pointer to the data to write.
+
+ @param Length The number of bytes to write.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+TestLineReadWrite(
+    __in HANDLE FileHandle,
+    __in PVOID Buffer,
+    __in DWORD Length
+    )
+{
+    DWORD BytesWritten;
+
+    if (!WriteFile(FileHandle, Buffer, Length, &BytesWritten, NULL) ||
+        BytesWritten != Length) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i write failure\n"), __FILE__, __LINE__);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Read the test file and check that the expected lines are returned.
+
+ @param FileHandle The file to read, positioned at the start.
+
+ @param UseBatch If TRUE, read lines with YoriLibReadLineBatch.  If FALSE,
+        read lines with YoriLibReadLineToStringEx.
+
+ @param MaximumLines When reading in batches, the maximum number of lines to
+        request in each batch.
+
+ @return TRUE to indicate the expected lines were returned, FALSE if they
+         were not.
+ */
+BOOLEAN
+TestLineReadCheckExpected(
+    __in HANDLE FileHandle,
+    __in BOOLEAN UseBatch,
+    __in YORI_ALLOC_SIZE_T MaximumLines
+    )
+{
+    PVOID LineContext;
+    YORI_STRING LineString;
+    YORI_STRING FoundString;
+    YORI_LIB_LINE_SPAN Lines[4];
+    YORI_LIB_LINE_ENDING LineEnding;
+    YORI_ALLOC_SIZE_T LineCount;
+    YORI_ALLOC_SIZE_T BatchIndex;
+    DWORD Index;
+    BOOL TimeoutReached;
+    BOOLEAN Result;
+
+    ASSERT(MaximumLines <= sizeof(Lines)/sizeof(Lines[0]));
+
+    LineContext = NULL;
+    LineCount = 0;
+    BatchIndex = 0;
+    Result = FALSE;
+    YoriLibInitEmptyString(&LineString);
+
+    for (Index = 0; Index < sizeof(TestLineReadExpected)/sizeof(TestLineReadExpected[0]); Index++) {
+        if (UseBatch) {
+            if (BatchIndex == LineCount) {
+                if (!YoriLibReadLineBatch(&LineString, &LineContext, TRUE, FileHandle, Lines, MaximumLines, &LineCount)) {
+                    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i batch read failed at line %i\n"), __FILE__, __LINE__, Index);
+                    goto Exit;
+                }
+                BatchIndex = 0;
+            }
+            memcpy(&FoundString, &Lines[BatchIndex].Line, sizeof(YORI_STRING));
+            LineEnding = Lines[BatchIndex].LineEnding;
+            BatchIndex++;
+        } else {
+            if (!YoriLibReadLineToStringEx(&LineString, &LineContext, TRUE, INFINITE, FileHandle, &LineEnding, &TimeoutReached)) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i read failed at line %i\n"), __FILE__, __LINE__, Index);
+                goto Exit;
+            }
+            memcpy(&FoundString, &LineString, sizeof(YORI_STRING));
+        }
+
+        if (YoriLibCompareStringLit(&FoundString, TestLineReadExpected[Index].Text) != 0 ||
+            LineEnding != TestLineReadExpected[Index].LineEnding) {
+
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i line %i is '%y' ending %i, expected '%s' ending %i\n"), __FILE__, __LINE__, Index, &FoundString, LineEnding, TestLineReadExpected[Index].Text, TestLineReadExpected[Index].LineEnding);
+            goto Exit;
+        }
+    }
+
+    if (UseBatch) {
+        if (BatchIndex != LineCount ||
+            YoriLibReadLineBatch(&LineString, &LineContext, TRUE, FileHandle, Lines, MaximumLines, &LineCount)) {
+
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i batch read returned too many lines\n"), __FILE__, __LINE__);
+            goto Exit;
+        }
+    } else if (YoriLibReadLineToStringEx(&LineString, &LineContext, TRUE, INFINITE, FileHandle, &LineEnding, &TimeoutReached)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i read returned too many lines\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+
+    Result = TRUE;
+
+Exit:
+    YoriLibLineReadClose(LineContext);
+    YoriLibFreeStringContents(&LineString);
+    return Result;
+}
+
+/**
+ Generate a buffer of text containing lines of varying length, separated by
+ a mixture of CRLF, LF and CR line endings.
+
+ @param Buffer Pointer to the buffer to populate.
+
+ @param Length The number of bytes in the buffer.
+
+ @param LogStyle If TRUE, generate lines that resemble a log file with CRLF
+        line endings.  If FALSE, generate lines of random length, including
+        empty lines, with random line endings.
+ */
+VOID
+TestLineReadGenerateText(
+    __out_bcount(Length) PUCHAR Buffer,
+    __in DWORD Length,
+    __in BOOLEAN LogStyle
+    )
+{
+    DWORD Index;
+    DWORD Seed;
+    DWORD LineLength;
+    DWORD LineNumber;
+    DWORD Count;
+    CHAR LogLine[100];
+
+    Seed = 1;
+    LineNumber = 0;
+    Index = 0;
+    while (Index < Length) {
+        Seed = Seed * 1103515245 + 12345;
+        if (LogStyle) {
+            LineNumber++;
+            Count = YoriLibSPrintfA(LogLine, "2026-10-16 12:%02i:%02i.%03i INFO worker[%04x] request %08x completed in %ims\r\n", (LineNumber / 60000) % 60, (LineNumber / 1000) % 60, LineNumber % 1000, (Seed >> 8) & 0xFFFF, LineNumber, (Seed >> 16) % 500);
+            if (Count > Length - Index) {
+                Count = Length - Index;
+            }
+            memcpy(&Buffer[Index], LogLine, Count);
+            Index = Index + Count;
+        } else {
+            LineLength = (Seed >> 8) % 80;
+            for (Count = 0; Count < LineLength && Index < Length; Count++) {
+                Buffer[Index] = (UCHAR)('a' + (Index % 26));
+                Index++;
+            }
+            if (Index < Length) {
+                Buffer[Index] = (UCHAR)(((Seed >> 16) % 3 == 0)?'\n':'\r');
+                Index++;
+            }
+            if (Index < Length && (Seed >> 16) % 3 == 1) {
+                Buffer[Index] = '\n';
+                Index++;
+            }
+        }
+    }
+}
+
+/**
+ A test variation to check that lines are split on CRLF, LF and CR, that byte
+ order marks are removed, and that YoriLibReadLineBatch returns the same
+ lines as YoriLibReadLineToStringEx.
+ */
+BOOLEAN
+TestLineRead(VOID)
+{
+    HANDLE TempHandle;
+    HANDLE SecondHandle;
+    YORI_STRING TempName;
+    YORI_STRING LineString;
+    YORI_STRING BatchBuffer;
+    YORI_LIB_LINE_SPAN Lines[16];
+    YORI_LIB_LINE_ENDING LineEnding;
+    YORI_ALLOC_SIZE_T LineCount;
+    YORI_ALLOC_SIZE_T LineIndex;
+    PVOID LineContext;
+    PVOID BatchContext;
+    PUCHAR Buffer;
+    DWORD BufferLength;
+    DWORD OriginalEncoding;
+    DWORD Index;
+    DWORD ExpectedLength;
+    DWORD LinesCompared;
+    BOOL TimeoutReached;
+    BOOLEAN Result;
+    WCHAR Bom;
+
+    if (!TestCreateTempFile(&TempHandle, &TempName)) {
+        return FALSE;
+    }
+
+    Result = FALSE;
+    Buffer = NULL;
+    SecondHandle = INVALID_HANDLE_VALUE;
+    LineContext = NULL;
+    BatchContext = NULL;
+    YoriLibInitEmptyString(&LineString);
+    YoriLibInitEmptyString(&BatchBuffer);
+    OriginalEncoding = YoriLibGetMultibyteInputEncoding();
+
+    //
+    //  Check the UTF-8 form of the file, reading one line at a time, and in
+    //  batches of different sizes.
+    //
+
+    YoriLibSetMultibyteInputEncoding(CP_UTF8);
+    if (!TestLineReadWrite(TempHandle, (PVOID)TestLineReadUtf8, sizeof(TestLineReadUtf8) - 1)) {
+        goto Exit;
+    }
+
+    for (Index = 0; Index <= 4; Index++) {
+        SetFilePointer(TempHandle, 0, NULL, FILE_BEGIN);
+        if (!TestLineReadCheckExpected(TempHandle, (BOOLEAN)(Index > 0), (YORI_ALLOC_SIZE_T)Index)) {
+            goto Exit;
+        }
+    }
+
+    //
+    //  Check the UTF-16 form of the file.
+    //
+
+    YoriLibSetMultibyteInputEncoding(CP_UTF16);
+    SetFilePointer(TempHandle, 0, NULL, FILE_BEGIN);
+    SetEndOfFile(TempHandle);
+    Bom = 0xFEFF;
+    if (!TestLineReadWrite(TempHandle, &Bom, sizeof(Bom))) {
+        goto Exit;
+    }
+    for (Index = 0; Index < sizeof(TestLineReadExpected)/sizeof(TestLineReadExpected[0]); Index++) {
+        ExpectedLength = (DWORD)_tcslen(TestLineReadExpected[Index].Text);
+        if (!TestLineReadWrite(TempHandle, (PVOID)TestLineReadExpected[Index].Text, ExpectedLength * sizeof(TCHAR))) {
+            goto Exit;
+        }
+        if (TestLineReadExpected[Index].LineEnding == YoriLibLineEndingCRLF) {
+            if (!TestLineReadWrite(TempHandle, L"\r\n", 2 * sizeof(WCHAR))) {
+                goto Exit;
+            }
+        } else if (TestLineReadExpected[Index].LineEnding == YoriLibLineEndingLF) {
+            if (!TestLineReadWrite(TempHandle, L"\n", sizeof(WCHAR))) {
+                goto Exit;
+            }
+        } else if (TestLineReadExpected[Index].LineEnding == YoriLibLineEndingCR) {
+            if (!TestLineReadWrite(TempHandle, L"\r", sizeof(WCHAR))) {
+                goto Exit;
+            }
+        }
+    }
+
+    for (Index = 0; Index <= 4; Index++) {
+        SetFilePointer(TempHandle, 0, NULL, FILE_BEGIN);
+        if (!TestLineReadCheckExpected(TempHandle, (BOOLEAN)(Index > 0), (YORI_ALLOC_SIZE_T)Index)) {
+            goto Exit;
+        }
+    }
+
+    //
+    //  Generate a file that spans several read buffers, and check that
+    //  both forms of reading return the same lines, including where a CRLF
+    //  is split across reads.
+    //
+
+    YoriLibSetMultibyteInputEncoding(CP_UTF8);
+    BufferLength = 1024 * 1024;
+    Buffer = YoriLibMalloc(BufferLength);
+    if (Buffer == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation failure\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+
+    TestLineReadGenerateText(Buffer, BufferLength, FALSE);
+    SetFilePointer(TempHandle, 0, NULL, FILE_BEGIN);
+    SetEndOfFile(TempHandle);
+    if (!TestLineReadWrite(TempHandle, Buffer, BufferLength)) {
+        goto Exit;
+    }
+    SetFilePointer(TempHandle, 0, NULL, FILE_BEGIN);
+
+    SecondHandle = CreateFile(TempName.StartOfString,
+                              GENERIC_READ,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              NULL,
+                              OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL,
+                              NULL);
+    if (SecondHandle == INVALID_HANDLE_VALUE) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i could not open %y\n"), __FILE__, __LINE__, &TempName);
+        goto Exit;
+    }
+
+    LinesCompared = 0;
+    while (YoriLibReadLineBatch(&BatchBuffer, &BatchContext, TRUE, SecondHandle, Lines, sizeof(Lines)/sizeof(Lines[0]), &LineCount)) {
+        for (LineIndex = 0; LineIndex < LineCount; LineIndex++) {
+            if (!YoriLibReadLineToStringEx(&LineString, &LineContext, TRUE, INFINITE, TempHandle, &LineEnding, &TimeoutReached)) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i batch read returned more lines than single reads\n"), __FILE__, __LINE__);
+                goto Exit;
+            }
+            if (YoriLibCompareString(&LineString, &Lines[LineIndex].Line) != 0 ||
+                LineEnding != Lines[LineIndex].LineEnding) {
+
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i line %i differs between batch and single reads\n"), __FILE__, __LINE__, LinesCompared);
+                goto Exit;
+            }
+            LinesCompared++;
+        }
+    }
+
+    if (YoriLibReadLineToStringEx(&LineString, &LineContext, TRUE, INFINITE, TempHandle, &LineEnding, &TimeoutReached)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i single reads returned more lines than batch read\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+
+    Result = TRUE;
+
+Exit:
+    YoriLibSetMultibyteInputEncoding(OriginalEncoding);
+    YoriLibLineReadClose(LineContext);
+    YoriLibLineReadClose(BatchContext);
+    YoriLibFreeStringContents(&LineString);
+    YoriLibFreeStringContents(&BatchBuffer);
+    if (Buffer != NULL) {
+        YoriLibFree(Buffer);
+    }
+    if (SecondHandle != INVALID_HANDLE_VALUE) {
+        CloseHandle(SecondHandle);
+    }
+    CloseHandle(TempHandle);
+    DeleteFile(TempName.StartOfString);
+    YoriLibFreeStringContents(&TempName);
+    return Result;
+}
+
+/**
+ The number of megabytes of text to read in the line reading benchmark.
+ */
+#define TEST_LINE_READ_PERF_MB 1024
+
+/**
+ A test variation to measure the throughput of reading a large log file one
+ line at a time compared to reading it in batches.
+ */
+BOOLEAN
+TestLineReadPerf(VOID)
+{
+    HANDLE TempHandle;
+    YORI_STRING TempName;
+    YORI_STRING LineString;
+    YORI_LIB_LINE_SPAN Lines[64];
+    YORI_LIB_LINE_ENDING LineEnding;
+    YORI_ALLOC_SIZE_T LineCount;
+    PVOID LineContext;
+    PUCHAR Buffer;
+    DWORD BufferLength;
+    DWORD Index;
+    DWORDLONG SingleLines;
+    DWORDLONG BatchLines;
+    DWORDLONG SingleTime;
+    DWORDLONG BatchTime;
+    LARGE_INTEGER Frequency;
+    LARGE_INTEGER Start;
+    LARGE_INTEGER End;
+    BOOL TimeoutReached;
+    BOOLEAN Result;
+
+    if (!TestCreateTempFile(&TempHandle, &TempName)) {
+        return FALSE;
+    }
+
+    Result = FALSE;
+    YoriLibInitEmptyString(&LineString);
+    QueryPerformanceFrequency(&Frequency);
+
+    BufferLength = 1024 * 1024;
+    Buffer = YoriLibMalloc(BufferLength);
+    if (Buffer == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation failure\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+
+    TestLineReadGenerateText(Buffer, BufferLength, TRUE);
+    for (Index = 0; Index < TEST_LINE_READ_PERF_MB; Index++) {
+        if (!TestLineReadWrite(TempHandle, Buffer, BufferLength)) {
+            goto Exit;
+        }
+    }
+
+    //
+    //  Read the file one line at a time.
+    //
+
+    SetFilePointer(TempHandle, 0, NULL, FILE_BEGIN);
+    LineContext = NULL;
+    SingleLines = 0;
+    QueryPerformanceCounter(&Start);
+    while (YoriLibReadLineToStringEx(&LineString, &LineContext, TRUE, INFINITE, TempHandle, &LineEnding, &TimeoutReached)) {
+        SingleLines++;
+    }
+    QueryPerformanceCounter(&End);
+    YoriLibLineReadClose(LineContext);
+    SingleTime = (DWORDLONG)(End.QuadPart - Start.QuadPart) * 1000 / Frequency.QuadPart;
+
+    //
+    //  Read the file in batches.
+    //
+
+    SetFilePointer(TempHandle, 0, NULL, FILE_BEGIN);
+    LineContext = NULL;
+    BatchLines = 0;
+    QueryPerformanceCounter(&Start);
+    while (YoriLibReadLineBatch(&LineString, &LineContext, TRUE, TempHandle, Lines, sizeof(Lines)/sizeof(Lines[0]), &LineCount)) {
+        BatchLines = BatchLines + LineCount;
+    }
+    QueryPerformanceCounter(&End);
+    YoriLibLineReadClose(LineContext);
+    BatchTime = (DWORDLONG)(End.QuadPart - Start.QuadPart) * 1000 / Frequency.QuadPart;
+
+    if (SingleLines != BatchLines) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i single reads found %lli lines, batch reads found %lli\n"), __FILE__, __LINE__, SingleLines, BatchLines);
+        goto Exit;
+    }
+
+    if (SingleTime == 0) {
+        SingleTime = 1;
+    }
+    if (BatchTime == 0) {
+        BatchTime = 1;
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                  _T("  %i Mb, %lli lines: single %lli ms (%lli Mb/s), batch %lli ms (%lli Mb/s)\n"),
+                  TEST_LINE_READ_PERF_MB,
+                  SingleLines,
+                  SingleTime,
+                  (DWORDLONG)TEST_LINE_READ_PERF_MB * 1000 / SingleTime,
+                  BatchTime,
+                  (DWORDLONG)TEST_LINE_READ_PERF_MB * 1000 / BatchTime);
+
+    Result = TRUE;
+
+Exit:
+    YoriLibFreeStringContents(&LineString);
+    if (Buffer != NULL) {
+        YoriLibFree(Buffer);
+    }
+    CloseHandle(TempHandle);
+    DeleteFile(TempName.StartOfString);
+    YoriLibFreeStringContents(&TempName);
+    return Result;
+}
+
+/**
+ Buffers which test line counting, covering each line ending, byte order
+ marks, and UTF-8 which generates a different number of characters to the
+ number of bytes.
+ */
+CONST CHAR * CONST TestLineCountBuffers[] = {
+    "",
+    "a",
+    "a\r",
+    "a\n",
+    "a\r\n",
+    "\r",
+    "\n\r",
+    "\r\r\n\n",
+    "one\rtwo\nthree\r\nfour\n\rfive",
+    "\xEF\xBB\xBF",
+    "\xEF\xBB\xBF" "bom\r",
+    "\xEF\xBB\xBE" "not a bom\n",
+    "caf\xC3\xA9 \xE2\x82\xAC \xF0\x9F\x98\x80\r\n\xC3\xA9",
+    "lone \x80 continuation\n\xFF\n",
+    "truncated \xC3\r\n\xC3",
+};
+
+/**
+ Count the lines in a file by reading each line, which is the result that
+ YoriLibCountLines is expected to return.  A carriage return at the end of
+ the file ends the final line, even if the line reader included it in the
+ line.
+
+ @param FileHandle The file to read, positioned at the start.
+
+ @param LineCount On completion, populated with the number of lines and
+        their lengths.
+ */
+VOID
+TestLineCountWithReader(
+    __in HANDLE FileHandle,
+    __out PYORI_LIB_LINE_COUNT LineCount
+    )
+{
+    PVOID LineContext;
+    YORI_STRING LineString;
+    YORI_LIB_LINE_ENDING LineEnding;
+    BOOL TimeoutReached;
+
+    LineContext = NULL;
+    YoriLibInitEmptyString(&LineString);
+    ZeroMemory(LineCount, sizeof(YORI_LIB_LINE_COUNT));
+
+    while (YoriLibReadLineToStringEx(&LineString, &LineContext, TRUE, INFINITE, FileHandle, &LineEnding, &TimeoutReached)) {
+        if (LineEnding == YoriLibLineEndingNone &&
+            LineString.LengthInChars > 0 &&
+            LineString.StartOfString[LineString.LengthInChars - 1] == '\r') {
+
+            LineString.LengthInChars--;
+        }
+        if (LineCount->LineCount == 0 || LineString.LengthInChars < LineCount->ShortestLine) {
+            LineCount->ShortestLine = LineString.LengthInChars;
+        }
+        if (LineString.LengthInChars > LineCount->LongestLine) {
+            LineCount->LongestLine = LineString.LengthInChars;
+        }
+        LineCount->LineCount++;
+        LineCount->TotalChars = LineCount->TotalChars + LineString.LengthInChars;
+    }
+
+    YoriLibLineReadClose(LineContext);
+    YoriLibFreeStringContents(&LineString);
+}
+
+/**
+ Check that counting the lines in a file returns the same result as reading
+ each line, both with and without calculating line lengths.
+
+ @param FileHandle The file to check.
+
+ @param Description A description of the file to include in any error.
+
+ @return TRUE to indicate the results match, FALSE if they do not.
+ */
+BOOLEAN
+TestLineCountCompare(
+    __in HANDLE FileHandle,
+    __in LPCTSTR Description
+    )
+{
+    YORI_LIB_LINE_COUNT Expected;
+    YORI_LIB_LINE_COUNT Found;
+
+    SetFilePointer(FileHandle, 0, NULL, FILE_BEGIN);
+    TestLineCountWithReader(FileHandle, &Expected);
+
+    SetFilePointer(FileHandle, 0, NULL, FILE_BEGIN);
+    if (!YoriLibCountLines(FileHandle, TRUE, &Found)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i count failed for %s\n"), __FILE__, __LINE__, Description);
+        return FALSE;
+    }
+
+    if (Found.LineCount != Expected.LineCount ||
+        Found.TotalChars != Expected.TotalChars ||
+        Found.ShortestLine != Expected.ShortestLine ||
+        Found.LongestLine != Expected.LongestLine) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                      _T("%hs:%i %s counted %lli lines %lli chars shortest %lli longest %lli, expected %lli lines %lli chars shortest %lli longest %lli\n"),
+                      __FILE__, __LINE__, Description,
+                      Found.LineCount, Found.TotalChars, Found.ShortestLine, Found.LongestLine,
+                      Expected.LineCount, Expected.TotalChars, Expected.ShortestLine, Expected.LongestLine);
+        return FALSE;
+    }
+
+    SetFilePointer(FileHandle, 0, NULL, FILE_BEGIN);
+    if (!YoriLibCountLines(FileHandle, FALSE, &Found)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i count failed for %s\n"), __FILE__, __LINE__, Description);
+        return FALSE;
+    }
+
+    if (Found.LineCount != Expected.LineCount) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i %s counted %lli lines without lengths, expected %lli\n"), __FILE__, __LINE__, Description, Found.LineCount, Expected.LineCount);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Check that a carriage return at the end of a file ends the final line when
+ counting lines in a specified input encoding.
+
+ @param FileHandle A temporary file which can be overwritten.
+
+ @param Encoding The input encoding to count lines with.  Encodings other
+        than UTF-8 are counted with the line reader.
+
+ @return TRUE to indicate the count is correct, FALSE if it is not.
+ */
+BOOLEAN
+TestLineCountFinalCr(
+    __in HANDLE FileHandle,
+    __in DWORD Encoding
+    )
+{
+    YORI_LIB_LINE_COUNT Found;
+    CHAR Buffer[] = "one\r\ntwo\r";
+
+    SetFilePointer(FileHandle, 0, NULL, FILE_BEGIN);
+    SetEndOfFile(FileHandle);
+    if (!TestLineReadWrite(FileHandle, Buffer, sizeof(Buffer) - 1)) {
+        return FALSE;
+    }
+
+    YoriLibSetMultibyteInputEncoding(Encoding);
+    SetFilePointer(FileHandle, 0, NULL, FILE_BEGIN);
+    if (!YoriLibCountLines(FileHandle, TRUE, &Found)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i count failed for encoding %i\n"), __FILE__, __LINE__, Encoding);
+        return FALSE;
+    }
+
+    if (Found.LineCount != 2 ||
+        Found.TotalChars != 6 ||
+        Found.ShortestLine != 3 ||
+        Found.LongestLine != 3) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                      _T("%hs:%i encoding %i counted %lli lines %lli chars shortest %lli longest %lli, expected 2 lines 6 chars shortest 3 longest 3\n"),
+                      __FILE__, __LINE__, Encoding,
+                      Found.LineCount, Found.TotalChars, Found.ShortestLine, Found.LongestLine);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ A test variation to check that counting lines returns the same number of
+ lines and line lengths as reading each line.
+ */
+BOOLEAN
+TestLineCount(VOID)
+{
+    HANDLE TempHandle;
+    YORI_STRING TempName;
+    PUCHAR Buffer;
+    DWORD BufferLength;
+    DWORD OriginalEncoding;
+    DWORD Index;
+    DWORD Length;
+    BOOLEAN Result;
+
+    if (!TestCreateTempFile(&TempHandle, &TempName)) {
+        return FALSE;
+    }
+
+    Result = FALSE;
+    Buffer = NULL;
+    OriginalEncoding = YoriLibGetMultibyteInputEncoding();
+    YoriLibSetMultibyteInputEncoding(CP_UTF8);
+
+    for (Index = 0; Index < sizeof(TestLineCountBuffers)/sizeof(TestLineCountBuffers[0]); Index++) {
+        SetFilePointer(TempHandle, 0, NULL, FILE_BEGIN);
+        SetEndOfFile(TempHandle);
+        Length = 0;
+        while (TestLineCountBuffers[Index][Length] != '\0') {
+            Length++;
+        }
+        if (Length > 0 &&
+            !TestLineReadWrite(TempHandle, (PVOID)TestLineCountBuffers[Index], Length)) {
+            goto Exit;
+        }
+        if (!TestLineCountCompare(TempHandle, _T("buffer"))) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i failing buffer is %i\n"), __FILE__, __LINE__, Index);
+            goto Exit;
+        }
+    }
+
+    //
+    //  Check a file that spans several read buffers with random line
+    //  endings.
+    //
+
+    BufferLength = 1024 * 1024;
+    Buffer = YoriLibMalloc(BufferLength);
+    if (Buffer == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation failure\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+
+    TestLineReadGenerateText(Buffer, BufferLength, FALSE);
+    SetFilePointer(TempHandle, 0, NULL, FILE_BEGIN);
+    SetEndOfFile(TempHandle);
+    if (!TestLineReadWrite(TempHandle, Buffer, BufferLength)) {
+        goto Exit;
+    }
+    if (!TestLineCountCompare(TempHandle, _T("generated text"))) {
+        goto Exit;
+    }
+
+    if (!TestLineCountFinalCr(TempHandle, CP_UTF8) ||
+        !TestLineCountFinalCr(TempHandle, 1252)) {
+        goto Exit;
+    }
+
+    Result = TRUE;
+
+Exit:
+    YoriLibSetMultibyteInputEncoding(OriginalEncoding);
+    if (Buffer != NULL) {
+        YoriLibFree(Buffer);
+    }
+    CloseHandle(TempHandle);
+    DeleteFile(TempName.StartOfString);
+    YoriLibFreeStringContents(&TempName);
+    return Result;
+}
+
+/**
+ The number of megabytes in the file used to check counting large files on
+ multiple threads.  This must be large enough for the file to be split into
+ multiple ranges.
+ */
+#define TEST_LINE_COUNT_LARGE_MB 80
+
+/**
+ A test variation to check that counting a file large enough to be split
+ into ranges returns the same result as reading each line.  This writes a
+ large file so it is only run when explicitly requested.
+ */
+BOOLEAN
+TestLineCountLarge(VOID)
+{
+    HANDLE TempHandle;
+    YORI_STRING TempName;
+    PUCHAR Buffer;
+    DWORD BufferLength;
+    DWORD OriginalEncoding;
+    DWORD Index;
+    DWORD Pass;
+    BOOLEAN Result;
+
+    if (!TestCreateTempFile(&TempHandle, &TempName)) {
+        return FALSE;
+    }
+
+    Result = FALSE;
+    OriginalEncoding = YoriLibGetMultibyteInputEncoding();
+    YoriLibSetMultibyteInputEncoding(CP_UTF8);
+
+    BufferLength = 1024 * 1024;
+    Buffer = YoriLibMalloc(BufferLength);
+    if (Buffer == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation failure\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+
+    TestLineReadGenerateText(Buffer, BufferLength, FALSE);
+
+    //
+    //  Check a file large enough to be counted in ranges.  Each megabyte
+    //  of the file is identical, so every range boundary falls at the same
+    //  place in the text.  On the first pass this is within a CRLF, and on
+    //  the second pass it is within a line.
+    //
+
+    for (Pass = 0; Pass < 2; Pass++) {
+        if (Pass == 0) {
+            Buffer[0] = '\n';
+            Buffer[BufferLength - 1] = '\r';
+        } else {
+            Buffer[0] = 'x';
+            Buffer[BufferLength - 1] = 'y';
+        }
+
+        SetFilePointer(TempHandle, 0, NULL, FILE_BEGIN);
+        SetEndOfFile(TempHandle);
+        for (Index = 0; Index < TEST_LINE_COUNT_LARGE_MB; Index++) {
+            if (!TestLineReadWrite(TempHandle, Buffer, BufferLength)) {
+                goto Exit;
+            }
+        }
+        if (!TestLineCountCompare(TempHandle, _T("large file"))) {
+            goto Exit;
+        }
+    }
+
+    Result = TRUE;
+
+Exit:
+    YoriLibSetMultibyteInputEncoding(OriginalEncoding);
+    if (Buffer != NULL) {
+        YoriLibFree(Buffer);
+    }
+    CloseHandle(TempHandle);
+    DeleteFile(TempName.StartOfString);
+    YoriLibFreeStringContents(&TempName);
+    return Result;
+}
+
+/**
+ A test variation to measure the throughput of counting lines in a large
+ log file compared to reading each line.
+ */
+BOOLEAN
+TestLineCountPerf(VOID)
+{
+    HANDLE TempHandle;
+    YORI_STRING TempName;
+    YORI_LIB_LINE_COUNT ReadCount;
+    YORI_LIB_LINE_COUNT LineCount;
+    YORI_LIB_LINE_COUNT MeasureCount;
+    PUCHAR Buffer;
+    DWORD BufferLength;
+    DWORD Index;
+    DWORD OriginalEncoding;
+    DWORDLONG ReadTime;
+    DWORDLONG CountTime;
+    DWORDLONG MeasureTime;
+    LARGE_INTEGER Frequency;
+    LARGE_INTEGER Start;
+    LARGE_INTEGER End;
+    BOOLEAN Result;
+
+    if (!TestCreateTempFile(&TempHandle, &TempName)) {
+        return FALSE;
+    }
+
+    Result = FALSE;
+    QueryPerformanceFrequency(&Frequency);
+    OriginalEncoding = YoriLibGetMultibyteInputEncoding();
+    YoriLibSetMultibyteInputEncoding(CP_UTF8);
+
+    BufferLength = 1024 * 1024;
+    Buffer = YoriLibMalloc(BufferLength);
+    if (Buffer == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation failure\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+
+    TestLineReadGenerateText(Buffer, BufferLength, TRUE);
+    for (Index = 0; Index < TEST_LINE_READ_PERF_MB; Index++) {
+        if (!TestLineReadWrite(TempHandle, Buffer, BufferLength)) {
+            goto Exit;
+        }
+    }
+
+    //
+    //  Read each line, which is how lines were previously counted.
+    //
+
+    SetFilePointer(TempHandle, 0, NULL, FILE_BEGIN);
+    QueryPerformanceCounter(&Start);
+    TestLineCountWithReader(TempHandle, &ReadCount);
+    QueryPerformanceCounter(&End);
+    ReadTime = (DWORDLONG)(End.QuadPart - Start.QuadPart) * 1000 / Frequency.QuadPart;
+
+    //
+    //  Count lines without lengths, then with lengths.
+    //
+
+    SetFilePointer(TempHandle, 0, NULL, FILE_BEGIN);
+    QueryPerformanceCounter(&Start);
+    if (!YoriLibCountLines(TempHandle, FALSE, &LineCount)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i count failed\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+    QueryPerformanceCounter(&End);
+    CountTime = (DWORDLONG)(End.QuadPart - Start.QuadPart) * 1000 / Frequency.QuadPart;
+
+    SetFilePointer(TempHandle, 0, NULL, FILE_BEGIN);
+    QueryPerformanceCounter(&Start);
+    if (!YoriLibCountLines(TempHandle, TRUE, &MeasureCount)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i count failed\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+    QueryPerformanceCounter(&End);
+    MeasureTime = (DWORDLONG)(End.QuadPart - Start.QuadPart) * 1000 / Frequency.QuadPart;
+
+    if (LineCount.LineCount != ReadCount.LineCount ||
+        MeasureCount.LineCount != ReadCount.LineCount ||
+        MeasureCount.TotalChars != ReadCount.TotalChars ||
+        MeasureCount.ShortestLine != ReadCount.ShortestLine ||
+        MeasureCount.LongestLine != ReadCount.LongestLine) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i reading found %lli lines, counting found %lli and %lli\n"), __FILE__, __LINE__, ReadCount.LineCount, LineCount.LineCount, MeasureCount.LineCount);
+        goto Exit;
+    }
+
+    if (ReadTime == 0) {
+        ReadTime = 1;
+    }
+    if (CountTime == 0) {
+        CountTime = 1;
+    }
+    if (MeasureTime == 0) {
+        MeasureTime = 1;
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                  _T("  %i Mb, %lli lines: read %lli ms (%lli Mb/s), count %lli ms (%lli Mb/s), count with lengths %lli ms (%lli Mb/s)\n"),
+                  TEST_LINE_READ_PERF_MB,
+                  ReadCount.LineCount,
+                  ReadTime,
+                  (DWORDLONG)TEST_LINE_READ_PERF_MB * 1000 / ReadTime,
+                  CountTime,
+                  (DWORDLONG)TEST_LINE_READ_PERF_MB * 1000 / CountTime,
+                  MeasureTime,
+                  (DWORDLONG)TEST_LINE_READ_PERF_MB * 1000 / MeasureTime);
+
+    Result = TRUE;
+
+Exit:
+    YoriLibSetMultibyteInputEncoding(OriginalEncoding);
+    if (Buffer != NULL) {
+        YoriLibFree(Buffer);
+    }
+    CloseHandle(TempHandle);
+    DeleteFile(TempName.StartOfString);
+    YoriLibFreeStringContents(&TempName);
+    return Result;
+}
+
+/**
+ Check that the final lines found in a file are the lines that reading the
+ file would return last, by reading forward from the offset that was found
+ and counting the lines.
+
+ @param FileHandle The file to check.
+
+ @param Description A description of the file to include in any error.
+
+ @return TRUE to indicate the results match, FALSE if they do not.
+ */
+BOOLEAN
+TestFinalLinesCompare(
+    __in HANDLE FileHandle,
+    __in LPCTSTR Description
+    )
+{
+    YORI_LIB_LINE_COUNT Total;
+    YORI_LIB_LINE_COUNT Found;
+    YORI_MAX_UNSIGNED_T Requested[10];
+    YORI_MAX_UNSIGNED_T Expected;
+    YORI_MAX_UNSIGNED_T Offset;
+    DWORD Index;
+
+    SetFilePointer(FileHandle, 0, NULL, FILE_BEGIN);
+    TestLineCountWithReader(FileHandle, &Total);
+
+    Requested[0] = 0;
+    Requested[1] = 1;
+    Requested[2] = 2;
+    Requested[3] = 3;
+    Requested[4] = 10;
+    Requested[5] = 100;
+    Requested[6] = 1000;
+    Requested[7] = Total.LineCount;
+    Requested[8] = Total.LineCount + 1;
+    Requested[9] = 1;
+    if (Total.LineCount > 1) {
+        Requested[9] = Total.LineCount - 1;
+    }
+
+    for (Index = 0; Index < sizeof(Requested)/sizeof(Requested[0]); Index++) {
+        if (!YoriLibFindFinalLines(FileHandle, Requested[Index], &Offset)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i find final lines failed for %s\n"), __FILE__, __LINE__, Description);
+            return FALSE;
+        }
+
+        Expected = Requested[Index];
+        if (Expected > Total.LineCount) {
+            Expected = Total.LineCount;
+        }
+
+        TestLineCountWithReader(FileHandle, &Found);
+        if (Found.LineCount != Expected) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i %s found %lli lines from offset %lli when requesting %lli, expected %lli\n"), __FILE__, __LINE__, Description, Found.LineCount, Offset, Requested[Index], Expected);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ A test variation to check that searching backwards for the final lines of a
+ file finds the same lines as reading the file, in both 8 bit and UTF16
+ encodings.
+ */
+BOOLEAN
+TestFinalLines(VOID)
+{
+    HANDLE TempHandle;
+    YORI_STRING TempName;
+    PUCHAR Buffer;
+    PWCHAR WideBuffer;
+    DWORD BufferLength;
+    DWORD OriginalEncoding;
+    DWORD Index;
+    DWORD Length;
+    BOOLEAN Result;
+
+    if (!TestCreateTempFile(&TempHandle, &TempName)) {
+        return FALSE;
+    }
+
+    Result = FALSE;
+    Buffer = NULL;
+    WideBuffer = NULL;
+    OriginalEncoding = YoriLibGetMultibyteInputEncoding();
+    YoriLibSetMultibyteInputEncoding(CP_UTF8);
+
+    for (Index = 0; Index < sizeof(TestLineCountBuffers)/sizeof(TestLineCountBuffers[0]); Index++) {
+        SetFilePointer(TempHandle, 0, NULL, FILE_BEGIN);
+        SetEndOfFile(TempHandle);
+        Length = 0;
+        while (TestLineCountBuffers[Index][Length] != '\0') {
+            Length++;
+        }
+        if (Length > 0 &&
+            !TestLineReadWrite(TempHandle, (PVOID)TestLineCountBuffers[Index], Length)) {
+            goto Exit;
+        }
+        if (!TestFinalLinesCompare(TempHandle, _T("buffer"))) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i failing buffer is %i\n"), __FILE__, __LINE__, Index);
+            goto Exit;
+        }
+    }
+
+    //
+    //  Check a file that spans many blocks with random line endings, so
+    //  that some block boundaries fall within a CRLF.
+    //
+
+    BufferLength = 1024 * 1024;
+    Buffer = YoriLibMalloc(BufferLength);
+    if (Buffer == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation failure\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+
+    TestLineReadGenerateText(Buffer, BufferLength, FALSE);
+    SetFilePointer(TempHandle, 0, NULL, FILE_BEGIN);
+    SetEndOfFile(TempHandle);
+    if (!TestLineReadWrite(TempHandle, Buffer, BufferLength)) {
+        goto Exit;
+    }
+    if (!TestFinalLinesCompare(TempHandle, _T("generated text"))) {
+        goto Exit;
+    }
+
+    //
+    //  Check the same text in UTF16, following a byte order mark.
+    //
+
+    WideBuffer = YoriLibMalloc((BufferLength + 1) * sizeof(WCHAR));
+    if (WideBuffer == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation failure\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+
+    WideBuffer[0] = 0xFEFF;
+    for (Index = 0; Index < BufferLength; Index++) {
+        WideBuffer[Index + 1] = Buffer[Index];
+    }
+
+    YoriLibSetMultibyteInputEncoding(CP_UTF16);
+    SetFilePointer(TempHandle, 0, NULL, FILE_BEGIN);
+    SetEndOfFile(TempHandle);
+    if (!TestLineReadWrite(TempHandle, WideBuffer, (BufferLength + 1) * sizeof(WCHAR))) {
+        goto Exit;
+    }
+    if (!TestFinalLinesCompare(TempHandle, _T("UTF16 text"))) {
+        goto Exit;
+    }
+
+    Result = TRUE;
+
+Exit:
+    YoriLibSetMultibyteInputEncoding(OriginalEncoding);
+    if (Buffer != NULL) {
+        YoriLibFree(Buffer);
+    }
+    if (WideBuffer != NULL) {
+        YoriLibFree(WideBuffer);
+    }
+    CloseHandle(TempHandle);
+    DeleteFile(TempName.StartOfString);
+    YoriLibFreeStringContents(&TempName);
+    return Result;
+}
+
+// vim:sw=4:ts=4:et:
@@ -0,0 +1,270 @@
+/**
+ * @file test/output.c
+ *
+ * Yori shell output stream tests
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "test.h"
+
+/**
+ The number of lines written in the output stream performance test.
+ */
+#define TEST_OUTPUT_PERF_LINES 100000
+
+/**
+ Write a set of lines to a file, either directly or through a stream.  Some
+ lines contain escapes, and some are longer than the buffer in a small
+ stream.
+
+ @param FileHandle The file to write to.
+
+ @param Stream Optionally points to a stream to write through.  If NULL,
+        lines are written directly to the file.
+
+ @param LineCount The number of lines to write.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+TestOutputWriteLines(
+    __in HANDLE FileHandle,
+    __in_opt PYORI_LIB_OUTPUT_STREAM Stream,
+    __in DWORD LineCount
+    )
+{
+    TCHAR LongLineBuffer[200];
+    YORI_STRING LongLine;
+    DWORD Index;
+    BOOL Result;
+
+    for (Index = 0; Index < sizeof(LongLineBuffer)/sizeof(LongLineBuffer[0]) - 1; Index++) {
+        LongLineBuffer[Index] = (TCHAR)('a' + Index % 26);
+    }
+    LongLineBuffer[Index] = '\n';
+    YoriLibInitEmptyString(&LongLine);
+    LongLine.StartOfString = LongLineBuffer;
+    LongLine.LengthInChars = sizeof(LongLineBuffer)/sizeof(LongLineBuffer[0]);
+
+    for (Index = 0; Index < LineCount; Index++) {
+        if (Index % 97 == 0) {
+            if (Stream != NULL) {
+                Result = YoriLibOutputStreamString(Stream, &LongLine);
+            } else {
+                Result = YoriLibOutputString(FileHandle, 0, &LongLine);
+            }
+        } else if (Index % 89 == 0) {
+            if (Stream != NULL) {
+                Result = YoriLibOutputStream(Stream, _T("%i: %y"), Index, &LongLine);
+            } else {
+                Result = YoriLibOutputToDevice(FileHandle, 0, _T("%i: %y"), Index, &LongLine);
+            }
+        } else {
+            if (Stream != NULL) {
+                Result = YoriLibOutputStream(Stream, _T("Line %i of %i: %c[1m%08x%c[0m\n"), Index, LineCount, 27, Index * 7919, 27);
+            } else {
+                Result = YoriLibOutputToDevice(FileHandle, 0, _T("Line %i of %i: %c[1m%08x%c[0m\n"), Index, LineCount, 27, Index * 7919, 27);
+            }
+        }
+
+        if (!Result) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i write failure on line %i\n"), __FILE__, __LINE__, Index);
+            return FALSE;
+        }
+    }
+
+    if (Stream != NULL && !YoriLibOutputStreamClose(Stream)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i stream close failure\n"), __FILE__, __LINE__);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Check that two files contain the same data.
+
+ @param FirstHandle The first file to compare.
+
+ @param SecondHandle The second file to compare.
+
+ @return TRUE if the files are identical, FALSE if they are not.
+ */
+BOOLEAN
+TestOutputCompareFiles(
+    __in HANDLE FirstHandle,
+    __in HANDLE SecondHandle
+    )
+{
+    UCHAR FirstBuffer[4096];
+    UCHAR SecondBuffer[4096];
+    DWORD FirstRead;
+    DWORD SecondRead;
+    DWORDLONG Offset;
+
+    SetFilePointer(FirstHandle, 0, NULL, FILE_BEGIN);
+    SetFilePointer(SecondHandle, 0, NULL, FILE_BEGIN);
+
+    Offset = 0;
+    while (TRUE) {
+        if (!ReadFile(FirstHandle, FirstBuffer, sizeof(FirstBuffer), &FirstRead, NULL) ||
+            !ReadFile(SecondHandle, SecondBuffer, sizeof(SecondBuffer), &SecondRead, NULL)) {
+
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i read failure\n"), __FILE__, __LINE__);
+            return FALSE;
+        }
+
+        if (FirstRead != SecondRead ||
+            memcmp(FirstBuffer, SecondBuffer, FirstRead) != 0) {
+
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i output differs near offset %lli\n"), __FILE__, __LINE__, Offset);
+            return FALSE;
+        }
+
+        if (FirstRead == 0) {
+            break;
+        }
+        Offset = Offset + FirstRead;
+    }
+
+    return TRUE;
+}
+
+/**
+ Write lines to two files, one directly and one through a stream, and check
+ that the files are identical.
+
+ @param LineCount The number of lines to write.
+
+ @param FlushSize The flush size of the stream.
+
+ @param DirectTime On successful completion, updated to contain the time
+        taken to write directly, in microseconds.
+
+ @param StreamTime On successful completion, updated to contain the time
+        taken to write through the stream, in microseconds.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+TestOutputCompareStream(
+    __in DWORD LineCount,
+    __in YORI_ALLOC_SIZE_T FlushSize,
+    __out PDWORDLONG DirectTime,
+    __out PDWORDLONG StreamTime
+    )
+{
+    YORI_LIB_OUTPUT_STREAM Stream;
+    HANDLE DirectHandle;
+    HANDLE StreamHandle;
+    YORI_STRING DirectName;
+    YORI_STRING StreamName;
+    LARGE_INTEGER Frequency;
+    LARGE_INTEGER Start;
+    LARGE_INTEGER End;
+    BOOLEAN Result;
+
+    if (!TestCreateTempFile(&DirectHandle, &DirectName)) {
+        return FALSE;
+    }
+
+    if (!TestCreateTempFile(&StreamHandle, &StreamName)) {
+        CloseHandle(DirectHandle);
+        DeleteFile(DirectName.StartOfString);
+        YoriLibFreeStringContents(&DirectName);
+        return FALSE;
+    }
+
+    Result = FALSE;
+    QueryPerformanceFrequency(&Frequency);
+
+    QueryPerformanceCounter(&Start);
+    if (!TestOutputWriteLines(DirectHandle, NULL, LineCount)) {
+        goto Exit;
+    }
+    QueryPerformanceCounter(&End);
+    *DirectTime = (DWORDLONG)(End.QuadPart - Start.QuadPart) * 1000000 / Frequency.QuadPart;
+
+    QueryPerformanceCounter(&Start);
+    YoriLibOutputStreamInitializeForDevice(&Stream, StreamHandle, 0, FlushSize);
+    if (!TestOutputWriteLines(StreamHandle, &Stream, LineCount)) {
+        goto Exit;
+    }
+    QueryPerformanceCounter(&End);
+    *StreamTime = (DWORDLONG)(End.QuadPart - Start.QuadPart) * 1000000 / Frequency.QuadPart;
+
+    if (!TestOutputCompareFiles(DirectHandle, StreamHandle)) {
+        goto Exit;
+    }
+
+    Result = TRUE;
+
+Exit:
+    CloseHandle(DirectHandle);
+    CloseHandle(StreamHandle);
+    DeleteFile(DirectName.StartOfString);
+    DeleteFile(StreamName.StartOfString);
+    YoriLibFreeStringContents(&DirectName);
+    YoriLibFreeStringContents(&StreamName);
+    return Result;
+}
+
+/**
+ A test variation to check that output written through a stream with a small
+ buffer is identical to output written directly, including strings larger
+ than the buffer.
+ */
+BOOLEAN
+TestOutputStream(VOID)
+{
+    DWORDLONG DirectTime;
+    DWORDLONG StreamTime;
+
+    return TestOutputCompareStream(1000, 64, &DirectTime, &StreamTime);
+}
+
+/**
+ A test variation to compare the time taken to write many lines to a file
+ directly and through a stream.
+ */
+BOOLEAN
+TestOutputStreamPerf(VOID)
+{
+    DWORDLONG DirectTime;
+    DWORDLONG StreamTime;
+
+    if (!TestOutputCompareStream(TEST_OUTPUT_PERF_LINES, 0, &DirectTime, &StreamTime)) {
+        return FALSE;
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                  _T("  %i lines: direct %10lli us, stream %10lli us\n"),
+                  TEST_OUTPUT_PERF_LINES,
+                  DirectTime,
+                  StreamTime);
+
+    return TRUE;
+}
+
+// vim:sw=4:ts=4:et:
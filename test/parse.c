@@ -3,7 +3,7 @@
  *
  * Yori shell test command line parsing
  *
- * Copyright (c) 2022 Malcolm J. Smith
+ * Copyright (c) 2022-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -732,4 +732,132 @@ TestParseRedirectWithEndingQuoteCmd(VOID)
     return TRUE;
 }
 
+/**
+ The number of times each command is parsed when measuring parse
+ performance.
+ */
+#define TEST_PARSE_PERF_ITERATIONS (20000)
+
+/**
+ A test variation to measure the time and number of allocations needed to
+ parse commands into execution plans and insert an argument into the first
+ program, as the shell does when splitting a builtin name from its first
+ argument.  Each plan should require a single allocation, where allocating
+ each program and argument array individually would require one allocation
+ for the entire command plus two per program.  Only the plan is allocated
+ from an arena; parsing the command line allocates each argument, and
+ inserting an argument reallocates the argument array from the heap.
+ */
+BOOLEAN
+TestParsePerf(VOID)
+{
+    LPTSTR Commands[] = {
+        _T("foo bar"),
+        _T("dir /b *.c | sort | head -5"),
+        _T("cl -nologo -c foo.c && link -nologo foo.obj || echo failed"),
+        _T("ymake -j 4 all & echo one & echo two & echo three & echo four")
+    };
+    YORI_LIBSH_CMD_CONTEXT CmdContext;
+    YORI_LIBSH_EXEC_PLAN ExecPlan;
+    YORI_STRING InputString;
+    LARGE_INTEGER Frequency;
+    LARGE_INTEGER Start;
+    LARGE_INTEGER End;
+    DWORD CmdAllocations;
+    DWORD PlanAllocations;
+    DWORD ExpandAllocations;
+    DWORD AllocationCount;
+    DWORD PerObjectAllocations;
+    DWORD Iteration;
+    DWORD Index;
+
+    QueryPerformanceFrequency(&Frequency);
+
+    for (Index = 0; Index < sizeof(Commands)/sizeof(Commands[0]); Index++) {
+        YoriLibConstantString(&InputString, Commands[Index]);
+        CmdAllocations = 0;
+        PlanAllocations = 0;
+        ExpandAllocations = 0;
+        PerObjectAllocations = 0;
+
+        QueryPerformanceCounter(&Start);
+        for (Iteration = 0; Iteration < TEST_PARSE_PERF_ITERATIONS; Iteration++) {
+            AllocationCount = YoriLibGetAllocationCount();
+            if (!YoriLibShParseCmdlineToCmdContext(&InputString, 0, &CmdContext)) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                              _T("%hs:%i YoriLibShParseCmdlineToCmdContext failed on '%y'\n"),
+                              __FILE__,
+                              __LINE__,
+                              &InputString);
+                return FALSE;
+            }
+            CmdAllocations = CmdAllocations + YoriLibGetAllocationCount() - AllocationCount;
+
+            AllocationCount = YoriLibGetAllocationCount();
+            if (!YoriLibShParseCmdContextToExecPlan(&CmdContext, &ExecPlan, NULL, NULL, NULL, NULL)) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                              _T("%hs:%i YoriLibShParseCmdContextToExecPlan failed on '%y'\n"),
+                              __FILE__,
+                              __LINE__,
+                              &InputString);
+                YoriLibShFreeCmdContext(&CmdContext);
+                return FALSE;
+            }
+            PlanAllocations = PlanAllocations + YoriLibGetAllocationCount() - AllocationCount;
+            PerObjectAllocations = PerObjectAllocations + 1 + 2 * ExecPlan.NumberCommands;
+
+            AllocationCount = YoriLibGetAllocationCount();
+            if (!YoriLibShExpandCmdContext(&ExecPlan.FirstCmd->CmdToExec, 1, 1)) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                              _T("%hs:%i YoriLibShExpandCmdContext failed on '%y'\n"),
+                              __FILE__,
+                              __LINE__,
+                              &InputString);
+                YoriLibShFreeExecPlan(&ExecPlan);
+                YoriLibShFreeCmdContext(&CmdContext);
+                return FALSE;
+            }
+            ExpandAllocations = ExpandAllocations + YoriLibGetAllocationCount() - AllocationCount;
+
+            YoriLibShFreeExecPlan(&ExecPlan);
+            YoriLibShFreeCmdContext(&CmdContext);
+        }
+        QueryPerformanceCounter(&End);
+
+#if !YORI_SPECIAL_HEAP
+        if (PlanAllocations != TEST_PARSE_PERF_ITERATIONS) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                          _T("%hs:%i YoriLibShParseCmdContextToExecPlan used %i allocations per plan for '%y', expected 1\n"),
+                          __FILE__,
+                          __LINE__,
+                          PlanAllocations / TEST_PARSE_PERF_ITERATIONS,
+                          &InputString);
+            return FALSE;
+        }
+
+        if (ExpandAllocations != TEST_PARSE_PERF_ITERATIONS) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                          _T("%hs:%i YoriLibShExpandCmdContext used %i allocations per command for '%y', expected 1\n"),
+                          __FILE__,
+                          __LINE__,
+                          ExpandAllocations / TEST_PARSE_PERF_ITERATIONS,
+                          &InputString);
+            return FALSE;
+        }
+#endif
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                      _T("  %-64s %8lli us, allocations per command: cmd %i plan %i (per object %i) expand %i total %i\n"),
+                      Commands[Index],
+                      (DWORDLONG)(End.QuadPart - Start.QuadPart) * 1000000 / Frequency.QuadPart,
+                      CmdAllocations / TEST_PARSE_PERF_ITERATIONS,
+                      PlanAllocations / TEST_PARSE_PERF_ITERATIONS,
+                      PerObjectAllocations / TEST_PARSE_PERF_ITERATIONS,
+                      ExpandAllocations / TEST_PARSE_PERF_ITERATIONS,
+                      (CmdAllocations + PlanAllocations + ExpandAllocations) / TEST_PARSE_PERF_ITERATIONS);
+    }
+
+    return TRUE;
+}
+
 // vim:sw=4:ts=4:et:
@@ -0,0 +1,424 @@
+/**
+ * @file test/regex.c
+ *
+ * Yori shell regular expression tests
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "test.h"
+
+/**
+ A single expression to search for along with the expected result.
+ */
+typedef struct _TEST_REGEX_CASE {
+
+    /**
+     The expression to search for.
+     */
+    LPCTSTR Pattern;
+
+    /**
+     The string to search within.
+     */
+    LPCTSTR String;
+
+    /**
+     TRUE if the search should be case insensitive.
+     */
+    BOOLEAN Insensitive;
+
+    /**
+     TRUE if a match is expected.
+     */
+    BOOLEAN Found;
+
+    /**
+     The offset of the expected match.
+     */
+    YORI_ALLOC_SIZE_T Offset;
+
+    /**
+     The length of the expected match.
+     */
+    YORI_ALLOC_SIZE_T Length;
+} TEST_REGEX_CASE;
+
+/**
+ Constant pointer to a single expression to search for.
+ */
+typedef TEST_REGEX_CASE CONST *PCTEST_REGEX_CASE;
+
+/**
+ Expressions with known results.
+ */
+CONST TEST_REGEX_CASE TestRegexCases[] = {
+    {_T("abc"),            _T("xxabcxx"),            FALSE, TRUE,  2, 3},
+    {_T("ABC"),            _T("xxabcxx"),            FALSE, FALSE, 0, 0},
+    {_T("ABC"),            _T("xxabcxx"),            TRUE,  TRUE,  2, 3},
+    {_T("a.c"),            _T("abc"),                FALSE, TRUE,  0, 3},
+    {_T("a*"),             _T("baaa"),               FALSE, TRUE,  0, 0},
+    {_T("a+"),             _T("baaa"),               FALSE, TRUE,  1, 3},
+    {_T("a+?"),            _T("baaa"),               FALSE, TRUE,  1, 1},
+    {_T("ba?b"),           _T("abbab"),              FALSE, TRUE,  1, 2},
+    {_T("a{2,3}"),         _T("aaaa"),               FALSE, TRUE,  0, 3},
+    {_T("a{2}"),           _T("abaab"),              FALSE, TRUE,  2, 2},
+    {_T("a{2,}b"),         _T("abaaab"),             FALSE, TRUE,  2, 4},
+    {_T("cat|dog"),        _T("hotdog"),             FALSE, TRUE,  3, 3},
+    {_T("(?:ab)+"),        _T("xababa"),             FALSE, TRUE,  1, 4},
+    {_T("(a|ab)(c|bcd)"),  _T("abcd"),               FALSE, TRUE,  0, 4},
+    {_T("[a-c]+"),         _T("xxbcaz"),             FALSE, TRUE,  2, 3},
+    {_T("[^a-c]+"),        _T("abxyc"),              FALSE, TRUE,  2, 2},
+    {_T("[a-c]+"),         _T("XXBCAZ"),             TRUE,  TRUE,  2, 3},
+    {_T("\\d+"),           _T("abc 1234 def"),       FALSE, TRUE,  4, 4},
+    {_T("\\w+\\s\\w+"),    _T("  hello world"),      FALSE, TRUE,  2, 11},
+    {_T("\\bis\\b"),       _T("this is it"),         FALSE, TRUE,  5, 2},
+    {_T("\\Bis"),          _T("this is it"),         FALSE, TRUE,  2, 2},
+    {_T("^abc"),           _T("xabc"),               FALSE, FALSE, 0, 0},
+    {_T("abc$"),           _T("abcabc"),             FALSE, TRUE,  3, 3},
+    {_T("^$"),             _T(""),                   FALSE, TRUE,  0, 0},
+    {_T("\\x41\\u0042"),   _T("xAB"),                FALSE, TRUE,  1, 2},
+    {_T("a\\.b"),          _T("axb a.b"),            FALSE, TRUE,  4, 3},
+    {_T("[.]"),            _T("ab.c"),               FALSE, TRUE,  2, 1},
+    {_T("(x+x+)+y"),       _T("xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx"), FALSE, FALSE, 0, 0},
+};
+
+/**
+ Expressions which are not valid and should fail to compile.
+ */
+LPCTSTR TestRegexInvalid[] = {
+    _T("("),
+    _T("a)"),
+    _T("[abc"),
+    _T("*a"),
+    _T("a{3,2}"),
+    _T("a\\"),
+    _T("[z-a]"),
+};
+
+/**
+ Compile a single expression and search for it within a string.
+
+ @param Pattern The expression to search for.
+
+ @param String The string to search within.
+
+ @param Insensitive TRUE to search case insensitively.
+
+ @param Found On successful completion, set to TRUE if a match was found.
+
+ @param Offset On successful completion, set to the offset of the match.
+
+ @param Length On successful completion, set to the length of the match.
+
+ @return TRUE to indicate the expression was compiled, FALSE if it could not
+         be.
+ */
+__success(return)
+BOOLEAN
+TestRegexSearch(
+    __in PYORI_STRING Pattern,
+    __in PYORI_STRING String,
+    __in BOOLEAN Insensitive,
+    __out PBOOLEAN Found,
+    __out PYORI_ALLOC_SIZE_T Offset,
+    __out PYORI_ALLOC_SIZE_T Length
+    )
+{
+    PYORI_LIB_REGEX Regex;
+
+    Regex = YoriLibAllocateRegex(1, Pattern, Insensitive, NULL, NULL);
+    if (Regex == NULL) {
+        return FALSE;
+    }
+
+    *Offset = 0;
+    *Length = 0;
+    *Found = FALSE;
+    if (YoriLibRegexFindFirst(Regex, String, 0, Offset, Length) != NULL) {
+        *Found = TRUE;
+    }
+
+    YoriLibFreeRegex(Regex);
+    return TRUE;
+}
+
+/**
+ The maximum length of a literal string used in a randomly generated search.
+ */
+#define TEST_REGEX_MAX_LITERAL 4
+
+/**
+ A test variation to check that regular expressions return expected
+ results, and that expressions containing only literal text return the same
+ results as a substring search.
+ */
+BOOLEAN
+TestRegex(VOID)
+{
+    YORI_STRING Pattern;
+    YORI_STRING Literal;
+    YORI_STRING String;
+    TCHAR PatternBuffer[TEST_REGEX_MAX_LITERAL * 2];
+    TCHAR LiteralBuffer[TEST_REGEX_MAX_LITERAL];
+    TCHAR StringBuffer[24];
+    PCTEST_REGEX_CASE Case;
+    PYORI_STRING Expected;
+    YORI_ALLOC_SIZE_T ExpectedOffset;
+    YORI_ALLOC_SIZE_T FoundOffset;
+    YORI_ALLOC_SIZE_T FoundLength;
+    YORI_ALLOC_SIZE_T Index;
+    DWORD Iteration;
+    DWORD Seed;
+    BOOLEAN Found;
+    BOOLEAN Insensitive;
+    LPCTSTR Alphabet;
+
+    for (Index = 0; Index < sizeof(TestRegexCases)/sizeof(TestRegexCases[0]); Index++) {
+        Case = &TestRegexCases[Index];
+        YoriLibConstantString(&Pattern, Case->Pattern);
+        YoriLibConstantString(&String, Case->String);
+        if (!TestRegexSearch(&Pattern, &String, Case->Insensitive, &Found, &FoundOffset, &FoundLength)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i could not compile %y\n"), __FILE__, __LINE__, &Pattern);
+            return FALSE;
+        }
+
+        if (Found != Case->Found ||
+            (Found && (FoundOffset != Case->Offset || FoundLength != Case->Length))) {
+
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i %y in %y found %i offset %i length %i, expected found %i offset %i length %i\n"), __FILE__, __LINE__, &Pattern, &String, Found, FoundOffset, FoundLength, Case->Found, Case->Offset, Case->Length);
+            return FALSE;
+        }
+    }
+
+    for (Index = 0; Index < sizeof(TestRegexInvalid)/sizeof(TestRegexInvalid[0]); Index++) {
+        YoriLibConstantString(&Pattern, TestRegexInvalid[Index]);
+        YoriLibConstantString(&String, _T("abc"));
+        if (TestRegexSearch(&Pattern, &String, FALSE, &Found, &FoundOffset, &FoundLength)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i %y should not compile\n"), __FILE__, __LINE__, &Pattern);
+            return FALSE;
+        }
+    }
+
+    //
+    //  Generate literal strings from an alphabet containing operators, and
+    //  escape them, so the result should match a substring search.
+    //
+
+    Alphabet = _T("aA.*");
+    Seed = 1;
+    for (Iteration = 0; Iteration < 50000; Iteration++) {
+        Insensitive = (BOOLEAN)(Iteration % 2);
+        Literal.StartOfString = LiteralBuffer;
+        Literal.LengthInChars = 1 + TestNextRandom(&Seed) % TEST_REGEX_MAX_LITERAL;
+        Pattern.StartOfString = PatternBuffer;
+        Pattern.LengthInChars = 0;
+        for (Index = 0; Index < Literal.LengthInChars; Index++) {
+            LiteralBuffer[Index] = Alphabet[TestNextRandom(&Seed) % 4];
+            if (LiteralBuffer[Index] == '.' || LiteralBuffer[Index] == '*') {
+                PatternBuffer[Pattern.LengthInChars++] = '\\';
+            }
+            PatternBuffer[Pattern.LengthInChars++] = LiteralBuffer[Index];
+        }
+
+        String.StartOfString = StringBuffer;
+        String.LengthInChars = TestNextRandom(&Seed) % (sizeof(StringBuffer)/sizeof(StringBuffer[0]));
+        for (Index = 0; Index < String.LengthInChars; Index++) {
+            StringBuffer[Index] = Alphabet[TestNextRandom(&Seed) % 4];
+        }
+
+        if (Insensitive) {
+            Expected = YoriLibFindFirstMatchSubstrIns(&String, 1, &Literal, &ExpectedOffset);
+        } else {
+            Expected = YoriLibFindFirstMatchSubstr(&String, 1, &Literal, &ExpectedOffset);
+        }
+
+        if (!TestRegexSearch(&Pattern, &String, Insensitive, &Found, &FoundOffset, &FoundLength)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i could not compile %y\n"), __FILE__, __LINE__, &Pattern);
+            return FALSE;
+        }
+
+        if (Found != (Expected != NULL) ||
+            (Found && (FoundOffset != ExpectedOffset || FoundLength != Literal.LengthInChars))) {
+
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i %y in %y differs from substring search, insensitive %i\n"), __FILE__, __LINE__, &Pattern, &String, Insensitive);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ The number of distinct lines generated for the regular expression
+ performance test.
+ */
+#define TEST_REGEX_PERF_LINES 1024
+
+/**
+ The number of times each generated line is searched in the regular
+ expression performance test.
+ */
+#define TEST_REGEX_PERF_PASSES 50
+
+/**
+ A test variation to compare the time taken to search many lines for a set
+ of literal strings with a compiled substring matcher and with a compiled
+ regular expression, and to search for an expression that a substring
+ search cannot describe.
+ */
+BOOLEAN
+TestRegexPerf(VOID)
+{
+    YORI_STRING MatchArray[4];
+    YORI_STRING Expression;
+    PYORI_STRING Lines;
+    PTCHAR LineBuffer;
+    PYORI_LIB_SUBSTR_MATCHER Matcher;
+    PYORI_LIB_REGEX LiteralRegex;
+    PYORI_LIB_REGEX Regex;
+    LARGE_INTEGER Frequency;
+    LARGE_INTEGER Start;
+    LARGE_INTEGER End;
+    DWORDLONG MatcherTime;
+    DWORDLONG LiteralTime;
+    DWORDLONG RegexTime;
+    DWORD LineNumber;
+    DWORD Pass;
+    DWORD MatcherFound;
+    DWORD LiteralFound;
+    DWORD RegexFound;
+    DWORD Seed;
+    BOOLEAN Result;
+
+    YoriLibConstantString(&MatchArray[0], _T("exception"));
+    YoriLibConstantString(&MatchArray[1], _T("timeout"));
+    YoriLibConstantString(&MatchArray[2], _T("denied"));
+    YoriLibConstantString(&MatchArray[3], _T("worker\\[0042\\]"));
+    YoriLibConstantString(&Expression, _T("worker\\[00[0-4][0-9a-f]\\].*in 4\\d\\dms$"));
+
+    Lines = YoriLibMalloc(TEST_REGEX_PERF_LINES * (sizeof(YORI_STRING) + 96 * sizeof(TCHAR)));
+    if (Lines == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation failure\n"), __FILE__, __LINE__);
+        return FALSE;
+    }
+    LineBuffer = (PTCHAR)&Lines[TEST_REGEX_PERF_LINES];
+
+    Result = FALSE;
+    Matcher = NULL;
+    LiteralRegex = NULL;
+    Regex = NULL;
+
+    LiteralRegex = YoriLibAllocateRegex(sizeof(MatchArray)/sizeof(MatchArray[0]), MatchArray, TRUE, NULL, NULL);
+    Regex = YoriLibAllocateRegex(1, &Expression, TRUE, NULL, NULL);
+
+    //
+    //  The substring matcher takes the last string without escapes.
+    //
+
+    YoriLibConstantString(&MatchArray[3], _T("worker[0042]"));
+    Matcher = YoriLibAllocateSubstrMatcher(sizeof(MatchArray)/sizeof(MatchArray[0]), MatchArray, TRUE);
+    if (Matcher == NULL || LiteralRegex == NULL || Regex == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation failure\n"), __FILE__, __LINE__);
+        goto Exit;
+    }
+
+    Seed = 1;
+    for (LineNumber = 0; LineNumber < TEST_REGEX_PERF_LINES; LineNumber++) {
+        Seed = Seed * 1103515245 + 12345;
+        YoriLibInitEmptyString(&Lines[LineNumber]);
+        Lines[LineNumber].StartOfString = &LineBuffer[LineNumber * 96];
+        Lines[LineNumber].LengthInChars = (YORI_ALLOC_SIZE_T)YoriLibSPrintf(Lines[LineNumber].StartOfString, _T("2026-10-16 12:00:00.000 INFO worker[%04x] request %08x completed in %ims"), (Seed >> 8) & 0xFF, LineNumber, (Seed >> 16) % 500);
+    }
+
+    QueryPerformanceFrequency(&Frequency);
+
+    MatcherFound = 0;
+    QueryPerformanceCounter(&Start);
+    for (Pass = 0; Pass < TEST_REGEX_PERF_PASSES; Pass++) {
+        for (LineNumber = 0; LineNumber < TEST_REGEX_PERF_LINES; LineNumber++) {
+            if (YoriLibSubstrMatcherFindFirst(Matcher, &Lines[LineNumber], NULL) != NULL) {
+                MatcherFound++;
+            }
+        }
+    }
+    QueryPerformanceCounter(&End);
+    MatcherTime = (DWORDLONG)(End.QuadPart - Start.QuadPart) * 1000000 / Frequency.QuadPart;
+
+    LiteralFound = 0;
+    QueryPerformanceCounter(&Start);
+    for (Pass = 0; Pass < TEST_REGEX_PERF_PASSES; Pass++) {
+        for (LineNumber = 0; LineNumber < TEST_REGEX_PERF_LINES; LineNumber++) {
+            if (YoriLibRegexFindFirst(LiteralRegex, &Lines[LineNumber], 0, NULL, NULL) != NULL) {
+                LiteralFound++;
+            }
+        }
+    }
+    QueryPerformanceCounter(&End);
+    LiteralTime = (DWORDLONG)(End.QuadPart - Start.QuadPart) * 1000000 / Frequency.QuadPart;
+
+    RegexFound = 0;
+    QueryPerformanceCounter(&Start);
+    for (Pass = 0; Pass < TEST_REGEX_PERF_PASSES; Pass++) {
+        for (LineNumber = 0; LineNumber < TEST_REGEX_PERF_LINES; LineNumber++) {
+            if (YoriLibRegexFindFirst(Regex, &Lines[LineNumber], 0, NULL, NULL) != NULL) {
+                RegexFound++;
+            }
+        }
+    }
+    QueryPerformanceCounter(&End);
+    RegexTime = (DWORDLONG)(End.QuadPart - Start.QuadPart) * 1000000 / Frequency.QuadPart;
+
+    if (MatcherFound != LiteralFound) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i matcher found %i lines, expression found %i lines\n"), __FILE__, __LINE__, MatcherFound, LiteralFound);
+        goto Exit;
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                  _T("  %i lines, %i matches: matcher %10lli us, literal expression %10lli us\n")
+                  _T("  %i lines, %i matches: expression %10lli us\n"),
+                  TEST_REGEX_PERF_LINES * TEST_REGEX_PERF_PASSES,
+                  MatcherFound,
+                  MatcherTime,
+                  LiteralTime,
+                  TEST_REGEX_PERF_LINES * TEST_REGEX_PERF_PASSES,
+                  RegexFound,
+                  RegexTime);
+
+    Result = TRUE;
+
+Exit:
+    if (Matcher != NULL) {
+        YoriLibFreeSubstrMatcher(Matcher);
+    }
+    if (LiteralRegex != NULL) {
+        YoriLibFreeRegex(LiteralRegex);
+    }
+    if (Regex != NULL) {
+        YoriLibFreeRegex(Regex);
+    }
+    YoriLibFree(Lines);
+    return Result;
+}
+
+// vim:sw=4:ts=4:et:
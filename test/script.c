@@ -0,0 +1,464 @@
+/**
+ * @file test/script.c
+ *
+ * Yori shell script label tests
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "test.h"
+
+/**
+ The number of lines in the generated script.
+ */
+#define TEST_SCRIPT_GOTO_LINES 2000
+
+/**
+ The number of lines between each label in the generated script.
+ */
+#define TEST_SCRIPT_GOTO_LABEL_INTERVAL 10
+
+/**
+ The number of goto commands executed each time the generated script runs.
+ */
+#define TEST_SCRIPT_GOTO_COUNT 50000
+
+/**
+ The number of labels between a goto and its target.  This has no factors in
+ common with the number of labels, so the script jumps to every label in
+ turn.
+ */
+#define TEST_SCRIPT_GOTO_STRIDE 37
+
+/**
+ The maximum number of builtins that ys can register with the test host.
+ */
+#define TEST_SCRIPT_MAX_BUILTINS 8
+
+/**
+ A builtin command registered with the test host.
+ */
+typedef struct _TEST_SCRIPT_BUILTIN {
+
+    /**
+     The name of the command.
+     */
+    YORI_STRING Name;
+
+    /**
+     The function to invoke when the command is executed.
+     */
+    PYORI_CMD_BUILTIN BuiltinFn;
+
+    /**
+     Memory holding the name of the command.
+     */
+    TCHAR Buffer[16];
+} TEST_SCRIPT_BUILTIN, *PTEST_SCRIPT_BUILTIN;
+
+/**
+ State for a minimal shell that hosts ys within the test.  ys locates the
+ shell functions it needs by name within the executable that loads it, so
+ the functions below are exported from the test program.  Commands that are
+ not builtins are treated as comments.
+ */
+typedef struct _TEST_SCRIPT_HOST {
+
+    /**
+     Builtins registered by ys, with the most recent last.
+     */
+    TEST_SCRIPT_BUILTIN Builtins[TEST_SCRIPT_MAX_BUILTINS];
+
+    /**
+     The number of entries in Builtins.
+     */
+    DWORD BuiltinCount;
+
+    /**
+     The function registered by ys to free its cached scripts.
+     */
+    PYORI_BUILTIN_UNLOAD_NOTIFY UnloadNotify;
+
+    /**
+     The exit code of the most recently executed command.
+     */
+    DWORD ErrorLevel;
+
+    /**
+     The number of goto commands executed.
+     */
+    DWORD GotoCount;
+
+    /**
+     The number of goto commands to execute before the testcount command
+     ends the script.
+     */
+    DWORD GotoLimit;
+
+    /**
+     TRUE if a builtin failed, such as a goto that did not find its label.
+     */
+    BOOLEAN CommandFailed;
+} TEST_SCRIPT_HOST, *PTEST_SCRIPT_HOST;
+
+/**
+ The test host for ys.
+ */
+TEST_SCRIPT_HOST TestScriptHost;
+
+/**
+ Declaration for the ys builtin.
+ */
+YORI_CMD_BUILTIN YoriCmd_YS;
+
+/**
+ Find the most recently registered builtin with a specified name.
+
+ @param Name The name of the builtin.
+
+ @return Pointer to the builtin, or NULL if no builtin has the name.
+ */
+PTEST_SCRIPT_BUILTIN
+TestScriptFindBuiltin(
+    __in PCYORI_STRING Name
+    )
+{
+    DWORD Index;
+
+    Index = TestScriptHost.BuiltinCount;
+    while (Index > 0) {
+        Index--;
+        if (YoriLibCompareStringIns(&TestScriptHost.Builtins[Index].Name, Name) == 0) {
+            return &TestScriptHost.Builtins[Index];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ Register a builtin command with the test host.
+
+ @param BuiltinCmd The command to register.
+
+ @param CallbackFn The function to invoke in response to the command.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriApiBuiltinRegister(
+    __in PYORI_STRING BuiltinCmd,
+    __in PYORI_CMD_BUILTIN CallbackFn
+    )
+{
+    PTEST_SCRIPT_BUILTIN Builtin;
+
+    if (TestScriptHost.BuiltinCount >= TEST_SCRIPT_MAX_BUILTINS ||
+        BuiltinCmd->LengthInChars >= sizeof(Builtin->Buffer)/sizeof(Builtin->Buffer[0])) {
+
+        return FALSE;
+    }
+
+    Builtin = &TestScriptHost.Builtins[TestScriptHost.BuiltinCount];
+    YoriLibInitEmptyString(&Builtin->Name);
+    Builtin->Name.StartOfString = Builtin->Buffer;
+    Builtin->Name.LengthAllocated = sizeof(Builtin->Buffer)/sizeof(Builtin->Buffer[0]);
+    memcpy(Builtin->Buffer, BuiltinCmd->StartOfString, BuiltinCmd->LengthInChars * sizeof(TCHAR));
+    Builtin->Buffer[BuiltinCmd->LengthInChars] = '\0';
+    Builtin->Name.LengthInChars = BuiltinCmd->LengthInChars;
+    Builtin->BuiltinFn = CallbackFn;
+    TestScriptHost.BuiltinCount++;
+    return TRUE;
+}
+
+/**
+ Unregister a builtin command from the test host.
+
+ @param BuiltinCmd The command to unregister.
+
+ @param CallbackFn The function that was registered for the command.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriApiBuiltinUnregister(
+    __in PYORI_STRING BuiltinCmd,
+    __in PYORI_CMD_BUILTIN CallbackFn
+    )
+{
+    PTEST_SCRIPT_BUILTIN Builtin;
+    DWORD Index;
+
+    Builtin = TestScriptFindBuiltin(BuiltinCmd);
+    if (Builtin == NULL || Builtin->BuiltinFn != CallbackFn) {
+        return FALSE;
+    }
+
+    for (Index = (DWORD)(Builtin - TestScriptHost.Builtins); Index + 1 < TestScriptHost.BuiltinCount; Index++) {
+        memcpy(&TestScriptHost.Builtins[Index], &TestScriptHost.Builtins[Index + 1], sizeof(TEST_SCRIPT_BUILTIN));
+        TestScriptHost.Builtins[Index].Name.StartOfString = TestScriptHost.Builtins[Index].Buffer;
+    }
+    TestScriptHost.BuiltinCount--;
+    return TRUE;
+}
+
+/**
+ Execute a command from a script in the test host.  Builtins are invoked
+ directly.  The testcount command ends the script once enough goto commands
+ have executed, and any other command is ignored.
+
+ @param Expression The command to execute.
+
+ @return TRUE to indicate the command was executed, FALSE if it could not
+         be parsed.
+ */
+__success(return)
+BOOL
+YoriApiExecuteExpression(
+    __in PYORI_STRING Expression
+    )
+{
+    PYORI_STRING ArgV;
+    YORI_ALLOC_SIZE_T ArgC;
+    YORI_ALLOC_SIZE_T Index;
+    PTEST_SCRIPT_BUILTIN Builtin;
+    YORI_STRING GotoArgV[2];
+
+    ArgV = YoriLibCmdlineToArgcArgv(Expression->StartOfString, (YORI_ALLOC_SIZE_T)-1, FALSE, &ArgC, NULL);
+    if (ArgV == NULL) {
+        return FALSE;
+    }
+
+    TestScriptHost.ErrorLevel = EXIT_SUCCESS;
+    if (ArgC > 0) {
+        if (YoriLibCompareStringLitIns(&ArgV[0], _T("testcount")) == 0) {
+            if (TestScriptHost.GotoCount >= TestScriptHost.GotoLimit) {
+                YoriLibConstantString(&GotoArgV[0], _T("goto"));
+                YoriLibConstantString(&GotoArgV[1], _T(":eof"));
+                Builtin = TestScriptFindBuiltin(&GotoArgV[0]);
+                if (Builtin == NULL) {
+                    TestScriptHost.CommandFailed = TRUE;
+                } else {
+                    TestScriptHost.ErrorLevel = Builtin->BuiltinFn(2, GotoArgV);
+                }
+            }
+        } else {
+            Builtin = TestScriptFindBuiltin(&ArgV[0]);
+            if (Builtin != NULL) {
+                if (YoriLibCompareStringLitIns(&ArgV[0], _T("goto")) == 0) {
+                    TestScriptHost.GotoCount++;
+                }
+                TestScriptHost.ErrorLevel = Builtin->BuiltinFn(ArgC, ArgV);
+            }
+        }
+    }
+
+    if (TestScriptHost.ErrorLevel != EXIT_SUCCESS) {
+        TestScriptHost.CommandFailed = TRUE;
+    }
+
+    for (Index = 0; Index < ArgC; Index++) {
+        YoriLibFreeStringContents(&ArgV[Index]);
+    }
+    YoriLibDereference(ArgV);
+    return TRUE;
+}
+
+/**
+ Return the exit code of the most recently executed command in the test
+ host.
+
+ @return The exit code of the most recently executed command.
+ */
+DWORD
+YoriApiGetErrorLevel(VOID)
+{
+    return TestScriptHost.ErrorLevel;
+}
+
+/**
+ Indicate whether the test host is exiting.  It never is while a script is
+ running.
+
+ @return FALSE.
+ */
+BOOL
+YoriApiIsProcessExiting(VOID)
+{
+    return FALSE;
+}
+
+/**
+ Record a function to invoke when the test host has finished with ys.
+
+ @param UnloadNotify The function to invoke.
+
+ @return TRUE to indicate success, FALSE if a different function has already
+         been recorded.
+ */
+__success(return)
+BOOL
+YoriApiSetUnloadRoutine(
+    __in PYORI_BUILTIN_UNLOAD_NOTIFY UnloadNotify
+    )
+{
+    if (TestScriptHost.UnloadNotify != NULL &&
+        TestScriptHost.UnloadNotify != UnloadNotify) {
+
+        return FALSE;
+    }
+
+    TestScriptHost.UnloadNotify = UnloadNotify;
+    return TRUE;
+}
+
+/**
+ A test variation to measure the time taken to run a script whose loops
+ execute many goto commands.  The script is run by ys, so this measures how
+ ys loads a script, indexes its labels, and finds the target of each goto.
+ The script is run twice, so the second run uses the script that ys cached
+ after the first.
+ */
+BOOLEAN
+TestScriptGotoPerf(VOID)
+{
+    HANDLE TempHandle;
+    YORI_STRING TempName;
+    YORI_STRING ArgV[2];
+    LPSTR Script;
+    YORI_ALLOC_SIZE_T ScriptLength;
+    DWORD BytesWritten;
+    DWORD LabelCount;
+    DWORD Label;
+    DWORD Index;
+    DWORD Run;
+    DWORD ExitCode;
+    LARGE_INTEGER Frequency;
+    LARGE_INTEGER Start;
+    LARGE_INTEGER End;
+    DWORDLONG RunTime[2];
+    BOOLEAN Result;
+
+    if (!TestCreateTempFile(&TempHandle, &TempName)) {
+        return FALSE;
+    }
+
+    Result = FALSE;
+    ZeroMemory(&TestScriptHost, sizeof(TestScriptHost));
+    LabelCount = TEST_SCRIPT_GOTO_LINES / TEST_SCRIPT_GOTO_LABEL_INTERVAL;
+
+    Script = YoriLibMalloc(TEST_SCRIPT_GOTO_LINES * 32);
+    if (Script == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation failure\n"), __FILE__, __LINE__);
+        CloseHandle(TempHandle);
+        goto Exit;
+    }
+
+    //
+    //  Generate a script where each block of lines starts with a label,
+    //  followed by comments, and ends by jumping to a later block.
+    //
+
+    ScriptLength = 0;
+    for (Label = 0; Label < LabelCount; Label++) {
+        ScriptLength = ScriptLength + (YORI_ALLOC_SIZE_T)YoriLibSPrintfA(&Script[ScriptLength], ":Loop%i\r\n", Label);
+        for (Index = 3; Index < TEST_SCRIPT_GOTO_LABEL_INTERVAL; Index++) {
+            ScriptLength = ScriptLength + (YORI_ALLOC_SIZE_T)YoriLibSPrintfA(&Script[ScriptLength], "rem line %i\r\n", Label * TEST_SCRIPT_GOTO_LABEL_INTERVAL + Index);
+        }
+        ScriptLength = ScriptLength + (YORI_ALLOC_SIZE_T)YoriLibSPrintfA(&Script[ScriptLength], "testcount\r\n");
+        ScriptLength = ScriptLength + (YORI_ALLOC_SIZE_T)YoriLibSPrintfA(&Script[ScriptLength], "goto loop%i\r\n", (Label + TEST_SCRIPT_GOTO_STRIDE) % LabelCount);
+    }
+
+    if (!WriteFile(TempHandle, Script, ScriptLength, &BytesWritten, NULL) ||
+        BytesWritten != ScriptLength) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i write failure\n"), __FILE__, __LINE__);
+        CloseHandle(TempHandle);
+        goto Exit;
+    }
+
+    //
+    //  ys opens the script itself, and won't share it with a writer.
+    //
+
+    CloseHandle(TempHandle);
+
+    YoriLibConstantString(&ArgV[0], _T("ys"));
+    YoriLibInitEmptyString(&ArgV[1]);
+    ArgV[1].StartOfString = TempName.StartOfString;
+    ArgV[1].LengthInChars = TempName.LengthInChars;
+    ArgV[1].LengthAllocated = TempName.LengthAllocated;
+
+    QueryPerformanceFrequency(&Frequency);
+    for (Run = 0; Run < 2; Run++) {
+        TestScriptHost.GotoCount = 0;
+        TestScriptHost.GotoLimit = TEST_SCRIPT_GOTO_COUNT;
+        TestScriptHost.CommandFailed = FALSE;
+
+        QueryPerformanceCounter(&Start);
+        ExitCode = YoriCmd_YS(2, ArgV);
+        QueryPerformanceCounter(&End);
+        RunTime[Run] = (DWORDLONG)(End.QuadPart - Start.QuadPart) * 1000000 / Frequency.QuadPart;
+
+        if (ExitCode != EXIT_SUCCESS || TestScriptHost.CommandFailed) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i script failed, exit code %i\n"), __FILE__, __LINE__, ExitCode);
+            goto Exit;
+        }
+
+        if (TestScriptHost.GotoCount != TEST_SCRIPT_GOTO_COUNT) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                          _T("%hs:%i script executed %i gotos, expected %i\n"),
+                          __FILE__,
+                          __LINE__,
+                          TestScriptHost.GotoCount,
+                          TEST_SCRIPT_GOTO_COUNT);
+            goto Exit;
+        }
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                  _T("  %i lines, %i labels, %i gotos: first run %lli us, cached run %lli us\n"),
+                  TEST_SCRIPT_GOTO_LINES,
+                  LabelCount,
+                  TEST_SCRIPT_GOTO_COUNT,
+                  RunTime[0],
+                  RunTime[1]);
+
+    Result = TRUE;
+
+Exit:
+    if (TestScriptHost.UnloadNotify != NULL) {
+        TestScriptHost.UnloadNotify();
+        TestScriptHost.UnloadNotify = NULL;
+    }
+    if (Script != NULL) {
+        YoriLibFree(Script);
+    }
+    DeleteFile(TempName.StartOfString);
+    YoriLibFreeStringContents(&TempName);
+    return Result;
+}
+
+// vim:sw=4:ts=4:et:
@@ -0,0 +1,295 @@
+/**
+ * @file test/strfnd.c
+ *
+ * Yori shell substring search tests
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "test.h"
+
+/**
+ The maximum number of substrings used in a randomly generated search.
+ */
+#define TEST_STRFND_MAX_MATCHES 6
+
+/**
+ Search for a set of substrings with a compiled matcher and check the result
+ against searching for the substrings directly.
+
+ @param String The string to search.
+
+ @param NumberMatches The number of substrings to search for.
+
+ @param MatchArray The substrings to search for.
+
+ @param Insensitive TRUE to search case insensitively, FALSE to search case
+        sensitively.
+
+ @return TRUE if the matcher returned the same results as a direct search,
+         FALSE if it did not.
+ */
+BOOLEAN
+TestStrFndCompareMatcher(
+    __in PYORI_STRING String,
+    __in YORI_ALLOC_SIZE_T NumberMatches,
+    __in PYORI_STRING MatchArray,
+    __in BOOLEAN Insensitive
+    )
+{
+    PYORI_LIB_SUBSTR_MATCHER Matcher;
+    PYORI_STRING Expected;
+    PYORI_STRING Found;
+    YORI_ALLOC_SIZE_T ExpectedOffset;
+    YORI_ALLOC_SIZE_T FoundOffset;
+    YORI_ALLOC_SIZE_T Index;
+    BOOLEAN Result;
+
+    Matcher = YoriLibAllocateSubstrMatcher(NumberMatches, MatchArray, Insensitive);
+    if (Matcher == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation failure\n"), __FILE__, __LINE__);
+        return FALSE;
+    }
+
+    Result = FALSE;
+
+    if (Insensitive) {
+        Expected = YoriLibFindFirstMatchSubstrIns(String, NumberMatches, MatchArray, &ExpectedOffset);
+    } else {
+        Expected = YoriLibFindFirstMatchSubstr(String, NumberMatches, MatchArray, &ExpectedOffset);
+    }
+    Found = YoriLibSubstrMatcherFindFirst(Matcher, String, &FoundOffset);
+    if (Found != Expected || FoundOffset != ExpectedOffset) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i first match in %y differs, insensitive %i\n"), __FILE__, __LINE__, String, Insensitive);
+        goto Exit;
+    }
+
+    //
+    //  The lowest entry is the first substring in array order that is found
+    //  anywhere.
+    //
+
+    Expected = NULL;
+    ExpectedOffset = 0;
+    for (Index = 0; Index < NumberMatches; Index++) {
+        if (Insensitive) {
+            Expected = YoriLibFindFirstMatchSubstrIns(String, 1, &MatchArray[Index], &ExpectedOffset);
+        } else {
+            Expected = YoriLibFindFirstMatchSubstr(String, 1, &MatchArray[Index], &ExpectedOffset);
+        }
+        if (Expected != NULL) {
+            break;
+        }
+    }
+    Found = YoriLibSubstrMatcherFindLowestEntry(Matcher, String, &FoundOffset);
+    if (Found != Expected || FoundOffset != ExpectedOffset) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i lowest entry match in %y differs, insensitive %i\n"), __FILE__, __LINE__, String, Insensitive);
+        goto Exit;
+    }
+
+    Result = TRUE;
+
+Exit:
+    YoriLibFreeSubstrMatcher(Matcher);
+    return Result;
+}
+
+/**
+ A test variation to check that a compiled substring matcher returns the
+ same results as searching for each substring directly.
+ */
+BOOLEAN
+TestSubstrMatcher(VOID)
+{
+    YORI_STRING MatchArray[TEST_STRFND_MAX_MATCHES];
+    TCHAR MatchBuffer[TEST_STRFND_MAX_MATCHES][4];
+    YORI_STRING String;
+    TCHAR StringBuffer[24];
+    YORI_ALLOC_SIZE_T NumberMatches;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T CharIndex;
+    DWORD Iteration;
+    DWORD Seed;
+    LPCTSTR Alphabet;
+
+    //
+    //  Check overlapping substrings, where a longer match starts before a
+    //  shorter one that ends first.
+    //
+
+    YoriLibConstantString(&MatchArray[0], _T("he"));
+    YoriLibConstantString(&MatchArray[1], _T("hers"));
+    YoriLibConstantString(&MatchArray[2], _T("she"));
+    YoriLibConstantString(&String, _T("uSHErs"));
+    if (!TestStrFndCompareMatcher(&String, 3, MatchArray, TRUE) ||
+        !TestStrFndCompareMatcher(&String, 3, MatchArray, FALSE)) {
+
+        return FALSE;
+    }
+
+    //
+    //  Generate substrings and strings from a small alphabet so that
+    //  matches, partial matches and duplicate substrings are common.
+    //
+
+    Alphabet = _T("abAB");
+    Seed = 1;
+    for (Iteration = 0; Iteration < 100000; Iteration++) {
+        NumberMatches = 1 + TestNextRandom(&Seed) % TEST_STRFND_MAX_MATCHES;
+        for (Index = 0; Index < NumberMatches; Index++) {
+            MatchArray[Index].StartOfString = MatchBuffer[Index];
+            MatchArray[Index].LengthInChars = TestNextRandom(&Seed) % 4;
+            if (MatchArray[Index].LengthInChars == 0 && TestNextRandom(&Seed) % 8 != 0) {
+                MatchArray[Index].LengthInChars = 1;
+            }
+            for (CharIndex = 0; CharIndex < MatchArray[Index].LengthInChars; CharIndex++) {
+                MatchBuffer[Index][CharIndex] = Alphabet[TestNextRandom(&Seed) % 4];
+            }
+        }
+
+        String.StartOfString = StringBuffer;
+        String.LengthInChars = TestNextRandom(&Seed) % (sizeof(StringBuffer)/sizeof(StringBuffer[0]));
+        for (CharIndex = 0; CharIndex < String.LengthInChars; CharIndex++) {
+            StringBuffer[CharIndex] = Alphabet[TestNextRandom(&Seed) % 4];
+        }
+
+        if (!TestStrFndCompareMatcher(&String, NumberMatches, MatchArray, (BOOLEAN)(Iteration % 2))) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ The number of distinct lines generated for the substring search performance
+ test.
+ */
+#define TEST_STRFND_PERF_LINES 1024
+
+/**
+ The number of times each generated line is searched in the substring search
+ performance test.
+ */
+#define TEST_STRFND_PERF_PASSES 200
+
+/**
+ A test variation to compare the time taken to search many lines for a set
+ of substrings directly and with a compiled matcher.
+ */
+BOOLEAN
+TestSubstrMatcherPerf(VOID)
+{
+    YORI_STRING MatchArray[10];
+    PYORI_STRING Lines;
+    PTCHAR LineBuffer;
+    PYORI_LIB_SUBSTR_MATCHER Matcher;
+    LARGE_INTEGER Frequency;
+    LARGE_INTEGER Start;
+    LARGE_INTEGER End;
+    DWORDLONG DirectTime;
+    DWORDLONG MatcherTime;
+    DWORD LineNumber;
+    DWORD Pass;
+    DWORD DirectFound;
+    DWORD MatcherFound;
+    DWORD Seed;
+
+    YoriLibConstantString(&MatchArray[0], _T("exception"));
+    YoriLibConstantString(&MatchArray[1], _T("timeout"));
+    YoriLibConstantString(&MatchArray[2], _T("denied"));
+    YoriLibConstantString(&MatchArray[3], _T("fatal"));
+    YoriLibConstantString(&MatchArray[4], _T("corrupt"));
+    YoriLibConstantString(&MatchArray[5], _T("retry"));
+    YoriLibConstantString(&MatchArray[6], _T("overflow"));
+    YoriLibConstantString(&MatchArray[7], _T("deadlock"));
+    YoriLibConstantString(&MatchArray[8], _T("unreachable"));
+    YoriLibConstantString(&MatchArray[9], _T("worker[0042]"));
+
+    Lines = YoriLibMalloc(TEST_STRFND_PERF_LINES * (sizeof(YORI_STRING) + 96 * sizeof(TCHAR)));
+    if (Lines == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation failure\n"), __FILE__, __LINE__);
+        return FALSE;
+    }
+    LineBuffer = (PTCHAR)&Lines[TEST_STRFND_PERF_LINES];
+
+    Matcher = YoriLibAllocateSubstrMatcher(sizeof(MatchArray)/sizeof(MatchArray[0]), MatchArray, TRUE);
+    if (Matcher == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation failure\n"), __FILE__, __LINE__);
+        YoriLibFree(Lines);
+        return FALSE;
+    }
+
+    Seed = 1;
+    for (LineNumber = 0; LineNumber < TEST_STRFND_PERF_LINES; LineNumber++) {
+        Seed = Seed * 1103515245 + 12345;
+        YoriLibInitEmptyString(&Lines[LineNumber]);
+        Lines[LineNumber].StartOfString = &LineBuffer[LineNumber * 96];
+        Lines[LineNumber].LengthInChars = (YORI_ALLOC_SIZE_T)YoriLibSPrintf(Lines[LineNumber].StartOfString, _T("2026-10-16 12:00:00.000 INFO worker[%04x] request %08x completed in %ims"), (Seed >> 8) & 0xFFFF, LineNumber, (Seed >> 16) % 500);
+    }
+
+    QueryPerformanceFrequency(&Frequency);
+
+    DirectFound = 0;
+    QueryPerformanceCounter(&Start);
+    for (Pass = 0; Pass < TEST_STRFND_PERF_PASSES; Pass++) {
+        for (LineNumber = 0; LineNumber < TEST_STRFND_PERF_LINES; LineNumber++) {
+            if (YoriLibFindFirstMatchSubstrIns(&Lines[LineNumber], sizeof(MatchArray)/sizeof(MatchArray[0]), MatchArray, NULL) != NULL) {
+                DirectFound++;
+            }
+        }
+    }
+    QueryPerformanceCounter(&End);
+    DirectTime = (DWORDLONG)(End.QuadPart - Start.QuadPart) * 1000000 / Frequency.QuadPart;
+
+    MatcherFound = 0;
+    QueryPerformanceCounter(&Start);
+    for (Pass = 0; Pass < TEST_STRFND_PERF_PASSES; Pass++) {
+        for (LineNumber = 0; LineNumber < TEST_STRFND_PERF_LINES; LineNumber++) {
+            if (YoriLibSubstrMatcherFindFirst(Matcher, &Lines[LineNumber], NULL) != NULL) {
+                MatcherFound++;
+            }
+        }
+    }
+    QueryPerformanceCounter(&End);
+    MatcherTime = (DWORDLONG)(End.QuadPart - Start.QuadPart) * 1000000 / Frequency.QuadPart;
+
+    YoriLibFreeSubstrMatcher(Matcher);
+    YoriLibFree(Lines);
+
+    if (DirectFound != MatcherFound) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i direct search found %i lines, matcher found %i lines\n"), __FILE__, __LINE__, DirectFound, MatcherFound);
+        return FALSE;
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                  _T("  %i lines, %i matches: direct %10lli us, matcher %10lli us\n"),
+                  TEST_STRFND_PERF_LINES * TEST_STRFND_PERF_PASSES,
+                  MatcherFound,
+                  DirectTime,
+                  MatcherTime);
+
+    return TRUE;
+}
+
+// vim:sw=4:ts=4:et:
@@ -0,0 +1,271 @@
+/**
+ * @file test/strsrt.c
+ *
+ * Yori shell string sort tests
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "test.h"
+
+/**
+ The number of strings sorted in the performance test, and in the largest
+ array in the correctness test.  This is large enough for the sort to use
+ multiple threads.
+ */
+#define TEST_STRSRT_LARGE_COUNT 200000
+
+/**
+ The maximum number of characters in each generated string.
+ */
+#define TEST_STRSRT_MAX_CHARS 16
+
+/**
+ The order of the strings to generate before sorting.
+ */
+typedef enum _TEST_STRSRT_ORDER {
+    TestStrSrtSorted = 0,
+    TestStrSrtReversed = 1,
+    TestStrSrtRandom = 2,
+    TestStrSrtDuplicates = 3,
+    TestStrSrtOrderCount = 4
+} TEST_STRSRT_ORDER;
+
+/**
+ A description of each order, used when reporting results.
+ */
+LPCTSTR TestStrSrtOrderNames[TestStrSrtOrderCount] = {
+    _T("sorted"),
+    _T("reversed"),
+    _T("random"),
+    _T("duplicates")
+};
+
+/**
+ Generate an array of strings resembling file names.  Alternate strings are
+ upper case, so they are only in order when compared without regard to case.
+
+ @param Strings Pointer to the array of strings to populate.
+
+ @param Buffer Pointer to a buffer of TEST_STRSRT_MAX_CHARS characters for
+        each string.
+
+ @param Count The number of strings to generate.
+
+ @param Order The order of the strings to generate.
+ */
+VOID
+TestStrSrtGenerate(
+    __out_ecount(Count) PYORI_STRING Strings,
+    __out_ecount(Count * TEST_STRSRT_MAX_CHARS) PTCHAR Buffer,
+    __in YORI_ALLOC_SIZE_T Count,
+    __in TEST_STRSRT_ORDER Order
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    DWORD Value;
+    DWORD Seed;
+
+    Seed = 1;
+    for (Index = 0; Index < Count; Index++) {
+        Seed = Seed * 1103515245 + 12345;
+        switch(Order) {
+            case TestStrSrtSorted:
+                Value = Index;
+                break;
+            case TestStrSrtReversed:
+                Value = Count - Index;
+                break;
+            case TestStrSrtDuplicates:
+                Value = (Seed >> 16) % 16;
+                break;
+            default:
+                Value = Seed >> 8;
+                break;
+        }
+
+        YoriLibInitEmptyString(&Strings[Index]);
+        Strings[Index].StartOfString = &Buffer[Index * TEST_STRSRT_MAX_CHARS];
+        if (Index % 2 == 0) {
+            Strings[Index].LengthInChars = (YORI_ALLOC_SIZE_T)YoriLibSPrintf(Strings[Index].StartOfString, _T("file%06x.txt"), Value);
+        } else {
+            Strings[Index].LengthInChars = (YORI_ALLOC_SIZE_T)YoriLibSPrintf(Strings[Index].StartOfString, _T("FILE%06X.TXT"), Value);
+        }
+    }
+}
+
+/**
+ Sort an array of strings and check that the result is sorted and contains
+ the same strings as the input.
+
+ @param Strings Pointer to the array of strings to sort.
+
+ @param Count The number of strings in the array.
+
+ @param Flags The flags to pass to the sort.
+
+ @return TRUE if the array was sorted correctly, FALSE if it was not.
+ */
+BOOLEAN
+TestStrSrtSortAndCheck(
+    __inout PYORI_STRING Strings,
+    __in YORI_ALLOC_SIZE_T Count,
+    __in DWORD Flags
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    DWORD_PTR ChecksumBefore;
+    DWORD_PTR ChecksumAfter;
+
+    ChecksumBefore = 0;
+    for (Index = 0; Index < Count; Index++) {
+        ChecksumBefore = ChecksumBefore + (DWORD_PTR)Strings[Index].StartOfString;
+    }
+
+    YoriLibSortStringArrayEx(Strings, Count, Flags);
+
+    ChecksumAfter = 0;
+    for (Index = 0; Index < Count; Index++) {
+        ChecksumAfter = ChecksumAfter + (DWORD_PTR)Strings[Index].StartOfString;
+        if (Index > 0 && YoriLibCompareStringIns(&Strings[Index - 1], &Strings[Index]) > 0) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i %y sorted before %y, count %i flags %x\n"), __FILE__, __LINE__, &Strings[Index - 1], &Strings[Index], Count, Flags);
+            return FALSE;
+        }
+    }
+
+    if (ChecksumBefore != ChecksumAfter) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i sorted array does not contain the original strings, count %i flags %x\n"), __FILE__, __LINE__, Count, Flags);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ A test variation to check that arrays of strings are sorted correctly
+ regardless of their initial order, size, or the options used to sort them.
+ */
+BOOLEAN
+TestSortStringArray(VOID)
+{
+    PYORI_STRING Strings;
+    PTCHAR Buffer;
+    TEST_STRSRT_ORDER Order;
+    YORI_ALLOC_SIZE_T Count;
+    DWORD Flags;
+
+    Strings = YoriLibMalloc(TEST_STRSRT_LARGE_COUNT * (sizeof(YORI_STRING) + TEST_STRSRT_MAX_CHARS * sizeof(TCHAR)));
+    if (Strings == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation failure\n"), __FILE__, __LINE__);
+        return FALSE;
+    }
+    Buffer = (PTCHAR)&Strings[TEST_STRSRT_LARGE_COUNT];
+
+    for (Order = 0; Order < TestStrSrtOrderCount; Order++) {
+        for (Flags = 0; Flags <= (YORILIB_SORT_CACHE_KEYS | YORILIB_SORT_PARALLEL); Flags++) {
+
+            //
+            //  Small arrays are handled by the insertion sort, arrays around
+            //  the cutoff exercise partitioning, and the large array can be
+            //  sorted with multiple threads.
+            //
+
+            for (Count = 0; Count < 64; Count++) {
+                TestStrSrtGenerate(Strings, Buffer, Count, Order);
+                if (!TestStrSrtSortAndCheck(Strings, Count, Flags)) {
+                    YoriLibFree(Strings);
+                    return FALSE;
+                }
+            }
+
+            TestStrSrtGenerate(Strings, Buffer, TEST_STRSRT_LARGE_COUNT, Order);
+            if (!TestStrSrtSortAndCheck(Strings, TEST_STRSRT_LARGE_COUNT, Flags)) {
+                YoriLibFree(Strings);
+                return FALSE;
+            }
+        }
+    }
+
+    YoriLibFree(Strings);
+    return TRUE;
+}
+
+/**
+ A test variation to compare the time taken to sort arrays of strings with
+ and without cached keys and multiple threads.
+ */
+BOOLEAN
+TestSortStringArrayPerf(VOID)
+{
+    PYORI_STRING Strings;
+    PTCHAR Buffer;
+    TEST_STRSRT_ORDER Order;
+    LARGE_INTEGER Frequency;
+    LARGE_INTEGER Start;
+    LARGE_INTEGER End;
+    DWORDLONG PlainTime;
+    DWORDLONG KeyedTime;
+    DWORDLONG ParallelTime;
+
+    Strings = YoriLibMalloc(TEST_STRSRT_LARGE_COUNT * (sizeof(YORI_STRING) + TEST_STRSRT_MAX_CHARS * sizeof(TCHAR)));
+    if (Strings == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation failure\n"), __FILE__, __LINE__);
+        return FALSE;
+    }
+    Buffer = (PTCHAR)&Strings[TEST_STRSRT_LARGE_COUNT];
+
+    QueryPerformanceFrequency(&Frequency);
+
+    for (Order = 0; Order < TestStrSrtOrderCount; Order++) {
+        TestStrSrtGenerate(Strings, Buffer, TEST_STRSRT_LARGE_COUNT, Order);
+        QueryPerformanceCounter(&Start);
+        YoriLibSortStringArrayEx(Strings, TEST_STRSRT_LARGE_COUNT, 0);
+        QueryPerformanceCounter(&End);
+        PlainTime = (DWORDLONG)(End.QuadPart - Start.QuadPart) * 1000000 / Frequency.QuadPart;
+
+        TestStrSrtGenerate(Strings, Buffer, TEST_STRSRT_LARGE_COUNT, Order);
+        QueryPerformanceCounter(&Start);
+        YoriLibSortStringArrayEx(Strings, TEST_STRSRT_LARGE_COUNT, YORILIB_SORT_CACHE_KEYS);
+        QueryPerformanceCounter(&End);
+        KeyedTime = (DWORDLONG)(End.QuadPart - Start.QuadPart) * 1000000 / Frequency.QuadPart;
+
+        TestStrSrtGenerate(Strings, Buffer, TEST_STRSRT_LARGE_COUNT, Order);
+        QueryPerformanceCounter(&Start);
+        YoriLibSortStringArrayEx(Strings, TEST_STRSRT_LARGE_COUNT, YORILIB_SORT_CACHE_KEYS | YORILIB_SORT_PARALLEL);
+        QueryPerformanceCounter(&End);
+        ParallelTime = (DWORDLONG)(End.QuadPart - Start.QuadPart) * 1000000 / Frequency.QuadPart;
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                      _T("  %i %-10s strings: plain %10lli us, keys %10lli us, keys and threads %10lli us\n"),
+                      TEST_STRSRT_LARGE_COUNT,
+                      TestStrSrtOrderNames[Order],
+                      PlainTime,
+                      KeyedTime,
+                      ParallelTime);
+    }
+
+    YoriLibFree(Strings);
+    return TRUE;
+}
+
+// vim:sw=4:ts=4:et:
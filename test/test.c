@@ -3,7 +3,7 @@
  *
  * Yori shell test suite
  *
- * Copyright (c) 2022 Malcolm J. Smith
+ * Copyright (c) 2022-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -41,7 +41,7 @@ CHAR strTestHelpText[] =
         "   -v             Variation to include\n"
         "   -x             Variation to exclude\n"
         "\n"
-        "Supported variations:\n";
+        "Supported variations (* only run when included with -v):\n";
 
 /**
  A structure to describe a test variation.
@@ -58,6 +58,13 @@ typedef struct _TEST_VARIATION {
      */
     LPCTSTR Name;
 
+    /**
+     If TRUE, the variation is only executed when it is requested via
+     command line parameter.  This is used for benchmarks, which take a long
+     time and can consume large amounts of disk space.
+     */
+    BOOLEAN ExplicitOnly;
+
     /**
      If TRUE, the execution status of this variation was set explicitly via
      command line parameter.  If FALSE, default execution should apply.
@@ -79,6 +86,31 @@ typedef struct _TEST_VARIATION {
 TEST_VARIATION TestVariations[] = {
     {TestEnumRoot,                         _T("EnumRoot")},
     {TestEnumWindows,                      _T("EnumWindows")},
+    {TestEnumTreePerf,                     _T("EnumTreePerf"), TRUE},
+    {TestOpenHashTable,                    _T("OpenHashTable")},
+    {TestHashTablePerf,                    _T("HashTablePerf"), TRUE},
+    {TestLineRead,                         _T("LineRead")},
+    {TestLineReadPerf,                     _T("LineReadPerf"), TRUE},
+    {TestLineCount,                        _T("LineCount")},
+    {TestLineCountLarge,                   _T("LineCountLarge"), TRUE},
+    {TestLineCountPerf,                    _T("LineCountPerf"), TRUE},
+    {TestFinalLines,                       _T("FinalLines")},
+    {TestIni,                              _T("Ini")},
+    {TestIniPerf,                          _T("IniPerf"), TRUE},
+    {TestSubstrMatcher,                    _T("SubstrMatcher")},
+    {TestSubstrMatcherPerf,                _T("SubstrMatcherPerf"), TRUE},
+    {TestRegex,                            _T("Regex")},
+    {TestRegexPerf,                        _T("RegexPerf"), TRUE},
+    {TestScriptGotoPerf,                   _T("ScriptGotoPerf"), TRUE},
+    {TestDigest,                           _T("Digest")},
+    {TestDigestPerf,                       _T("DigestPerf"), TRUE},
+    {TestBase64,                           _T("Base64")},
+    {TestBase64Output,                     _T("Base64Output")},
+    {TestBase64Perf,                       _T("Base64Perf"), TRUE},
+    {TestSortStringArray,                  _T("SortStringArray")},
+    {TestSortStringArrayPerf,              _T("SortStringArrayPerf"), TRUE},
+    {TestOutputStream,                     _T("OutputStream")},
+    {TestOutputStreamPerf,                 _T("OutputStreamPerf"), TRUE},
     {TestParseTwoArgCmd,                   _T("ParseTwoArgCmd")},
     {TestParseOneArgContainingQuotesCmd,   _T("ParseOneArgContainingQuotesCmd")},
     {TestParseOneArgEnclosedInQuotesCmd,   _T("ParseOneArgEnclosedInQuotesCmd")},
@@ -87,6 +119,7 @@ TEST_VARIATION TestVariations[] = {
     {TestParseOneArgWithStartingQuotesEndingCaretCmd, _T("ParseOneArgWithStartingQuotesEndingCaretCmd")},
     {TestParseOneArgContainingAndEnclosedInQuotesCmd, _T("ParseOneArgContainingAndEnclosedInQuotesCmd")},
     {TestParseRedirectWithEndingQuoteCmd,  _T("ParseRedirectWithEndingQuoteCmd")},
+    {TestParsePerf,                        _T("ParsePerf"), TRUE},
     {TestArgTwoArgCmd,                     _T("ArgTwoArgCmd")},
     {TestArgOneArgContainingQuotesCmd,     _T("ArgOneArgContainingQuotesCmd")},
     {TestArgOneArgWithStartingQuotesCmd,   _T("ArgOneArgWithStartingQuotesCmd")},
@@ -95,6 +128,61 @@ TEST_VARIATION TestVariations[] = {
     {TestArgBackslashEscapeCmd,            _T("ArgBackslashEscapeCmd")},
 };
 
+/**
+ Create a temporary file for a test variation.  The caller is expected to
+ close and delete the file when the variation completes.
+
+ @param TempHandle On successful completion, updated to contain a handle to
+        the file, opened for read and write.
+
+ @param TempName On successful completion, updated to contain the name of the
+        file.  The caller should free this with YoriLibFreeStringContents.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+TestCreateTempFile(
+    __out PHANDLE TempHandle,
+    __out PYORI_STRING TempName
+    )
+{
+    YORI_STRING TempPath;
+    YORI_STRING Prefix;
+
+    if (!YoriLibGetTempPath(&TempPath, 0)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i could not find temporary path\n"), __FILE__, __LINE__);
+        return FALSE;
+    }
+
+    YoriLibConstantString(&Prefix, _T("YTT"));
+    if (!YoriLibGetTempFileName(&TempPath, &Prefix, TempHandle, TempName)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i could not create temporary file in %y\n"), __FILE__, __LINE__, &TempPath);
+        YoriLibFreeStringContents(&TempPath);
+        return FALSE;
+    }
+
+    YoriLibFreeStringContents(&TempPath);
+    return TRUE;
+}
+
+/**
+ Return the next value from a simple pseudo random sequence, so that test
+ failures can be reproduced.
+
+ @param Seed Pointer to the state of the sequence, updated on return.
+
+ @return The next value in the sequence.
+ */
+DWORD
+TestNextRandom(
+    __inout PDWORD Seed
+    )
+{
+    *Seed = *Seed * 1103515245 + 12345;
+    return (*Seed >> 16) & 0x7FFF;
+}
+
 
 /**
  Display usage text to the user.
@@ -109,7 +197,7 @@ TestHelp(VOID)
 #endif
     YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%hs"), strTestHelpText);
     for (i = 0; i < sizeof(TestVariations)/sizeof(TestVariations[0]); i++) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("    %s\n"), TestVariations[i].Name);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("   %c%s\n"), TestVariations[i].ExplicitOnly?'*':' ', TestVariations[i].Name);
     }
     return TRUE;
 }
@@ -185,8 +273,9 @@ ymain(
 
         ExecuteVariation = FALSE;
         if (RunAll) {
-            if (!TestVariations[i].ExplicitlySpecified ||
-                TestVariations[i].Execute) {
+            if ((!TestVariations[i].ExplicitlySpecified ||
+                 TestVariations[i].Execute) &&
+                !TestVariations[i].ExplicitOnly) {
 
                 ExecuteVariation = TRUE;
             }
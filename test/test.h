@@ -3,7 +3,7 @@
  *
  * Yori shell test header
  *
- * Copyright (c) 2022 Malcolm J. Smith
+ * Copyright (c) 2022-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -36,6 +36,18 @@ YORI_TEST_FN(VOID);
  */
 typedef YORI_TEST_FN *PYORI_TEST_FN;
 
+__success(return)
+BOOLEAN
+TestCreateTempFile(
+    __out PHANDLE TempHandle,
+    __out PYORI_STRING TempName
+    );
+
+DWORD
+TestNextRandom(
+    __inout PDWORD Seed
+    );
+
 /**
  A test variation to enumerate files in the root.
  */
@@ -46,6 +58,151 @@ YORI_TEST_FN TestEnumRoot;
  */
 YORI_TEST_FN TestEnumWindows;
 
+/**
+ A test variation to compare the time taken to enumerate a deep tree on a
+ single thread and in parallel.
+ */
+YORI_TEST_FN TestEnumTreePerf;
+
+/**
+ A test variation to insert, find, enumerate and remove entries from an open
+ addressed hash table.
+ */
+YORI_TEST_FN TestOpenHashTable;
+
+/**
+ A test variation to compare the performance of the chained and open
+ addressed hash tables.
+ */
+YORI_TEST_FN TestHashTablePerf;
+
+/**
+ A test variation to check line splitting, byte order mark handling, and
+ that reading lines in batches matches reading them individually.
+ */
+YORI_TEST_FN TestLineRead;
+
+/**
+ A test variation to compare the throughput of reading lines individually
+ and in batches.
+ */
+YORI_TEST_FN TestLineReadPerf;
+
+/**
+ A test variation to check that counting lines matches reading each line.
+ */
+YORI_TEST_FN TestLineCount;
+
+/**
+ A test variation to check that counting lines in a file large enough to be
+ split into ranges matches reading each line.
+ */
+YORI_TEST_FN TestLineCountLarge;
+
+/**
+ A test variation to compare the throughput of counting lines and reading
+ each line.
+ */
+YORI_TEST_FN TestLineCountPerf;
+
+/**
+ A test variation to check that searching backwards for the final lines of a
+ file matches reading each line.
+ */
+YORI_TEST_FN TestFinalLines;
+
+/**
+ A test variation to check parsing, querying, updating and saving an INI
+ document.
+ */
+YORI_TEST_FN TestIni;
+
+/**
+ A test variation to compare the time taken to query a large package INI
+ file from an in memory document and with the system profile functions.
+ */
+YORI_TEST_FN TestIniPerf;
+
+/**
+ A test variation to check that a compiled substring matcher returns the
+ same results as searching for each substring directly.
+ */
+YORI_TEST_FN TestSubstrMatcher;
+
+/**
+ A test variation to compare the time taken to search for a set of
+ substrings directly and with a compiled matcher.
+ */
+YORI_TEST_FN TestSubstrMatcherPerf;
+
+/**
+ A test variation to check that regular expressions return expected results.
+ */
+YORI_TEST_FN TestRegex;
+
+/**
+ A test variation to compare the time taken to search for literal strings
+ and regular expressions.
+ */
+YORI_TEST_FN TestRegexPerf;
+
+/**
+ A test variation to measure the time taken by ys to run a script whose loops
+ execute many goto commands.
+ */
+YORI_TEST_FN TestScriptGotoPerf;
+
+/**
+ A test variation to check that base64 encode and decode return known results
+ regardless of how data is supplied to them.
+ */
+YORI_TEST_FN TestBase64;
+
+/**
+ A test variation to check that base64 encoded text is written in the active
+ output encoding.
+ */
+YORI_TEST_FN TestBase64Output;
+
+/**
+ A test variation to measure the throughput of base64 encode and decode.
+ */
+YORI_TEST_FN TestBase64Perf;
+
+/**
+ A test variation to check that each digest algorithm returns known results
+ regardless of how data is supplied to it.
+ */
+YORI_TEST_FN TestDigest;
+
+/**
+ A test variation to measure the throughput of each digest algorithm.
+ */
+YORI_TEST_FN TestDigestPerf;
+
+/**
+ A test variation to check that arrays of strings are sorted correctly.
+ */
+YORI_TEST_FN TestSortStringArray;
+
+/**
+ A test variation to compare the time taken to sort arrays of strings with
+ and without cached keys and multiple threads.
+ */
+YORI_TEST_FN TestSortStringArrayPerf;
+
+/**
+ A test variation to check that output written through a stream is identical
+ to output written directly.
+ */
+YORI_TEST_FN TestOutputStream;
+
+/**
+ A test variation to compare the time taken to write many lines to a file
+ directly and through a stream.
+ */
+YORI_TEST_FN TestOutputStreamPerf;
+
 /**
  A test variation to parse a command with two space delimited arguments.
  */
@@ -92,6 +249,12 @@ YORI_TEST_FN TestParseOneArgContainingAndEnclosedInQuotesCmd;
  */
 YORI_TEST_FN TestParseRedirectWithEndingQuoteCmd;
 
+/**
+ A test variation to measure the time and number of allocations needed to
+ parse commands into execution plans and insert arguments into them.
+ */
+YORI_TEST_FN TestParsePerf;
+
 /**
  A test variation to parse a command with two space delimited arguments.
  */
@@ -102,6 +102,11 @@ typedef struct _TYPE_CONTEXT {
 
 } TYPE_CONTEXT, *PTYPE_CONTEXT;
 
+/**
+ The number of lines to request from each read of the input stream.
+ */
+#define TYPE_LINES_PER_READ 64
+
 /**
  Process a single opened stream, enumerating through all lines and displaying
  the set requested by the user.
@@ -121,15 +126,20 @@ TypeProcessStream(
 {
     PVOID LineContext = NULL;
     CONSOLE_SCREEN_BUFFER_INFO ScreenInfo;
-    YORI_STRING LineString;
+    YORI_STRING LineBuffer;
+    YORI_LIB_LINE_SPAN Lines[TYPE_LINES_PER_READ];
+    PYORI_STRING LineString;
+    YORI_ALLOC_SIZE_T LineCount;
+    YORI_ALLOC_SIZE_T Index;
     BOOL OutputIsConsole;
+    BOOL Finished;
     DWORD dwMode;
     DWORD CharactersDisplayed;
     HANDLE OutputHandle;
 
     OutputHandle = GetStdHandle(STD_OUTPUT_HANDLE);
 
-    YoriLibInitEmptyString(&LineString);
+    YoriLibInitEmptyString(&LineBuffer);
 
     TypeContext->FilesFound++;
     TypeContext->FilesFoundThisArg++;
@@ -140,21 +150,29 @@ TypeProcessStream(
         OutputIsConsole = TRUE;
     }
 
-    while (TRUE) {
+    Finished = FALSE;
+    while (!Finished) {
 
-        if (!YoriLibReadLineToString(&LineString, &LineContext, hSource)) {
+        if (!YoriLibReadLineBatch(&LineBuffer, &LineContext, TRUE, hSource, Lines, sizeof(Lines)/sizeof(Lines[0]), &LineCount)) {
             break;
         }
 
-        TypeContext->FileLinesFound++;
+        for (Index = 0; Index < LineCount; Index++) {
+            LineString = &Lines[Index].Line;
+
+            TypeContext->FileLinesFound++;
+
+            if (TypeContext->HeadLines != 0 && TypeContext->FileLinesFound > TypeContext->HeadLines) {
+                Finished = TRUE;
+                break;
+            }
 
-        if ((TypeContext->HeadLines == 0 || TypeContext->FileLinesFound <= TypeContext->HeadLines)) {
             if (TypeContext->DisplayLineNumbers) {
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%8lli: %y"), TypeContext->FileLinesFound, &LineString);
-                CharactersDisplayed = LineString.LengthInChars + 10;
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%8lli: %y"), TypeContext->FileLinesFound, LineString);
+                CharactersDisplayed = LineString->LengthInChars + 10;
             } else {
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &LineString);
-                CharactersDisplayed = LineString.LengthInChars;
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), LineString);
+                CharactersDisplayed = LineString->LengthInChars;
             }
             if (CharactersDisplayed == 0 ||
                 !OutputIsConsole ||
@@ -163,13 +181,11 @@ TypeProcessStream(
 
                 YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n"));
             }
-        } else {
-            break;
         }
     }
 
     YoriLibLineReadCloseOrCache(LineContext);
-    YoriLibFreeStringContents(&LineString);
+    YoriLibFreeStringContents(&LineBuffer);
 
     return TRUE;
 }